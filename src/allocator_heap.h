@@ -129,10 +129,10 @@ MemHeapFree( void* mem )
 }
 
 #define MemHeapAlloc( type, num ) \
-  Cast( type*, MemHeapAllocBytes( num * sizeof( type ) ) )
+  Cast( type*, MemHeapAllocBytes( ( num ) * sizeof( type ) ) )
 
 #define MemHeapRealloc( type, mem, oldnum, newnum ) \
-  Cast( type*, MemHeapReallocBytes( mem, oldnum * sizeof( type ), newnum * sizeof( type ) ) )
+  Cast( type*, MemHeapReallocBytes( mem, ( oldnum ) * sizeof( type ), ( newnum ) * sizeof( type ) ) )
 
 
 
@@ -21,25 +21,27 @@
   #include <sys/types.h>
   #include <sys/mman.h>
 
+  // the size header takes a full 64B line, so the returned memory keeps the same alignment the heap gives.
+  constant idx_t c_virtualalloc_header = 64;
+
   Inl void
   MemVirtualFree( void* mem )
   {
-    auto umem = Cast( idx_t*, mem );
-    auto nbytes_alloc = umem[-1];
-    int result = munmap( umem - 1, nbytes_alloc );
+    auto umem = Cast( u8*, mem ) - c_virtualalloc_header;
+    auto nbytes_alloc = *Cast( idx_t*, umem );
+    int result = munmap( umem, nbytes_alloc );
     AssertCrash( !result );
   }
   Inl void*
   MemVirtualAllocBytes( idx_t nbytes )
   {
-    auto nbytes_alloc = nbytes + _SIZEOF_IDX_T;
+    auto nbytes_alloc = nbytes + c_virtualalloc_header;
     void* memnew = mmap( 0 /*start_addr*/, nbytes_alloc, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1 /*file_descriptor*/, 0 /*offset_into_file*/);
     if( !memnew || memnew == Cast( void*, -1 ) ) {
       return 0;
     }
-    auto umemnew = Cast( idx_t*, memnew );
-    umemnew[0] = nbytes_alloc;
-    return umemnew + 1;
+    *Cast( idx_t*, memnew ) = nbytes_alloc;
+    return Cast( u8*, memnew ) + c_virtualalloc_header;
   }
 #endif
 
@@ -54,7 +56,7 @@ MemVirtualReallocBytes( void* oldmem, idx_t oldlen, idx_t newlen )
 
 
 #define MemVirtualAlloc( type, num ) \
-  Cast( type*, MemVirtualAllocBytes( num * sizeof( type ) ) )
+  Cast( type*, MemVirtualAllocBytes( ( num ) * sizeof( type ) ) )
 
 #define MemVirtualRealloc( type, mem, oldnum, newnum ) \
-  Cast( type*, MemVirtualReallocBytes( mem, oldnum * sizeof( type ), newnum * sizeof( type ) ) )
+  Cast( type*, MemVirtualReallocBytes( mem, ( oldnum ) * sizeof( type ), ( newnum ) * sizeof( type ) ) )
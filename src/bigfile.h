@@ -0,0 +1,1006 @@
+// Copyright (c) John A. Carlos Jr., all rights reserved.
+
+//
+// read-mostly view of files too big to load into a buf_t, e.g. multi-GB logs.
+//
+// nothing proportional to the file size stays resident. we keep:
+//   - a sparse line index: the byte offset of every c_bigfile_index_stride'th line. a taskthread builds it in
+//     the background, so the first screen is up immediately, and the rest of the file fills in as it's indexed.
+//   - an LRU of mapped windows into the file. any line lookup maps at most a few windows.
+//   - an overlay piece table over line ranges, for edits. pieces either name a range of original lines, or a
+//     range of lines we added. an unedited file has no pieces at all, which means 'all of the original lines'.
+//
+// save streams the pieces out to a temp file, and then replaces the original with it.
+// edits need to know how many original lines there are, so they aren't allowed until the index is done.
+//
+
+constant u32 c_bigfile_index_stride = 1024;
+constant idx_t c_bigfile_index_block_len = 64*1024;
+constant idx_t c_bigfile_index_max_blocks = 4096; // 2^28 entries of 2^10 lines each, so way past any real file.
+constant idx_t c_bigfile_num_windows = 8;
+constant idx_t c_bigfile_window_step = 32*1024*1024;
+constant idx_t c_bigfile_save_chunk = 4*1024*1024;
+
+// index task states.
+constant u32 c_bigfile_index_idle = 0;
+constant u32 c_bigfile_index_queued = 1;
+constant u32 c_bigfile_index_running = 2;
+
+struct
+bigfile_window_t
+{
+  u64 offset;
+  u8* mem;
+  idx_t len;
+  u64 last_used;
+};
+
+struct
+bigfile_piece_t
+{
+  u64 start; // original line number when !added, else an index into bigfile_t::added.
+  u64 nlines;
+  bool added;
+};
+
+struct
+bigfile_t
+{
+  fsobj_t filename;
+  filemapped_t mapping; // windowed.
+
+  // windows cover 2 * window_step bytes, starting on multiples of window_step.
+  // so any range of up to window_step bytes fits in a single window; that's also our max line len.
+  idx_t window_step;
+  bigfile_window_t windows[c_bigfile_num_windows];
+  u64 window_clock;
+
+  // the sparse line index. entry i is the offset of original line i * c_bigfile_index_stride.
+  // the index task writes this while the main thread reads it; blocks never move once allocated, and entries
+  // are written before num_offsets publishes them, so no locking is needed.
+  u64* offset_blocks[c_bigfile_index_max_blocks];
+  volatile u64 num_offsets;
+  volatile u64 nlines_indexed; // number of eols seen; these lines have known ends.
+  volatile u64 bytes_indexed;
+  volatile bool index_done;
+  volatile bool index_failed;
+  volatile bool index_cancel;
+  volatile u32 index_state;
+  u64 nlines_orig; // only valid once index_done.
+  eoltype_t eoltype; // only valid once index_done.
+
+  // the last original line we looked up, so sequential lookups don't rescan from the index entry.
+  bool cache_valid;
+  u64 cache_y;
+  u64 cache_offset;
+
+  // the overlay. empty until the first edit.
+  stack_resizeable_cont_t<bigfile_piece_t> pieces;
+  stack_resizeable_cont_t<slice_t> added;
+  pagelist_t added_mem;
+  u64 nlines; // only valid when pieces.len.
+  bool unsaved;
+
+  // the last piece we looked up, and its first line. piece lookups walk from here, so lookups near the last one,
+  // like scrolling, searching, and typing, don't rescan from the first piece.
+  idx_t piece_cache_idx;
+  u64 piece_cache_y0;
+};
+
+Inl void
+Zero( bigfile_t& bf )
+{
+  bf.filename.len = 0;
+  bf.mapping = {};
+  bf.window_step = 0;
+  For( i, 0, c_bigfile_num_windows ) {
+    bf.windows[i] = {};
+  }
+  bf.window_clock = 0;
+  For( i, 0, c_bigfile_index_max_blocks ) {
+    bf.offset_blocks[i] = 0;
+  }
+  bf.num_offsets = 0;
+  bf.nlines_indexed = 0;
+  bf.bytes_indexed = 0;
+  bf.index_done = 0;
+  bf.index_failed = 0;
+  bf.index_cancel = 0;
+  bf.index_state = c_bigfile_index_idle;
+  bf.nlines_orig = 0;
+  bf.eoltype = eoltype_t::crlf;
+  bf.cache_valid = 0;
+  bf.cache_y = 0;
+  bf.cache_offset = 0;
+  Zero( bf.pieces );
+  Zero( bf.added );
+  Zero( bf.added_mem );
+  bf.nlines = 0;
+  bf.unsaved = 0;
+  bf.piece_cache_idx = 0;
+  bf.piece_cache_y0 = 0;
+}
+
+// =================================================================================
+// INDEXING
+//
+
+Inl void
+_BigfileAddOffset( bigfile_t& bf, u64 offset )
+{
+  auto i = bf.num_offsets;
+  auto block = i / c_bigfile_index_block_len;
+  AssertCrash( block < c_bigfile_index_max_blocks );
+  if( !bf.offset_blocks[block] ) {
+    bf.offset_blocks[block] = MemHeapAlloc( u64, c_bigfile_index_block_len );
+  }
+  bf.offset_blocks[block][ i % c_bigfile_index_block_len ] = offset;
+  _ReadWriteBarrier();
+  bf.num_offsets = i + 1;
+}
+
+Inl u64
+_BigfileIndexOffset( bigfile_t& bf, u64 i )
+{
+  AssertCrash( i < bf.num_offsets );
+  return bf.offset_blocks[ i / c_bigfile_index_block_len ][ i % c_bigfile_index_block_len ];
+}
+
+// counts eols in mem[0, scan_len), recording an offset every c_bigfile_index_stride lines.
+// mem_len may be one past scan_len, so we can see whether a '\r' at the end is the start of a crlf.
+// an eol ends at the '\n' of a crlf, so the line after it starts right after that.
+Inl void
+_BigfileIndexScan(
+  bigfile_t& bf,
+  u8* mem,
+  idx_t scan_len,
+  idx_t mem_len,
+  u64 base,
+  u64* nlines_,
+  eolcounts_t* totals
+  )
+{
+  auto nlines = *nlines_;
+  auto next_mark = ( nlines / c_bigfile_index_stride + 1 ) * c_bigfile_index_stride;
+  idx_t i = 0;
+#if STRINGSEARCH_SIMD
+  auto cr = StrvecSet( '\r' );
+  auto lf = StrvecSet( '\n' );
+  while( i + c_stringsearch_width <= scan_len  &&  i + c_stringsearch_width + 1 <= mem_len ) {
+    auto v = StrvecLoad( mem + i );
+    auto mask_cr = StrvecEqualMask( v, cr );
+    auto mask_lf = StrvecEqualMask( v, lf );
+    auto mask_lf_next = StrvecEqualMask( StrvecLoad( mem + i + 1 ), lf );
+    auto ends = mask_lf | ( mask_cr & ~mask_lf_next );
+    totals->num_cr += _mm_popcnt_u32( mask_cr & ~mask_lf_next );
+    totals->num_lf += _mm_popcnt_u32( mask_lf );
+    totals->num_crlf += _mm_popcnt_u32( mask_cr & mask_lf_next );
+    auto n = _mm_popcnt_u32( ends );
+    if( nlines + n < next_mark ) {
+      nlines += n;
+    }
+    else {
+      while( ends ) {
+        auto bit = _tzcnt_u32( ends );
+        ends &= ends - 1;
+        nlines += 1;
+        if( nlines == next_mark ) {
+          _BigfileAddOffset( bf, base + i + bit + 1 );
+          next_mark += c_bigfile_index_stride;
+        }
+      }
+    }
+    i += c_stringsearch_width;
+  }
+#endif
+  for( ;  i < scan_len;  ++i ) {
+    auto c = mem[i];
+    auto next_lf = ( i + 1 < mem_len )  &&  ( mem[i + 1] == '\n' );
+    bool end = 0;
+    if( c == '\n' ) {
+      totals->num_lf += 1;
+      end = 1;
+    }
+    elif( c == '\r' ) {
+      if( next_lf ) {
+        totals->num_crlf += 1;
+      }
+      else {
+        totals->num_cr += 1;
+        end = 1;
+      }
+    }
+    if( end ) {
+      nlines += 1;
+      if( nlines == next_mark ) {
+        _BigfileAddOffset( bf, base + i + 1 );
+        next_mark += c_bigfile_index_stride;
+      }
+    }
+  }
+  *nlines_ = nlines;
+}
+
+// note this maps its own views, since the LRU windows belong to the main thread.
+Inl void
+_BigfileIndex( bigfile_t& bf )
+{
+  auto size = bf.mapping.size;
+  eolcounts_t totals = {};
+  u64 nlines = 0;
+  _BigfileAddOffset( bf, 0 );
+  for( u64 offset = 0;  offset < size;  offset += bf.window_step ) {
+    if( bf.index_cancel ) {
+      return;
+    }
+    // one byte of lookahead, for a crlf straddling the step boundary.
+    idx_t len = bf.window_step + 1;
+    auto mem = FileMappedView( bf.mapping, offset, &len );
+    if( !mem ) {
+      bf.index_failed = 1;
+      return;
+    }
+    auto scan_len = MIN( len, bf.window_step );
+    _BigfileIndexScan( bf, mem, scan_len, len, offset, &nlines, &totals );
+    FileMappedUnview( mem, len );
+
+    _ReadWriteBarrier();
+    bf.nlines_indexed = nlines;
+    bf.bytes_indexed = offset + scan_len;
+  }
+
+  // the lf totals include the lf half of every crlf.
+  totals.num_lf -= totals.num_crlf;
+
+  // same tie breaking as BufLoad.
+  auto max_eol = MAX3( totals.num_cr, totals.num_lf, totals.num_crlf );
+  if( max_eol == totals.num_crlf ) {
+    bf.eoltype = eoltype_t::crlf;
+  }
+  elif( max_eol == totals.num_lf ) {
+    bf.eoltype = eoltype_t::lf;
+  }
+  else {
+    bf.eoltype = eoltype_t::cr;
+  }
+
+  // the final line has no eol.
+  bf.nlines_orig = nlines + 1;
+  _ReadWriteBarrier();
+  bf.index_done = 1;
+}
+
+// note Kill may have beaten us to it, if the task sat in the queue for a while.
+// that's also why bigfile_t storage has to stay put while a task could still be queued; the edit_t owns ours.
+__AsyncTask( AsyncTask_BigfileIndex )
+{
+  auto bf = Cast( bigfile_t*, misc0 );
+  if( !CAS( &bf->index_state, c_bigfile_index_queued, c_bigfile_index_running ) ) {
+    return;
+  }
+  _BigfileIndex( *bf );
+  _ReadWriteBarrier();
+  bf->index_state = c_bigfile_index_idle;
+}
+
+// window_step must be a multiple of c_filemapped_granularity; the tests use small ones.
+// main thread only, since we push the index task.
+Inl bool
+BigfileOpen( bigfile_t& bf, u8* name, idx_t name_len, idx_t window_step = c_bigfile_window_step )
+{
+  AssertCrash( window_step % c_filemapped_granularity == 0 );
+  Zero( bf );
+  bf.mapping = FileOpenMappedWindowedExistingReadShareRead( name, name_len );
+  if( !bf.mapping.loaded ) {
+    return 0;
+  }
+  Memmove( AddBack( bf.filename, name_len ), name, name_len );
+  Memmove( AddBack( bf.filename ), "\0", 1 );
+  RemBack( bf.filename );
+  bf.window_step = window_step;
+  Alloc( bf.pieces, 16 );
+  Alloc( bf.added, 16 );
+  Init( bf.added_mem, 4096 );
+
+  bf.index_state = c_bigfile_index_queued;
+  if( g_mainthread.taskthreads.len ) {
+    asyncqueue_entry_t entry;
+    entry.FnAsyncTask = AsyncTask_BigfileIndex;
+    entry.misc0 = &bf;
+    entry.misc1 = 0;
+    entry.time_generated = TimeTSC();
+    PushAsyncTask( 0, &entry );
+  }
+  else {
+    bf.index_state = c_bigfile_index_running;
+    _BigfileIndex( bf );
+    bf.index_state = c_bigfile_index_idle;
+  }
+  return 1;
+}
+
+// closes the file, but keeps the index and the pieces, e.g. so save can put the original back.
+Inl void
+_BigfileUnmap( bigfile_t& bf )
+{
+  // the index task may still be using the mapping and the index blocks.
+  // if it hasn't started yet, take it back, since the taskthreads may already be gone at shutdown.
+  bf.index_cancel = 1;
+  if( !CAS( &bf.index_state, c_bigfile_index_queued, c_bigfile_index_idle ) ) {
+    while( bf.index_state == c_bigfile_index_running ) {
+      _mm_pause();
+    }
+  }
+  For( i, 0, c_bigfile_num_windows ) {
+    auto window = bf.windows + i;
+    if( window->mem ) {
+      FileMappedUnview( window->mem, window->len );
+    }
+    *window = {};
+  }
+  FileFree( bf.mapping );
+}
+
+Inl void
+Kill( bigfile_t& bf )
+{
+  _BigfileUnmap( bf );
+  For( i, 0, c_bigfile_index_max_blocks ) {
+    if( bf.offset_blocks[i] ) {
+      MemHeapFree( bf.offset_blocks[i] );
+    }
+  }
+  Free( bf.pieces );
+  Free( bf.added );
+  Kill( bf.added_mem );
+  Zero( bf );
+}
+
+Inl u64
+BigfileNLines( bigfile_t& bf )
+{
+  if( bf.pieces.len ) {
+    return bf.nlines;
+  }
+  if( bf.index_done ) {
+    return bf.nlines_orig;
+  }
+  // only lines with a known end until we're done.
+  return bf.nlines_indexed;
+}
+
+// =================================================================================
+// WINDOWS AND LINES
+//
+
+// returns the bytes starting at offset, up to the end of the window holding it.
+// that's always at least window_step bytes, unless we hit the end of the file.
+// note this can evict whatever window an earlier call returned.
+// returns 0 on failure, including when a failed save couldn't reopen the file.
+Inl u8*
+_BigfileView( bigfile_t& bf, u64 offset, idx_t* len )
+{
+  if( !bf.mapping.loaded ) {
+    *len = 0;
+    return 0;
+  }
+  AssertCrash( offset < bf.mapping.size );
+  auto window_offset = offset - offset % bf.window_step;
+  bigfile_window_t* window = 0;
+  bigfile_window_t* lru = bf.windows;
+  For( i, 0, c_bigfile_num_windows ) {
+    auto w = bf.windows + i;
+    if( w->mem  &&  w->offset == window_offset ) {
+      window = w;
+      break;
+    }
+    if( w->last_used < lru->last_used ) {
+      lru = w;
+    }
+  }
+  if( !window ) {
+    window = lru;
+    if( window->mem ) {
+      FileMappedUnview( window->mem, window->len );
+    }
+    window->offset = window_offset;
+    window->len = 2 * bf.window_step;
+    window->mem = FileMappedView( bf.mapping, window_offset, &window->len );
+    if( !window->mem ) {
+      AssertWarn( 0 );
+      window->len = 0;
+      *len = 0;
+      return 0;
+    }
+  }
+  window->last_used = ++bf.window_clock;
+  auto skip = Cast( idx_t, offset - window_offset );
+  *len = window->len - skip;
+  return window->mem + skip;
+}
+
+Inl idx_t
+_BigfileScanEol( u8* mem, idx_t len )
+{
+  idx_t i = 0;
+#if STRINGSEARCH_SIMD
+  auto cr = StrvecSet( '\r' );
+  auto lf = StrvecSet( '\n' );
+  while( i + c_stringsearch_width <= len ) {
+    auto v = StrvecLoad( mem + i );
+    auto mask = StrvecEqualMask( v, cr ) | StrvecEqualMask( v, lf );
+    if( mask ) {
+      return i + _tzcnt_u32( mask );
+    }
+    i += c_stringsearch_width;
+  }
+#endif
+  while( i < len  &&  mem[i] != '\r'  &&  mem[i] != '\n' ) {
+    i += 1;
+  }
+  return i;
+}
+
+// finds the end of the original line starting at offset, and where the line after it starts.
+Inl void
+_BigfileLineEnd( bigfile_t& bf, u64 offset, u64* end, u64* next )
+{
+  auto size = bf.mapping.size;
+  auto pos = offset;
+  while( pos < size ) {
+    idx_t avail;
+    auto mem = _BigfileView( bf, pos, &avail );
+    if( !mem ) {
+      break;
+    }
+    auto i = _BigfileScanEol( mem, avail );
+    if( i < avail ) {
+      *end = pos + i;
+      *next = pos + i + 1;
+      if( mem[i] == '\r'  &&  *next < size ) {
+        // the '\n' of a crlf can land in the next window.
+        idx_t avail_next;
+        auto mem_next = ( i + 1 < avail )  ?  mem + i + 1  :  _BigfileView( bf, *next, &avail_next );
+        if( mem_next  &&  *mem_next == '\n' ) {
+          *next += 1;
+        }
+      }
+      return;
+    }
+    pos += avail;
+  }
+  *end = size;
+  *next = size;
+}
+
+// offset of original line y. y has to be indexed already.
+Inl u64
+_BigfileOrigLineOffset( bigfile_t& bf, u64 y )
+{
+  u64 y0;
+  u64 offset;
+  if( bf.cache_valid  &&  bf.cache_y <= y  &&  y - bf.cache_y < c_bigfile_index_stride ) {
+    y0 = bf.cache_y;
+    offset = bf.cache_offset;
+  }
+  else {
+    auto k = y / c_bigfile_index_stride;
+    y0 = k * c_bigfile_index_stride;
+    offset = _BigfileIndexOffset( bf, k );
+  }
+  while( y0 < y ) {
+    u64 end;
+    _BigfileLineEnd( bf, offset, &end, &offset );
+    y0 += 1;
+  }
+  bf.cache_valid = 1;
+  bf.cache_y = y;
+  bf.cache_offset = offset;
+  return offset;
+}
+
+// returns the index of the piece holding line y, or pieces.len for y == nlines, and sets *y0 to its first line.
+Inl idx_t
+_BigfileFindPiece( bigfile_t& bf, u64 y, u64* y0 )
+{
+  auto i = bf.piece_cache_idx;
+  auto start = bf.piece_cache_y0;
+  while( i  &&  y < start ) {
+    i -= 1;
+    start -= bf.pieces.mem[i].nlines;
+  }
+  while( i < bf.pieces.len  &&  y - start >= bf.pieces.mem[i].nlines ) {
+    start += bf.pieces.mem[i].nlines;
+    i += 1;
+  }
+  bf.piece_cache_idx = i;
+  bf.piece_cache_y0 = start;
+  *y0 = start;
+  return i;
+}
+
+// maps line space to a piece, and the line within that piece.
+Inl bigfile_piece_t*
+_BigfilePieceFromLine( bigfile_t& bf, u64 y, u64* y_in_piece )
+{
+  u64 y0;
+  auto i = _BigfileFindPiece( bf, y, &y0 );
+  AssertCrash( i < bf.pieces.len );
+  *y_in_piece = y - y0;
+  return bf.pieces.mem + i;
+}
+
+// lines longer than window_step get truncated.
+// note the returned contents are only valid until the next bigfile call.
+Inl slice_t
+BigfileLine( bigfile_t& bf, u64 y )
+{
+  AssertCrash( y < BigfileNLines( bf ) );
+  auto y_orig = y;
+  if( bf.pieces.len ) {
+    u64 y_in_piece;
+    auto piece = _BigfilePieceFromLine( bf, y, &y_in_piece );
+    if( piece->added ) {
+      return bf.added.mem[ piece->start + y_in_piece ];
+    }
+    y_orig = piece->start + y_in_piece;
+  }
+
+  auto offset = _BigfileOrigLineOffset( bf, y_orig );
+  u64 end;
+  u64 next;
+  _BigfileLineEnd( bf, offset, &end, &next );
+
+  // scrolling and searching go line by line, so remember where the next line starts.
+  bf.cache_y = y_orig + 1;
+  bf.cache_offset = next;
+
+  slice_t line = {};
+  if( end > offset ) {
+    idx_t avail;
+    line.mem = _BigfileView( bf, offset, &avail );
+    line.len = Cast( idx_t, MIN( end - offset, Cast( u64, MIN( avail, bf.window_step ) ) ) );
+  }
+  return line;
+}
+
+// =================================================================================
+// EDITS
+//
+
+Inl bool
+BigfileCanEdit( bigfile_t& bf )
+{
+  return bf.index_done  &&  !bf.index_failed;
+}
+
+Inl void
+_BigfileInitPieces( bigfile_t& bf )
+{
+  AssertCrash( BigfileCanEdit( bf ) );
+  if( !bf.pieces.len ) {
+    auto piece = AddBack( bf.pieces );
+    piece->start = 0;
+    piece->nlines = bf.nlines_orig;
+    piece->added = 0;
+    bf.nlines = bf.nlines_orig;
+    bf.piece_cache_idx = 0;
+    bf.piece_cache_y0 = 0;
+  }
+}
+
+// makes sure a piece starts at y, and returns its index. returns pieces.len for y == nlines.
+// leaves the piece cache on the returned index.
+Inl idx_t
+_BigfileSplitAt( bigfile_t& bf, u64 y )
+{
+  u64 y0;
+  auto i = _BigfileFindPiece( bf, y, &y0 );
+  if( y == y0 ) {
+    return i;
+  }
+  AssertCrash( i < bf.pieces.len );
+  auto piece = bf.pieces.mem + i;
+  auto split = y - y0;
+  bigfile_piece_t right;
+  right.start = piece->start + split;
+  right.nlines = piece->nlines - split;
+  right.added = piece->added;
+  piece->nlines = split;
+  *AddAt( bf.pieces, i + 1 ) = right;
+  bf.piece_cache_idx = i + 1;
+  bf.piece_cache_y0 = y;
+  return i + 1;
+}
+
+Inl u64
+_BigfileAddLine( bigfile_t& bf, u8* mem, idx_t len )
+{
+  auto line = AddBack( bf.added );
+  line->mem = 0;
+  line->len = len;
+  if( len ) {
+    line->mem = AddPagelist( bf.added_mem, u8, 1, len );
+    Memmove( line->mem, mem, len );
+  }
+  return bf.added.len - 1;
+}
+
+// puts a single added line y at piece idx, extending the previous piece when it's the added line right before.
+// that way typing in a run of new lines stays one piece.
+// pieces before idx have to be untouched since _BigfileSplitAt( y ) returned idx; we leave the piece cache valid.
+Inl void
+_BigfilePutAddedLine( bigfile_t& bf, idx_t idx, u64 y, u64 added_idx )
+{
+  if( idx ) {
+    auto prev = bf.pieces.mem + idx - 1;
+    if( prev->added  &&  prev->start + prev->nlines == added_idx ) {
+      prev->nlines += 1;
+      bf.piece_cache_idx = idx - 1;
+      bf.piece_cache_y0 = y + 1 - prev->nlines;
+      return;
+    }
+  }
+  auto piece = AddAt( bf.pieces, idx );
+  piece->start = added_idx;
+  piece->nlines = 1;
+  piece->added = 1;
+  bf.piece_cache_idx = idx;
+  bf.piece_cache_y0 = y;
+}
+
+Inl void
+BigfileInsertLine( bigfile_t& bf, u64 y, u8* mem, idx_t len )
+{
+  _BigfileInitPieces( bf );
+  AssertCrash( y <= bf.nlines );
+  auto added_idx = _BigfileAddLine( bf, mem, len );
+  auto idx = _BigfileSplitAt( bf, y );
+  _BigfilePutAddedLine( bf, idx, y, added_idx );
+  bf.nlines += 1;
+  bf.unsaved = 1;
+}
+
+Inl void
+BigfileReplaceLine( bigfile_t& bf, u64 y, u8* mem, idx_t len )
+{
+  _BigfileInitPieces( bf );
+  AssertCrash( y < bf.nlines );
+  auto added_idx = _BigfileAddLine( bf, mem, len );
+  auto idx = _BigfileSplitAt( bf, y );
+  _BigfileSplitAt( bf, y + 1 );
+  RemAt( bf.pieces, idx );
+  _BigfilePutAddedLine( bf, idx, y, added_idx );
+  bf.unsaved = 1;
+}
+
+// like buf_t, there's always at least one line; removing the last one just empties it.
+Inl void
+BigfileRemoveLine( bigfile_t& bf, u64 y )
+{
+  _BigfileInitPieces( bf );
+  AssertCrash( y < bf.nlines );
+  if( bf.nlines == 1 ) {
+    BigfileReplaceLine( bf, 0, 0, 0 );
+    return;
+  }
+  auto idx = _BigfileSplitAt( bf, y );
+  _BigfileSplitAt( bf, y + 1 );
+  RemAt( bf.pieces, idx );
+  bf.piece_cache_idx = idx;
+  bf.piece_cache_y0 = y;
+  bf.nlines -= 1;
+  bf.unsaved = 1;
+}
+
+// =================================================================================
+// FIND
+//
+
+Enumc( bigfile_findresult_t )
+{
+  found,
+  notfound, // hit the end of the file.
+  budget, // ran out of lines to look at this call; call again to continue from y, x.
+};
+
+// searches forward from inline offset x of line y, looking at no more than max_lines lines.
+// advances y, x as it goes, so callers can spread a big search over many frames.
+Inl bigfile_findresult_t
+BigfileFindR(
+  bigfile_t& bf,
+  u64* y,
+  idx_t* x,
+  u8* key,
+  idx_t key_len,
+  bool case_sens,
+  bool word_boundary,
+  u64 max_lines
+  )
+{
+  auto nlines = BigfileNLines( bf );
+  For( i, 0, max_lines ) {
+    if( *y >= nlines ) {
+      auto more_coming = !bf.pieces.len  &&  !bf.index_done  &&  !bf.index_failed;
+      return more_coming  ?  bigfile_findresult_t::budget  :  bigfile_findresult_t::notfound;
+    }
+    auto line = BigfileLine( bf, *y );
+    idx_t found_x;
+    if( *x <= line.len  &&  StringSearch( &found_x, ML( line ), *x, key, key_len, case_sens, word_boundary ) ) {
+      *x = found_x;
+      return bigfile_findresult_t::found;
+    }
+    *y += 1;
+    *x = 0;
+  }
+  return bigfile_findresult_t::budget;
+}
+
+// =================================================================================
+// SAVE
+//
+
+Inl void
+_BigfileSaveFlush( file_t& file, string_t& chunk, idx_t* chunk_len )
+{
+  if( *chunk_len ) {
+    FileWriteAppend( file, chunk.mem, *chunk_len );
+    *chunk_len = 0;
+  }
+}
+
+Inl void
+_BigfileSaveWrite( file_t& file, string_t& chunk, idx_t* chunk_len, u64* total, u8* mem, idx_t len )
+{
+  *total += len;
+  if( *chunk_len + len > chunk.len ) {
+    _BigfileSaveFlush( file, chunk, chunk_len );
+  }
+  if( len > chunk.len ) {
+    FileWriteAppend( file, mem, len );
+    return;
+  }
+  Memmove( chunk.mem + *chunk_len, mem, len );
+  *chunk_len += len;
+}
+
+// writes the pieces out to a temp file, and then replaces the original with it.
+// original line ranges keep their own eols; we only write eoltype between pieces and after added lines.
+// on success, the bigfile is reopened on the saved file, which starts a fresh index.
+// on failure, the original is left as it was, and so are our edits, so the caller can retry.
+Inl bool
+BigfileSave( bigfile_t& bf )
+{
+  if( !BigfileCanEdit( bf ) ) {
+    return 0;
+  }
+  _BigfileInitPieces( bf );
+
+  auto tmpname = bf.filename;
+  AddBackCStr( &tmpname, ".bigfile_save" );
+  auto file = FileOpen( ML( tmpname ), fileopen_t::always, fileop_t::W, fileop_t::none );
+  if( !file.loaded ) {
+    return 0;
+  }
+  FileSetEOF( file, 0 );
+
+  auto eol = EolString( bf.eoltype );
+  auto chunk = AllocString<u8>( c_bigfile_save_chunk );
+  idx_t chunk_len = 0;
+  u64 total = 0;
+  bool written = 1;
+  FORLEN( piece, i, bf.pieces )
+    auto last_piece = i + 1 == bf.pieces.len;
+    if( piece->added ) {
+      For( j, 0, piece->nlines ) {
+        auto line = bf.added.mem + piece->start + j;
+        _BigfileSaveWrite( file, chunk, &chunk_len, &total, ML( *line ) );
+        if( !last_piece  ||  j + 1 < piece->nlines ) {
+          _BigfileSaveWrite( file, chunk, &chunk_len, &total, ML( eol ) );
+        }
+      }
+    }
+    else {
+      auto start = _BigfileOrigLineOffset( bf, piece->start );
+      auto y_last = piece->start + piece->nlines - 1;
+      u64 end = bf.mapping.size;
+      if( y_last + 1 < bf.nlines_orig ) {
+        u64 next;
+        _BigfileLineEnd( bf, _BigfileOrigLineOffset( bf, y_last ), &end, &next );
+      }
+      auto pos = start;
+      while( pos < end ) {
+        idx_t avail;
+        auto mem = _BigfileView( bf, pos, &avail );
+        if( !mem ) {
+          written = 0;
+          break;
+        }
+        auto n = Cast( idx_t, MIN( Cast( u64, avail ), end - pos ) );
+        _BigfileSaveWrite( file, chunk, &chunk_len, &total, mem, n );
+        pos += n;
+      }
+      if( !last_piece ) {
+        _BigfileSaveWrite( file, chunk, &chunk_len, &total, ML( eol ) );
+      }
+    }
+  }
+  _BigfileSaveFlush( file, chunk, &chunk_len );
+  written &= file.size == total;
+  Free( chunk );
+  FileFree( file );
+  if( !written ) {
+    FileDelete( ML( tmpname ) );
+    return 0;
+  }
+
+  // our views of the original have to go before we can replace it, but we keep the pieces until that works.
+  _BigfileUnmap( bf );
+  if( !FileMoveOverwrite( ML( bf.filename ), ML( tmpname ) ) ) {
+    FileDelete( ML( tmpname ) );
+    // the original is unchanged, so the index and the pieces still describe it.
+    bf.mapping = FileOpenMappedWindowedExistingReadShareRead( ML( bf.filename ) );
+    bf.index_cancel = 0;
+    if( !bf.mapping.loaded  ||  bf.mapping.size != bf.bytes_indexed ) {
+      AssertWarn( 0 );
+      bf.index_failed = 1;
+    }
+    return 0;
+  }
+
+  auto filename = bf.filename;
+  auto window_step = bf.window_step;
+  Kill( bf );
+  BigfileOpen( bf, ML( filename ), window_step );
+  return 1;
+}
+
+
+
+RegisterTest([]()
+{
+  // small windows, so lines straddle window boundaries, and the index and line lookups cross many windows.
+  fsobj_t name;
+  FsGetCwd( name );
+  AddBackCStr( &name, "/bigfile_test.txt" );
+  auto window_step = c_filemapped_granularity;
+
+  rng_xorshift32_t rng;
+  Init( rng, 1234 );
+  stack_resizeable_cont_t<u8> contents;
+  Alloc( contents, 1024*1024 );
+  slice_t eols[] = { SliceFromCStr( "\r\n" ), SliceFromCStr( "\n" ), SliceFromCStr( "\r" ) };
+  For( i, 0, 20000 ) {
+    auto len = Rand32( rng ) % 120;
+    if( i % 5000 == 7 ) {
+      len = 3 * window_step; // longer than a window, so it gets truncated.
+    }
+    For( j, 0, len ) {
+      *AddBack( contents ) = Cast( u8, 'a' + ( i + j ) % 26 );
+    }
+    AddBackContents( &contents, eols[ Rand32( rng ) % _countof( eols ) ] );
+  }
+  AddBackCStr( &contents, "last line" );
+
+  auto WriteFile = [&]( slice_t data )
+  {
+    auto file = FileOpen( ML( name ), fileopen_t::always, fileop_t::W, fileop_t::none );
+    AssertCrash( file.loaded );
+    FileSetEOF( file, 0 );
+    FileWriteAppend( file, ML( data ) );
+    FileFree( file );
+  };
+  WriteFile( SliceFromArray( contents ) );
+
+  // the model we check against.
+  stack_resizeable_cont_t<slice32_t> lines;
+  Alloc( lines, 1024 );
+  SplitIntoLines( &lines, ML( contents ) );
+
+  bigfile_t bf;
+  AssertCrash( BigfileOpen( bf, ML( name ), window_step ) );
+  while( !bf.index_done ) {
+    _mm_pause();
+  }
+  AssertCrash( !bf.index_failed );
+  AssertCrash( BigfileNLines( bf ) == lines.len );
+
+  auto CheckLines = [&]()
+  {
+    AssertCrash( BigfileNLines( bf ) == lines.len );
+    For( y, 0, lines.len ) {
+      auto line = BigfileLine( bf, y );
+      auto expected = lines.mem[y];
+      auto expected_len = MIN( Cast( idx_t, expected.len ), window_step );
+      AssertCrash( line.len == expected_len );
+      AssertCrash( MemEqual( line.mem, expected.mem, expected_len ) );
+    }
+    // random access too, which goes through the index instead of the sequential cache.
+    For( i, 0, 200 ) {
+      auto y = Rand32( rng ) % lines.len;
+      auto line = BigfileLine( bf, y );
+      AssertCrash( line.len == MIN( Cast( idx_t, lines.mem[y].len ), window_step ) );
+    }
+  };
+  CheckLines();
+
+  {
+    u64 y = 0;
+    idx_t x = 0;
+    auto key = Str( "last line" );
+    auto result = bigfile_findresult_t::budget;
+    while( result == bigfile_findresult_t::budget ) {
+      result = BigfileFindR( bf, &y, &x, key, CstrLength( key ), 1, 0, 1000 );
+    }
+    AssertCrash( result == bigfile_findresult_t::found );
+    AssertCrash( y == lines.len - 1 );
+    AssertCrash( x == 0 );
+  }
+
+  // edits against the model. the model's line contents have to outlive the edits, so keep them in a pagelist.
+  // every other edit goes right after the last one, like typing, which keeps extending the same added piece.
+  pagelist_t mem;
+  Init( mem, 4096 );
+  u64 y_next = 0;
+  For( i, 0, 500 ) {
+    auto y = ( i % 2  &&  y_next < lines.len )  ?  y_next  :  Rand32( rng ) % lines.len;
+    auto r = Rand32( rng ) % 3;
+    auto len = Rand32( rng ) % 20;
+    auto text = AddPagelist( mem, u8, 1, len + 1 );
+    For( j, 0, len ) {
+      text[j] = Cast( u8, '0' + ( i + j ) % 10 );
+    }
+    slice32_t line = { text, Cast( u32, len ) };
+    if( r == 0 ) {
+      BigfileInsertLine( bf, y, text, len );
+      *AddAt( lines, y ) = line;
+    }
+    elif( r == 1 ) {
+      BigfileReplaceLine( bf, y, text, len );
+      lines.mem[y] = line;
+    }
+    elif( lines.len > 1 ) {
+      BigfileRemoveLine( bf, y );
+      RemAt( lines, y );
+    }
+    y_next = y + 1;
+
+    // lookups right around the edit walk the piece cache it left behind.
+    auto y0 = y  ?  y - 1  :  0;
+    For( y1, y0, MIN( y + 2, lines.len ) ) {
+      auto line = BigfileLine( bf, y1 );
+      AssertCrash( line.len == MIN( Cast( idx_t, lines.mem[y1].len ), window_step ) );
+    }
+  }
+  CheckLines();
+
+  // long lines get truncated in the view, but save has to write them in full.
+  AssertCrash( BigfileSave( bf ) );
+  while( !bf.index_done ) {
+    _mm_pause();
+  }
+  AssertCrash( BigfileNLines( bf ) == lines.len );
+
+  auto file = FileOpen( ML( name ), fileopen_t::only_existing, fileop_t::R, fileop_t::R );
+  AssertCrash( file.loaded );
+  auto saved = FileAlloc( file );
+  FileFree( file );
+
+  // original line ranges keep their own eols, so compare line contents rather than bytes.
+  stack_resizeable_cont_t<slice32_t> saved_lines;
+  Alloc( saved_lines, 1024 );
+  SplitIntoLines( &saved_lines, ML( saved ) );
+  AssertCrash( saved_lines.len == lines.len );
+  For( y, 0, lines.len ) {
+    AssertCrash( saved_lines.mem[y].len == lines.mem[y].len );
+    AssertCrash( MemEqual( saved_lines.mem[y].mem, lines.mem[y].mem, lines.mem[y].len ) );
+  }
+
+  Kill( bf );
+  FileDelete( ML( name ) );
+  Free( saved );
+  Free( saved_lines );
+  Kill( mem );
+  Free( lines );
+  Free( contents );
+});
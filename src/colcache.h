@@ -0,0 +1,659 @@
+// Copyright (c) John A. Carlos Jr., all rights reserved.
+
+// persistent columnar cache for parsed csv tables, so we only parse a csv when it changes.
+//
+// on-disk format, native-endian, with each section 8-byte aligned:
+//   colcache_header_t
+//   colcache_column_t[ ncolumns ]
+//   names: the source filename, then the column names referenced by colcache_column_t.
+//   column data, referenced by colcache_column_t, each 64-byte aligned.
+// we load it with FileOpenMappedExistingReadShareRead, so raw columns get handed out as tslice_t<f64> straight from the mapping.
+// encoded columns get decoded into one allocation on load.
+//
+// column encodings:
+//   raw: nrows f64s.
+//   decimal: every value is exactly n / 10^scale for some integer n, like prices and dates usually are.
+//     we store the integers as zigzag varint deltas. decoding divides by the same exact power of ten ParseNumeric
+//     uses, and we check every value round-trips bit for bit before choosing this.
+//   xorprev: each value's bits xor'd with the previous value's, stored as a control byte holding the number of
+//     leading and trailing zero bytes, then the bytes in between.
+//
+// a cache is keyed by its source filename, size and last-write time; any mismatch means reparse.
+//
+
+constant u64 c_colcache_magic = 0x31484341434C4F43ULL; // "COLCACH1"
+constant u32 c_colcache_version = 1;
+
+constant u8 c_colcache_numeric = 1u << 0;
+constant u8 c_colcache_datetime = 1u << 1;
+constant u8 c_colcache_mixed_string_numeric = 1u << 2;
+constant u8 c_colcache_all_usd = 1u << 3;
+
+constant f64 c_colcache_pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+Enumc( colcache_encoding_t )
+{
+  raw,
+  decimal,
+  xorprev,
+  COUNT
+};
+
+struct
+colcache_header_t
+{
+  u64 magic;
+  u32 version;
+  u32 ncolumns;
+  u64 nrows;
+  u64 source_size;
+  u64 source_time;
+  u64 source_name_len; // at the start of the names.
+  u64 offset_columns;
+  u64 offset_names;
+  u64 offset_data;
+  u64 size;
+};
+
+struct
+colcache_column_t
+{
+  u64 name_offset;
+  u32 name_len;
+  u8 encoding; // colcache_encoding_t
+  u8 scale; // for decimal.
+  u8 flags; // c_colcache_*
+  u8 unused;
+  u64 data_offset; // relative to offset_data.
+  u64 data_len;
+};
+
+struct
+colcache_t
+{
+  filemapped_t file; // owns the memory everything below points into, except decoded.
+  colcache_header_t* header;
+  colcache_column_t* columns;
+  tstring_t<slice_t> names; // per column, pointing into file.
+  tstring_t<tslice_t<f64>> values; // per column; raw ones point into file, so they're read-only when mapped.
+  tstring_t<f64> decoded; // the non-raw columns.
+};
+
+Inl void
+Zero( colcache_t& cache )
+{
+  cache.file = {};
+  cache.header = 0;
+  cache.columns = 0;
+  cache.names = {};
+  cache.values = {};
+  cache.decoded = {};
+}
+
+Inl void
+Free( colcache_t& cache )
+{
+  if( cache.names.mem ) {
+    Free( cache.names );
+  }
+  if( cache.values.mem ) {
+    Free( cache.values );
+  }
+  if( cache.decoded.mem ) {
+    Free( cache.decoded );
+  }
+  FileFree( cache.file );
+  Zero( cache );
+}
+
+Inl u64
+_ColCacheZigzag( s64 x )
+{
+  return ( Cast( u64, x ) << 1 ) ^ Cast( u64, x >> 63 );
+}
+
+Inl s64
+_ColCacheUnzigzag( u64 x )
+{
+  return Cast( s64, x >> 1 ) ^ -Cast( s64, x & 1 );
+}
+
+Inl void
+_ColCachePutVarint( stack_resizeable_cont_t<u8>& dst, u64 value )
+{
+  while( value >= 0x80 ) {
+    *AddBack( dst ) = Cast( u8, value | 0x80 );
+    value >>= 7;
+  }
+  *AddBack( dst ) = Cast( u8, value );
+}
+
+// returns 0 if the encoding runs off the end.
+Inl bool
+_ColCacheGetVarint( u8** psrc, u8* end, u64* value )
+{
+  auto src = *psrc;
+  u64 r = 0;
+  for( u32 shift = 0;  shift < 64;  shift += 7 ) {
+    if( src == end ) {
+      return 0;
+    }
+    auto b = *src++;
+    r |= Cast( u64, b & 0x7F ) << shift;
+    if( !( b & 0x80 ) ) {
+      *value = r;
+      *psrc = src;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// the smallest scale where every value is exactly some integer over 10^scale.
+// the integers have to fit in an f64 mantissa, for the divide to be correctly rounded.
+Inl bool
+_ColCacheDecimalScale( tslice_t<f64> values, u8* scale )
+{
+  constant f64 max_integer = 9007199254740992.0; // 2^53
+  For( s, 0, _countof( c_colcache_pow10 ) ) {
+    auto pow10 = c_colcache_pow10[s];
+    bool exact = 1;
+    ForLen( i, values ) {
+      auto value = values.mem[i];
+      auto scaled = value * pow10;
+      // written this way so nans fail too.
+      if( !( -max_integer < scaled  &&  scaled < max_integer ) ) {
+        exact = 0;
+        break;
+      }
+      auto n = Cast( s64, scaled + ( scaled < 0  ?  -0.5  :  0.5 ) );
+      auto roundtrip = Cast( f64, n ) / pow10;
+      if( !MemEqual( &roundtrip, &value, sizeof( f64 ) ) ) {
+        exact = 0;
+        break;
+      }
+    }
+    if( exact ) {
+      *scale = Cast( u8, s );
+      return 1;
+    }
+  }
+  return 0;
+}
+
+Inl void
+_ColCacheEncodeDecimal( stack_resizeable_cont_t<u8>& dst, tslice_t<f64> values, u8 scale )
+{
+  auto pow10 = c_colcache_pow10[scale];
+  s64 prev = 0;
+  ForLen( i, values ) {
+    auto scaled = values.mem[i] * pow10;
+    auto n = Cast( s64, scaled + ( scaled < 0  ?  -0.5  :  0.5 ) );
+    _ColCachePutVarint( dst, _ColCacheZigzag( n - prev ) );
+    prev = n;
+  }
+}
+
+Inl bool
+_ColCacheDecodeDecimal( u8* src, u8* end, u8 scale, tslice_t<f64> values )
+{
+  auto pow10 = c_colcache_pow10[scale];
+  s64 n = 0;
+  ForLen( i, values ) {
+    u64 delta;
+    if( !_ColCacheGetVarint( &src, end, &delta ) ) {
+      return 0;
+    }
+    // wrapping, since corrupt deltas can overflow.
+    n = Cast( s64, Cast( u64, n ) + Cast( u64, _ColCacheUnzigzag( delta ) ) );
+    values.mem[i] = Cast( f64, n ) / pow10;
+  }
+  return src == end;
+}
+
+Inl void
+_ColCacheEncodeXorprev( stack_resizeable_cont_t<u8>& dst, tslice_t<f64> values )
+{
+  u64 prev = 0;
+  ForLen( i, values ) {
+    u64 bits;
+    Memmove( &bits, values.mem + i, sizeof( u64 ) );
+    auto x = bits ^ prev;
+    prev = bits;
+    auto nleading = Cast( u32, _lzcnt_u64( x ) / 8 );
+    auto ntrailing = x  ?  Cast( u32, _tzcnt_u64( x ) / 8 )  :  0;
+    *AddBack( dst ) = Cast( u8, ( nleading << 4 ) | ntrailing );
+    x >>= 8 * ntrailing;
+    For( b, 0, 8 - nleading - ntrailing ) {
+      *AddBack( dst ) = Cast( u8, x );
+      x >>= 8;
+    }
+  }
+}
+
+Inl bool
+_ColCacheDecodeXorprev( u8* src, u8* end, tslice_t<f64> values )
+{
+  u64 prev = 0;
+  ForLen( i, values ) {
+    if( src == end ) {
+      return 0;
+    }
+    auto control = *src++;
+    u32 nleading = control >> 4;
+    u32 ntrailing = control & 0xF;
+    if( nleading + ntrailing > 8 ) {
+      return 0;
+    }
+    auto nbytes = 8 - nleading - ntrailing;
+    if( Cast( idx_t, end - src ) < nbytes ) {
+      return 0;
+    }
+    u64 x = 0;
+    For( b, 0, nbytes ) {
+      x |= Cast( u64, src[b] ) << ( 8 * b );
+    }
+    src += nbytes;
+    if( nbytes ) {
+      x <<= 8 * ntrailing;
+    }
+    prev ^= x;
+    Memmove( values.mem + i, &prev, sizeof( u64 ) );
+  }
+  return src == end;
+}
+
+// takes ownership of file, and checks everything we'll later index with.
+// on failure, the cache is left empty and file is freed.
+Inl bool
+ColCacheAttach(
+  colcache_t& cache,
+  filemapped_t& file,
+  slice_t source_name,
+  u64 source_size,
+  u64 source_time
+  )
+{
+  Zero( cache );
+  cache.file = file;
+  file = {};
+
+  auto mem = cache.file.mapped_mem;
+  auto len = cache.file.size;
+  auto header = Cast( colcache_header_t*, mem );
+  bool valid =
+    len >= sizeof( colcache_header_t )  &&
+    !( Cast( idx_t, mem ) & 7 )  &&
+    header->magic == c_colcache_magic  &&
+    header->version == c_colcache_version  &&
+    header->size == len  &&
+    header->source_size == source_size  &&
+    header->source_time == source_time  &&
+    header->nrows <= MAX_u32  &&
+    header->offset_columns <= header->offset_names  &&
+    header->offset_names <= header->offset_data  &&
+    header->offset_data <= len  &&
+    header->offset_columns + header->ncolumns * sizeof( colcache_column_t ) <= header->offset_names  &&
+    header->source_name_len <= header->offset_data - header->offset_names  &&
+    EqualContents( source_name, slice_t{ mem + header->offset_names, Cast( idx_t, header->source_name_len ) } );
+  if( !valid ) {
+    Free( cache );
+    return 0;
+  }
+
+  cache.header = header;
+  cache.columns = Cast( colcache_column_t*, mem + header->offset_columns );
+  auto names = mem + header->offset_names;
+  auto data = mem + header->offset_data;
+  auto names_len = header->offset_data - header->offset_names;
+  auto data_len = len - header->offset_data;
+  auto ncolumns = header->ncolumns;
+  auto nrows = Cast( idx_t, header->nrows );
+
+  idx_t ndecoded = 0;
+  For( x, 0, ncolumns ) {
+    auto column = cache.columns + x;
+    bool column_valid =
+      column->name_offset + column->name_len <= names_len  &&
+      column->encoding < Cast( u8, colcache_encoding_t::COUNT )  &&
+      column->scale < _countof( c_colcache_pow10 )  &&
+      column->data_offset <= data_len  &&
+      column->data_len <= data_len - column->data_offset;
+    if( column_valid  &&  column->encoding == Cast( u8, colcache_encoding_t::raw ) ) {
+      column_valid =
+        column->data_len == nrows * sizeof( f64 )  &&
+        !( Cast( idx_t, data + column->data_offset ) & 7 );
+    }
+    if( !column_valid ) {
+      Free( cache );
+      return 0;
+    }
+    ndecoded += column->encoding != Cast( u8, colcache_encoding_t::raw );
+  }
+
+  cache.names = AllocString<slice_t>( ncolumns );
+  For( x, 0, ncolumns ) {
+    auto column = cache.columns + x;
+    cache.names.mem[x] = { names + column->name_offset, column->name_len };
+  }
+  cache.values = AllocString<tslice_t<f64>>( ncolumns );
+  if( ndecoded ) {
+    cache.decoded = AllocString<f64>( ndecoded * nrows );
+  }
+  auto decoded = cache.decoded.mem;
+  For( x, 0, ncolumns ) {
+    auto column = cache.columns + x;
+    auto src = data + column->data_offset;
+    auto end = src + column->data_len;
+    auto values = cache.values.mem + x;
+    bool decoded_ok = 1;
+    switch( Cast( colcache_encoding_t, column->encoding ) ) {
+      case colcache_encoding_t::raw: {
+        *values = { Cast( f64*, src ), nrows };
+      } break;
+      case colcache_encoding_t::decimal: {
+        *values = { decoded, nrows };
+        decoded += nrows;
+        decoded_ok = _ColCacheDecodeDecimal( src, end, column->scale, *values );
+      } break;
+      case colcache_encoding_t::xorprev: {
+        *values = { decoded, nrows };
+        decoded += nrows;
+        decoded_ok = _ColCacheDecodeXorprev( src, end, *values );
+      } break;
+      default: UnreachableCrash();
+    }
+    if( !decoded_ok ) {
+      Free( cache );
+      return 0;
+    }
+  }
+  return 1;
+}
+
+Inl bool
+ColCacheLoad(
+  colcache_t& cache,
+  u8* filename,
+  idx_t filename_len,
+  slice_t source_name,
+  u64 source_size,
+  u64 source_time
+  )
+{
+  auto file = FileOpenMappedExistingReadShareRead( filename, filename_len );
+  if( !file.loaded ) {
+    Zero( cache );
+    return 0;
+  }
+  return ColCacheAttach( cache, file, source_name, source_size, source_time );
+}
+
+// where we keep the cache for a given source file: next to the exe, keyed by a hash of the source filename.
+Inl fsobj_t
+ColCacheFilename( u8* source_name, idx_t source_name_len )
+{
+  fsobj_t r = FsGetExe();
+  auto last_slash = StringScanL( ML( r ), '/' );
+  r.len = last_slash  ?  ( last_slash - r.mem + 1 )  :  0;
+  u8 tmp[64];
+  auto tmp_len = sprintf( Cast( char*, tmp ), "colcache/%016llx.columns", Cast( unsigned long long, StringHash( source_name, source_name_len ) ) );
+  Memmove( AddBack( r, tmp_len ), tmp, tmp_len );
+  r.mem[r.len] = 0;
+  return r;
+}
+
+// builds the cache contents in memory. names, values and flags are per column; flags are c_colcache_*.
+// with compress, each column gets whichever encoding is smallest; otherwise they're all raw.
+Inl string_t
+ColCacheEncode(
+  slice_t source_name,
+  u64 source_size,
+  u64 source_time,
+  idx_t nrows,
+  tslice_t<slice_t> names,
+  tslice_t<tslice_t<f64>> values,
+  tslice_t<u8> flags,
+  bool compress
+  )
+{
+  auto ncolumns = names.len;
+  AssertCrash( values.len == ncolumns );
+  AssertCrash( flags.len == ncolumns );
+  AssertCrash( ncolumns <= MAX_u32 );
+
+  // encode everything up front, so we know the section sizes.
+  stack_resizeable_cont_t<u8> encoded;
+  Alloc( encoded, compress  ?  ncolumns * nrows * 2  :  0 );
+  stack_resizeable_cont_t<u8> candidate;
+  Alloc( candidate, compress  ?  nrows * 2  :  0 );
+  auto encodings = AllocString<colcache_encoding_t>( ncolumns );
+  auto scales = AllocString<u8>( ncolumns );
+  auto encoded_offsets = AllocString<idx_t>( ncolumns + 1 );
+  For( x, 0, ncolumns ) {
+    auto column = values.mem[x];
+    AssertCrash( column.len == nrows );
+    encodings.mem[x] = colcache_encoding_t::raw;
+    scales.mem[x] = 0;
+    encoded_offsets.mem[x] = encoded.len;
+    if( compress ) {
+      auto best = nrows * sizeof( f64 );
+      u8 scale;
+      if( _ColCacheDecimalScale( column, &scale ) ) {
+        candidate.len = 0;
+        _ColCacheEncodeDecimal( candidate, column, scale );
+        if( candidate.len < best ) {
+          best = candidate.len;
+          encodings.mem[x] = colcache_encoding_t::decimal;
+          scales.mem[x] = scale;
+          encoded.len = encoded_offsets.mem[x];
+          Memmove( AddBack( encoded, candidate.len ), ML( candidate ) );
+        }
+      }
+      candidate.len = 0;
+      _ColCacheEncodeXorprev( candidate, column );
+      if( candidate.len < best ) {
+        best = candidate.len;
+        encodings.mem[x] = colcache_encoding_t::xorprev;
+        scales.mem[x] = 0;
+        encoded.len = encoded_offsets.mem[x];
+        Memmove( AddBack( encoded, candidate.len ), ML( candidate ) );
+      }
+    }
+  }
+  encoded_offsets.mem[ncolumns] = encoded.len;
+  Free( candidate );
+
+  idx_t names_len = source_name.len;
+  ForLen( x, names ) {
+    names_len += names.mem[x].len;
+  }
+  idx_t data_len = 0;
+  For( x, 0, ncolumns ) {
+    data_len = RoundUpToMultipleOfPowerOf2( data_len, 64 );
+    data_len += ( encodings.mem[x] == colcache_encoding_t::raw )  ?
+      nrows * sizeof( f64 )  :
+      encoded_offsets.mem[x + 1] - encoded_offsets.mem[x];
+  }
+
+  colcache_header_t header;
+  header.magic = c_colcache_magic;
+  header.version = c_colcache_version;
+  header.ncolumns = Cast( u32, ncolumns );
+  header.nrows = nrows;
+  header.source_size = source_size;
+  header.source_time = source_time;
+  header.source_name_len = source_name.len;
+  header.offset_columns = RoundUpToMultipleOfPowerOf2( sizeof( colcache_header_t ), 8 );
+  header.offset_names = RoundUpToMultipleOfPowerOf2( header.offset_columns + ncolumns * sizeof( colcache_column_t ), 8 );
+  header.offset_data = RoundUpToMultipleOfPowerOf2( header.offset_names + names_len, 64 );
+  header.size = header.offset_data + data_len;
+
+  auto result = AllocString<u8>( Cast( idx_t, header.size ) );
+  Memzero( result.mem, Cast( idx_t, header.size ) );
+  Memmove( result.mem, &header, sizeof( header ) );
+  auto columns = Cast( colcache_column_t*, result.mem + header.offset_columns );
+  auto names_dst = result.mem + header.offset_names;
+  auto data_dst = result.mem + header.offset_data;
+  Memmove( names_dst, ML( source_name ) );
+  u64 name_offset = source_name.len;
+  u64 data_offset = 0;
+  For( x, 0, ncolumns ) {
+    auto column = columns + x;
+    auto name = names.mem[x];
+    AssertCrash( name.len <= MAX_u32 );
+    column->name_offset = name_offset;
+    column->name_len = Cast( u32, name.len );
+    Memmove( names_dst + name_offset, ML( name ) );
+    name_offset += name.len;
+
+    column->encoding = Cast( u8, encodings.mem[x] );
+    column->scale = scales.mem[x];
+    column->flags = flags.mem[x];
+    data_offset = RoundUpToMultipleOfPowerOf2( data_offset, 64 );
+    column->data_offset = data_offset;
+    if( encodings.mem[x] == colcache_encoding_t::raw ) {
+      column->data_len = nrows * sizeof( f64 );
+      Memmove( data_dst + data_offset, values.mem[x].mem, Cast( idx_t, column->data_len ) );
+    }
+    else {
+      column->data_len = encoded_offsets.mem[x + 1] - encoded_offsets.mem[x];
+      Memmove( data_dst + data_offset, encoded.mem + encoded_offsets.mem[x], Cast( idx_t, column->data_len ) );
+    }
+    data_offset += column->data_len;
+  }
+
+  Free( encoded_offsets );
+  Free( scales );
+  Free( encodings );
+  Free( encoded );
+  return result;
+}
+
+// a partially written cache fails validation on load, so we don't bother writing to a temporary first.
+Inl bool
+ColCacheWrite( u8* filename, idx_t filename_len, string_t& contents )
+{
+  auto file = FileOpen( filename, filename_len, fileopen_t::always, fileop_t::W, fileop_t::none );
+  if( !file.loaded ) {
+    return 0;
+  }
+  FileWrite( file, 0, ML( contents ) );
+  FileSetEOF( file, contents.len );
+  FileFree( file );
+  return 1;
+}
+
+
+
+RegisterTest([]()
+{
+  // round-trip columns of each encoding through an in-memory cache, and check we reject stale or broken ones.
+  // this bypasses the file writes, so it doesn't need the filesystem.
+  rng_xorshift32_t rng;
+  Init( rng, 1234 );
+  constant idx_t nrows = 1000;
+  constant idx_t ncolumns = 5;
+  auto storage = AllocString<f64>( nrows * ncolumns );
+  tslice_t<f64> values[ncolumns];
+  For( x, 0, ncolumns ) {
+    values[x] = { storage.mem + x * nrows, nrows };
+  }
+  f64 price = 100;
+  For( y, 0, nrows ) {
+    // dates, one day apart.
+    values[0].mem[y] = 1325376000.0 + 86400.0 * y;
+    // prices in cents, like ParseNumeric gives us.
+    price = MAX( 0.01, price + Cast( f64, Cast( s32, Rand32( rng ) % 201 ) - 100 ) / 100 );
+    values[1].mem[y] = Cast( f64, Cast( s64, price * 100 + 0.5 ) ) / 100;
+    // noise that doesn't compress.
+    u64 bits = ( Cast( u64, Rand32( rng ) ) << 32 ) | Rand32( rng );
+    Memmove( values[2].mem + y, &bits, sizeof( u64 ) );
+    // mostly-repeating values, for xorprev.
+    values[3].mem[y] = ( y / 10 ) * 0.1;
+    // negatives and zeros.
+    values[4].mem[y] = ( y % 3 )  ?  -Cast( f64, y )  :  0;
+  }
+  slice_t names[] = {
+    SliceFromCStr( "date" ), SliceFromCStr( "price" ), SliceFromCStr( "noise" ),
+    SliceFromCStr( "steps" ), SliceFromCStr( "signed" ),
+  };
+  u8 flags[] = {
+    c_colcache_numeric | c_colcache_datetime, c_colcache_numeric | c_colcache_all_usd, c_colcache_numeric,
+    c_colcache_numeric, c_colcache_mixed_string_numeric,
+  };
+  auto source_name = SliceFromCStr( "c:/data/test.csv" );
+
+  For( compress, 0, 2 ) {
+    auto contents = ColCacheEncode(
+      source_name, 1234, 5678, nrows,
+      SliceFromCArray( slice_t, names ), { values, ncolumns }, SliceFromCArray( u8, flags ),
+      Cast( bool, compress )
+      );
+    if( compress ) {
+      // dates and prices compress well, and noise stays raw.
+      auto columns = Cast( colcache_column_t*, contents.mem + sizeof( colcache_header_t ) );
+      AssertCrash( columns[0].encoding == Cast( u8, colcache_encoding_t::decimal )  &&  columns[0].scale == 0 );
+      AssertCrash( columns[1].encoding == Cast( u8, colcache_encoding_t::decimal )  &&  columns[1].scale == 2 );
+      AssertCrash( columns[2].encoding == Cast( u8, colcache_encoding_t::raw ) );
+      AssertCrash( columns[0].data_len < nrows * 4 );
+      AssertCrash( columns[1].data_len < nrows * 2 );
+    }
+
+    // a heap copy, like FileOpenMappedExistingReadShareRead makes of small files.
+    auto Attach = [&]( slice_t copy, slice_t name, u64 size, u64 time, colcache_t& cache )
+    {
+      filemapped_t file = {};
+      file.mapped_mem = copy.mem;
+      file.size = copy.len;
+      file.loaded = 1;
+      return ColCacheAttach( cache, file, name, size, time );
+    };
+    auto Copy = [&]()
+    {
+      slice_t r;
+      r.mem = MemHeapAlloc( u8, contents.len );
+      r.len = contents.len;
+      TMove( r.mem, ML( contents ) );
+      return r;
+    };
+
+    colcache_t cache;
+    AssertCrash( Attach( Copy(), source_name, 1234, 5678, cache ) );
+    AssertCrash( cache.header->ncolumns == ncolumns );
+    AssertCrash( cache.header->nrows == nrows );
+    For( x, 0, ncolumns ) {
+      AssertCrash( EqualContents( cache.names.mem[x], names[x] ) );
+      AssertCrash( cache.columns[x].flags == flags[x] );
+      AssertCrash( MemEqual( cache.values.mem[x].mem, values[x].mem, nrows * sizeof( f64 ) ) );
+    }
+    Free( cache );
+
+    // stale, or for some other file.
+    AssertCrash( !Attach( Copy(), source_name, 1235, 5678, cache ) );
+    AssertCrash( !Attach( Copy(), source_name, 1234, 5679, cache ) );
+    AssertCrash( !Attach( Copy(), SliceFromCStr( "c:/data/test2.csv" ), 1234, 5678, cache ) );
+
+    // truncated anywhere.
+    For( i, 0, 64 ) {
+      auto copy = Copy();
+      copy.len = Rand32( rng ) % contents.len;
+      AssertCrash( !Attach( copy, source_name, 1234, 5678, cache ) );
+    }
+
+    // corrupted encoded data either fails, or decodes to something; it mustn't read out of bounds.
+    if( compress ) {
+      auto header = Cast( colcache_header_t*, contents.mem );
+      For( i, 0, 64 ) {
+        auto copy = Copy();
+        auto pos = header->offset_data + Rand32( rng ) % ( copy.len - header->offset_data );
+        copy.mem[pos] ^= Cast( u8, 1 + Rand32( rng ) % 255 );
+        if( Attach( copy, source_name, 1234, 5678, cache ) ) {
+          Free( cache );
+        }
+      }
+    }
+    Free( contents );
+  }
+  Free( storage );
+});
@@ -192,19 +192,267 @@ CstrCopy( u8* dst, u8* src_start, u8* src_end )
 
 
 
-// C++ type inference for argument passing sucks ( esp. constants ), so we have to do this nonsense.
+// ============================================================================
+// SUBSTRING SEARCH
+//
+// the reference search is the obvious loop: StringEquals at every offset.
+// the fast search filters candidate offsets a whole vector at a time, by comparing the first and last key chars
+// against the src chars at those offsets. case-insensitive search folds case in the vector registers,
+// and word_boundary search applies the wordiness test to the whole candidate mask at once.
+// only offsets that survive all of that get a full StringEquals.
+// without vector support, long keys use boyer-moore-horspool instead, since its skip distance grows with the key
+// length. with vector support, the first/last filter measured faster even for long keys, so it's used for all of them.
+//
+// note the word_boundary test relies on the first/last src chars of a match having the same wordiness as the
+// first/last key chars, which holds since case-folding never changes wordiness.
+//
+
+#define AsciiFold( c, case_sens )   ( ( case_sens )  ?  ( c )  :  ToLowerAscii( c ) )
+
+// eliminate the fullstring match at i, if it fails the word_boundary test.
+// if we're searching "0123456789" for "234", the test is:
+//   keep-match <=> AsciiInWord( "1" ) != AsciiInWord( "2" ) && AsciiInWord( "4" ) != AsciiInWord( "5" )
+// i.e. the first and last chars in the match must have different "wordiness" than the chars outside.
+Inl bool
+StringWordBoundaryAt( u8* src, idx_t src_len, idx_t i, idx_t key_len )
+{
+  if( i > 0  &&  ( AsciiInWord( src[i - 1] ) == AsciiInWord( src[i] ) ) ) {
+    return 0;
+  }
+  if( i + key_len < src_len  &&  ( AsciiInWord( src[i + key_len - 1] ) == AsciiInWord( src[i + key_len] ) ) ) {
+    return 0;
+  }
+  return 1;
+}
 
-Templ Inl bool
-_StringIdxScanR( T* dst, u8* src, T src_len, T start, u8 key )
+Inl bool
+StringMatchAt( u8* src, idx_t src_len, idx_t i, u8* key, idx_t key_len, bool case_sens, bool word_boundary )
 {
-  Fori( T, i, start, src_len ) {
-    if( src[i] == key ) {
+  if( !StringEquals( src + i, MIN( src_len - i, key_len ), key, key_len, case_sens ) ) {
+    return 0;
+  }
+  return !word_boundary  ||  StringWordBoundaryAt( src, src_len, i, key_len );
+}
+
+// kept around as the correctness and speed baseline for the fast search.
+Inl bool
+StringSearchReference( idx_t* dst, u8* src, idx_t src_len, idx_t start, u8* key, idx_t key_len, bool case_sens, bool word_boundary )
+{
+  For( i, start, src_len ) {
+    if( StringMatchAt( src, src_len, i, key, key_len, case_sens, word_boundary ) ) {
+      *dst = i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+#if defined(__AVX2__)
+
+  #define STRINGSEARCH_SIMD 1
+  constant idx_t c_stringsearch_width = 32;
+  typedef __m256i strvec_t;
+
+  ForceInl strvec_t StrvecLoad( u8* src ) { return _mm256_loadu_si256( Cast( __m256i*, src ) ); }
+  ForceInl strvec_t StrvecSet( u8 c ) { return _mm256_set1_epi8( Cast( s8, c ) ); }
+  ForceInl u32 StrvecEqualMask( strvec_t a, strvec_t b ) { return Cast( u32, _mm256_movemask_epi8( _mm256_cmpeq_epi8( a, b ) ) ); }
+
+  // signed compares, so chars >= 0x80 are never in range.
+  ForceInl strvec_t
+  StrvecInRange( strvec_t v, u8 lo, u8 hi )
+  {
+    return _mm256_and_si256(
+      _mm256_cmpgt_epi8( v, StrvecSet( lo - 1 ) ),
+      _mm256_cmpgt_epi8( StrvecSet( hi + 1 ), v )
+      );
+  }
+  ForceInl strvec_t
+  StrvecToLowerAscii( strvec_t v )
+  {
+    return _mm256_or_si256( v, _mm256_and_si256( StrvecInRange( v, 'A', 'Z' ), StrvecSet( 0x20 ) ) );
+  }
+  ForceInl u32
+  StrvecInWordMask( strvec_t v )
+  {
+    auto alpha = StrvecInRange( _mm256_or_si256( v, StrvecSet( 0x20 ) ), 'a', 'z' );
+    auto number = StrvecInRange( v, '0', '9' );
+    auto underscore = _mm256_cmpeq_epi8( v, StrvecSet( '_' ) );
+    return Cast( u32, _mm256_movemask_epi8( _mm256_or_si256( _mm256_or_si256( alpha, number ), underscore ) ) );
+  }
+
+#elif defined(_M_AMD64) || defined(__SSE2__)
+
+  #define STRINGSEARCH_SIMD 1
+  constant idx_t c_stringsearch_width = 16;
+  typedef __m128i strvec_t;
+
+  ForceInl strvec_t StrvecLoad( u8* src ) { return _mm_loadu_si128( Cast( __m128i*, src ) ); }
+  ForceInl strvec_t StrvecSet( u8 c ) { return _mm_set1_epi8( Cast( s8, c ) ); }
+  ForceInl u32 StrvecEqualMask( strvec_t a, strvec_t b ) { return Cast( u32, _mm_movemask_epi8( _mm_cmpeq_epi8( a, b ) ) ); }
+
+  // signed compares, so chars >= 0x80 are never in range.
+  ForceInl strvec_t
+  StrvecInRange( strvec_t v, u8 lo, u8 hi )
+  {
+    return _mm_and_si128(
+      _mm_cmpgt_epi8( v, StrvecSet( lo - 1 ) ),
+      _mm_cmpgt_epi8( StrvecSet( hi + 1 ), v )
+      );
+  }
+  ForceInl strvec_t
+  StrvecToLowerAscii( strvec_t v )
+  {
+    return _mm_or_si128( v, _mm_and_si128( StrvecInRange( v, 'A', 'Z' ), StrvecSet( 0x20 ) ) );
+  }
+  ForceInl u32
+  StrvecInWordMask( strvec_t v )
+  {
+    auto alpha = StrvecInRange( _mm_or_si128( v, StrvecSet( 0x20 ) ), 'a', 'z' );
+    auto number = StrvecInRange( v, '0', '9' );
+    auto underscore = _mm_cmpeq_epi8( v, StrvecSet( '_' ) );
+    return Cast( u32, _mm_movemask_epi8( _mm_or_si128( _mm_or_si128( alpha, number ), underscore ) ) );
+  }
+
+#else
+
+  #define STRINGSEARCH_SIMD 0
+
+#endif
+
+// keys at least this long use boyer-moore-horspool, when we don't have the vector search.
+constant idx_t c_stringsearch_horspool_min_key_len = 32;
+
+// assumes start + key_len <= src_len.
+Inl bool
+StringSearchHorspool( idx_t* dst, u8* src, idx_t src_len, idx_t start, u8* key, idx_t key_len, bool case_sens, bool word_boundary )
+{
+  auto last = key_len - 1;
+  idx_t skip[256];
+  For( c, 0, 256 ) {
+    skip[c] = key_len;
+  }
+  For( k, 0, last ) {
+    skip[ AsciiFold( key[k], case_sens ) ] = last - k;
+  }
+  auto key_last = AsciiFold( key[last], case_sens );
+  idx_t i = start;
+  while( i + key_len <= src_len ) {
+    auto c = AsciiFold( src[i + last], case_sens );
+    if( c == key_last  &&
+        StringEquals( src + i, last, key, last, case_sens )  &&
+        ( !word_boundary  ||  StringWordBoundaryAt( src, src_len, i, key_len ) ) )
+    {
+      *dst = i;
+      return 1;
+    }
+    i += skip[c];
+  }
+  return 0;
+}
+
+// assumes start + key_len <= src_len.
+Inl bool
+StringSearchFirstLast( idx_t* dst, u8* src, idx_t src_len, idx_t start, u8* key, idx_t key_len, bool case_sens, bool word_boundary )
+{
+  idx_t i = start;
+
+#if STRINGSEARCH_SIMD
+  auto last = key_len - 1;
+
+  // the vector word_boundary test reads src[i - 1], so the match at 0 goes through the scalar test.
+  if( word_boundary  &&  !i ) {
+    if( StringMatchAt( src, src_len, 0, key, key_len, case_sens, word_boundary ) ) {
+      *dst = 0;
+      return 1;
+    }
+    i = 1;
+  }
+
+  auto first_in_word = AsciiInWord( key[0] );
+  auto last_in_word = AsciiInWord( key[last] );
+  auto key_first = StrvecSet( AsciiFold( key[0], case_sens ) );
+  auto key_last = StrvecSet( AsciiFold( key[last], case_sens ) );
+
+  // the furthest load is at i + last, or i + key_len for the char after the match when word_boundary.
+  auto load_extent = c_stringsearch_width + ( word_boundary  ?  key_len  :  last );
+  while( i + load_extent <= src_len ) {
+    auto block_first = StrvecLoad( src + i );
+    auto block_last = StrvecLoad( src + i + last );
+    if( !case_sens ) {
+      block_first = StrvecToLowerAscii( block_first );
+      block_last = StrvecToLowerAscii( block_last );
+    }
+    auto mask = StrvecEqualMask( block_first, key_first ) & StrvecEqualMask( block_last, key_last );
+    if( mask  &&  word_boundary ) {
+      auto in_word_prev = StrvecInWordMask( StrvecLoad( src + i - 1 ) );
+      auto in_word_next = StrvecInWordMask( StrvecLoad( src + i + key_len ) );
+      mask &= first_in_word  ?  ~in_word_prev  :  in_word_prev;
+      mask &= last_in_word  ?  ~in_word_next  :  in_word_next;
+    }
+    while( mask ) {
+      auto j = i + _tzcnt_u32( mask );
+      if( key_len <= 2  ||  StringEquals( src + j + 1, last - 1, key + 1, last - 1, case_sens ) ) {
+        *dst = j;
+        return 1;
+      }
+      mask &= mask - 1;
+    }
+    i += c_stringsearch_width;
+  }
+#endif
+
+  while( i + key_len <= src_len ) {
+    if( StringMatchAt( src, src_len, i, key, key_len, case_sens, word_boundary ) ) {
       *dst = i;
       return 1;
     }
+    i += 1;
   }
   return 0;
 }
+
+Inl bool
+StringSearch( idx_t* dst, u8* src, idx_t src_len, idx_t start, u8* key, idx_t key_len, bool case_sens, bool word_boundary )
+{
+  AssertCrash( start <= src_len );
+  AssertCrash( key_len );
+  if( key_len > src_len - start ) {
+    return 0;
+  }
+  if( key_len == 1  &&  case_sens  &&  !word_boundary ) {
+    auto found = Cast( u8*, memchr( src + start, key[0], src_len - start ) );
+    if( !found ) {
+      return 0;
+    }
+    *dst = Cast( idx_t, found - src );
+    return 1;
+  }
+#if !STRINGSEARCH_SIMD
+  if( key_len >= c_stringsearch_horspool_min_key_len ) {
+    return StringSearchHorspool( dst, src, src_len, start, key, key_len, case_sens, word_boundary );
+  }
+#endif
+  return StringSearchFirstLast( dst, src, src_len, start, key, key_len, case_sens, word_boundary );
+}
+
+
+
+// C++ type inference for argument passing sucks ( esp. constants ), so we have to do this nonsense.
+
+Templ Inl bool
+_StringIdxScanR( T* dst, u8* src, T src_len, T start, u8 key )
+{
+  AssertCrash( start <= src_len );
+  if( start == src_len ) {
+    return 0;
+  }
+  auto found = Cast( u8*, memchr( src + start, key, src_len - start ) );
+  if( !found ) {
+    return 0;
+  }
+  *dst = Cast( T, found - src );
+  return 1;
+}
 Inl bool
 StringIdxScanR( u32* dst, u8* src, u32 src_len, u32 start, u8 key )
 {
@@ -226,41 +474,12 @@ _StringIdxScanR( T* dst, u8* src, T src_len, T start, u8* key, T key_len, bool c
   if( !src_len ) {
     return 0;
   }
-  if( word_boundary ) {
-    Fori( T, i, start, src_len ) {
-      if( StringEquals( src + i, MIN( src_len - i, key_len ), key, key_len, case_sens ) ) {
-        //
-        // now we have a fullstring match!
-        //
-        // eliminate the fullstring match, if it fails the word_boundary test.
-        // if we're searching "0123456789" for "234", the test is:
-        //   keep-match <=> AsciiInWord( "1" ) != AsciiInWord( "2" ) && AsciiInWord( "4" ) != AsciiInWord( "5" )
-        // i.e. the first and last chars in the match must have different "wordiness" than the chars outside.
-        //
-        bool found = 1;
-        if( i > 0  &&  ( AsciiInWord( src[i - 1] ) == AsciiInWord( src[i] ) ) ) {
-          found = 0;
-        }
-        if( i + key_len < src_len  &&  ( AsciiInWord( src[i + key_len - 1] ) == AsciiInWord( src[i + key_len] ) ) ) {
-          found = 0;
-        }
-        if( found ) {
-          *dst = i;
-          return 1;
-        }
-      }
-    }
-  }
-  else {
-    // simpler code for non word_boundary.
-    Fori( T, i, start, src_len ) {
-      if( StringEquals( src + i, MIN( src_len - i, key_len ), key, key_len, case_sens ) ) {
-        *dst = i;
-        return 1;
-      }
-    }
+  idx_t found;
+  if( !StringSearch( &found, src, src_len, start, key, key_len, case_sens, word_boundary ) ) {
+    return 0;
   }
-  return 0;
+  *dst = Cast( T, found );
+  return 1;
 }
 Inl bool
 StringIdxScanR( u32* dst, u8* src, u32 src_len, u32 start, u8* key, u32 key_len, bool case_sens, bool word_boundary )
@@ -357,11 +576,10 @@ StringIdxScanL( u64* dst, u8* src, u64 src_len, u64 start, u8* key, u64 key_len,
 Inl u8*
 StringScanR( u8* src, idx_t src_len, u8 key )
 {
-  For( i, 0, src_len ) {
-    if( src[i] == key )
-      return src + i;
+  if( !src_len ) {
+    return 0;
   }
-  return 0;
+  return Cast( u8*, memchr( src, key, src_len ) );
 }
 
 Inl u8*
@@ -622,3 +840,55 @@ Format( u8* dst, idx_t dstlen, u8* format, idx_t formatlen, ... )
 }
 #endif
 
+
+
+
+RegisterTest([]()
+{
+  // compare the fast search against the reference search on random strings over a small alphabet,
+  // so matches are common and land at every vector lane, block edge, and src edge.
+  u8 alphabet[] = { 'a', 'A', 'b', 'B', 'z', 'Z', '_', '0', ' ', '.', '@', '[', 0x80, 0xC1, 0xE1 };
+  u8 src[300];
+  u8 key[40];
+  u32 rng = 12345;
+  auto Next = [&]() { rng = rng * 1664525u + 1013904223u;  return rng >> 8; };
+  For( trial, 0, 3000 ) {
+    auto alphabet_len = 2 + Next() % ( _countof( alphabet ) - 1 );
+    auto src_len = Next() % _countof( src );
+    For( i, 0, src_len ) {
+      src[i] = alphabet[ Next() % alphabet_len ];
+    }
+    auto key_len = 1 + Next() % ( ( trial & 1 )  ?  _countof( key )  :  4 );
+    if( key_len <= src_len  &&  ( Next() & 1 ) ) {
+      Memmove( key, src + Next() % ( src_len - key_len + 1 ), key_len );
+    } else {
+      For( i, 0, key_len ) {
+        key[i] = alphabet[ Next() % alphabet_len ];
+      }
+    }
+    For( flags, 0, 4 ) {
+      bool case_sens = flags & 1;
+      bool word_boundary = flags & 2;
+      idx_t start = 0;
+      while( start <= src_len ) {
+        idx_t expected = 0;
+        idx_t actual = 0;
+        auto found_expected = StringSearchReference( &expected, src, src_len, start, key, key_len, case_sens, word_boundary );
+        auto found_actual = StringIdxScanR( &actual, src, src_len, start, key, key_len, case_sens, word_boundary );
+        AssertCrash( found_expected == found_actual );
+        // the horspool search only runs for long keys without vector support, so exercise it directly too.
+        if( start + key_len <= src_len ) {
+          idx_t actual_horspool = 0;
+          auto found_horspool = StringSearchHorspool( &actual_horspool, src, src_len, start, key, key_len, case_sens, word_boundary );
+          AssertCrash( found_expected == found_horspool );
+          AssertCrash( !found_horspool  ||  expected == actual_horspool );
+        }
+        if( !found_expected ) {
+          break;
+        }
+        AssertCrash( expected == actual );
+        start = expected + 1;
+      }
+    }
+  }
+});
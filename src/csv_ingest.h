@@ -0,0 +1,1357 @@
+// Copyright (c) John A. Carlos Jr., all rights reserved.
+
+// csv ingest, shared by the grid and stocks apps.
+//
+// CsvIngest scans the source in parallel chunks, in the same shape as BufLoad:
+// pass one counts the record ends in each chunk, for both quote states the chunk could start in, and the
+//   chunk's quotes. a prefix over the quote counts then gives each chunk its real starting quote state.
+// we then move each chunk start forward to just past a record end, so no record straddles two chunks, and
+//   every chunk knows its first row.
+// pass two splits each chunk into fields, writing them straight into column-major storage. when typed, it also
+//   parses every cell as a number/date/usd, and tallies per-column stats for picking each column's type.
+// pass three converts the date cells to numbers, in the columns which agree on one date order.
+//
+// fields may be double-quoted, so they can contain commas, eols, and "" escaped quotes.
+// note we treat every '"' as flipping the quote state, so a stray quote in the middle of an unquoted field throws
+// off the rest of the file.
+// eols are lf, crlf, or a lone cr.
+//
+
+Inl void
+ParseNumeric(
+  slice_t value,
+  f64* numeric,
+  bool* is_numeric
+  )
+{
+  *numeric = 0;
+  *is_numeric = 0;
+
+  bool found_num = 0;
+  idx_t offset_num_start = 0;
+  bool num_negative = 0;
+  auto curr = value.mem;
+  auto len = value.len;
+  if( curr[0] == '-' ) {
+    idx_t offset = 1;
+    while( offset < len  &&  AsciiIsSpaceTab( curr[offset] ) ) {
+      offset += 1;
+    }
+    if( offset < len ) {
+      if( AsciiIsNumber( curr[offset] ) ) {
+        found_num = 1;
+        num_negative = 1;
+        offset_num_start = offset;
+      }
+    }
+  }
+  elif( AsciiIsNumber( curr[0] ) ) {
+    found_num = 1;
+    num_negative = 0;
+    offset_num_start = 0;
+  }
+  if( found_num ) {
+    // we've determined AsciiIsNumber( curr[offset_num_start] )
+    idx_t offset = 1;
+    bool seen_dot = 0;
+    bool seen_e = 0;
+    // TODO: negative exponents
+    // bool seen_e_negativesign = 0;
+    while( offset < len ) {
+      auto c = curr[offset];
+      if( AsciiIsNumber( c ) ) {
+        offset += 1;
+        continue;
+      }
+      elif( c == '.' ) {
+        if( seen_dot ) {
+          // "numbers can only have one decimal point!"
+          return;
+        }
+        if( seen_e ) {
+          // "number exponent can't contain a decimal point!"
+          return;
+        }
+        seen_dot = 1;
+        offset += 1;
+        continue;
+      }
+      elif( c == 'e'  ||  c == 'E' ) {
+        if( seen_e ) {
+          // "numbers can only have one exponent!"
+          return;
+        }
+        seen_e = 1;
+        offset += 1;
+        continue;
+      }
+      else {
+        // "unexpected character within a number!"
+        return;
+      }
+      break;
+    }
+    *is_numeric = 1;
+    // fast path for plain decimals, which is most of what we see in price dumps.
+    // when the digits fit exactly in an f64 mantissa, and the power of ten is exact, one correctly-rounded
+    // divide gives the same answer as a full parse.
+    if( !seen_e ) {
+      constant f64 pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+        };
+      u64 mantissa = 0;
+      idx_t nfrac = 0;
+      bool after_dot = 0;
+      bool exact = 1;
+      for( idx_t i = offset_num_start;  i < len;  ++i ) {
+        auto c = curr[i];
+        if( c == '.' ) {
+          after_dot = 1;
+          continue;
+        }
+        if( mantissa >= ( 1ULL << 53 ) / 10 ) {
+          exact = 0;
+          break;
+        }
+        mantissa = 10 * mantissa + ( c - '0' );
+        nfrac += after_dot;
+      }
+      if( exact  &&  nfrac < _countof( pow10 ) ) {
+        auto r = Cast( f64, mantissa ) / pow10[nfrac];
+        *numeric = num_negative  ?  -r  :  r;
+        return;
+      }
+    }
+    *numeric = CsTo_f64( ML( value ) ); // TODO: use our own instead.
+  }
+}
+enum
+date_order_t
+{
+  ymd = 1u << 0,
+  mdy = 1u << 1,
+  dym = 1u << 2,
+  ydm = 1u << 3,
+  dmy = 1u << 4,
+  myd = 1u << 5,
+};
+ENUM_IS_BITMASK( date_order_t );
+struct
+date_t
+{
+  date_order_t order;
+  u32 slots[3];
+};
+Inl void
+UnpackDate(
+  date_t date,
+  u32* dd,
+  u32* mm,
+  u32* yyyy
+  )
+{
+  AssertCrash( _popcnt_idx_t( date.order ) == 1u );
+  switch( date.order ) {
+    case date_order_t::ymd: {
+      *yyyy = date.slots[0];
+      *mm   = date.slots[1];
+      *dd   = date.slots[2];
+    } break;
+    case date_order_t::mdy: {
+      *yyyy = date.slots[2];
+      *mm   = date.slots[0];
+      *dd   = date.slots[1];
+    } break;
+    case date_order_t::dym: {
+      *yyyy = date.slots[1];
+      *mm   = date.slots[2];
+      *dd   = date.slots[0];
+    } break;
+    case date_order_t::ydm: {
+      *yyyy = date.slots[0];
+      *mm   = date.slots[2];
+      *dd   = date.slots[1];
+    } break;
+    case date_order_t::dmy: {
+      *yyyy = date.slots[2];
+      *mm   = date.slots[1];
+      *dd   = date.slots[0];
+    } break;
+    case date_order_t::myd: {
+      *yyyy = date.slots[1];
+      *mm   = date.slots[0];
+      *dd   = date.slots[2];
+    } break;
+  }
+}
+struct
+parsed_number_t
+{
+  f64 numeric;
+  date_t date;
+  bool is_numeric;
+  bool is_datetime;
+  bool is_usd;
+};
+// Use posix 32bit year bounds, since our CRT uses that.
+constant u32 c_date_minyear = 1900;
+constant u32 c_date_maxyear = 2037;
+ForceInl void
+ParseDate(
+  stack_resizeable_cont_t<slice_t>* buffer,
+  slice_t value,
+  parsed_number_t* result
+  )
+{
+  // most cells aren't dates, so rule them out before splitting.
+  bool has_split_char = 0;
+  ForLen( i, value ) {
+    auto c = value.mem[i];
+    has_split_char |= ( c == '-'  ||  c == '/' );
+  }
+  if( !has_split_char  &&  value.len != 8 ) {
+    return;
+  }
+
+  buffer->len = 0;
+  Reserve( *buffer, 4 );
+  // Each split character is OR'ed when splitting, so the presence of any will cause a split.
+  auto split_chars = SliceFromCStr( "-/" );
+  SplitBy( buffer, split_chars, ML( value ) );
+  if( buffer->len == 1 ) {
+    // Handle dates without separators, like: "20120129"
+    // TODO: handle all possible orderings of ymd in this case.
+    //   it requires more possibilities than date_t.order at the moment, since the 3 integer values aren't
+    //   decided just yet. Or maybe we try the 3 possible slicings here, and error if more than one works?
+    if( value.len == 8 ) {
+      bool all_numbers = 1;
+      ForLen( i, value ) {
+        auto c = value.mem[i];
+        all_numbers &= ( '0' <= c  &&  c <= '9' );
+      }
+      if( all_numbers ) {
+        buffer->mem[0] = { value.mem, 4 };
+        buffer->mem[1] = { value.mem + 4, 2 };
+        buffer->mem[2] = { value.mem + 6, 2 };
+        buffer->len = 3;
+      }
+    }
+  }
+
+  if( buffer->len != 3 ) {
+    return;
+  }
+
+  auto string0 = TrimSpacetabsPrefixAndSuffix( buffer->mem[0] );
+  u32 val0;
+  bool parsed0;
+  CsToIntegerU<u32>( &val0, &parsed0, ML( string0 ), 0 );
+  auto string1 = TrimSpacetabsPrefixAndSuffix( buffer->mem[1] );
+  u32 val1;
+  bool parsed1;
+  CsToIntegerU<u32>( &val1, &parsed1, ML( string1 ), 0 );
+  auto string2 = TrimSpacetabsPrefixAndSuffix( buffer->mem[2] );
+  u32 val2;
+  bool parsed2;
+  CsToIntegerU<u32>( &val2, &parsed2, ML( string2 ), 0 );
+  if( !parsed0 || !parsed1 || !parsed2 ) {
+    return;
+  }
+  constant u32 minyear = c_date_minyear;
+  constant u32 maxyear = c_date_maxyear;
+  constant u32 minmonth = 1;
+  constant u32 maxmonth = 12;
+  constant u32 minday = 1;
+  constant u32 maxday = 31;
+  auto valid_y_0 = LTEandLTE( val0, minyear, maxyear );
+  auto valid_y_1 = LTEandLTE( val1, minyear, maxyear );
+  auto valid_y_2 = LTEandLTE( val2, minyear, maxyear );
+  auto valid_m_0 = LTEandLTE( val0, minmonth, maxmonth );
+  auto valid_m_1 = LTEandLTE( val1, minmonth, maxmonth );
+  auto valid_m_2 = LTEandLTE( val2, minmonth, maxmonth );
+  auto valid_d_0 = LTEandLTE( val0, minday, maxday );
+  auto valid_d_1 = LTEandLTE( val1, minday, maxday );
+  auto valid_d_2 = LTEandLTE( val2, minday, maxday );
+  date_t date = {};
+  date.slots[0] = val0;
+  date.slots[1] = val1;
+  date.slots[2] = val2;
+  if( valid_y_0 && valid_m_1 && valid_d_2 ) date.order |= date_order_t::ymd;
+  if( valid_m_0 && valid_d_1 && valid_y_2 ) date.order |= date_order_t::mdy;
+  if( valid_d_0 && valid_y_1 && valid_m_2 ) date.order |= date_order_t::dym;
+  if( valid_y_0 && valid_d_1 && valid_m_2 ) date.order |= date_order_t::ydm;
+  if( valid_d_0 && valid_m_1 && valid_y_2 ) date.order |= date_order_t::dmy;
+  if( valid_m_0 && valid_y_1 && valid_d_2 ) date.order |= date_order_t::myd;
+  result->date = date;
+  result->is_datetime = 1;
+}
+ForceInl void
+ParseNumericOrDatetimeOrUsd(
+  stack_resizeable_cont_t<slice_t>* buffer,
+  slice_t value,
+  parsed_number_t* result
+  )
+{
+  *result = {};
+
+  value = TrimSpacetabsPrefixAndSuffix( value );
+  if( !value.len ) return;
+
+  // USD parsing
+  if( value.mem[0] == '$' ) {
+    result->is_usd = 1;
+    value.mem += 1;
+    value.len -= 1;
+    value = TrimSpacetabsPrefixAndSuffix( value );
+    if( !value.len ) return;
+    ParseNumeric( value, &result->numeric, &result->is_numeric );
+    if( result->is_numeric ) return;
+  }
+
+  // datetime parsing
+  ParseDate( buffer, value, result );
+  // WARNING: some values are both datetime-like and numeric-like. E.g. "20120128"
+  // So for these, we want to set is_datetime=1 and is_numeric=1.
+  // It's up to the calling column-parsing logic to decide which way to treat these.
+  //if( result->is_datetime ) return;
+
+  // Final numeric parsing for standalone numerics.
+  ParseNumeric( value, &result->numeric, &result->is_numeric );
+  if( result->is_numeric ) return;
+}
+
+
+
+Enumc( csvingesterror_t )
+{
+  none,
+  empty, // no records at all.
+  nfields_mismatch, // a row had a different field count than the header, and we weren't allowing ragged rows.
+  date_before_epoch,
+};
+
+struct
+csvcolumninfo_t
+{
+  bool is_numeric;
+  bool is_datetime;
+  bool is_mixed_string_numeric; // true when the column contains mixed string and numeric data.
+  bool is_all_usd; // true when the column contains all $-prefixed values.
+};
+
+struct
+csvingest_t
+{
+  idx_t ncolumns;
+  u32 nrows; // excluding the header row.
+  tstring_t<slice_t> headers; // the first row.
+  tstring_t<slice_t> cells; // column-major, nrows per column. cells missing from short ragged rows have mem == 0.
+  tstring_t<f64> numeric; // when typed. column-major like cells; any cell that isn't numeric is a 0 entry.
+  tstring_t<csvcolumninfo_t> infos; // when typed.
+  stack_resizeable_cont_t<pagelist_t> unescaped; // quoted fields with "" escapes get copied out to here.
+
+  csvingesterror_t error;
+  u32 error_row; // 0-based, including the header row.
+  idx_t error_nfields;
+};
+
+Inl void
+Kill( csvingest_t* ingest )
+{
+  if( ingest->headers.mem ) {
+    Free( ingest->headers );
+  }
+  if( ingest->cells.mem ) {
+    Free( ingest->cells );
+  }
+  if( ingest->numeric.mem ) {
+    Free( ingest->numeric );
+  }
+  if( ingest->infos.mem ) {
+    Free( ingest->infos );
+  }
+  FORLEN( list, i, ingest->unescaped )
+    Kill( *list );
+  }
+  Free( ingest->unescaped );
+  *ingest = {};
+}
+
+constant idx_t c_csvload_chunk_size = 4*1024*1024;
+constant idx_t c_csvload_max_chunks = 256;
+
+Enumc( csvloadpass_t )
+{
+  count,
+  split,
+  resplit, // ragged rows wider than the header make us split again, into wider storage.
+  dates,
+};
+
+// per-cell flags, when typed.
+constant u8 c_csvcell_numeric = 1u << 0;
+constant u8 c_csvcell_datetime = 1u << 1;
+constant u8 c_csvcell_usd = 1u << 2;
+
+struct
+csvcolumnstats_t
+{
+  idx_t nnumeric;
+  idx_t ndatetime;
+  idx_t nusd;
+  idx_t nnumeric_or_datetime;
+  date_order_t order; // the date orders every date cell so far agrees with.
+  bool found_date;
+};
+
+struct
+csvload_chunk_t
+{
+  idx_t start;
+  idx_t end;
+
+  // pass one, relative to the original chunk start.
+  idx_t nquotes;
+  idx_t nrecords[2]; // indexed by whether the chunk starts inside quotes.
+  idx_t last_eol[2]; // MAX_idx if there's none.
+
+  u32 row_start;
+  u32 row_end;
+
+  // pass two.
+  idx_t max_nfields;
+  u32 error_row; // MAX_u32 if there's none.
+  idx_t error_nfields;
+  pagelist_t unescaped;
+  bool unescaped_used;
+
+  // pass three.
+  bool date_error;
+};
+
+struct
+csvload_t
+{
+  csvingest_t* ingest;
+  u8* src;
+  idx_t src_len;
+  csvload_chunk_t chunks[c_csvload_max_chunks];
+  idx_t nchunks;
+  bool typed;
+  bool ragged;
+  bool skip_empty_records;
+  u8* cellflags; // when typed.
+  csvcolumnstats_t* stats; // when typed; ncolumns per chunk.
+  date_order_t* date_orders; // per column, the resolved date order, or 0 when it isn't a date column.
+  volatile s64* date_cache; // see _CsvSecondsFromDate.
+  csvloadpass_t pass; // the one _CsvLoadRunPass is running.
+};
+
+// whether an eol ends at pos. that's an lf, or a cr that isn't the first half of a crlf.
+ForceInl bool
+_CsvIsEol( u8* src, idx_t src_len, idx_t pos )
+{
+  auto c = src[pos];
+  return c == '\n'  ||  ( c == '\r'  &&  !( pos + 1 < src_len  &&  src[pos + 1] == '\n' ) );
+}
+
+// whether the record that the eol at pos ends is empty.
+// note the record starts just past an eol outside quotes, or at the start of the file.
+ForceInl bool
+_CsvRecordIsEmpty( u8* src, idx_t src_len, idx_t pos )
+{
+  if( src[pos] == '\n'  &&  pos  &&  src[pos - 1] == '\r' ) {
+    pos -= 1;
+  }
+  return !pos  ||  _CsvIsEol( src, src_len, pos - 1 );
+}
+
+#if STRINGSEARCH_SIMD
+
+  constant u32 c_csvload_lanemask = ( c_stringsearch_width == 32 )  ?  MAX_u32  :  ( 1u << c_stringsearch_width ) - 1;
+
+  // bit i is set when the byte at i is inside quotes, counting each quote as inside its own quoted run.
+  ForceInl u32
+  _CsvPrefixXor( u32 x )
+  {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    return x;
+  }
+
+  // note this looks one byte past the block, for crlfs.
+  ForceInl u32
+  _CsvEolMask( u8* src )
+  {
+    auto v = StrvecLoad( src );
+    auto lf = StrvecEqualMask( v, StrvecSet( '\n' ) );
+    auto cr = StrvecEqualMask( v, StrvecSet( '\r' ) );
+    auto lf_next = StrvecEqualMask( StrvecLoad( src + 1 ), StrvecSet( '\n' ) );
+    return lf | ( cr & ~lf_next );
+  }
+
+  // bit i is set when the eol at i ends an empty record. note this looks two bytes before the block.
+  ForceInl u32
+  _CsvEmptyRecordMask( u8* src, u32 eol )
+  {
+    auto eol_prev1 = _CsvEolMask( src - 1 );
+    auto eol_prev2 = _CsvEolMask( src - 2 );
+    auto lf = StrvecEqualMask( StrvecLoad( src ), StrvecSet( '\n' ) );
+    auto cr_prev1 = StrvecEqualMask( StrvecLoad( src - 1 ), StrvecSet( '\r' ) );
+    return eol & ( eol_prev1 | ( lf & cr_prev1 & eol_prev2 ) );
+  }
+
+#endif
+
+Inl void
+_CsvLoadCountChunk( csvload_t* load, csvload_chunk_t* chunk )
+{
+  auto src = load->src;
+  auto src_len = load->src_len;
+  auto skip = load->skip_empty_records;
+  idx_t nquotes = 0;
+  idx_t nrecords[2] = {};
+  idx_t last_eol[2] = { MAX_idx, MAX_idx };
+  u32 inq = 0;
+
+  auto CountByte = [&]( idx_t pos )
+  {
+    auto c = src[pos];
+    if( c == '"' ) {
+      nquotes += 1;
+      inq ^= 1;
+    }
+    elif( _CsvIsEol( src, src_len, pos ) ) {
+      last_eol[inq] = pos;
+      if( !skip  ||  !_CsvRecordIsEmpty( src, src_len, pos ) ) {
+        nrecords[inq] += 1;
+      }
+    }
+  };
+
+  auto idx = chunk->start;
+#if STRINGSEARCH_SIMD
+  // the empty record test looks two bytes back, so do the first two bytes of the file by hand.
+  while( idx < 2  &&  idx < chunk->end ) {
+    CountByte( idx );
+    idx += 1;
+  }
+  auto quote = StrvecSet( '"' );
+  while( idx + c_stringsearch_width <= chunk->end  &&  idx + c_stringsearch_width + 1 <= src_len ) {
+    auto q = StrvecEqualMask( StrvecLoad( src + idx ), quote );
+    auto eol = _CsvEolMask( src + idx );
+    auto inside = ( _CsvPrefixXor( q ) ^ ( 0 - inq ) ) & c_csvload_lanemask;
+    if( eol ) {
+      auto eol_outside = eol & ~inside;
+      auto eol_inside = eol & inside;
+      if( eol_outside ) {
+        last_eol[0] = idx + 31 - _lzcnt_u32( eol_outside );
+      }
+      if( eol_inside ) {
+        last_eol[1] = idx + 31 - _lzcnt_u32( eol_inside );
+      }
+      if( skip ) {
+        eol &= ~_CsvEmptyRecordMask( src + idx, eol );
+      }
+      nrecords[0] += _mm_popcnt_u32( eol & ~inside );
+      nrecords[1] += _mm_popcnt_u32( eol & inside );
+    }
+    nquotes += _mm_popcnt_u32( q );
+    inq = ( inside >> ( c_stringsearch_width - 1 ) ) & 1;
+    idx += c_stringsearch_width;
+  }
+#endif
+  for( ;  idx < chunk->end;  ++idx ) {
+    CountByte( idx );
+  }
+
+  chunk->nquotes = nquotes;
+  chunk->nrecords[0] = nrecords[0];
+  chunk->nrecords[1] = nrecords[1];
+  chunk->last_eol[0] = last_eol[0];
+  chunk->last_eol[1] = last_eol[1];
+}
+
+// strips the quotes off a quoted field. fields with "" escapes get copied out to the chunk's pagelist, unescaped.
+Inl slice_t
+_CsvUnquote( csvload_chunk_t* chunk, slice_t field )
+{
+  if( field.len < 2  ||  field.mem[0] != '"'  ||  field.mem[field.len - 1] != '"' ) {
+    return field;
+  }
+  slice_t inner = { field.mem + 1, field.len - 2 };
+  // count escape pairs the same way the copy below consumes them; stray single quotes stay as-is.
+  idx_t npairs = 0;
+  for( idx_t i = 0;  i + 1 < inner.len;  ++i ) {
+    if( inner.mem[i] == '"'  &&  inner.mem[i + 1] == '"' ) {
+      npairs += 1;
+      i += 1;
+    }
+  }
+  if( !npairs ) {
+    return inner;
+  }
+  if( !chunk->unescaped_used ) {
+    Init( chunk->unescaped, 64*1024 );
+    chunk->unescaped_used = 1;
+  }
+  auto dst = AddPagelist( chunk->unescaped, u8, 1, inner.len - npairs );
+  idx_t len = 0;
+  for( idx_t i = 0;  i < inner.len;  ++i ) {
+    dst[len] = inner.mem[i];
+    len += 1;
+    if( inner.mem[i] == '"'  &&  i + 1 < inner.len  &&  inner.mem[i + 1] == '"' ) {
+      i += 1;
+    }
+  }
+  slice_t r = { dst, len };
+  return r;
+}
+
+struct
+csvsplit_t
+{
+  u32 row;
+  idx_t x;
+  idx_t field_start;
+  csvcolumnstats_t* stats; // this chunk's, when typed.
+  stack_resizeable_cont_t<slice_t> buffer; // for ParseDate.
+};
+
+Inl void
+_CsvLoadCell( csvload_t* load, csvsplit_t* split, idx_t x, slice_t field )
+{
+  auto ingest = load->ingest;
+  if( !split->row ) {
+    ingest->headers.mem[x] = field;
+    return;
+  }
+  auto idx = x * ingest->nrows + split->row - 1;
+  ingest->cells.mem[idx] = field;
+  if( load->typed ) {
+    parsed_number_t parsed;
+    ParseNumericOrDatetimeOrUsd( &split->buffer, field, &parsed );
+    ingest->numeric.mem[idx] = parsed.is_numeric  ?  parsed.numeric  :  0;
+    load->cellflags[idx] = Cast( u8,
+      ( parsed.is_numeric  ?  c_csvcell_numeric  :  0 ) |
+      ( parsed.is_datetime  ?  c_csvcell_datetime  :  0 ) |
+      ( parsed.is_usd  ?  c_csvcell_usd  :  0 )
+      );
+    auto stats = split->stats + x;
+    stats->nnumeric += parsed.is_numeric;
+    stats->ndatetime += parsed.is_datetime;
+    stats->nusd += parsed.is_usd;
+    stats->nnumeric_or_datetime += parsed.is_numeric  ||  parsed.is_datetime;
+    if( parsed.is_datetime ) {
+      if( !stats->found_date ) {
+        stats->found_date = 1;
+        stats->order = parsed.date.order;
+      }
+      else {
+        stats->order &= parsed.date.order;
+      }
+    }
+  }
+}
+
+Inl void
+_CsvLoadField( csvload_t* load, csvload_chunk_t* chunk, csvsplit_t* split, idx_t end )
+{
+  auto x = split->x;
+  split->x += 1;
+  // wider rows are an error, or they make us split again into wider storage, so just drop the extra fields here.
+  if( x >= load->ingest->ncolumns ) {
+    return;
+  }
+  slice_t field = { load->src + split->field_start, end - split->field_start };
+  _CsvLoadCell( load, split, x, _CsvUnquote( chunk, field ) );
+}
+
+Inl void
+_CsvLoadEndRecord( csvload_t* load, csvload_chunk_t* chunk, csvsplit_t* split )
+{
+  auto ncolumns = load->ingest->ncolumns;
+  auto nfields = split->x;
+  chunk->max_nfields = MAX( chunk->max_nfields, nfields );
+  if( nfields != ncolumns  &&  !load->ragged  &&  chunk->error_row == MAX_u32 ) {
+    chunk->error_row = split->row;
+    chunk->error_nfields = nfields;
+  }
+  For( x, nfields, ncolumns ) {
+    _CsvLoadCell( load, split, x, {} );
+  }
+  split->row += 1;
+  split->x = 0;
+}
+
+Inl void
+_CsvLoadEol( csvload_t* load, csvload_chunk_t* chunk, csvsplit_t* split, idx_t pos )
+{
+  auto src = load->src;
+  auto end = pos;
+  if( src[pos] == '\n'  &&  pos > split->field_start  &&  src[pos - 1] == '\r' ) {
+    end = pos - 1;
+  }
+  if( !split->x  &&  end == split->field_start  &&  load->skip_empty_records ) {
+    split->field_start = pos + 1;
+    return;
+  }
+  _CsvLoadField( load, chunk, split, end );
+  _CsvLoadEndRecord( load, chunk, split );
+  split->field_start = pos + 1;
+}
+
+Inl void
+_CsvLoadSplitChunk( csvload_t* load, idx_t chunk_idx )
+{
+  auto src = load->src;
+  auto src_len = load->src_len;
+  auto chunk = load->chunks + chunk_idx;
+  csvsplit_t split;
+  split.row = chunk->row_start;
+  split.x = 0;
+  split.field_start = chunk->start;
+  split.stats = load->stats  ?  load->stats + chunk_idx * load->ingest->ncolumns  :  0;
+  Alloc( split.buffer, 4 );
+
+  auto Structural = [&]( idx_t pos )
+  {
+    if( src[pos] == ',' ) {
+      _CsvLoadField( load, chunk, &split, pos );
+      split.field_start = pos + 1;
+    }
+    else {
+      _CsvLoadEol( load, chunk, &split, pos );
+    }
+  };
+
+  // note chunks start just past a record end, so they start outside quotes.
+  u32 inq = 0;
+  auto idx = chunk->start;
+#if STRINGSEARCH_SIMD
+  auto quote = StrvecSet( '"' );
+  auto comma = StrvecSet( ',' );
+  while( idx + c_stringsearch_width <= chunk->end  &&  idx + c_stringsearch_width + 1 <= src_len ) {
+    auto v = StrvecLoad( src + idx );
+    auto q = StrvecEqualMask( v, quote );
+    auto inside = ( _CsvPrefixXor( q ) ^ ( 0 - inq ) ) & c_csvload_lanemask;
+    auto mask = ( StrvecEqualMask( v, comma ) | _CsvEolMask( src + idx ) ) & ~inside;
+    while( mask ) {
+      auto pos = idx + _tzcnt_u32( mask );
+      mask &= mask - 1;
+      Structural( pos );
+    }
+    inq = ( inside >> ( c_stringsearch_width - 1 ) ) & 1;
+    idx += c_stringsearch_width;
+  }
+#endif
+  for( ;  idx < chunk->end;  ++idx ) {
+    auto c = src[idx];
+    if( c == '"' ) {
+      inq ^= 1;
+    }
+    elif( !inq  &&  ( c == ','  ||  _CsvIsEol( src, src_len, idx ) ) ) {
+      Structural( idx );
+    }
+  }
+
+  // the final record of the file may not have an eol.
+  if( chunk->end == src_len  &&  ( split.x  ||  split.field_start < src_len ) ) {
+    _CsvLoadField( load, chunk, &split, src_len );
+    _CsvLoadEndRecord( load, chunk, &split );
+  }
+  AssertCrash( split.row == chunk->row_end );
+  Free( split.buffer );
+}
+
+constant idx_t c_csvload_date_cache_len = ( c_date_maxyear - c_date_minyear + 1 ) * 12 * 31;
+
+// mktime is expensive, and it's most of the ingest time for date columns if we call it per cell.
+// there's only ~50k dates in range, so we cache its results in a flat table indexed by date.
+// racing threads compute the same value, so a plain store is fine.
+Inl s64
+_CsvSecondsFromDate( csvload_t* load, u32 dd, u32 mm, u32 yyyy )
+{
+  auto slot = load->date_cache + ( yyyy - c_date_minyear ) * 12 * 31 + ( mm - 1 ) * 31 + ( dd - 1 );
+  auto seconds = *slot;
+  if( seconds != MIN_s64 ) {
+    return seconds;
+  }
+  struct tm time_data = { 0 };
+  // time_data.tm_sec = 0
+  // time_data.tm_min = 0
+  // time_data.tm_hour = 0
+  time_data.tm_mday = dd; // 1-based
+  time_data.tm_mon = mm - 1; // 0-based
+  time_data.tm_year = yyyy - 1900; // based on 1900
+  // time_data.tm_wday = 0
+  // time_data.tm_yday = 0
+  time_data.tm_isdst = -1;
+  seconds = Cast( s64, mktime( &time_data ) );
+  *slot = seconds;
+  return seconds;
+}
+
+Inl void
+_CsvLoadDatesChunk( csvload_t* load, idx_t chunk_idx )
+{
+  auto ingest = load->ingest;
+  auto chunk = load->chunks + chunk_idx;
+  stack_resizeable_cont_t<slice_t> buffer;
+  Alloc( buffer, 4 );
+  auto row_start = MAX( chunk->row_start, 1u ); // skip the header row.
+  For( x, 0, ingest->ncolumns ) {
+    auto order = load->date_orders[x];
+    if( !order ) {
+      continue;
+    }
+    Fori( u32, row, row_start, chunk->row_end ) {
+      auto idx = x * ingest->nrows + row - 1;
+      if( !( load->cellflags[idx] & c_csvcell_datetime ) ) {
+        continue;
+      }
+      parsed_number_t parsed;
+      ParseNumericOrDatetimeOrUsd( &buffer, ingest->cells.mem[idx], &parsed );
+      AssertCrash( parsed.is_datetime );
+      // UnpackDate reads the order from the date_t, so use the shared, resolved order.
+      parsed.date.order = order;
+      u32 dd;
+      u32 mm;
+      u32 yyyy;
+      UnpackDate( parsed.date, &dd, &mm, &yyyy );
+      auto seconds = _CsvSecondsFromDate( load, dd, mm, yyyy );
+      if( seconds == -1 ) {
+        // TODO: we need to write our own date encoding?
+        chunk->date_error = 1;
+        continue;
+      }
+      // Cast the time_t sequence_number to f64, which should be big enough to hold it.
+      ingest->numeric.mem[idx] = Cast( f64, seconds ); // dates are numerically encoded.
+    }
+  }
+  Free( buffer );
+}
+
+__ParallelForBody( ParallelFor_CsvLoad )
+{
+  auto load = Cast( csvload_t*, misc );
+  switch( load->pass ) {
+    case csvloadpass_t::count: {
+      _CsvLoadCountChunk( load, load->chunks + k );
+    } break;
+    case csvloadpass_t::split:
+    case csvloadpass_t::resplit: {
+      _CsvLoadSplitChunk( load, k );
+    } break;
+    case csvloadpass_t::dates: {
+      _CsvLoadDatesChunk( load, k );
+    } break;
+    default: UnreachableCrash();
+  }
+}
+
+// note parallel is only allowed on the main thread, since ParallelFor pushes tasks.
+Inl void
+_CsvLoadRunPass( csvload_t* load, csvloadpass_t pass, bool parallel )
+{
+  load->pass = pass;
+  ParallelFor( ParallelFor_CsvLoad, load, load->nchunks, parallel  ?  MAX_idx  :  1 );
+}
+
+// the header is the first record, and its field count sets the column count.
+Inl idx_t
+_CsvHeaderNfields( u8* src, idx_t src_len, bool skip_empty_records )
+{
+  idx_t ncommas = 0;
+  u32 inq = 0;
+  For( pos, 0, src_len ) {
+    auto c = src[pos];
+    if( c == '"' ) {
+      inq ^= 1;
+    }
+    elif( inq ) {
+    }
+    elif( c == ',' ) {
+      ncommas += 1;
+    }
+    elif( _CsvIsEol( src, src_len, pos ) ) {
+      if( !skip_empty_records  ||  !_CsvRecordIsEmpty( src, src_len, pos ) ) {
+        break;
+      }
+    }
+  }
+  return ncommas + 1;
+}
+
+Inl void
+_CsvLoadAllocCells( csvload_t* load, idx_t ncolumns )
+{
+  auto ingest = load->ingest;
+  ingest->ncolumns = ncolumns;
+  ingest->headers = AllocString<slice_t>( ncolumns );
+  ingest->cells = AllocString<slice_t>( ncolumns * ingest->nrows );
+  if( load->typed ) {
+    ingest->numeric = AllocString<f64>( ncolumns * ingest->nrows );
+    load->cellflags = MemHeapAlloc( u8, ncolumns * ingest->nrows );
+    load->stats = MemHeapAlloc( csvcolumnstats_t, ncolumns * load->nchunks );
+    TZero( load->stats, ncolumns * load->nchunks );
+  }
+  For( k, 0, load->nchunks ) {
+    auto chunk = load->chunks + k;
+    chunk->max_nfields = 0;
+    chunk->error_row = MAX_u32;
+    chunk->error_nfields = 0;
+  }
+}
+
+Inl void
+_CsvLoadFreeCells( csvload_t* load )
+{
+  auto ingest = load->ingest;
+  Free( ingest->headers );
+  Free( ingest->cells );
+  if( load->typed ) {
+    Free( ingest->numeric );
+    MemHeapFree( load->cellflags );
+    MemHeapFree( load->stats );
+    load->cellflags = 0;
+    load->stats = 0;
+  }
+  For( k, 0, load->nchunks ) {
+    auto chunk = load->chunks + k;
+    if( chunk->unescaped_used ) {
+      Reset( chunk->unescaped );
+    }
+  }
+}
+
+// splits src into column-major cells, which point into src, so src has to outlive the ingest.
+// when typed, we also parse every cell as a number/date/usd, and pick each column's type.
+// ragged allows rows with a different field count than the header; the columns widen to fit the widest row,
+// and missing cells are left with mem == 0. otherwise a row with a different field count is an error.
+// chunk_size is a parameter so the tests can exercise the chunk boundaries on small inputs.
+// note parallel is only allowed on the main thread, since it pushes tasks.
+// returns false on failure, with ingest->error saying why. either way the ingest needs a Kill.
+Inl bool
+_CsvIngest(
+  csvingest_t* ingest,
+  slice_t src,
+  bool typed,
+  bool ragged,
+  bool skip_empty_records,
+  bool parallel,
+  idx_t chunk_size
+  )
+{
+  *ingest = {};
+  Alloc( ingest->unescaped, 4 );
+
+  auto load = MemHeapAlloc( csvload_t, 1 );
+  load->ingest = ingest;
+  load->src = src.mem;
+  load->src_len = src.len;
+  load->typed = typed;
+  load->ragged = ragged;
+  load->skip_empty_records = skip_empty_records;
+  load->cellflags = 0;
+  load->stats = 0;
+  load->date_orders = 0;
+  load->date_cache = 0;
+
+  // pass one runs on even byte ranges; we move the chunk starts to record starts after.
+  load->nchunks = CLAMP( src.len / chunk_size, 1, c_csvload_max_chunks );
+  auto stride = src.len / load->nchunks;
+  For( k, 0, load->nchunks ) {
+    auto chunk = load->chunks + k;
+    chunk->start = stride * k;
+    chunk->end = ( k + 1 == load->nchunks )  ?  src.len  :  stride * ( k + 1 );
+    chunk->unescaped_used = 0;
+    chunk->date_error = 0;
+  }
+  Prof( CsvIngest_Count );
+  _CsvLoadRunPass( load, csvloadpass_t::count, parallel );
+  ProfClose( CsvIngest_Count );
+
+  Prof( CsvIngest_Boundaries );
+  idx_t nrecords = 0;
+  idx_t tail_start = 0; // just past the last eol outside quotes.
+  u32 inq = 0;
+  For( k, 0, load->nchunks ) {
+    auto chunk = load->chunks + k;
+    if( !k ) {
+      chunk->row_start = 0;
+    }
+    else {
+      // the first eol outside quotes from here ends the record that straddles the chunks.
+      auto pos = chunk->start;
+      auto q = inq;
+      for( ;  pos < src.len;  ++pos ) {
+        auto c = src.mem[pos];
+        if( c == '"' ) {
+          q ^= 1;
+        }
+        elif( !q  &&  _CsvIsEol( ML( src ), pos ) ) {
+          break;
+        }
+      }
+      auto counted = pos < src.len  &&  ( !skip_empty_records  ||  !_CsvRecordIsEmpty( ML( src ), pos ) );
+      chunk->start = MIN( pos + 1, src.len );
+      load->chunks[k - 1].end = chunk->start;
+      AssertCrash( nrecords + counted <= MAX_u32 );
+      chunk->row_start = Cast( u32, nrecords + counted );
+    }
+    if( chunk->last_eol[inq] != MAX_idx ) {
+      tail_start = chunk->last_eol[inq] + 1;
+    }
+    nrecords += chunk->nrecords[inq];
+    inq ^= chunk->nquotes & 1;
+  }
+  nrecords += tail_start < src.len;
+  AssertCrash( nrecords <= MAX_u32 );
+  For( k, 0, load->nchunks ) {
+    auto chunk = load->chunks + k;
+    // chunks that found no record end are empty, past the unterminated last record that an earlier chunk emits.
+    if( chunk->start == src.len ) {
+      chunk->row_start = Cast( u32, nrecords );
+    }
+  }
+  For( k, 0, load->nchunks ) {
+    auto chunk = load->chunks + k;
+    chunk->row_end = ( k + 1 == load->nchunks )  ?  Cast( u32, nrecords )  :  load->chunks[k + 1].row_start;
+  }
+  ProfClose( CsvIngest_Boundaries );
+
+  bool success = 1;
+  if( !nrecords ) {
+    ingest->error = csvingesterror_t::empty;
+    success = 0;
+  }
+  else {
+    ingest->nrows = Cast( u32, nrecords - 1 );
+    _CsvLoadAllocCells( load, _CsvHeaderNfields( ML( src ), skip_empty_records ) );
+
+    Prof( CsvIngest_Split );
+    _CsvLoadRunPass( load, csvloadpass_t::split, parallel );
+    ProfClose( CsvIngest_Split );
+
+    idx_t max_nfields = 0;
+    For( k, 0, load->nchunks ) {
+      auto chunk = load->chunks + k;
+      max_nfields = MAX( max_nfields, chunk->max_nfields );
+      if( success  &&  chunk->error_row != MAX_u32 ) {
+        ingest->error = csvingesterror_t::nfields_mismatch;
+        ingest->error_row = chunk->error_row;
+        ingest->error_nfields = chunk->error_nfields;
+        success = 0;
+      }
+    }
+    if( success  &&  max_nfields > ingest->ncolumns ) {
+      AssertCrash( ragged );
+      Prof( CsvIngest_Resplit );
+      _CsvLoadFreeCells( load );
+      _CsvLoadAllocCells( load, max_nfields );
+      _CsvLoadRunPass( load, csvloadpass_t::resplit, parallel );
+      ProfClose( CsvIngest_Resplit );
+    }
+  }
+
+  if( success  &&  typed ) {
+    Prof( CsvIngest_Types );
+    auto ncolumns = ingest->ncolumns;
+    auto nrows = ingest->nrows;
+    ingest->infos = AllocString<csvcolumninfo_t>( ncolumns );
+    load->date_orders = MemHeapAlloc( date_order_t, ncolumns );
+    bool any_dates = 0;
+    For( x, 0, ncolumns ) {
+      csvcolumnstats_t total = {};
+      For( k, 0, load->nchunks ) {
+        auto stats = load->stats + k * ncolumns + x;
+        total.nnumeric += stats->nnumeric;
+        total.ndatetime += stats->ndatetime;
+        total.nusd += stats->nusd;
+        total.nnumeric_or_datetime += stats->nnumeric_or_datetime;
+        if( stats->found_date ) {
+          if( !total.found_date ) {
+            total.found_date = 1;
+            total.order = stats->order;
+          }
+          else {
+            total.order &= stats->order;
+          }
+        }
+      }
+      // Convert the column to is_numeric=1 from is_datetime=1 if we have a consistent date.order.
+      auto is_date_column = total.found_date  &&  _popcnt_idx_t( total.order ) == 1u;
+      load->date_orders[x] = is_date_column  ?  total.order  :  date_order_t{};
+      any_dates |= is_date_column;
+      auto nnumeric = is_date_column  ?  total.nnumeric_or_datetime  :  total.nnumeric;
+      auto info = ingest->infos.mem + x;
+      info->is_numeric = nnumeric == nrows;
+      info->is_datetime = total.ndatetime == nrows;
+      info->is_mixed_string_numeric = nnumeric  &&  nnumeric < nrows;
+      info->is_all_usd = total.nusd == nrows;
+    }
+    ProfClose( CsvIngest_Types );
+
+    if( any_dates ) {
+      Prof( CsvIngest_Dates );
+      load->date_cache = MemHeapAlloc( s64, c_csvload_date_cache_len );
+      For( i, 0, c_csvload_date_cache_len ) {
+        load->date_cache[i] = MIN_s64;
+      }
+      _CsvLoadRunPass( load, csvloadpass_t::dates, parallel );
+      For( k, 0, load->nchunks ) {
+        if( load->chunks[k].date_error ) {
+          ingest->error = csvingesterror_t::date_before_epoch;
+          success = 0;
+        }
+      }
+      MemHeapFree( Cast( s64*, load->date_cache ) );
+      ProfClose( CsvIngest_Dates );
+    }
+    MemHeapFree( load->date_orders );
+  }
+
+  For( k, 0, load->nchunks ) {
+    auto chunk = load->chunks + k;
+    if( chunk->unescaped_used ) {
+      *AddBack( ingest->unescaped ) = chunk->unescaped;
+    }
+  }
+  if( load->cellflags ) {
+    MemHeapFree( load->cellflags );
+  }
+  if( load->stats ) {
+    MemHeapFree( load->stats );
+  }
+  MemHeapFree( load );
+  return success;
+}
+
+// see _CsvIngest.
+Inl bool
+CsvIngest(
+  csvingest_t* ingest,
+  slice_t src,
+  bool typed,
+  bool ragged,
+  bool skip_empty_records,
+  bool parallel
+  )
+{
+  return _CsvIngest( ingest, src, typed, ragged, skip_empty_records, parallel, c_csvload_chunk_size );
+}
+
+RegisterTest([]()
+{
+  auto Cell = []( csvingest_t* ingest, idx_t x, u32 row ) -> slice_t
+  {
+    if( !row ) {
+      return ingest->headers.mem[x];
+    }
+    return ingest->cells.mem[ x * ingest->nrows + row - 1 ];
+  };
+  auto CellIs = [&]( csvingest_t* ingest, idx_t x, u32 row, const void* cstr )
+  {
+    return EqualContents( Cell( ingest, x, row ), SliceFromCStr( cstr ) );
+  };
+
+  {
+    csvingest_t ingest;
+    AssertCrash( CsvIngest( &ingest, SliceFromCStr( "a,b,c\n1,2,3\r\n\r\n4,,6\n\n" ), 0, 0, 1, 0 ) );
+    AssertCrash( ingest.ncolumns == 3 );
+    AssertCrash( ingest.nrows == 2 );
+    AssertCrash( CellIs( &ingest, 0, 0, "a" ) );
+    AssertCrash( CellIs( &ingest, 2, 0, "c" ) );
+    AssertCrash( CellIs( &ingest, 0, 1, "1" ) );
+    AssertCrash( CellIs( &ingest, 2, 1, "3" ) );
+    AssertCrash( CellIs( &ingest, 1, 2, "" ) );
+    AssertCrash( CellIs( &ingest, 2, 2, "6" ) );
+    Kill( &ingest );
+  }
+
+  {
+    // quoted fields.
+    csvingest_t ingest;
+    AssertCrash( CsvIngest( &ingest, SliceFromCStr( "h0,h1\n\"x,y\",\"a\"\"b\"\n\"two\r\nlines\",\"\"" ), 0, 0, 1, 0 ) );
+    AssertCrash( ingest.nrows == 2 );
+    AssertCrash( CellIs( &ingest, 0, 1, "x,y" ) );
+    AssertCrash( CellIs( &ingest, 1, 1, "a\"b" ) );
+    AssertCrash( CellIs( &ingest, 0, 2, "two\r\nlines" ) );
+    AssertCrash( CellIs( &ingest, 1, 2, "" ) );
+    Kill( &ingest );
+  }
+
+  {
+    // keeping empty records, and ragged rows.
+    csvingest_t ingest;
+    AssertCrash( CsvIngest( &ingest, SliceFromCStr( "a\r\rb,c,d\ne,f\n" ), 0, 1, 0, 0 ) );
+    AssertCrash( ingest.ncolumns == 3 );
+    AssertCrash( ingest.nrows == 3 );
+    AssertCrash( CellIs( &ingest, 0, 0, "a" ) );
+    AssertCrash( !Cell( &ingest, 1, 0 ).mem );
+    AssertCrash( CellIs( &ingest, 0, 1, "" ) );
+    AssertCrash( !Cell( &ingest, 1, 1 ).mem );
+    AssertCrash( CellIs( &ingest, 2, 2, "d" ) );
+    AssertCrash( CellIs( &ingest, 1, 3, "f" ) );
+    AssertCrash( !Cell( &ingest, 2, 3 ).mem );
+    Kill( &ingest );
+
+    AssertCrash( !CsvIngest( &ingest, SliceFromCStr( "a,b\n1,2\n3\n" ), 0, 0, 1, 0 ) );
+    AssertCrash( ingest.error == csvingesterror_t::nfields_mismatch );
+    AssertCrash( ingest.error_row == 2 );
+    AssertCrash( ingest.error_nfields == 1 );
+    Kill( &ingest );
+
+    AssertCrash( !CsvIngest( &ingest, SliceFromCStr( "\n\r\n" ), 0, 0, 1, 0 ) );
+    AssertCrash( ingest.error == csvingesterror_t::empty );
+    Kill( &ingest );
+  }
+
+  {
+    // typed columns.
+    csvingest_t ingest;
+    auto csv = SliceFromCStr( "date,price,name,mixed\n2012-01-13,$1.5,x,1\n2012-01-14, $ 2.5 ,y,z\n" );
+    AssertCrash( CsvIngest( &ingest, csv, 1, 0, 1, 0 ) );
+    auto infos = ingest.infos.mem;
+    AssertCrash( infos[0].is_datetime  &&  infos[0].is_numeric  &&  !infos[0].is_mixed_string_numeric );
+    AssertCrash( !infos[1].is_datetime  &&  infos[1].is_numeric  &&  infos[1].is_all_usd );
+    AssertCrash( !infos[2].is_numeric  &&  !infos[2].is_mixed_string_numeric );
+    AssertCrash( !infos[3].is_numeric  &&  infos[3].is_mixed_string_numeric );
+    AssertCrash( ingest.numeric.mem[1] - ingest.numeric.mem[0] == 24*60*60 );
+    AssertCrash( ingest.numeric.mem[2] == 1.5 );
+    AssertCrash( ingest.numeric.mem[3] == 2.5 );
+    AssertCrash( ingest.numeric.mem[4] == 0 );
+    AssertCrash( ingest.numeric.mem[6] == 1 );
+    AssertCrash( ingest.numeric.mem[7] == 0 );
+    Kill( &ingest );
+  }
+
+  {
+    // the decimal fast path in ParseNumeric has to agree with a full parse, bit for bit.
+    rng_xorshift32_t rng;
+    Init( rng, 1234 );
+    For( i, 0, 100000 ) {
+      u8 text[64];
+      auto ndigits = 1 + Rand32( rng ) % 20;
+      auto dot = Rand32( rng ) % ( ndigits + 1 );
+      idx_t len = 0;
+      if( Rand32( rng ) & 1 ) {
+        text[len++] = '-';
+      }
+      For( d, 0, ndigits ) {
+        if( d  &&  d == dot ) {
+          text[len++] = '.';
+        }
+        text[len++] = Cast( u8, '0' + Rand32( rng ) % 10 );
+      }
+      f64 numeric;
+      bool is_numeric;
+      ParseNumeric( { text, len }, &numeric, &is_numeric );
+      AssertCrash( is_numeric );
+      auto expected = CsTo_f64( text, len );
+      AssertCrash( MemEqual( &numeric, &expected, sizeof( f64 ) ) );
+    }
+  }
+
+  // fuzz the chunked, simd splitter against a plain byte-at-a-time one.
+  {
+    rng_xorshift32_t rng;
+    Init( rng, 1234 );
+    u8 alphabet[] = { 'a', 'b', ' ', ',', ',', '"', '\r', '\n', '\n' };
+    stack_resizeable_cont_t<u8> csv;
+    Alloc( csv, 8192 );
+    stack_resizeable_cont_t<slice_t> fields;
+    Alloc( fields, 1024 );
+    stack_resizeable_cont_t<idx_t> nfields;
+    Alloc( nfields, 1024 );
+    csvload_chunk_t scratch = {};
+    idx_t chunk_sizes[] = { 1, 3, 16, 33, 200, MAX_idx };
+    For( iter, 0, 200 ) {
+      csv.len = 0;
+      auto len = Rand32( rng ) % 4000;
+      For( i, 0, len ) {
+        *AddBack( csv ) = alphabet[ Rand32( rng ) % _countof( alphabet ) ];
+      }
+      auto src = SliceFromArray( csv );
+      auto skip = Cast( bool, iter & 1 );
+
+      fields.len = 0;
+      nfields.len = 0;
+      u32 inq = 0;
+      idx_t field_start = 0;
+      idx_t n = 0;
+      auto EndField = [&]( idx_t end )
+      {
+        slice_t field = { src.mem + field_start, end - field_start };
+        *AddBack( fields ) = _CsvUnquote( &scratch, field );
+        n += 1;
+      };
+      For( pos, 0, src.len ) {
+        auto c = src.mem[pos];
+        if( c == '"' ) {
+          inq ^= 1;
+        }
+        elif( inq ) {
+        }
+        elif( c == ',' ) {
+          EndField( pos );
+          field_start = pos + 1;
+        }
+        elif( _CsvIsEol( ML( src ), pos ) ) {
+          auto end = ( c == '\n'  &&  pos > field_start  &&  src.mem[pos - 1] == '\r' )  ?  pos - 1  :  pos;
+          if( n  ||  end != field_start  ||  !skip ) {
+            EndField( end );
+            *AddBack( nfields ) = n;
+            n = 0;
+          }
+          field_start = pos + 1;
+        }
+      }
+      if( n  ||  field_start < src.len ) {
+        EndField( src.len );
+        *AddBack( nfields ) = n;
+      }
+      idx_t ncolumns = 0;
+      ForLen( i, nfields ) {
+        ncolumns = MAX( ncolumns, nfields.mem[i] );
+      }
+
+      ForEach( chunk_size, chunk_sizes ) {
+        csvingest_t ingest;
+        auto success = _CsvIngest( &ingest, src, 0, 1, skip, 0, chunk_size );
+        if( !nfields.len ) {
+          AssertCrash( !success );
+          Kill( &ingest );
+          continue;
+        }
+        AssertCrash( success );
+        AssertCrash( ingest.nrows + 1 == nfields.len );
+        AssertCrash( ingest.ncolumns == ncolumns );
+        auto field = fields.mem;
+        Fori( u32, row, 0, Cast( u32, nfields.len ) ) {
+          For( x, 0, ncolumns ) {
+            if( x < nfields.mem[row] ) {
+              AssertCrash( EqualContents( Cell( &ingest, x, row ), *field ) );
+              field += 1;
+            }
+            else {
+              AssertCrash( !Cell( &ingest, x, row ).mem );
+            }
+          }
+        }
+        Kill( &ingest );
+      }
+    }
+    if( scratch.unescaped_used ) {
+      Kill( scratch.unescaped );
+    }
+    Free( nfields );
+    Free( fields );
+    Free( csv );
+  }
+});
@@ -0,0 +1,1050 @@
+// Copyright (c) John A. Carlos Jr., all rights reserved.
+
+// line diff engine, used by diffview_t.
+//
+// DiffFiles splits both files into lines, and interns every line into a dense u32 id, so the rest of the engine
+//   only ever compares u32s.
+// we then trim the common prefix/suffix, and discard lines which don't occur at all in the other file; those
+//   can't be part of any match, so they're changed no matter what. on typical edits that leaves very little.
+// what's left goes through one of three algorithms, each of which marks changed lines:
+//   myers: O(ND) greedy, with the linear-space middle snake. gives a minimal edit script.
+//     past a cost limit we give up on minimality and split at the furthest-reaching diagonal, so a pair of
+//     unrelated files can't make us quadratic.
+//   patience: anchors on lines that are unique in both sides, in longest-increasing order.
+//   histogram: anchors on the lowest-occurrence common line, extended to the longest run around it.
+//     patience and histogram fall back to myers on regions without anchors. these tend to read better on code,
+//     since they don't match up braces and blank lines across unrelated blocks.
+// all three work off an explicit region stack, so there's no recursion depth to worry about.
+// the changed flags then turn into hunks, and we optionally run a byte-level myers on each changed line pair,
+//   to get the intra-line spans. unchanged lines never get looked at again.
+//
+
+Enumc( diffalgo_t )
+{
+  myers,
+  patience,
+  histogram,
+  COUNT
+};
+
+struct
+diffhunk_t
+{
+  u32 start_l; // line index into file_l.
+  u32 len_l;
+  u32 start_r; // line index into file_r.
+  u32 len_r;
+  u32 spans_start; // intra-line spans, into diff_t.spans.
+  u32 spans_len;
+};
+
+struct
+diffspan_t
+{
+  u32 line; // line index, into file_r when right, otherwise file_l.
+  u32 start; // byte offset from the start of the line.
+  u32 len;
+  bool right;
+};
+
+struct
+diffregion_t
+{
+  u32 l0;
+  u32 l1;
+  u32 r0;
+  u32 r1;
+  diffalgo_t algo;
+};
+
+struct
+diff_t
+{
+  stack_resizeable_cont_t<slice_t> lines_l;
+  stack_resizeable_cont_t<slice_t> lines_r;
+  stack_resizeable_cont_t<u32> ids_l;
+  stack_resizeable_cont_t<u32> ids_r;
+  stack_resizeable_cont_t<u8> changed_l; // 1 per line.
+  stack_resizeable_cont_t<u8> changed_r;
+  stack_resizeable_cont_t<diffhunk_t> hunks;
+  stack_resizeable_cont_t<diffspan_t> spans;
+  u32 nids;
+
+  // scratch, kept around so repeated diffs don't reallocate.
+  stack_resizeable_cont_t<u64> intern; // open-addressed. high 32 bits of the hash, then id + 1, per slot.
+  stack_resizeable_cont_t<u64> hashes; // per line.
+  stack_resizeable_cont_t<slice_t> id_lines; // the first line we saw, per id.
+  stack_resizeable_cont_t<u32> count_l; // per id.
+  stack_resizeable_cont_t<u32> count_r; // per id.
+  stack_resizeable_cont_t<u32> head; // per id.
+  stack_resizeable_cont_t<u32> next; // per line.
+  stack_resizeable_cont_t<u32> compact_l; // ids, after discarding.
+  stack_resizeable_cont_t<u32> compact_r;
+  stack_resizeable_cont_t<u32> index_l; // compacted position -> line index.
+  stack_resizeable_cont_t<u32> index_r;
+  stack_resizeable_cont_t<u8> compact_changed_l;
+  stack_resizeable_cont_t<u8> compact_changed_r;
+  stack_resizeable_cont_t<s32> vf; // per diagonal.
+  stack_resizeable_cont_t<s32> vb;
+  stack_resizeable_cont_t<diffregion_t> regions;
+  stack_resizeable_cont_t<u32> pairs; // patience anchors, and lis piles.
+  stack_resizeable_cont_t<u32> bytes_l;
+  stack_resizeable_cont_t<u32> bytes_r;
+};
+
+Inl void
+Init( diff_t& diff )
+{
+  Alloc( diff.lines_l, 1024 );
+  Alloc( diff.lines_r, 1024 );
+  Alloc( diff.ids_l, 1024 );
+  Alloc( diff.ids_r, 1024 );
+  Alloc( diff.changed_l, 1024 );
+  Alloc( diff.changed_r, 1024 );
+  Alloc( diff.hunks, 64 );
+  Alloc( diff.spans, 64 );
+  diff.nids = 0;
+  Alloc( diff.intern, 4096 );
+  Alloc( diff.hashes, 1024 );
+  Alloc( diff.id_lines, 1024 );
+  Alloc( diff.count_l, 1024 );
+  Alloc( diff.count_r, 1024 );
+  Alloc( diff.head, 1024 );
+  Alloc( diff.next, 1024 );
+  Alloc( diff.compact_l, 1024 );
+  Alloc( diff.compact_r, 1024 );
+  Alloc( diff.index_l, 1024 );
+  Alloc( diff.index_r, 1024 );
+  Alloc( diff.compact_changed_l, 1024 );
+  Alloc( diff.compact_changed_r, 1024 );
+  Alloc( diff.vf, 1024 );
+  Alloc( diff.vb, 1024 );
+  Alloc( diff.regions, 256 );
+  Alloc( diff.pairs, 1024 );
+  Alloc( diff.bytes_l, 256 );
+  Alloc( diff.bytes_r, 256 );
+}
+
+Inl void
+Kill( diff_t& diff )
+{
+  Free( diff.lines_l );
+  Free( diff.lines_r );
+  Free( diff.ids_l );
+  Free( diff.ids_r );
+  Free( diff.changed_l );
+  Free( diff.changed_r );
+  Free( diff.hunks );
+  Free( diff.spans );
+  diff.nids = 0;
+  Free( diff.intern );
+  Free( diff.hashes );
+  Free( diff.id_lines );
+  Free( diff.count_l );
+  Free( diff.count_r );
+  Free( diff.head );
+  Free( diff.next );
+  Free( diff.compact_l );
+  Free( diff.compact_r );
+  Free( diff.index_l );
+  Free( diff.index_r );
+  Free( diff.compact_changed_l );
+  Free( diff.compact_changed_r );
+  Free( diff.vf );
+  Free( diff.vb );
+  Free( diff.regions );
+  Free( diff.pairs );
+  Free( diff.bytes_l );
+  Free( diff.bytes_r );
+}
+
+// sets len, growing capacity if needed. contents are left undefined.
+Templ Inl void
+_DiffResize( stack_resizeable_cont_t<T>& stack, idx_t len )
+{
+  Reserve( stack, len );
+  stack.len = len;
+}
+
+// lines don't include their eol. eols are lf, crlf, or a lone cr.
+// a trailing eol doesn't start another line.
+Inl void
+DiffSplitLines( stack_resizeable_cont_t<slice_t>& lines, slice_t file )
+{
+  lines.len = 0;
+  auto mem = file.mem;
+  auto end = file.mem + file.len;
+  // the next lf and cr at or after mem, or end when there are none left.
+  // we only rescan once we pass them, so this stays linear regardless of the eol style.
+  u8* lf = 0;
+  u8* cr = 0;
+  while( mem < end ) {
+    if( lf < mem ) {
+      lf = Cast( u8*, memchr( mem, '\n', end - mem ) );
+      lf = lf  ?  lf  :  end;
+    }
+    if( cr < mem ) {
+      cr = Cast( u8*, memchr( mem, '\r', end - mem ) );
+      cr = cr  ?  cr  :  end;
+    }
+    auto line_end = MIN( lf, cr );
+    auto add = AddBack( lines );
+    add->mem = mem;
+    add->len = line_end - mem;
+    if( line_end == end ) {
+      break;
+    }
+    mem = line_end + 1;
+    if( line_end == cr  &&  mem < end  &&  mem[0] == '\n' ) {
+      mem += 1;
+    }
+  }
+}
+
+ForceInl u64
+_DiffHashLine( u8* mem, idx_t len )
+{
+  u64 h = 0x9E3779B97F4A7C15ULL ^ len;
+  while( len >= 8 ) {
+    u64 w;
+    Memmove( &w, mem, 8 );
+    h = ( h ^ w ) * 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 32;
+    mem += 8;
+    len -= 8;
+  }
+  if( len ) {
+    u64 w = 0;
+    Memmove( &w, mem, len );
+    h = ( h ^ w ) * 0xFF51AFD7ED558CCDULL;
+  }
+  h ^= h >> 29;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+// the table is far bigger than cache on large files, so we hash every line up front, and prefetch each
+// line's slot a ways ahead of probing it.
+Inl void
+_DiffIntern(
+  diff_t& diff,
+  stack_resizeable_cont_t<slice_t>& lines,
+  stack_resizeable_cont_t<u32>& ids
+  )
+{
+  constant idx_t c_prefetch_distance = 16;
+
+  auto mask = diff.intern.len - 1;
+  _DiffResize( ids, lines.len );
+  _DiffResize( diff.hashes, lines.len );
+  For( i, 0, lines.len ) {
+    diff.hashes.mem[i] = _DiffHashLine( ML( lines.mem[i] ) );
+  }
+  For( i, 0, lines.len ) {
+    if( i + c_prefetch_distance < lines.len ) {
+      auto slot_ahead = Cast( idx_t, diff.hashes.mem[ i + c_prefetch_distance ] ) & mask;
+      _mm_prefetch( Cast( const char*, diff.intern.mem + slot_ahead ), _MM_HINT_T0 );
+    }
+    auto line = lines.mem[i];
+    auto hash = diff.hashes.mem[i];
+    auto tag = hash & 0xFFFFFFFF00000000ULL;
+    auto slot = Cast( idx_t, hash ) & mask;
+    Forever {
+      auto entry = diff.intern.mem[slot];
+      if( !entry ) {
+        auto id = diff.nids;
+        diff.nids += 1;
+        diff.intern.mem[slot] = tag | ( id + 1 );
+        *AddBack( diff.id_lines ) = line;
+        ids.mem[i] = id;
+        break;
+      }
+      if( ( entry & 0xFFFFFFFF00000000ULL ) == tag ) {
+        auto id = Cast( u32, entry ) - 1;
+        auto other = diff.id_lines.mem[id];
+        if( MemEqual( ML( line ), ML( other ) ) ) {
+          ids.mem[i] = id;
+          break;
+        }
+      }
+      slot = ( slot + 1 ) & mask;
+    }
+  }
+}
+
+Inl void
+_DiffMarkChanged( u8* changed_a, u8* changed_b, diffregion_t region )
+{
+  For( i, region.l0, region.l1 ) {
+    changed_a[i] = 1;
+  }
+  For( j, region.r0, region.r1 ) {
+    changed_b[j] = 1;
+  }
+}
+
+// finds a split point of the region, such that diffing both halves separately gives a minimal diff.
+// this is the middle snake: we run the greedy forward and backward searches at the same time, alternating cost
+// by cost, until the paths overlap on some diagonal. diagonals are k = x - y, where x indexes a and y indexes b.
+// past max_cost, we give up and return the furthest-reaching forward point instead.
+// vf, vb need room for every diagonal from -( r1 - r0 ) - 1 through ( l1 - l0 ) + 1.
+// the region must be nonempty on both sides, and its first and last elements must differ.
+// returns false if we couldn't find a split that makes progress.
+Inl bool
+_DiffMiddleSnake(
+  u32* a,
+  u32* b,
+  diffregion_t region,
+  s32* vf,
+  s32* vb,
+  u32 max_cost,
+  u32* split_l,
+  u32* split_r
+  )
+{
+  // work in region-relative coordinates.
+  a += region.l0;
+  b += region.r0;
+  auto n = Cast( s32, region.l1 - region.l0 );
+  auto m = Cast( s32, region.r1 - region.r0 );
+  vf += m + 1;
+  vb += m + 1;
+  auto dmin = -m;
+  auto dmax = n;
+  auto fmid = 0;
+  auto bmid = n - m;
+  auto odd = ( n - m ) & 1;
+  auto fmin = fmid;
+  auto fmax = fmid;
+  auto bmin = bmid;
+  auto bmax = bmid;
+  vf[fmid] = 0;
+  vb[bmid] = n;
+  for( u32 cost = 1;  ;  ++cost ) {
+    // forward.
+    if( fmin > dmin ) {
+      vf[ --fmin - 1 ] = -1;
+    } else {
+      ++fmin;
+    }
+    if( fmax < dmax ) {
+      vf[ ++fmax + 1 ] = -1;
+    } else {
+      --fmax;
+    }
+    for( auto k = fmax;  k >= fmin;  k -= 2 ) {
+      auto xlo = vf[k - 1];
+      auto xhi = vf[k + 1];
+      auto x = xlo >= xhi  ?  xlo + 1  :  xhi;
+      auto y = x - k;
+      while( x < n  &&  y < m  &&  a[x] == b[y] ) {
+        x += 1;
+        y += 1;
+      }
+      vf[k] = x;
+      if( odd  &&  bmin <= k  &&  k <= bmax  &&  vb[k] <= x ) {
+        *split_l = region.l0 + x;
+        *split_r = region.r0 + y;
+        return 1;
+      }
+    }
+
+    // backward.
+    if( bmin > dmin ) {
+      vb[ --bmin - 1 ] = MAX_s32;
+    } else {
+      ++bmin;
+    }
+    if( bmax < dmax ) {
+      vb[ ++bmax + 1 ] = MAX_s32;
+    } else {
+      --bmax;
+    }
+    for( auto k = bmax;  k >= bmin;  k -= 2 ) {
+      auto xlo = vb[k - 1];
+      auto xhi = vb[k + 1];
+      auto x = xlo < xhi  ?  xlo  :  xhi - 1;
+      auto y = x - k;
+      while( x > 0  &&  y > 0  &&  a[x - 1] == b[y - 1] ) {
+        x -= 1;
+        y -= 1;
+      }
+      vb[k] = x;
+      if( !odd  &&  fmin <= k  &&  k <= fmax  &&  x <= vf[k] ) {
+        *split_l = region.l0 + x;
+        *split_r = region.r0 + y;
+        return 1;
+      }
+    }
+
+    if( cost >= max_cost ) {
+      s32 best_x = 0;
+      s32 best_y = 0;
+      for( auto k = fmax;  k >= fmin;  k -= 2 ) {
+        auto x = MIN( vf[k], n );
+        auto y = x - k;
+        if( y > m ) {
+          x = m + k;
+          y = m;
+        }
+        if( x + y > best_x + best_y ) {
+          best_x = x;
+          best_y = y;
+        }
+      }
+      *split_l = region.l0 + best_x;
+      *split_r = region.r0 + best_y;
+      return best_x + best_y > 0  &&  best_x + best_y < n + m;
+    }
+  }
+}
+
+// histogram anchoring. returns false when there's no usable anchor in the region.
+// head/count_l are per id, and must be zero on entry; we leave them zeroed.
+Inl bool
+_DiffHistogramAnchor(
+  u32* a,
+  u32* b,
+  diffregion_t region,
+  u32* head,
+  u32* next,
+  u32* count_l,
+  u32* anchor_l0,
+  u32* anchor_l1,
+  u32* anchor_r0,
+  u32* anchor_r1
+  )
+{
+  constant u32 c_max_chain = 64;
+
+  // chains are built back to front, so walking one visits a's occurrences in order.
+  for( auto i = region.l1;  i > region.l0;  --i ) {
+    auto id = a[i - 1];
+    next[i - 1] = head[id];
+    head[id] = i;
+    count_l[id] += 1;
+  }
+
+  auto best_count = c_max_chain + 1;
+  u32 best_len = 0;
+  auto j = region.r0;
+  while( j < region.r1 ) {
+    auto id = b[j];
+    auto count = count_l[id];
+    auto j_next = j + 1;
+    if( count  &&  count <= best_count ) {
+      for( auto i = head[id];  i;  i = next[i - 1] ) {
+        auto l0 = i - 1;
+        auto r0 = j;
+        while( l0 > region.l0  &&  r0 > region.r0  &&  a[l0 - 1] == b[r0 - 1] ) {
+          l0 -= 1;
+          r0 -= 1;
+        }
+        auto l1 = i;
+        auto r1 = j + 1;
+        while( l1 < region.l1  &&  r1 < region.r1  &&  a[l1] == b[r1] ) {
+          l1 += 1;
+          r1 += 1;
+        }
+        // the run's rarest line is what makes it a good anchor.
+        auto run_count = count;
+        For( t, l0, l1 ) {
+          run_count = MIN( run_count, count_l[ a[t] ] );
+        }
+        auto len = l1 - l0;
+        if( run_count < best_count  ||  ( run_count == best_count  &&  len > best_len ) ) {
+          best_count = run_count;
+          best_len = len;
+          *anchor_l0 = l0;
+          *anchor_l1 = l1;
+          *anchor_r0 = r0;
+          *anchor_r1 = r1;
+        }
+        j_next = MAX( j_next, r1 );
+      }
+    }
+    j = j_next;
+  }
+
+  For( i, region.l0, region.l1 ) {
+    auto id = a[i];
+    head[id] = 0;
+    count_l[id] = 0;
+  }
+  return best_len != 0;
+}
+
+// patience anchoring: pushes the regions between anchors, in reverse order.
+// returns false when there are no lines unique to both sides.
+// count_l/count_r/head are per id, and must be zero on entry; we leave them zeroed.
+Inl bool
+_DiffPatienceAnchors(
+  diff_t& diff,
+  u32* a,
+  u32* b,
+  diffregion_t region,
+  u32* count_l,
+  u32* count_r,
+  u32* pos_l
+  )
+{
+  For( i, region.l0, region.l1 ) {
+    auto id = a[i];
+    count_l[id] += 1;
+    pos_l[id] = i;
+  }
+  For( j, region.r0, region.r1 ) {
+    count_r[ b[j] ] += 1;
+  }
+
+  // pairs holds ( l, r ) for each unique-in-both line, in r order.
+  // we then lay piles out after the pairs: the pile tops, and each pair's predecessor.
+  auto& pairs = diff.pairs;
+  pairs.len = 0;
+  For( j, region.r0, region.r1 ) {
+    auto id = b[j];
+    if( count_l[id] == 1  &&  count_r[id] == 1 ) {
+      auto add = AddBack( pairs, 2 );
+      add[0] = pos_l[id];
+      add[1] = Cast( u32, j );
+    }
+  }
+  For( i, region.l0, region.l1 ) {
+    count_l[ a[i] ] = 0;
+  }
+  For( j, region.r0, region.r1 ) {
+    count_r[ b[j] ] = 0;
+  }
+  auto npairs = Cast( u32, pairs.len / 2 );
+  if( !npairs ) {
+    return 0;
+  }
+
+  // longest increasing subsequence on l, by patience sorting.
+  Reserve( pairs, 4 * npairs );
+  auto tops = pairs.mem + 2 * npairs;
+  auto prev = tops + npairs;
+  u32 npiles = 0;
+  Fori( u32, p, 0, npairs ) {
+    auto l = pairs.mem[ 2 * p ];
+    u32 lo = 0;
+    u32 hi = npiles;
+    while( lo < hi ) {
+      auto mid = ( lo + hi ) / 2;
+      if( pairs.mem[ 2 * tops[mid] ] < l ) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    prev[p] = lo  ?  tops[lo - 1]  :  MAX_u32;
+    tops[lo] = p;
+    npiles = MAX( npiles, lo + 1 );
+  }
+
+  // walk the lis back to front. we push regions onto a stack, so pushing back to front means we process
+  // them front to back, not that it matters.
+  auto l1 = region.l1;
+  auto r1 = region.r1;
+  for( auto p = tops[npiles - 1];  p != MAX_u32;  p = prev[p] ) {
+    auto l = pairs.mem[ 2 * p ];
+    auto r = pairs.mem[ 2 * p + 1 ];
+    auto add = AddBack( diff.regions );
+    add->l0 = l + 1;
+    add->l1 = l1;
+    add->r0 = r + 1;
+    add->r1 = r1;
+    add->algo = diffalgo_t::patience;
+    l1 = l;
+    r1 = r;
+  }
+  auto add = AddBack( diff.regions );
+  add->l0 = region.l0;
+  add->l1 = l1;
+  add->r0 = region.r0;
+  add->r1 = r1;
+  add->algo = diffalgo_t::patience;
+  return 1;
+}
+
+// marks changed elements of a and b, for the given algorithm.
+// changed_a and changed_b must be zeroed on entry.
+// ids must be < nids.
+Inl void
+_DiffSequences(
+  diff_t& diff,
+  u32* a,
+  u32 a_len,
+  u32* b,
+  u32 b_len,
+  u32 nids,
+  u8* changed_a,
+  u8* changed_b,
+  diffalgo_t algo
+  )
+{
+  // the middle snake's cost limit. it's rare to hit this on real files, since most of the work is in long
+  // matching runs, which don't add cost.
+  auto max_cost = MAX( 256u, Cast( u32, Sqrt( Cast( f64, a_len + b_len ) ) ) );
+
+  _DiffResize( diff.vf, a_len + b_len + 3 );
+  _DiffResize( diff.vb, a_len + b_len + 3 );
+  if( algo != diffalgo_t::myers ) {
+    _DiffResize( diff.head, nids );
+    _DiffResize( diff.count_l, nids );
+    _DiffResize( diff.count_r, nids );
+    TZero( diff.head.mem, nids );
+    TZero( diff.count_l.mem, nids );
+    TZero( diff.count_r.mem, nids );
+    _DiffResize( diff.next, a_len );
+  }
+
+  diff.regions.len = 0;
+  {
+    auto add = AddBack( diff.regions );
+    add->l0 = 0;
+    add->l1 = a_len;
+    add->r0 = 0;
+    add->r1 = b_len;
+    add->algo = algo;
+  }
+  while( diff.regions.len ) {
+    auto region = diff.regions.mem[ diff.regions.len - 1 ];
+    RemBack( diff.regions );
+
+    while( region.l0 < region.l1  &&  region.r0 < region.r1  &&  a[region.l0] == b[region.r0] ) {
+      region.l0 += 1;
+      region.r0 += 1;
+    }
+    while( region.l0 < region.l1  &&  region.r0 < region.r1  &&  a[region.l1 - 1] == b[region.r1 - 1] ) {
+      region.l1 -= 1;
+      region.r1 -= 1;
+    }
+    if( region.l0 == region.l1  ||  region.r0 == region.r1 ) {
+      _DiffMarkChanged( changed_a, changed_b, region );
+      continue;
+    }
+
+    switch( region.algo ) {
+      case diffalgo_t::histogram: {
+        u32 l0, l1, r0, r1;
+        if( _DiffHistogramAnchor( a, b, region, diff.head.mem, diff.next.mem, diff.count_l.mem, &l0, &l1, &r0, &r1 ) ) {
+          auto add = AddBack( diff.regions, 2 );
+          add[0] = { region.l0, l0, region.r0, r0, diffalgo_t::histogram };
+          add[1] = { l1, region.l1, r1, region.r1, diffalgo_t::histogram };
+          continue;
+        }
+        region.algo = diffalgo_t::myers;
+      } break;
+
+      case diffalgo_t::patience: {
+        if( _DiffPatienceAnchors( diff, a, b, region, diff.count_l.mem, diff.count_r.mem, diff.head.mem ) ) {
+          continue;
+        }
+        region.algo = diffalgo_t::myers;
+      } break;
+
+      case diffalgo_t::myers: {
+      } break;
+
+      default: UnreachableCrash();
+    }
+
+    AssertCrash( region.algo == diffalgo_t::myers );
+    u32 split_l, split_r;
+    if( !_DiffMiddleSnake( a, b, region, diff.vf.mem, diff.vb.mem, max_cost, &split_l, &split_r ) ) {
+      _DiffMarkChanged( changed_a, changed_b, region );
+      continue;
+    }
+    auto add = AddBack( diff.regions, 2 );
+    add[0] = { region.l0, split_l, region.r0, split_r, diffalgo_t::myers };
+    add[1] = { split_l, region.l1, split_r, region.r1, diffalgo_t::myers };
+  }
+}
+
+// fills diff.changed_l/changed_r from diff.ids_l/ids_r.
+Inl void
+_DiffLines( diff_t& diff, diffalgo_t algo )
+{
+  auto a = diff.ids_l.mem;
+  auto b = diff.ids_r.mem;
+  auto a_len = Cast( u32, diff.ids_l.len );
+  auto b_len = Cast( u32, diff.ids_r.len );
+  _DiffResize( diff.changed_l, a_len );
+  _DiffResize( diff.changed_r, b_len );
+  TZero( diff.changed_l.mem, a_len );
+  TZero( diff.changed_r.mem, b_len );
+
+  // common prefix/suffix.
+  u32 l0 = 0;
+  u32 r0 = 0;
+  u32 l1 = a_len;
+  u32 r1 = b_len;
+  while( l0 < l1  &&  r0 < r1  &&  a[l0] == b[r0] ) {
+    l0 += 1;
+    r0 += 1;
+  }
+  while( l0 < l1  &&  r0 < r1  &&  a[l1 - 1] == b[r1 - 1] ) {
+    l1 -= 1;
+    r1 -= 1;
+  }
+
+  // discard lines that don't occur in the other side.
+  auto nids = diff.nids;
+  _DiffResize( diff.count_l, nids );
+  _DiffResize( diff.count_r, nids );
+  TZero( diff.count_l.mem, nids );
+  TZero( diff.count_r.mem, nids );
+  For( i, l0, l1 ) {
+    diff.count_l.mem[ a[i] ] = 1;
+  }
+  For( j, r0, r1 ) {
+    diff.count_r.mem[ b[j] ] = 1;
+  }
+  _DiffResize( diff.compact_l, l1 - l0 );
+  _DiffResize( diff.compact_r, r1 - r0 );
+  _DiffResize( diff.index_l, l1 - l0 );
+  _DiffResize( diff.index_r, r1 - r0 );
+  u32 na = 0;
+  u32 nb = 0;
+  Fori( u32, i, l0, l1 ) {
+    if( diff.count_r.mem[ a[i] ] ) {
+      diff.compact_l.mem[na] = a[i];
+      diff.index_l.mem[na] = i;
+      na += 1;
+    } else {
+      diff.changed_l.mem[i] = 1;
+    }
+  }
+  Fori( u32, j, r0, r1 ) {
+    if( diff.count_l.mem[ b[j] ] ) {
+      diff.compact_r.mem[nb] = b[j];
+      diff.index_r.mem[nb] = j;
+      nb += 1;
+    } else {
+      diff.changed_r.mem[j] = 1;
+    }
+  }
+
+  _DiffResize( diff.compact_changed_l, na );
+  _DiffResize( diff.compact_changed_r, nb );
+  TZero( diff.compact_changed_l.mem, na );
+  TZero( diff.compact_changed_r.mem, nb );
+  _DiffSequences(
+    diff,
+    diff.compact_l.mem,
+    na,
+    diff.compact_r.mem,
+    nb,
+    nids,
+    diff.compact_changed_l.mem,
+    diff.compact_changed_r.mem,
+    algo
+    );
+  For( i, 0, na ) {
+    if( diff.compact_changed_l.mem[i] ) {
+      diff.changed_l.mem[ diff.index_l.mem[i] ] = 1;
+    }
+  }
+  For( j, 0, nb ) {
+    if( diff.compact_changed_r.mem[j] ) {
+      diff.changed_r.mem[ diff.index_r.mem[j] ] = 1;
+    }
+  }
+}
+
+Inl void
+_DiffAddSpans( diff_t& diff, u8* changed, u32 len, u32 line, bool right )
+{
+  u32 i = 0;
+  while( i < len ) {
+    if( !changed[i] ) {
+      i += 1;
+      continue;
+    }
+    auto start = i;
+    while( i < len  &&  changed[i] ) {
+      i += 1;
+    }
+    auto span = AddBack( diff.spans );
+    span->line = line;
+    span->start = start;
+    span->len = i - start;
+    span->right = right;
+  }
+}
+
+// byte-level diff of each line pair in the hunk.
+// lines past the shorter side of the hunk have nothing to pair with, so they're left as wholly changed.
+Inl void
+_DiffRefineHunk( diff_t& diff, diffhunk_t& hunk )
+{
+  // very long lines aren't worth refining; the spans wouldn't be readable anyways.
+  constant idx_t c_max_refine_len = 4096;
+
+  hunk.spans_start = Cast( u32, diff.spans.len );
+  auto npairs = MIN( hunk.len_l, hunk.len_r );
+  Fori( u32, p, 0, npairs ) {
+    auto line_l = diff.lines_l.mem[ hunk.start_l + p ];
+    auto line_r = diff.lines_r.mem[ hunk.start_r + p ];
+    if( line_l.len > c_max_refine_len  ||  line_r.len > c_max_refine_len ) {
+      continue;
+    }
+    _DiffResize( diff.bytes_l, line_l.len );
+    _DiffResize( diff.bytes_r, line_r.len );
+    For( i, 0, line_l.len ) {
+      diff.bytes_l.mem[i] = line_l.mem[i];
+    }
+    For( i, 0, line_r.len ) {
+      diff.bytes_r.mem[i] = line_r.mem[i];
+    }
+    _DiffResize( diff.compact_changed_l, line_l.len );
+    _DiffResize( diff.compact_changed_r, line_r.len );
+    TZero( diff.compact_changed_l.mem, line_l.len );
+    TZero( diff.compact_changed_r.mem, line_r.len );
+    _DiffSequences(
+      diff,
+      diff.bytes_l.mem,
+      Cast( u32, line_l.len ),
+      diff.bytes_r.mem,
+      Cast( u32, line_r.len ),
+      256,
+      diff.compact_changed_l.mem,
+      diff.compact_changed_r.mem,
+      diffalgo_t::myers
+      );
+    _DiffAddSpans( diff, diff.compact_changed_l.mem, Cast( u32, line_l.len ), hunk.start_l + p, 0 );
+    _DiffAddSpans( diff, diff.compact_changed_r.mem, Cast( u32, line_r.len ), hunk.start_r + p, 1 );
+  }
+  hunk.spans_len = Cast( u32, diff.spans.len ) - hunk.spans_start;
+}
+
+// diffs file_l against file_r, filling diff.hunks, and diff.spans when intraline.
+// the lines/hunks/spans point into the given files, so they must outlive the results.
+Inl void
+DiffFiles(
+  diff_t& diff,
+  slice_t file_l,
+  slice_t file_r,
+  diffalgo_t algo,
+  bool intraline
+  )
+{
+  ProfFunc();
+
+  DiffSplitLines( diff.lines_l, file_l );
+  DiffSplitLines( diff.lines_r, file_r );
+  AssertCrash( diff.lines_l.len + diff.lines_r.len < MAX_u32 );
+
+  // intern into dense ids. the table stays at most half full.
+  auto nlines = diff.lines_l.len + diff.lines_r.len;
+  idx_t ntable = 64;
+  while( ntable < 2 * nlines ) {
+    ntable *= 2;
+  }
+  _DiffResize( diff.intern, ntable );
+  TZero( diff.intern.mem, ntable );
+  diff.nids = 0;
+  diff.id_lines.len = 0;
+  Reserve( diff.id_lines, nlines );
+  _DiffIntern( diff, diff.lines_l, diff.ids_l );
+  _DiffIntern( diff, diff.lines_r, diff.ids_r );
+
+  _DiffLines( diff, algo );
+
+  // matched lines pair up one to one, in order, so hunks are just the runs between them.
+  diff.hunks.len = 0;
+  diff.spans.len = 0;
+  auto changed_l = diff.changed_l.mem;
+  auto changed_r = diff.changed_r.mem;
+  auto nl = Cast( u32, diff.lines_l.len );
+  auto nr = Cast( u32, diff.lines_r.len );
+  u32 i = 0;
+  u32 j = 0;
+  Forever {
+    while( i < nl  &&  j < nr  &&  !changed_l[i]  &&  !changed_r[j] ) {
+      i += 1;
+      j += 1;
+    }
+    if( i == nl  &&  j == nr ) {
+      break;
+    }
+    auto hunk = AddBack( diff.hunks );
+    hunk->start_l = i;
+    hunk->start_r = j;
+    while( i < nl  &&  changed_l[i] ) {
+      i += 1;
+    }
+    while( j < nr  &&  changed_r[j] ) {
+      j += 1;
+    }
+    hunk->len_l = i - hunk->start_l;
+    hunk->len_r = j - hunk->start_r;
+    hunk->spans_start = 0;
+    hunk->spans_len = 0;
+  }
+
+  if( intraline ) {
+    FORLEN( hunk, h, diff.hunks )
+      _DiffRefineHunk( diff, *hunk );
+    }
+  }
+}
+
+RegisterTest([]()
+{
+  diff_t diff;
+  Init( diff );
+
+  auto CheckScript = [&]( slice_t file_l, slice_t file_r ) -> idx_t
+  {
+    // every unchanged line must pair with an equal line on the other side.
+    idx_t nunchanged = 0;
+    idx_t i = 0;
+    idx_t j = 0;
+    Forever {
+      while( i < diff.lines_l.len  &&  diff.changed_l.mem[i] ) {
+        i += 1;
+      }
+      while( j < diff.lines_r.len  &&  diff.changed_r.mem[j] ) {
+        j += 1;
+      }
+      if( i == diff.lines_l.len  ||  j == diff.lines_r.len ) {
+        AssertCrash( i == diff.lines_l.len );
+        AssertCrash( j == diff.lines_r.len );
+        break;
+      }
+      AssertCrash( diff.ids_l.mem[i] == diff.ids_r.mem[j] );
+      AssertCrash( MemEqual( ML( diff.lines_l.mem[i] ), ML( diff.lines_r.mem[j] ) ) );
+      nunchanged += 1;
+      i += 1;
+      j += 1;
+    }
+    // hunks must cover exactly the changed lines.
+    idx_t nchanged_l = 0;
+    idx_t nchanged_r = 0;
+    FORLEN( hunk, h, diff.hunks )
+      For( t, 0, hunk->len_l ) {
+        AssertCrash( diff.changed_l.mem[ hunk->start_l + t ] );
+      }
+      For( t, 0, hunk->len_r ) {
+        AssertCrash( diff.changed_r.mem[ hunk->start_r + t ] );
+      }
+      nchanged_l += hunk->len_l;
+      nchanged_r += hunk->len_r;
+    }
+    AssertCrash( nchanged_l + nunchanged == diff.lines_l.len );
+    AssertCrash( nchanged_r + nunchanged == diff.lines_r.len );
+    return nunchanged;
+  };
+
+  {
+    auto file_l = SliceFromCStr( "a\nb\r\nc\rd\n" );
+    auto file_r = SliceFromCStr( "a\nx\nc\nd" );
+    DiffFiles( diff, file_l, file_r, diffalgo_t::myers, 1 );
+    AssertCrash( diff.lines_l.len == 4 );
+    AssertCrash( diff.lines_r.len == 4 );
+    AssertCrash( diff.nids == 5 );
+    AssertCrash( diff.hunks.len == 1 );
+    auto hunk = diff.hunks.mem[0];
+    AssertCrash( hunk.start_l == 1  &&  hunk.len_l == 1 );
+    AssertCrash( hunk.start_r == 1  &&  hunk.len_r == 1 );
+    AssertCrash( hunk.spans_len == 2 );
+    AssertCrash( !diff.spans.mem[0].right  &&  diff.spans.mem[0].start == 0  &&  diff.spans.mem[0].len == 1 );
+    AssertCrash( diff.spans.mem[1].right  &&  diff.spans.mem[1].start == 0  &&  diff.spans.mem[1].len == 1 );
+  }
+
+  {
+    // intra-line spans only cover the changed bytes.
+    auto file_l = SliceFromCStr( "same\n  x = foo( 1 );\nsame\n" );
+    auto file_r = SliceFromCStr( "same\n  x = foo( 22 );\nsame\n" );
+    DiffFiles( diff, file_l, file_r, diffalgo_t::histogram, 1 );
+    AssertCrash( diff.hunks.len == 1 );
+    AssertCrash( diff.hunks.mem[0].spans_len == 2 );
+    auto span_l = diff.spans.mem[ diff.hunks.mem[0].spans_start + 0 ];
+    auto span_r = diff.spans.mem[ diff.hunks.mem[0].spans_start + 1 ];
+    AssertCrash( span_l.line == 1  &&  span_l.start == 11  &&  span_l.len == 1 );
+    AssertCrash( span_r.line == 1  &&  span_r.start == 11  &&  span_r.len == 2 );
+  }
+
+  {
+    // patience/histogram shouldn't match the braces of the deleted function with the kept one.
+    auto file_l = SliceFromCStr( "f()\n{\n  one;\n}\ng()\n{\n  two;\n}\n" );
+    auto file_r = SliceFromCStr( "g()\n{\n  two;\n}\n" );
+    For( algo, 0, Cast( idx_t, diffalgo_t::COUNT ) ) {
+      DiffFiles( diff, file_l, file_r, Cast( diffalgo_t, algo ), 0 );
+      AssertCrash( CheckScript( file_l, file_r ) == 4 );
+      AssertCrash( diff.hunks.len == 1 );
+      AssertCrash( diff.hunks.mem[0].start_l == 0  &&  diff.hunks.mem[0].len_l == 4 );
+    }
+  }
+
+  // random edits over a small alphabet, so there's plenty of ambiguity.
+  // myers must find the lcs, which we check against the quadratic dp.
+  rng_xorshift32_t rng;
+  Init( rng, 1234 );
+  stack_resizeable_cont_t<u8> file_l;
+  stack_resizeable_cont_t<u8> file_r;
+  stack_resizeable_cont_t<u32> lcs;
+  Alloc( file_l, 1024 );
+  Alloc( file_r, 1024 );
+  Alloc( lcs, 1024 );
+  For( trial, 0, 300 ) {
+    file_l.len = 0;
+    file_r.len = 0;
+    auto nl = Rand32( rng ) % 60;
+    auto alphabet = 2 + Rand32( rng ) % 8;
+    For( t, 0, nl ) {
+      auto line = AddBack( file_l, 2 );
+      line[0] = Cast( u8, 'a' + Rand32( rng ) % alphabet );
+      line[1] = '\n';
+    }
+    For( t, 0, nl ) {
+      auto c = file_l.mem[ 2 * t ];
+      switch( Rand32( rng ) % 4 ) {
+        case 0: break;
+        case 1: c = Cast( u8, 'a' + Rand32( rng ) % alphabet ); __fallthrough;
+        default: {
+          auto line = AddBack( file_r, 2 );
+          line[0] = c;
+          line[1] = '\n';
+        } break;
+      }
+      if( Rand32( rng ) % 8 == 0 ) {
+        auto line = AddBack( file_r, 2 );
+        line[0] = Cast( u8, 'a' + Rand32( rng ) % alphabet );
+        line[1] = '\n';
+      }
+    }
+    auto nr = file_r.len / 2;
+    auto stride = nr + 1;
+    _DiffResize( lcs, ( nl + 1 ) * stride );
+    For( i, 0, nl + 1 ) {
+      For( j, 0, nr + 1 ) {
+        u32 v = 0;
+        if( i  &&  j ) {
+          v = MAX( lcs.mem[ ( i - 1 ) * stride + j ], lcs.mem[ i * stride + j - 1 ] );
+          if( file_l.mem[ 2 * ( i - 1 ) ] == file_r.mem[ 2 * ( j - 1 ) ] ) {
+            v = MAX( v, lcs.mem[ ( i - 1 ) * stride + j - 1 ] + 1 );
+          }
+        }
+        lcs.mem[ i * stride + j ] = v;
+      }
+    }
+    auto expected = lcs.mem[ nl * stride + nr ];
+    For( algo, 0, Cast( idx_t, diffalgo_t::COUNT ) ) {
+      DiffFiles( diff, SliceFromArray( file_l ), SliceFromArray( file_r ), Cast( diffalgo_t, algo ), 1 );
+      auto nunchanged = CheckScript( SliceFromArray( file_l ), SliceFromArray( file_r ) );
+      AssertCrash( nunchanged <= expected );
+      if( Cast( diffalgo_t, algo ) == diffalgo_t::myers ) {
+        AssertCrash( nunchanged == expected );
+      }
+    }
+  }
+  Free( lcs );
+  Free( file_r );
+  Free( file_l );
+
+  Kill( diff );
+});
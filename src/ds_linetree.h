@@ -0,0 +1,733 @@
+// Copyright (c) John A. Carlos Jr., all rights reserved.
+
+//
+// ordered sequence of u32 values, indexed by position, with a u32 len per value.
+// this is what buf_t uses to map line space to internal line idxs, replacing the plain array that made
+// every line ins/del O( num_lines ).
+//
+// it's a B+ tree with no keys; interior nodes store per-child subtree line counts and byte counts instead.
+// so descending by position is a short linear scan per level, and descending by linear offset works the same way,
+// just scanning bytes + lines * eol_len instead of lines.
+//
+// lookup, insert, remove, and len changes are all O( log num_lines ).
+// leaves are linked, so in-order iteration is O( 1 ) per step.
+//
+// appending at the very end of a full node doesn't split it in half, it starts a fresh node instead.
+// that way sequential loading fills every node, rather than leaving them all half-empty.
+//
+
+constant u32 c_linetree_leaf_cap = 128;
+constant u32 c_linetree_interior_cap = 32;
+constant u32 c_linetree_max_height = 8; // 32^7 * 128 is way past u32 lines.
+
+struct
+linetree_leaf_t
+{
+  u32 len;
+  u32 values[c_linetree_leaf_cap];
+  u32 lens[c_linetree_leaf_cap];
+  linetree_leaf_t* prev;
+  linetree_leaf_t* next;
+};
+
+struct
+linetree_interior_t
+{
+  u32 len;
+  u32 nlines[c_linetree_interior_cap];
+  u64 nbytes[c_linetree_interior_cap];
+  void* children[c_linetree_interior_cap]; // leaves when this is at height 1, interiors otherwise.
+};
+
+struct
+linetree_t
+{
+  void* root; // a leaf when height is 0.
+  u32 height;
+  u32 nlines;
+  u64 nbytes;
+};
+
+// the interiors we passed through on the way down to a leaf, and which child we took in each.
+// level 0 is the root.
+struct
+linetree_path_t
+{
+  linetree_interior_t* nodes[c_linetree_max_height];
+  u32 idxs[c_linetree_max_height];
+};
+
+Inl linetree_leaf_t*
+_LinetreeAllocLeaf()
+{
+  auto leaf = MemHeapAlloc( linetree_leaf_t, 1 );
+  leaf->len = 0;
+  leaf->prev = 0;
+  leaf->next = 0;
+  return leaf;
+}
+
+Inl linetree_interior_t*
+_LinetreeAllocInterior()
+{
+  auto node = MemHeapAlloc( linetree_interior_t, 1 );
+  node->len = 0;
+  return node;
+}
+
+Inl void
+Zero( linetree_t& tree )
+{
+  tree.root = 0;
+  tree.height = 0;
+  tree.nlines = 0;
+  tree.nbytes = 0;
+}
+
+Inl void
+Init( linetree_t& tree )
+{
+  Zero( tree );
+  tree.root = _LinetreeAllocLeaf();
+}
+
+void
+_LinetreeFree( void* node, u32 height )
+{
+  if( height ) {
+    auto interior = Cast( linetree_interior_t*, node );
+    Fori( u32, i, 0, interior->len ) {
+      _LinetreeFree( interior->children[i], height - 1 );
+    }
+    MemHeapFree( interior );
+  }
+  else {
+    auto leaf = Cast( linetree_leaf_t*, node );
+    MemHeapFree( leaf );
+  }
+}
+
+Inl void
+Kill( linetree_t& tree )
+{
+  if( tree.root ) {
+    _LinetreeFree( tree.root, tree.height );
+  }
+  Zero( tree );
+}
+
+Inl u64
+_LinetreeLeafBytes( linetree_leaf_t* leaf )
+{
+  u64 r = 0;
+  Fori( u32, i, 0, leaf->len ) {
+    r += leaf->lens[i];
+  }
+  return r;
+}
+
+Inl void
+_LinetreeChildCounts( void* child, u32 height, u32* nlines, u64* nbytes )
+{
+  if( height ) {
+    auto interior = Cast( linetree_interior_t*, child );
+    *nlines = 0;
+    *nbytes = 0;
+    Fori( u32, i, 0, interior->len ) {
+      *nlines += interior->nlines[i];
+      *nbytes += interior->nbytes[i];
+    }
+  }
+  else {
+    auto leaf = Cast( linetree_leaf_t*, child );
+    *nlines = leaf->len;
+    *nbytes = _LinetreeLeafBytes( leaf );
+  }
+}
+
+// y == tree.nlines is allowed, and lands one past the end of the last leaf, for appending.
+Inl linetree_leaf_t*
+_LinetreeDescend( linetree_t& tree, u32 y, linetree_path_t* path, u32* idx_in_leaf )
+{
+  AssertCrash( y <= tree.nlines );
+  auto node = tree.root;
+  Fori( u32, level, 0, tree.height ) {
+    auto interior = Cast( linetree_interior_t*, node );
+    AssertCrash( interior->len );
+    u32 i = 0;
+    while( i + 1 < interior->len  &&  y >= interior->nlines[i] ) {
+      y -= interior->nlines[i];
+      i += 1;
+    }
+    path->nodes[level] = interior;
+    path->idxs[level] = i;
+    node = interior->children[i];
+  }
+  auto leaf = Cast( linetree_leaf_t*, node );
+  AssertCrash( y <= leaf->len );
+  *idx_in_leaf = y;
+  return leaf;
+}
+
+Inl u32*
+LinetreeLookup( linetree_t& tree, u32 y )
+{
+  AssertCrash( y < tree.nlines );
+  auto node = tree.root;
+  Fori( u32, level, 0, tree.height ) {
+    auto interior = Cast( linetree_interior_t*, node );
+    u32 i = 0;
+    while( y >= interior->nlines[i] ) {
+      y -= interior->nlines[i];
+      i += 1;
+    }
+    node = interior->children[i];
+  }
+  auto leaf = Cast( linetree_leaf_t*, node );
+  AssertCrash( y < leaf->len );
+  return leaf->values + y;
+}
+
+// inserts child at idx of the interior at the given path level, whose counts are nlines / nbytes.
+// splits up the path as needed; a root split grows the tree by one level.
+void
+_LinetreeInsertChild(
+  linetree_t& tree,
+  linetree_path_t* path,
+  u32 level, // level of the interior we're inserting into, or -1 for 'above the root'.
+  u32 idx,
+  void* child,
+  u32 child_nlines,
+  u64 child_nbytes
+  )
+{
+  if( level == MAX_u32 ) {
+    // the old root split, so make a new root above it.
+    auto root = _LinetreeAllocInterior();
+    auto old_root = tree.root;
+    u32 old_nlines;
+    u64 old_nbytes;
+    _LinetreeChildCounts( old_root, tree.height, &old_nlines, &old_nbytes );
+    root->len = 2;
+    root->children[0] = old_root;
+    root->nlines[0] = old_nlines;
+    root->nbytes[0] = old_nbytes;
+    root->children[1] = child;
+    root->nlines[1] = child_nlines;
+    root->nbytes[1] = child_nbytes;
+    tree.root = root;
+    tree.height += 1;
+    AssertCrash( tree.height < c_linetree_max_height );
+    return;
+  }
+
+  auto node = path->nodes[level];
+  AssertCrash( idx <= node->len );
+  if( node->len < c_linetree_interior_cap ) {
+    auto nmove = node->len - idx;
+    Memmove( node->children + idx + 1, node->children + idx, nmove * sizeof( node->children[0] ) );
+    Memmove( node->nlines + idx + 1, node->nlines + idx, nmove * sizeof( node->nlines[0] ) );
+    Memmove( node->nbytes + idx + 1, node->nbytes + idx, nmove * sizeof( node->nbytes[0] ) );
+    node->children[idx] = child;
+    node->nlines[idx] = child_nlines;
+    node->nbytes[idx] = child_nbytes;
+    node->len += 1;
+    return;
+  }
+
+  // full, so split.
+  auto right = _LinetreeAllocInterior();
+  auto split = ( idx == node->len )  ?  node->len  :  node->len / 2;
+  right->len = node->len - split;
+  Memmove( right->children, node->children + split, right->len * sizeof( node->children[0] ) );
+  Memmove( right->nlines, node->nlines + split, right->len * sizeof( node->nlines[0] ) );
+  Memmove( right->nbytes, node->nbytes + split, right->len * sizeof( node->nbytes[0] ) );
+  node->len = split;
+  auto dst = node;
+  if( idx >= split ) {
+    dst = right;
+    idx -= split;
+  }
+  auto nmove = dst->len - idx;
+  Memmove( dst->children + idx + 1, dst->children + idx, nmove * sizeof( dst->children[0] ) );
+  Memmove( dst->nlines + idx + 1, dst->nlines + idx, nmove * sizeof( dst->nlines[0] ) );
+  Memmove( dst->nbytes + idx + 1, dst->nbytes + idx, nmove * sizeof( dst->nbytes[0] ) );
+  dst->children[idx] = child;
+  dst->nlines[idx] = child_nlines;
+  dst->nbytes[idx] = child_nbytes;
+  dst->len += 1;
+
+  // our parent's count for node is stale now, so fix it before we hand it the right half.
+  u32 right_nlines;
+  u64 right_nbytes;
+  _LinetreeChildCounts( right, 1, &right_nlines, &right_nbytes );
+  if( level ) {
+    auto parent = path->nodes[ level - 1 ];
+    auto parent_idx = path->idxs[ level - 1 ];
+    parent->nlines[ parent_idx ] -= right_nlines;
+    parent->nbytes[ parent_idx ] -= right_nbytes;
+  }
+  _LinetreeInsertChild(
+    tree,
+    path,
+    level ? level - 1 : MAX_u32,
+    level ? path->idxs[ level - 1 ] + 1 : 0,
+    right,
+    right_nlines,
+    right_nbytes
+    );
+}
+
+Inl void
+LinetreeInsert( linetree_t& tree, u32 y, u32 value, u32 len )
+{
+  AssertCrash( tree.nlines < MAX_u32 );
+  linetree_path_t path;
+  u32 idx;
+  auto leaf = _LinetreeDescend( tree, y, &path, &idx );
+  Fori( u32, level, 0, tree.height ) {
+    path.nodes[level]->nlines[ path.idxs[level] ] += 1;
+    path.nodes[level]->nbytes[ path.idxs[level] ] += len;
+  }
+  tree.nlines += 1;
+  tree.nbytes += len;
+
+  if( leaf->len < c_linetree_leaf_cap ) {
+    auto nmove = leaf->len - idx;
+    Memmove( leaf->values + idx + 1, leaf->values + idx, nmove * sizeof( leaf->values[0] ) );
+    Memmove( leaf->lens + idx + 1, leaf->lens + idx, nmove * sizeof( leaf->lens[0] ) );
+    leaf->values[idx] = value;
+    leaf->lens[idx] = len;
+    leaf->len += 1;
+    return;
+  }
+
+  // full, so split.
+  auto right = _LinetreeAllocLeaf();
+  auto split = ( idx == leaf->len )  ?  leaf->len  :  leaf->len / 2;
+  right->len = leaf->len - split;
+  Memmove( right->values, leaf->values + split, right->len * sizeof( leaf->values[0] ) );
+  Memmove( right->lens, leaf->lens + split, right->len * sizeof( leaf->lens[0] ) );
+  leaf->len = split;
+  right->next = leaf->next;
+  right->prev = leaf;
+  if( leaf->next ) {
+    leaf->next->prev = right;
+  }
+  leaf->next = right;
+  auto dst = leaf;
+  if( idx >= split ) {
+    dst = right;
+    idx -= split;
+  }
+  auto nmove = dst->len - idx;
+  Memmove( dst->values + idx + 1, dst->values + idx, nmove * sizeof( dst->values[0] ) );
+  Memmove( dst->lens + idx + 1, dst->lens + idx, nmove * sizeof( dst->lens[0] ) );
+  dst->values[idx] = value;
+  dst->lens[idx] = len;
+  dst->len += 1;
+
+  auto right_nlines = right->len;
+  auto right_nbytes = _LinetreeLeafBytes( right );
+  if( tree.height ) {
+    auto parent = path.nodes[ tree.height - 1 ];
+    auto parent_idx = path.idxs[ tree.height - 1 ];
+    parent->nlines[ parent_idx ] -= right_nlines;
+    parent->nbytes[ parent_idx ] -= right_nbytes;
+  }
+  _LinetreeInsertChild(
+    tree,
+    &path,
+    tree.height ? tree.height - 1 : MAX_u32,
+    tree.height ? path.idxs[ tree.height - 1 ] + 1 : 0,
+    right,
+    right_nlines,
+    right_nbytes
+    );
+}
+
+Inl void
+LinetreeAppend( linetree_t& tree, u32 value, u32 len )
+{
+  LinetreeInsert( tree, tree.nlines, value, len );
+}
+
+// bulk loading, for when nlines is known up front and the lines get filled in out of order, e.g. in parallel.
+// LinetreeBulkAlloc lays out full leaves in order, so line y lives at leaves[ y / c_linetree_leaf_cap ].
+// callers fill in every value and len, and then LinetreeBulkFinish builds the interiors and counts.
+Inl void
+LinetreeBulkAlloc( linetree_t& tree, u32 nlines, stack_resizeable_cont_t<linetree_leaf_t*>* leaves )
+{
+  AssertCrash( !tree.root );
+  auto nleaves = MAX( 1u, ( nlines + c_linetree_leaf_cap - 1 ) / c_linetree_leaf_cap );
+  Reserve( *leaves, nleaves );
+  leaves->len = 0;
+  linetree_leaf_t* prev = 0;
+  Fori( u32, i, 0, nleaves ) {
+    auto leaf = _LinetreeAllocLeaf();
+    leaf->len = MIN( c_linetree_leaf_cap, nlines - i * c_linetree_leaf_cap );
+    leaf->prev = prev;
+    if( prev ) {
+      prev->next = leaf;
+    }
+    prev = leaf;
+    *AddBack( *leaves ) = leaf;
+  }
+}
+
+Inl void
+LinetreeBulkFinish( linetree_t& tree, stack_resizeable_cont_t<linetree_leaf_t*>* leaves )
+{
+  AssertCrash( !tree.root );
+  AssertCrash( leaves->len );
+
+  // build one level at a time, in place over the leaves array.
+  auto nodes = Cast( void**, leaves->mem );
+  auto nnodes = leaves->len;
+  u32 height = 0;
+  tree.nlines = 0;
+  tree.nbytes = 0;
+  FORLEN( leaf, i, *leaves )
+    tree.nlines += ( *leaf )->len;
+    tree.nbytes += _LinetreeLeafBytes( *leaf );
+  }
+  while( nnodes > 1 ) {
+    idx_t nparents = 0;
+    for( idx_t i = 0;  i < nnodes;  i += c_linetree_interior_cap ) {
+      auto parent = _LinetreeAllocInterior();
+      auto nchildren = MIN( Cast( idx_t, c_linetree_interior_cap ), nnodes - i );
+      Fori( u32, j, 0, Cast( u32, nchildren ) ) {
+        auto child = nodes[ i + j ];
+        parent->children[j] = child;
+        _LinetreeChildCounts( child, height, parent->nlines + j, parent->nbytes + j );
+      }
+      parent->len = Cast( u32, nchildren );
+      nodes[ nparents++ ] = parent;
+    }
+    nnodes = nparents;
+    height += 1;
+    AssertCrash( height < c_linetree_max_height );
+  }
+  tree.root = nodes[0];
+  tree.height = height;
+  leaves->len = 0;
+}
+
+// removes child idx from the interior at the given path level, freeing nothing; the caller owns child.
+// empty interiors get removed from their parents in turn, and small ones merge with a sibling.
+void
+_LinetreeRemoveChild( linetree_t& tree, linetree_path_t* path, u32 level, u32 idx )
+{
+  auto node = path->nodes[level];
+  AssertCrash( idx < node->len );
+  auto nmove = node->len - idx - 1;
+  Memmove( node->children + idx, node->children + idx + 1, nmove * sizeof( node->children[0] ) );
+  Memmove( node->nlines + idx, node->nlines + idx + 1, nmove * sizeof( node->nlines[0] ) );
+  Memmove( node->nbytes + idx, node->nbytes + idx + 1, nmove * sizeof( node->nbytes[0] ) );
+  node->len -= 1;
+
+  if( !level ) {
+    // collapse a root with only one child, so lookups don't walk through useless levels.
+    if( node->len == 1 ) {
+      tree.root = node->children[0];
+      tree.height -= 1;
+      MemHeapFree( node );
+    }
+    return;
+  }
+
+  auto parent = path->nodes[ level - 1 ];
+  auto parent_idx = path->idxs[ level - 1 ];
+  if( !node->len ) {
+    MemHeapFree( node );
+    _LinetreeRemoveChild( tree, path, level - 1, parent_idx );
+    return;
+  }
+
+  // merge with a neighbor when both fit comfortably in one node.
+  if( node->len < c_linetree_interior_cap / 4  &&  parent->len > 1 ) {
+    auto l_idx = ( parent_idx + 1 < parent->len )  ?  parent_idx  :  parent_idx - 1;
+    auto l = Cast( linetree_interior_t*, parent->children[ l_idx ] );
+    auto r = Cast( linetree_interior_t*, parent->children[ l_idx + 1 ] );
+    if( l->len + r->len <= ( 3 * c_linetree_interior_cap ) / 4 ) {
+      Memmove( l->children + l->len, r->children, r->len * sizeof( r->children[0] ) );
+      Memmove( l->nlines + l->len, r->nlines, r->len * sizeof( r->nlines[0] ) );
+      Memmove( l->nbytes + l->len, r->nbytes, r->len * sizeof( r->nbytes[0] ) );
+      l->len += r->len;
+      parent->nlines[ l_idx ] += parent->nlines[ l_idx + 1 ];
+      parent->nbytes[ l_idx ] += parent->nbytes[ l_idx + 1 ];
+      MemHeapFree( r );
+      _LinetreeRemoveChild( tree, path, level - 1, l_idx + 1 );
+    }
+  }
+}
+
+Inl void
+LinetreeRemove( linetree_t& tree, u32 y, u32* value )
+{
+  AssertCrash( y < tree.nlines );
+  linetree_path_t path;
+  u32 idx;
+  auto leaf = _LinetreeDescend( tree, y, &path, &idx );
+  AssertCrash( idx < leaf->len );
+  auto len = leaf->lens[idx];
+  if( value ) {
+    *value = leaf->values[idx];
+  }
+  Fori( u32, level, 0, tree.height ) {
+    path.nodes[level]->nlines[ path.idxs[level] ] -= 1;
+    path.nodes[level]->nbytes[ path.idxs[level] ] -= len;
+  }
+  tree.nlines -= 1;
+  tree.nbytes -= len;
+
+  auto nmove = leaf->len - idx - 1;
+  Memmove( leaf->values + idx, leaf->values + idx + 1, nmove * sizeof( leaf->values[0] ) );
+  Memmove( leaf->lens + idx, leaf->lens + idx + 1, nmove * sizeof( leaf->lens[0] ) );
+  leaf->len -= 1;
+
+  if( !tree.height ) {
+    return;
+  }
+  auto level = tree.height - 1;
+  auto parent = path.nodes[level];
+  auto parent_idx = path.idxs[level];
+
+  if( !leaf->len ) {
+    if( leaf->prev ) leaf->prev->next = leaf->next;
+    if( leaf->next ) leaf->next->prev = leaf->prev;
+    MemHeapFree( leaf );
+    _LinetreeRemoveChild( tree, &path, level, parent_idx );
+    return;
+  }
+
+  // merge with a neighbor when both fit comfortably in one leaf.
+  if( leaf->len < c_linetree_leaf_cap / 4  &&  parent->len > 1 ) {
+    auto l_idx = ( parent_idx + 1 < parent->len )  ?  parent_idx  :  parent_idx - 1;
+    auto l = Cast( linetree_leaf_t*, parent->children[ l_idx ] );
+    auto r = Cast( linetree_leaf_t*, parent->children[ l_idx + 1 ] );
+    if( l->len + r->len <= ( 3 * c_linetree_leaf_cap ) / 4 ) {
+      Memmove( l->values + l->len, r->values, r->len * sizeof( r->values[0] ) );
+      Memmove( l->lens + l->len, r->lens, r->len * sizeof( r->lens[0] ) );
+      l->len += r->len;
+      l->next = r->next;
+      if( r->next ) r->next->prev = l;
+      parent->nlines[ l_idx ] += parent->nlines[ l_idx + 1 ];
+      parent->nbytes[ l_idx ] += parent->nbytes[ l_idx + 1 ];
+      MemHeapFree( r );
+      _LinetreeRemoveChild( tree, &path, level, l_idx + 1 );
+    }
+  }
+}
+
+// call this whenever the len of the value at y changes, to keep the byte counts right.
+Inl void
+LinetreeSetLen( linetree_t& tree, u32 y, u32 len )
+{
+  linetree_path_t path;
+  u32 idx;
+  auto leaf = _LinetreeDescend( tree, y, &path, &idx );
+  AssertCrash( idx < leaf->len );
+  auto len_old = leaf->lens[idx];
+  leaf->lens[idx] = len;
+  Fori( u32, level, 0, tree.height ) {
+    path.nodes[level]->nbytes[ path.idxs[level] ] -= len_old;
+    path.nodes[level]->nbytes[ path.idxs[level] ] += len;
+  }
+  tree.nbytes -= len_old;
+  tree.nbytes += len;
+}
+
+// linear space -> line space, treating every value as followed by eol_len bytes.
+// returns 0 if offset is past the end.
+Inl bool
+LinetreeFromOffset( linetree_t& tree, u64 offset, u32 eol_len, u32* y, u64* offset_inline )
+{
+  if( offset >= tree.nbytes + Cast( u64, tree.nlines ) * eol_len ) {
+    return 0;
+  }
+  u32 r = 0;
+  auto node = tree.root;
+  Fori( u32, level, 0, tree.height ) {
+    auto interior = Cast( linetree_interior_t*, node );
+    u32 i = 0;
+    for( ;; ) {
+      auto span = interior->nbytes[i] + Cast( u64, interior->nlines[i] ) * eol_len;
+      if( offset < span ) {
+        break;
+      }
+      offset -= span;
+      r += interior->nlines[i];
+      i += 1;
+      AssertCrash( i < interior->len );
+    }
+    node = interior->children[i];
+  }
+  auto leaf = Cast( linetree_leaf_t*, node );
+  u32 i = 0;
+  for( ;; ) {
+    AssertCrash( i < leaf->len );
+    auto span = Cast( u64, leaf->lens[i] ) + eol_len;
+    if( offset < span ) {
+      break;
+    }
+    offset -= span;
+    i += 1;
+  }
+  *y = r + i;
+  *offset_inline = offset;
+  return 1;
+}
+
+// in-order iteration. note any insert / remove invalidates this, but SetLen doesn't.
+struct
+linetree_iter_t
+{
+  linetree_leaf_t* leaf;
+  u32 idx;
+  u32 y;
+};
+
+Inl linetree_iter_t
+LinetreeIter( linetree_t& tree, u32 y )
+{
+  linetree_path_t path;
+  linetree_iter_t iter;
+  iter.leaf = _LinetreeDescend( tree, y, &path, &iter.idx );
+  iter.y = y;
+  return iter;
+}
+
+Inl void
+LinetreeIterNext( linetree_iter_t& iter )
+{
+  iter.y += 1;
+  iter.idx += 1;
+  if( iter.idx >= iter.leaf->len  &&  iter.leaf->next ) {
+    iter.leaf = iter.leaf->next;
+    iter.idx = 0;
+  }
+}
+
+Inl u32*
+LinetreeIterValue( linetree_iter_t& iter )
+{
+  AssertCrash( iter.idx < iter.leaf->len );
+  return iter.leaf->values + iter.idx;
+}
+
+
+
+RegisterTest([]()
+{
+  // fuzz against a plain array.
+  rng_xorshift32_t rng;
+  Init( rng, 1234 );
+
+  linetree_t tree;
+  Init( tree );
+  stack_resizeable_cont_t<u32> values;
+  Alloc( values, 1024 );
+  stack_resizeable_cont_t<u32> lens;
+  Alloc( lens, 1024 );
+
+  auto Check = [&]()
+  {
+    AssertCrash( tree.nlines == values.len );
+    u64 nbytes = 0;
+    auto iter = LinetreeIter( tree, 0 );
+    Fori( u32, y, 0, Cast( u32, values.len ) ) {
+      AssertCrash( *LinetreeLookup( tree, y ) == values.mem[y] );
+      AssertCrash( *LinetreeIterValue( iter ) == values.mem[y] );
+      LinetreeIterNext( iter );
+      nbytes += lens.mem[y];
+    }
+    AssertCrash( tree.nbytes == nbytes );
+    constant u32 eol_len = 2;
+    u64 offset = 0;
+    Fori( u32, y, 0, Cast( u32, values.len ) ) {
+      u32 y_found;
+      u64 x_found;
+      AssertCrash( LinetreeFromOffset( tree, offset + lens.mem[y], eol_len, &y_found, &x_found ) );
+      AssertCrash( y_found == y );
+      AssertCrash( x_found == lens.mem[y] );
+      offset += lens.mem[y] + eol_len;
+    }
+    u32 y_found;
+    u64 x_found;
+    AssertCrash( !LinetreeFromOffset( tree, offset, eol_len, &y_found, &x_found ) );
+  };
+
+  u32 next_value = 0;
+  For( round, 0, 40 ) {
+    // alternate growing and shrinking phases, so we exercise splits and merges at several heights.
+    auto grow = ( round % 4 ) < 2;
+    auto nops = 50 + Rand32( rng ) % 3000;
+    For( op, 0, nops ) {
+      auto r = Rand32( rng ) % 100;
+      if( !values.len  ||  ( grow  &&  r < 70 )  ||  ( !grow  &&  r < 25 ) ) {
+        auto y = ( r % 3 )  ?  Rand32( rng ) % ( values.len + 1 )  :  Cast( u32, values.len );
+        auto len = Rand32( rng ) % 100;
+        LinetreeInsert( tree, y, next_value, len );
+        *AddAt( values, y ) = next_value;
+        *AddAt( lens, y ) = len;
+        next_value += 1;
+      }
+      elif( r < 90 ) {
+        auto y = Rand32( rng ) % values.len;
+        u32 removed;
+        LinetreeRemove( tree, y, &removed );
+        AssertCrash( removed == values.mem[y] );
+        RemAt( values, y );
+        RemAt( lens, y );
+      }
+      else {
+        auto y = Rand32( rng ) % values.len;
+        auto len = Rand32( rng ) % 100;
+        LinetreeSetLen( tree, y, len );
+        lens.mem[y] = len;
+      }
+    }
+    Check();
+  }
+
+  // bulk load, then keep fuzzing on top of it.
+  Kill( tree );
+  {
+    auto nlines = 3 * c_linetree_leaf_cap * c_linetree_interior_cap + 57;
+    stack_resizeable_cont_t<linetree_leaf_t*> leaves;
+    Alloc( leaves, 16 );
+    LinetreeBulkAlloc( tree, nlines, &leaves );
+    values.len = 0;
+    lens.len = 0;
+    Fori( u32, y, 0, nlines ) {
+      auto len = Rand32( rng ) % 100;
+      auto leaf = leaves.mem[ y / c_linetree_leaf_cap ];
+      leaf->values[ y % c_linetree_leaf_cap ] = y;
+      leaf->lens[ y % c_linetree_leaf_cap ] = len;
+      *AddBack( values ) = y;
+      *AddBack( lens ) = len;
+    }
+    LinetreeBulkFinish( tree, &leaves );
+    Free( leaves );
+    Check();
+    For( op, 0, 2000 ) {
+      auto y = Rand32( rng ) % values.len;
+      if( op % 2 ) {
+        LinetreeInsert( tree, y, nlines + op, 7 );
+        *AddAt( values, y ) = nlines + op;
+        *AddAt( lens, y ) = 7;
+      }
+      else {
+        LinetreeRemove( tree, y, 0 );
+        RemAt( values, y );
+        RemAt( lens, y );
+      }
+    }
+    Check();
+  }
+
+  Free( lens );
+  Free( values );
+  Kill( tree );
+});
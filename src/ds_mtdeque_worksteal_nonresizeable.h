@@ -0,0 +1,110 @@
+// Copyright (c) John A. Carlos Jr., all rights reserved.
+
+// chase-lev work-stealing deque, fixed elemsize.
+// the single owner thread pushes and pops at the bottom, LIFO.
+// any number of other threads steal from the top, FIFO.
+// the owner only touches shared state with a CAS when it's racing the stealers for the last element.
+//
+// top and bottom only ever increase, and we mask them into mem; capacity has to be a power of 2.
+// a steal can read a slot that the owner is concurrently overwriting, but only when top has already moved past it,
+// so that steal's CAS fails and the torn copy gets thrown away.
+//
+// note this needs MemoryFence from thread_atomics.h, so include it after that.
+
+Templ struct
+mtdeque_worksteal_t
+{
+  T* mem;
+  volatile idx_t top;
+  volatile idx_t bottom;
+  idx_t capacity;
+};
+
+Templ Inl void
+Zero( mtdeque_worksteal_t<T>& deque )
+{
+  deque.mem = 0;
+  deque.top = 0;
+  deque.bottom = 0;
+  deque.capacity = 0;
+}
+
+Templ Inl void
+Alloc( mtdeque_worksteal_t<T>& deque, idx_t size )
+{
+  AssertCrash( IsPowerOf2( size ) );
+  Zero( deque );
+  deque.mem = MemHeapAlloc( T, size );
+  deque.capacity = size;
+}
+
+Templ Inl void
+Free( mtdeque_worksteal_t<T>& deque )
+{
+  MemHeapFree( deque.mem );
+  Zero( deque );
+}
+
+// approximate, since other threads may be pushing/stealing concurrently.
+Templ Inl bool
+IsEmpty( mtdeque_worksteal_t<T>& deque )
+{
+  return Cast( sidx_t, deque.bottom - deque.top ) <= 0;
+}
+
+// owner only.
+Templ Inl void
+PushS( mtdeque_worksteal_t<T>& deque, T* src, bool* success )
+{
+  idx_t b = deque.bottom;
+  idx_t t = deque.top;
+  if( b - t >= deque.capacity ) {
+    *success = 0;
+    return;
+  }
+  deque.mem[ b & ( deque.capacity - 1 ) ] = *src;
+  _ReadWriteBarrier();
+  deque.bottom = b + 1;
+  *success = 1;
+}
+
+// owner only.
+Templ Inl void
+PopS( mtdeque_worksteal_t<T>& deque, T* dst, bool* success )
+{
+  idx_t b = deque.bottom - 1;
+  deque.bottom = b;
+  // the bottom store has to be visible before we read top, or we could hand out the same element as a stealer.
+  MemoryFence();
+  idx_t t = deque.top;
+  if( Cast( sidx_t, b - t ) < 0 ) {
+    deque.bottom = b + 1;
+    *success = 0;
+    return;
+  }
+  *dst = deque.mem[ b & ( deque.capacity - 1 ) ];
+  if( b != t ) {
+    *success = 1;
+    return;
+  }
+  // last element, so race the stealers for it.
+  *success = CAS( &deque.top, t, t + 1 );
+  deque.bottom = b + 1;
+}
+
+// any thread but the owner.
+// note this fails if we lose a race with another stealer or the owner, even if the deque isn't empty.
+Templ Inl void
+StealM( mtdeque_worksteal_t<T>& deque, T* dst, bool* success )
+{
+  idx_t t = deque.top;
+  MemoryFence();
+  idx_t b = deque.bottom;
+  if( Cast( sidx_t, b - t ) <= 0 ) {
+    *success = 0;
+    return;
+  }
+  _ReadWriteBarrier();
+  *dst = deque.mem[ t & ( deque.capacity - 1 ) ];
+  *success = CAS( &deque.top, t, t + 1 );
+}
@@ -1,6 +1,8 @@
 // Copyright (c) John A. Carlos Jr., all rights reserved.
 
-void _ReadWriteBarrier();
+#ifndef MAC
+  void _ReadWriteBarrier();
+#endif
 
 // multi-reader, multi-writer circular queue, fixed elemsize.
 Templ struct
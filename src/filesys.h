@@ -50,6 +50,16 @@ _fsobj( const void* cstr )
     return !( f.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY );
   }
 #elif defined(MAC)
+  // nanoseconds since the epoch. only compared for equality, so the units don't have to match windows.
+  Inl u64
+  _GetFileTime( struct stat& info )
+  {
+  #if defined(__APPLE__)
+    return Cast( u64, info.st_mtimespec.tv_sec ) * 1000000000ull + Cast( u64, info.st_mtimespec.tv_nsec );
+  #else
+    return Cast( u64, info.st_mtim.tv_sec ) * 1000000000ull + Cast( u64, info.st_mtim.tv_nsec );
+  #endif
+  }
 #else
 #error Unsupported platform
 #endif
@@ -236,8 +246,15 @@ FsGetExe( u8* dst, idx_t dst_len, idx_t* exe_len )
   *exe_len = CstrLength( dst );
   _FixupFile( dst, exe_len );
 #elif defined(MAC)
+#if defined(__linux__)
+  auto r = readlink( "/proc/self/exe", Cast( char*, dst ), dst_len - 1 );
+  AssertWarn( r > 0 );
+  *exe_len = ( r > 0 )  ?  Cast( idx_t, r )  :  0;
+  dst[*exe_len] = 0;
+#else
   Memmove( dst, "~/apple-binary", 12 );
   *exe_len = 12;
+#endif
 #else
 #error Unsupported platform
 #endif
@@ -266,6 +283,10 @@ FsGetCwd( u8* dst, idx_t dst_len, idx_t* cwd_len )
   *cwd_len = CstrLength( dst );
   _FixupDir( dst, cwd_len );
 #elif defined(MAC)
+  auto res = getcwd( Cast( char*, dst ), dst_len );
+  AssertWarn( res );
+  *cwd_len = res  ?  CstrLength( dst )  :  0;
+  _FixupDir( dst, cwd_len );
 #else
 #error Unsupported platform
 #endif
@@ -313,6 +334,7 @@ Enumc( fsiter_result_t )
     bool is_file, \
     bool readonly, \
     u64 filesize, \
+    u64 filetime, \
     void* misc \
     )
 
@@ -350,7 +372,7 @@ FsIterate(
         bool readonly = f.dwFileAttributes & FILE_ATTRIBUTE_READONLY;
         u64 filesize = Pack( f.nFileSizeHigh, f.nFileSizeLow );
         auto normfile = _StandardFilename( ML( searchdir ) );
-        auto iter_result = FsIterator( ML( normfile ), 1, readonly, filesize, misc );
+        auto iter_result = FsIterator( ML( normfile ), 1, readonly, filesize, _GetFileTime( f ), misc );
         switch( iter_result ) {
           case fsiter_result_t::continue_: {
           } break;
@@ -364,7 +386,7 @@ FsIterate(
         auto filename_len = CstrLength( Cast( u8*, f.cFileName ) );
         Memmove( AddBack( searchdir, filename_len ), Cast( u8*, f.cFileName ), filename_len );
         auto normdir = _StandardDirname( ML( searchdir ) );
-        auto iter_result = FsIterator( ML( normdir ), 0, 0, 0, misc );
+        auto iter_result = FsIterator( ML( normdir ), 0, 0, 0, 0, misc );
         switch( iter_result ) {
           case fsiter_result_t::continue_: {
           } break;
@@ -385,6 +407,52 @@ NO_MORE_FILES:
   }
   Free( searchdirs );
 #elif defined(MAC)
+  stack_resizeable_cont_t<fsobj_t> searchdirs;
+  Alloc( searchdirs, 32 );
+  *AddBack( searchdirs ) = _StandardDirname( path, path_len );
+  while( searchdirs.len ) {
+    fsobj_t searchdir = searchdirs.mem[ searchdirs.len - 1 ];
+    RemBack( searchdirs );
+    DIR* d = opendir( Cast( char*, searchdir.mem ) );
+    if( !d ) {
+      continue;
+    }
+    *AddBack( searchdir ) = '/';
+    while( auto f = readdir( d ) ) {
+      auto filename_len = CstrLength( Cast( u8*, f->d_name ) );
+      if( StringEquals( Str( f->d_name ), filename_len, Str( "." ), 1, 1 )  ||
+          StringEquals( Str( f->d_name ), filename_len, Str( ".." ), 2, 1 ) ) {
+        continue;
+      }
+      if( searchdir.len + filename_len + 1 > Capacity( searchdir ) ) {
+        continue;
+      }
+      Memmove( AddBack( searchdir, filename_len ), Cast( u8*, f->d_name ), filename_len );
+      searchdir.mem[ searchdir.len ] = 0;
+      struct stat info;
+      auto iter_result = fsiter_result_t::continue_;
+      if( !stat( Cast( char*, searchdir.mem ), &info ) ) {
+        if( S_ISREG( info.st_mode ) ) {
+          bool readonly = !( info.st_mode & S_IWUSR );
+          auto normfile = _StandardFilename( ML( searchdir ) );
+          iter_result = FsIterator( ML( normfile ), 1, readonly, Cast( u64, info.st_size ), _GetFileTime( info ), misc );
+        } elif( S_ISDIR( info.st_mode ) ) {
+          auto normdir = _StandardDirname( ML( searchdir ) );
+          iter_result = FsIterator( ML( normdir ), 0, 0, 0, 0, misc );
+          if( recur ) {
+            *AddBack( searchdirs ) = normdir;
+          }
+        }
+      }
+      RemBack( searchdir, filename_len );
+      if( iter_result == fsiter_result_t::stop ) {
+        searchdirs.len = 0;
+        break;
+      }
+    }
+    closedir( d );
+  }
+  Free( searchdirs );
 #else
 #error Unsupported platform
 #endif
@@ -408,7 +476,12 @@ DirExists( u8* name, idx_t len )
   }
   return !!( attribs & FILE_ATTRIBUTE_DIRECTORY );
 #elif defined(MAC)
-  return 0;
+  fsobj_t dir = _StandardDirname( name, len );
+  struct stat info;
+  if( stat( Cast( char*, dir.mem ), &info ) ) {
+    return 0;
+  }
+  return S_ISDIR( info.st_mode );
 #else
 #error Unsupported platform
 #endif
@@ -441,7 +514,23 @@ DirCreate( u8* name, idx_t len )
   }
   return 1;
 #elif defined(MAC)
-  return 0;
+  fsobj_t dir = _StandardDirname( name, len );
+
+  // skip the leading slash of an absolute path, so we don't try to create the root.
+  For( i, 1, dir.len ) {
+    if( dir.mem[i] != '/' ) {
+      continue;
+    }
+    dir.mem[i] = 0;
+    if( !DirExists( dir.mem, i )  &&  mkdir( Cast( char*, dir.mem ), 0777 )  &&  errno != EEXIST ) {
+      return 0;
+    }
+    dir.mem[i] = '/';
+  }
+  if( mkdir( Cast( char*, dir.mem ), 0777 )  &&  errno != EEXIST ) {
+    return 0;
+  }
+  return 1;
 #else
 #error Unsupported platform
 #endif
@@ -458,7 +547,8 @@ FileDelete( u8* name, idx_t len )
   }
   return 1;
 #elif defined(MAC)
-  return 0;
+  fsobj_t file = _StandardFilename( name, len );
+  return !unlink( Cast( char*, file.mem ) );
 #else
 #error Unsupported platform
 #endif
@@ -699,17 +789,15 @@ _PopulateMetadata( file_t& file )
 #elif defined(MAC)
   auto curpos = ftell( file.loaded );
 
-  auto seek_result = fseek( file.loaded, 0, SEEK_CUR );
-  AssertCrash( !seek_result );
-  auto start = ftell( file.loaded );
-  seek_result = fseek( file.loaded, 0, SEEK_END );
+  auto seek_result = fseek( file.loaded, 0, SEEK_END );
   AssertCrash( !seek_result );
   auto end = ftell( file.loaded );
 
   seek_result = fseek( file.loaded, curpos, SEEK_SET );
   AssertCrash( !seek_result );
 
-  file.size = end - start;
+  // the size is the offset of the end, regardless of where the file ptr was.
+  file.size = end;
 #else
 #error Unsupported platform
 #endif
@@ -890,7 +978,24 @@ FileOpen( u8* name, idx_t len, fileopen_t type, fileop_t access, fileop_t share
       if( !_EnsureDstDirectory( file.obj ) ) {
         return file;
       }
-      AssertCrash( false ); // TODO: implement.
+      // fopen has no open-or-create mode that doesn't truncate or force appends, so create it first.
+      auto fd = open( Cast( const char*, file.obj.mem ), O_CREAT | O_WRONLY | O_CLOEXEC, 0666 );
+      if( fd < 0 ) {
+        return file;
+      }
+      close( fd );
+      switch( access ) {
+        case fileop_t::none: {
+          return file; // makes no sense.
+        } break;
+        case fileop_t::R: {
+          mode = "r";
+        } break;
+        case fileop_t::W:
+        case fileop_t::RW: {
+          mode = "r+";
+        } break;
+      }
     } break;
   }
   file.loaded = fopen( Cast( const char*, file.obj.mem ), mode );
@@ -1002,6 +1107,10 @@ FileWrite( file_t& file, u64 file_offset, u8* src, u64 src_len )
   // update file info.
   _PopulateMetadata( file );
 #elif defined(MAC)
+  _SetFilePtr( file, file_offset );
+  auto nwritten = fwrite( src, 1, src_len, file.loaded );
+  AssertWarn( nwritten == src_len );
+  _PopulateMetadata( file );
 #else
 #error Unsupported platform
 #endif
@@ -1022,6 +1131,9 @@ FileSetEOF( file_t& file, u64 file_offset )
   AssertWarn( SetEndOfFile( _GetHandle( file ) ) );
   _PopulateMetadata( file );
 #elif defined(MAC)
+  fflush( file.loaded );
+  AssertWarn( !ftruncate( fileno( file.loaded ), file_offset ) );
+  _PopulateMetadata( file );
 #else
 #error Unsupported platform
 #endif
@@ -1042,7 +1154,39 @@ FileTimeLastWrite( u8* name, idx_t len )
   AssertWarn( GetFileAttributesEx( Cast( char*, file.mem ), GetFileExInfoStandard, &metadata ) );
   return Pack( metadata.ftLastWriteTime.dwHighDateTime, metadata.ftLastWriteTime.dwLowDateTime );
 #elif defined(MAC)
-  return 0;
+  fsobj_t file = _StandardFilename( name, len );
+  struct stat info;
+  if( stat( Cast( char*, file.mem ), &info ) ) {
+    return 0;
+  }
+  return _GetFileTime( info );
+#else
+#error Unsupported platform
+#endif
+}
+
+// one metadata lookup, without opening the file. returns 0 if the file doesn't exist.
+bool
+FileSizeAndTimeLastWrite( u8* name, idx_t len, u64* size, u64* time )
+{
+#if defined(WIN)
+  fsobj_t file = _StandardFilename( name, len );
+  WIN32_FILE_ATTRIBUTE_DATA metadata;
+  if( !GetFileAttributesEx( Cast( char*, file.mem ), GetFileExInfoStandard, &metadata ) ) {
+    return 0;
+  }
+  *size = Pack( metadata.nFileSizeHigh, metadata.nFileSizeLow );
+  *time = Pack( metadata.ftLastWriteTime.dwHighDateTime, metadata.ftLastWriteTime.dwLowDateTime );
+  return 1;
+#elif defined(MAC)
+  fsobj_t file = _StandardFilename( name, len );
+  struct stat info;
+  if( stat( Cast( char*, file.mem ), &info ) ) {
+    return 0;
+  }
+  *size = Cast( u64, info.st_size );
+  *time = _GetFileTime( info );
+  return 1;
 #else
 #error Unsupported platform
 #endif
@@ -1056,6 +1200,9 @@ FileFree( file_t& file )
     AssertWarn( CloseHandle( _GetHandle( file ) ) );
   }
 #elif defined(MAC)
+  if( file.loaded ) {
+    fclose( file.loaded );
+  }
 #else
 #error Unsupported platform
 #endif
@@ -1094,7 +1241,12 @@ FileExists( u8* name, idx_t len )
   AssertWarn( FindClose( h ) );
   return r;
 #elif defined(MAC)
-  return false;
+  fsobj_t file = _StandardFilename( name, len );
+  struct stat info;
+  if( stat( Cast( const char*, file.mem ), &info ) ) {
+    return 0;
+  }
+  return S_ISREG( info.st_mode );
 #else
 #error Unsupported platform
 #endif
@@ -1154,8 +1306,27 @@ FileMove( u8* dstname, idx_t dstname_len, u8* srcname, idx_t srcname_len )
   bool moved = !!MoveFile( Cast( char*, src.mem ), Cast( char*, dst.mem ) );
   return moved;
 #elif defined(MAC)
-  // TODO:
-  return false;
+  fsobj_t dst = _StandardFilename( dstname, dstname_len );
+  fsobj_t src = _StandardFilename( srcname, srcname_len );
+  if( FileExists( ML( dst ) ) ) {
+    return 0;
+  }
+  return !rename( Cast( const char*, src.mem ), Cast( const char*, dst.mem ) );
+#endif
+}
+
+bool
+FileMoveOverwrite( u8* dstname, idx_t dstname_len, u8* srcname, idx_t srcname_len )
+{
+#if defined(WIN)
+  fsobj_t dst = _StandardFilename( dstname, dstname_len );
+  fsobj_t src = _StandardFilename( srcname, srcname_len );
+  bool moved = !!MoveFileEx( Cast( char*, src.mem ), Cast( char*, dst.mem ), MOVEFILE_REPLACE_EXISTING );
+  return moved;
+#elif defined(MAC)
+  fsobj_t dst = _StandardFilename( dstname, dstname_len );
+  fsobj_t src = _StandardFilename( srcname, srcname_len );
+  return !rename( Cast( const char*, src.mem ), Cast( const char*, dst.mem ) );
 #endif
 }
 
@@ -1190,13 +1361,29 @@ Size( u8* name, idx_t len, u64* size )
 #endif
 
 
+// read-only contents of a whole file.
+// big files are memory-mapped, so there's no copy into a heap buffer; small files are read into a heap buffer
+// instead, since setting up and tearing down a mapping costs more than the read for them.
+// note mapped_mem is only valid until FileFree, so copy out anything you want to keep.
+// also note a mapping can fault if another process truncates the file underneath us. on windows we share read
+// only, and hold the file open while it's mapped, so nobody can. posix has no such lock.
+
+constant idx_t c_filemapped_min_mapped_size = 64*1024;
+
 struct
 filemapped_t
 {
   u8* mapped_mem;
   idx_t size;
-  void* m; // file mapping handle.
-  void* loaded; // file handle.
+  bool loaded;
+  bool mapped; // else mapped_mem is a heap copy, or 0 for an empty file.
+  bool windowed; // mapped_mem is 0, and callers map ranges with FileMappedView.
+#if defined(WIN)
+  void* f; // file handle; only held while mapped or windowed.
+  void* m; // file mapping handle; 0 for an empty windowed file, which can't be mapped.
+#elif defined(MAC)
+  int fd; // only held while windowed.
+#endif
 };
 
 filemapped_t
@@ -1213,7 +1400,7 @@ FileOpenMappedExistingReadShareRead( u8* filename, idx_t filename_len )
     FILE_SHARE_READ,
     0,
     OPEN_EXISTING,
-    FILE_ATTRIBUTE_NORMAL,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
     0
     );
   if( f == INVALID_HANDLE_VALUE ) {
@@ -1221,11 +1408,22 @@ FileOpenMappedExistingReadShareRead( u8* filename, idx_t filename_len )
   }
 
   u64 file_size;
-  BOOL sized = GetFileSizeEx( f, Cast( LARGE_INTEGER*, &file_size ) );
-  AssertWarn( sized );
-  if( !file_size ) {
-    // we can't memory-map an empty file. return a valid result, but with zero size.
-    ret.loaded = Cast( void*, f );
+  if( !GetFileSizeEx( f, Cast( LARGE_INTEGER*, &file_size ) ) ) {
+    CloseHandle( f );
+    return ret;
+  }
+  AssertCrash( file_size < MAX_idx );
+
+  if( file_size < c_filemapped_min_mapped_size ) {
+    // note we can't memory-map an empty file anyways.
+    if( file_size ) {
+      ret.mapped_mem = MemHeapAlloc( u8, Cast( idx_t, file_size ) );
+      DWORD nread = 0;
+      BOOL r = ReadFile( f, ret.mapped_mem, Cast( DWORD, file_size ), &nread, 0 );
+      AssertWarn( r );
+      ret.size = nread;
+    }
+    CloseHandle( f );
 
   } else {
     HANDLE m = CreateFileMapping(
@@ -1251,29 +1449,235 @@ FileOpenMappedExistingReadShareRead( u8* filename, idx_t filename_len )
     }
 
     ret.mapped_mem = Cast( u8*, p );
+    ret.size = Cast( idx_t, file_size );
+    ret.mapped = 1;
+    ret.m = Cast( void*, m );
+    ret.f = Cast( void*, f );
+  }
+  ret.loaded = 1;
 
-    AssertCrash( file_size < MAX_idx );
+#elif defined(MAC)
+  fsobj_t file = _StandardFilename( filename, filename_len );
+
+  int f = open( Cast( const char*, file.mem ), O_RDONLY | O_CLOEXEC );
+  if( f < 0 ) {
+    return ret;
+  }
+
+  struct stat info;
+  if( fstat( f, &info ) ) {
+    close( f );
+    return ret;
+  }
+  auto file_size = Cast( u64, info.st_size );
+  AssertCrash( file_size < MAX_idx );
+
+  if( file_size < c_filemapped_min_mapped_size ) {
+    if( file_size ) {
+      ret.mapped_mem = MemHeapAlloc( u8, Cast( idx_t, file_size ) );
+      idx_t nread = 0;
+      while( nread < file_size ) {
+        auto r = read( f, ret.mapped_mem + nread, Cast( size_t, file_size - nread ) );
+        if( r < 0  &&  errno == EINTR ) {
+          continue;
+        }
+        if( r <= 0 ) {
+          break;
+        }
+        nread += Cast( idx_t, r );
+      }
+      ret.size = nread;
+    }
+
+  } else {
+    // MAP_PRIVATE, since we never write through this, and don't want our pages shared back to the file.
+    void* p = mmap( 0, Cast( size_t, file_size ), PROT_READ, MAP_PRIVATE, f, 0 );
+    if( p == MAP_FAILED ) {
+      close( f );
+      return ret;
+    }
+    madvise( p, Cast( size_t, file_size ), MADV_SEQUENTIAL );
+    ret.mapped_mem = Cast( u8*, p );
     ret.size = Cast( idx_t, file_size );
+    ret.mapped = 1;
+  }
+  // the mapping holds its own reference to the file.
+  close( f );
+  ret.loaded = 1;
+
+#else
+#error Unsupported platform
+#endif
+
+  return ret;
+}
+
+// for files too big to map or read all at once: this only opens the file, and FileMappedView maps ranges of it.
+// the caller decides which ranges stay mapped.
+// note view offsets must be multiples of c_filemapped_granularity, but lens needn't be.
+
+constant idx_t c_filemapped_granularity = 64*1024; // windows allocation granularity; a multiple of posix page sizes.
+
+filemapped_t
+FileOpenMappedWindowedExistingReadShareRead( u8* filename, idx_t filename_len )
+{
+  filemapped_t ret = {};
+
+#if defined(WIN)
+  fsobj_t file = _StandardFilename( filename, filename_len );
+
+  HANDLE f = CreateFile(
+    Cast( char*, file.mem ),
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    0,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    0
+    );
+  if( f == INVALID_HANDLE_VALUE ) {
+    return ret;
+  }
+
+  u64 file_size;
+  if( !GetFileSizeEx( f, Cast( LARGE_INTEGER*, &file_size ) ) ) {
+    CloseHandle( f );
+    return ret;
+  }
+  AssertCrash( file_size < MAX_idx );
+
+  if( file_size ) {
+    HANDLE m = CreateFileMapping( f, 0, PAGE_READONLY, 0, 0, 0 );
+    if( !m ) {
+      CloseHandle( f );
+      return ret;
+    }
     ret.m = Cast( void*, m );
-    ret.loaded = Cast( void*, f );
   }
+  ret.f = Cast( void*, f );
+  ret.size = Cast( idx_t, file_size );
+
+#elif defined(MAC)
+  fsobj_t file = _StandardFilename( filename, filename_len );
+
+  int f = open( Cast( const char*, file.mem ), O_RDONLY | O_CLOEXEC );
+  if( f < 0 ) {
+    return ret;
+  }
+
+  struct stat info;
+  if( fstat( f, &info ) ) {
+    close( f );
+    return ret;
+  }
+  auto file_size = Cast( u64, info.st_size );
+  AssertCrash( file_size < MAX_idx );
+
+  ret.fd = f;
+  ret.size = Cast( idx_t, file_size );
+
+#else
+#error Unsupported platform
 #endif
 
+  ret.windowed = 1;
+  ret.loaded = 1;
   return ret;
 }
 
+// returns 0 on failure. len gets clipped to the end of the file.
+Inl u8*
+FileMappedView( filemapped_t& file, u64 offset, idx_t* len )
+{
+  AssertCrash( file.windowed );
+  AssertCrash( offset % c_filemapped_granularity == 0 );
+
+#if defined(WIN)
+  // FILE_SHARE_READ keeps anyone from truncating the file under us.
+  auto size = Cast( u64, file.size );
+#elif defined(MAC)
+  // posix can't keep others from truncating the file, and touching a mapped page past the end raises SIGBUS.
+  // so we clip views to the file's current size. that can still race with a truncate, but not with one that
+  // happened before this view.
+  struct stat info;
+  if( fstat( file.fd, &info ) ) {
+    *len = 0;
+    return 0;
+  }
+  auto size = MIN( Cast( u64, file.size ), Cast( u64, info.st_size ) );
+#else
+#error Unsupported platform
+#endif
+
+  if( offset >= size ) {
+    *len = 0;
+    return 0;
+  }
+  *len = Cast( idx_t, MIN( Cast( u64, *len ), size - offset ) );
+
+#if defined(WIN)
+  void* p = MapViewOfFile(
+    Cast( HANDLE, file.m ),
+    FILE_MAP_READ,
+    Cast( DWORD, offset >> 32 ),
+    Cast( DWORD, offset ),
+    *len
+    );
+  return Cast( u8*, p );
+#elif defined(MAC)
+  // MAP_PRIVATE, like FileOpenMappedExistingReadShareRead.
+  void* p = mmap( 0, *len, PROT_READ, MAP_PRIVATE, file.fd, Cast( off_t, offset ) );
+  if( p == MAP_FAILED ) {
+    return 0;
+  }
+  return Cast( u8*, p );
+#else
+#error Unsupported platform
+#endif
+}
+
+Inl void
+FileMappedUnview( u8* mem, idx_t len )
+{
+#if defined(WIN)
+  AssertWarn( UnmapViewOfFile( mem ) );
+#elif defined(MAC)
+  AssertWarn( !munmap( mem, len ) );
+#else
+#error Unsupported platform
+#endif
+}
+
 void
 FileFree( filemapped_t& file )
 {
+  if( file.windowed ) {
+#if defined(WIN)
+    if( file.m ) {
+      CloseHandle( Cast( HANDLE, file.m ) );
+    }
+    CloseHandle( Cast( HANDLE, file.f ) );
+#elif defined(MAC)
+    close( file.fd );
+#else
+#error Unsupported platform
+#endif
+  }
+  elif( file.mapped ) {
 #if defined(WIN)
-  if( file.size ) {
     AssertWarn( UnmapViewOfFile( file.mapped_mem ) );
     CloseHandle( Cast( HANDLE, file.m ) );
-    CloseHandle( Cast( HANDLE, file.loaded ) );
+    CloseHandle( Cast( HANDLE, file.f ) );
+#elif defined(MAC)
+    AssertWarn( !munmap( file.mapped_mem, file.size ) );
+#else
+#error Unsupported platform
+#endif
+  }
+  elif( file.mapped_mem ) {
+    MemHeapFree( file.mapped_mem );
   }
-
   file = {};
-#endif
 }
 
 
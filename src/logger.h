@@ -44,6 +44,11 @@ LogInline( const void* cstr ... )
 {
 }
 
+Inl void
+LogDirect( slice_t slice )
+{
+}
+
 #else // LOGGER_ENABLED
 
 
@@ -40,6 +40,7 @@
 #include "cstr_float.h"
 #include "timedate.h"
 #include "thread_atomics.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
 #include "ds_mtqueue_srsw_nonresizeable.h"
 #include "ds_mtqueue_srmw_nonresizeable.h"
 #include "ds_mtqueue_mrsw_nonresizeable.h"
@@ -37,6 +37,7 @@
 #include "ds_mtqueue_srmw_nonresizeable.h"
 #include "ds_mtqueue_srsw_nonresizeable.h"
 #include "thread_atomics.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
 #include "threading.h"
 #define LOGGER_ENABLED   0
 #include "logger.h"
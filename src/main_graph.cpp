@@ -40,6 +40,7 @@
 #include "filesys.h"
 #include "timedate.h"
 #include "thread_atomics.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
 #include "threading.h"
 #define LOGGER_ENABLED   1
 #include "logger.h"
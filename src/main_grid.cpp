@@ -39,6 +39,7 @@
 #include "cstr_float.h"
 #include "timedate.h"
 #include "thread_atomics.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
 #include "ds_mtqueue_srsw_nonresizeable.h"
 #include "ds_mtqueue_srmw_nonresizeable.h"
 #include "ds_mtqueue_mrsw_nonresizeable.h"
@@ -55,6 +56,12 @@
 #include "allocator_heap_findleaks.h"
 #include "mainthread.h"
 #include "text_parsing.h"
+#include "csv_ingest.h"
+#include "ds_queue_nonresizeable.h"
+#include "ds_minheap_extractable.h"
+#include "ds_minheap_decreaseable.h"
+#include "ds_bitarray_nonresizeable_stack.h"
+#include "ds_graph.h"
 
 #define OPENGL_INSTEAD_OF_SOFTWARE       0
 #define GLW_RAWINPUT_KEYBOARD            0
@@ -64,6 +71,7 @@
 #include "ui_propdb.h"
 #include "ui_font.h"
 #include "ui_render.h"
+#include "ds_linetree.h"
 #include "ui_buf2.h"
 #include "ui_txt2.h"
 
@@ -150,11 +158,13 @@ cell_t
   // this is the final calculated value, not the formula that produces that result.
   cellvalue_t value;
 
-  // the grid's eval_generation is incremented each time we start an eval loop,
-  // and this is stored on the cell so we can do eval cycle detection.
-  // a generation number means we don't have to do a clear-flag pre-pass.
+  // the grid's eval_generation is incremented for each recalc round,
+  // and this is stored on the cell when that round evaluates it.
   u32 eval_generation;
 
+  // index+1 into grid->graph_nodes, or 0 if this cell isn't in the dependency graph.
+  u32 graph_node;
+
   // note it might be worth sharing this stuff across cells, for mem/speed reasons.
   slice32_t input; // source string that's parsed into an expression, and calculated for a final value.
   cellerror_t error;
@@ -175,6 +185,8 @@ cell_t
   u16 error_start; // into cell's input
   u16 error_end;
 
+  u32 graph_node;
+
 #endif
 };
 
@@ -830,22 +842,34 @@ Enumc( gridfocus_t )
   input,
 };
 
+// we construct these for tracking evaluation dependencies.
+// e.g. if cell(1,1) contains "10", and cell(1,2) contains "5+cell(1,1)",
+// then cell(1,2)'s node has cell(1,1)'s node as a subexpr, and cell(1,1)'s node has cell(1,2)'s node as a superexpr.
+// we keep both directions, so recalc can walk superexprs without scanning every edge in the grid.
+// node indices are stable for the lifetime of the grid; cell->graph_node links back here.
+struct
+cellcode_t;
+
 struct
-cellandpos_t
+gridnode_t
 {
   cell_t* cell;
   absolutepos_t abspos;
-};
 
-// we construct these for tracking evaluation dependencies.
-// e.g. if cell(1,1) contains "10", and cell(1,2) contains "5+cell(1,1)",
-// then we'll make an edge ( cell(1,2), cell(1,1) )
-// the directionality is ( superexpr, subexpr )
-struct
-graphedge_t
-{
-  cellandpos_t start;
-  cell_t* end;
+  // the cells this cell's expression read during its last evaluation, with no duplicates.
+  stack_resizeable_cont_t<u32> subexprs;
+
+  // the reverse edges, i.e. the cells whose expressions read this cell.
+  stack_resizeable_cont_t<u32> superexprs;
+
+  // the compiled input, or 0 if we haven't compiled it since the input last changed.
+  cellcode_t* code;
+
+  // recalc scratch. generation == grid->eval_generation means this node is in the current dirty set.
+  u32 generation;
+  u32 dirty_idx;
+  u32 level; // evaluation level in the dirty set, or MAX_u32 for cells that are part of a reference cycle.
+  u64 mark; // for deduping edges.
 };
 
 struct
@@ -859,7 +883,8 @@ grid_t
 #else
   listwalloc_t<cellblock_t> cellblocks;
 #endif
-  stack_resizeable_cont_t<graphedge_t> graph_edges;
+  stack_resizeable_cont_t<gridnode_t> graph_nodes;
+  u64 graph_mark;
   stack_resizeable_cont_t<custom_dim_x_t> custom_dim_xs; // TODO: implement
   stack_resizeable_cont_t<custom_dim_y_t> custom_dim_ys;
   gridfocus_t focus;
@@ -896,7 +921,8 @@ Init( grid_t* grid )
 #else
   Init( grid->cellblocks, &grid->cellmem );
 #endif
-  Alloc( grid->graph_edges, 256 );
+  Alloc( grid->graph_nodes, 256 );
+  grid->graph_mark = 0;
   Alloc( grid->custom_dim_xs, 4 );
   Alloc( grid->custom_dim_ys, 4 );
   grid->focus = gridfocus_t::cursel;
@@ -925,7 +951,15 @@ Kill( grid_t* grid )
   grid->focus = gridfocus_t::cursel;
   Free( grid->custom_dim_ys );
   Free( grid->custom_dim_xs );
-  Free( grid->graph_edges );
+  grid->graph_mark = 0;
+  FORLEN( node, i, grid->graph_nodes )
+    if( node->code ) {
+      MemHeapFree( node->code );
+    }
+    Free( node->subexprs );
+    Free( node->superexprs );
+  }
+  Free( grid->graph_nodes );
 #if PT
   Zero( &grid->cellblock_tree );
 #else
@@ -934,47 +968,53 @@ Kill( grid_t* grid )
   Kill( grid->cellmem );
 }
 
-Inl void
-InsertOrSetCellContents(
+Inl u32
+SetCellInput(
   grid_t* grid,
-  absoluterectlist_t* rectlist,
+  absolutepos_t abspos,
   slice32_t input
   );
 
+void
+RecalcCells(
+  grid_t* grid,
+  stack_resizeable_cont_t<u32>* seeds
+  );
+
 Inl void
 LoadCSV(
   grid_t* grid,
   slice_t csv
   )
 {
-  u32 nlines = CountNewlines( ML( csv ) ) + 1;
-  stack_resizeable_cont_t<slice32_t> lines;
-  Alloc( lines, nlines );
-  stack_resizeable_cont_t<slice_t> entries;
-  Alloc( entries, 32 );
-  SplitIntoLines( &lines, ML( csv ) );
-  absoluterectlist_t rectlist;
-  Alloc( rectlist, 1 );
-  FORLEN32( line, y, lines )
-    auto nentries = CountCommas( ML( *line ) ) + 1;
-    entries.len = 0;
-    Reserve( entries, nentries );
-    SplitByCommas( &entries, ML( *line ) );
-    FORLEN32( entry, x, entries )
-      absolutepos_t abspos = { x, y };
-      rectlist.len = 0;
-      auto rect = AddBack( rectlist );
-      rect->p0 = abspos;
-      rect->p1 = abspos + _vec2<u32>( 1, 1 );
-      AssertCrash( entry->len <= MAX_u32 );
-      auto copied = AddPagelistSlice32( grid->cellmem, u8, 1, Cast( u32, entry->len ) );
-      Memmove( copied.mem, ML( *entry ) );
-      InsertOrSetCellContents( grid, &rectlist, copied );
+  // keep empty lines and short rows, so the grid layout matches the file's.
+  csvingest_t ingest;
+  if( !CsvIngest( &ingest, csv, 0, 1, 0, 1 ) ) {
+    Kill( &ingest );
+    return;
+  }
+  auto ncolumns = ingest.ncolumns;
+  auto nrows = ingest.nrows;
+  stack_resizeable_cont_t<u32> seeds;
+  Alloc( seeds, ( nrows + 1 ) * ncolumns );
+  Fori( u32, y, 0, nrows + 1 ) {
+    For( x, 0, ncolumns ) {
+      auto entry = y  ?  ingest.cells.mem[ x * nrows + y - 1 ]  :  ingest.headers.mem[x];
+      // missing from a short row.
+      if( !entry.mem ) {
+        continue;
+      }
+      absolutepos_t abspos = { Cast( u32, x ), y };
+      AssertCrash( entry.len <= MAX_u32 );
+      auto copied = AddPagelistSlice32( grid->cellmem, u8, 1, Cast( u32, entry.len ) );
+      Memmove( copied.mem, ML( entry ) );
+      *AddBack( seeds ) = SetCellInput( grid, abspos, copied );
     }
   }
-  Free( rectlist );
-  Free( entries );
-  Free( lines );
+  Kill( &ingest );
+  // set all the inputs first, so we evaluate the whole sheet in one recalc.
+  RecalcCells( grid, &seeds );
+  Free( seeds );
 }
 
 Inl u32
@@ -1052,6 +1092,83 @@ AccessCell( grid_t* grid, absolutepos_t abspos )
   return cell;
 }
 
+// returns the node index for the cell, adding a node if it isn't in the graph yet.
+// note this may reallocate grid->graph_nodes.
+Inl u32
+GraphNodeFromCell( grid_t* grid, cell_t* cell, absolutepos_t abspos )
+{
+  if( !cell->graph_node ) {
+    AssertCrash( grid->graph_nodes.len < MAX_u32 );
+    auto node = AddBack( grid->graph_nodes );
+    *node = {};
+    node->cell = cell;
+    node->abspos = abspos;
+    cell->graph_node = Cast( u32, grid->graph_nodes.len );
+  }
+  return cell->graph_node - 1;
+}
+
+// most cells have just a few edges, so allocate these lazily.
+Inl void
+_AddGraphEdge( stack_resizeable_cont_t<u32>& edges, u32 n )
+{
+  if( !edges.capacity ) {
+    Alloc( edges, 4 );
+  }
+  *AddBack( edges ) = n;
+}
+
+Inl void
+_RemGraphEdge( stack_resizeable_cont_t<u32>& edges, u32 n )
+{
+  FORLEN( edge, i, edges )
+    if( *edge == n ) {
+      UnorderedRemAt( edges, i );
+      return;
+    }
+  }
+  UnreachableCrash();
+}
+
+// replaces node n's subexprs, and updates the superexprs of the old and new subexprs to match.
+// the given subexprs may have duplicates, e.g. from overlapping row/col reads.
+// takes time O( old + new ), plus the superexprs scans for removed edges.
+Inl void
+SetSubexprs( grid_t* grid, u32 n, u32* subexprs, idx_t nsubexprs )
+{
+  auto nodes = grid->graph_nodes.mem;
+  auto mark_new = grid->graph_mark + 1; // in the new list only.
+  auto mark_kept = grid->graph_mark + 2; // in both lists.
+  auto mark_done = grid->graph_mark + 3; // already added to node->subexprs.
+  grid->graph_mark += 3;
+  For( i, 0, nsubexprs ) {
+    nodes[ subexprs[i] ].mark = mark_new;
+  }
+  auto node = nodes + n;
+  FORLEN( sub, i, node->subexprs )
+    auto subnode = nodes + *sub;
+    if( subnode->mark == mark_new ) {
+      subnode->mark = mark_kept;
+    }
+    else {
+      _RemGraphEdge( subnode->superexprs, n );
+    }
+  }
+  node->subexprs.len = 0;
+  For( i, 0, nsubexprs ) {
+    auto sub = subexprs[i];
+    auto subnode = nodes + sub;
+    if( subnode->mark == mark_done ) {
+      continue;
+    }
+    if( subnode->mark == mark_new ) {
+      _AddGraphEdge( subnode->superexprs, n );
+    }
+    subnode->mark = mark_done;
+    _AddGraphEdge( node->subexprs, sub );
+  }
+}
+
 // PERF: these are terrible, especially how we call them.
 Inl bool
 HasCustomDimX(
@@ -2127,54 +2244,221 @@ Parse(
   return expr;
 }
 
-NoInl cellvalue_t
-EvaluateExpr(
-  grid_t* grid,
-  pagelist_t* evalmem,
-  absolutepos_t abspos, // which cell we're evaluating into.  used for relcell and other relative stuff.
+//
+// compiled cell expressions.
+// we tokenize and parse a cell's input once, and flatten the expr tree into postfix instrs that run on a
+// value stack. the result is cached on the cell's graph node until its input changes, so recalc only pays
+// for evaluation.
+//
+Enumc( cellinstrtype_t )
+{
+  num,
+  array,
+  fncall,
+  unop,
+  binop,
+  aggregate_row, // sum/min/max of a row(..) range, with the range args on the stack.
+  aggregate_col, // same for col(..).
+};
+struct
+cellinstr_t
+{
+  u8 type; // cellinstrtype_t
+  u8 subtype; // fncalltype_t, unoptype_t, or binoptype_t. for aggregates, the sum/min/max fncalltype_t.
+  u16 n; // # of stack values an array/fncall/aggregate consumes, or the index into nums for num.
+  u32 start; // the expr's token, for error reporting.
+  u32 end;
+};
+struct
+cellcode_t
+{
+  cellinstr_t* instrs;
+  f64* nums;
+  u32 ninstrs;
+  u32 max_depth; // the most values on the stack at once.
+  compileerror_t error; // set if the input didn't tokenize/parse, in which case there are no instrs.
+};
+
+Inl void
+Error(
+  compileerror_t* error,
+  cellinstr_t* instr,
+  slice32_t errortext
+  )
+{
+  error->text = errortext;
+  error->start = instr->start;
+  error->end = instr->end;
+}
+
+Inl void
+_EmitInstr(
+  stack_resizeable_cont_t<cellinstr_t>* instrs,
   node_expr_t* expr,
-  stack_resizeable_cont_t<cell_t*>* cells_subexpr,
-  compileerror_t* error
-  );
+  cellinstrtype_t type,
+  u8 subtype,
+  idx_t n
+  )
+{
+  AssertCrash( n <= MAX_u16 );
+  auto instr = AddBack( *instrs );
+  instr->type = Cast( u8, type );
+  instr->subtype = subtype;
+  instr->n = Cast( u16, n );
+  instr->start = 0;
+  instr->end = 0;
+  if( expr->tkn ) {
+    instr->start = expr->tkn->offset_into_input;
+    instr->end = instr->start + expr->tkn->slice.len;
+  }
+}
 
-Inl cellvalue_t
-EvaluateExprArray(
-  grid_t* grid,
-  pagelist_t* evalmem,
-  absolutepos_t abspos, // which cell we're evaluating into.  used for relcell and other relative stuff.
-  expr_array_t* array,
-  stack_resizeable_cont_t<cell_t*>* cells_subexpr,
-  compileerror_t* error
+NoInl void
+_CompileExpr(
+  node_expr_t* expr,
+  stack_resizeable_cont_t<cellinstr_t>* instrs,
+  stack_resizeable_cont_t<f64>* nums,
+  u32* depth,
+  u32* max_depth
   )
 {
-  auto len = array->len;
-  cellvalue_t value;
-  value.type = cellvaluetype_t::_array;
-  value._array.len = len;
-  value._array.mem = AddPagelist( *evalmem, cellvalue_t, _SIZEOF_IDX_T, len );
-  For( i, 0, len ) {
-    auto expr_elem = array->mem[i];
-    value._array.mem[i] = EvaluateExpr( grid, evalmem, abspos, expr_elem, cells_subexpr, error );
-    if( error->text.len ) {
-      return {};
-    }
+  switch( expr->type ) {
+    case exprtype_t::fncall: {
+      // sum/min/max straight over a row or col fuse into one instr, so we never build the range's array.
+      auto type = expr->fncall.type;
+      if( ( type == fncalltype_t::sum  ||  type == fncalltype_t::min  ||  type == fncalltype_t::max )  &&
+          expr->fncall.args.len == 1 )
+      {
+        auto range = expr->fncall.args.mem[0];
+        if( range->type == exprtype_t::fncall  &&
+            ( range->fncall.type == fncalltype_t::row  ||  range->fncall.type == fncalltype_t::col ) )
+        {
+          FORLEN( arg, i, range->fncall.args )
+            _CompileExpr( *arg, instrs, nums, depth, max_depth );
+          }
+          auto instrtype = ( range->fncall.type == fncalltype_t::row ) ?
+            cellinstrtype_t::aggregate_row :
+            cellinstrtype_t::aggregate_col;
+          _EmitInstr( instrs, expr, instrtype, Cast( u8, type ), range->fncall.args.len );
+          *depth = *depth + 1 - range->fncall.args.len;
+          break;
+        }
+      }
+      FORLEN( arg, i, expr->fncall.args )
+        _CompileExpr( *arg, instrs, nums, depth, max_depth );
+      }
+      _EmitInstr( instrs, expr, cellinstrtype_t::fncall, Cast( u8, expr->fncall.type ), expr->fncall.args.len );
+      *depth = *depth + 1 - expr->fncall.args.len;
+    } break;
+
+    case exprtype_t::array: {
+      FORLEN( elem, i, expr->array )
+        _CompileExpr( *elem, instrs, nums, depth, max_depth );
+      }
+      _EmitInstr( instrs, expr, cellinstrtype_t::array, 0, expr->array.len );
+      *depth = *depth + 1 - expr->array.len;
+    } break;
+
+    case exprtype_t::unop: {
+      _CompileExpr( expr->unop.expr, instrs, nums, depth, max_depth );
+      // fold negative literals, since relcell args are usually things like -1.
+      auto last = instrs->mem + instrs->len - 1;
+      if( expr->unop.type == unoptype_t::negate  &&  last->type == Cast( u8, cellinstrtype_t::num ) ) {
+        nums->mem[ last->n ] = -nums->mem[ last->n ];
+        if( expr->tkn ) {
+          last->start = expr->tkn->offset_into_input;
+        }
+        break;
+      }
+      _EmitInstr( instrs, expr, cellinstrtype_t::unop, Cast( u8, expr->unop.type ), 0 );
+    } break;
+
+    case exprtype_t::num: {
+      _EmitInstr( instrs, expr, cellinstrtype_t::num, 0, nums->len );
+      *AddBack( *nums ) = expr->num.value_f64;
+      *depth += 1;
+    } break;
+
+    case exprtype_t::binop: {
+      _CompileExpr( expr->binop.expr_l, instrs, nums, depth, max_depth );
+      _CompileExpr( expr->binop.expr_r, instrs, nums, depth, max_depth );
+      _EmitInstr( instrs, expr, cellinstrtype_t::binop, Cast( u8, expr->binop.type ), 0 );
+      *depth -= 1;
+    } break;
+
+    default: UnreachableCrash();
   }
-  return value;
+  *max_depth = MAX( *max_depth, *depth );
+}
+
+// the instrs, nums, and error text all live in the one heap block, so MemHeapFree the cellcode_t to free it.
+// tokens, nodemem, tmpargmem, and errortextmem are scratch.
+Inl cellcode_t*
+CompileCellInput(
+  slice32_t input,
+  stack_resizeable_cont_t<token_t>* tokens,
+  pagelist_t* nodemem,
+  stack_resizeable_cont_t<node_expr_t*>* tmpargmem,
+  pagelist_t* errortextmem,
+  stack_resizeable_cont_t<cellinstr_t>* instrs,
+  stack_resizeable_cont_t<f64>* nums
+  )
+{
+  compileerror_t error = {};
+  tokens->len = 0;
+  Tokenize( input, tokens, &error );
+  node_expr_t* expr = 0;
+  if( !error.text.len ) {
+    parse_input_t parse_input;
+    parse_input.tokens = tokens;
+    parse_input.nodemem = nodemem;
+    parse_input.errortextmem = errortextmem;
+    parse_input.tmpargmem = tmpargmem;
+    expr = Parse( &parse_input, &error );
+  }
+  instrs->len = 0;
+  nums->len = 0;
+  u32 depth = 0;
+  u32 max_depth = 0;
+  if( !error.text.len ) {
+    AssertCrash( expr );
+    _CompileExpr( expr, instrs, nums, &depth, &max_depth );
+    AssertCrash( depth == 1 );
+  }
+  AssertCrash( instrs->len <= MAX_u32 );
+
+  auto nbytes_instrs = instrs->len * sizeof( cellinstr_t );
+  auto nbytes_nums = nums->len * sizeof( f64 );
+  auto mem = MemHeapAlloc( u8, sizeof( cellcode_t ) + nbytes_nums + nbytes_instrs + error.text.len );
+  auto code = Cast( cellcode_t*, mem );
+  mem += sizeof( cellcode_t );
+  code->nums = Cast( f64*, mem );
+  TMove( code->nums, nums->mem, nums->len );
+  mem += nbytes_nums;
+  code->instrs = Cast( cellinstr_t*, mem );
+  TMove( code->instrs, instrs->mem, instrs->len );
+  mem += nbytes_instrs;
+  code->ninstrs = Cast( u32, instrs->len );
+  code->max_depth = max_depth;
+  code->error = error;
+  code->error.text.mem = mem;
+  Memmove( code->error.text.mem, ML( error.text ) );
+  return code;
 }
 
 Inl u32
 ExpectGridAbsposCoord(
   f64 value,
-  node_expr_t* expr,
+  cellinstr_t* instr,
   compileerror_t* error
   )
 {
   if( value <= 0.5 ) {
-    Error( error, expr->tkn, Slice32FromCStr( "expected an integer 1 or greater!" ) );
+    Error( error, instr, Slice32FromCStr( "expected an integer 1 or greater!" ) );
     return {};
   }
   if( value >= Cast( f64, MAX_u32 ) + 0.5 ) {
-    Error( error, expr->tkn, Slice32FromCStr( "number is larger than the grid size!" ) );
+    Error( error, instr, Slice32FromCStr( "number is larger than the grid size!" ) );
     return {};
   }
   auto abspos_coord = Round_u32_from_f64( value );
@@ -2187,16 +2471,16 @@ ExpectGridAbsposCoord(
 Inl s64
 ExpectGridAbsposRelCoord(
   f64 value,
-  node_expr_t* expr,
+  cellinstr_t* instr,
   compileerror_t* error
   )
 {
   if( value <= -Cast( f64, MAX_u32 ) - 0.5 ) {
-    Error( error, expr->tkn, Slice32FromCStr( "number is larger than the grid size!" ) );
+    Error( error, instr, Slice32FromCStr( "number is larger than the grid size!" ) );
     return {};
   }
   if( value >= Cast( f64, MAX_u32 ) + 0.5 ) {
-    Error( error, expr->tkn, Slice32FromCStr( "number is larger than the grid size!" ) );
+    Error( error, instr, Slice32FromCStr( "number is larger than the grid size!" ) );
     return {};
   }
   auto abspos_relcoord = Round_s64_from_f64( value );
@@ -2204,15 +2488,8 @@ ExpectGridAbsposRelCoord(
 }
 
 Inl cellvalue_t
-ReadCellValueDuringExprEval(
-  grid_t* grid,
-  absolutepos_t abspos,
-  stack_resizeable_cont_t<cell_t*>* cells_subexpr
-  )
+CellValue( cell_t* cell )
 {
-  auto cell = AccessCell( grid, abspos );
-  *AddBack( *cells_subexpr ) = cell;
-
 #if PACKCELL
   cellvalue_t r;
   r.type = Cast( cellvaluetype_t, cell->value_type );
@@ -2231,11 +2508,135 @@ ReadCellValueDuringExprEval(
     } break;
     default: UnreachableCrash();
   }
+  return r;
 #else
   return cell->value;
 #endif
 }
 
+Inl cellvalue_t
+ReadCellValueDuringExprEval(
+  grid_t* grid,
+  absolutepos_t abspos,
+  stack_resizeable_cont_t<absolutepos_t>* cells_subexpr
+  )
+{
+  // note this runs on taskthreads during recalc, so we can't allocate missing cells here.
+  // recalc adds the graph edges for what we read after evaluating.
+  *AddBack( *cells_subexpr ) = abspos;
+  auto cell = TryAccessCell( grid, abspos );
+  if( !cell ) {
+    return {};
+  }
+  return CellValue( cell );
+}
+
+// reads count cells in a line from abspos, stepping in y if along_y, else in x.
+// this is the fast path for ranges: one cellblock lookup per run of cells in that block, instead of one per cell.
+Inl void
+ReadCellRunDuringExprEval(
+  grid_t* grid,
+  absolutepos_t abspos,
+  u32 count,
+  bool along_y,
+  cellvalue_t* dst,
+  stack_resizeable_cont_t<absolutepos_t>* cells_subexpr
+  )
+{
+  auto reads = AddBack( *cells_subexpr, count );
+  auto step = along_y ? _vec2<u32>( 0, 1 ) : _vec2<u32>( 1, 0 );
+  auto stride = along_y ? c_cellblock_dim_x : 1;
+  u32 i = 0;
+  while( i < count ) {
+    auto blockpos = BlockposFromAbsolutepos( abspos );
+    auto block = TryAccessCellBlock( grid, blockpos );
+    auto posinblock = PosinblockFromAbsolutepos( blockpos, abspos );
+    auto run = along_y ?
+      c_cellblock_dim_y - abspos.y % c_cellblock_dim_y :
+      c_cellblock_dim_x - abspos.x % c_cellblock_dim_x;
+    run = MIN( run, count - i );
+    if( block ) {
+      auto cell = block->cells + posinblock;
+      Fori( u32, j, 0, run ) {
+        dst[i + j] = CellValue( cell );
+        cell += stride;
+      }
+    }
+    else {
+      Memzero( dst + i, run * sizeof( cellvalue_t ) );
+    }
+    Fori( u32, j, 0, run ) {
+      reads[i + j] = abspos;
+      abspos = abspos + step;
+    }
+    i += run;
+  }
+}
+
+// sum/min/max of count cells in a line from abspos, stepping in y if along_y, else in x.
+// this is the fused path for e.g. sum(col(1,1,1000)): we reduce straight out of the cellblocks, instead of building
+// the range as an array value first.
+// note cells are tagged unions, 72 bytes apart, so there's no contiguous run of f64s to load as vectors.
+// AVX2 gathers measured slower than this scalar loop.
+// missing cells count as 0, like ReadCellRunDuringExprEval. returns false if the run has a non-number cell.
+Inl bool
+AggregateCellRunDuringExprEval(
+  grid_t* grid,
+  absolutepos_t abspos,
+  u32 count,
+  bool along_y,
+  fncalltype_t type,
+  f64* result,
+  stack_resizeable_cont_t<absolutepos_t>* cells_subexpr
+  )
+{
+  auto reads = AddBack( *cells_subexpr, count );
+  auto step = along_y ? _vec2<u32>( 0, 1 ) : _vec2<u32>( 1, 0 );
+  auto stride = along_y ? c_cellblock_dim_x : 1;
+  auto is_sum = type == fncalltype_t::sum;
+  auto is_min = type == fncalltype_t::min;
+  kahansum64_t sum = {};
+  f64 extreme = is_min ? INFINITY : -INFINITY;
+  bool numbers = 1;
+  u32 i = 0;
+  while( i < count ) {
+    auto blockpos = BlockposFromAbsolutepos( abspos );
+    auto block = TryAccessCellBlock( grid, blockpos );
+    auto posinblock = PosinblockFromAbsolutepos( blockpos, abspos );
+    auto run = along_y ?
+      c_cellblock_dim_y - abspos.y % c_cellblock_dim_y :
+      c_cellblock_dim_x - abspos.x % c_cellblock_dim_x;
+    run = MIN( run, count - i );
+    if( block ) {
+      auto cell = block->cells + posinblock;
+      Fori( u32, j, 0, run ) {
+        auto value = CellValue( cell );
+        numbers &= value.type == cellvaluetype_t::_f64;
+        if( is_sum ) {
+          Add( sum, value._f64 );
+        }
+        elif( is_min ) {
+          extreme = MIN( extreme, value._f64 );
+        }
+        else {
+          extreme = MAX( extreme, value._f64 );
+        }
+        cell += stride;
+      }
+    }
+    elif( !is_sum ) {
+      extreme = is_min ? MIN( extreme, 0.0 ) : MAX( extreme, 0.0 );
+    }
+    Fori( u32, j, 0, run ) {
+      reads[i + j] = abspos;
+      abspos = abspos + step;
+    }
+    i += run;
+  }
+  *result = is_sum ? sum.sum : extreme;
+  return numbers;
+}
+
 // TODO: PERF: not ideal. can probably avoid doing this in the future.
 Inl void
 CopyCellValue(
@@ -2266,387 +2667,311 @@ CopyCellValue(
   }
 }
 
-// flattens all cells read during evalutation into cells_subexpr.
-NoInl cellvalue_t
-EvaluateExpr(
+// flattens the positions of all cells read during evalutation into cells_subexpr.
+// args is the fncall's args as an array value, and arg_instrs are the instrs that produced each one.
+Inl cellvalue_t
+EvaluateFncall(
   grid_t* grid,
   pagelist_t* evalmem,
   absolutepos_t abspos, // which cell we're evaluating into.  used for relcell and other relative stuff.
-  node_expr_t* expr,
-  stack_resizeable_cont_t<cell_t*>* cells_subexpr,
+  fncalltype_t type,
+  cellvalue_t args,
+  cellinstr_t** arg_instrs,
+  stack_resizeable_cont_t<absolutepos_t>* cells_subexpr,
   compileerror_t* error
   )
 {
-  switch( expr->type ) {
-    case exprtype_t::fncall: {
-      auto args = EvaluateExprArray( grid, evalmem, abspos, &expr->fncall.args, cells_subexpr, error );
+  // right now all functions take all numbers as args.
+  // TODO: this will change for newer fns, and we may even allow auto array inlining, so "cell(cell(1,1))" would work if cell(1,1) evals to a 2-elem array.
+  #define VERIFY_ARGS_ARE_NUM_ARRAY \
+    AssertCrash( args.type == cellvaluetype_t::_array ); \
+    FORLEN( arg, i, args._array ) \
+      if( arg->type != cellvaluetype_t::_f64 ) { \
+        Error( error, arg_instrs[i], Slice32FromCStr( "expected this to be a number argument!" ) ); \
+        return {}; \
+      } \
+    } \
+
+  switch( type ) {
+    case fncalltype_t::cell   : {
+      VERIFY_ARGS_ARE_NUM_ARRAY;
+      AssertCrash( args._array.len == 2 );
+      auto abspos_x = ExpectGridAbsposCoord( args._array.mem[0]._f64, arg_instrs[0], error );
       if( error->text.len ) {
         return {};
       }
+      auto abspos_y = ExpectGridAbsposCoord( args._array.mem[1]._f64, arg_instrs[1], error );
+      if( error->text.len ) {
+        return {};
+      }
+      absolutepos_t abspos_arg = { abspos_x, abspos_y };
+      auto value = ReadCellValueDuringExprEval( grid, abspos_arg, cells_subexpr );
+      if( error->text.len ) {
+        return {};
+      }
+      return value;
+    } break;
 
-      // right now all functions take all numbers as args.
-      // TODO: this will change for newer fns, and we may even allow auto array inlining, so "cell(cell(1,1))" would work if cell(1,1) evals to a 2-elem array.
-      #define VERIFY_ARGS_ARE_NUM_ARRAY \
-        AssertCrash( args.type == cellvaluetype_t::_array ); \
-        FORLEN( arg, i, args._array ) \
-          if( arg->type != cellvaluetype_t::_f64 ) { \
-            Error( error, expr->fncall.args.mem[i]->tkn, Slice32FromCStr( "expected this to be a number argument!" ) ); \
-            return {}; \
-          } \
-        } \
-
-      switch( expr->fncall.type ) {
-        case fncalltype_t::cell   : {
-          VERIFY_ARGS_ARE_NUM_ARRAY;
-          AssertCrash( args._array.len == 2 );
-          auto abspos_x = ExpectGridAbsposCoord( args._array.mem[0]._f64, expr->fncall.args.mem[0], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto abspos_y = ExpectGridAbsposCoord( args._array.mem[1]._f64, expr->fncall.args.mem[1], error );
-          if( error->text.len ) {
-            return {};
-          }
-          absolutepos_t abspos_arg = { abspos_x, abspos_y };
-          auto value = ReadCellValueDuringExprEval( grid, abspos_arg, cells_subexpr );
-          if( error->text.len ) {
-            return {};
-          }
-          return value;
-        } break;
+    case fncalltype_t::relcell: {
+      VERIFY_ARGS_ARE_NUM_ARRAY;
+      AssertCrash( args._array.len == 2 );
+      auto relpos_x = ExpectGridAbsposRelCoord( args._array.mem[0]._f64, arg_instrs[0], error );
+      if( error->text.len ) {
+        return {};
+      }
+      auto relpos_y = ExpectGridAbsposRelCoord( args._array.mem[1]._f64, arg_instrs[1], error );
+      if( error->text.len ) {
+        return {};
+      }
+      absolutepos_t abspos_arg = _vec2<u32>(
+        Cast( u32, CLAMP( abspos.x + relpos_x, 0, MAX_u32 ) ),
+        Cast( u32, CLAMP( abspos.y + relpos_y, 0, MAX_u32 ) )
+        );
+      auto value = ReadCellValueDuringExprEval( grid, abspos_arg, cells_subexpr );
+      if( error->text.len ) {
+        return {};
+      }
+      return value;
+    } break;
 
-        case fncalltype_t::relcell: {
-          VERIFY_ARGS_ARE_NUM_ARRAY;
-          AssertCrash( args._array.len == 2 );
-          auto relpos_x = ExpectGridAbsposRelCoord( args._array.mem[0]._f64, expr->fncall.args.mem[0], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto relpos_y = ExpectGridAbsposRelCoord( args._array.mem[1]._f64, expr->fncall.args.mem[1], error );
-          if( error->text.len ) {
-            return {};
-          }
-          absolutepos_t abspos_arg = _vec2<u32>(
-            Cast( u32, CLAMP( abspos.x + relpos_x, 0, MAX_u32 ) ),
-            Cast( u32, CLAMP( abspos.y + relpos_y, 0, MAX_u32 ) )
-            );
-          auto value = ReadCellValueDuringExprEval( grid, abspos_arg, cells_subexpr );
-          if( error->text.len ) {
-            return {};
-          }
-          return value;
-        } break;
+    case fncalltype_t::row    : {
+      VERIFY_ARGS_ARE_NUM_ARRAY;
+      AssertCrash( args._array.len == 3 );
+      auto abspos_y = ExpectGridAbsposCoord( args._array.mem[0]._f64, arg_instrs[0], error );
+      if( error->text.len ) {
+        return {};
+      }
+      auto abspos_x0 = ExpectGridAbsposCoord( args._array.mem[1]._f64, arg_instrs[1], error );
+      if( error->text.len ) {
+        return {};
+      }
+      auto abspos_x1 = ExpectGridAbsposCoord( args._array.mem[2]._f64, arg_instrs[2], error );
+      if( error->text.len ) {
+        return {};
+      }
+      // reorder x0,x1 s.t. x0 <= x1.
+      auto tmp0 = abspos_x0;
+      auto tmp1 = abspos_x1;
+      abspos_x0 = MIN( tmp0, tmp1 );
+      abspos_x1 = MAX( tmp0, tmp1 );
 
-        case fncalltype_t::row    : {
-          VERIFY_ARGS_ARE_NUM_ARRAY;
-          AssertCrash( args._array.len == 3 );
-          auto abspos_y = ExpectGridAbsposCoord( args._array.mem[0]._f64, expr->fncall.args.mem[0], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto abspos_x0 = ExpectGridAbsposCoord( args._array.mem[1]._f64, expr->fncall.args.mem[1], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto abspos_x1 = ExpectGridAbsposCoord( args._array.mem[2]._f64, expr->fncall.args.mem[2], error );
-          if( error->text.len ) {
-            return {};
-          }
-          // reorder x0,x1 s.t. x0 <= x1.
-          auto tmp0 = abspos_x0;
-          auto tmp1 = abspos_x1;
-          abspos_x0 = MIN( tmp0, tmp1 );
-          abspos_x1 = MAX( tmp0, tmp1 );
-
-          cellvalue_t value;
-          value.type = cellvaluetype_t::_array;
-          value._array.len = abspos_x1 - abspos_x0;
-          value._array.mem = AddPagelist( *evalmem, cellvalue_t, _SIZEOF_IDX_T, value._array.len );
-          Fori( u32, abspos_x, abspos_x0, abspos_x1 ) {
-            absolutepos_t abspos_elem = { abspos_x, abspos_y };
-            value._array.mem[abspos_x - abspos_x0] = ReadCellValueDuringExprEval( grid, abspos_elem, cells_subexpr );
-          }
-          return value;
-        } break;
-
-        case fncalltype_t::col    : {
-          VERIFY_ARGS_ARE_NUM_ARRAY;
-          AssertCrash( args._array.len == 3 );
-          auto abspos_x = ExpectGridAbsposCoord( args._array.mem[0]._f64, expr->fncall.args.mem[0], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto abspos_y0 = ExpectGridAbsposCoord( args._array.mem[1]._f64, expr->fncall.args.mem[1], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto abspos_y1 = ExpectGridAbsposCoord( args._array.mem[2]._f64, expr->fncall.args.mem[2], error );
-          if( error->text.len ) {
-            return {};
-          }
-          // reorder y0,y1 s.t. y0 <= y1.
-          auto tmp0 = abspos_y0;
-          auto tmp1 = abspos_y1;
-          abspos_y0 = MIN( tmp0, tmp1 );
-          abspos_y1 = MAX( tmp0, tmp1 );
-
-          cellvalue_t value;
-          value.type = cellvaluetype_t::_array;
-          value._array.len = abspos_y1 - abspos_y0;
-          value._array.mem = AddPagelist( *evalmem, cellvalue_t, _SIZEOF_IDX_T, value._array.len );
-          Fori( u32, abspos_y, abspos_y0, abspos_y1 ) {
-            absolutepos_t abspos_elem = { abspos_x, abspos_y };
-            value._array.mem[abspos_y - abspos_y0] = ReadCellValueDuringExprEval( grid, abspos_elem, cells_subexpr );
-          }
-          return value;
-        } break;
-
-        case fncalltype_t::rowrect: {
-          VERIFY_ARGS_ARE_NUM_ARRAY;
-          AssertCrash( args._array.len == 4 );
-          auto abspos_x0 = ExpectGridAbsposCoord( args._array.mem[0]._f64, expr->fncall.args.mem[0], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto abspos_y0 = ExpectGridAbsposCoord( args._array.mem[1]._f64, expr->fncall.args.mem[1], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto abspos_x1 = ExpectGridAbsposCoord( args._array.mem[2]._f64, expr->fncall.args.mem[2], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto abspos_y1 = ExpectGridAbsposCoord( args._array.mem[3]._f64, expr->fncall.args.mem[3], error );
-          if( error->text.len ) {
-            return {};
-          }
-          // reorder x0,x1 s.t. x0 <= x1.
-          auto tmp0 = abspos_x0;
-          auto tmp1 = abspos_x1;
-          abspos_x0 = MIN( tmp0, tmp1 );
-          abspos_x1 = MAX( tmp0, tmp1 );
-          // reorder y0,y1 s.t. y0 <= y1.
-          tmp0 = abspos_y0;
-          tmp1 = abspos_y1;
-          abspos_y0 = MIN( tmp0, tmp1 );
-          abspos_y1 = MAX( tmp0, tmp1 );
-
-          auto dim_x = abspos_x1 - abspos_x0;
-          auto dim_y = abspos_y1 - abspos_y0;
-          auto memblock = AddPagelist( *evalmem, cellvalue_t, _SIZEOF_IDX_T, ( dim_x + 1 ) * dim_y );
-          cellvalue_t value;
-          value.type = cellvaluetype_t::_array;
-          value._array.len = dim_y;
-          value._array.mem = memblock;
-          memblock += dim_y;
-          Fori( u32, y, 0, dim_y ) {
-            auto value_row = value._array.mem + y;
-            value_row->type = cellvaluetype_t::_array;
-            value_row->_array.len = dim_x;
-            value_row->_array.mem = memblock;
-            memblock += dim_x;
-            Fori( u32, x, 0, dim_x ) {
-              absolutepos_t abspos_elem = { abspos_x0 + x, abspos_y0 + y };
-              value_row->_array.mem[x] = ReadCellValueDuringExprEval( grid, abspos_elem, cells_subexpr );
-            }
-          }
-          return value;
-        } break;
-
-        case fncalltype_t::colrect: {
-          VERIFY_ARGS_ARE_NUM_ARRAY;
-          AssertCrash( args._array.len == 4 );
-          auto abspos_x0 = ExpectGridAbsposCoord( args._array.mem[0]._f64, expr->fncall.args.mem[0], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto abspos_y0 = ExpectGridAbsposCoord( args._array.mem[1]._f64, expr->fncall.args.mem[1], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto abspos_x1 = ExpectGridAbsposCoord( args._array.mem[2]._f64, expr->fncall.args.mem[2], error );
-          if( error->text.len ) {
-            return {};
-          }
-          auto abspos_y1 = ExpectGridAbsposCoord( args._array.mem[3]._f64, expr->fncall.args.mem[3], error );
-          if( error->text.len ) {
-            return {};
-          }
-          // reorder x0,x1 s.t. x0 <= x1.
-          auto tmp0 = abspos_x0;
-          auto tmp1 = abspos_x1;
-          abspos_x0 = MIN( tmp0, tmp1 );
-          abspos_x1 = MAX( tmp0, tmp1 );
-          // reorder y0,y1 s.t. y0 <= y1.
-          tmp0 = abspos_y0;
-          tmp1 = abspos_y1;
-          abspos_y0 = MIN( tmp0, tmp1 );
-          abspos_y1 = MAX( tmp0, tmp1 );
-
-          auto dim_x = abspos_x1 - abspos_x0;
-          auto dim_y = abspos_y1 - abspos_y0;
-          auto memblock = AddPagelist( *evalmem, cellvalue_t, _SIZEOF_IDX_T, dim_x * ( dim_y + 1 ) );
-          cellvalue_t value;
-          value.type = cellvaluetype_t::_array;
-          value._array.len = dim_x;
-          value._array.mem = memblock;
-          memblock += dim_x;
-          Fori( u32, x, 0, dim_x ) {
-            auto value_col = value._array.mem + x;
-            value_col->type = cellvaluetype_t::_array;
-            value_col->_array.len = dim_y;
-            value_col->_array.mem = memblock;
-            memblock += dim_y;
-            Fori( u32, y, 0, dim_y ) {
-              absolutepos_t abspos_elem = { abspos_x0 + x, abspos_y0 + y };
-              value_col->_array.mem[y] = ReadCellValueDuringExprEval( grid, abspos_elem, cells_subexpr );
-            }
-          }
-          return value;
-        } break;
-
-        case fncalltype_t::sum    : {
-          VERIFY_ARGS_ARE_NUM_ARRAY;
-          kahansum64_t sum = {};
-          FORLEN( arg, i, args._array )
-            Add( sum, arg->_f64 );
-          }
-          cellvalue_t value;
-          value.type = cellvaluetype_t::_f64;
-          value._f64 = sum.sum;
-          return value;
-        } break;
-
-        case fncalltype_t::max    : {
-          VERIFY_ARGS_ARE_NUM_ARRAY;
-          AssertCrash( args._array.len );
-          auto max = args._array.mem[0]._f64;
-          For( i, 1, args._array.len ) {
-            auto arg = args._array.mem + i;
-            max = MAX( max, arg->_f64 );
-          }
-          cellvalue_t value;
-          value.type = cellvaluetype_t::_f64;
-          value._f64 = max;
-          return value;
-        } break;
-
-        case fncalltype_t::min    : {
-          VERIFY_ARGS_ARE_NUM_ARRAY;
-          AssertCrash( args._array.len );
-          auto min = args._array.mem[0]._f64;
-          For( i, 1, args._array.len ) {
-            auto arg = args._array.mem + i;
-            min = MIN( min, arg->_f64 );
-          }
-          cellvalue_t value;
-          value.type = cellvaluetype_t::_f64;
-          value._f64 = min;
-          return value;
-        } break;
-
-        case fncalltype_t::mean   : {
-          VERIFY_ARGS_ARE_NUM_ARRAY;
-          kahansum64_t sum = {};
-          FORLEN( arg, i, args._array )
-            Add( sum, arg->_f64 );
-          }
-          cellvalue_t value;
-          value.type = cellvaluetype_t::_f64;
-          value._f64 = sum.sum / Cast( f64, args._array.len );
-          return value;
-        } break;
-
-        case fncalltype_t::median : {
-          VERIFY_ARGS_ARE_NUM_ARRAY;
-          AssertCrash( args._array.len );
-          ImplementCrash();
-        } break;
-
-        case fncalltype_t::graph  : {
-          AssertCrash( args.type == cellvaluetype_t::_array );
-          FORLEN( arg, i, args._array )
-            if( arg->type != cellvaluetype_t::_array ) {
-              Error( error, expr->fncall.args.mem[i]->tkn, Slice32FromCStr( "expected this to be an array argument!" ) );
-              return {};
-            }
-            // TODO: string columns.
-            // TODO: allow a minority of strings, and just turn them to 0 ?
-            // TODO: do we need to accept array-of-array-of-numbers too ?
-            FORLEN( arg_elem, j, arg->_array )
-              if( arg_elem->type != cellvaluetype_t::_f64 ) {
-                Error( error, expr->fncall.args.mem[i]->tkn, Slice32FromCStr( "expected this to be a number argument!" ) );
-                return {};
-              }
-            }
-          }
-          // graph(..) evaluates to the 2d array of value data.
-          // TODO: don't assume the args are already in that format, once we allow other arg formats.
-          auto value = args;
-          value.type = cellvaluetype_t::_graph;
-          return value;
-        } break;
-
-        default: UnreachableCrash();
-      }
-    } break;
-
-    case exprtype_t::array: {
-      return EvaluateExprArray( grid, evalmem, abspos, &expr->array, cells_subexpr, error );
+      cellvalue_t value;
+      value.type = cellvaluetype_t::_array;
+      value._array.len = abspos_x1 - abspos_x0;
+      value._array.mem = AddPagelist( *evalmem, cellvalue_t, _SIZEOF_IDX_T, value._array.len );
+      ReadCellRunDuringExprEval( grid, _vec2<u32>( abspos_x0, abspos_y ), value._array.len, 0, value._array.mem, cells_subexpr );
+      return value;
     } break;
 
-    case exprtype_t::unop: {
-      auto value = EvaluateExpr( grid, evalmem, abspos, expr->unop.expr, cells_subexpr, error );
+    case fncalltype_t::col    : {
+      VERIFY_ARGS_ARE_NUM_ARRAY;
+      AssertCrash( args._array.len == 3 );
+      auto abspos_x = ExpectGridAbsposCoord( args._array.mem[0]._f64, arg_instrs[0], error );
       if( error->text.len ) {
         return {};
       }
-      if( value.type != cellvaluetype_t::_f64 ) {
-        Error( error, expr->tkn, Slice32FromCStr( "unary operators expect a number!" ) );
+      auto abspos_y0 = ExpectGridAbsposCoord( args._array.mem[1]._f64, arg_instrs[1], error );
+      if( error->text.len ) {
         return {};
       }
-      switch( expr->unop.type ) {
-        case unoptype_t::not_: { value._f64 = value._f64 != 0; } break;
-        case unoptype_t::negate: { value._f64 = -value._f64; } break;
-        default: UnreachableCrash();
+      auto abspos_y1 = ExpectGridAbsposCoord( args._array.mem[2]._f64, arg_instrs[2], error );
+      if( error->text.len ) {
+        return {};
       }
+      // reorder y0,y1 s.t. y0 <= y1.
+      auto tmp0 = abspos_y0;
+      auto tmp1 = abspos_y1;
+      abspos_y0 = MIN( tmp0, tmp1 );
+      abspos_y1 = MAX( tmp0, tmp1 );
+
+      cellvalue_t value;
+      value.type = cellvaluetype_t::_array;
+      value._array.len = abspos_y1 - abspos_y0;
+      value._array.mem = AddPagelist( *evalmem, cellvalue_t, _SIZEOF_IDX_T, value._array.len );
+      ReadCellRunDuringExprEval( grid, _vec2<u32>( abspos_x, abspos_y0 ), value._array.len, 1, value._array.mem, cells_subexpr );
       return value;
     } break;
 
-    case exprtype_t::num: {
+    case fncalltype_t::rowrect: {
+      VERIFY_ARGS_ARE_NUM_ARRAY;
+      AssertCrash( args._array.len == 4 );
+      auto abspos_x0 = ExpectGridAbsposCoord( args._array.mem[0]._f64, arg_instrs[0], error );
+      if( error->text.len ) {
+        return {};
+      }
+      auto abspos_y0 = ExpectGridAbsposCoord( args._array.mem[1]._f64, arg_instrs[1], error );
+      if( error->text.len ) {
+        return {};
+      }
+      auto abspos_x1 = ExpectGridAbsposCoord( args._array.mem[2]._f64, arg_instrs[2], error );
+      if( error->text.len ) {
+        return {};
+      }
+      auto abspos_y1 = ExpectGridAbsposCoord( args._array.mem[3]._f64, arg_instrs[3], error );
+      if( error->text.len ) {
+        return {};
+      }
+      // reorder x0,x1 s.t. x0 <= x1.
+      auto tmp0 = abspos_x0;
+      auto tmp1 = abspos_x1;
+      abspos_x0 = MIN( tmp0, tmp1 );
+      abspos_x1 = MAX( tmp0, tmp1 );
+      // reorder y0,y1 s.t. y0 <= y1.
+      tmp0 = abspos_y0;
+      tmp1 = abspos_y1;
+      abspos_y0 = MIN( tmp0, tmp1 );
+      abspos_y1 = MAX( tmp0, tmp1 );
+
+      auto dim_x = abspos_x1 - abspos_x0;
+      auto dim_y = abspos_y1 - abspos_y0;
+      auto memblock = AddPagelist( *evalmem, cellvalue_t, _SIZEOF_IDX_T, ( dim_x + 1 ) * dim_y );
       cellvalue_t value;
-      value.type = cellvaluetype_t::_f64;
-      value._f64 = expr->num.value_f64;
+      value.type = cellvaluetype_t::_array;
+      value._array.len = dim_y;
+      value._array.mem = memblock;
+      memblock += dim_y;
+      Fori( u32, y, 0, dim_y ) {
+        auto value_row = value._array.mem + y;
+        value_row->type = cellvaluetype_t::_array;
+        value_row->_array.len = dim_x;
+        value_row->_array.mem = memblock;
+        memblock += dim_x;
+        ReadCellRunDuringExprEval( grid, _vec2<u32>( abspos_x0, abspos_y0 + y ), dim_x, 0, value_row->_array.mem, cells_subexpr );
+      }
       return value;
     } break;
 
-    case exprtype_t::binop: {
-      auto value_l = EvaluateExpr( grid, evalmem, abspos, expr->binop.expr_l, cells_subexpr, error );
+    case fncalltype_t::colrect: {
+      VERIFY_ARGS_ARE_NUM_ARRAY;
+      AssertCrash( args._array.len == 4 );
+      auto abspos_x0 = ExpectGridAbsposCoord( args._array.mem[0]._f64, arg_instrs[0], error );
       if( error->text.len ) {
         return {};
       }
-      auto value_r = EvaluateExpr( grid, evalmem, abspos, expr->binop.expr_r, cells_subexpr, error );
+      auto abspos_y0 = ExpectGridAbsposCoord( args._array.mem[1]._f64, arg_instrs[1], error );
       if( error->text.len ) {
         return {};
       }
-      if( value_l.type != cellvaluetype_t::_f64 ) {
-        Error( error, expr->binop.expr_l->tkn, Slice32FromCStr( "binary operator left-side should be a number!" ) );
+      auto abspos_x1 = ExpectGridAbsposCoord( args._array.mem[2]._f64, arg_instrs[2], error );
+      if( error->text.len ) {
         return {};
       }
-      if( value_r.type != cellvaluetype_t::_f64 ) {
-        Error( error, expr->binop.expr_r->tkn, Slice32FromCStr( "binary operator right-side should be a number!" ) );
+      auto abspos_y1 = ExpectGridAbsposCoord( args._array.mem[3]._f64, arg_instrs[3], error );
+      if( error->text.len ) {
         return {};
       }
+      // reorder x0,x1 s.t. x0 <= x1.
+      auto tmp0 = abspos_x0;
+      auto tmp1 = abspos_x1;
+      abspos_x0 = MIN( tmp0, tmp1 );
+      abspos_x1 = MAX( tmp0, tmp1 );
+      // reorder y0,y1 s.t. y0 <= y1.
+      tmp0 = abspos_y0;
+      tmp1 = abspos_y1;
+      abspos_y0 = MIN( tmp0, tmp1 );
+      abspos_y1 = MAX( tmp0, tmp1 );
+
+      auto dim_x = abspos_x1 - abspos_x0;
+      auto dim_y = abspos_y1 - abspos_y0;
+      auto memblock = AddPagelist( *evalmem, cellvalue_t, _SIZEOF_IDX_T, dim_x * ( dim_y + 1 ) );
+      cellvalue_t value;
+      value.type = cellvaluetype_t::_array;
+      value._array.len = dim_x;
+      value._array.mem = memblock;
+      memblock += dim_x;
+      Fori( u32, x, 0, dim_x ) {
+        auto value_col = value._array.mem + x;
+        value_col->type = cellvaluetype_t::_array;
+        value_col->_array.len = dim_y;
+        value_col->_array.mem = memblock;
+        memblock += dim_y;
+        ReadCellRunDuringExprEval( grid, _vec2<u32>( abspos_x0 + x, abspos_y0 ), dim_y, 1, value_col->_array.mem, cells_subexpr );
+      }
+      return value;
+    } break;
+
+    case fncalltype_t::sum    : {
+      VERIFY_ARGS_ARE_NUM_ARRAY;
+      kahansum64_t sum = {};
+      FORLEN( arg, i, args._array )
+        Add( sum, arg->_f64 );
+      }
       cellvalue_t value;
       value.type = cellvaluetype_t::_f64;
-      switch( expr->binop.type ) {
-        case binoptype_t::add: { value._f64 = value_l._f64 + value_r._f64; } break;
-        case binoptype_t::sub: { value._f64 = value_l._f64 - value_r._f64; } break;
-        case binoptype_t::mul: { value._f64 = value_l._f64 * value_r._f64; } break;
-        case binoptype_t::div: { value._f64 = value_l._f64 / value_r._f64; } break;
-        case binoptype_t::rem: { value._f64 = fmod( value_l._f64, value_r._f64 ); } break;
-        case binoptype_t::pow: { value._f64 = Pow64( value_l._f64, value_r._f64 ); } break;
-        default: UnreachableCrash();
+      value._f64 = sum.sum;
+      return value;
+    } break;
+
+    case fncalltype_t::max    : {
+      VERIFY_ARGS_ARE_NUM_ARRAY;
+      AssertCrash( args._array.len );
+      auto max = args._array.mem[0]._f64;
+      For( i, 1, args._array.len ) {
+        auto arg = args._array.mem + i;
+        max = MAX( max, arg->_f64 );
       }
+      cellvalue_t value;
+      value.type = cellvaluetype_t::_f64;
+      value._f64 = max;
+      return value;
+    } break;
+
+    case fncalltype_t::min    : {
+      VERIFY_ARGS_ARE_NUM_ARRAY;
+      AssertCrash( args._array.len );
+      auto min = args._array.mem[0]._f64;
+      For( i, 1, args._array.len ) {
+        auto arg = args._array.mem + i;
+        min = MIN( min, arg->_f64 );
+      }
+      cellvalue_t value;
+      value.type = cellvaluetype_t::_f64;
+      value._f64 = min;
+      return value;
+    } break;
+
+    case fncalltype_t::mean   : {
+      VERIFY_ARGS_ARE_NUM_ARRAY;
+      kahansum64_t sum = {};
+      FORLEN( arg, i, args._array )
+        Add( sum, arg->_f64 );
+      }
+      cellvalue_t value;
+      value.type = cellvaluetype_t::_f64;
+      value._f64 = sum.sum / Cast( f64, args._array.len );
+      return value;
+    } break;
+
+    case fncalltype_t::median : {
+      VERIFY_ARGS_ARE_NUM_ARRAY;
+      AssertCrash( args._array.len );
+      ImplementCrash();
+    } break;
+
+    case fncalltype_t::graph  : {
+      AssertCrash( args.type == cellvaluetype_t::_array );
+      FORLEN( arg, i, args._array )
+        if( arg->type != cellvaluetype_t::_array ) {
+          Error( error, arg_instrs[i], Slice32FromCStr( "expected this to be an array argument!" ) );
+          return {};
+        }
+        // TODO: string columns.
+        // TODO: allow a minority of strings, and just turn them to 0 ?
+        // TODO: do we need to accept array-of-array-of-numbers too ?
+        FORLEN( arg_elem, j, arg->_array )
+          if( arg_elem->type != cellvaluetype_t::_f64 ) {
+            Error( error, arg_instrs[i], Slice32FromCStr( "expected this to be a number argument!" ) );
+            return {};
+          }
+        }
+      }
+      // graph(..) evaluates to the 2d array of value data.
+      // TODO: don't assume the args are already in that format, once we allow other arg formats.
+      // note args is a view into the value stack, so copy it out.
+      cellvalue_t value;
+      value.type = cellvaluetype_t::_graph;
+      value._array = AddPagelistSlice32( *evalmem, cellvalue_t, _SIZEOF_IDX_T, args._array.len );
+      TMove( value._array.mem, ML( args._array ) );
       return value;
     } break;
 
@@ -2657,6 +2982,171 @@ EvaluateExpr(
   return {};
 }
 
+// runs an aggregate_row or aggregate_col instr. args are the row(..) or col(..) args, with arg_instrs the instrs
+// that produced each one.
+Inl cellvalue_t
+EvaluateAggregate(
+  grid_t* grid,
+  cellinstr_t* instr,
+  cellvalue_t* args,
+  cellinstr_t** arg_instrs,
+  stack_resizeable_cont_t<absolutepos_t>* cells_subexpr,
+  compileerror_t* error
+  )
+{
+  AssertCrash( instr->n == 3 );
+  u32 coords[3];
+  For( i, 0, 3 ) {
+    if( args[i].type != cellvaluetype_t::_f64 ) {
+      Error( error, arg_instrs[i], Slice32FromCStr( "expected this to be a number argument!" ) );
+      return {};
+    }
+    coords[i] = ExpectGridAbsposCoord( args[i]._f64, arg_instrs[i], error );
+    if( error->text.len ) {
+      return {};
+    }
+  }
+  // row(y,x0,x1) and col(x,y0,y1), with the range reordered s.t. lo <= hi.
+  auto along_y = instr->type == Cast( u8, cellinstrtype_t::aggregate_col );
+  auto lo = MIN( coords[1], coords[2] );
+  auto hi = MAX( coords[1], coords[2] );
+  auto type = Cast( fncalltype_t, instr->subtype );
+  if( type != fncalltype_t::sum  &&  lo == hi ) {
+    Error( error, instr, Slice32FromCStr( "expected a non-empty range!" ) );
+    return {};
+  }
+  auto abspos = along_y ? _vec2<u32>( coords[0], lo ) : _vec2<u32>( lo, coords[0] );
+  cellvalue_t value;
+  value.type = cellvaluetype_t::_f64;
+  if( !AggregateCellRunDuringExprEval( grid, abspos, hi - lo, along_y, type, &value._f64, cells_subexpr ) ) {
+    Error( error, instr, Slice32FromCStr( "expected every cell in the range to be a number!" ) );
+    return {};
+  }
+  return value;
+}
+
+// runs a compiled cell expression.
+// values and producers are scratch for the value stack; producers tracks which instr made each value, for errors.
+// flattens the positions of all cells read during evalutation into cells_subexpr.
+NoInl cellvalue_t
+EvaluateCellCode(
+  grid_t* grid,
+  pagelist_t* evalmem,
+  absolutepos_t abspos, // which cell we're evaluating into.  used for relcell and other relative stuff.
+  cellcode_t* code,
+  stack_resizeable_cont_t<cellvalue_t>* values,
+  stack_resizeable_cont_t<cellinstr_t*>* producers,
+  stack_resizeable_cont_t<absolutepos_t>* cells_subexpr,
+  compileerror_t* error
+  )
+{
+  AssertCrash( !code->error.text.len );
+  Reserve( *values, code->max_depth );
+  Reserve( *producers, code->max_depth );
+  auto stack = values->mem;
+  auto stack_instrs = producers->mem;
+  u32 top = 0;
+
+  Fori( u32, i, 0, code->ninstrs ) {
+    auto instr = code->instrs + i;
+    switch( Cast( cellinstrtype_t, instr->type ) ) {
+      case cellinstrtype_t::num: {
+        stack[top].type = cellvaluetype_t::_f64;
+        stack[top]._f64 = code->nums[ instr->n ];
+        stack_instrs[top] = instr;
+        top += 1;
+      } break;
+
+      case cellinstrtype_t::array: {
+        auto len = instr->n;
+        top -= len;
+        cellvalue_t value;
+        value.type = cellvaluetype_t::_array;
+        value._array = AddPagelistSlice32( *evalmem, cellvalue_t, _SIZEOF_IDX_T, len );
+        TMove( value._array.mem, stack + top, len );
+        stack[top] = value;
+        stack_instrs[top] = instr;
+        top += 1;
+      } break;
+
+      case cellinstrtype_t::fncall: {
+        auto len = instr->n;
+        top -= len;
+        cellvalue_t args;
+        args.type = cellvaluetype_t::_array;
+        args._array.mem = stack + top;
+        args._array.len = len;
+        auto value = EvaluateFncall( grid, evalmem, abspos, Cast( fncalltype_t, instr->subtype ), args, stack_instrs + top, cells_subexpr, error );
+        if( error->text.len ) {
+          return {};
+        }
+        stack[top] = value;
+        stack_instrs[top] = instr;
+        top += 1;
+      } break;
+
+      case cellinstrtype_t::aggregate_row:
+      case cellinstrtype_t::aggregate_col: {
+        top -= instr->n;
+        auto value = EvaluateAggregate( grid, instr, stack + top, stack_instrs + top, cells_subexpr, error );
+        if( error->text.len ) {
+          return {};
+        }
+        stack[top] = value;
+        stack_instrs[top] = instr;
+        top += 1;
+      } break;
+
+      case cellinstrtype_t::unop: {
+        AssertCrash( top );
+        auto value = stack + top - 1;
+        if( value->type != cellvaluetype_t::_f64 ) {
+          Error( error, instr, Slice32FromCStr( "unary operators expect a number!" ) );
+          return {};
+        }
+        switch( Cast( unoptype_t, instr->subtype ) ) {
+          case unoptype_t::not_: { value->_f64 = value->_f64 != 0; } break;
+          case unoptype_t::negate: { value->_f64 = -value->_f64; } break;
+          default: UnreachableCrash();
+        }
+        stack_instrs[top - 1] = instr;
+      } break;
+
+      case cellinstrtype_t::binop: {
+        AssertCrash( top >= 2 );
+        auto value_l = stack[top - 2];
+        auto value_r = stack[top - 1];
+        if( value_l.type != cellvaluetype_t::_f64 ) {
+          Error( error, stack_instrs[top - 2], Slice32FromCStr( "binary operator left-side should be a number!" ) );
+          return {};
+        }
+        if( value_r.type != cellvaluetype_t::_f64 ) {
+          Error( error, stack_instrs[top - 1], Slice32FromCStr( "binary operator right-side should be a number!" ) );
+          return {};
+        }
+        cellvalue_t value;
+        value.type = cellvaluetype_t::_f64;
+        switch( Cast( binoptype_t, instr->subtype ) ) {
+          case binoptype_t::add: { value._f64 = value_l._f64 + value_r._f64; } break;
+          case binoptype_t::sub: { value._f64 = value_l._f64 - value_r._f64; } break;
+          case binoptype_t::mul: { value._f64 = value_l._f64 * value_r._f64; } break;
+          case binoptype_t::div: { value._f64 = value_l._f64 / value_r._f64; } break;
+          case binoptype_t::rem: { value._f64 = fmod( value_l._f64, value_r._f64 ); } break;
+          case binoptype_t::pow: { value._f64 = Pow64( value_l._f64, value_r._f64 ); } break;
+          default: UnreachableCrash();
+        }
+        top -= 1;
+        stack[top - 1] = value;
+        stack_instrs[top - 1] = instr;
+      } break;
+
+      default: UnreachableCrash();
+    }
+  }
+  AssertCrash( top == 1 );
+  return stack[0];
+}
+
 Inl bool
 EqualErrors(
   cellerror_t* a,
@@ -2851,322 +3341,589 @@ AddToCursel( grid_t* grid, absolutepos_t abspos )
 }
 
 //
-// assumes input is already allocated on grid->cellmem
+// recalc.
+// callers set cell inputs, then hand the changed cells to RecalcCells as seeds.
+// we walk superexprs from the seeds to find the dirty set, sort it with TopologicalSortKahn, and evaluate it one
+// level at a time. a level is the set of dirty cells whose dirty subexprs are all in lower levels, so cells in a
+// level don't depend on each other, and wide levels get spread across the taskthreads.
+// anything Kahn can't sort is part of a reference cycle, or downstream of one.
 //
-// TODO: should we try to remove the leading eq requirement?
-// seems like it'd be nice, since you're usually putting data in cells
-// the one concern is that we'd fail to compile regular string data, and we wouldn't know
-// whether to show the compile error or not. when you're putting in string data, you don't
-// want to see compile errors constantly. actually, presence of parens is probably all we
-// need to decide. we could do more advanced filters if we want.
-// let's proceed with no leading eq required, and see how that is.
+// we only know a cell's subexprs after evaluating it, since cell(x,y) args can be computed. so seeds start with
+// no subexprs, and a cell that reads a dirty cell which wasn't in a lower level gets re-run in another round,
+// along with its superexprs, now that its edges are right.
+// e.g. LoadCSV's first round evaluates the whole sheet as one level, and the second round orders the formulas.
+// each round settles at least the lowest level that still had a wrong edge, so a dependency chain L levels deep is
+// done within L + 1 rounds. we allow one more round than the deepest level count we've seen; past that, computed
+// references keep moving the edges around, and we give up on what's left the same way we do for cycles.
 //
-Inl void
-InsertOrSetCellContents(
-  grid_t* grid,
-  absoluterectlist_t* rectlist,
-  slice32_t input
-  )
-{
-  FORLEN( rect, i, *rectlist )
-    Fori( u32, y, rect->p0.y, rect->p1.y ) {
-    Fori( u32, x, rect->p0.x, rect->p1.x ) {
-      absolutepos_t abspos = { x, y };
-      auto cell = AccessCell( grid, abspos );
-#if PACKCELL
-      cell->input_mem = input.mem;
-      cell->input_len = input.len;
-#else
-      cell->input = input;
-#endif
-
-      // PERF: could tokenize/parse the initial input outside the 3 loops above.
-      // it's unlikely we could do eval outside the loops.
-
-      // bump generation, so we can detect cycles anew.
-      grid->eval_generation += 1;
-
-      stack_resizeable_cont_t<token_t> tokens;
-      Alloc( tokens, 1024 );
-
-      pagelist_t nodemem;
-      Init( nodemem, 16000 );
-      stack_resizeable_cont_t<node_expr_t*> tmpargmem;
-      Alloc( tmpargmem, 512 );
-      stack_resizeable_cont_t<cell_t*> cells_subexpr;
-      Alloc( cells_subexpr, 512 );
-      stack_resizeable_cont_t<cellandpos_t> cells_superexpr;
-      Alloc( cells_superexpr, 512 );
+constant u32 c_recalc_parallel_min = 256; // smaller levels aren't worth waking the taskthreads for.
+constant u32 c_recalc_chunk = 64;
 
-      parse_input_t parse_input;
-      parse_input.tokens = &tokens;
-      parse_input.nodemem = &nodemem;
-      parse_input.errortextmem = &grid->cellmem;
-      parse_input.tmpargmem = &tmpargmem;
+// per-thread evaluation state.
+struct
+recalcscratch_t
+{
+  stack_resizeable_cont_t<token_t> tokens;
+  pagelist_t nodemem;
+  stack_resizeable_cont_t<node_expr_t*> tmpargmem;
+  pagelist_t resultmem; // parse error text and array values, which live until the level is committed.
+  stack_resizeable_cont_t<absolutepos_t> reads;
+  stack_resizeable_cont_t<cellinstr_t> instrs;
+  stack_resizeable_cont_t<f64> nums;
+  stack_resizeable_cont_t<cellvalue_t> values;
+  stack_resizeable_cont_t<cellinstr_t*> producers;
+};
 
-      auto cellandpos = AddBack( cells_superexpr );
-      cellandpos->cell = cell;
-      cellandpos->abspos = abspos;
+Inl void
+Init( recalcscratch_t* scratch )
+{
+  Alloc( scratch->tokens, 1024 );
+  Init( scratch->nodemem, 16000 );
+  Alloc( scratch->tmpargmem, 512 );
+  Init( scratch->resultmem, 16000 );
+  Alloc( scratch->reads, 512 );
+  Alloc( scratch->instrs, 64 );
+  Alloc( scratch->nums, 64 );
+  Alloc( scratch->values, 64 );
+  Alloc( scratch->producers, 64 );
+}
 
-      bool cycle_detected = 0;
+Inl void
+Kill( recalcscratch_t* scratch )
+{
+  Free( scratch->producers );
+  Free( scratch->values );
+  Free( scratch->nums );
+  Free( scratch->instrs );
+  Free( scratch->reads );
+  Kill( scratch->resultmem );
+  Free( scratch->tmpargmem );
+  Kill( scratch->nodemem );
+  Free( scratch->tokens );
+}
 
-      ForLen( j, cells_superexpr ) {
-        cellandpos = cells_superexpr.mem + j;
-        cell = cellandpos->cell;
+struct
+recalcresult_t
+{
+  cellvalue_t value;
+  cellerror_t error;
+  u32 scratch; // which scratch holds the reads.
+  u32 nreads;
+  idx_t reads_offset;
+};
 
-        compileerror_t error = {};
+// one level's worth of work, shared with the taskthreads.
+struct
+recalclevel_t
+{
+  grid_t* grid;
+  u32* items;
+  recalcresult_t* results;
+  recalcscratch_t* scratches;
+  idx_t nitems;
+};
 
-        if( cycle_detected ) {
-          Error( &error, 0, 0, Slice32FromCStr( "part of a reference cycle!" ) );
+Inl slice32_t
+CellInput( cell_t* cell )
+{
+#if PACKCELL
+  slice32_t r;
+  r.mem = cell->input_mem;
+  r.len = cell->input_len;
+  return r;
+#else
+  return cell->input;
+#endif
+}
 
-          // set cell value
-          cell->eval_generation = grid->eval_generation;
+// note the value and error text must already live somewhere persistent.
+Inl void
+SetCellResult( cell_t* cell, cellvalue_t* value, cellerror_t* error, u32 eval_generation )
+{
+  cell->eval_generation = eval_generation;
 #if PACKCELL
-          cell->error_text_mem = error.text.mem;
-          AssertCrash( error.text.len <= MAX_u16 );
-          cell->error_text_len = Cast( u16, error.text.len );
-          AssertCrash( error.start <= MAX_u16 );
-          cell->error_start = Cast( u16, error.start );
-          AssertCrash( error.end <= MAX_u16 );
-          cell->error_end = Cast( u16, error.end );
-          cell->value_type = Cast( u16, cellvaluetype_t::_string );
-          auto value = Slice32FromCStr( "ERROR_CYCLE" );
-          cell->value_mem = value.mem;
-          cell->value_len = value.len;
+  cell->error_text_mem = error->text.mem;
+  AssertCrash( error->text.len <= MAX_u16 );
+  cell->error_text_len = Cast( u16, error->text.len );
+  AssertCrash( error->start <= MAX_u16 );
+  cell->error_start = Cast( u16, error->start );
+  AssertCrash( error->end <= MAX_u16 );
+  cell->error_end = Cast( u16, error->end );
+  cell->value_type = Cast( u16, value->type );
+  switch( value->type ) {
+    case cellvaluetype_t::_f64: {
+      *Cast( f64*, &cell->value_mem ) = value->_f64;
+    } break;
+    case cellvaluetype_t::_string: {
+      cell->value_len = value->_string.len;
+      cell->value_mem = value->_string.mem;
+    } break;
+    case cellvaluetype_t::_array:
+    case cellvaluetype_t::_graph: {
+      cell->value_len = value->_array.len;
+      cell->value_mem = Cast( u8*, value->_array.mem );
+    } break;
+    default: UnreachableCrash();
+  }
 #else
-          cell->error.text = error.text;
-          cell->error.start = error.start;
-          cell->error.end = error.end;
-          cell->value.type = cellvaluetype_t::_string;
-          cell->value._string = Slice32FromCStr( "ERROR_CYCLE" );
+  cell->error = *error;
+  cell->value = *value;
 #endif
+}
 
-          // since this cell changed, loop over all superexprs which depend on this cell.
-          FORLEN( edge, m, grid->graph_edges )
-            if( edge->end == cell ) {
-              auto cell_superexpr = edge->start.cell;
-              auto abspos_superexpr = edge->start.abspos;
-              AssertCrash( cell_superexpr->eval_generation <= grid->eval_generation );
-              // walk the cycle in the superexpr direction, but avoid visiting cells we already covered.
-              // we don't want to infinite-walk the cycle.
-              if( cell_superexpr->eval_generation < grid->eval_generation ) {
-                auto cellandpos2 = AddBack( cells_superexpr );
-                cellandpos2->cell = cell_superexpr;
-                cellandpos2->abspos = abspos_superexpr;
-              }
-            }
-          }
-          continue;
-        }
+// runs on any thread; only reads the grid.
+NoInl void
+_RecalcEvaluate(
+  grid_t* grid,
+  recalcscratch_t* scratch,
+  u32 scratch_idx,
+  gridnode_t* node,
+  recalcresult_t* result
+  )
+{
+  result->value = {};
+  result->error = {};
+  result->scratch = scratch_idx;
+  result->nreads = 0;
+  result->reads_offset = scratch->reads.len;
+
+  // deleted cells have no input, and go back to the zero value.
+  auto input = CellInput( node->cell );
+  if( !input.len ) {
+    return;
+  }
 
-        if( cell->eval_generation == grid->eval_generation ) {
-          Error( &error, 0, 0, Slice32FromCStr( "head of a reference cycle!" ) );
-          cycle_detected = 1;
+  Reset( scratch->nodemem );
+  if( !node->code ) {
+    // note we own this node for the level, so it's safe to fill in the cache from any thread.
+    node->code = CompileCellInput(
+      input,
+      &scratch->tokens,
+      &scratch->nodemem,
+      &scratch->tmpargmem,
+      &scratch->resultmem,
+      &scratch->instrs,
+      &scratch->nums
+      );
+  }
+  auto code = node->code;
+  compileerror_t error = code->error;
+  cellvalue_t value = {};
+  if( !error.text.len ) {
+    value = EvaluateCellCode( grid, &scratch->nodemem, node->abspos, code, &scratch->values, &scratch->producers, &scratch->reads, &error );
+  }
+  AssertCrash( scratch->reads.len - result->reads_offset <= MAX_u32 );
+  result->nreads = Cast( u32, scratch->reads.len - result->reads_offset );
+
+  if( error.text.len ) {
+    result->error.text = error.text;
+    result->error.start = error.start;
+    result->error.end = error.end;
+    result->value.type = cellvaluetype_t::_string;
+    result->value._string = input;
+    return;
+  }
+  switch( value.type ) {
+    case cellvaluetype_t::_f64:
+    case cellvaluetype_t::_string: {
+      result->value = value;
+    } break;
 
-          // bump generation again, since we may have evaluated some cells in the cycle before detecting it!
-          // we'll need to cycle through again, so start anew.
-          grid->eval_generation += 1;
+    case cellvaluetype_t::_array:
+    case cellvaluetype_t::_graph: {
+      // EvaluateCellCode allocates arrays in the nodemem, which we reset for the next cell.
+      CopyCellValue( &result->value, &scratch->resultmem, &value );
+    } break;
+    default: UnreachableCrash();
+  }
+}
 
-          // set cell value
-          cell->eval_generation = grid->eval_generation;
-#if PACKCELL
-          cell->error_text_mem = error.text.mem;
-          AssertCrash( error.text.len <= MAX_u16 );
-          cell->error_text_len = Cast( u16, error.text.len );
-          AssertCrash( error.start <= MAX_u16 );
-          cell->error_start = Cast( u16, error.start );
-          AssertCrash( error.end <= MAX_u16 );
-          cell->error_end = Cast( u16, error.end );
-          cell->value_type = Cast( u16, cellvaluetype_t::_string );
-          auto value = Slice32FromCStr( "ERROR_CYCLEHEAD" );
-          cell->value_mem = value.mem;
-          cell->value_len = value.len;
-#else
-          cell->error.text = error.text;
-          cell->error.start = error.start;
-          cell->error.end = error.end;
-          cell->value.type = cellvaluetype_t::_string;
-          cell->value._string = Slice32FromCStr( "ERROR_CYCLEHEAD" );
-#endif
+// each ParallelFor worker gets its own scratch.
+__ParallelForBody( ParallelFor_RecalcChunk )
+{
+  auto level = Cast( recalclevel_t*, misc );
+  auto scratch = level->scratches + worker;
+  auto i0 = k * c_recalc_chunk;
+  auto i1 = MIN( i0 + c_recalc_chunk, level->nitems );
+  For( i, i0, i1 ) {
+    auto node = level->grid->graph_nodes.mem + level->items[i];
+    _RecalcEvaluate( level->grid, scratch, Cast( u32, worker ), node, level->results + i );
+  }
+}
 
-          // since this cell changed, loop over all superexprs which depend on this cell.
-          FORLEN( edge, m, grid->graph_edges )
-            if( edge->end == cell ) {
-              *AddBack( cells_superexpr ) = edge->start;
-            }
-          }
-          continue;
-        }
+// evaluates items into results, and returns how many scratches were used.
+// note this is only allowed on the main thread, since ParallelFor pushes tasks.
+Inl idx_t
+_RecalcRunLevel(
+  grid_t* grid,
+  recalcscratch_t* scratches,
+  idx_t nscratches,
+  u32* items,
+  recalcresult_t* results,
+  idx_t nitems
+  )
+{
+  recalclevel_t level;
+  level.grid = grid;
+  level.items = items;
+  level.results = results;
+  level.scratches = scratches;
+  level.nitems = nitems;
+  auto nchunks = ( nitems + c_recalc_chunk - 1 ) / c_recalc_chunk;
+  auto max_workers = ( nitems < c_recalc_parallel_min )  ?  1  :  nscratches;
+  return ParallelFor( ParallelFor_RecalcChunk, &level, nchunks, max_workers );
+}
 
-        cells_subexpr.len = 0;
-        tokens.len = 0;
+// writes a level's results into the cells and updates their edges. main thread only, since this allocates cells.
+// cells that read a stale value are added to reseeds.
+Inl void
+_RecalcCommitLevel(
+  grid_t* grid,
+  recalcscratch_t* scratches,
+  u32* items,
+  recalcresult_t* results,
+  idx_t nitems,
+  u32 level_idx,
+  stack_resizeable_cont_t<u32>* subexprs,
+  stack_resizeable_cont_t<u32>* reseeds
+  )
+{
+  For( i, 0, nitems ) {
+    auto n = items[i];
+    auto result = results + i;
+
+    auto error = result->error;
+    if( error.text.len ) {
+      auto text = AddPagelistSlice32( grid->cellmem, u8, 1, error.text.len );
+      Memmove( text.mem, ML( error.text ) );
+      error.text = text;
+    }
+    cellvalue_t value;
+    if( result->value.type == cellvaluetype_t::_array  ||  result->value.type == cellvaluetype_t::_graph ) {
+      CopyCellValue( &value, &grid->cellmem, &result->value );
+    }
+    else {
+      value = result->value;
+    }
+    SetCellResult( grid->graph_nodes.mem[n].cell, &value, &error, grid->eval_generation );
+
+    // note we have a graph edge (a,b) iff b is a cell read by a's expression.
+    // e.g. A=cell(B)
+    subexprs->len = 0;
+    bool stale = 0;
+    auto reads = scratches[ result->scratch ].reads.mem + result->reads_offset;
+    For( r, 0, result->nreads ) {
+      auto abspos = reads[r];
+      auto sub = GraphNodeFromCell( grid, AccessCell( grid, abspos ), abspos );
+      *AddBack( *subexprs ) = sub;
+      auto subnode = grid->graph_nodes.mem + sub;
+      if( subnode->generation == grid->eval_generation  &&  subnode->level >= level_idx ) {
+        stale = 1;
+      }
+    }
+    // keep error cells' dependency info, since it's possible they could eval back to non-error
+    // if the user changes other cells.
+    if( error.text.len ) {
+      auto node = grid->graph_nodes.mem + n;
+      TMove( AddBack( *subexprs, node->subexprs.len ), ML( node->subexprs ) );
+    }
+    SetSubexprs( grid, n, ML( *subexprs ) );
+    if( stale ) {
+      *AddBack( *reseeds ) = n;
+    }
+  }
+}
 
-        if( !error.text.len ) {
-          slice32_t cellinput;
-#if PACKCELL
-          cellinput.mem = cell->input_mem;
-          cellinput.len = cell->input_len;
-#else
-          cellinput = cell->input;
-#endif
-          Tokenize( cellinput, &tokens, &error );
+// seeds are node indices of cells whose inputs changed; their subexprs should already be cleared.
+void
+RecalcCells(
+  grid_t* grid,
+  stack_resizeable_cont_t<u32>* seeds
+  )
+{
+  stack_resizeable_cont_t<u32> pending;
+  Alloc( pending, MAX( seeds->len, 64 ) );
+  Copy( pending, *seeds );
+  stack_resizeable_cont_t<u32> reseeds;
+  Alloc( reseeds, 64 );
+  stack_resizeable_cont_t<u32> dirty;
+  Alloc( dirty, pending.capacity );
+  stack_resizeable_cont_t<u32> items;
+  Alloc( items, pending.capacity );
+  stack_resizeable_cont_t<u32> level_offsets;
+  Alloc( level_offsets, 64 );
+  stack_resizeable_cont_t<u32> subexprs;
+  Alloc( subexprs, 64 );
+  stack_resizeable_cont_t<recalcresult_t> results;
+  Alloc( results, 64 );
+
+  // CSR form of the dirty subgraph, for TopologicalSortKahn. edges point from subexpr to superexpr.
+  stack_resizeable_cont_t<e_t> outoffsets;
+  Alloc( outoffsets, pending.capacity );
+  stack_resizeable_cont_t<e_t> outdegrees;
+  Alloc( outdegrees, pending.capacity );
+  stack_resizeable_cont_t<e_t> indegrees;
+  Alloc( indegrees, pending.capacity );
+  stack_resizeable_cont_t<n_t> outnodes;
+  Alloc( outnodes, pending.capacity );
+  stack_resizeable_cont_t<n_t> buffer;
+  Alloc( buffer, pending.capacity );
+  stack_resizeable_cont_t<n_t> sorted;
+  Alloc( sorted, pending.capacity );
+
+  auto nscratches = 1 + g_mainthread.taskthreads.len;
+  auto scratches = MemHeapAlloc( recalcscratch_t, nscratches );
+  For( i, 0, nscratches ) {
+    Init( scratches + i );
+  }
+
+  u32 max_nlevels = 0;
+  for( u32 round = 0;  pending.len  &&  round <= max_nlevels + 1;  ++round ) {
+    grid->eval_generation += 1;
+    auto generation = grid->eval_generation;
+    auto nodes = grid->graph_nodes.mem;
+
+    // find the dirty set.
+    dirty.len = 0;
+    FORLEN( seed, i, pending )
+      auto node = nodes + *seed;
+      if( node->generation != generation ) {
+        node->generation = generation;
+        *AddBack( dirty ) = *seed;
+      }
+    }
+    idx_t nedges = 0;
+    ForLen( i, dirty ) {
+      auto node = nodes + dirty.mem[i];
+      AssertCrash( i <= MAX_u32 );
+      node->dirty_idx = Cast( u32, i );
+      nedges += node->superexprs.len;
+      FORLEN( super, j, node->superexprs )
+        auto supernode = nodes + *super;
+        if( supernode->generation != generation ) {
+          supernode->generation = generation;
+          *AddBack( dirty ) = *super;
         }
+      }
+    }
+    AssertCrash( dirty.len <= MAX_u32 );
+    auto N = Cast( n_t, dirty.len );
+
+    outoffsets.len = 0;
+    AddBack( outoffsets, N );
+    outdegrees.len = 0;
+    AddBack( outdegrees, N );
+    indegrees.len = 0;
+    AddBack( indegrees, N );
+    Memzero( indegrees.mem, N * sizeof( e_t ) );
+    outnodes.len = 0;
+    AddBack( outnodes, nedges );
+    buffer.len = 0;
+    AddBack( buffer, N );
+    sorted.len = 0;
+    AddBack( sorted, N );
+    e_t offset = 0;
+    Fori( n_t, u, 0, N ) {
+      auto node = nodes + dirty.mem[u];
+      outoffsets.mem[u] = offset;
+      outdegrees.mem[u] = node->superexprs.len;
+      FORLEN( super, j, node->superexprs )
+        auto v = nodes[ *super ].dirty_idx;
+        outnodes.mem[ offset++ ] = v;
+        indegrees.mem[v] += 1;
+      }
+    }
+    bool found_cycle = 0;
+    TopologicalSortKahn( N, nedges, outoffsets.mem, outdegrees.mem, indegrees.mem, outnodes.mem, buffer.mem, sorted.mem, &found_cycle );
+
+    // Kahn only takes edges out of a node once it's sorted, so whatever still has indegree is unsorted.
+    n_t nsorted = 0;
+    Fori( n_t, u, 0, N ) {
+      nodes[ dirty.mem[u] ].level = MAX_u32;
+      nsorted += !indegrees.mem[u];
+    }
+    AssertCrash( found_cycle == ( nsorted < N ) );
 
-        node_expr_t* expr = 0;
-        if( !error.text.len ) {
-          expr = Parse( &parse_input, &error );
+    // assign levels, in sorted order so every subexpr's level is final before we look at it.
+    Fori( n_t, i, 0, nsorted ) {
+      nodes[ dirty.mem[ sorted.mem[i] ] ].level = 0;
+    }
+    u32 nlevels = 0;
+    Fori( n_t, i, 0, nsorted ) {
+      auto node = nodes + dirty.mem[ sorted.mem[i] ];
+      nlevels = MAX( nlevels, node->level + 1 );
+      FORLEN( super, j, node->superexprs )
+        auto supernode = nodes + *super;
+        if( supernode->level != MAX_u32 ) {
+          supernode->level = MAX( supernode->level, node->level + 1 );
         }
-        cellvalue_t value = {};
-        if( !error.text.len ) {
-          AssertCrash( expr );
-          value = EvaluateExpr( grid, &nodemem, cellandpos->abspos, expr, &cells_subexpr, &error );
+      }
+    }
+    max_nlevels = MAX( max_nlevels, nlevels );
+
+    // bucket the sorted nodes by level.
+    level_offsets.len = 0;
+    AddBack( level_offsets, nlevels + 1 );
+    Memzero( level_offsets.mem, ( nlevels + 1 ) * sizeof( u32 ) );
+    Fori( n_t, i, 0, nsorted ) {
+      level_offsets.mem[ nodes[ dirty.mem[ sorted.mem[i] ] ].level + 1 ] += 1;
+    }
+    Fori( u32, l, 0, nlevels ) {
+      level_offsets.mem[l + 1] += level_offsets.mem[l];
+    }
+    items.len = 0;
+    AddBack( items, nsorted );
+    Fori( n_t, i, 0, nsorted ) {
+      auto n = dirty.mem[ sorted.mem[i] ];
+      items.mem[ level_offsets.mem[ nodes[n].level ]++ ] = n;
+    }
+    // the placement loop advanced each offset to the start of the next level, so shift them back.
+    for( u32 l = nlevels;  l > 0;  --l ) {
+      level_offsets.mem[l] = level_offsets.mem[l - 1];
+    }
+    level_offsets.mem[0] = 0;
+
+    if( found_cycle ) {
+      Fori( n_t, u, 0, N ) {
+        auto node = nodes + dirty.mem[u];
+        if( node->level == MAX_u32 ) {
+          cellerror_t error = {};
+          error.text = Slice32FromCStr( "part of a reference cycle!" );
+          cellvalue_t value;
+          value.type = cellvaluetype_t::_string;
+          value._string = Slice32FromCStr( "ERROR_CYCLE" );
+          SetCellResult( node->cell, &value, &error, generation );
         }
+      }
+    }
 
-        // note we have a graph edge (a,b) iff b is a cell referenced by a's expression.
-        // e.g. A=cell(B)
-
-        // keep error cells' dependency info, since it's possible they could eval back to non-error
-        // if the user changes other cells.
-        if( !error.text.len ) {
-#if 1
-          // rewrite as many existing (cell,*) edges as we have, and remove excess ones if needed.
-          // note we effectively delete the previous subexprs, since they could have changed.
-          idx_t m = 0;
-          idx_t k = 0;
-          while( k < grid->graph_edges.len ) {
-            auto edge = grid->graph_edges.mem + k;
-            if( edge->start.cell == cell ) {
-              if( m < cells_subexpr.len ) {
-                auto cell_subexpr = cells_subexpr.mem[m];
-                edge->end = cell_subexpr;
-                m += 1;
-              }
-              else {
-                UnorderedRemAt( grid->graph_edges, k );
-                continue;
-              }
-            }
-            k += 1;
-          }
-          while( m < cells_subexpr.len ) {
-            auto cell_subexpr = cells_subexpr.mem[m];
-            auto graph_edge = AddBack( grid->graph_edges );
-            graph_edge->start.cell = cell;
-            graph_edge->start.abspos = cellandpos->abspos;
-            graph_edge->end = cell_subexpr;
-            m += 1;
-          }
-#else
-          // delete previous subexprs, since they could have changed.
-          idx_t k = 0;
-          while( k < grid->graph_edges.len ) {
-            auto edge = grid->graph_edges.mem + k;
-            if( edge->start == cell ) {
-              UnorderedRemAt( grid->graph_edges, k );
-              continue;
-            }
-            k += 1;
-          }
+    reseeds.len = 0;
+    Fori( u32, l, 0, nlevels ) {
+      auto level_items = items.mem + level_offsets.mem[l];
+      auto nitems = level_offsets.mem[l + 1] - level_offsets.mem[l];
+      results.len = 0;
+      AddBack( results, nitems );
+      auto nscratches_used = _RecalcRunLevel( grid, scratches, nscratches, level_items, results.mem, nitems );
+      _RecalcCommitLevel( grid, scratches, level_items, results.mem, nitems, l, &subexprs, &reseeds );
+      For( i, 0, nscratches_used ) {
+        Reset( scratches[i].resultmem );
+        scratches[i].reads.len = 0;
+      }
+    }
 
-          // add subexprs so we have that connectivity info.
-          // TODO/PERF: could rewrite existing (cell,*) edges instead of removing, then adding.
-          FORLEN( cell_subexpr, m, cells_subexpr )
-            auto graph_edge = AddBack( grid->graph_edges );
-            graph_edge->start = cell;
-            graph_edge->end = cell_subexpr;
-          }
-#endif
+    auto tmp = pending;
+    pending = reseeds;
+    reseeds = tmp;
+  }
+
+  // out of rounds; don't leave stale values around looking like results.
+  AssertWarn( !pending.len );
+  if( pending.len ) {
+    grid->eval_generation += 1;
+    auto generation = grid->eval_generation;
+    auto nodes = grid->graph_nodes.mem;
+    // the leftovers' superexprs were computed from the leftovers' stale values, so they get the error too.
+    dirty.len = 0;
+    FORLEN( seed, i, pending )
+      auto node = nodes + *seed;
+      if( node->generation != generation ) {
+        node->generation = generation;
+        *AddBack( dirty ) = *seed;
+      }
+    }
+    ForLen( i, dirty ) {
+      auto node = nodes + dirty.mem[i];
+      FORLEN( super, j, node->superexprs )
+        auto supernode = nodes + *super;
+        if( supernode->generation != generation ) {
+          supernode->generation = generation;
+          *AddBack( dirty ) = *super;
         }
+      }
+      cellerror_t error = {};
+      error.text = Slice32FromCStr( "references didn't settle!" );
+      cellvalue_t value;
+      value.type = cellvaluetype_t::_string;
+      value._string = Slice32FromCStr( "ERROR_UNSETTLED" );
+      SetCellResult( node->cell, &value, &error, generation );
+    }
+  }
 
-        // set cell value
-        cell->eval_generation = grid->eval_generation;
+  For( i, 0, nscratches ) {
+    Kill( scratches + i );
+  }
+  MemHeapFree( scratches );
+  Free( sorted );
+  Free( buffer );
+  Free( outnodes );
+  Free( indegrees );
+  Free( outdegrees );
+  Free( outoffsets );
+  Free( results );
+  Free( subexprs );
+  Free( level_offsets );
+  Free( items );
+  Free( dirty );
+  Free( reseeds );
+  Free( pending );
+}
+
+// sets the input and clears the subexprs, since they're about to change. returns the cell's node index.
+// assumes input is already allocated on grid->cellmem
+Inl u32
+SetCellInput(
+  grid_t* grid,
+  absolutepos_t abspos,
+  slice32_t input
+  )
+{
+  auto cell = AccessCell( grid, abspos );
 #if PACKCELL
-        cell->error_text_mem = error.text.mem;
-        AssertCrash( error.text.len <= MAX_u16 );
-        cell->error_text_len = Cast( u16, error.text.len );
-        AssertCrash( error.start <= MAX_u16 );
-        cell->error_start = Cast( u16, error.start );
-        AssertCrash( error.end <= MAX_u16 );
-        cell->error_end = Cast( u16, error.end );
-        if( error.text.len ) {
-          cell->value_type = Cast( u16, cellvaluetype_t::_string );
-          cell->value_mem = cell->input_mem;
-          cell->value_len = cell->input_len;
-        }
-        else {
-          switch( value.type ) {
-            case cellvaluetype_t::_f64: {
-              *Cast( f64*, &cell->value_mem ) = value._f64;
-            } break;
-            case cellvaluetype_t::_string: {
-              cell->value_len = value._string.len;
-              cell->value_mem = value._string.mem;
-            } break;
-            case cellvaluetype_t::_array:
-            case cellvaluetype_t::_graph: {
-              // TODO: EvaluateExpr will allocate in the nodemem, which is freed at the end of this fn.
-              //   we'll need to copy the array contents into grid->cellmem, or
-              //   change EvaluateExpr to allocate there directly.
-              //   knowing we can allocate there directly seems a bit challenging, esp. since we'll add/change
-              //   a bunch of grid functions.
-              //   so probably best to just copy here for now, and try to eliminate it later, once the
-              //   grid function set is more stabilized.
-              //   note it's kind of annoying to copy, since we have to recurse for nested arrays.
-              cellvalue_t copied_value;
-              CopyCellValue( &copied_value, &grid->cellmem, &value );
-              cell->value_len = copied_value._array.len;
-              cell->value_mem = Cast( u8*, copied_value._array.mem );
-            } break;
-            default: UnreachableCrash();
-          }
-        }
+  cell->input_mem = input.mem;
+  cell->input_len = input.len;
 #else
-        cell->error.text = error.text;
-        cell->error.start = error.start;
-        cell->error.end = error.end;
-        if( error.text.len ) {
-          cell->value.type = cellvaluetype_t::_string;
-          cell->value._string = cell->input;
-        }
-        else {
-          switch( value.type ) {
-            case cellvaluetype_t::_f64:
-            case cellvaluetype_t::_string: {
-              cell->value = value;
-            } break;
-
-            case cellvaluetype_t::_array:
-            case cellvaluetype_t::_graph: {
-              // TODO: EvaluateExpr will allocate in the nodemem, which is freed at the end of this fn.
-              //   we'll need to copy the array contents into grid->cellmem, or
-              //   change EvaluateExpr to allocate there directly.
-              //   knowing we can allocate there directly seems a bit challenging, esp. since we'll add/change
-              //   a bunch of grid functions.
-              //   so probably best to just copy here for now, and try to eliminate it later, once the
-              //   grid function set is more stabilized.
-              //   note it's kind of annoying to copy, since we have to recurse for nested arrays.
-              CopyCellValue( &cell->value, &grid->cellmem, &value );
-            } break;
-            default: UnreachableCrash();
-          }
-        }
+  cell->input = input;
 #endif
+  auto n = GraphNodeFromCell( grid, cell, abspos );
+  SetSubexprs( grid, n, 0, 0 );
+  auto node = grid->graph_nodes.mem + n;
+  if( node->code ) {
+    MemHeapFree( node->code );
+    node->code = 0;
+  }
+  return n;
+}
 
-        // since this cell changed, loop over all superexprs which depend on this cell.
-        FORLEN( edge, m, grid->graph_edges )
-          if( edge->end == cell ) {
-            *AddBack( cells_superexpr ) = edge->start;
-          }
-        }
-      }
-
-      Free( cells_superexpr );
-      Free( cells_subexpr );
-      Free( tmpargmem );
-      Kill( nodemem );
-      Free( tokens );
+//
+// assumes input is already allocated on grid->cellmem
+//
+// TODO: should we try to remove the leading eq requirement?
+// seems like it'd be nice, since you're usually putting data in cells
+// the one concern is that we'd fail to compile regular string data, and we wouldn't know
+// whether to show the compile error or not. when you're putting in string data, you don't
+// want to see compile errors constantly. actually, presence of parens is probably all we
+// need to decide. we could do more advanced filters if we want.
+// let's proceed with no leading eq required, and see how that is.
+//
+Inl void
+InsertOrSetCellContents(
+  grid_t* grid,
+  absoluterectlist_t* rectlist,
+  slice32_t input
+  )
+{
+  // PERF: could tokenize/parse the input once here, instead of once per cell in RecalcCells.
+  stack_resizeable_cont_t<u32> seeds;
+  Alloc( seeds, 64 );
+  FORLEN( rect, i, *rectlist )
+    Fori( u32, y, rect->p0.y, rect->p1.y ) {
+    Fori( u32, x, rect->p0.x, rect->p1.x ) {
+      absolutepos_t abspos = { x, y };
+      *AddBack( seeds ) = SetCellInput( grid, abspos, input );
     }}
   }
+  RecalcCells( grid, &seeds );
+  Free( seeds );
 }
 
 Inl void
@@ -3175,6 +3932,8 @@ DeleteCellContents(
   absoluterectlist_t* rectlist
   )
 {
+  stack_resizeable_cont_t<u32> seeds;
+  Alloc( seeds, 64 );
   FORLEN( rect, i, *rectlist )
     Fori( u32, y, rect->p0.y, rect->p1.y ) {
     Fori( u32, x, rect->p0.x, rect->p1.x ) {
@@ -3184,10 +3943,23 @@ DeleteCellContents(
         // nothing to do.
         continue;
       }
-      // zero cell to delete.
+      // zero cell to delete, but stay in the graph, so we recalc the cells that read this one.
+      auto graph_node = cell->graph_node;
       *cell = {};
+      cell->graph_node = graph_node;
+      if( graph_node ) {
+        SetSubexprs( grid, graph_node - 1, 0, 0 );
+        auto node = grid->graph_nodes.mem + graph_node - 1;
+        if( node->code ) {
+          MemHeapFree( node->code );
+          node->code = 0;
+        }
+        *AddBack( seeds ) = graph_node - 1;
+      }
     }}
   }
+  RecalcCells( grid, &seeds );
+  Free( seeds );
 
   // TODO: some cleanup of all-zero cellblocks?
 }
@@ -4752,6 +5524,301 @@ __OnWindowEvent( AppOnWindowEvent )
 
 
 
+Inl void
+_SetCellFromCStr( grid_t* grid, u32 x, u32 y, const void* cstr )
+{
+  auto src = Slice32FromCStr( cstr );
+  auto input = AddPagelistSlice32( grid->cellmem, u8, 1, src.len );
+  Memmove( input.mem, ML( src ) );
+  absoluterectlist_t rectlist;
+  Alloc( rectlist, 1 );
+  auto rect = AddBack( rectlist );
+  rect->p0 = _vec2<u32>( x, y );
+  rect->p1 = rect->p0 + _vec2<u32>( 1, 1 );
+  if( input.len ) {
+    InsertOrSetCellContents( grid, &rectlist, input );
+  }
+  else {
+    DeleteCellContents( grid, &rectlist );
+  }
+  Free( rectlist );
+}
+
+Inl bool
+_CellIsNumber( grid_t* grid, u32 x, u32 y, f64 expected )
+{
+  auto cell = TryAccessCell( grid, _vec2<u32>( x, y ) );
+  AssertCrash( cell );
+  auto value = CellValue( cell );
+  return value.type == cellvaluetype_t::_f64  &&  value._f64 == expected;
+}
+
+Inl bool
+_CellIsCycle( grid_t* grid, u32 x, u32 y )
+{
+  auto cell = TryAccessCell( grid, _vec2<u32>( x, y ) );
+  AssertCrash( cell );
+  auto value = CellValue( cell );
+  return value.type == cellvaluetype_t::_string  &&
+    EqualContents( value._string, Slice32FromCStr( "ERROR_CYCLE" ) );
+}
+
+Inl bool
+_CellHasError( grid_t* grid, u32 x, u32 y )
+{
+  auto cell = TryAccessCell( grid, _vec2<u32>( x, y ) );
+  AssertCrash( cell );
+#if PACKCELL
+  return cell->error_text_len;
+#else
+  return cell->error.text.len;
+#endif
+}
+
+#if defined(_DEBUG)
+Inl void
+TestRecalc()
+{
+  grid_t grid;
+  Init( &grid );
+
+  // chain. note cell() takes 1-based coords.
+  _SetCellFromCStr( &grid, 0, 1, "cell(1,1)+1" );
+  _SetCellFromCStr( &grid, 0, 2, "cell(1,2)+1" );
+  _SetCellFromCStr( &grid, 0, 0, "1" );
+  AssertCrash( _CellIsNumber( &grid, 0, 2, 3 ) );
+  _SetCellFromCStr( &grid, 0, 0, "10" );
+  AssertCrash( _CellIsNumber( &grid, 0, 2, 12 ) );
+  _SetCellFromCStr( &grid, 0, 0, "" );
+  AssertCrash( _CellIsNumber( &grid, 0, 2, 2 ) );
+
+  // diamonds aren't cycles.
+  _SetCellFromCStr( &grid, 1, 0, "2" );
+  _SetCellFromCStr( &grid, 1, 1, "cell(2,1)*2" );
+  _SetCellFromCStr( &grid, 1, 2, "cell(2,1)*3" );
+  _SetCellFromCStr( &grid, 1, 3, "cell(2,2)+cell(2,3)+cell(2,2)" );
+  AssertCrash( _CellIsNumber( &grid, 1, 3, 14 ) );
+  _SetCellFromCStr( &grid, 1, 0, "1" );
+  AssertCrash( _CellIsNumber( &grid, 1, 3, 7 ) );
+
+  // cycles, and breaking them.
+  _SetCellFromCStr( &grid, 2, 0, "cell(3,2)" );
+  _SetCellFromCStr( &grid, 2, 1, "cell(3,1)+1" );
+  _SetCellFromCStr( &grid, 2, 2, "cell(3,2)+1" );
+  AssertCrash( _CellIsCycle( &grid, 2, 0 ) );
+  AssertCrash( _CellIsCycle( &grid, 2, 1 ) );
+  _SetCellFromCStr( &grid, 2, 0, "5" );
+  AssertCrash( _CellIsNumber( &grid, 2, 1, 6 ) );
+  AssertCrash( _CellIsNumber( &grid, 2, 2, 7 ) );
+  _SetCellFromCStr( &grid, 3, 0, "cell(4,1)" );
+  AssertCrash( _CellIsCycle( &grid, 3, 0 ) );
+  _SetCellFromCStr( &grid, 3, 0, "" );
+  AssertCrash( _CellIsNumber( &grid, 3, 0, 0 ) );
+
+  // computed references, which recalc only discovers by evaluating.
+  _SetCellFromCStr( &grid, 4, 0, "cell(5,2)" );
+  _SetCellFromCStr( &grid, 4, 1, "cell(cell(5,3),4)" );
+  _SetCellFromCStr( &grid, 4, 2, "6" );
+  _SetCellFromCStr( &grid, 5, 3, "8" );
+  AssertCrash( _CellIsNumber( &grid, 4, 0, 8 ) );
+  _SetCellFromCStr( &grid, 4, 2, "7" );
+  AssertCrash( _CellIsNumber( &grid, 4, 0, 0 ) );
+  _SetCellFromCStr( &grid, 6, 3, "9" );
+  AssertCrash( _CellIsNumber( &grid, 4, 0, 9 ) );
+
+  // ranges that span several cellblocks, some of which don't exist.
+  Fori( u32, y, 0, 40 ) {
+    u8 tmp[16];
+    idx_t len = 0;
+    CsFrom_u64( tmp, _countof( tmp ) - 1, &len, y + 1 );
+    tmp[len] = 0;
+    _SetCellFromCStr( &grid, 20, y, tmp );
+  }
+  _SetCellFromCStr( &grid, 21, 0, "col(21,1,70)" );
+  _SetCellFromCStr( &grid, 22, 0, "rowrect(21,2,23,72)" );
+  _SetCellFromCStr( &grid, 23, 0, "sum(col(21,1,70))" );
+  _SetCellFromCStr( &grid, 24, 0, "min(col(21,20,3))" );
+  _SetCellFromCStr( &grid, 25, 0, "max(col(21,1,70))" );
+  _SetCellFromCStr( &grid, 26, 0, "sum(col(22,1,3))" );
+  For( pass, 0, 2 ) {
+    AssertCrash( _CellIsNumber( &grid, 23, 0, 820 * ( pass + 1 ) ) );
+    AssertCrash( _CellIsNumber( &grid, 24, 0, 3 * ( pass + 1 ) ) );
+    AssertCrash( _CellIsNumber( &grid, 25, 0, 40 * ( pass + 1 ) ) );
+    AssertCrash( _CellHasError( &grid, 26, 0 ) );
+    auto value = CellValue( TryAccessCell( &grid, _vec2<u32>( 21, 0 ) ) );
+    AssertCrash( value.type == cellvaluetype_t::_array  &&  value._array.len == 69 );
+    Fori( u32, y, 0, 69 ) {
+      auto expected = ( y < 40 ) ? ( y + 1 ) * ( pass + 1 ) : 0;
+      AssertCrash( value._array.mem[y].type == cellvaluetype_t::_f64 );
+      AssertCrash( value._array.mem[y]._f64 == expected );
+    }
+    value = CellValue( TryAccessCell( &grid, _vec2<u32>( 22, 0 ) ) );
+    AssertCrash( value.type == cellvaluetype_t::_array  &&  value._array.len == 70 );
+    Fori( u32, y, 0, 70 ) {
+      auto row = value._array.mem[y];
+      AssertCrash( row.type == cellvaluetype_t::_array  &&  row._array.len == 2 );
+      AssertCrash( row._array.mem[0]._f64 == ( ( y + 1 < 40 ) ? ( y + 2 ) * ( pass + 1 ) : 0 ) );
+    }
+    // editing a cell inside the ranges recalcs both.
+    Fori( u32, y, 0, 40 ) {
+      u8 tmp[16];
+      idx_t len = 0;
+      CsFrom_u64( tmp, _countof( tmp ) - 1, &len, 2 * ( y + 1 ) );
+      tmp[len] = 0;
+      _SetCellFromCStr( &grid, 20, y, tmp );
+    }
+  }
+
+  // row aggregates, over runs that start and end mid-cellblock, with missing cells counting as 0.
+  Fori( u32, x, 0, 50 ) {
+    u8 tmp[16];
+    idx_t len = 0;
+    CsFrom_u64( tmp, _countof( tmp ) - 1, &len, x + 1 );
+    tmp[len] = 0;
+    _SetCellFromCStr( &grid, 30 + x, 50, tmp );
+  }
+  _SetCellFromCStr( &grid, 30, 51, "sum(row(51,31,81))" );
+  _SetCellFromCStr( &grid, 31, 51, "min(row(51,31,81))" );
+  _SetCellFromCStr( &grid, 32, 51, "max(row(51,1,200))" );
+  _SetCellFromCStr( &grid, 33, 51, "min(row(51,1,200))" );
+  _SetCellFromCStr( &grid, 34, 51, "sum(row(51,33,33))" );
+  _SetCellFromCStr( &grid, 35, 51, "max(row(51,33,33))" );
+  AssertCrash( _CellIsNumber( &grid, 30, 51, 1275 ) );
+  AssertCrash( _CellIsNumber( &grid, 31, 51, 1 ) );
+  AssertCrash( _CellIsNumber( &grid, 32, 51, 50 ) );
+  AssertCrash( _CellIsNumber( &grid, 33, 51, 0 ) );
+  AssertCrash( _CellIsNumber( &grid, 34, 51, 0 ) );
+  AssertCrash( _CellHasError( &grid, 35, 51 ) );
+  _SetCellFromCStr( &grid, 40, 50, "-5" );
+  AssertCrash( _CellIsNumber( &grid, 30, 51, 1275 - 11 - 5 ) );
+  AssertCrash( _CellIsNumber( &grid, 31, 51, -5 ) );
+  AssertCrash( _CellIsNumber( &grid, 33, 51, -5 ) );
+
+  Kill( &grid );
+
+  // forward references, set all at once like LoadCSV does.
+  // wide enough to evaluate levels on the taskthreads.
+  Init( &grid );
+  constant u32 c_ncols = 1000;
+  stack_resizeable_cont_t<u32> seeds;
+  Alloc( seeds, 4 * c_ncols );
+  Fori( u32, y, 0, 4 ) {
+    Fori( u32, x, 0, c_ncols ) {
+      auto input = ( y == 3 ) ? Slice32FromCStr( "2" ) : Slice32FromCStr( "relcell(0,1)*2" );
+      *AddBack( seeds ) = SetCellInput( &grid, _vec2<u32>( x, y ), input );
+    }
+  }
+  RecalcCells( &grid, &seeds );
+  Fori( u32, x, 0, c_ncols ) {
+    AssertCrash( _CellIsNumber( &grid, x, 0, 16 ) );
+  }
+  Free( seeds );
+  Kill( &grid );
+}
+#endif
+
+// a 1M-cell sheet of relcell chains, at a few aspect ratios.
+// wide sheets have a few long levels, and tall sheets have many short levels, which we evaluate serially.
+// reports the load and full-recalc times, and the time to recalc after editing one chain's head.
+void
+BenchGridRecalc()
+{
+  constant u32 c_ncells = 1000*1000;
+  u32 widths[] = { 1, 10, 1000 };
+  printf( "%10s  %10s  %10s  %12s  %12s\n", "width", "height", "load ms", "recalc ms", "edit head ms" );
+  ForEach( width, widths ) {
+    auto height = c_ncells / width;
+    grid_t grid;
+    Init( &grid );
+
+    auto head = Slice32FromCStr( "1" );
+    auto chain = Slice32FromCStr( "relcell(0,-1)+1" );
+    stack_resizeable_cont_t<u32> seeds;
+    Alloc( seeds, c_ncells );
+    auto t0 = TimeTSC();
+    Fori( u32, y, 0, height ) {
+      Fori( u32, x, 0, width ) {
+        *AddBack( seeds ) = SetCellInput( &grid, _vec2<u32>( x, y ), y ? chain : head );
+      }
+    }
+    RecalcCells( &grid, &seeds );
+    auto t1 = TimeTSC();
+    AssertCrash( _CellIsNumber( &grid, width - 1, height - 1, height ) );
+
+    // edit every head.
+    absoluterectlist_t rectlist;
+    Alloc( rectlist, 1 );
+    auto rect = AddBack( rectlist );
+    rect->p0 = _vec2<u32>( 0, 0 );
+    rect->p1 = _vec2<u32>( width, 1 );
+    InsertOrSetCellContents( &grid, &rectlist, Slice32FromCStr( "2" ) );
+    auto t2 = TimeTSC();
+    AssertCrash( _CellIsNumber( &grid, width - 1, height - 1, height + 1 ) );
+
+    rect->p1 = _vec2<u32>( 1, 1 );
+    InsertOrSetCellContents( &grid, &rectlist, Slice32FromCStr( "3" ) );
+    auto t3 = TimeTSC();
+    AssertCrash( _CellIsNumber( &grid, 0, height - 1, height + 2 ) );
+    Free( rectlist );
+
+    printf(
+      "%10u  %10u  %10.1f  %12.1f  %12.3f\n",
+      width,
+      height,
+      1e3 * TimeSecFromTSC64( t1 - t0 ),
+      1e3 * TimeSecFromTSC64( t2 - t1 ),
+      1e3 * TimeSecFromTSC64( t3 - t2 )
+      );
+    Free( seeds );
+    Kill( &grid );
+  }
+}
+
+// sum/min/max over a 1M-cell col, which take the fused aggregate path.
+// reports the load time, and the time to recalc all three after editing one cell in the col.
+void
+BenchGridAggregate()
+{
+  constant u32 c_ncells = 1000*1000;
+  grid_t grid;
+  Init( &grid );
+
+  stack_resizeable_cont_t<u32> seeds;
+  Alloc( seeds, c_ncells + 3 );
+  auto t0 = TimeTSC();
+  Fori( u32, y, 0, c_ncells ) {
+    *AddBack( seeds ) = SetCellInput( &grid, _vec2<u32>( 0, y ), Slice32FromCStr( "1" ) );
+  }
+  *AddBack( seeds ) = SetCellInput( &grid, _vec2<u32>( 1, 0 ), Slice32FromCStr( "sum(col(1,1,1000001))" ) );
+  *AddBack( seeds ) = SetCellInput( &grid, _vec2<u32>( 2, 0 ), Slice32FromCStr( "min(col(1,1,1000001))" ) );
+  *AddBack( seeds ) = SetCellInput( &grid, _vec2<u32>( 3, 0 ), Slice32FromCStr( "max(col(1,1,1000001))" ) );
+  RecalcCells( &grid, &seeds );
+  auto t1 = TimeTSC();
+  AssertCrash( _CellIsNumber( &grid, 1, 0, c_ncells ) );
+
+  absoluterectlist_t rectlist;
+  Alloc( rectlist, 1 );
+  auto rect = AddBack( rectlist );
+  rect->p0 = _vec2<u32>( 0, 0 );
+  rect->p1 = _vec2<u32>( 1, 1 );
+  InsertOrSetCellContents( &grid, &rectlist, Slice32FromCStr( "-2" ) );
+  auto t2 = TimeTSC();
+  AssertCrash( _CellIsNumber( &grid, 1, 0, c_ncells - 3 ) );
+  AssertCrash( _CellIsNumber( &grid, 2, 0, -2 ) );
+  AssertCrash( _CellIsNumber( &grid, 3, 0, 1 ) );
+  Free( rectlist );
+
+  printf( "%10s  %10s  %12s\n", "cells", "load ms", "edit ms" );
+  printf(
+    "%10u  %10.1f  %12.1f\n",
+    c_ncells,
+    1e3 * TimeSecFromTSC64( t1 - t0 ),
+    1e3 * TimeSecFromTSC64( t2 - t1 )
+    );
+  Free( seeds );
+  Kill( &grid );
+}
+
 #if defined(_DEBUG)
   struct
   testcase_t
@@ -4770,6 +5837,14 @@ Main( stack_resizeable_cont_t<slice_t>& args )
   auto app = &g_app;
   AppInit( app );
 
+  if( args.len == 1  &&  EqualContents( args.mem[0], SliceFromCStr( "bench" ) ) ) {
+    BenchGridRecalc();
+    BenchGridAggregate();
+    SignalQuitAndWaitForTaskThreads();
+    AppKill( app );
+    return 0;
+  }
+
   if( args.len == 1 ) {
     auto arg = args.mem + 0;
     filemapped_t file = FileOpenMappedExistingReadShareRead( ML( *arg ) );
@@ -4880,6 +5955,8 @@ Main( stack_resizeable_cont_t<slice_t>& args )
     Free( tmp );
     Kill( scratchmem );
     Free( tokens );
+
+    TestRecalc();
 #endif
 
   LoadFont(
@@ -5095,11 +6172,6 @@ WinMain( HINSTANCE prog_inst, HINSTANCE prog_inst_prev, LPSTR prog_cmd_line, int
   hold down shift, then arrow_d, arrow_u.
     we keep the second cell selected when we shouldn't.
 
-  we inc grid->eval_generation for every cell in a rectlist in InsertOrSetCellContents.
-    shouldn't we do it once at the start, set the cell inputs, and then evaluate all at once?
-
-  we have callers of InsertOrSetCellContents that call it in a loop, which is bad.
-
   arrow_d or page_d off the screen, both horz+vert should cause scrolling.
 
   alt+mousedrag after a press over the selection should move the selected cells.
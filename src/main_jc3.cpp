@@ -40,6 +40,7 @@
 #include "ds_mtqueue_srmw_nonresizeable.h"
 #include "ds_mtqueue_srsw_nonresizeable.h"
 #include "thread_atomics.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
 #include "threading.h"
 #define LOGGER_ENABLED   0
 #include "logger.h"
@@ -521,6 +522,7 @@ token_t
   // so during parsing the indent levels are { 0, 1, ... }
   size_t indent;
   size_t inum;
+  size_t isym; // ident tokens only; see interner_t.
 };
 
 Inl void
@@ -558,6 +560,135 @@ PrintTokens(
   }
 }
 
+// identifier interning. Tokenize gives every ident token a dense isym, so later passes can compare identifiers,
+//   and index tables by them, without touching the text again.
+// open addressing with linear probing, over a power of 2 table of 1 + isym, with 0 meaning empty.
+struct
+interner_t
+{
+  vector<string_view> texts; // by isym.
+  vector<u64> hashes; // by isym, so growing doesn't rehash the texts.
+  vector<u32> slots;
+};
+
+Inl u64
+_InternerHash( string_view text )
+{
+  // StringHash leaves the low bits weak, and we mask to index, so mix them back up.
+  return Cast( u64, StringHash( Cast( void*, text.data() ), text.length() ) ) * 0x9E3779B97F4A7C15ULL;
+}
+
+Inl void
+_InternerGrow( interner_t& interner )
+{
+  auto& slots = interner.slots;
+  const size_t nslots = slots.empty()  ?  1024  :  2 * slots.size();
+  slots.assign( nslots, 0 );
+  const auto mask = nslots - 1;
+  const auto nsyms = interner.texts.size();
+  for( size_t isym = 0;  isym < nsyms;  ++isym ) {
+    auto i = interner.hashes[isym] >> 32;
+    while( slots[ i & mask ] ) ++i;
+    slots[ i & mask ] = Cast( u32, isym + 1 );
+  }
+}
+
+Inl u32
+Intern( interner_t& interner, string_view text )
+{
+  // keep the load factor under 1/2.
+  if( 2 * ( interner.texts.size() + 1 ) > interner.slots.size() ) {
+    _InternerGrow( interner );
+  }
+  auto& slots = interner.slots;
+  const auto mask = slots.size() - 1;
+  const auto hash = _InternerHash( text );
+  for( auto i = hash >> 32;  ;  ++i ) {
+    const auto slot = slots[ i & mask ];
+    if( !slot ) {
+      const auto isym = Cast( u32, interner.texts.size() );
+      interner.texts.emplace_back( text );
+      interner.hashes.emplace_back( hash );
+      slots[ i & mask ] = isym + 1;
+      return isym;
+    }
+    const auto isym = slot - 1;
+    if( interner.hashes[isym] == hash  and  interner.texts[isym] == text ) {
+      return isym;
+    }
+  }
+}
+
+// maps isyms to values, with shadowing. the type checker keeps one of these for vars, and one for each global
+//   namespace.
+// isyms are dense, so instead of hashing them we index a flat array of chain heads by isym directly.
+// every binding links to the binding it shadows; leaving a scope pops bindings back to a mark, which re-exposes
+//   whatever they shadowed.
+struct symbinding_t { u32 isym;  u32 shadowed;  void* value; };
+struct
+symtable_t
+{
+  stack_resizeable_cont_t<u32> heads; // by isym, 1 + idx into bindings, or 0 if unbound.
+  stack_resizeable_cont_t<symbinding_t> bindings;
+};
+
+Inl void
+Init( symtable_t& table )
+{
+  Alloc( table.heads, 1024 );
+  Alloc( table.bindings, 1024 );
+}
+
+Inl void
+Kill( symtable_t& table )
+{
+  Free( table.bindings );
+  Free( table.heads );
+}
+
+Inl void
+BindSym( symtable_t& table, u32 isym, void* value )
+{
+  auto& heads = table.heads;
+  if( isym >= heads.len ) {
+    auto len = heads.len;
+    Reserve( heads, isym + 1 );
+    TZero( heads.mem + len, isym + 1 - len );
+    heads.len = isym + 1;
+  }
+  auto binding = AddBack( table.bindings );
+  binding->isym = isym;
+  binding->shadowed = heads.mem[isym];
+  binding->value = value;
+  heads.mem[isym] = Cast( u32, table.bindings.len );
+}
+
+Inl void*
+LookupSym( symtable_t& table, u32 isym )
+{
+  if( isym >= table.heads.len  ||  !table.heads.mem[isym] ) {
+    return 0;
+  }
+  return table.bindings.mem[ table.heads.mem[isym] - 1 ].value;
+}
+
+Inl idx_t
+MarkSyms( symtable_t& table )
+{
+  return table.bindings.len;
+}
+
+Inl void
+PopSyms( symtable_t& table, idx_t mark )
+{
+  AssertCrash( mark <= table.bindings.len );
+  while( table.bindings.len > mark ) {
+    auto binding = table.bindings.mem + table.bindings.len - 1;
+    table.heads.mem[ binding->isym ] = binding->shadowed;
+    table.bindings.len -= 1;
+  }
+}
+
 struct
 compilefile_t
 {
@@ -568,6 +699,9 @@ compilefile_t
 
   string nums_digits;
   vector<numliteral_t> nums;
+
+  interner_t syms;
+  symtable_t varsyms; // locals and args in scope, while typing a function.
 };
 
 Inl void
@@ -647,7 +781,7 @@ struct function_t;
 ForceInl bool
 Prefixed(string_view larger, string_view prefix) {
   if (larger.length() < prefix.length()) return false;
-  return memcmp(larger.data(), prefix.data(), prefix.length());
+  return !memcmp(larger.data(), prefix.data(), prefix.length());
 }
 #define isalphalower(c) ('a' <= (c) and (c) <= 'z')
 #define isalphaupper(c) ('A' <= (c) and (c) <= 'Z')
@@ -796,7 +930,8 @@ Tokenize(compilefile_t& file, string_view in) {
 			auto j = ich + 1;
 			while (j < cch and isvarchar(rgch[j])) ++j;
 			// [ich,j) is the variable name.
-			tokens.emplace_back(tokentype_t::ident, string_view(&rgch[ich], j - ich), bol, sbol, lineno, indent, 0);
+			const auto text = string_view(&rgch[ich], j - ich);
+			tokens.emplace_back(tokentype_t::ident, text, bol, sbol, lineno, indent, 0, Intern(file.syms, text));
 			ich = j;
 			continue;
 		}
@@ -854,16 +989,17 @@ Tokenize(compilefile_t& file, string_view in) {
 	}
 
   // optimal ordered re-contiguoize.
-  const auto cr = removes.size();
+  // note an unterminated '//' comment truncates tokens, so the last keep ends at the current size, not ct.
   vector<tokenspan_t> keeps;
-  if (cr > 0 and removes[0].l > 0) {
-    keeps.emplace_back(0, removes[0].l);
-  }
-  for (size_t i = 1; i < cr; ++i) {
-    keeps.emplace_back(removes[i-1].r, removes[i].l);
+  size_t kept = 0;
+  for (const auto& remove : removes) {
+    if (kept < remove.l) {
+      keeps.emplace_back(kept, remove.l);
+    }
+    kept = remove.r;
   }
-  if (cr > 0 and removes.back().r != ct) {
-    keeps.emplace_back(removes.back().r, ct);
+  if (kept < tokens.size()) {
+    keeps.emplace_back(kept, tokens.size());
   }
 
   {
@@ -871,7 +1007,7 @@ Tokenize(compilefile_t& file, string_view in) {
     auto data = tokens.data();
     for (const auto& keep : keeps) {
       const size_t cKeep = keep.r - keep.l;
-      Memmove(
+      TMove(
         data + i,
         data + keep.l,
         cKeep
@@ -1075,7 +1211,7 @@ struct str_t { token_t* literal; };
 
 struct chr_t { token_t* literal; };
 
-struct ident_t { slice_t text;  token_t* literal; };
+struct ident_t { slice_t text;  token_t* literal;  u32 isym; };
 
 Enumc( typedecl_arrayidx_type_t ) { expr_const, star };
 struct typedecl_arrayidx_t { typedecl_arrayidx_type_t type;  expr_t* expr_const; };
@@ -1979,15 +2115,18 @@ MakeIdent(
   ident->literal = tkn;
   ident->text.mem = tkn->mem;
   ident->text.len = tkn->len;
+  ident->isym = Cast( u32, tkn->isym );
 }
 Inl void
 MakePseudoIdent(
+  compilefile_t* ctx,
   slice_t text,
   ident_t* ident
   )
 {
   ident->literal = 0;
   ident->text = text;
+  ident->isym = Intern( ctx->syms, string_view( Cast( const char*, text.mem ), text.len ) );
 }
 Inl void
 ParseIdent(
@@ -2755,6 +2894,11 @@ globaltypes_t
   list_t<namedvar_t> constants;
   list_t<function_t> functions;
 
+  // the same decltypes as above, by isym.
+  symtable_t fndecltype_syms;
+  symtable_t structdecltype_syms;
+  symtable_t enumdecltype_syms;
+
   type_t type_bool;
   type_t type_string; // TODO: delete this, in favor of '[N] u8' when we know N, and '[] u8' otherwise.
   type_t type_enum; // TODO: probably structure this differently when we allow arbitrary enum types.
@@ -3295,10 +3439,7 @@ IdentsMatch(
   ident_t* b
   )
 {
-  if( a == b ) return 1;
-  if( a->literal == b->literal ) return 1;
-  auto r = MemEqual( ML( a->text ), ML( b->text ) );
-  return r;
+  return a->isym == b->isym;
 }
 Inl bool
 TypesEqual(
@@ -3638,6 +3779,17 @@ FindEntryByIdent(
   *found_elem = 0;
 }
 Templ Inl void
+FindEntryByIdent(
+  symtable_t* table,
+  ident_t* ident,
+  bool* found,
+  T** found_elem
+  )
+{
+  *found_elem = Cast( T*, LookupSym( *table, ident->isym ) );
+  *found = !!*found_elem;
+}
+Templ Inl void
 FindEntryByIdent(
   tslice_t<T>* list,
   ident_t* ident,
@@ -3687,7 +3839,7 @@ TypeFncall(
   auto function = ctx->current_function;
   bool already_there = 0;
   fndecltype_t* fndecltype = 0;
-  FindEntryByIdent( &globaltypes->fndecltypes, &fncall->ident, &already_there, &fndecltype );
+  FindEntryByIdent( &globaltypes->fndecltype_syms, &fncall->ident, &already_there, &fndecltype );
   if( !already_there ) {
     Error( ctx, fncall->ident.literal, "calling an undeclared function!" );
     return;
@@ -3749,24 +3901,14 @@ LookupVar(
   )
 {
   auto globaltypes = ctx->globaltypes;
-  auto function = ctx->current_function;
-  // check the local scopes for regular vars
-  namedvar_t* namedvar = 0;
-  REVERSEFORLEN( vartable, i, ctx->scopestack )
-    FindEntryByIdent( &(*vartable)->namedvars, ident, found, &namedvar );
-    if( *found ) {
-      *var = namedvar->var;
-      return;
-    }
-  }
-  // check the function for arg vars
-  idx_t offset_into_list = 0;
-  FindEntryByIdent( &function->namedvar_args, ident, found, &namedvar, &offset_into_list );
-  if( *found ) {
-    *var = namedvar->var;
+  // check the local scopes and the function args, innermost first.
+  *var = Cast( var_t*, LookupSym( ctx->varsyms, ident->isym ) );
+  if( *var ) {
+    *found = 1;
     return;
   }
   // check the global scope for constants
+  namedvar_t* namedvar = 0;
   FindEntryByIdent( &globaltypes->constants, ident, found, &namedvar );
   if( *found ) {
     *var = namedvar->var;
@@ -3996,7 +4138,7 @@ TypeExprAssignable(
     LookupVar( ctx, &entry->ident, &found, &var_entry );
     if( !found ) {
       enumdecltype_t* enumdecltype = 0;
-      FindEntryByIdent( &globaltypes->enumdecltypes, &entry->ident, &found, &enumdecltype );
+      FindEntryByIdent( &globaltypes->enumdecltype_syms, &entry->ident, &found, &enumdecltype );
       if( !found ) {
         Error( ctx, entry->ident.literal, "using undefined type!" );
         return;
@@ -4203,7 +4345,7 @@ TypeExprAssignable(
     LookupVar( ctx, &entry->ident, &found, &var_entry );
     if( !found ) {
       enumdecltype_t* enumdecltype = 0;
-      FindEntryByIdent( &globaltypes->enumdecltypes, &entry->ident, &found, &enumdecltype );
+      FindEntryByIdent( &globaltypes->enumdecltype_syms, &entry->ident, &found, &enumdecltype );
       if( !found ) {
         Error( ctx, entry->ident.literal, "using undefined type!" );
         return;
@@ -4897,14 +5039,14 @@ TypeFromTypedecl(
   }
   bool found = 0;
   enumdecltype_t* enumdecltype = 0;
-  FindEntryByIdent( &globaltypes->enumdecltypes, &typedecl->ident, &found, &enumdecltype );
+  FindEntryByIdent( &globaltypes->enumdecltype_syms, &typedecl->ident, &found, &enumdecltype );
   if( found ) {
     type->type = type_type_t::enum_;
     type->enumdecltype = enumdecltype;
     return;
   }
   structdecltype_t* structdecltype = 0;
-  FindEntryByIdent( &globaltypes->structdecltypes, &typedecl->ident, &found, &structdecltype );
+  FindEntryByIdent( &globaltypes->structdecltype_syms, &typedecl->ident, &found, &structdecltype );
   if( found ) {
     type->type = type_type_t::struct_;
     type->structdecltype = structdecltype;
@@ -4958,14 +5100,14 @@ LookForDeclConflicts(
     return;
   }
   enumdecltype_t* enumdecltype = 0;
-  FindEntryByIdent( &globaltypes->enumdecltypes, ident, &found, &enumdecltype );
+  FindEntryByIdent( &globaltypes->enumdecltype_syms, ident, &found, &enumdecltype );
   if( found ) {
     // TODO better messaging, print location of shadow.
     Error( ctx, ident->literal, "enum already exists with that name!" );
     return;
   }
   structdecltype_t* structdecltype = 0;
-  FindEntryByIdent( &globaltypes->structdecltypes, ident, &found, &structdecltype );
+  FindEntryByIdent( &globaltypes->structdecltype_syms, ident, &found, &structdecltype );
   if( found ) {
     // TODO better messaging, print location of shadow.
     Error( ctx, ident->literal, "struct already exists with that name!" );
@@ -5058,6 +5200,7 @@ TypeStatement(
       auto namedvar = AddBackList( ctx, &vartable->namedvars );
       namedvar->ident = decl->ident;
       namedvar->var = var;
+      BindSym( ctx->varsyms, decl->ident.isym, var );
     } break;
     case statement_type_t::declassign: {
       auto declassign = &statement->declassign;
@@ -5088,6 +5231,7 @@ TypeStatement(
       auto namedvar = AddBackList( ctx, &vartable->namedvars );
       namedvar->ident = declassign->ident;
       namedvar->var = var;
+      BindSym( ctx->varsyms, declassign->ident.isym, var );
     } break;
     case statement_type_t::binassign: {
       auto binassign = &statement->binassign;
@@ -5696,6 +5840,7 @@ TypeScope(
 {
   auto function = ctx->current_function;
   bool in_whileloop = ( tc_jumplabel_whileloop_begin );
+  auto mark = MarkSyms( ctx->varsyms );
   if( !ctx->scopestack.len ) {
     *AddBack( ctx->scopestack ) = &function->vartable;
   }
@@ -5729,6 +5874,7 @@ TypeScope(
     tc->type = tc_type_t::jump;
     tc->jump.jumplabel = tc_jumplabel_whileloop_begin;
   }
+  PopSyms( ctx->varsyms, mark );
   RemBack( ctx->scopestack );
 }
 
@@ -5742,10 +5888,11 @@ AddFndecltype(
   auto globaltypes = ctx->globaltypes;
   bool already_there = 0;
   fndecltype_t* fndecltype = 0;
-  FindEntryByIdent( &globaltypes->fndecltypes, &fndecl->ident, &already_there, &fndecltype );
+  FindEntryByIdent( &globaltypes->fndecltype_syms, &fndecl->ident, &already_there, &fndecltype );
   if( !already_there ) {
     fndecltype = AddBackList( ctx, &globaltypes->fndecltypes );
     fndecltype->ident = fndecl->ident;
+    BindSym( globaltypes->fndecltype_syms, fndecltype->ident.isym, fndecltype );
     fndecltype->args = AddPagelistSlice( ctx->mem, namedtype_t, _SIZEOF_IDX_T, fndecl->decl_args.len );
     ZeroContents( fndecltype->args );
     idx_t idx = 0;
@@ -5812,7 +5959,7 @@ TypeGlobalScope(
     auto enumdecl = &global_statement->enumdecl;
     bool already_there = 0;
     enumdecltype_t* enumdecltype = 0;
-    FindEntryByIdent( &globaltypes->enumdecltypes, &enumdecl->ident, &already_there, &enumdecltype );
+    FindEntryByIdent( &globaltypes->enumdecltype_syms, &enumdecl->ident, &already_there, &enumdecltype );
     if( already_there ) {
       // TODO: display both enum locations
       Error( ctx, enumdecl->ident.literal, "there's already an enum using this name!" );
@@ -5826,6 +5973,7 @@ TypeGlobalScope(
       END_FORLISTALLPAIRS
       enumdecltype = AddBackList( ctx, &globaltypes->enumdecltypes );
       enumdecltype->ident = enumdecl->ident;
+      BindSym( globaltypes->enumdecltype_syms, enumdecltype->ident.isym, enumdecltype );
       enumdecltype->type = globaltypes->type_u32;
       enumdecltype->values = AddPagelistSlice( ctx->mem, enumdecltype_value_t, _SIZEOF_IDX_T, enumdecl->enumdecl_entries.len );
       ZeroContents( enumdecltype->values );
@@ -5864,7 +6012,7 @@ TypeGlobalScope(
     END_FORLISTALLPAIRS
     bool already_there = 0;
     structdecltype_t* structdecltype = 0;
-    FindEntryByIdent( &globaltypes->structdecltypes, &structdecl->ident, &already_there, &structdecltype );
+    FindEntryByIdent( &globaltypes->structdecltype_syms, &structdecl->ident, &already_there, &structdecltype );
     if( already_there ) {
       // TODO: display both struct locations
       Error( ctx, structdecl->ident.literal, "there's already a struct using this name!" );
@@ -5872,6 +6020,7 @@ TypeGlobalScope(
     else {
       structdecltype = AddBackList( ctx, &globaltypes->structdecltypes );
       structdecltype->ident = structdecl->ident;
+      BindSym( globaltypes->structdecltype_syms, structdecltype->ident.isym, structdecltype );
       // leave structdecltype->fields blank for now, we'll fill it in later, once all structdecltypes are added.
     }
   }
@@ -5891,7 +6040,7 @@ TypeGlobalScope(
         auto structdecl = &global_statement->structdecl;
         bool already_there = 0;
         structdecltype_t* structdecltype = 0;
-        FindEntryByIdent( &globaltypes->structdecltypes, &structdecl->ident, &already_there, &structdecltype );
+        FindEntryByIdent( &globaltypes->structdecltype_syms, &structdecl->ident, &already_there, &structdecltype );
         AssertCrash( already_there );
         // now we fill in structdecltype->fields, now that all structdecltypes have been added, and can resolve to type_t.
         structdecltype->fields = AddPagelistSlice( ctx->mem, namedtype_t, _SIZEOF_IDX_T, structdecl->decl_fields.len );
@@ -5965,7 +6114,7 @@ TypeGlobalScope(
     function->fndefn = fndefn;
     bool found = 0;
     fndecltype_t* fndecltype = 0;
-    FindEntryByIdent( &globaltypes->fndecltypes, &fndefn->fndecl->ident, &found, &fndecltype );
+    FindEntryByIdent( &globaltypes->fndecltype_syms, &fndefn->fndecl->ident, &found, &fndecltype );
     AssertCrash( found ); // handled by the fndecl processing above.
     function->fndecltype = fndecltype;
     // allocate stack space for args.
@@ -6008,6 +6157,10 @@ TypeGlobalScope(
     function->vartable.scope = fndefn->scope;
 #endif
     ctx->current_function = function;
+    auto mark = MarkSyms( ctx->varsyms );
+    FORLEN( namedvar_arg, i, function->namedvar_args )
+      BindSym( ctx->varsyms, namedvar_arg->ident.isym, namedvar_arg->var );
+    }
     TypeScope(
       ctx,
       &function->tcode,
@@ -6015,6 +6168,7 @@ TypeGlobalScope(
       0,
       0
       ); // intentionally no IER
+    PopSyms( ctx->varsyms, mark );
     ctx->current_function = 0;
     // make sure all functions end with a ret.
     auto last_tcode_was_ret = function->tcode.len  &&  function->tcode.last->value.type == tc_type_t::ret;
@@ -6510,10 +6664,10 @@ Generate(
 {
   auto globaltypes = ctx->globaltypes;
   ident_t ident_main;
-  MakePseudoIdent( c_sym_main, &ident_main );
+  MakePseudoIdent( ctx, c_sym_main, &ident_main );
   bool found = 0;
   fndecltype_t* fndecltype_main = 0;
-  FindEntryByIdent( &globaltypes->fndecltypes, &ident_main, &found, &fndecltype_main );
+  FindEntryByIdent( &globaltypes->fndecltype_syms, &ident_main, &found, &fndecltype_main );
   if( !found ) {
     AddBackString( &ctx->errors, "no entry point found! define a 'Main()' function.\n" );
     return;
@@ -7091,7 +7245,7 @@ Execute( tslice_t<bc_t> code, idx_t entry_point )
         auto value_s16 = Cast( s16*, value_u8 );
         auto value_s32 = Cast( s32*, value_u8 );
         auto value_s64 = Cast( s64*, value_u8 );
-        u8*  dst_u8 = frame.mem + c->unop.var.offset_into_scope;
+        u8*  dst_u8 = frame.mem + c->unop.var_result.offset_into_scope;
         auto dst_u16 = Cast( u16*, dst_u8 );
         auto dst_u32 = Cast( u32*, dst_u8 );
         auto dst_u64 = Cast( u64*, dst_u8 );
@@ -7113,17 +7267,17 @@ Execute( tslice_t<bc_t> code, idx_t entry_point )
           case bc_unop_type_t::negatefloat_32: { *dst_u32 = *value_u32 ^ ( 1u   << 31 ); } break;
           case bc_unop_type_t::negatefloat_64: { *dst_u64 = *value_u64 ^ ( 1ull << 63 ); } break;
           case bc_unop_type_t::extendzero_8_16:  { *dst_u16 = *value_u8 ; } break;
-          case bc_unop_type_t::extendzero_8_32:  { *dst_u32 = *value_u16; } break;
+          case bc_unop_type_t::extendzero_8_32:  { *dst_u32 = *value_u8 ; } break;
           case bc_unop_type_t::extendzero_8_64:  { *dst_u64 = *value_u8 ; } break;
           case bc_unop_type_t::extendzero_16_32: { *dst_u32 = *value_u16; } break;
-          case bc_unop_type_t::extendzero_16_64: { *dst_u64 = *value_u32; } break;
-          case bc_unop_type_t::extendzero_32_64: { *dst_u64 = *value_u64; } break;
+          case bc_unop_type_t::extendzero_16_64: { *dst_u64 = *value_u16; } break;
+          case bc_unop_type_t::extendzero_32_64: { *dst_u64 = *value_u32; } break;
           case bc_unop_type_t::extendsign_8_16:  { *dst_s16 = *value_s8 ; } break;
-          case bc_unop_type_t::extendsign_8_32:  { *dst_s32 = *value_s16; } break;
+          case bc_unop_type_t::extendsign_8_32:  { *dst_s32 = *value_s8 ; } break;
           case bc_unop_type_t::extendsign_8_64:  { *dst_s64 = *value_s8 ; } break;
           case bc_unop_type_t::extendsign_16_32: { *dst_s32 = *value_s16; } break;
-          case bc_unop_type_t::extendsign_16_64: { *dst_s64 = *value_s32; } break;
-          case bc_unop_type_t::extendsign_32_64: { *dst_s64 = *value_s64; } break;
+          case bc_unop_type_t::extendsign_16_64: { *dst_s64 = *value_s16; } break;
+          case bc_unop_type_t::extendsign_32_64: { *dst_s64 = *value_s32; } break;
           default: UnreachableCrash();
         }
       } break;
@@ -7300,164 +7454,4175 @@ Execute( tslice_t<bc_t> code, idx_t entry_point )
 
 
 
-// TODO: how do we store fncall, since we need to know the dest code location, possibly before generating it?
-// in x86 asm i think you just use the fn name, but i'm not sure about in the executable.
-// presumably you have to resolve to a location, unless the OS loader does that for you.
-// i'll start with unresolved for now, and we can always do a post-pass to replace fncalls.
+// second-stage lowering of bc_t, into a compact type-specialized instruction stream for ExecuteVm.
+//
+// every vminstr_t is 16 bytes, and operands are fixed frame offsets, so there's none of the per-instruction
+//   bytecount handling or variable-length Memmove that Execute has.
+// fncalls lower to plain moves of the args straight into the callee frame, followed by a call. every function's
+//   frame length is static, so the callee frame base is baked into each call too.
+// we fuse common sequences into superinstructions, when the temporaries in between aren't read anywhere else in
+//   the function, and nothing jumps into the middle:
+//   loadconstant t; binop d <- x, t;                => binopimm d <- x, imm
+//   binop c <- x, y; jumpzero c;                    => jz x, y
+//   loadconstant t; binop c <- x, t; jumpzero c;    => jzimm x, imm
+//   and likewise for jumpnotzero.
+// dispatch is computed goto where the compiler has it, and a switch otherwise.
+
+// name, result type, operand type, expression of l and r.
+// these have to match the binop cases in Execute exactly, including the widths of the results.
+#define VM_BINOPS( _x ) \
+  _x( add_8          , u8  , u8  , l + r ) \
+  _x( add_16         , u16 , u16 , l + r ) \
+  _x( add_32         , u32 , u32 , l + r ) \
+  _x( add_64         , u64 , u64 , l + r ) \
+  _x( sub_8          , u8  , u8  , l - r ) \
+  _x( sub_16         , u16 , u16 , l - r ) \
+  _x( sub_32         , u32 , u32 , l - r ) \
+  _x( sub_64         , u64 , u64 , l - r ) \
+  _x( mul_8          , u8  , u8  , l * r ) \
+  _x( mul_16         , u16 , u16 , l * r ) \
+  _x( mul_32         , u32 , u32 , l * r ) \
+  _x( mul_64         , u64 , u64 , l * r ) \
+  _x( and_8          , u8  , u8  , l & r ) \
+  _x( and_16         , u16 , u16 , l & r ) \
+  _x( and_32         , u32 , u32 , l & r ) \
+  _x( and_64         , u64 , u64 , l & r ) \
+  _x( or_8           , u8  , u8  , l | r ) \
+  _x( or_16          , u16 , u16 , l | r ) \
+  _x( or_32          , u32 , u32 , l | r ) \
+  _x( or_64          , u64 , u64 , l | r ) \
+  _x( eq_8           , u8  , u8  , l == r ) \
+  _x( eq_16          , u16 , u16 , l == r ) \
+  _x( eq_32          , u32 , u32 , l == r ) \
+  _x( eq_64          , u64 , u64 , l == r ) \
+  _x( noteq_8        , u8  , u8  , l != r ) \
+  _x( noteq_16       , u16 , u16 , l != r ) \
+  _x( noteq_32       , u32 , u32 , l != r ) \
+  _x( noteq_64       , u64 , u64 , l != r ) \
+  _x( shiftl_8       , u8  , u8  , l << r ) \
+  _x( shiftl_16      , u16 , u16 , l << r ) \
+  _x( shiftl_32      , u32 , u32 , l << r ) \
+  _x( shiftl_64      , u64 , u64 , l << r ) \
+  _x( shiftrzero_8   , u8  , u8  , l >> r ) \
+  _x( shiftrzero_16  , u16 , u16 , l >> r ) \
+  _x( shiftrzero_32  , u32 , u32 , l >> r ) \
+  _x( shiftrzero_64  , u64 , u64 , l >> r ) \
+  _x( shiftrsign_8   , s8  , s8  , l >> r ) \
+  _x( shiftrsign_16  , s16 , s16 , l >> r ) \
+  _x( shiftrsign_32  , s32 , s32 , l >> r ) \
+  _x( shiftrsign_64  , s64 , s64 , l >> r ) \
+  _x( div_u8         , u8  , u8  , l / r ) \
+  _x( div_u16        , u16 , u16 , l / r ) \
+  _x( div_u32        , u32 , u32 , l / r ) \
+  _x( div_u64        , u64 , u64 , l / r ) \
+  _x( div_s8         , s8  , s8  , l / r ) \
+  _x( div_s16        , s16 , s16 , l / r ) \
+  _x( div_s32        , s32 , s32 , l / r ) \
+  _x( div_s64        , s64 , s64 , l / r ) \
+  _x( mod_u8         , u8  , u8  , l % r ) \
+  _x( mod_u16        , u16 , u16 , l % r ) \
+  _x( mod_u32        , u32 , u32 , l % r ) \
+  _x( mod_u64        , u64 , u64 , l % r ) \
+  _x( mod_s8         , s8  , s8  , l % r ) \
+  _x( mod_s16        , s16 , s16 , l % r ) \
+  _x( mod_s32        , s32 , s32 , l % r ) \
+  _x( mod_s64        , s64 , s64 , l % r ) \
+  _x( pow_u8         , u8  , u8  , ipow( l, r ) ) \
+  _x( pow_u16        , u16 , u16 , ipow( l, r ) ) \
+  _x( pow_u32        , u32 , u32 , ipow( l, r ) ) \
+  _x( pow_u64        , u64 , u64 , ipow( l, r ) ) \
+  _x( pow_s8         , s8  , s8  , ipow( l, r ) ) \
+  _x( pow_s16        , s16 , s16 , ipow( l, r ) ) \
+  _x( pow_s32        , s32 , s32 , ipow( l, r ) ) \
+  _x( pow_s64        , s64 , s64 , ipow( l, r ) ) \
+  _x( gt_u8          , u8  , u8  , l > r ) \
+  _x( gt_u16         , u8  , u16 , l > r ) \
+  _x( gt_u32         , u8  , u32 , l > r ) \
+  _x( gt_u64         , u8  , u64 , l > r ) \
+  _x( gt_s8          , u8  , s8  , l > r ) \
+  _x( gt_s16         , u8  , s16 , l > r ) \
+  _x( gt_s32         , u8  , s32 , l > r ) \
+  _x( gt_s64         , u8  , s64 , l > r ) \
+  _x( gteq_u8        , u8  , u8  , l >= r ) \
+  _x( gteq_u16       , u8  , u16 , l >= r ) \
+  _x( gteq_u32       , u8  , u32 , l >= r ) \
+  _x( gteq_u64       , u8  , u64 , l >= r ) \
+  _x( gteq_s8        , u8  , s8  , l >= r ) \
+  _x( gteq_s16       , u8  , s16 , l >= r ) \
+  _x( gteq_s32       , u8  , s32 , l >= r ) \
+  _x( gteq_s64       , u8  , s64 , l >= r ) \
+  _x( lt_u8          , u8  , u8  , l < r ) \
+  _x( lt_u16         , u8  , u16 , l < r ) \
+  _x( lt_u32         , u8  , u32 , l < r ) \
+  _x( lt_u64         , u8  , u64 , l < r ) \
+  _x( lt_s8          , u8  , s8  , l < r ) \
+  _x( lt_s16         , u8  , s16 , l < r ) \
+  _x( lt_s32         , u8  , s32 , l < r ) \
+  _x( lt_s64         , u8  , s64 , l < r ) \
+  _x( lteq_u8        , u8  , u8  , l <= r ) \
+  _x( lteq_u16       , u8  , u16 , l <= r ) \
+  _x( lteq_u32       , u8  , u32 , l <= r ) \
+  _x( lteq_u64       , u8  , u64 , l <= r ) \
+  _x( lteq_s8        , u8  , s8  , l <= r ) \
+  _x( lteq_s16       , u8  , s16 , l <= r ) \
+  _x( lteq_s32       , u8  , s32 , l <= r ) \
+  _x( lteq_s64       , u8  , s64 , l <= r ) \
+  _x( add_f32        , f32 , f32 , l + r ) \
+  _x( add_f64        , f64 , f64 , l + r ) \
+  _x( sub_f32        , f32 , f32 , l - r ) \
+  _x( sub_f64        , f64 , f64 , l - r ) \
+  _x( mul_f32        , f32 , f32 , l * r ) \
+  _x( mul_f64        , f64 , f64 , l * r ) \
+  _x( div_f32        , f32 , f32 , l / r ) \
+  _x( div_f64        , f64 , f64 , l / r ) \
+  _x( mod_f32        , f32 , f32 , Mod32( l, r ) ) \
+  _x( mod_f64        , f64 , f64 , Mod64( l, r ) ) \
+  _x( pow_f32        , f32 , f32 , Pow32( l, r ) ) \
+  _x( pow_f64        , f64 , f64 , Pow64( l, r ) ) \
+  _x( and_f32        , u8  , f32 , l != 0  &&  r != 0 ) \
+  _x( and_f64        , u8  , f64 , l != 0  &&  r != 0 ) \
+  _x( or_f32         , u8  , f32 , l != 0  ||  r != 0 ) \
+  _x( or_f64         , u8  , f64 , l != 0  ||  r != 0 ) \
+  _x( eq_f32         , u8  , f32 , l == r ) \
+  _x( eq_f64         , u8  , f64 , l == r ) \
+  _x( noteq_f32      , u8  , f32 , l != r ) \
+  _x( noteq_f64      , u8  , f64 , l != r ) \
+  _x( gt_f32         , u8  , f32 , l > r ) \
+  _x( gt_f64         , u8  , f64 , l > r ) \
+  _x( gteq_f32       , u8  , f32 , l >= r ) \
+  _x( gteq_f64       , u8  , f64 , l >= r ) \
+  _x( lt_f32         , u8  , f32 , l < r ) \
+  _x( lt_f64         , u8  , f64 , l < r ) \
+  _x( lteq_f32       , u8  , f32 , l <= r ) \
+  _x( lteq_f64       , u8  , f64 , l <= r ) \
+
+// name, result type, operand type, expression of v.
+#define VM_UNOPS( _x ) \
+  _x( negate_8         , u8  , u8  , ~v ) \
+  _x( negate_16        , u16 , u16 , ~v ) \
+  _x( negate_32        , u32 , u32 , ~v ) \
+  _x( negate_64        , u64 , u64 , ~v ) \
+  _x( negateint_8      , u8  , u8  , ~v + 1 ) \
+  _x( negateint_16     , u16 , u16 , ~v + 1 ) \
+  _x( negateint_32     , u32 , u32 , ~v + 1 ) \
+  _x( negateint_64     , u64 , u64 , ~v + 1 ) \
+  _x( negatefloat_8    , u8  , u8  , v ^ ( 1u   <<  7 ) ) \
+  _x( negatefloat_16   , u16 , u16 , v ^ ( 1u   << 15 ) ) \
+  _x( negatefloat_32   , u32 , u32 , v ^ ( 1u   << 31 ) ) \
+  _x( negatefloat_64   , u64 , u64 , v ^ ( 1ull << 63 ) ) \
+  _x( extendzero_8_16  , u16 , u8  , v ) \
+  _x( extendzero_8_32  , u32 , u8  , v ) \
+  _x( extendzero_8_64  , u64 , u8  , v ) \
+  _x( extendzero_16_32 , u32 , u16 , v ) \
+  _x( extendzero_16_64 , u64 , u16 , v ) \
+  _x( extendzero_32_64 , u64 , u32 , v ) \
+  _x( extendsign_8_16  , s16 , s8  , v ) \
+  _x( extendsign_8_32  , s32 , s8  , v ) \
+  _x( extendsign_8_64  , s64 , s8  , v ) \
+  _x( extendsign_16_32 , s32 , s16 , v ) \
+  _x( extendsign_16_64 , s64 , s16 , v ) \
+  _x( extendsign_32_64 , s64 , s32 , v ) \
+
+// the sized ops come in runs of _8, _16, _32, _64, _n; see _VmSizedOp.
+Enumc( vmop_t )
+{
+  halt,
+  call,
+  ret,
+  addr,
+  jump,
+  move_8,
+  move_16,
+  move_32,
+  move_64,
+  move_n,
+  loadconstant_8,
+  loadconstant_16,
+  loadconstant_32,
+  loadconstant_64,
+  loadconstant_n,
+  store_8,
+  store_16,
+  store_32,
+  store_64,
+  store_n,
+  jumpzero_8,
+  jumpzero_16,
+  jumpzero_32,
+  jumpzero_64,
+  jumpzero_n,
+  jumpnotzero_8,
+  jumpnotzero_16,
+  jumpnotzero_32,
+  jumpnotzero_64,
+  jumpnotzero_n,
+  assertvalue,
+  #define CASE( name, tr, to, expr ) \
+    NAMEJOIN( binop_, name ), \
+    NAMEJOIN( binopimm_, name ), \
+    NAMEJOIN( jz_, name ), \
+    NAMEJOIN( jnz_, name ), \
+    NAMEJOIN( jzimm_, name ), \
+    NAMEJOIN( jnzimm_, name ),
+  VM_BINOPS( CASE )
+  #undef CASE
+  #define CASE( name, tr, to, expr )   NAMEJOIN( unop_, name ),
+  VM_UNOPS( CASE )
+  #undef CASE
+  COUNT
+};
 
-  s64 offset_into_scope;
+// operand meanings depend on the op:
+//   call: a = callee save area, as an offset into the caller frame. b = target instr. c = callee frame length.
+//   move/addr: a = dst, b = src. move_n has the bytecount in c.
+//   loadconstant: a = dst. the constant itself is in b ( and c for _64 ). _n has a pointer in b:c, bytecount in n.
+//   store: a = the var holding the dst address. b = src. _n has the bytecount in c.
+//   jump: c = target instr. jumpzero/jumpnotzero: a = cond, c = target. _n has the bytecount in n.
+//   binop: a = dst, b = l, c = r. binopimm: c holds r itself.
+//   jz/jnz: a = l, b = r, c = target. jzimm/jnzimm: b holds r itself.
+//   unop: a = dst, b = src.
+//   assertvalue: a = var, pointer to the expected value in b:c, bytecount in n.
+struct
+vminstr_t
+{
+  u16 op;
+  u16 n;
+  s32 a;
+  s32 b;
+  s32 c;
+};
 
+struct
+vmcode_t
+{
+  stack_resizeable_cont_t<vminstr_t> instrs;
+  idx_t entry_point;
+  u32 nfused; // # of superinstructions.
+};
 
-//Inl void
-//ComputeStackOffset(
-//  vartable_t* vartable,
-//  var_t* var
-//  )
-//{
-//  var->offset_into_scope = vartable->vars_bytecount_top;
-//  vartable->vars_bytecount_top += var->type.bytecount;
-//}
+Inl void
+Init( vmcode_t& vm )
+{
+  Alloc( vm.instrs, 1024 );
+  vm.entry_point = 0;
+  vm.nfused = 0;
+}
 
+Inl void
+Kill( vmcode_t& vm )
+{
+  Free( vm.instrs );
+}
 
+constant s32 c_vm_save_bytecount = 2 * sizeof( idx_t ); // caller frame, return instr.
 
+Templ ForceInl T
+VmImm( s32 imm )
+{
+  return Cast( T, imm );
+}
+template<> ForceInl f32
+VmImm<f32>( s32 imm )
+{
+  f32 r;
+  Memmove( &r, &imm, sizeof( r ) );
+  return r;
+}
 
+Inl vmop_t
+_VmSizedOp( vmop_t op_8, u32 bytecount )
+{
+  switch( bytecount ) {
+    case 1: return op_8;
+    case 2: return Cast( vmop_t, Cast( enum_t, op_8 ) + 1 );
+    case 4: return Cast( vmop_t, Cast( enum_t, op_8 ) + 2 );
+    case 8: return Cast( vmop_t, Cast( enum_t, op_8 ) + 3 );
+    default: return Cast( vmop_t, Cast( enum_t, op_8 ) + 4 );
+  }
+}
 
-Inl void
-PrintCppType(
-  stack_resizeable_cont_t<u8>* out,
-  type_t* type
-  )
+// the binops come in runs of 6 ops, starting from binop_. see vmop_t.
+Inl vmop_t
+_VmBinop( bc_binop_type_t type, idx_t variant )
 {
-  switch( type->type ) {
-    case type_type_t::num: {
-      auto bytecount = type->num.bytecount;
-      switch( type->num.type ) {
-        case num_type_t::unsigned_: {
-          AddBackString( out, "u" );
-        } break;
-        case num_type_t::signed_: {
-          AddBackString( out, "s" );
-        } break;
-        case num_type_t::float_: {
-          AddBackString( out, "f" );
-        } break;
-        default: UnreachableCrash();
+  return Cast( vmop_t, Cast( enum_t, vmop_t::binop_add_8 ) + 6 * Cast( enum_t, type ) + variant );
+}
+
+Inl bool
+_VmBinopIsFloat( bc_binop_type_t type, bool* result_float, u32* operand_bytecount )
+{
+  switch( type ) {
+    #define CASE( name, tr, to, expr ) \
+      case bc_binop_type_t::name: { \
+        *result_float = std::is_floating_point<tr>::value; \
+        *operand_bytecount = sizeof( to ); \
+        return std::is_floating_point<to>::value; \
       }
-      stack_nonresizeable_stack_t<u8, 64> tmp;
-      CsFromIntegerU( tmp.mem, Capacity( tmp ), &tmp.len, bytecount * 8 );
-      AddBackString( out, SliceFromArray( tmp ) );
-    } break;
-    case type_type_t::bool_: {
-      AddBackString( out, "bool" );
-    } break;
-    case type_type_t::string_: {
-      AddBackString( out, "string" );
-    } break;
-    case type_type_t::struct_: {
-      PrintIdent( out, &type->structdecltype->ident );
-    } break;
-    case type_type_t::enum_: {
-      PrintIdent( out, &type->enumdecltype->ident );
-    } break;
-    default: UnreachableCrash();
-  }
-  if( type->qualifiers.len ) {
-    AddBackString( out, " " );
-  }
-  FORLIST( qualifier, elem, type->qualifiers )
-    switch( qualifier->type ) {
-      case typedecl_qualifier_type_t::star: {
-        AddBackString( out, "*" );
-      } break;
-      case typedecl_qualifier_type_t::array: {
-        AddBackString( out, "[" );
-        FORLIST( arrayidx, elem2, qualifier->arrayidxs )
-          switch( arrayidx->type ) {
-            case typedecl_arrayidx_type_t::star: {
-              AddBackString( out, "*" );
-            } break;
-            case typedecl_arrayidx_type_t::expr_const: {
-              stack_nonresizeable_stack_t<u8, 64> tmp;
-              CsFromIntegerU( tmp.mem, Capacity( tmp ), &tmp.len, arrayidx->value );
-              AddBackString( out, SliceFromArray( tmp ) );
-            } break;
-            default: UnreachableCrash();
-          }
-          if( elem2 != qualifier->arrayidxs.last ) {
-            AddBackString( out, ", " );
-          }
-        }
-        AddBackString( out, "]" );
-      } break;
-      default: UnreachableCrash();
-    }
+    VM_BINOPS( CASE )
+    #undef CASE
+    default: UnreachableCrash(); return 0;
   }
 }
-Inl void
-PrintCppVarName(
-  stack_resizeable_cont_t<u8>* out,
-  var_t* var
-  )
+
+// calls fn( slot ) for every stackvar the bc reads, including vars whose address is taken.
+Templ Inl void
+_VmForEachRead( bc_t* bc, T fn )
 {
-  AddBackString( out, "var" );
-  PrintU64( out, var->idx );
+  switch( bc->type ) {
+    case bc_type_t::fncall: {
+      FORLEN( loc, k, bc->fncall.caller_loc_args )
+        fn( *loc );
+      }
+      FORLEN( loc, k, bc->fncall.caller_loc_rets )
+        fn( *loc );
+      }
+    } break;
+    case bc_type_t::move: { fn( bc->move.var_r ); } break;
+    case bc_type_t::store: { fn( bc->store.var_l );  fn( bc->store.var_r ); } break;
+    case bc_type_t::jumpnotzero:
+    case bc_type_t::jumpzero: { fn( bc->jumpcond.var_cond ); } break;
+    case bc_type_t::binop: { fn( bc->binop.var_l );  fn( bc->binop.var_r ); } break;
+    case bc_type_t::unop: { fn( bc->unop.var ); } break;
+    case bc_type_t::assertvalue: { fn( bc->assertvalue.var_l ); } break;
+    case bc_type_t::loadconstant:
+    case bc_type_t::ret:
+    case bc_type_t::jump: break;
+    default: UnreachableCrash();
+  }
 }
-Inl void
-PrintCppVar(
-  stack_resizeable_cont_t<u8>* out,
-  var_t* var
-  )
+
+Inl bool
+_VmSlotsEqual( bc_var_t a, bc_var_t b )
 {
-  PrintCppType( out, &var->type );
-  AddBackString( out, " " );
-  PrintCppVarName( out, var );
+  return a.offset_into_scope == b.offset_into_scope  &&  a.bytecount == b.bytecount;
 }
-Inl void
-PrintCppFndecltype(
-  stack_resizeable_cont_t<u8>* out,
-  fndecltype_t* fndecltype
+
+NoInl void
+LowerToVm(
+  tslice_t<bc_t> code,
+  idx_t entry_point,
+  vmcode_t* vm
   )
 {
-  AddBackString( out, "void " );
-  PrintIdent( out, &fndecltype->ident );
-  AddBackString( out, "(\n" );
-  FORLEN( type_arg, j, fndecltype->args )
-    AddBackString( out, "  " );
-    PrintCppType( out, &type_arg->type );
-    AddBackString( out, " " );
-    PrintIdent( out, &type_arg->ident );
-    if( j + 1 != fndecltype->args.len  ||  fndecltype->rets.len ) {
-      AddBackString( out, "," );
+  // static frame lengths, indexed by the first bc of each function.
+  // Execute computes the same thing dynamically on every fncall.
+  auto frame_lens = MemHeapAlloc( u32, code.len + 1 );
+  TSet( frame_lens, code.len + 1, MAX_u32 );
+  frame_lens[entry_point] = 0;
+  FORLEN( bc, i, code )
+    if( bc->type != bc_type_t::fncall ) {
+      continue;
     }
-    AddBackString( out, "\n" );
+    u32 frame_len = bc->fncall.bytecount_locals;
+    FORLEN( loc, k, bc->fncall.caller_loc_args )
+      frame_len += loc->bytecount;
+    }
+    frame_len += Cast( u32, bc->fncall.caller_loc_rets.len * sizeof( void* ) );
+    auto target = bc->fncall.target_fn_bc_start;
+    AssertCrash( target < code.len );
+    AssertCrash( frame_lens[target] == MAX_u32  ||  frame_lens[target] == frame_len );
+    frame_lens[target] = frame_len;
   }
-  FORLEN( type_ret, j, fndecltype->rets )
-    AddBackString( out, "  " );
-    PrintCppType( out, type_ret );
-    AddBackString( out, "* " ); // rets are passed as pointer args.
-    AddBackString( out, "_ret" );
-    PrintU64( out, j );
-    if( j + 1 != fndecltype->rets.len ) {
-      AddBackString( out, "," );
+
+  auto is_target = MemHeapAlloc( u8, code.len + 1 );
+  TZero( is_target, code.len + 1 );
+  FORLEN( bc, i, code )
+    switch( bc->type ) {
+      case bc_type_t::jump: { is_target[ bc->jump.target ] = 1; } break;
+      case bc_type_t::jumpzero:
+      case bc_type_t::jumpnotzero: { is_target[ bc->jumpcond.jump.target ] = 1; } break;
+      default: break;
     }
-    AddBackString( out, "\n" );
   }
-  AddBackString( out, "  )" );
-}
-NoInl void
-GenerateCpp(
-  compilefile_t* ctx,
-  stack_resizeable_cont_t<u8>* out
-  )
-{
-  auto globaltypes = ctx->globaltypes;
-  AddBackString( out, "typedef int8_t      s8;\n" );
-  AddBackString( out, "typedef int16_t    s16;\n" );
-  AddBackString( out, "typedef int32_t    s32;\n" );
-  AddBackString( out, "typedef int64_t    s64;\n" );
-  AddBackString( out, "typedef uint8_t     u8;\n" );
-  AddBackString( out, "typedef uint16_t   u16;\n" );
-  AddBackString( out, "typedef uint32_t   u32;\n" );
+
+  // first lowered instr of each bc, so we can patch jump and call targets afterwards.
+  auto map = MemHeapAlloc( u32, code.len + 1 );
+
+  // per-byte read counts over the current function's frame, for finding temporaries that are only read once.
+  stack_resizeable_cont_t<u32> reads;
+  Alloc( reads, 1024 );
+
+  auto& instrs = vm->instrs;
+  instrs.len = 0;
+  vm->nfused = 0;
+
+  idx_t i = 0;
+  u32 frame_len = 0;
+  while( i < code.len ) {
+    if( frame_lens[i] != MAX_u32 ) {
+      // new function; recount reads up to the next one.
+      frame_len = frame_lens[i];
+      reads.len = 0;
+      auto CountRead = [&]( bc_var_t slot )
+      {
+        auto end = Cast( idx_t, slot.offset_into_scope ) + slot.bytecount;
+        if( end > reads.len ) {
+          auto len = reads.len;
+          Reserve( reads, end );
+          TZero( reads.mem + len, end - len );
+          reads.len = end;
+        }
+        For( t, 0, slot.bytecount ) {
+          reads.mem[ slot.offset_into_scope + t ] += 1;
+        }
+      };
+      for( auto j = i;  j < code.len;  ++j ) {
+        if( j != i  &&  frame_lens[j] != MAX_u32 ) {
+          break;
+        }
+        _VmForEachRead( code.mem + j, CountRead );
+      }
+    }
+    auto ReadOnce = [&]( bc_var_t slot )
+    {
+      For( t, 0, slot.bytecount ) {
+        auto offset = slot.offset_into_scope + t;
+        if( offset >= reads.len  ||  reads.mem[offset] != 1 ) {
+          return 0;
+        }
+      }
+      return 1;
+    };
+    auto InFunction = [&]( idx_t j )
+    {
+      return j < code.len  &&  !is_target[j]  &&  frame_lens[j] == MAX_u32;
+    };
+
+    map[i] = Cast( u32, instrs.len );
+    auto bc = code.mem + i;
+    switch( bc->type ) {
+      case bc_type_t::fncall: {
+        // args go by value, straight into the callee frame. rets go by reference.
+        auto base = Cast( s32, frame_len ) + c_vm_save_bytecount;
+        s32 offset = 0;
+        FORLEN( loc, k, bc->fncall.caller_loc_args )
+          auto instr = AddBack( instrs );
+          instr->op = Cast( u16, _VmSizedOp( vmop_t::move_8, loc->bytecount ) );
+          instr->n = 0;
+          instr->a = base + offset;
+          instr->b = loc->offset_into_scope;
+          instr->c = loc->bytecount;
+          offset += loc->bytecount;
+        }
+        FORLEN( loc, k, bc->fncall.caller_loc_rets )
+          auto instr = AddBack( instrs );
+          instr->op = Cast( u16, vmop_t::addr );
+          instr->n = 0;
+          instr->a = base + offset;
+          instr->b = loc->offset_into_scope;
+          instr->c = 0;
+          offset += sizeof( void* );
+        }
+        auto instr = AddBack( instrs );
+        instr->op = Cast( u16, vmop_t::call );
+        instr->n = 0;
+        instr->a = Cast( s32, frame_len );
+        instr->b = Cast( s32, bc->fncall.target_fn_bc_start ); // patched below.
+        instr->c = Cast( s32, frame_lens[ bc->fncall.target_fn_bc_start ] );
+        i += 1;
+      } break;
+
+      case bc_type_t::ret: {
+        auto instr = AddBack( instrs );
+        *instr = {};
+        instr->op = Cast( u16, vmop_t::ret );
+        i += 1;
+      } break;
+
+      case bc_type_t::move: {
+        AssertCrash( bc->move.var_l.bytecount == bc->move.var_r.bytecount );
+        auto instr = AddBack( instrs );
+        instr->op = Cast( u16, _VmSizedOp( vmop_t::move_8, bc->move.var_l.bytecount ) );
+        instr->n = 0;
+        instr->a = bc->move.var_l.offset_into_scope;
+        instr->b = bc->move.var_r.offset_into_scope;
+        instr->c = bc->move.var_l.bytecount;
+        i += 1;
+      } break;
+
+      case bc_type_t::loadconstant: {
+        auto slot = bc->loadconstant.var_l;
+        u64 value = 0;
+        if( slot.bytecount <= sizeof( value ) ) {
+          Memmove( &value, bc->loadconstant.mem, slot.bytecount );
+        }
+
+        // loadconstant t; binop d <- x, t;
+        if( InFunction( i + 1 )  &&  code.mem[i + 1].type == bc_type_t::binop ) {
+          auto binop = &code.mem[i + 1].binop;
+          bool result_float;
+          u32 operand_bytecount;
+          auto operand_float = _VmBinopIsFloat( binop->type, &result_float, &operand_bytecount );
+          auto fits = operand_bytecount <= 4  ||
+            ( !operand_float  &&  Cast( u64, Cast( s64, Cast( s32, value ) ) ) == value );
+          if( fits  &&
+              _VmSlotsEqual( binop->var_r, slot )  &&
+              !_VmSlotsEqual( binop->var_l, slot )  &&
+              ReadOnce( slot ) )
+          {
+            // ... jumpzero d;
+            auto bc_jump = code.mem + i + 2;
+            if( InFunction( i + 2 )  &&
+                !result_float  &&
+                ( bc_jump->type == bc_type_t::jumpzero  ||  bc_jump->type == bc_type_t::jumpnotzero )  &&
+                _VmSlotsEqual( bc_jump->jumpcond.var_cond, binop->var_result )  &&
+                ReadOnce( binop->var_result ) )
+            {
+              auto instr = AddBack( instrs );
+              instr->op = Cast( u16, _VmBinop( binop->type, bc_jump->type == bc_type_t::jumpzero  ?  4  :  5 ) );
+              instr->n = 0;
+              instr->a = binop->var_l.offset_into_scope;
+              instr->b = Cast( s32, value );
+              instr->c = Cast( s32, bc_jump->jumpcond.jump.target ); // patched below.
+              map[i + 1] = map[i];
+              map[i + 2] = map[i];
+              vm->nfused += 1;
+              i += 3;
+              break;
+            }
+            auto instr = AddBack( instrs );
+            instr->op = Cast( u16, _VmBinop( binop->type, 1 ) );
+            instr->n = 0;
+            instr->a = binop->var_result.offset_into_scope;
+            instr->b = binop->var_l.offset_into_scope;
+            instr->c = Cast( s32, value );
+            map[i + 1] = map[i];
+            vm->nfused += 1;
+            i += 2;
+            break;
+          }
+        }
+
+        auto op = _VmSizedOp( vmop_t::loadconstant_8, slot.bytecount );
+        auto instr = AddBack( instrs );
+        instr->op = Cast( u16, op );
+        instr->n = 0;
+        instr->a = slot.offset_into_scope;
+        if( op != vmop_t::loadconstant_n ) {
+          instr->b = Cast( s32, value );
+          instr->c = Cast( s32, value >> 32 );
+        } else {
+          AssertCrash( slot.bytecount <= MAX_u16 );
+          instr->n = Cast( u16, slot.bytecount );
+          auto ptr = Cast( u64, bc->loadconstant.mem );
+          instr->b = Cast( s32, ptr );
+          instr->c = Cast( s32, ptr >> 32 );
+        }
+        i += 1;
+      } break;
+
+      case bc_type_t::store: {
+        auto instr = AddBack( instrs );
+        instr->op = Cast( u16, _VmSizedOp( vmop_t::store_8, bc->store.var_r.bytecount ) );
+        instr->n = 0;
+        instr->a = bc->store.var_l.offset_into_scope;
+        instr->b = bc->store.var_r.offset_into_scope;
+        instr->c = bc->store.var_r.bytecount;
+        i += 1;
+      } break;
+
+      case bc_type_t::jump: {
+        auto instr = AddBack( instrs );
+        instr->op = Cast( u16, vmop_t::jump );
+        instr->n = 0;
+        instr->a = 0;
+        instr->b = 0;
+        instr->c = Cast( s32, bc->jump.target ); // patched below.
+        i += 1;
+      } break;
+
+      case bc_type_t::jumpzero:
+      case bc_type_t::jumpnotzero: {
+        auto cond = bc->jumpcond.var_cond;
+        auto op_8 = bc->type == bc_type_t::jumpzero  ?  vmop_t::jumpzero_8  :  vmop_t::jumpnotzero_8;
+        auto instr = AddBack( instrs );
+        instr->op = Cast( u16, _VmSizedOp( op_8, cond.bytecount ) );
+        AssertCrash( cond.bytecount <= MAX_u16 );
+        instr->n = Cast( u16, cond.bytecount );
+        instr->a = cond.offset_into_scope;
+        instr->b = 0;
+        instr->c = Cast( s32, bc->jumpcond.jump.target ); // patched below.
+        i += 1;
+      } break;
+
+      case bc_type_t::binop: {
+        auto binop = &bc->binop;
+
+        // binop c <- x, y; jumpzero c;
+        auto bc_jump = code.mem + i + 1;
+        bool result_float;
+        u32 operand_bytecount;
+        _VmBinopIsFloat( binop->type, &result_float, &operand_bytecount );
+        if( InFunction( i + 1 )  &&
+            !result_float  &&
+            ( bc_jump->type == bc_type_t::jumpzero  ||  bc_jump->type == bc_type_t::jumpnotzero )  &&
+            _VmSlotsEqual( bc_jump->jumpcond.var_cond, binop->var_result )  &&
+            ReadOnce( binop->var_result ) )
+        {
+          auto instr = AddBack( instrs );
+          instr->op = Cast( u16, _VmBinop( binop->type, bc_jump->type == bc_type_t::jumpzero  ?  2  :  3 ) );
+          instr->n = 0;
+          instr->a = binop->var_l.offset_into_scope;
+          instr->b = binop->var_r.offset_into_scope;
+          instr->c = Cast( s32, bc_jump->jumpcond.jump.target ); // patched below.
+          map[i + 1] = map[i];
+          vm->nfused += 1;
+          i += 2;
+          break;
+        }
+
+        auto instr = AddBack( instrs );
+        instr->op = Cast( u16, _VmBinop( binop->type, 0 ) );
+        instr->n = 0;
+        instr->a = binop->var_result.offset_into_scope;
+        instr->b = binop->var_l.offset_into_scope;
+        instr->c = binop->var_r.offset_into_scope;
+        i += 1;
+      } break;
+
+      case bc_type_t::unop: {
+        auto instr = AddBack( instrs );
+        instr->op = Cast( u16, Cast( enum_t, vmop_t::unop_negate_8 ) + Cast( enum_t, bc->unop.type ) );
+        instr->n = 0;
+        instr->a = bc->unop.var_result.offset_into_scope;
+        instr->b = bc->unop.var.offset_into_scope;
+        instr->c = 0;
+        i += 1;
+      } break;
+
+      case bc_type_t::assertvalue: {
+        auto instr = AddBack( instrs );
+        instr->op = Cast( u16, vmop_t::assertvalue );
+        AssertCrash( bc->assertvalue.var_l.bytecount <= MAX_u16 );
+        instr->n = Cast( u16, bc->assertvalue.var_l.bytecount );
+        instr->a = bc->assertvalue.var_l.offset_into_scope;
+        auto ptr = Cast( u64, bc->assertvalue.mem );
+        instr->b = Cast( s32, ptr );
+        instr->c = Cast( s32, ptr >> 32 );
+        i += 1;
+      } break;
+
+      default: UnreachableCrash();
+    }
+  }
+
+  // running off the end of the code is how Execute stops, so jumps and rets to the end go to a halt.
+  map[code.len] = Cast( u32, instrs.len );
+  {
+    auto instr = AddBack( instrs );
+    *instr = {};
+    instr->op = Cast( u16, vmop_t::halt );
+  }
+
+  FORLEN( instr, k, instrs )
+    auto op = Cast( vmop_t, instr->op );
+    if( op == vmop_t::call ) {
+      instr->b = map[ instr->b ];
+    }
+    elif( op == vmop_t::jump  ||
+          ( vmop_t::jumpzero_8 <= op  &&  op <= vmop_t::jumpnotzero_n ) )
+    {
+      instr->c = map[ instr->c ];
+    }
+    elif( vmop_t::binop_add_8 <= op  &&  op <= _VmBinop( bc_binop_type_t::lteq_f64, 5 ) ) {
+      auto variant = ( Cast( enum_t, op ) - Cast( enum_t, vmop_t::binop_add_8 ) ) % 6;
+      if( variant >= 2 ) {
+        instr->c = map[ instr->c ];
+      }
+    }
+  }
+  vm->entry_point = map[entry_point];
+
+  Free( reads );
+  MemHeapFree( map );
+  MemHeapFree( is_target );
+  MemHeapFree( frame_lens );
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+  #define VM_COMPUTED_GOTO   1
+#else
+  #define VM_COMPUTED_GOTO   0
+#endif
+
+NoInl void
+ExecuteVm( vmcode_t* vm )
+{
+  if( !vm->instrs.len ) {
+    return;
+  }
+  slice_t stack;
+  stack.len = 1024*1024;
+  stack.mem = MemHeapAlloc( u8, stack.len );
+  Memzero( stack.mem, stack.len );
+  auto stack_end = stack.mem + stack.len;
+  auto frame = stack.mem;
+  auto instrs = vm->instrs.mem;
+  auto ip = instrs + vm->entry_point;
+
+  #define VM_OPERAND( _type, _offset )   ( *Cast( _type*, frame + ( _offset ) ) )
+  #define VM_NEXT \
+    ip += 1; \
+    VM_DISPATCH; \
+
+#if VM_COMPUTED_GOTO
+  static const void* c_labels[] = {
+    &&l_halt,
+    &&l_call,
+    &&l_ret,
+    &&l_addr,
+    &&l_jump,
+    &&l_move_8,
+    &&l_move_16,
+    &&l_move_32,
+    &&l_move_64,
+    &&l_move_n,
+    &&l_loadconstant_8,
+    &&l_loadconstant_16,
+    &&l_loadconstant_32,
+    &&l_loadconstant_64,
+    &&l_loadconstant_n,
+    &&l_store_8,
+    &&l_store_16,
+    &&l_store_32,
+    &&l_store_64,
+    &&l_store_n,
+    &&l_jumpzero_8,
+    &&l_jumpzero_16,
+    &&l_jumpzero_32,
+    &&l_jumpzero_64,
+    &&l_jumpzero_n,
+    &&l_jumpnotzero_8,
+    &&l_jumpnotzero_16,
+    &&l_jumpnotzero_32,
+    &&l_jumpnotzero_64,
+    &&l_jumpnotzero_n,
+    &&l_assertvalue,
+    #define CASE( name, tr, to, expr ) \
+      &&NAMEJOIN( l_binop_, name ), \
+      &&NAMEJOIN( l_binopimm_, name ), \
+      &&NAMEJOIN( l_jz_, name ), \
+      &&NAMEJOIN( l_jnz_, name ), \
+      &&NAMEJOIN( l_jzimm_, name ), \
+      &&NAMEJOIN( l_jnzimm_, name ),
+    VM_BINOPS( CASE )
+    #undef CASE
+    #define CASE( name, tr, to, expr )   &&NAMEJOIN( l_unop_, name ),
+    VM_UNOPS( CASE )
+    #undef CASE
+  };
+  CompileAssert( _countof( c_labels ) == Cast( idx_t, vmop_t::COUNT ) );
+  #define VM_CASE( _name )   NAMEJOIN( l_, _name ):
+  #define VM_DISPATCH        goto *c_labels[ ip->op ]
+
+  VM_DISPATCH;
+  {
+#else
+  #define VM_CASE( _name )   case vmop_t::_name:
+  #define VM_DISPATCH        continue
+
+  Forever {
+    switch( Cast( vmop_t, ip->op ) ) {
+#endif
+
+    VM_CASE( halt ) {
+      goto LDone;
+    }
+    VM_CASE( call ) {
+      auto save = Cast( idx_t*, frame + ip->a );
+      auto callee = frame + ip->a + c_vm_save_bytecount;
+      AssertCrash( callee + ip->c <= stack_end );
+      save[0] = Cast( idx_t, frame );
+      save[1] = Cast( idx_t, ip + 1 );
+      frame = callee;
+      ip = instrs + ip->b;
+      VM_DISPATCH;
+    }
+    VM_CASE( ret ) {
+      auto save = Cast( idx_t*, frame - c_vm_save_bytecount );
+      frame = Cast( u8*, save[0] );
+      ip = Cast( vminstr_t*, save[1] );
+      VM_DISPATCH;
+    }
+    VM_CASE( addr ) {
+      VM_OPERAND( u8*, ip->a ) = frame + ip->b;
+      VM_NEXT;
+    }
+    VM_CASE( jump ) {
+      ip = instrs + ip->c;
+      VM_DISPATCH;
+    }
+
+    #define SIZED( _name, _body ) \
+      VM_CASE( NAMEJOIN( _name, _8  ) ) { typedef u8  T; _body } \
+      VM_CASE( NAMEJOIN( _name, _16 ) ) { typedef u16 T; _body } \
+      VM_CASE( NAMEJOIN( _name, _32 ) ) { typedef u32 T; _body } \
+      VM_CASE( NAMEJOIN( _name, _64 ) ) { typedef u64 T; _body } \
+
+    SIZED( move, VM_OPERAND( T, ip->a ) = VM_OPERAND( T, ip->b );  VM_NEXT; )
+    VM_CASE( move_n ) {
+      Memmove( frame + ip->a, frame + ip->b, ip->c );
+      VM_NEXT;
+    }
+    SIZED( loadconstant, VM_OPERAND( T, ip->a ) = Cast( T, Cast( u32, ip->b ) | ( Cast( u64, Cast( u32, ip->c ) ) << 32 ) );  VM_NEXT; )
+    VM_CASE( loadconstant_n ) {
+      auto src = Cast( u8*, Cast( u64, Cast( u32, ip->b ) ) | ( Cast( u64, Cast( u32, ip->c ) ) << 32 ) );
+      Memmove( frame + ip->a, src, ip->n );
+      VM_NEXT;
+    }
+    SIZED( store, *VM_OPERAND( T*, ip->a ) = VM_OPERAND( T, ip->b );  VM_NEXT; )
+    VM_CASE( store_n ) {
+      Memmove( VM_OPERAND( u8*, ip->a ), frame + ip->b, ip->c );
+      VM_NEXT;
+    }
+    SIZED( jumpzero, if( !VM_OPERAND( T, ip->a ) ) { ip = instrs + ip->c;  VM_DISPATCH; }  VM_NEXT; )
+    VM_CASE( jumpzero_n ) {
+      if( MemIsZero( frame + ip->a, ip->n ) ) {
+        ip = instrs + ip->c;
+        VM_DISPATCH;
+      }
+      VM_NEXT;
+    }
+    SIZED( jumpnotzero, if( VM_OPERAND( T, ip->a ) ) { ip = instrs + ip->c;  VM_DISPATCH; }  VM_NEXT; )
+    VM_CASE( jumpnotzero_n ) {
+      if( !MemIsZero( frame + ip->a, ip->n ) ) {
+        ip = instrs + ip->c;
+        VM_DISPATCH;
+      }
+      VM_NEXT;
+    }
+    #undef SIZED
+
+    VM_CASE( assertvalue ) {
+      auto expected = Cast( u8*, Cast( u64, Cast( u32, ip->b ) ) | ( Cast( u64, Cast( u32, ip->c ) ) << 32 ) );
+      AssertCrash( MemEqual( expected, frame + ip->a, ip->n ) );
+      VM_NEXT;
+    }
+
+    #define CASE( name, tr, to, expr ) \
+      VM_CASE( NAMEJOIN( binop_, name ) ) { \
+        auto l = VM_OPERAND( to, ip->b ); \
+        auto r = VM_OPERAND( to, ip->c ); \
+        VM_OPERAND( tr, ip->a ) = Cast( tr, expr ); \
+        VM_NEXT; \
+      } \
+      VM_CASE( NAMEJOIN( binopimm_, name ) ) { \
+        auto l = VM_OPERAND( to, ip->b ); \
+        auto r = VmImm<to>( ip->c ); \
+        VM_OPERAND( tr, ip->a ) = Cast( tr, expr ); \
+        VM_NEXT; \
+      } \
+      VM_CASE( NAMEJOIN( jz_, name ) ) { \
+        auto l = VM_OPERAND( to, ip->a ); \
+        auto r = VM_OPERAND( to, ip->b ); \
+        if( Cast( tr, expr ) == 0 ) { \
+          ip = instrs + ip->c; \
+          VM_DISPATCH; \
+        } \
+        VM_NEXT; \
+      } \
+      VM_CASE( NAMEJOIN( jnz_, name ) ) { \
+        auto l = VM_OPERAND( to, ip->a ); \
+        auto r = VM_OPERAND( to, ip->b ); \
+        if( Cast( tr, expr ) != 0 ) { \
+          ip = instrs + ip->c; \
+          VM_DISPATCH; \
+        } \
+        VM_NEXT; \
+      } \
+      VM_CASE( NAMEJOIN( jzimm_, name ) ) { \
+        auto l = VM_OPERAND( to, ip->a ); \
+        auto r = VmImm<to>( ip->b ); \
+        if( Cast( tr, expr ) == 0 ) { \
+          ip = instrs + ip->c; \
+          VM_DISPATCH; \
+        } \
+        VM_NEXT; \
+      } \
+      VM_CASE( NAMEJOIN( jnzimm_, name ) ) { \
+        auto l = VM_OPERAND( to, ip->a ); \
+        auto r = VmImm<to>( ip->b ); \
+        if( Cast( tr, expr ) != 0 ) { \
+          ip = instrs + ip->c; \
+          VM_DISPATCH; \
+        } \
+        VM_NEXT; \
+      } \
+
+    VM_BINOPS( CASE )
+    #undef CASE
+
+    #define CASE( name, tr, to, expr ) \
+      VM_CASE( NAMEJOIN( unop_, name ) ) { \
+        auto v = VM_OPERAND( to, ip->b ); \
+        VM_OPERAND( tr, ip->a ) = Cast( tr, expr ); \
+        VM_NEXT; \
+      } \
+
+    VM_UNOPS( CASE )
+    #undef CASE
+
+#if !VM_COMPUTED_GOTO
+      default: UnreachableCrash();
+    }
+#endif
+  }
+
+  #undef VM_CASE
+  #undef VM_DISPATCH
+  #undef VM_NEXT
+  #undef VM_OPERAND
+
+LDone:
+  MemHeapFree( stack.mem );
+}
+
+
+// optimization passes over bc_t, run between Generate and Execute.
+//
+// Generate makes a stackvar for every temporary, each with its own loadconstant or move, and doesn't simplify
+//   anything. these passes clean that up in place, one function at a time, where a function is the run of bcs
+//   from one fncall target up to the next.
+//   unreachable   drop bcs that no path from the function start reaches.
+//   jumpthread    retarget jumps that land on other jumps, turn jumps to rets into rets, and drop jumps to the
+//                 very next bc.
+//   constfold     fold binops, unops and moves of known constants into loadconstants, and resolve jumpzero and
+//                 jumpnotzero of known constants. this only tracks constants within runs of bcs that nothing
+//                 jumps into the middle of.
+//   copyprop      after move a <- b, read b instead of a until either is written. drops moves to themselves.
+//   coalesce      def t; move x <- t;  =>  def x;  when nothing reads t after the move.
+//   deadstore     drop loadconstants, moves, binops and unops whose results are never read.
+//   compact       share frame bytes between stackvars whose live ranges don't overlap, to shrink bytecount_locals.
+// the first six feed each other, so they repeat until nothing changes. compact runs once at the end.
+// compact isn't in c_bcpasses_default: LowerToVm only fuses temporaries whose frame bytes are read once in the
+//   whole function, and stackvars sharing bytes defeat that, which costs ExecuteVm more than the smaller frame buys.
+//
+// liveness is per byte of the frame, since stackvars of different sizes can overlap. fncall rets are passed by
+//   reference, so a fncall counts as reading its ret stackvars, and maybe writing them.
+
+#define BCOPT_PASSES( _x ) \
+  _x( unreachable ) \
+  _x( jumpthread ) \
+  _x( constfold ) \
+  _x( copyprop ) \
+  _x( coalesce ) \
+  _x( deadstore ) \
+  _x( compact ) \
+
+Enumc( bcpass_t )
+{
+  #define CASE( name )   name,
+  BCOPT_PASSES( CASE )
+  #undef CASE
+  COUNT
+};
+Inl slice_t
+StringFromBcpass( bcpass_t pass )
+{
+  switch( pass ) {
+    #define CASE( name )   case bcpass_t::name: return SliceFromCStr( # name );
+    BCOPT_PASSES( CASE )
+    #undef CASE
+    default: UnreachableCrash(); return {};
+  }
+}
+constant u32 c_bcpasses_all = ( 1u << Cast( u32, bcpass_t::COUNT ) ) - 1;
+constant u32 c_bcpasses_default = c_bcpasses_all & ~( 1u << Cast( u32, bcpass_t::compact ) );
+
+struct
+bcoptstats_t
+{
+  idx_t nremoved[ Cast( idx_t, bcpass_t::COUNT ) ];
+  idx_t nrewritten[ Cast( idx_t, bcpass_t::COUNT ) ];
+  u64 tsc[ Cast( idx_t, bcpass_t::COUNT ) ];
+  idx_t nbcs_before;
+  idx_t nbcs_after;
+  idx_t bytecount_locals_before; // summed over all called functions.
+  idx_t bytecount_locals_after;
+  u32 niterations;
+};
+
+struct
+bcfn_t
+{
+  idx_t start;
+  idx_t end;
+  u32 bytecount_incoming; // args and ret ptrs at the start of the frame. MAX_u32 when no fncall targets this.
+  u32 bytecount_locals;
+};
+
+struct bcknown_t { bc_var_t var;  u64 value; };
+struct bccopy_t { bc_var_t dst;  bc_var_t src; };
+struct bcchunk_t { s32 offset;  u32 bytecount;  s32 offset_new;  u32 first;  u32 last; };
+
+constant u8 c_bcmark_target = 1; // some jump lands here.
+constant u8 c_bcmark_fn = 2; // some fncall lands here, or it's the entry point.
+constant u8 c_bcmark_escape = 4; // some jump from another function lands here.
+
+struct
+bcopt_t
+{
+  stack_resizeable_cont_t<bc_t>* code;
+  idx_t* entry_point;
+  pagelist_t* mem; // folded constants, and the fncall locs we rewrite, since those can be shared between fncalls.
+  bcoptstats_t* stats;
+  stack_resizeable_cont_t<bcfn_t> fns;
+  stack_resizeable_cont_t<u8> marks; // per bc.
+  stack_resizeable_cont_t<u8> removed; // per bc. _BcoptSweep drops these.
+  stack_resizeable_cont_t<u64> live; // per bc of the current function, a live-in bitset of nwords.
+  stack_resizeable_cont_t<u64> scratch;
+  idx_t nwords;
+  stack_resizeable_cont_t<idx_t> worklist;
+  stack_resizeable_cont_t<bcknown_t> known;
+  stack_resizeable_cont_t<bccopy_t> copies;
+  stack_resizeable_cont_t<bcchunk_t> chunks;
+  stack_resizeable_cont_t<bcchunk_t*> order;
+};
+
+Inl void
+Init( bcopt_t& opt, stack_resizeable_cont_t<bc_t>* code, idx_t* entry_point, pagelist_t* mem, bcoptstats_t* stats )
+{
+  opt.code = code;
+  opt.entry_point = entry_point;
+  opt.mem = mem;
+  opt.stats = stats;
+  Alloc( opt.fns, 64 );
+  Alloc( opt.marks, code->len + 1 );
+  Alloc( opt.removed, code->len + 1 );
+  Alloc( opt.live, 1024 );
+  Alloc( opt.scratch, 64 );
+  opt.nwords = 0;
+  Alloc( opt.worklist, 256 );
+  Alloc( opt.known, 64 );
+  Alloc( opt.copies, 64 );
+  Alloc( opt.chunks, 256 );
+  Alloc( opt.order, 256 );
+}
+
+Inl void
+Kill( bcopt_t& opt )
+{
+  Free( opt.order );
+  Free( opt.chunks );
+  Free( opt.copies );
+  Free( opt.known );
+  Free( opt.worklist );
+  Free( opt.scratch );
+  Free( opt.live );
+  Free( opt.removed );
+  Free( opt.marks );
+  Free( opt.fns );
+}
+
+Inl u32
+_BcoptBinopBytecount( bc_binop_type_t type )
+{
+  switch( type ) {
+    #define CASE( name, tr, to, expr )   case bc_binop_type_t::name: return sizeof( tr );
+    VM_BINOPS( CASE )
+    #undef CASE
+    default: UnreachableCrash(); return 0;
+  }
+}
+
+Inl u32
+_BcoptUnopBytecount( bc_unop_type_t type )
+{
+  switch( type ) {
+    #define CASE( name, tr, to, expr )   case bc_unop_type_t::name: return sizeof( tr );
+    VM_UNOPS( CASE )
+    #undef CASE
+    default: UnreachableCrash(); return 0;
+  }
+}
+
+// the stackvar a bc overwrites, if any.
+Inl bc_var_t*
+_BcoptDefSlot( bc_t* bc )
+{
+  switch( bc->type ) {
+    case bc_type_t::move: return &bc->move.var_l;
+    case bc_type_t::loadconstant: return &bc->loadconstant.var_l;
+    case bc_type_t::binop: return &bc->binop.var_result;
+    case bc_type_t::unop: return &bc->unop.var_result;
+    default: return 0;
+  }
+}
+
+// the frame bytes a bc overwrites. binops and unops write the full width of their result type, which can be wider
+//   than var_result; e.g. eq_16 writes a u16.
+Inl bool
+_BcoptDef( bc_t* bc, bc_var_t* def )
+{
+  auto slot = _BcoptDefSlot( bc );
+  if( !slot ) {
+    return 0;
+  }
+  *def = *slot;
+  if( bc->type == bc_type_t::binop ) {
+    def->bytecount = MAX( def->bytecount, _BcoptBinopBytecount( bc->binop.type ) );
+  }
+  elif( bc->type == bc_type_t::unop ) {
+    def->bytecount = MAX( def->bytecount, _BcoptUnopBytecount( bc->unop.type ) );
+  }
+  return 1;
+}
+
+// calls fn( slot ) for every stackvar the bc reads by value. fncalls are left to the caller, since their locs can
+//   be shared with other fncalls.
+Templ Inl void
+_BcoptForEachUse( bc_t* bc, T fn )
+{
+  switch( bc->type ) {
+    case bc_type_t::move: { fn( bc->move.var_r ); } break;
+    case bc_type_t::store: { fn( bc->store.var_l );  fn( bc->store.var_r ); } break;
+    case bc_type_t::jumpnotzero:
+    case bc_type_t::jumpzero: { fn( bc->jumpcond.var_cond ); } break;
+    case bc_type_t::binop: { fn( bc->binop.var_l );  fn( bc->binop.var_r ); } break;
+    case bc_type_t::unop: { fn( bc->unop.var ); } break;
+    case bc_type_t::assertvalue: { fn( bc->assertvalue.var_l ); } break;
+    default: break;
+  }
+}
+
+Inl bool
+_BcoptOverlap( bc_var_t a, bc_var_t b )
+{
+  return a.offset_into_scope < b.offset_into_scope + Cast( s32, b.bytecount )  &&
+    b.offset_into_scope < a.offset_into_scope + Cast( s32, a.bytecount );
+}
+
+Inl void
+_BcoptSetBits( u64* bits, bc_var_t var, bool value )
+{
+  For( b, 0, var.bytecount ) {
+    auto offset = Cast( idx_t, var.offset_into_scope ) + b;
+    auto mask = 1ULL << ( offset % 64 );
+    if( value ) {
+      bits[ offset / 64 ] |= mask;
+    } else {
+      bits[ offset / 64 ] &= ~mask;
+    }
+  }
+}
+
+Inl bool
+_BcoptAnyBits( u64* bits, bc_var_t var )
+{
+  For( b, 0, var.bytecount ) {
+    auto offset = Cast( idx_t, var.offset_into_scope ) + b;
+    if( bits[ offset / 64 ] & ( 1ULL << ( offset % 64 ) ) ) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+Inl idx_t
+_BcoptSuccessors( bc_t* code, idx_t i, idx_t* succs )
+{
+  auto bc = code + i;
+  switch( bc->type ) {
+    case bc_type_t::ret: return 0;
+    case bc_type_t::jump: { succs[0] = bc->jump.target; } return 1;
+    case bc_type_t::jumpzero:
+    case bc_type_t::jumpnotzero: { succs[0] = i + 1;  succs[1] = bc->jumpcond.jump.target; } return 2;
+    default: { succs[0] = i + 1; } return 1;
+  }
+}
+
+Inl void*
+_BcoptConstant( bcopt_t& opt, u64 value )
+{
+  auto mem = AddPagelist( *opt.mem, u64, sizeof( u64 ), 1 );
+  *mem = value;
+  return mem;
+}
+
+// Generate and hand-built code can share loc slices between fncalls, so we copy them before rewriting any.
+Inl void
+_BcoptOwnLocs( bcopt_t& opt, bc_t* bc )
+{
+  auto fncall = &bc->fncall;
+  if( fncall->caller_loc_args.len ) {
+    auto args = AddPagelistSlice( *opt.mem, bc_var_t, sizeof( bc_var_t ), fncall->caller_loc_args.len );
+    TMove( args.mem, fncall->caller_loc_args.mem, args.len );
+    fncall->caller_loc_args = args;
+  }
+  if( fncall->caller_loc_rets.len ) {
+    auto rets = AddPagelistSlice( *opt.mem, bc_var_t, sizeof( bc_var_t ), fncall->caller_loc_rets.len );
+    TMove( rets.mem, fncall->caller_loc_rets.mem, rets.len );
+    fncall->caller_loc_rets = rets;
+  }
+}
+
+// finds function boundaries and jump targets. this has to be redone after every sweep.
+NoInl void
+_BcoptFindFunctions( bcopt_t& opt )
+{
+  auto& code = *opt.code;
+  auto& marks = opt.marks;
+  marks.len = 0;
+  Reserve( marks, code.len + 1 );
+  marks.len = code.len + 1;
+  TZero( marks.mem, marks.len );
+  opt.removed.len = 0;
+  Reserve( opt.removed, code.len + 1 );
+  opt.removed.len = code.len + 1;
+  TZero( opt.removed.mem, opt.removed.len );
+
+  marks.mem[ *opt.entry_point ] |= c_bcmark_fn;
+  FORLEN( bc, i, code )
+    switch( bc->type ) {
+      case bc_type_t::fncall: { marks.mem[ bc->fncall.target_fn_bc_start ] |= c_bcmark_fn; } break;
+      case bc_type_t::jump: { marks.mem[ bc->jump.target ] |= c_bcmark_target; } break;
+      case bc_type_t::jumpzero:
+      case bc_type_t::jumpnotzero: { marks.mem[ bc->jumpcond.jump.target ] |= c_bcmark_target; } break;
+      default: break;
+    }
+  }
+
+  auto& fns = opt.fns;
+  fns.len = 0;
+  For( i, 0, code.len ) {
+    if( !i  ||  ( marks.mem[i] & c_bcmark_fn ) ) {
+      if( fns.len ) {
+        fns.mem[ fns.len - 1 ].end = i;
+      }
+      auto fn = AddBack( fns );
+      fn->start = i;
+      fn->end = code.len;
+      fn->bytecount_incoming = MAX_u32;
+      fn->bytecount_locals = 0;
+    }
+  }
+
+  // every fncall of a function has to agree on its frame layout; if they don't, we leave its frame alone.
+  auto FindFn = [&]( idx_t i )
+  {
+    idx_t lo = 0;
+    idx_t hi = fns.len;
+    while( hi - lo > 1 ) {
+      auto mid = ( lo + hi ) / 2;
+      if( fns.mem[mid].start <= i ) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    return fns.mem + lo;
+  };
+  FORLEN( bc, i, code )
+    if( bc->type != bc_type_t::fncall ) {
+      continue;
+    }
+    u32 bytecount_incoming = Cast( u32, bc->fncall.caller_loc_rets.len * sizeof( void* ) );
+    FORLEN( loc, k, bc->fncall.caller_loc_args )
+      bytecount_incoming += loc->bytecount;
+    }
+    auto fn = FindFn( bc->fncall.target_fn_bc_start );
+    if( fn->bytecount_incoming == MAX_u32 ) {
+      fn->bytecount_incoming = bytecount_incoming;
+      fn->bytecount_locals = bc->fncall.bytecount_locals;
+    }
+    elif( fn->bytecount_incoming != bytecount_incoming  ||  fn->bytecount_locals != bc->fncall.bytecount_locals ) {
+      fn->bytecount_incoming = MAX_u32 - 1;
+    }
+  }
+  FORLEN( fn, k, fns )
+    For( i, fn->start, fn->end ) {
+      idx_t succs[2];
+      auto nsuccs = _BcoptSuccessors( code.mem, i, succs );
+      For( s, 0, nsuccs ) {
+        if( succs[s] < fn->start  ||  succs[s] >= fn->end ) {
+          marks.mem[ succs[s] ] |= c_bcmark_escape;
+        }
+      }
+    }
+  }
+}
+
+// drops the removed bcs, and patches up everything that refers to bcs by index.
+NoInl void
+_BcoptSweep( bcopt_t& opt )
+{
+  auto& code = *opt.code;
+  auto map = MemHeapAlloc( idx_t, code.len + 1 );
+  idx_t len = 0;
+  For( i, 0, code.len ) {
+    map[i] = len;
+    if( !opt.removed.mem[i] ) {
+      code.mem[len] = code.mem[i];
+      len += 1;
+    }
+  }
+  map[code.len] = len;
+  code.len = len;
+  FORLEN( bc, i, code )
+    switch( bc->type ) {
+      case bc_type_t::fncall: { bc->fncall.target_fn_bc_start = map[ bc->fncall.target_fn_bc_start ]; } break;
+      case bc_type_t::jump: { bc->jump.target = map[ bc->jump.target ]; } break;
+      case bc_type_t::jumpzero:
+      case bc_type_t::jumpnotzero: { bc->jumpcond.jump.target = map[ bc->jumpcond.jump.target ]; } break;
+      default: break;
+    }
+  }
+  *opt.entry_point = map[ *opt.entry_point ];
+  MemHeapFree( map );
+  _BcoptFindFunctions( opt );
+}
+
+// the union of the live-in sets of bc i's successors. anywhere outside the function has everything live.
+Inl void
+_BcoptLiveOut( bcopt_t& opt, bcfn_t* fn, idx_t i, u64* out )
+{
+  auto nwords = opt.nwords;
+  TZero( out, nwords );
+  idx_t succs[2];
+  auto nsuccs = _BcoptSuccessors( opt.code->mem, i, succs );
+  For( s, 0, nsuccs ) {
+    auto succ = succs[s];
+    if( succ < fn->start  ||  succ >= fn->end ) {
+      TSet( out, nwords, MAX_u64 );
+      return;
+    }
+    auto live = opt.live.mem + ( succ - fn->start ) * nwords;
+    For( w, 0, nwords ) {
+      out[w] |= live[w];
+    }
+  }
+}
+
+// live-in sets for every bc of fn, over the frame bytes that fn touches. removed bcs are skipped over.
+NoInl void
+_BcoptLiveness( bcopt_t& opt, bcfn_t* fn )
+{
+  auto code = opt.code->mem;
+  idx_t nbytes = 0;
+  auto Extent = [&]( bc_var_t var )
+  {
+    AssertCrash( var.offset_into_scope >= 0 );
+    nbytes = MAX( nbytes, Cast( idx_t, var.offset_into_scope ) + var.bytecount );
+  };
+  For( i, fn->start, fn->end ) {
+    _VmForEachRead( code + i, Extent );
+    bc_var_t def;
+    if( _BcoptDef( code + i, &def ) ) {
+      Extent( def );
+    }
+  }
+  auto nwords = MAX( Cast( idx_t, 1 ), ( nbytes + 63 ) / 64 );
+  opt.nwords = nwords;
+  auto& live = opt.live;
+  live.len = 0;
+  Reserve( live, ( fn->end - fn->start ) * nwords );
+  live.len = ( fn->end - fn->start ) * nwords;
+  TZero( live.mem, live.len );
+  opt.scratch.len = 0;
+  Reserve( opt.scratch, nwords );
+  auto out = opt.scratch.mem;
+
+  // backwards, so straight-line code converges in one sweep; loops take another sweep per nesting level.
+  Forever {
+    bool changed = 0;
+    ReverseFor( i, fn->start, fn->end ) {
+      _BcoptLiveOut( opt, fn, i, out );
+      if( !opt.removed.mem[i] ) {
+        bc_var_t def;
+        if( _BcoptDef( code + i, &def ) ) {
+          _BcoptSetBits( out, def, 0 );
+        }
+        _VmForEachRead( code + i, [&]( bc_var_t var ) { _BcoptSetBits( out, var, 1 ); } );
+      }
+      auto live_in = live.mem + ( i - fn->start ) * nwords;
+      if( !MemEqual( live_in, out, nwords * sizeof( u64 ) ) ) {
+        TMove( live_in, out, nwords );
+        changed = 1;
+      }
+    }
+    if( !changed ) {
+      break;
+    }
+  }
+}
+
+NoInl void
+_BcoptUnreachable( bcopt_t& opt, bcfn_t* fn )
+{
+  auto code = opt.code->mem;
+  auto removed = opt.removed.mem;
+  auto& worklist = opt.worklist;
+  worklist.len = 0;
+  For( i, fn->start, fn->end ) {
+    removed[i] = 1;
+    if( i == fn->start  ||  ( opt.marks.mem[i] & c_bcmark_escape ) ) {
+      *AddBack( worklist ) = i;
+    }
+  }
+  while( worklist.len ) {
+    auto i = worklist.mem[ worklist.len - 1 ];
+    worklist.len -= 1;
+    if( i < fn->start  ||  i >= fn->end  ||  !removed[i] ) {
+      continue;
+    }
+    removed[i] = 0;
+    idx_t succs[2];
+    auto nsuccs = _BcoptSuccessors( code, i, succs );
+    For( s, 0, nsuccs ) {
+      *AddBack( worklist ) = succs[s];
+    }
+  }
+  For( i, fn->start, fn->end ) {
+    opt.stats->nremoved[ Cast( idx_t, bcpass_t::unreachable ) ] += removed[i];
+  }
+}
+
+NoInl void
+_BcoptJumpthread( bcopt_t& opt, bcfn_t* fn )
+{
+  auto code = opt.code->mem;
+  auto code_len = opt.code->len;
+  auto& nremoved = opt.stats->nremoved[ Cast( idx_t, bcpass_t::jumpthread ) ];
+  auto& nrewritten = opt.stats->nrewritten[ Cast( idx_t, bcpass_t::jumpthread ) ];
+  For( i, fn->start, fn->end ) {
+    auto bc = code + i;
+    idx_t* target;
+    switch( bc->type ) {
+      case bc_type_t::jump: { target = &bc->jump.target; } break;
+      case bc_type_t::jumpzero:
+      case bc_type_t::jumpnotzero: { target = &bc->jumpcond.jump.target; } break;
+      default: continue;
+    }
+    // follow chains of jumps. a jumpcond that lands on another test of the same stackvar knows which way that
+    //   one goes too, since nothing runs in between. the hop limit is for jumps to themselves.
+    auto t = *target;
+    constant idx_t c_max_hops = 16;
+    For( hop, 0, c_max_hops ) {
+      if( t >= code_len ) {
+        break;
+      }
+      auto next = code + t;
+      if( next->type == bc_type_t::jump ) {
+        t = next->jump.target;
+        continue;
+      }
+      if( bc->type != bc_type_t::jump  &&
+          ( next->type == bc_type_t::jumpzero  ||  next->type == bc_type_t::jumpnotzero )  &&
+          _VmSlotsEqual( next->jumpcond.var_cond, bc->jumpcond.var_cond ) )
+      {
+        t = next->type == bc->type  ?  next->jumpcond.jump.target  :  t + 1;
+        continue;
+      }
+      break;
+    }
+    if( bc->type == bc_type_t::jump  &&  t < code_len  &&  code[t].type == bc_type_t::ret ) {
+      bc->type = bc_type_t::ret;
+      nrewritten += 1;
+      continue;
+    }
+    if( t == i + 1 ) {
+      opt.removed.mem[i] = 1;
+      nremoved += 1;
+      continue;
+    }
+    if( t != *target ) {
+      *target = t;
+      nrewritten += 1;
+    }
+  }
+}
+
+// computes a binop of constants, the way Execute would. we leave alone anything that's undefined or traps at
+//   runtime: integer division by zero, signed division overflow, and shifts past the width. we also leave alone
+//   stackvars whose bytecounts don't match the op's types, since those read or write their neighbors.
+Inl bool
+_BcoptFoldBinop( bc_binop_t* binop, u64 bits_l, u64 bits_r, u64* result )
+{
+  auto type = binop->type;
+  bool divides = 0;
+  bool shifts = 0;
+  switch( type ) {
+    #define CASE( _op ) \
+      case bc_binop_type_t::NAMEJOIN( _op, _u8  ): \
+      case bc_binop_type_t::NAMEJOIN( _op, _u16 ): \
+      case bc_binop_type_t::NAMEJOIN( _op, _u32 ): \
+      case bc_binop_type_t::NAMEJOIN( _op, _u64 ): \
+      case bc_binop_type_t::NAMEJOIN( _op, _s8  ): \
+      case bc_binop_type_t::NAMEJOIN( _op, _s16 ): \
+      case bc_binop_type_t::NAMEJOIN( _op, _s32 ): \
+      case bc_binop_type_t::NAMEJOIN( _op, _s64 ):
+    CASE( div )
+    CASE( mod )
+    #undef CASE
+      divides = 1;
+      break;
+    #define CASE( _op ) \
+      case bc_binop_type_t::NAMEJOIN( _op, _8  ): \
+      case bc_binop_type_t::NAMEJOIN( _op, _16 ): \
+      case bc_binop_type_t::NAMEJOIN( _op, _32 ): \
+      case bc_binop_type_t::NAMEJOIN( _op, _64 ):
+    CASE( shiftl )
+    CASE( shiftrzero )
+    CASE( shiftrsign )
+    #undef CASE
+      shifts = 1;
+      break;
+    default: break;
+  }
+  switch( type ) {
+    #define CASE( name, tr, to, expr ) \
+      case bc_binop_type_t::name: { \
+        if( binop->var_l.bytecount != sizeof( to )  ||  binop->var_r.bytecount != sizeof( to )  || \
+            binop->var_result.bytecount != sizeof( tr ) ) \
+        { \
+          return 0; \
+        } \
+        to l; \
+        to r; \
+        Memmove( &l, &bits_l, sizeof( to ) ); \
+        Memmove( &r, &bits_r, sizeof( to ) ); \
+        if( divides  &&  ( r == 0  ||  ( std::is_signed<to>::value  &&  r == Cast( to, -1 ) ) ) ) { \
+          return 0; \
+        } \
+        if( shifts  &&  Cast( u64, r ) >= 8 * sizeof( to ) ) { \
+          return 0; \
+        } \
+        tr value = Cast( tr, expr ); \
+        *result = 0; \
+        Memmove( result, &value, sizeof( tr ) ); \
+      } return 1;
+    VM_BINOPS( CASE )
+    #undef CASE
+    default: UnreachableCrash(); return 0;
+  }
+}
+
+Inl bool
+_BcoptFoldUnop( bc_unop_t* unop, u64 bits, u64* result )
+{
+  switch( unop->type ) {
+    #define CASE( name, tr, to, expr ) \
+      case bc_unop_type_t::name: { \
+        if( unop->var.bytecount != sizeof( to )  ||  unop->var_result.bytecount != sizeof( tr ) ) { \
+          return 0; \
+        } \
+        to v; \
+        Memmove( &v, &bits, sizeof( to ) ); \
+        tr value = Cast( tr, expr ); \
+        *result = 0; \
+        Memmove( result, &value, sizeof( tr ) ); \
+      } return 1;
+    VM_UNOPS( CASE )
+    #undef CASE
+    default: UnreachableCrash(); return 0;
+  }
+}
+
+NoInl void
+_BcoptConstfold( bcopt_t& opt, bcfn_t* fn )
+{
+  auto code = opt.code->mem;
+  auto& nremoved = opt.stats->nremoved[ Cast( idx_t, bcpass_t::constfold ) ];
+  auto& nrewritten = opt.stats->nrewritten[ Cast( idx_t, bcpass_t::constfold ) ];
+  auto& known = opt.known;
+  known.len = 0;
+  auto Lookup = [&]( bc_var_t var, u64* value )
+  {
+    FORLEN( k, idx, known )
+      if( _VmSlotsEqual( k->var, var ) ) {
+        *value = k->value;
+        return 1;
+      }
+    }
+    return 0;
+  };
+  auto Forget = [&]( bc_var_t var )
+  {
+    for( idx_t k = 0;  k < known.len;  ) {
+      if( _BcoptOverlap( known.mem[k].var, var ) ) {
+        known.mem[k] = known.mem[ known.len - 1 ];
+        known.len -= 1;
+      } else {
+        k += 1;
+      }
+    }
+  };
+  For( i, fn->start, fn->end ) {
+    if( opt.marks.mem[i] & ( c_bcmark_target | c_bcmark_escape ) ) {
+      known.len = 0;
+    }
+    auto bc = code + i;
+    u64 l;
+    u64 r;
+    u64 value;
+    switch( bc->type ) {
+      case bc_type_t::binop: {
+        auto binop = bc->binop;
+        if( Lookup( binop.var_l, &l )  &&  Lookup( binop.var_r, &r )  &&  _BcoptFoldBinop( &binop, l, r, &value ) ) {
+          bc->type = bc_type_t::loadconstant;
+          bc->loadconstant = { binop.var_result, _BcoptConstant( opt, value ) };
+          nrewritten += 1;
+        }
+      } break;
+      case bc_type_t::unop: {
+        auto unop = bc->unop;
+        if( Lookup( unop.var, &l )  &&  _BcoptFoldUnop( &unop, l, &value ) ) {
+          bc->type = bc_type_t::loadconstant;
+          bc->loadconstant = { unop.var_result, _BcoptConstant( opt, value ) };
+          nrewritten += 1;
+        }
+      } break;
+      case bc_type_t::move: {
+        auto move = bc->move;
+        if( Lookup( move.var_r, &value ) ) {
+          bc->type = bc_type_t::loadconstant;
+          bc->loadconstant = { move.var_l, _BcoptConstant( opt, value ) };
+          nrewritten += 1;
+        }
+      } break;
+      case bc_type_t::jumpzero:
+      case bc_type_t::jumpnotzero: {
+        if( Lookup( bc->jumpcond.var_cond, &value ) ) {
+          if( ( bc->type == bc_type_t::jumpzero )  ==  ( value == 0 ) ) {
+            auto target = bc->jumpcond.jump.target;
+            bc->type = bc_type_t::jump;
+            bc->jump.target = target;
+            nrewritten += 1;
+          } else {
+            opt.removed.mem[i] = 1;
+            nremoved += 1;
+          }
+        }
+      } break;
+      default: break;
+    }
+
+    bc_var_t def;
+    if( _BcoptDef( bc, &def ) ) {
+      Forget( def );
+    }
+    if( bc->type == bc_type_t::fncall ) {
+      FORLEN( loc, k, bc->fncall.caller_loc_rets )
+        Forget( *loc );
+      }
+    }
+    auto var = bc->loadconstant.var_l;
+    if( bc->type == bc_type_t::loadconstant  &&  var.bytecount  &&  var.bytecount <= sizeof( u64 ) ) {
+      auto k = AddBack( known );
+      k->var = var;
+      k->value = 0;
+      Memmove( &k->value, bc->loadconstant.mem, var.bytecount );
+    }
+  }
+}
+
+NoInl void
+_BcoptCopyprop( bcopt_t& opt, bcfn_t* fn )
+{
+  auto code = opt.code->mem;
+  auto& nremoved = opt.stats->nremoved[ Cast( idx_t, bcpass_t::copyprop ) ];
+  auto& nrewritten = opt.stats->nrewritten[ Cast( idx_t, bcpass_t::copyprop ) ];
+  auto& copies = opt.copies;
+  copies.len = 0;
+  auto Source = [&]( bc_var_t var ) -> bccopy_t*
+  {
+    FORLEN( copy, k, copies )
+      if( _VmSlotsEqual( copy->dst, var ) ) {
+        return copy;
+      }
+    }
+    return 0;
+  };
+  auto Replace = [&]( bc_var_t& var )
+  {
+    if( auto copy = Source( var ) ) {
+      var = copy->src;
+      nrewritten += 1;
+    }
+  };
+  auto Forget = [&]( bc_var_t var )
+  {
+    for( idx_t k = 0;  k < copies.len;  ) {
+      if( _BcoptOverlap( copies.mem[k].dst, var )  ||  _BcoptOverlap( copies.mem[k].src, var ) ) {
+        copies.mem[k] = copies.mem[ copies.len - 1 ];
+        copies.len -= 1;
+      } else {
+        k += 1;
+      }
+    }
+  };
+  For( i, fn->start, fn->end ) {
+    if( opt.marks.mem[i] & ( c_bcmark_target | c_bcmark_escape ) ) {
+      copies.len = 0;
+    }
+    auto bc = code + i;
+    if( bc->type == bc_type_t::fncall ) {
+      // args are by value, so they can read the source instead. rets are by reference, so they can't.
+      bool any = 0;
+      FORLEN( loc, k, bc->fncall.caller_loc_args )
+        any |= !!Source( *loc );
+      }
+      if( any ) {
+        _BcoptOwnLocs( opt, bc );
+        FORLEN( loc, k, bc->fncall.caller_loc_args )
+          Replace( *loc );
+        }
+      }
+      FORLEN( loc, k, bc->fncall.caller_loc_rets )
+        Forget( *loc );
+      }
+      continue;
+    }
+    _BcoptForEachUse( bc, Replace );
+    if( bc->type == bc_type_t::move  &&  _VmSlotsEqual( bc->move.var_l, bc->move.var_r ) ) {
+      opt.removed.mem[i] = 1;
+      nremoved += 1;
+      continue;
+    }
+    bc_var_t def;
+    if( _BcoptDef( bc, &def ) ) {
+      Forget( def );
+    }
+    if( bc->type == bc_type_t::move  &&  !_BcoptOverlap( bc->move.var_l, bc->move.var_r ) ) {
+      *AddBack( copies ) = { bc->move.var_l, bc->move.var_r };
+    }
+  }
+}
+
+NoInl void
+_BcoptCoalesce( bcopt_t& opt, bcfn_t* fn )
+{
+  auto code = opt.code->mem;
+  auto& nremoved = opt.stats->nremoved[ Cast( idx_t, bcpass_t::coalesce ) ];
+  _BcoptLiveness( opt, fn );
+  auto out = opt.scratch.mem;
+  for( idx_t i = fn->start;  i + 1 < fn->end;  ++i ) {
+    auto bc = code + i;
+    auto move = code + i + 1;
+    if( move->type != bc_type_t::move  ||  ( opt.marks.mem[i + 1] & ( c_bcmark_target | c_bcmark_escape ) ) ) {
+      continue;
+    }
+    bc_var_t def;
+    if( !_BcoptDef( bc, &def )  ||  !_VmSlotsEqual( def, move->move.var_r ) ) {
+      continue;
+    }
+    auto var = move->move.var_l;
+    if( _BcoptOverlap( var, def ) ) {
+      continue;
+    }
+    // the def can read var itself, since operands are read before the result is written. but only all of it.
+    bool reads_var = 0;
+    _BcoptForEachUse( bc, [&]( bc_var_t& use ) {
+      reads_var |= _BcoptOverlap( use, var )  &&  !_VmSlotsEqual( use, var );
+    });
+    if( reads_var ) {
+      continue;
+    }
+    _BcoptLiveOut( opt, fn, i + 1, out );
+    if( _BcoptAnyBits( out, def ) ) {
+      continue;
+    }
+    *_BcoptDefSlot( bc ) = var;
+    opt.removed.mem[i + 1] = 1;
+    nremoved += 1;
+    i += 1;
+  }
+}
+
+NoInl void
+_BcoptDeadstore( bcopt_t& opt, bcfn_t* fn )
+{
+  auto code = opt.code->mem;
+  auto& nremoved = opt.stats->nremoved[ Cast( idx_t, bcpass_t::deadstore ) ];
+  Forever {
+    _BcoptLiveness( opt, fn );
+    auto out = opt.scratch.mem;
+    idx_t ndead = 0;
+    For( i, fn->start, fn->end ) {
+      bc_var_t def;
+      if( opt.removed.mem[i]  ||  !_BcoptDef( code + i, &def ) ) {
+        continue;
+      }
+      _BcoptLiveOut( opt, fn, i, out );
+      if( !_BcoptAnyBits( out, def ) ) {
+        opt.removed.mem[i] = 1;
+        ndead += 1;
+      }
+    }
+    nremoved += ndead;
+    if( !ndead ) {
+      break;
+    }
+  }
+}
+
+NoInl void
+_BcoptCompact( bcopt_t& opt, bcfn_t* fn )
+{
+  // skip the entry point, and anything whose fncalls disagree on the frame layout.
+  if( fn->bytecount_incoming >= MAX_u32 - 1 ) {
+    return;
+  }
+  auto code = opt.code->mem;
+  auto locals_start = Cast( s32, fn->bytecount_incoming );
+  auto& chunks = opt.chunks;
+  chunks.len = 0;
+  bool straddles = 0;
+  auto AddRange = [&]( bc_var_t var )
+  {
+    if( var.offset_into_scope >= locals_start ) {
+      *AddBack( chunks ) = { var.offset_into_scope, var.bytecount, 0, MAX_u32, 0 };
+    }
+    elif( var.offset_into_scope + Cast( s32, var.bytecount ) > locals_start ) {
+      straddles = 1;
+    }
+  };
+  For( i, fn->start, fn->end ) {
+    _VmForEachRead( code + i, AddRange );
+    bc_var_t def;
+    if( _BcoptDef( code + i, &def ) ) {
+      AddRange( def );
+    }
+  }
+  if( straddles  ||  !chunks.len ) {
+    return;
+  }
+
+  // overlapping stackvars, e.g. a struct and its fields, move together as one chunk.
+  std::sort(
+    chunks.mem,
+    chunks.mem + chunks.len,
+    []( const bcchunk_t& a, const bcchunk_t& b ) { return a.offset < b.offset; }
+    );
+  idx_t nchunks = 0;
+  FORLEN( chunk, k, chunks )
+    auto prev = chunks.mem + nchunks - 1;
+    if( nchunks  &&  chunk->offset < prev->offset + Cast( s32, prev->bytecount ) ) {
+      auto end = MAX( prev->offset + Cast( s32, prev->bytecount ), chunk->offset + Cast( s32, chunk->bytecount ) );
+      prev->bytecount = Cast( u32, end - prev->offset );
+    } else {
+      chunks.mem[nchunks] = *chunk;
+      nchunks += 1;
+    }
+  }
+  chunks.len = nchunks;
+  auto FindChunk = [&]( s32 offset )
+  {
+    idx_t lo = 0;
+    idx_t hi = chunks.len;
+    while( hi - lo > 1 ) {
+      auto mid = ( lo + hi ) / 2;
+      if( chunks.mem[mid].offset <= offset ) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    return chunks.mem + lo;
+  };
+
+  // a chunk's live range covers every bc where any of its bytes is live-in, or written.
+  // liveness already runs around loops, so a plain [ first, last ] interval over bc indices is conservative.
+  _BcoptLiveness( opt, fn );
+  For( i, fn->start, fn->end ) {
+    auto idx = Cast( u32, i - fn->start );
+    auto live = opt.live.mem + ( i - fn->start ) * opt.nwords;
+    auto Touch = [&]( bcchunk_t* chunk )
+    {
+      chunk->first = MIN( chunk->first, idx );
+      chunk->last = MAX( chunk->last, idx );
+    };
+    FORLEN( chunk, k, chunks )
+      if( _BcoptAnyBits( live, { chunk->offset, chunk->bytecount } ) ) {
+        Touch( chunk );
+      }
+    }
+    bc_var_t def;
+    if( _BcoptDef( code + i, &def )  &&  def.offset_into_scope >= locals_start ) {
+      Touch( FindChunk( def.offset_into_scope ) );
+    }
+  }
+
+  // first fit, in order of live range start.
+  auto& order = opt.order;
+  order.len = 0;
+  FORLEN( chunk, k, chunks )
+    if( chunk->first == MAX_u32 ) {
+      chunk->first = 0;
+    }
+    *AddBack( order ) = chunk;
+  }
+  std::sort(
+    order.mem,
+    order.mem + order.len,
+    []( bcchunk_t* a, bcchunk_t* b ) { return a->first < b->first; }
+    );
+  s32 end = locals_start;
+  FORLEN( pchunk, k, order )
+    auto chunk = *pchunk;
+    idx_t align = 1;
+    while( align < chunk->bytecount  &&  align < 8 ) {
+      align *= 2;
+    }
+    auto offset = Cast( s32, RoundUpToMultipleOfPowerOf2( Cast( idx_t, locals_start ), align ) );
+    Forever {
+      bool moved = 0;
+      For( p, 0, k ) {
+        auto placed = order.mem[p];
+        if( placed->first <= chunk->last  &&  chunk->first <= placed->last  &&
+            offset < placed->offset_new + Cast( s32, placed->bytecount )  &&
+            placed->offset_new < offset + Cast( s32, chunk->bytecount ) )
+        {
+          offset = Cast( s32, RoundUpToMultipleOfPowerOf2( Cast( idx_t, placed->offset_new + placed->bytecount ), align ) );
+          moved = 1;
+        }
+      }
+      if( !moved ) {
+        break;
+      }
+    }
+    chunk->offset_new = offset;
+    end = MAX( end, offset + Cast( s32, chunk->bytecount ) );
+  }
+  auto bytecount_locals = Cast( u32, RoundUpToMultipleOfPowerOf2( Cast( idx_t, end ), 8 ) - locals_start );
+  if( bytecount_locals >= fn->bytecount_locals ) {
+    return;
+  }
+
+  auto Rewrite = [&]( bc_var_t& var )
+  {
+    if( var.offset_into_scope >= locals_start ) {
+      auto chunk = FindChunk( var.offset_into_scope );
+      var.offset_into_scope += chunk->offset_new - chunk->offset;
+    }
+  };
+  auto& nrewritten = opt.stats->nrewritten[ Cast( idx_t, bcpass_t::compact ) ];
+  For( i, fn->start, fn->end ) {
+    auto bc = code + i;
+    if( bc->type == bc_type_t::fncall ) {
+      _BcoptOwnLocs( opt, bc );
+      FORLEN( loc, k, bc->fncall.caller_loc_args )
+        Rewrite( *loc );
+      }
+      FORLEN( loc, k, bc->fncall.caller_loc_rets )
+        Rewrite( *loc );
+      }
+      continue;
+    }
+    _BcoptForEachUse( bc, Rewrite );
+    if( auto slot = _BcoptDefSlot( bc ) ) {
+      Rewrite( *slot );
+    }
+    nrewritten += 1;
+  }
+  FORLEN( bc, i, *opt.code )
+    if( bc->type == bc_type_t::fncall  &&  bc->fncall.target_fn_bc_start == fn->start ) {
+      bc->fncall.bytecount_locals = bytecount_locals;
+    }
+  }
+  fn->bytecount_locals = bytecount_locals;
+}
+
+// passes is a bitmask of ( 1 << bcpass_t ), so we can measure each pass on its own.
+NoInl void
+OptimizeCode(
+  stack_resizeable_cont_t<bc_t>* code,
+  idx_t* entry_point,
+  pagelist_t* mem,
+  u32 passes,
+  bcoptstats_t* stats
+  )
+{
+  *stats = {};
+  stats->nbcs_before = code->len;
+  stats->nbcs_after = code->len;
+  if( !code->len ) {
+    return;
+  }
+  bcopt_t opt;
+  Init( opt, code, entry_point, mem, stats );
+  _BcoptFindFunctions( opt );
+  auto SumLocals = [&]()
+  {
+    idx_t sum = 0;
+    FORLEN( fn, k, opt.fns )
+      if( fn->bytecount_incoming < MAX_u32 - 1 ) {
+        sum += fn->bytecount_locals;
+      }
+    }
+    return sum;
+  };
+  stats->bytecount_locals_before = SumLocals();
+
+  auto Run = [&]( bcpass_t pass, void (*fn_pass)( bcopt_t&, bcfn_t* ) )
+  {
+    if( !( passes & ( 1u << Cast( u32, pass ) ) ) ) {
+      return;
+    }
+    auto t0 = TimeTSC();
+    FORLEN( fn, k, opt.fns )
+      fn_pass( opt, fn );
+    }
+    _BcoptSweep( opt );
+    stats->tsc[ Cast( idx_t, pass ) ] += TimeTSC() - t0;
+  };
+  auto NumChanges = [&]()
+  {
+    idx_t nchanges = 0;
+    For( pass, 0, Cast( idx_t, bcpass_t::COUNT ) ) {
+      nchanges += stats->nremoved[pass] + stats->nrewritten[pass];
+    }
+    return nchanges;
+  };
+  constant u32 c_max_iterations = 16;
+  Fori( u32, iteration, 0, c_max_iterations ) {
+    auto nchanges = NumChanges();
+    Run( bcpass_t::unreachable, _BcoptUnreachable );
+    Run( bcpass_t::jumpthread, _BcoptJumpthread );
+    Run( bcpass_t::constfold, _BcoptConstfold );
+    Run( bcpass_t::copyprop, _BcoptCopyprop );
+    Run( bcpass_t::coalesce, _BcoptCoalesce );
+    Run( bcpass_t::deadstore, _BcoptDeadstore );
+    stats->niterations += 1;
+    if( NumChanges() == nchanges ) {
+      break;
+    }
+  }
+  Run( bcpass_t::compact, _BcoptCompact );
+
+  stats->bytecount_locals_after = SumLocals();
+  stats->nbcs_after = code->len;
+  Kill( opt );
+}
+
+NoInl void
+PrintBcoptStats(
+  stack_resizeable_cont_t<u8>* out,
+  bcoptstats_t* stats
+  )
+{
+  AddBackString( out, "optimized bcs: " );
+  PrintU64( out, stats->nbcs_before );
+  AddBackString( out, " -> " );
+  PrintU64( out, stats->nbcs_after );
+  AddBackString( out, ", bytecount_locals: " );
+  PrintU64( out, stats->bytecount_locals_before );
+  AddBackString( out, " -> " );
+  PrintU64( out, stats->bytecount_locals_after );
+  AddBackString( out, ", iterations: " );
+  PrintU64( out, stats->niterations );
+  AddBackString( out, "\n" );
+  For( pass, 0, Cast( idx_t, bcpass_t::COUNT ) ) {
+    AddBackString( out, "  " );
+    AddBackString( out, StringFromBcpass( Cast( bcpass_t, pass ) ) );
+    AddBackString( out, ": removed " );
+    PrintU64( out, stats->nremoved[pass] );
+    AddBackString( out, ", rewrote " );
+    PrintU64( out, stats->nrewritten[pass] );
+    AddBackString( out, "\n" );
+  }
+}
+
+
+
+// x86-64 codegen for bc_t, following the system v abi. we only build it for linux x64, since win64 has different
+//   arg registers and wants shadow space on every call, and other targets aren't x64 at all. elsewhere, callers
+//   run ExecuteVm instead.
+#if defined(__x86_64__)  &&  defined(__linux__)
+  #define JC3_JIT 1
+#else
+  #define JC3_JIT 0
+#endif
+
+#if JC3_JIT
+
+// every bc function becomes a native function taking its frame pointer in rdi, which lives in rbx for the
+//   duration of the function. the first few scalar args also go in registers, as system v does; the callee
+//   moves them into their homes in the prologue. the rest are copied into the callee frame, like Execute.
+//   rets are still by reference, which is how system v returns anything through memory anyways.
+// scalar stackvars that never have their address taken, and never alias a differently-sized stackvar, get a
+//   register via linear scan over their live ranges. we only hand out callee-saved registers, so values
+//   survive fncalls and helper calls without any spilling around them.
+// the code is generated into a plain buffer, then copied into a read-write mapping that we flip to
+//   read-execute before running; it's never writable and executable at the same time.
+
+Enumc( jitreg_t )
+{
+  rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+  r8, r9, r10, r11, r12, r13, r14, r15,
+};
+constant u8 c_jitreg_none = MAX_u8;
+
+// the registers linear scan hands out. rbx is the frame pointer.
+constant jitreg_t c_jit_allocatable[] = {
+  jitreg_t::rbp,
+  jitreg_t::r12,
+  jitreg_t::r13,
+  jitreg_t::r14,
+  jitreg_t::r15,
+};
+
+// system v integer arg registers, after rdi which holds the callee frame.
+constant jitreg_t c_jit_argregs[] = {
+  jitreg_t::rsi,
+  jitreg_t::rdx,
+  jitreg_t::rcx,
+  jitreg_t::r8,
+  jitreg_t::r9,
+};
+
+Enumc( jitbinop_t )
+{
+  add,
+  sub,
+  mul,
+  andbits, // logical and, for floats.
+  orbits, // logical or, for floats.
+  eq,
+  noteq,
+  shiftl,
+  shiftr,
+  div,
+  mod,
+  pow,
+  gt,
+  gteq,
+  lt,
+  lteq,
+};
+
+struct
+jitinterval_t
+{
+  s32 offset_into_scope;
+  u32 bytecount;
+  u32 start;
+  u32 end;
+};
+
+struct
+jitfixup_t
+{
+  idx_t pos; // of the rel32 to patch.
+  idx_t target; // bc idx.
+};
+
+struct
+jitcode_t
+{
+  stack_resizeable_cont_t<u8> bytes;
+  u8* exec; // read-execute mapping of bytes, once we're done.
+  idx_t exec_len;
+  void (*entry)( u8* frame );
+  u32 nslots; // # of scalar stackvars.
+  u32 nslots_allocated; // # that got a register.
+};
+
+Inl void
+Init( jitcode_t& jit )
+{
+  Alloc( jit.bytes, 4096 );
+  jit.exec = 0;
+  jit.exec_len = 0;
+  jit.entry = 0;
+  jit.nslots = 0;
+  jit.nslots_allocated = 0;
+}
+
+Inl void
+Kill( jitcode_t& jit )
+{
+  if( jit.exec ) {
+    int r = munmap( jit.exec, jit.exec_len );
+    AssertWarn( !r );
+  }
+  Free( jit.bytes );
+}
+
+NoInl void
+JitHelperMemmove( void* dst, void* src, idx_t bytecount )
+{
+  Memmove( dst, src, bytecount );
+}
+NoInl u8
+JitHelperMemIsZero( void* src, idx_t bytecount )
+{
+  return MemIsZero( src, bytecount );
+}
+NoInl void
+JitHelperAssertValue( void* expected, void* value, idx_t bytecount )
+{
+  AssertCrash( MemEqual( expected, value, bytecount ) );
+}
+NoInl f32 JitHelperMod32( f32 a, f32 b ) { return Mod32( a, b ); }
+NoInl f64 JitHelperMod64( f64 a, f64 b ) { return Mod64( a, b ); }
+NoInl f32 JitHelperPow32( f32 a, f32 b ) { return Pow32( a, b ); }
+NoInl f64 JitHelperPow64( f64 a, f64 b ) { return Pow64( a, b ); }
+
+Inl void
+_JitByte( jitcode_t& jit, u8 b )
+{
+  *AddBack( jit.bytes ) = b;
+}
+Inl void
+_JitU32( jitcode_t& jit, u32 v )
+{
+  Memmove( AddBack( jit.bytes, sizeof( v ) ), &v, sizeof( v ) );
+}
+Inl void
+_JitU64( jitcode_t& jit, u64 v )
+{
+  Memmove( AddBack( jit.bytes, sizeof( v ) ), &v, sizeof( v ) );
+}
+
+// emits [prefix] [rex] op modrm [disp32].
+// op is 1 to 3 bytes, most significant first. reg is the modrm.reg field ( a register, or an opcode extension ).
+// with mem, rm is the base register, and we always use the disp32 form. otherwise rm is a register.
+// byte_regs says this operates on 8bit registers, where 4..7 mean spl/bpl/sil/dil only with a rex prefix.
+Inl void
+_JitInstr(
+  jitcode_t& jit,
+  u8 prefix,
+  bool w,
+  bool byte_regs,
+  u32 op,
+  u8 reg,
+  u8 rm,
+  bool mem,
+  s32 disp
+  )
+{
+  if( prefix ) {
+    _JitByte( jit, prefix );
+  }
+  u8 rex = 0x40 | ( w << 3 ) | ( ( reg >> 3 ) << 2 ) | ( rm >> 3 );
+  auto needs_rex = byte_regs  &&  ( ( 4 <= reg  &&  reg < 8 )  ||  ( !mem  &&  4 <= rm  &&  rm < 8 ) );
+  if( rex != 0x40  ||  needs_rex ) {
+    _JitByte( jit, rex );
+  }
+  if( op > 0xFFFF ) {
+    _JitByte( jit, Cast( u8, op >> 16 ) );
+  }
+  if( op > 0xFF ) {
+    _JitByte( jit, Cast( u8, op >> 8 ) );
+  }
+  _JitByte( jit, Cast( u8, op ) );
+  if( mem ) {
+    AssertCrash( ( rm & 7 ) != 4 ); // rsp and r12 need a sib byte, which we never generate.
+    _JitByte( jit, 0x80 | ( ( reg & 7 ) << 3 ) | ( rm & 7 ) );
+    _JitU32( jit, Cast( u32, disp ) );
+  } else {
+    _JitByte( jit, 0xC0 | ( ( reg & 7 ) << 3 ) | ( rm & 7 ) );
+  }
+}
+
+// dst <- the bytecount value at [base + disp], or in register src when !mem, zero or sign extended to 64 bits.
+Inl void
+_JitLoadRaw( jitcode_t& jit, u8 dst, u32 bytecount, bool sign, u8 src, bool mem, s32 disp )
+{
+  switch( bytecount ) {
+    case 1: _JitInstr( jit, 0, sign, 1, sign  ?  0x0FBE  :  0x0FB6, dst, src, mem, disp ); break;
+    case 2: _JitInstr( jit, 0, sign, 0, sign  ?  0x0FBF  :  0x0FB7, dst, src, mem, disp ); break;
+    case 4: _JitInstr( jit, 0, sign, 0, sign  ?  0x63  :  0x8B, dst, src, mem, disp ); break;
+    case 8: _JitInstr( jit, 0, 1, 0, 0x8B, dst, src, mem, disp ); break;
+    default: UnreachableCrash();
+  }
+}
+
+// [base + disp] <- the low bytecount bytes of src.
+Inl void
+_JitStoreMem( jitcode_t& jit, u8 base, s32 disp, u32 bytecount, u8 src )
+{
+  switch( bytecount ) {
+    case 1: _JitInstr( jit, 0, 0, 1, 0x88, src, base, 1, disp ); break;
+    case 2: _JitInstr( jit, 0x66, 0, 0, 0x89, src, base, 1, disp ); break;
+    case 4: _JitInstr( jit, 0, 0, 0, 0x89, src, base, 1, disp ); break;
+    case 8: _JitInstr( jit, 0, 1, 0, 0x89, src, base, 1, disp ); break;
+    default: UnreachableCrash();
+  }
+}
+
+Inl void
+_JitMovRegReg( jitcode_t& jit, u8 dst, u8 src )
+{
+  _JitInstr( jit, 0, 1, 0, 0x8B, dst, src, 0, 0 );
+}
+
+Inl void
+_JitMovImm( jitcode_t& jit, u8 dst, u64 imm )
+{
+  _JitByte( jit, 0x48 | ( dst >> 3 ) );
+  _JitByte( jit, 0xB8 | ( dst & 7 ) );
+  _JitU64( jit, imm );
+}
+
+Inl void
+_JitLea( jitcode_t& jit, u8 dst, s32 disp )
+{
+  _JitInstr( jit, 0, 1, 0, 0x8D, dst, Cast( u8, jitreg_t::rbx ), 1, disp );
+}
+
+Inl void
+_JitCallAbs( jitcode_t& jit, void* fn )
+{
+  _JitMovImm( jit, Cast( u8, jitreg_t::rax ), Cast( u64, fn ) );
+  _JitByte( jit, 0xFF ); // call rax
+  _JitByte( jit, 0xD0 );
+}
+
+Inl void
+_JitSetcc( jitcode_t& jit, u8 cc, u8 dst )
+{
+  _JitInstr( jit, 0, 0, 1, 0x0F00 | cc, 0, dst, 0, 0 );
+}
+
+// registers we push in the prologue. everything we hand out, plus the frame pointer.
+constant jitreg_t c_jit_saved[] = {
+  jitreg_t::rbx,
+  jitreg_t::rbp,
+  jitreg_t::r12,
+  jitreg_t::r13,
+  jitreg_t::r14,
+  jitreg_t::r15,
+};
+
+Inl void
+_JitPrologue( jitcode_t& jit )
+{
+  ForEach( reg, c_jit_saved ) {
+    auto r = Cast( u8, reg );
+    if( r >= 8 ) {
+      _JitByte( jit, 0x41 );
+    }
+    _JitByte( jit, 0x50 | ( r & 7 ) );
+  }
+  // the call pushed 8 bytes, and we pushed 6 * 8, so 8 more to get back to 16B alignment.
+  _JitInstr( jit, 0, 1, 0, 0x83, 5, Cast( u8, jitreg_t::rsp ), 0, 0 ); // sub rsp, imm8
+  _JitByte( jit, 8 );
+  _JitMovRegReg( jit, Cast( u8, jitreg_t::rbx ), Cast( u8, jitreg_t::rdi ) );
+}
+
+Inl void
+_JitEpilogue( jitcode_t& jit )
+{
+  _JitInstr( jit, 0, 1, 0, 0x83, 0, Cast( u8, jitreg_t::rsp ), 0, 0 ); // add rsp, imm8
+  _JitByte( jit, 8 );
+  ReverseFor( i, 0, _countof( c_jit_saved ) ) {
+    auto r = Cast( u8, c_jit_saved[i] );
+    if( r >= 8 ) {
+      _JitByte( jit, 0x41 );
+    }
+    _JitByte( jit, 0x58 | ( r & 7 ) );
+  }
+  _JitByte( jit, 0xC3 );
+}
+
+Inl void
+_JitBinopInfo(
+  bc_binop_type_t type,
+  jitbinop_t* op,
+  u32* bytecount_operand,
+  u32* bytecount_result,
+  bool* sign,
+  bool* is_float
+  )
+{
+  switch( type ) {
+    #define CASE( name, tr, to, expr ) \
+      case bc_binop_type_t::name: { \
+        *bytecount_operand = sizeof( to ); \
+        *bytecount_result = sizeof( tr ); \
+        *sign = std::is_integral<to>::value  &&  std::is_signed<to>::value; \
+        *is_float = std::is_floating_point<to>::value; \
+      } break;
+    VM_BINOPS( CASE )
+    #undef CASE
+    default: UnreachableCrash();
+  }
+  #define CASE2( _op, a, b ) \
+    case bc_binop_type_t::a: \
+    case bc_binop_type_t::b: { *op = jitbinop_t::_op; } break;
+  #define CASE4( _op, a, b, c, d ) \
+    case bc_binop_type_t::a: \
+    case bc_binop_type_t::b: \
+    case bc_binop_type_t::c: \
+    case bc_binop_type_t::d: { *op = jitbinop_t::_op; } break;
+  #define CASESIGNED( _op ) \
+    CASE4( _op, NAMEJOIN( _op, _u8 ), NAMEJOIN( _op, _u16 ), NAMEJOIN( _op, _u32 ), NAMEJOIN( _op, _u64 ) ) \
+    CASE4( _op, NAMEJOIN( _op, _s8 ), NAMEJOIN( _op, _s16 ), NAMEJOIN( _op, _s32 ), NAMEJOIN( _op, _s64 ) )
+  switch( type ) {
+    CASE4( add, add_8, add_16, add_32, add_64 )
+    CASE4( sub, sub_8, sub_16, sub_32, sub_64 )
+    CASE4( mul, mul_8, mul_16, mul_32, mul_64 )
+    CASE4( andbits, and_8, and_16, and_32, and_64 )
+    CASE4( orbits, or_8, or_16, or_32, or_64 )
+    CASE4( eq, eq_8, eq_16, eq_32, eq_64 )
+    CASE4( noteq, noteq_8, noteq_16, noteq_32, noteq_64 )
+    CASE4( shiftl, shiftl_8, shiftl_16, shiftl_32, shiftl_64 )
+    CASE4( shiftr, shiftrzero_8, shiftrzero_16, shiftrzero_32, shiftrzero_64 )
+    CASE4( shiftr, shiftrsign_8, shiftrsign_16, shiftrsign_32, shiftrsign_64 )
+    CASESIGNED( div )
+    CASESIGNED( mod )
+    CASESIGNED( pow )
+    CASESIGNED( gt )
+    CASESIGNED( gteq )
+    CASESIGNED( lt )
+    CASESIGNED( lteq )
+    CASE2( add, add_f32, add_f64 )
+    CASE2( sub, sub_f32, sub_f64 )
+    CASE2( mul, mul_f32, mul_f64 )
+    CASE2( div, div_f32, div_f64 )
+    CASE2( mod, mod_f32, mod_f64 )
+    CASE2( pow, pow_f32, pow_f64 )
+    CASE2( andbits, and_f32, and_f64 )
+    CASE2( orbits, or_f32, or_f64 )
+    CASE2( eq, eq_f32, eq_f64 )
+    CASE2( noteq, noteq_f32, noteq_f64 )
+    CASE2( gt, gt_f32, gt_f64 )
+    CASE2( gteq, gteq_f32, gteq_f64 )
+    CASE2( lt, lt_f32, lt_f64 )
+    CASE2( lteq, lteq_f32, lteq_f64 )
+    default: UnreachableCrash();
+  }
+  #undef CASESIGNED
+  #undef CASE4
+  #undef CASE2
+}
+
+Inl bool
+_JitIsScalar( u32 bytecount )
+{
+  return bytecount == 1  ||  bytecount == 2  ||  bytecount == 4  ||  bytecount == 8;
+}
+
+// calls fn( var, address_taken ) for every stackvar the bc reads or writes.
+Templ Inl void
+_JitForEachVar( bc_t* bc, T fn )
+{
+  switch( bc->type ) {
+    case bc_type_t::fncall: {
+      FORLEN( loc, k, bc->fncall.caller_loc_args )
+        fn( *loc, 0 );
+      }
+      FORLEN( loc, k, bc->fncall.caller_loc_rets )
+        fn( *loc, 1 );
+      }
+    } break;
+    case bc_type_t::move: { fn( bc->move.var_l, 0 );  fn( bc->move.var_r, 0 ); } break;
+    case bc_type_t::loadconstant: { fn( bc->loadconstant.var_l, 0 ); } break;
+    case bc_type_t::store: { fn( bc->store.var_l, 0 );  fn( bc->store.var_r, 0 ); } break;
+    case bc_type_t::jumpnotzero:
+    case bc_type_t::jumpzero: { fn( bc->jumpcond.var_cond, 0 ); } break;
+    case bc_type_t::binop: { fn( bc->binop.var_l, 0 );  fn( bc->binop.var_r, 0 );  fn( bc->binop.var_result, 0 ); } break;
+    case bc_type_t::unop: { fn( bc->unop.var, 0 );  fn( bc->unop.var_result, 0 ); } break;
+    case bc_type_t::assertvalue: { fn( bc->assertvalue.var_l, 0 ); } break;
+    case bc_type_t::ret:
+    case bc_type_t::jump: break;
+    default: UnreachableCrash();
+  }
+}
+
+// register homes for the current function, indexed by offset_into_scope.
+// only scalar stackvars that don't overlap any differently-sized stackvar get one, so the offset is enough.
+Inl u8
+_JitHome( stack_resizeable_cont_t<u8>& homes, bc_var_t var )
+{
+  AssertCrash( var.offset_into_scope >= 0 );
+  auto offset = Cast( idx_t, var.offset_into_scope );
+  return offset < homes.len  ?  homes.mem[offset]  :  c_jitreg_none;
+}
+
+Inl void
+_JitLoad( jitcode_t& jit, stack_resizeable_cont_t<u8>& homes, u8 dst, bc_var_t var, bool sign )
+{
+  auto home = _JitHome( homes, var );
+  if( home != c_jitreg_none ) {
+    _JitLoadRaw( jit, dst, var.bytecount, sign, home, 0, 0 );
+  } else {
+    _JitLoadRaw( jit, dst, var.bytecount, sign, Cast( u8, jitreg_t::rbx ), 1, var.offset_into_scope );
+  }
+}
+
+// note homes always hold their value zero extended, so a load of the full register is always valid.
+Inl void
+_JitStore( jitcode_t& jit, stack_resizeable_cont_t<u8>& homes, bc_var_t var, u8 src )
+{
+  auto home = _JitHome( homes, var );
+  if( home != c_jitreg_none ) {
+    _JitLoadRaw( jit, home, var.bytecount, 0, src, 0, 0 );
+  } else {
+    _JitStoreMem( jit, Cast( u8, jitreg_t::rbx ), var.offset_into_scope, var.bytecount, src );
+  }
+}
+
+Inl void
+_JitRel32( jitcode_t& jit, stack_resizeable_cont_t<jitfixup_t>& fixups, idx_t target )
+{
+  auto fixup = AddBack( fixups );
+  fixup->pos = jit.bytes.len;
+  fixup->target = target;
+  _JitU32( jit, 0 );
+}
+
+Inl void
+_JitPatchRel32( jitcode_t& jit, idx_t pos, idx_t target_pos )
+{
+  auto rel = Cast( s32, Cast( s64, target_pos ) - Cast( s64, pos + sizeof( u32 ) ) );
+  Memmove( jit.bytes.mem + pos, &rel, sizeof( rel ) );
+}
+
+// linear scan over the live ranges of the scalar stackvars in code[start, end), filling in homes.
+// live ranges are in bc order, extended to cover any loop they're live across.
+NoInl void
+_JitAllocateRegisters(
+  jitcode_t* jit,
+  tslice_t<bc_t> code,
+  idx_t start,
+  idx_t end,
+  bc_fncall_t* callsite,
+  stack_resizeable_cont_t<u8>& homes
+  )
+{
+  // the incoming args and ret ptrs are defined on entry.
+  auto ForEachIncoming = [&]( auto fn )
+  {
+    if( !callsite ) {
+      return;
+    }
+    s32 offset = 0;
+    FORLEN( loc, k, callsite->caller_loc_args )
+      fn( bc_var_t{ offset, loc->bytecount }, 0 );
+      offset += loc->bytecount;
+    }
+    FORLEN( loc, k, callsite->caller_loc_rets )
+      fn( bc_var_t{ offset, Cast( u32, sizeof( void* ) ) }, 0 );
+      offset += sizeof( void* );
+    }
+  };
+
+  idx_t extent = 0;
+  auto Extent = [&]( bc_var_t var, bool address_taken )
+  {
+    AssertCrash( var.offset_into_scope >= 0 );
+    extent = MAX( extent, Cast( idx_t, var.offset_into_scope ) + var.bytecount );
+  };
+  ForEachIncoming( Extent );
+  For( i, start, end ) {
+    _JitForEachVar( code.mem + i, Extent );
+  }
+
+  // per-byte owner, ( offset << 32 ) | bytecount of the first stackvar covering it.
+  // a stackvar is a candidate when it owns all its bytes, nothing else overlaps it, and its address isn't taken.
+  constant u8 c_conflict = 1;
+  constant u8 c_address_taken = 2;
+  auto owners = MemHeapAlloc( u64, extent );
+  auto flags = MemHeapAlloc( u8, extent );
+  auto interval_idxs = MemHeapAlloc( u32, extent );
+  TZero( owners, extent );
+  TZero( flags, extent );
+  TSet( interval_idxs, extent, MAX_u32 );
+  auto Mark = [&]( bc_var_t var, bool address_taken )
+  {
+    auto key = ( Cast( u64, var.offset_into_scope ) << 32 ) | var.bytecount;
+    For( b, 0, var.bytecount ) {
+      auto offset = var.offset_into_scope + b;
+      if( !owners[offset] ) {
+        owners[offset] = key;
+      }
+      elif( owners[offset] != key ) {
+        flags[offset] |= c_conflict;
+      }
+      if( address_taken ) {
+        flags[offset] |= c_address_taken;
+      }
+    }
+  };
+  ForEachIncoming( Mark );
+  For( i, start, end ) {
+    _JitForEachVar( code.mem + i, Mark );
+  }
+  auto IsCandidate = [&]( bc_var_t var )
+  {
+    if( !_JitIsScalar( var.bytecount ) ) {
+      return 0;
+    }
+    auto key = ( Cast( u64, var.offset_into_scope ) << 32 ) | var.bytecount;
+    For( b, 0, var.bytecount ) {
+      auto offset = var.offset_into_scope + b;
+      if( flags[offset]  ||  owners[offset] != key ) {
+        return 0;
+      }
+    }
+    return 1;
+  };
+
+  stack_resizeable_cont_t<jitinterval_t> intervals;
+  Alloc( intervals, 64 );
+  u32 idx = 0;
+  auto Use = [&]( bc_var_t var, bool address_taken )
+  {
+    if( !IsCandidate( var ) ) {
+      return;
+    }
+    auto& interval_idx = interval_idxs[var.offset_into_scope];
+    if( interval_idx == MAX_u32 ) {
+      interval_idx = Cast( u32, intervals.len );
+      auto interval = AddBack( intervals );
+      interval->offset_into_scope = var.offset_into_scope;
+      interval->bytecount = var.bytecount;
+      interval->start = idx;
+      interval->end = idx;
+    }
+    auto interval = intervals.mem + interval_idx;
+    interval->start = MIN( interval->start, idx );
+    interval->end = MAX( interval->end, idx );
+  };
+  idx = Cast( u32, start );
+  ForEachIncoming( Use );
+  For( i, start, end ) {
+    idx = Cast( u32, i );
+    _JitForEachVar( code.mem + i, Use );
+  }
+  jit->nslots += Cast( u32, intervals.len );
+
+  // a range that overlaps a loop has to cover the whole loop, since the value can flow around the backedge.
+  stack_resizeable_cont_t<jitinterval_t> loops;
+  Alloc( loops, 16 );
+  For( i, start, end ) {
+    auto bc = code.mem + i;
+    idx_t target;
+    switch( bc->type ) {
+      case bc_type_t::jump: { target = bc->jump.target; } break;
+      case bc_type_t::jumpzero:
+      case bc_type_t::jumpnotzero: { target = bc->jumpcond.jump.target; } break;
+      default: continue;
+    }
+    if( target <= i ) {
+      auto loop = AddBack( loops );
+      loop->start = Cast( u32, target );
+      loop->end = Cast( u32, i );
+    }
+  }
+  Forever {
+    bool changed = 0;
+    FORLEN( interval, k, intervals )
+      FORLEN( loop, l, loops )
+        if( interval->start <= loop->end  &&  interval->end >= loop->start ) {
+          if( interval->start > loop->start  ||  interval->end < loop->end ) {
+            interval->start = MIN( interval->start, loop->start );
+            interval->end = MAX( interval->end, loop->end );
+            changed = 1;
+          }
+        }
+      }
+    }
+    if( !changed ) {
+      break;
+    }
+  }
+
+  std::sort(
+    intervals.mem,
+    intervals.mem + intervals.len,
+    []( const jitinterval_t& a, const jitinterval_t& b ) { return a.start < b.start; }
+    );
+
+  homes.len = 0;
+  Reserve( homes, extent );
+  homes.len = extent;
+  TSet( homes.mem, extent, c_jitreg_none );
+
+  jitinterval_t* active[ _countof( c_jit_allocatable ) ];
+  u8 active_regs[ _countof( c_jit_allocatable ) ];
+  idx_t nactive = 0;
+  u8 free_regs[ _countof( c_jit_allocatable ) ];
+  idx_t nfree = 0;
+  ReverseFor( i, 0, _countof( c_jit_allocatable ) ) {
+    free_regs[nfree++] = Cast( u8, c_jit_allocatable[i] );
+  }
+  FORLEN( interval, k, intervals )
+    For( a, 0, nactive ) {
+      if( active[a]->end < interval->start ) {
+        free_regs[nfree++] = active_regs[a];
+        active[a] = active[nactive - 1];
+        active_regs[a] = active_regs[nactive - 1];
+        nactive -= 1;
+        a -= 1;
+      }
+    }
+    if( nfree ) {
+      auto reg = free_regs[--nfree];
+      active[nactive] = interval;
+      active_regs[nactive] = reg;
+      nactive += 1;
+      homes.mem[ interval->offset_into_scope ] = reg;
+      continue;
+    }
+    // spill whichever lives longest.
+    idx_t furthest = 0;
+    For( a, 1, nactive ) {
+      if( active[a]->end > active[furthest]->end ) {
+        furthest = a;
+      }
+    }
+    if( active[furthest]->end > interval->end ) {
+      auto reg = active_regs[furthest];
+      homes.mem[ active[furthest]->offset_into_scope ] = c_jitreg_none;
+      homes.mem[ interval->offset_into_scope ] = reg;
+      active[furthest] = interval;
+    }
+  }
+  FORLEN( home, k, homes )
+    jit->nslots_allocated += *home != c_jitreg_none;
+  }
+
+  Free( loops );
+  Free( intervals );
+  MemHeapFree( interval_idxs );
+  MemHeapFree( flags );
+  MemHeapFree( owners );
+}
+
+NoInl void
+JitCompile(
+  tslice_t<bc_t> code,
+  idx_t entry_point,
+  jitcode_t* jit
+  )
+{
+  constant u8 rax = Cast( u8, jitreg_t::rax );
+  constant u8 rcx = Cast( u8, jitreg_t::rcx );
+  constant u8 rdx = Cast( u8, jitreg_t::rdx );
+  constant u8 rbx = Cast( u8, jitreg_t::rbx );
+  constant u8 rsi = Cast( u8, jitreg_t::rsi );
+  constant u8 rdi = Cast( u8, jitreg_t::rdi );
+  constant u8 xmm0 = 0;
+  constant u8 xmm1 = 1;
+  constant u8 xmm2 = 2;
+
+  // static frame lengths like LowerToVm, and a callsite for each function, so we know its arg layout.
+  auto frame_lens = MemHeapAlloc( u32, code.len + 1 );
+  auto callsites = MemHeapAlloc( bc_fncall_t*, code.len + 1 );
+  TSet( frame_lens, code.len + 1, MAX_u32 );
+  TZero( callsites, code.len + 1 );
+  frame_lens[entry_point] = 0;
+  FORLEN( bc, i, code )
+    if( bc->type != bc_type_t::fncall ) {
+      continue;
+    }
+    u32 frame_len = bc->fncall.bytecount_locals;
+    FORLEN( loc, k, bc->fncall.caller_loc_args )
+      frame_len += loc->bytecount;
+    }
+    frame_len += Cast( u32, bc->fncall.caller_loc_rets.len * sizeof( void* ) );
+    auto target = bc->fncall.target_fn_bc_start;
+    AssertCrash( target < code.len );
+    AssertCrash( frame_lens[target] == MAX_u32  ||  frame_lens[target] == frame_len );
+    frame_lens[target] = frame_len;
+    auto callsite = callsites[target];
+    if( callsite ) {
+      AssertCrash( callsite->caller_loc_args.len == bc->fncall.caller_loc_args.len );
+      AssertCrash( callsite->caller_loc_rets.len == bc->fncall.caller_loc_rets.len );
+      FORLEN( loc, k, bc->fncall.caller_loc_args )
+        AssertCrash( loc->bytecount == callsite->caller_loc_args.mem[k].bytecount );
+      }
+    }
+    callsites[target] = &bc->fncall;
+  }
+
+  auto bc_offsets = MemHeapAlloc( idx_t, code.len + 1 );
+  auto fn_offsets = MemHeapAlloc( idx_t, code.len + 1 );
+  stack_resizeable_cont_t<jitfixup_t> fixups_jump;
+  stack_resizeable_cont_t<jitfixup_t> fixups_call;
+  stack_resizeable_cont_t<u8> homes;
+  Alloc( fixups_jump, 256 );
+  Alloc( fixups_call, 64 );
+  Alloc( homes, 256 );
+
+  jit->bytes.len = 0;
+  jit->nslots = 0;
+  jit->nslots_allocated = 0;
+
+  idx_t start = 0;
+  while( start < code.len ) {
+    auto end = start + 1;
+    while( end < code.len  &&  frame_lens[end] == MAX_u32 ) {
+      end += 1;
+    }
+    auto frame_len = frame_lens[start] == MAX_u32  ?  0  :  frame_lens[start];
+    auto callsite = callsites[start];
+
+    _JitAllocateRegisters( jit, code, start, end, callsite, homes );
+
+    fn_offsets[start] = jit->bytes.len;
+    _JitPrologue( *jit );
+    if( callsite ) {
+      // register args go to their homes, and any other incoming value with a register home gets loaded.
+      s32 offset = 0;
+      FORLEN( loc, k, callsite->caller_loc_args )
+        bc_var_t var = { offset, loc->bytecount };
+        if( k < _countof( c_jit_argregs )  &&  _JitIsScalar( loc->bytecount ) ) {
+          _JitStore( *jit, homes, var, Cast( u8, c_jit_argregs[k] ) );
+        }
+        elif( _JitHome( homes, var ) != c_jitreg_none ) {
+          _JitLoadRaw( *jit, _JitHome( homes, var ), var.bytecount, 0, rbx, 1, var.offset_into_scope );
+        }
+        offset += loc->bytecount;
+      }
+      FORLEN( loc, k, callsite->caller_loc_rets )
+        bc_var_t var = { offset, Cast( u32, sizeof( void* ) ) };
+        if( _JitHome( homes, var ) != c_jitreg_none ) {
+          _JitLoadRaw( *jit, _JitHome( homes, var ), var.bytecount, 0, rbx, 1, var.offset_into_scope );
+        }
+        offset += sizeof( void* );
+      }
+    }
+
+    fixups_jump.len = 0;
+    For( i, start, end ) {
+      bc_offsets[i] = jit->bytes.len;
+      auto bc = code.mem + i;
+      switch( bc->type ) {
+        case bc_type_t::fncall: {
+          auto callee = Cast( s32, frame_len );
+          // memory args first, since the memmove helper clobbers the arg registers.
+          s32 offset = 0;
+          FORLEN( loc, k, bc->fncall.caller_loc_args )
+            auto in_reg = k < _countof( c_jit_argregs )  &&  _JitIsScalar( loc->bytecount );
+            if( !in_reg ) {
+              if( _JitIsScalar( loc->bytecount ) ) {
+                _JitLoad( *jit, homes, rax, *loc, 0 );
+                _JitStoreMem( *jit, rbx, callee + offset, loc->bytecount, rax );
+              } else {
+                _JitLea( *jit, rdi, callee + offset );
+                _JitLea( *jit, rsi, loc->offset_into_scope );
+                _JitMovImm( *jit, rdx, loc->bytecount );
+                _JitCallAbs( *jit, Cast( void*, JitHelperMemmove ) );
+              }
+            }
+            offset += loc->bytecount;
+          }
+          FORLEN( loc, k, bc->fncall.caller_loc_rets )
+            AssertCrash( loc->bytecount == sizeof( void* ) );
+            _JitLea( *jit, rax, loc->offset_into_scope );
+            _JitStoreMem( *jit, rbx, callee + offset, sizeof( void* ), rax );
+            offset += sizeof( void* );
+          }
+          FORLEN( loc, k, bc->fncall.caller_loc_args )
+            if( k < _countof( c_jit_argregs )  &&  _JitIsScalar( loc->bytecount ) ) {
+              _JitLoad( *jit, homes, Cast( u8, c_jit_argregs[k] ), *loc, 0 );
+            }
+          }
+          _JitLea( *jit, rdi, callee );
+          _JitByte( *jit, 0xE8 ); // call rel32
+          _JitRel32( *jit, fixups_call, bc->fncall.target_fn_bc_start );
+        } break;
+
+        case bc_type_t::ret: {
+          _JitEpilogue( *jit );
+        } break;
+
+        case bc_type_t::move: {
+          auto var_l = bc->move.var_l;
+          auto var_r = bc->move.var_r;
+          AssertCrash( var_l.bytecount == var_r.bytecount );
+          if( _JitIsScalar( var_l.bytecount ) ) {
+            _JitLoad( *jit, homes, rax, var_r, 0 );
+            _JitStore( *jit, homes, var_l, rax );
+          } else {
+            _JitLea( *jit, rdi, var_l.offset_into_scope );
+            _JitLea( *jit, rsi, var_r.offset_into_scope );
+            _JitMovImm( *jit, rdx, var_l.bytecount );
+            _JitCallAbs( *jit, Cast( void*, JitHelperMemmove ) );
+          }
+        } break;
+
+        case bc_type_t::loadconstant: {
+          auto var_l = bc->loadconstant.var_l;
+          if( _JitIsScalar( var_l.bytecount ) ) {
+            u64 value = 0;
+            Memmove( &value, bc->loadconstant.mem, var_l.bytecount );
+            _JitMovImm( *jit, rax, value );
+            _JitStore( *jit, homes, var_l, rax );
+          } else {
+            _JitLea( *jit, rdi, var_l.offset_into_scope );
+            _JitMovImm( *jit, rsi, Cast( u64, bc->loadconstant.mem ) );
+            _JitMovImm( *jit, rdx, var_l.bytecount );
+            _JitCallAbs( *jit, Cast( void*, JitHelperMemmove ) );
+          }
+        } break;
+
+        case bc_type_t::store: {
+          auto var_l = bc->store.var_l;
+          auto var_r = bc->store.var_r;
+          AssertCrash( var_l.bytecount == sizeof( void* ) );
+          if( _JitIsScalar( var_r.bytecount ) ) {
+            _JitLoad( *jit, homes, rax, var_l, 0 );
+            _JitLoad( *jit, homes, rcx, var_r, 0 );
+            _JitStoreMem( *jit, rax, 0, var_r.bytecount, rcx );
+          } else {
+            _JitLoad( *jit, homes, rdi, var_l, 0 );
+            _JitLea( *jit, rsi, var_r.offset_into_scope );
+            _JitMovImm( *jit, rdx, var_r.bytecount );
+            _JitCallAbs( *jit, Cast( void*, JitHelperMemmove ) );
+          }
+        } break;
+
+        case bc_type_t::jump: {
+          _JitByte( *jit, 0xE9 ); // jmp rel32
+          _JitRel32( *jit, fixups_jump, bc->jump.target );
+        } break;
+
+        case bc_type_t::jumpzero:
+        case bc_type_t::jumpnotzero: {
+          auto cond = bc->jumpcond.var_cond;
+          auto jump_if_zero = bc->type == bc_type_t::jumpzero;
+          if( _JitIsScalar( cond.bytecount ) ) {
+            _JitLoad( *jit, homes, rax, cond, 0 );
+            _JitInstr( *jit, 0, 1, 0, 0x85, rax, rax, 0, 0 ); // test rax, rax
+          } else {
+            _JitLea( *jit, rdi, cond.offset_into_scope );
+            _JitMovImm( *jit, rsi, cond.bytecount );
+            _JitCallAbs( *jit, Cast( void*, JitHelperMemIsZero ) );
+            _JitInstr( *jit, 0, 0, 1, 0x84, rax, rax, 0, 0 ); // test al, al
+            jump_if_zero = !jump_if_zero;
+          }
+          _JitByte( *jit, 0x0F );
+          _JitByte( *jit, jump_if_zero  ?  0x84  :  0x85 ); // jz/jnz rel32
+          _JitRel32( *jit, fixups_jump, bc->jumpcond.jump.target );
+        } break;
+
+        case bc_type_t::binop: {
+          auto binop = &bc->binop;
+          jitbinop_t op;
+          u32 bytecount;
+          u32 bytecount_result;
+          bool sign;
+          bool is_float;
+          _JitBinopInfo( binop->type, &op, &bytecount, &bytecount_result, &sign, &is_float );
+          AssertCrash( binop->var_l.bytecount == bytecount );
+          AssertCrash( binop->var_r.bytecount == bytecount );
+          AssertCrash( binop->var_result.bytecount == bytecount_result );
+          _JitLoad( *jit, homes, rax, binop->var_l, sign );
+          _JitLoad( *jit, homes, rcx, binop->var_r, sign );
+
+          if( !is_float ) {
+            u8 cc = 0;
+            switch( op ) {
+              case jitbinop_t::add: { _JitInstr( *jit, 0, 1, 0, 0x01, rcx, rax, 0, 0 ); } break;
+              case jitbinop_t::sub: { _JitInstr( *jit, 0, 1, 0, 0x29, rcx, rax, 0, 0 ); } break;
+              case jitbinop_t::mul: { _JitInstr( *jit, 0, 1, 0, 0x0FAF, rax, rcx, 0, 0 ); } break;
+              case jitbinop_t::andbits: { _JitInstr( *jit, 0, 1, 0, 0x21, rcx, rax, 0, 0 ); } break;
+              case jitbinop_t::orbits: { _JitInstr( *jit, 0, 1, 0, 0x09, rcx, rax, 0, 0 ); } break;
+              case jitbinop_t::shiftl: { _JitInstr( *jit, 0, 1, 0, 0xD3, 4, rax, 0, 0 ); } break;
+              case jitbinop_t::shiftr: { _JitInstr( *jit, 0, 1, 0, 0xD3, sign  ?  7  :  5, rax, 0, 0 ); } break;
+              case jitbinop_t::div:
+              case jitbinop_t::mod: {
+                if( sign ) {
+                  _JitByte( *jit, 0x48 ); // cqo
+                  _JitByte( *jit, 0x99 );
+                  _JitInstr( *jit, 0, 1, 0, 0xF7, 7, rcx, 0, 0 ); // idiv rcx
+                } else {
+                  _JitInstr( *jit, 0, 0, 0, 0x31, rdx, rdx, 0, 0 ); // xor edx, edx
+                  _JitInstr( *jit, 0, 1, 0, 0xF7, 6, rcx, 0, 0 ); // div rcx
+                }
+                if( op == jitbinop_t::mod ) {
+                  _JitMovRegReg( *jit, rax, rdx );
+                }
+              } break;
+              case jitbinop_t::pow: {
+                void* fn = 0;
+                switch( bytecount ) {
+                  case 1: fn = sign  ?  Cast( void*, Cast( s8  (*)( s8 , s8  ), ipow ) )  :  Cast( void*, Cast( u8  (*)( u8 , u8  ), ipow ) ); break;
+                  case 2: fn = sign  ?  Cast( void*, Cast( s16 (*)( s16, s16 ), ipow ) )  :  Cast( void*, Cast( u16 (*)( u16, u16 ), ipow ) ); break;
+                  case 4: fn = sign  ?  Cast( void*, Cast( s32 (*)( s32, s32 ), ipow ) )  :  Cast( void*, Cast( u32 (*)( u32, u32 ), ipow ) ); break;
+                  case 8: fn = sign  ?  Cast( void*, Cast( s64 (*)( s64, s64 ), ipow ) )  :  Cast( void*, Cast( u64 (*)( u64, u64 ), ipow ) ); break;
+                  default: UnreachableCrash();
+                }
+                _JitMovRegReg( *jit, rdi, rax );
+                _JitMovRegReg( *jit, rsi, rcx );
+                _JitCallAbs( *jit, fn );
+              } break;
+              case jitbinop_t::eq:    { cc = 0x94; } break; // sete
+              case jitbinop_t::noteq: { cc = 0x95; } break; // setne
+              case jitbinop_t::gt:    { cc = sign  ?  0x9F  :  0x97; } break; // setg, seta
+              case jitbinop_t::gteq:  { cc = sign  ?  0x9D  :  0x93; } break; // setge, setae
+              case jitbinop_t::lt:    { cc = sign  ?  0x9C  :  0x92; } break; // setl, setb
+              case jitbinop_t::lteq:  { cc = sign  ?  0x9E  :  0x96; } break; // setle, setbe
+              default: UnreachableCrash();
+            }
+            if( cc ) {
+              _JitInstr( *jit, 0, 1, 0, 0x39, rcx, rax, 0, 0 ); // cmp rax, rcx
+              _JitSetcc( *jit, cc, rax );
+              _JitLoadRaw( *jit, rax, 1, 0, rax, 0, 0 );
+            }
+          } else {
+            auto wide = bytecount == 8;
+            auto prefix = wide  ?  0xF2  :  0xF3;
+            auto prefix_ucomi = wide  ?  0x66  :  0;
+            _JitInstr( *jit, 0x66, wide, 0, 0x0F6E, xmm0, rax, 0, 0 ); // movq xmm0, rax
+            _JitInstr( *jit, 0x66, wide, 0, 0x0F6E, xmm1, rcx, 0, 0 ); // movq xmm1, rcx
+            auto result_float = 0;
+            switch( op ) {
+              case jitbinop_t::add: { _JitInstr( *jit, prefix, 0, 0, 0x0F58, xmm0, xmm1, 0, 0 );  result_float = 1; } break;
+              case jitbinop_t::sub: { _JitInstr( *jit, prefix, 0, 0, 0x0F5C, xmm0, xmm1, 0, 0 );  result_float = 1; } break;
+              case jitbinop_t::mul: { _JitInstr( *jit, prefix, 0, 0, 0x0F59, xmm0, xmm1, 0, 0 );  result_float = 1; } break;
+              case jitbinop_t::div: { _JitInstr( *jit, prefix, 0, 0, 0x0F5E, xmm0, xmm1, 0, 0 );  result_float = 1; } break;
+              case jitbinop_t::mod: {
+                _JitCallAbs( *jit, wide  ?  Cast( void*, JitHelperMod64 )  :  Cast( void*, JitHelperMod32 ) );
+                result_float = 1;
+              } break;
+              case jitbinop_t::pow: {
+                _JitCallAbs( *jit, wide  ?  Cast( void*, JitHelperPow64 )  :  Cast( void*, JitHelperPow32 ) );
+                result_float = 1;
+              } break;
+              case jitbinop_t::andbits:
+              case jitbinop_t::orbits: {
+                // x != 0 is true for nan, so it's setne or setp.
+                _JitInstr( *jit, 0, 0, 0, 0x0F57, xmm2, xmm2, 0, 0 ); // xorps xmm2, xmm2
+                _JitInstr( *jit, prefix_ucomi, 0, 0, 0x0F2E, xmm0, xmm2, 0, 0 ); // ucomis xmm0, xmm2
+                _JitSetcc( *jit, 0x95, rax );
+                _JitSetcc( *jit, 0x9A, rdx );
+                _JitInstr( *jit, 0, 0, 1, 0x08, rdx, rax, 0, 0 ); // or al, dl
+                _JitInstr( *jit, prefix_ucomi, 0, 0, 0x0F2E, xmm1, xmm2, 0, 0 ); // ucomis xmm1, xmm2
+                _JitSetcc( *jit, 0x95, rcx );
+                _JitSetcc( *jit, 0x9A, rdx );
+                _JitInstr( *jit, 0, 0, 1, 0x08, rdx, rcx, 0, 0 ); // or cl, dl
+                _JitInstr( *jit, 0, 0, 1, op == jitbinop_t::andbits  ?  0x20  :  0x08, rcx, rax, 0, 0 ); // and/or al, cl
+              } break;
+              case jitbinop_t::eq: {
+                _JitInstr( *jit, prefix_ucomi, 0, 0, 0x0F2E, xmm0, xmm1, 0, 0 );
+                _JitSetcc( *jit, 0x94, rax ); // sete
+                _JitSetcc( *jit, 0x9B, rcx ); // setnp
+                _JitInstr( *jit, 0, 0, 1, 0x20, rcx, rax, 0, 0 ); // and al, cl
+              } break;
+              case jitbinop_t::noteq: {
+                _JitInstr( *jit, prefix_ucomi, 0, 0, 0x0F2E, xmm0, xmm1, 0, 0 );
+                _JitSetcc( *jit, 0x95, rax ); // setne
+                _JitSetcc( *jit, 0x9A, rcx ); // setp
+                _JitInstr( *jit, 0, 0, 1, 0x08, rcx, rax, 0, 0 ); // or al, cl
+              } break;
+              // unordered sets cf, so seta and setae are false for nan.
+              case jitbinop_t::gt: {
+                _JitInstr( *jit, prefix_ucomi, 0, 0, 0x0F2E, xmm0, xmm1, 0, 0 );
+                _JitSetcc( *jit, 0x97, rax );
+              } break;
+              case jitbinop_t::gteq: {
+                _JitInstr( *jit, prefix_ucomi, 0, 0, 0x0F2E, xmm0, xmm1, 0, 0 );
+                _JitSetcc( *jit, 0x93, rax );
+              } break;
+              case jitbinop_t::lt: {
+                _JitInstr( *jit, prefix_ucomi, 0, 0, 0x0F2E, xmm1, xmm0, 0, 0 );
+                _JitSetcc( *jit, 0x97, rax );
+              } break;
+              case jitbinop_t::lteq: {
+                _JitInstr( *jit, prefix_ucomi, 0, 0, 0x0F2E, xmm1, xmm0, 0, 0 );
+                _JitSetcc( *jit, 0x93, rax );
+              } break;
+              default: UnreachableCrash();
+            }
+            if( result_float ) {
+              _JitInstr( *jit, 0x66, wide, 0, 0x0F7E, xmm0, rax, 0, 0 ); // movq rax, xmm0
+            } else {
+              _JitLoadRaw( *jit, rax, 1, 0, rax, 0, 0 );
+            }
+          }
+          _JitStore( *jit, homes, binop->var_result, rax );
+        } break;
+
+        case bc_type_t::unop: {
+          auto unop = &bc->unop;
+          switch( unop->type ) {
+            case bc_unop_type_t::negate_8:
+            case bc_unop_type_t::negate_16:
+            case bc_unop_type_t::negate_32:
+            case bc_unop_type_t::negate_64: {
+              _JitLoad( *jit, homes, rax, unop->var, 0 );
+              _JitInstr( *jit, 0, 1, 0, 0xF7, 2, rax, 0, 0 ); // not rax
+            } break;
+            case bc_unop_type_t::negateint_8:
+            case bc_unop_type_t::negateint_16:
+            case bc_unop_type_t::negateint_32:
+            case bc_unop_type_t::negateint_64: {
+              _JitLoad( *jit, homes, rax, unop->var, 0 );
+              _JitInstr( *jit, 0, 1, 0, 0xF7, 3, rax, 0, 0 ); // neg rax
+            } break;
+            case bc_unop_type_t::negatefloat_8:
+            case bc_unop_type_t::negatefloat_16:
+            case bc_unop_type_t::negatefloat_32:
+            case bc_unop_type_t::negatefloat_64: {
+              _JitLoad( *jit, homes, rax, unop->var, 0 );
+              _JitMovImm( *jit, rcx, 1ull << ( 8 * unop->var.bytecount - 1 ) );
+              _JitInstr( *jit, 0, 1, 0, 0x31, rcx, rax, 0, 0 ); // xor rax, rcx
+            } break;
+            case bc_unop_type_t::extendzero_8_16:
+            case bc_unop_type_t::extendzero_8_32:
+            case bc_unop_type_t::extendzero_8_64:
+            case bc_unop_type_t::extendzero_16_32:
+            case bc_unop_type_t::extendzero_16_64:
+            case bc_unop_type_t::extendzero_32_64: {
+              _JitLoad( *jit, homes, rax, unop->var, 0 );
+            } break;
+            case bc_unop_type_t::extendsign_8_16:
+            case bc_unop_type_t::extendsign_8_32:
+            case bc_unop_type_t::extendsign_8_64:
+            case bc_unop_type_t::extendsign_16_32:
+            case bc_unop_type_t::extendsign_16_64:
+            case bc_unop_type_t::extendsign_32_64: {
+              _JitLoad( *jit, homes, rax, unop->var, 1 );
+            } break;
+            default: UnreachableCrash();
+          }
+          _JitStore( *jit, homes, unop->var_result, rax );
+        } break;
+
+        case bc_type_t::assertvalue: {
+          auto var = bc->assertvalue.var_l;
+          auto home = _JitHome( homes, var );
+          if( home != c_jitreg_none ) {
+            _JitStoreMem( *jit, rbx, var.offset_into_scope, var.bytecount, home );
+          }
+          _JitMovImm( *jit, rdi, Cast( u64, bc->assertvalue.mem ) );
+          _JitLea( *jit, rsi, var.offset_into_scope );
+          _JitMovImm( *jit, rdx, var.bytecount );
+          _JitCallAbs( *jit, Cast( void*, JitHelperAssertValue ) );
+        } break;
+
+        default: UnreachableCrash();
+      }
+    }
+
+    // running off the end of a function returns from it. for the entry point, that's how Execute stops.
+    bc_offsets[end] = jit->bytes.len;
+    _JitEpilogue( *jit );
+
+    FORLEN( fixup, k, fixups_jump )
+      AssertCrash( start <= fixup->target  &&  fixup->target <= end );
+      _JitPatchRel32( *jit, fixup->pos, bc_offsets[ fixup->target ] );
+    }
+    start = end;
+  }
+  FORLEN( fixup, k, fixups_call )
+    _JitPatchRel32( *jit, fixup->pos, fn_offsets[ fixup->target ] );
+  }
+
+  // W^X: write through a read-write mapping, then flip it to read-execute.
+  if( jit->exec ) {
+    int r = munmap( jit->exec, jit->exec_len );
+    AssertWarn( !r );
+  }
+  jit->exec_len = jit->bytes.len;
+  auto exec = mmap( 0, jit->exec_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0 );
+  AssertCrash( exec != MAP_FAILED );
+  jit->exec = Cast( u8*, exec );
+  Memmove( jit->exec, jit->bytes.mem, jit->bytes.len );
+  int r = mprotect( jit->exec, jit->exec_len, PROT_READ | PROT_EXEC );
+  AssertCrash( !r );
+  jit->entry = Cast( void (*)( u8* ), jit->exec + fn_offsets[entry_point] );
+
+  Free( homes );
+  Free( fixups_call );
+  Free( fixups_jump );
+  MemHeapFree( fn_offsets );
+  MemHeapFree( bc_offsets );
+  MemHeapFree( callsites );
+  MemHeapFree( frame_lens );
+}
+
+NoInl void
+ExecuteJit( jitcode_t* jit )
+{
+  if( !jit->entry ) {
+    return;
+  }
+  slice_t stack;
+  stack.len = 1024*1024;
+  stack.mem = MemHeapAlloc( u8, stack.len );
+  Memzero( stack.mem, stack.len );
+  jit->entry( stack.mem );
+  MemHeapFree( stack.mem );
+}
+
+
+// differential test of JitCompile against Execute and ExecuteVm, on random programs, before and after OptimizeCode.
+// each program is a Main that calls a random function f, which may call a random leaf function g.
+// every function initializes a pool of scalar stackvars, runs random binops/unops/moves, skips and counted loops over
+//   them, then stores the whole pool out to a host buffer. we run each program under all three and compare buffers.
+NoInl void
+TestJit()
+{
+  rng_xorshift32_t rng;
+  Init( rng, 1234 );
+
+  constant u32 c_nslots_per_bytecount = 6;
+  constant u32 c_bytecounts[] = { 8, 4, 2, 1 };
+  constant idx_t c_buffer_len = 4096;
+  constant idx_t c_nconstants = 4096;
+  auto buffer = MemHeapAlloc( u8, c_buffer_len );
+  auto buffer_expected = MemHeapAlloc( u8, c_buffer_len );
+  auto constants = MemHeapAlloc( u64, c_nconstants );
+  idx_t nconstants = 0;
+  idx_t buffer_pos = 0;
+
+  stack_resizeable_cont_t<bc_t> code;
+  stack_resizeable_cont_t<bc_var_t> locs;
+  Alloc( code, 1024 );
+  Alloc( locs, 256 );
+  stack_resizeable_cont_t<bc_t> code_opt;
+  Alloc( code_opt, 1024 );
+  pagelist_t mem;
+  Init( mem, 4096 );
+  vmcode_t vm;
+  Init( vm );
+  jitcode_t jit;
+  Init( jit );
+
+  auto Const = [&]( u64 value )
+  {
+    AssertCrash( nconstants < c_nconstants );
+    constants[nconstants] = value;
+    return Cast( void*, constants + nconstants++ );
+  };
+  auto AddLoadconstant = [&]( bc_var_t var, u64 value )
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::loadconstant;
+    bc->loadconstant = { var, Const( value ) };
+  };
+  // locs lives until the end of the test, so slices into it stay valid; we reserve up front so it never moves.
+  auto AddLocs = [&]( bc_var_t* vars, idx_t nvars )
+  {
+    AssertCrash( locs.len + nvars <= locs.capacity );
+    tslice_t<bc_var_t> r = { locs.mem + locs.len, nvars };
+    Memmove( AddBack( locs, nvars ), vars, nvars * sizeof( bc_var_t ) );
+    return r;
+  };
+
+  struct
+  testfn_t
+  {
+    idx_t start;
+    u32 bytecount_locals;
+    bc_var_t args[7];
+    u32 nargs;
+    u32 nrets;
+  };
+
+  // emits one function, returning its layout. g is the callee, if any.
+  auto GenerateFn = [&]( testfn_t* fn, testfn_t* g )
+  {
+    // args are packed, so we sort them by bytecount to keep them aligned. stackvars are assumed to be aligned.
+    fn->start = code.len;
+    fn->nargs = Rand32( rng ) % ( _countof( fn->args ) + 1 );
+    fn->nrets = Rand32( rng ) % 3;
+    u32 arg_bytecounts[ _countof( fn->args ) ];
+    For( k, 0, fn->nargs ) {
+      arg_bytecounts[k] = c_bytecounts[ Rand32( rng ) % _countof( c_bytecounts ) ];
+    }
+    std::sort( arg_bytecounts, arg_bytecounts + fn->nargs, []( u32 a, u32 b ) { return a > b; } );
+    s32 offset = 0;
+    For( k, 0, fn->nargs ) {
+      fn->args[k] = { offset, arg_bytecounts[k] };
+      offset += arg_bytecounts[k];
+    }
+    if( offset % 8 ) {
+      fn->nrets = 0;
+    }
+    bc_var_t rets[2];
+    For( k, 0, fn->nrets ) {
+      rets[k] = { offset, 8 };
+      offset += 8;
+    }
+    auto locals_start = offset;
+    offset = Cast( s32, RoundUpToMultipleOfPowerOf2( offset, 8 ) );
+
+    // dedicated stackvars for loop counters, pointers and call rets, then divisors and shift counts.
+    bc_var_t counter = { offset, 8 };  offset += 8;
+    bc_var_t one = { offset, 8 };  offset += 8;
+    bc_var_t ptr = { offset, 8 };  offset += 8;
+    bc_var_t g_rets[2] = { { offset, 8 }, { offset + 8, 8 } };  offset += 16;
+    bc_var_t operands[ _countof( c_bytecounts ) ];
+    For( b, 0, _countof( c_bytecounts ) ) {
+      operands[b] = { offset, c_bytecounts[b] };
+      offset += 8;
+    }
+    // the pool, by bytecount.
+    bc_var_t slots[ _countof( c_bytecounts ) ][ c_nslots_per_bytecount ];
+    For( b, 0, _countof( c_bytecounts ) ) {
+      For( k, 0, c_nslots_per_bytecount ) {
+        slots[b][k] = { offset, c_bytecounts[b] };
+        offset += c_bytecounts[b];
+      }
+    }
+    offset = Cast( s32, RoundUpToMultipleOfPowerOf2( offset, 8 ) );
+    fn->bytecount_locals = offset - locals_start;
+
+    auto Slot = [&]( u32 bytecount )
+    {
+      idx_t b = 0;
+      while( c_bytecounts[b] != bytecount ) {
+        b += 1;
+      }
+      return slots[b][ Rand32( rng ) % c_nslots_per_bytecount ];
+    };
+    auto Bytecount = [&]()
+    {
+      return c_bytecounts[ Rand32( rng ) % _countof( c_bytecounts ) ];
+    };
+
+    // the args are inputs too; fold them into the pool.
+    For( b, 0, _countof( c_bytecounts ) ) {
+      For( k, 0, c_nslots_per_bytecount ) {
+        AddLoadconstant( slots[b][k], Rand64( rng ) );
+      }
+    }
+    For( k, 0, fn->nargs ) {
+      auto bc = AddBack( code );
+      bc->type = bc_type_t::move;
+      bc->move = { Slot( fn->args[k].bytecount ), fn->args[k] };
+    }
+
+    auto AddOp = [&]()
+    {
+      switch( Rand32( rng ) % 4 ) {
+        case 0: {
+          auto bytecount = Bytecount();
+          auto bc = AddBack( code );
+          bc->type = bc_type_t::move;
+          bc->move = { Slot( bytecount ), Slot( bytecount ) };
+        } break;
+        case 1: {
+          auto type = Cast( bc_unop_type_t, Rand32( rng ) % ( Cast( enum_t, bc_unop_type_t::extendsign_32_64 ) + 1 ) );
+          u32 bytecount;
+          u32 bytecount_result;
+          switch( type ) {
+            #define CASE( name, tr, to, expr ) \
+              case bc_unop_type_t::name: { bytecount = sizeof( to );  bytecount_result = sizeof( tr ); } break;
+            VM_UNOPS( CASE )
+            #undef CASE
+            default: UnreachableCrash();
+          }
+          auto bc = AddBack( code );
+          bc->type = bc_type_t::unop;
+          bc->unop = { type, Slot( bytecount ), Slot( bytecount_result ) };
+        } break;
+        default: {
+          auto type = Cast( bc_binop_type_t, Rand32( rng ) % ( Cast( enum_t, bc_binop_type_t::lteq_f64 ) + 1 ) );
+          jitbinop_t op;
+          u32 bytecount;
+          u32 bytecount_result;
+          bool sign;
+          bool is_float;
+          _JitBinopInfo( type, &op, &bytecount, &bytecount_result, &sign, &is_float );
+          auto var_r = Slot( bytecount );
+          // keep clear of division by zero, and shifts past the width, which are undefined.
+          if( !is_float  &&  ( op == jitbinop_t::div  ||  op == jitbinop_t::mod  ||  op == jitbinop_t::shiftl  ||  op == jitbinop_t::shiftr ) ) {
+            idx_t b = 0;
+            while( c_bytecounts[b] != bytecount ) {
+              b += 1;
+            }
+            var_r = operands[b];
+            auto shift = op == jitbinop_t::shiftl  ||  op == jitbinop_t::shiftr;
+            AddLoadconstant( var_r, shift  ?  Rand32( rng ) % ( 8 * bytecount )  :  1 + Rand32( rng ) % 100 );
+          }
+          auto bc = AddBack( code );
+          bc->type = bc_type_t::binop;
+          bc->binop = { type, Slot( bytecount ), var_r, Slot( bytecount_result ) };
+        } break;
+      }
+    };
+
+    auto nops = 20 + Rand32( rng ) % 40;
+    For( k, 0, nops ) {
+      switch( Rand32( rng ) % 8 ) {
+        case 0: {
+          // jumpzero/jumpnotzero over the next op.
+          auto bc = AddBack( code );
+          auto jump_idx = code.len - 1;
+          bc->type = Rand32( rng ) % 2  ?  bc_type_t::jumpzero  :  bc_type_t::jumpnotzero;
+          bc->jumpcond.var_cond = Slot( Bytecount() );
+          AddOp();
+          code.mem[jump_idx].jumpcond.jump.target = code.len;
+        } break;
+        case 1: {
+          // a counted loop over a few ops.
+          AddLoadconstant( counter, 1 + Rand32( rng ) % 4 );
+          AddLoadconstant( one, 1 );
+          auto loop = code.len;
+          auto nbody = 1 + Rand32( rng ) % 4;
+          For( l, 0, nbody ) {
+            AddOp();
+          }
+          auto bc = AddBack( code );
+          bc->type = bc_type_t::binop;
+          bc->binop = { bc_binop_type_t::sub_64, counter, one, counter };
+          bc = AddBack( code );
+          bc->type = bc_type_t::jumpnotzero;
+          bc->jumpcond = { counter, { loop } };
+        } break;
+        case 2: {
+          if( !g ) {
+            AddOp();
+            break;
+          }
+          bc_var_t args[ _countof( g->args ) ];
+          For( a, 0, g->nargs ) {
+            args[a] = Slot( g->args[a].bytecount );
+          }
+          auto bc = AddBack( code );
+          bc->type = bc_type_t::fncall;
+          bc->fncall.target_fn_bc_start = g->start;
+          bc->fncall.caller_loc_args = AddLocs( args, g->nargs );
+          bc->fncall.caller_loc_rets = AddLocs( g_rets, g->nrets );
+          bc->fncall.bytecount_locals = g->bytecount_locals;
+          For( r, 0, g->nrets ) {
+            bc = AddBack( code );
+            bc->type = bc_type_t::move;
+            bc->move = { Slot( 8 ), g_rets[r] };
+          }
+        } break;
+        default: {
+          AddOp();
+        } break;
+      }
+    }
+
+    // store the pool out to the host buffer, and write rets.
+    buffer_pos = RoundUpToMultipleOfPowerOf2( buffer_pos, 8 );
+    For( b, 0, _countof( c_bytecounts ) ) {
+      For( k, 0, c_nslots_per_bytecount ) {
+        AssertCrash( buffer_pos + c_bytecounts[b] <= c_buffer_len );
+        AddLoadconstant( ptr, Cast( u64, buffer + buffer_pos ) );
+        buffer_pos += c_bytecounts[b];
+        auto bc = AddBack( code );
+        bc->type = bc_type_t::store;
+        bc->store = { ptr, slots[b][k] };
+      }
+    }
+    For( k, 0, fn->nrets ) {
+      auto bc = AddBack( code );
+      bc->type = bc_type_t::store;
+      bc->store = { rets[k], Slot( 8 ) };
+    }
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::ret;
+  };
+
+  constant idx_t c_nprograms = 200;
+  For( program, 0, c_nprograms ) {
+    code.len = 0;
+    locs.len = 0;
+    Reserve( locs, 4096 );
+    nconstants = 0;
+    buffer_pos = 0;
+
+    testfn_t g;
+    testfn_t f;
+    auto has_g = Rand32( rng ) % 2;
+    if( has_g ) {
+      GenerateFn( &g, 0 );
+    }
+    GenerateFn( &f, has_g  ?  &g  :  0 );
+
+    // Main: f( random args ), then store f's rets out.
+    bc_var_t args[ _countof( f.args ) ];
+    s32 offset = 0;
+    For( k, 0, f.nargs ) {
+      args[k] = { offset, f.args[k].bytecount };
+      offset += 8;
+    }
+    bc_var_t rets[2];
+    For( k, 0, f.nrets ) {
+      rets[k] = { offset, 8 };
+      offset += 8;
+    }
+    bc_var_t ptr = { offset, 8 };
+    offset += 8;
+    buffer_pos = RoundUpToMultipleOfPowerOf2( buffer_pos, 8 );
+    auto fn_main = code.len;
+    For( k, 0, f.nargs ) {
+      AddLoadconstant( args[k], Rand64( rng ) );
+    }
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::fncall;
+    bc->fncall.target_fn_bc_start = f.start;
+    bc->fncall.caller_loc_args = AddLocs( args, f.nargs );
+    bc->fncall.caller_loc_rets = AddLocs( rets, f.nrets );
+    bc->fncall.bytecount_locals = f.bytecount_locals;
+    For( k, 0, f.nrets ) {
+      AssertCrash( buffer_pos + 8 <= c_buffer_len );
+      AddLoadconstant( ptr, Cast( u64, buffer + buffer_pos ) );
+      buffer_pos += 8;
+      bc = AddBack( code );
+      bc->type = bc_type_t::store;
+      bc->store = { ptr, rets[k] };
+    }
+    bc = AddBack( code );
+    bc->type = bc_type_t::ret;
+
+    auto entry_point = code.len;
+    bc = AddBack( code );
+    bc->type = bc_type_t::fncall;
+    bc->fncall.target_fn_bc_start = fn_main;
+    bc->fncall.caller_loc_args = {};
+    bc->fncall.caller_loc_rets = {};
+    bc->fncall.bytecount_locals = offset;
+
+    auto code_slice = SliceFromArray( code );
+    TZero( buffer, c_buffer_len );
+    Execute( code_slice, entry_point );
+    Memmove( buffer_expected, buffer, c_buffer_len );
+
+    TZero( buffer, c_buffer_len );
+    LowerToVm( code_slice, entry_point, &vm );
+    ExecuteVm( &vm );
+    AssertCrash( MemEqual( buffer, buffer_expected, c_buffer_len ) );
+
+    TZero( buffer, c_buffer_len );
+    JitCompile( code_slice, entry_point, &jit );
+    ExecuteJit( &jit );
+    AssertCrash( MemEqual( buffer, buffer_expected, c_buffer_len ) );
+
+    // and all three again, on the optimized program.
+    Reset( mem );
+    Copy( code_opt, code );
+    auto entry_point_opt = entry_point;
+    bcoptstats_t stats;
+    OptimizeCode( &code_opt, &entry_point_opt, &mem, c_bcpasses_all, &stats );
+    auto code_opt_slice = SliceFromArray( code_opt );
+    TZero( buffer, c_buffer_len );
+    Execute( code_opt_slice, entry_point_opt );
+    AssertCrash( MemEqual( buffer, buffer_expected, c_buffer_len ) );
+
+    TZero( buffer, c_buffer_len );
+    LowerToVm( code_opt_slice, entry_point_opt, &vm );
+    ExecuteVm( &vm );
+    AssertCrash( MemEqual( buffer, buffer_expected, c_buffer_len ) );
+
+    TZero( buffer, c_buffer_len );
+    JitCompile( code_opt_slice, entry_point_opt, &jit );
+    ExecuteJit( &jit );
+    AssertCrash( MemEqual( buffer, buffer_expected, c_buffer_len ) );
+  }
+
+  Kill( mem );
+  Kill( jit );
+  Kill( vm );
+  Free( code_opt );
+  Free( locs );
+  Free( code );
+  MemHeapFree( constants );
+  MemHeapFree( buffer_expected );
+  MemHeapFree( buffer );
+}
+
+#endif // JC3_JIT
+
+
+// Execute vs ExecuteVm, and the jit where we have it, on a few hand-built kernels, since Generate can't lower most programs yet.
+// every kernel checks its own result with assertvalue, or the host checks memory afterwards.
+NoInl void
+BenchExecute()
+{
+  stack_resizeable_cont_t<bc_t> code;
+  Alloc( code, 256 );
+  u64 constants[64];
+  idx_t nconstants = 0;
+  vmcode_t vm;
+  Init( vm );
+#if JC3_JIT
+  jitcode_t jit;
+  Init( jit );
+#endif
+
+  auto Const = [&]( u64 value )
+  {
+    AssertCrash( nconstants < _countof( constants ) );
+    constants[nconstants] = value;
+    return Cast( void*, constants + nconstants++ );
+  };
+  auto AddLoadconstant = [&]( bc_var_t var, u64 value )
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::loadconstant;
+    bc->loadconstant = { var, Const( value ) };
+  };
+  auto AddBinop = [&]( bc_binop_type_t type, bc_var_t var_result, bc_var_t var_l, bc_var_t var_r )
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::binop;
+    bc->binop = { type, var_l, var_r, var_result };
+  };
+  auto AddJumpcond = [&]( bc_type_t type, bc_var_t var_cond, idx_t target )
+  {
+    auto bc = AddBack( code );
+    bc->type = type;
+    bc->jumpcond = { var_cond, { target } };
+  };
+  auto AddJump = [&]( idx_t target )
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::jump;
+    bc->jump = { target };
+  };
+  auto AddStore = [&]( bc_var_t var_l, bc_var_t var_r )
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::store;
+    bc->store = { var_l, var_r };
+  };
+  auto AddAssertvalue = [&]( bc_var_t var_l, u64 value )
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::assertvalue;
+    bc->assertvalue = { var_l, Const( value ) };
+  };
+  auto AddRet = [&]()
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::ret;
+  };
+  auto AddFncall = [&]( idx_t target, tslice_t<bc_var_t> args, tslice_t<bc_var_t> rets, u32 bytecount_locals )
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::fncall;
+    bc->fncall.target_fn_bc_start = target;
+    bc->fncall.caller_loc_args = args;
+    bc->fncall.caller_loc_rets = rets;
+    bc->fncall.bytecount_locals = bytecount_locals;
+  };
+  auto Time = [&]( const char* name, idx_t entry_point, std::function<void()> check )
+  {
+    auto code_slice = SliceFromArray( code );
+    LowerToVm( code_slice, entry_point, &vm );
+    auto t0 = TimeTSC();
+    Execute( code_slice, entry_point );
+    auto t1 = TimeTSC();
+    check();
+    auto t2 = TimeTSC();
+    ExecuteVm( &vm );
+    auto t3 = TimeTSC();
+    check();
+    auto sec_bc = TimeSecFromTSC64( t1 - t0 );
+    auto sec_vm = TimeSecFromTSC64( t3 - t2 );
+    printf(
+      "%10s  %10llu  %10llu  %10llu  %10.1f  %10.1f  %10.2f\n",
+      name,
+      Cast( unsigned long long, code.len ),
+      Cast( unsigned long long, vm.instrs.len ),
+      Cast( unsigned long long, vm.nfused ),
+      1e3 * sec_bc,
+      1e3 * sec_vm,
+      sec_bc / sec_vm
+      );
+#if JC3_JIT
+    auto t4 = TimeTSC();
+    JitCompile( code_slice, entry_point, &jit );
+    auto t5 = TimeTSC();
+    ExecuteJit( &jit );
+    auto t6 = TimeTSC();
+    check();
+    auto sec_jit = TimeSecFromTSC64( t6 - t5 );
+    printf(
+      "%10s  %10llu  %7u/%-7u  %10.1f  %10.1f  %10.2f\n",
+      "",
+      Cast( unsigned long long, jit.bytes.len ),
+      jit.nslots_allocated,
+      jit.nslots,
+      1e6 * TimeSecFromTSC64( t5 - t4 ),
+      1e3 * sec_jit,
+      sec_bc / sec_jit
+      );
+#endif
+  };
+
+  printf( "%10s  %10s  %10s  %10s  %10s  %10s  %10s\n", "kernel", "bcs", "vminstrs", "fused", "Execute ms", "ExecuteVm ms", "speedup" );
+#if JC3_JIT
+  printf( "%10s  %10s  %15s  %10s  %10s  %10s\n", "", "jit bytes", "regs/slots", "compile us", "jit ms", "speedup" );
+#endif
+
+  // fib( n u64 ) u64, recursively.
+  {
+    constant u64 c_n = 27;
+    constant u64 c_fib = 196418;
+    bc_var_t n = { 0, 8 };
+    bc_var_t ret = { 8, 8 };
+    bc_var_t two = { 16, 8 };
+    bc_var_t c = { 24, 1 };
+    bc_var_t r1 = { 32, 8 };
+    bc_var_t r2 = { 40, 8 };
+    bc_var_t n1 = { 48, 8 };
+    bc_var_t one = { 56, 8 };
+    bc_var_t two_ = { 64, 8 };
+    bc_var_t sum = { 72, 8 };
+    constant u32 c_bytecount_locals = 80 - 16;
+    tslice_t<bc_var_t> args_n1 = { &n1, 1 };
+    tslice_t<bc_var_t> rets_r1 = { &r1, 1 };
+    tslice_t<bc_var_t> rets_r2 = { &r2, 1 };
+
+    code.len = 0;
+    nconstants = 0;
+    auto fib = code.len;
+    AddLoadconstant( two, 2 );
+    AddBinop( bc_binop_type_t::lt_u64, c, n, two );
+    AddJumpcond( bc_type_t::jumpzero, c, fib + 5 );
+    AddStore( ret, n );
+    AddRet();
+    AddLoadconstant( one, 1 );
+    AddBinop( bc_binop_type_t::sub_64, n1, n, one );
+    AddFncall( fib, args_n1, rets_r1, c_bytecount_locals );
+    AddLoadconstant( two_, 2 );
+    AddBinop( bc_binop_type_t::sub_64, n1, n, two_ );
+    AddFncall( fib, args_n1, rets_r2, c_bytecount_locals );
+    AddBinop( bc_binop_type_t::add_64, sum, r1, r2 );
+    AddStore( ret, sum );
+    AddRet();
+
+    bc_var_t main_n = { 0, 8 };
+    bc_var_t main_r = { 8, 8 };
+    tslice_t<bc_var_t> main_args = { &main_n, 1 };
+    tslice_t<bc_var_t> main_rets = { &main_r, 1 };
+    auto fn_main = code.len;
+    AddLoadconstant( main_n, c_n );
+    AddFncall( fib, main_args, main_rets, c_bytecount_locals );
+    AddAssertvalue( main_r, c_fib );
+    AddRet();
+
+    auto entry_point = code.len;
+    AddFncall( fn_main, {}, {}, 16 );
+    Time( "fib", entry_point, [](){} );
+  }
+
+  // sum of 0 .. n, in a loop.
+  {
+    constant u64 c_n = 10*1000*1000;
+    bc_var_t i = { 0, 8 };
+    bc_var_t s = { 8, 8 };
+    bc_var_t n = { 16, 8 };
+    bc_var_t c = { 24, 1 };
+    bc_var_t one = { 32, 8 };
+
+    code.len = 0;
+    nconstants = 0;
+    auto fn_main = code.len;
+    AddLoadconstant( i, 0 );
+    AddLoadconstant( s, 0 );
+    auto loop = code.len;
+    AddLoadconstant( n, c_n );
+    AddBinop( bc_binop_type_t::lt_u64, c, i, n );
+    AddJumpcond( bc_type_t::jumpzero, c, loop + 7 );
+    AddBinop( bc_binop_type_t::add_64, s, s, i );
+    AddLoadconstant( one, 1 );
+    AddBinop( bc_binop_type_t::add_64, i, i, one );
+    AddJump( loop );
+    AddAssertvalue( s, c_n * ( c_n - 1 ) / 2 );
+    AddRet();
+
+    auto entry_point = code.len;
+    AddFncall( fn_main, {}, {}, 40 );
+    Time( "sum", entry_point, [](){} );
+  }
+
+  // fill an array with a u32 counter, through store.
+  {
+    constant u64 c_n = 4*1000*1000;
+    auto array = MemHeapAlloc( u32, c_n );
+    bc_var_t i = { 0, 8 };
+    bc_var_t base = { 8, 8 };
+    bc_var_t n = { 16, 8 };
+    bc_var_t c = { 24, 1 };
+    bc_var_t v = { 28, 4 };
+    bc_var_t four = { 32, 8 };
+    bc_var_t offset = { 40, 8 };
+    bc_var_t addr = { 48, 8 };
+    bc_var_t three = { 56, 4 };
+    bc_var_t one = { 64, 8 };
+
+    code.len = 0;
+    nconstants = 0;
+    auto fn_main = code.len;
+    AddLoadconstant( i, 0 );
+    AddLoadconstant( v, 0 );
+    AddLoadconstant( base, Cast( u64, array ) );
+    auto loop = code.len;
+    AddLoadconstant( n, c_n );
+    AddBinop( bc_binop_type_t::lt_u64, c, i, n );
+    AddJumpcond( bc_type_t::jumpzero, c, loop + 12 );
+    AddLoadconstant( four, 4 );
+    AddBinop( bc_binop_type_t::mul_64, offset, i, four );
+    AddBinop( bc_binop_type_t::add_64, addr, base, offset );
+    AddLoadconstant( three, 3 );
+    AddBinop( bc_binop_type_t::add_32, v, v, three );
+    AddStore( addr, v );
+    AddLoadconstant( one, 1 );
+    AddBinop( bc_binop_type_t::add_64, i, i, one );
+    AddJump( loop );
+    AddRet();
+
+    auto entry_point = code.len;
+    AddFncall( fn_main, {}, {}, 72 );
+    Time( "fill", entry_point, [&]() {
+      For( k, 0, c_n ) {
+        AssertCrash( array[k] == 3 * ( k + 1 ) );
+      }
+      TZero( array, c_n );
+    });
+    MemHeapFree( array );
+  }
+
+#if JC3_JIT
+  Kill( jit );
+#endif
+  Kill( vm );
+  Free( code );
+}
+
+
+
+// OptimizeCode on a loop shaped like Generate's output: every expression goes through its own temporaries, with
+//   a foldable constant subexpression, a branch on a constant, a dead store, a chain of jumps, and dead code after
+//   the ret. each row turns on one more pass, so the removed/rewritten columns are what that pass added.
+NoInl void
+BenchOptimize()
+{
+  stack_resizeable_cont_t<bc_t> code;
+  Alloc( code, 256 );
+  pagelist_t mem;
+  Init( mem, 4096 );
+  u64 constants[64];
+  idx_t nconstants = 0;
+  vmcode_t vm;
+  Init( vm );
+
+  constant u64 c_n = 10*1000*1000;
+  constant u64 c_sum = 5 * ( c_n * ( c_n - 1 ) / 2 );
+
+  auto Const = [&]( u64 value )
+  {
+    AssertCrash( nconstants < _countof( constants ) );
+    constants[nconstants] = value;
+    return Cast( void*, constants + nconstants++ );
+  };
+  auto AddLoadconstant = [&]( bc_var_t var, u64 value )
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::loadconstant;
+    bc->loadconstant = { var, Const( value ) };
+  };
+  auto AddMove = [&]( bc_var_t var_l, bc_var_t var_r )
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::move;
+    bc->move = { var_l, var_r };
+  };
+  auto AddBinop = [&]( bc_binop_type_t type, bc_var_t var_result, bc_var_t var_l, bc_var_t var_r )
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::binop;
+    bc->binop = { type, var_l, var_r, var_result };
+  };
+  auto AddJumpcond = [&]( bc_type_t type, bc_var_t var_cond )
+  {
+    auto bc = AddBack( code );
+    bc->type = type;
+    bc->jumpcond.var_cond = var_cond;
+    return code.len - 1;
+  };
+  auto AddJump = [&]( idx_t target )
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::jump;
+    bc->jump = { target };
+    return code.len - 1;
+  };
+  auto AddRet = [&]()
+  {
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::ret;
+  };
+
+  // returns the entry point.
+  u32 bytecount_locals = 0;
+  auto Build = [&]()
+  {
+    code.len = 0;
+    nconstants = 0;
+    s32 offset = 0;
+    auto Var = [&]()
+    {
+      bc_var_t var = { offset, 8 };
+      offset += 8;
+      return var;
+    };
+    auto i = Var();
+    auto sum = Var();
+    auto n = Var();
+    bc_var_t t[20];
+    For( k, 0, _countof( t ) ) {
+      t[k] = Var();
+    }
+    bytecount_locals = Cast( u32, offset );
+
+    auto fn_main = code.len;
+    AddLoadconstant( t[0], 0 );
+    AddMove( i, t[0] );
+    AddLoadconstant( t[1], 0 );
+    AddMove( sum, t[1] );
+    AddLoadconstant( t[2], c_n );
+    AddMove( n, t[2] );
+    auto loop = code.len;
+    AddMove( t[3], i );
+    AddMove( t[4], n );
+    AddBinop( bc_binop_type_t::lt_u64, t[5], t[3], t[4] );
+    auto jump_done = AddJumpcond( bc_type_t::jumpzero, t[5] );
+    // sum = sum + i * ( 2 + 3 )
+    AddLoadconstant( t[6], 2 );
+    AddLoadconstant( t[7], 3 );
+    AddBinop( bc_binop_type_t::add_64, t[8], t[6], t[7] );
+    AddMove( t[9], i );
+    AddBinop( bc_binop_type_t::mul_64, t[10], t[9], t[8] );
+    AddMove( t[11], sum );
+    AddBinop( bc_binop_type_t::add_64, t[12], t[11], t[10] );
+    AddMove( sum, t[12] );
+    // if( 0 ) { sum = 0 }
+    AddLoadconstant( t[13], 0 );
+    auto jump_skip = AddJumpcond( bc_type_t::jumpzero, t[13] );
+    AddLoadconstant( sum, 0 );
+    code.mem[jump_skip].jumpcond.jump.target = code.len;
+    // a store nothing reads.
+    AddLoadconstant( t[14], 42 );
+    // i = i + 1
+    AddLoadconstant( t[15], 1 );
+    AddMove( t[16], i );
+    AddBinop( bc_binop_type_t::add_64, t[17], t[16], t[15] );
+    AddMove( i, t[17] );
+    AddJump( code.len + 1 );
+    AddJump( loop );
+    code.mem[jump_done].jumpcond.jump.target = AddJump( code.len + 1 );
+    {
+      auto bc = AddBack( code );
+      bc->type = bc_type_t::assertvalue;
+      bc->assertvalue = { sum, Const( c_sum ) };
+    }
+    AddRet();
+    AddLoadconstant( t[18], 7 );
+    AddMove( t[19], t[18] );
+    AddRet();
+
+    auto entry_point = code.len;
+    auto bc = AddBack( code );
+    bc->type = bc_type_t::fncall;
+    bc->fncall.target_fn_bc_start = fn_main;
+    bc->fncall.caller_loc_args = {};
+    bc->fncall.caller_loc_rets = {};
+    bc->fncall.bytecount_locals = bytecount_locals;
+    return entry_point;
+  };
+
+  printf( "%12s  %10s  %10s  %10s  %10s  %10s  %10s  %12s\n", "+pass", "bcs", "removed", "rewritten", "locals", "opt us", "Execute ms", "ExecuteVm ms" );
+  For( npasses, 0, Cast( idx_t, bcpass_t::COUNT ) + 1 ) {
+    auto entry_point = Build();
+    Reset( mem );
+    bcoptstats_t stats;
+    auto t0 = TimeTSC();
+    OptimizeCode( &code, &entry_point, &mem, ( 1u << npasses ) - 1, &stats );
+    auto t1 = TimeTSC();
+    u32 bytecount_locals_opt = bytecount_locals;
+    FORLEN( bc, k, code )
+      if( bc->type == bc_type_t::fncall ) {
+        bytecount_locals_opt = bc->fncall.bytecount_locals;
+      }
+    }
+
+    auto code_slice = SliceFromArray( code );
+    auto t2 = TimeTSC();
+    Execute( code_slice, entry_point );
+    auto t3 = TimeTSC();
+    LowerToVm( code_slice, entry_point, &vm );
+    auto t4 = TimeTSC();
+    ExecuteVm( &vm );
+    auto t5 = TimeTSC();
+
+    auto pass = npasses - 1;
+    auto name = npasses  ?  StringFromBcpass( Cast( bcpass_t, pass ) )  :  SliceFromCStr( "none" );
+    printf(
+      "%12.*s  %10llu  %10llu  %10llu  %10u  %10.1f  %10.1f  %12.1f\n",
+      Cast( int, name.len ),
+      name.mem,
+      Cast( unsigned long long, code.len ),
+      Cast( unsigned long long, npasses  ?  stats.nremoved[pass]  :  0 ),
+      Cast( unsigned long long, npasses  ?  stats.nrewritten[pass]  :  0 ),
+      bytecount_locals_opt,
+      1e6 * TimeSecFromTSC64( t1 - t0 ),
+      1e3 * TimeSecFromTSC64( t3 - t2 ),
+      1e3 * TimeSecFromTSC64( t5 - t4 )
+      );
+  }
+
+  Kill( vm );
+  Kill( mem );
+  Free( code );
+}
+
+
+// TODO: how do we store fncall, since we need to know the dest code location, possibly before generating it?
+// in x86 asm i think you just use the fn name, but i'm not sure about in the executable.
+// presumably you have to resolve to a location, unless the OS loader does that for you.
+// i'll start with unresolved for now, and we can always do a post-pass to replace fncalls.
+
+  s64 offset_into_scope;
+
+
+//Inl void
+//ComputeStackOffset(
+//  vartable_t* vartable,
+//  var_t* var
+//  )
+//{
+//  var->offset_into_scope = vartable->vars_bytecount_top;
+//  vartable->vars_bytecount_top += var->type.bytecount;
+//}
+
+
+
+
+
+Inl void
+PrintCppType(
+  stack_resizeable_cont_t<u8>* out,
+  type_t* type
+  )
+{
+  switch( type->type ) {
+    case type_type_t::num: {
+      auto bytecount = type->num.bytecount;
+      switch( type->num.type ) {
+        case num_type_t::unsigned_: {
+          AddBackString( out, "u" );
+        } break;
+        case num_type_t::signed_: {
+          AddBackString( out, "s" );
+        } break;
+        case num_type_t::float_: {
+          AddBackString( out, "f" );
+        } break;
+        default: UnreachableCrash();
+      }
+      stack_nonresizeable_stack_t<u8, 64> tmp;
+      CsFromIntegerU( tmp.mem, Capacity( tmp ), &tmp.len, bytecount * 8 );
+      AddBackString( out, SliceFromArray( tmp ) );
+    } break;
+    case type_type_t::bool_: {
+      AddBackString( out, "bool" );
+    } break;
+    case type_type_t::string_: {
+      AddBackString( out, "string" );
+    } break;
+    case type_type_t::struct_: {
+      PrintIdent( out, &type->structdecltype->ident );
+    } break;
+    case type_type_t::enum_: {
+      PrintIdent( out, &type->enumdecltype->ident );
+    } break;
+    default: UnreachableCrash();
+  }
+  if( type->qualifiers.len ) {
+    AddBackString( out, " " );
+  }
+  FORLIST( qualifier, elem, type->qualifiers )
+    switch( qualifier->type ) {
+      case typedecl_qualifier_type_t::star: {
+        AddBackString( out, "*" );
+      } break;
+      case typedecl_qualifier_type_t::array: {
+        AddBackString( out, "[" );
+        FORLIST( arrayidx, elem2, qualifier->arrayidxs )
+          switch( arrayidx->type ) {
+            case typedecl_arrayidx_type_t::star: {
+              AddBackString( out, "*" );
+            } break;
+            case typedecl_arrayidx_type_t::expr_const: {
+              stack_nonresizeable_stack_t<u8, 64> tmp;
+              CsFromIntegerU( tmp.mem, Capacity( tmp ), &tmp.len, arrayidx->value );
+              AddBackString( out, SliceFromArray( tmp ) );
+            } break;
+            default: UnreachableCrash();
+          }
+          if( elem2 != qualifier->arrayidxs.last ) {
+            AddBackString( out, ", " );
+          }
+        }
+        AddBackString( out, "]" );
+      } break;
+      default: UnreachableCrash();
+    }
+  }
+}
+Inl void
+PrintCppVarName(
+  stack_resizeable_cont_t<u8>* out,
+  var_t* var
+  )
+{
+  AddBackString( out, "var" );
+  PrintU64( out, var->idx );
+}
+Inl void
+PrintCppVar(
+  stack_resizeable_cont_t<u8>* out,
+  var_t* var
+  )
+{
+  PrintCppType( out, &var->type );
+  AddBackString( out, " " );
+  PrintCppVarName( out, var );
+}
+Inl void
+PrintCppFndecltype(
+  stack_resizeable_cont_t<u8>* out,
+  fndecltype_t* fndecltype
+  )
+{
+  AddBackString( out, "void " );
+  PrintIdent( out, &fndecltype->ident );
+  AddBackString( out, "(\n" );
+  FORLEN( type_arg, j, fndecltype->args )
+    AddBackString( out, "  " );
+    PrintCppType( out, &type_arg->type );
+    AddBackString( out, " " );
+    PrintIdent( out, &type_arg->ident );
+    if( j + 1 != fndecltype->args.len  ||  fndecltype->rets.len ) {
+      AddBackString( out, "," );
+    }
+    AddBackString( out, "\n" );
+  }
+  FORLEN( type_ret, j, fndecltype->rets )
+    AddBackString( out, "  " );
+    PrintCppType( out, type_ret );
+    AddBackString( out, "* " ); // rets are passed as pointer args.
+    AddBackString( out, "_ret" );
+    PrintU64( out, j );
+    if( j + 1 != fndecltype->rets.len ) {
+      AddBackString( out, "," );
+    }
+    AddBackString( out, "\n" );
+  }
+  AddBackString( out, "  )" );
+}
+NoInl void
+GenerateCpp(
+  compilefile_t* ctx,
+  stack_resizeable_cont_t<u8>* out
+  )
+{
+  auto globaltypes = ctx->globaltypes;
+  AddBackString( out, "typedef int8_t      s8;\n" );
+  AddBackString( out, "typedef int16_t    s16;\n" );
+  AddBackString( out, "typedef int32_t    s32;\n" );
+  AddBackString( out, "typedef int64_t    s64;\n" );
+  AddBackString( out, "typedef uint8_t     u8;\n" );
+  AddBackString( out, "typedef uint16_t   u16;\n" );
+  AddBackString( out, "typedef uint32_t   u32;\n" );
   AddBackString( out, "typedef uint64_t   u64;\n" );
   AddBackString( out, "typedef float      f32;\n" );
   AddBackString( out, "typedef double     f64;\n" );
@@ -8212,6 +12377,147 @@ GenerateCpp(
 #endif
 
 
+// symbol lookup throughput on a generated program of about 1M lines, with deep nesting and wide scopes.
+// every function nests c_depth scopes, each declaring c_width locals that read locals from the scopes around it,
+//   and calls the function before it. sibling scopes reuse the same names, so the shadowing chains get pushed and
+//   popped constantly.
+// the parser and type checker don't build against the std-based compilefile_t yet, so this times Tokenize, and then
+//   replays the walk TypeScope does over the same tokens: '{' marks varsyms and '}' pops back to the mark, 'x :=' and
+//   args bind, and every other ident is a lookup, falling back to the type names the way the typer does.
+NoInl void
+BenchSymbols()
+{
+  constant u32 c_nfns = 2000;
+  constant u32 c_depth = 16;
+  constant u32 c_width = 32;
+
+  string src;
+  src.reserve( 64*1000*1000 );
+  idx_t nlines = 0;
+  auto AddLine = [&]( const char* fmt, auto... args )
+  {
+    char line[256];
+    auto len = snprintf( line, _countof( line ), fmt, args... );
+    src.append( line, len );
+    nlines += 1;
+  };
+  Fori( u32, f, 0, c_nfns ) {
+    AddLine( "F%u( a u32, b u32 ) u32 {\n", f );
+    Fori( u32, d, 0, c_depth ) {
+      Fori( u32, w, 0, c_width ) {
+        if( !d ) {
+          AddLine( "  v%u_%u := a + b * %u;\n", d, w, w );
+        } else {
+          AddLine( "  v%u_%u := v%u_%u + v0_%u;\n", d, w, d - 1, ( w + 1 ) % c_width, w );
+        }
+      }
+      if( f  &&  d == c_depth / 2 ) {
+        AddLine( "  c%u := F%u( v%u_0, b );\n", d, f - 1, d );
+      }
+      AddLine( "  if( v%u_0 < a ) {\n", d );
+    }
+    Fori( u32, d, 0, c_depth ) {
+      AddLine( "  }\n" );
+    }
+    AddLine( "  ret v0_0;\n" );
+    AddLine( "}\n" );
+  }
+
+  compilefile_t ctx;
+  ctx.filename = "bench.jc";
+  ctx.file = src;
+  Init( ctx.varsyms );
+  symtable_t fnsyms;
+  Init( fnsyms );
+  symtable_t typesyms;
+  Init( typesyms );
+  BindSym( typesyms, Intern( ctx.syms, "u32" ), &typesyms );
+
+  auto t0 = TimeTSC();
+  auto tokenized = Tokenize( ctx, ctx.file );
+  auto t1 = TimeTSC();
+  AssertCrash( tokenized );
+
+  stack_resizeable_cont_t<idx_t> marks;
+  Alloc( marks, 64 );
+  idx_t nlookups = 0;
+  idx_t nmisses = 0;
+  idx_t parens = 0;
+  const auto& tokens = ctx.tokens;
+  const auto ntokens = tokens.size();
+  Fori( size_t, i, 0, ntokens ) {
+    const auto& tkn = tokens[i];
+    switch( tkn.type ) {
+      case tokentype_t::paren_l: {
+        parens += 1;
+      } break;
+      case tokentype_t::paren_r: {
+        parens -= 1;
+      } break;
+      case tokentype_t::bracket_curly_l: {
+        *AddBack( marks ) = MarkSyms( ctx.varsyms );
+      } break;
+      case tokentype_t::bracket_curly_r: {
+        PopSyms( ctx.varsyms, marks.mem[ marks.len - 1 ] );
+        RemBack( marks );
+        // the fn body's '}' also pops the args.
+        if( marks.len == 1 ) {
+          PopSyms( ctx.varsyms, marks.mem[0] );
+          RemBack( marks );
+        }
+      } break;
+      case tokentype_t::ident: {
+        auto isym = Cast( u32, tkn.isym );
+        auto next = i + 1 < ntokens  ?  tokens[ i + 1 ].type  :  tokentype_t::eol;
+        void* value = Cast( void*, &tkn );
+        if( !marks.len  &&  !parens ) {
+          // fn defn; its args bind under their own mark.
+          BindSym( fnsyms, isym, value );
+          *AddBack( marks ) = MarkSyms( ctx.varsyms );
+        }
+        elif( next == tokentype_t::colon  ||  ( parens  &&  next == tokentype_t::ident ) ) {
+          BindSym( ctx.varsyms, isym, value );
+        }
+        elif( next == tokentype_t::paren_l ) {
+          nlookups += 1;
+          nmisses += !LookupSym( fnsyms, isym );
+        }
+        else {
+          nlookups += 1;
+          if( !LookupSym( ctx.varsyms, isym ) ) {
+            nmisses += !LookupSym( typesyms, isym );
+          }
+        }
+      } break;
+      default: break;
+    }
+  }
+  auto t2 = TimeTSC();
+  AssertCrash( !marks.len );
+  AssertCrash( !ctx.varsyms.bindings.len );
+  AssertCrash( !nmisses );
+
+  printf(
+    "%10s  %10s  %10s  %10s  %12s  %10s\n",
+    "lines", "tokens", "syms", "lookups", "tokenize ms", "scopes ms"
+    );
+  printf(
+    "%10llu  %10llu  %10llu  %10llu  %12.1f  %10.1f\n",
+    Cast( unsigned long long, nlines ),
+    Cast( unsigned long long, ntokens ),
+    Cast( unsigned long long, ctx.syms.texts.size() ),
+    Cast( unsigned long long, nlookups ),
+    1e3 * TimeSecFromTSC64( t1 - t0 ),
+    1e3 * TimeSecFromTSC64( t2 - t1 )
+    );
+
+  Free( marks );
+  Kill( typesyms );
+  Kill( fnsyms );
+  Kill( ctx.varsyms );
+}
+
+
 int
 Main( u8* cmdline, idx_t cmdline_len )
 {
@@ -8284,6 +12590,17 @@ Main( u8* cmdline, idx_t cmdline_len )
 //    Execute( SliceFromArray( code ), m0_start );
   }
 
+#if JC3_JIT
+  TestJit();
+#endif
+
+  idx_t bench_idx;
+  if( StringIdxScanR( &bench_idx, cmdline, cmdline_len, 0, Str( "bench" ), 5, 0, 0 ) ) {
+    BenchExecute();
+    BenchOptimize();
+    BenchSymbols();
+  }
+
 
 
 
@@ -8315,8 +12632,12 @@ Main( u8* cmdline, idx_t cmdline_len )
 
   globaltypes_t globaltypes = {};
   ctx.globaltypes = &globaltypes;
+  Init( globaltypes.fndecltype_syms );
+  Init( globaltypes.structdecltype_syms );
+  Init( globaltypes.enumdecltype_syms );
   InitBuiltinTypes( &ctx );
   Alloc( ctx.scopestack, 1000 );
+  Init( ctx.varsyms );
 
   ctx.ptr_bytecount = _SIZEOF_IDX_T;
   ctx.array_bytecount = _SIZEOF_IDX_T * 2; // note we'll do a { void* mem;  idx_t len; } impl.
@@ -8363,6 +12684,9 @@ Main( u8* cmdline, idx_t cmdline_len )
   idx_t entry_point = 0;
   Generate( &ctx, &code, &entry_point );
   PRINTERRORS;
+  bcoptstats_t optstats;
+  OptimizeCode( &code, &entry_point, &ctx.mem, c_bcpasses_default, &optstats );
+  PrintBcoptStats( &debugout, &optstats );
   auto code_slice = SliceFromArray( code );
   PrintCode( &debugout, &code_slice, entry_point );
   PRINTDEBUGOUT;
@@ -44,6 +44,7 @@ LogUI( const void* cstr ... );
 #include "cstr_float.h"
 #include "timedate.h"
 #include "thread_atomics.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
 #include "ds_mtqueue_mrmw_nonresizeable.h"
 #include "ds_mtqueue_mrsw_nonresizeable.h"
 #include "ds_mtqueue_srmw_nonresizeable.h"
@@ -73,8 +74,10 @@ LogUI( const void* cstr ... );
 #include "ui_propdb.h"
 #include "ui_font.h"
 #include "ui_render.h"
+#include "ds_linetree.h"
 #include "ui_buf2.h"
 #include "ui_txt2.h"
+#include "diff.h"
 #include "ui_diffview.h"
 
 struct
@@ -637,7 +640,7 @@ Main( stack_resizeable_cont_t<slice_t>& args )
     return -1;
   }
 
-  auto file_r = FileOpen( ML( filepath_l ), fileopen_t::only_existing, fileop_t::R, fileop_t::R );
+  auto file_r = FileOpen( ML( filepath_r ), fileopen_t::only_existing, fileop_t::R, fileop_t::R );
   if( !file_r.loaded ) {
     // TODO: better error diagnostics here.
     u8 tmp[1024];
@@ -652,7 +655,7 @@ Main( stack_resizeable_cont_t<slice_t>& args )
   }
 
   auto filecontents_l = FileAlloc( file_l );
-  auto filecontents_r = FileAlloc( file_l );
+  auto filecontents_r = FileAlloc( file_r );
   FileFree( file_r );
   FileFree( file_l );
   SetFiles( app->diff, filecontents_l, filecontents_r );
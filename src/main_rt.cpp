@@ -34,6 +34,7 @@
 #include "filesys.h"
 #include "timedate.h"
 #include "thread_atomics.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
 #include "threading.h"
 #define LOGGER_ENABLED   0
 #include "logger.h"
@@ -163,7 +164,10 @@ app_t
   u32 min_upsize_factor;
   f32 time_anim;
   f32 time_anim_period;
-  rng_xorshift32_t rt_rng;
+  u64 rt_seed;
+  rttiles_t rt_tiles; // progressive accumulation; reset whenever the camera moves.
+  vec3<f32> rt_rot;
+  vec3<f32> rt_pos;
 
   vec3<f32> rot;
   vec3<f32> pos;
@@ -210,10 +214,12 @@ AppInit( app_t& app )
   app.samples_per_pixel = 50;
   app.time_anim = 0;
   app.time_anim_period = 1000;
-  Init( app.rt_rng, 1234567890 );
+  app.rt_seed = 1234567890;
 
   app.rot = _vec3<f32>( 0.12f, -0.12f, 0 );
   app.pos = _vec3<f32>( 5, 5, 50 );
+  app.rt_rot = app.rot;
+  app.rt_pos = app.pos;
 
   app.camera_fov_y = 0.34f * f32_PI;
   app.camera_near_z = 1.0;
@@ -226,6 +232,7 @@ AppInit( app_t& app )
   Alloc( app.target_img4 );
   Alloc( app.target_img16 );
   Alloc( app.target_dep4 );
+  Init( app.rt_tiles, app.target_img16.x, app.target_img16.y, app.rt_seed );
   app.texid_target = 1;
 
 
@@ -530,6 +537,7 @@ AppKill( app_t& app )
   Free( app.target_img4 );
   Free( app.target_img16 );
 
+  Kill( app.rt_tiles );
   Kill( app.raster_tiles );
 
   ShaderKill( app.shader );
@@ -539,6 +547,8 @@ AppKill( app_t& app )
   Free( app.white_tex );
   Free( app.checker_tex );
   Free( app.meshes );
+
+  Kill( rtscene );
 }
 
 
@@ -561,7 +571,7 @@ GetRotation( app_t& app )
 Inl bool
 IsTarget4( app_t& app )
 {
-  bool r = ( app.rendermode != rendermode_t::ray );
+  bool r = ( app.rendermode != rendermode_t::ray )  &&  ( app.rendermode != rendermode_t::ray_packet );
   return r;
 }
 
@@ -601,6 +611,9 @@ __OnRender( AppOnRender )
       Init( app.target_img16, window_x / app.upsize_factor, window_y / app.upsize_factor, new_stride_x, 16 );
       Alloc( app.target_img16 );
 
+      Kill( app.rt_tiles );
+      Init( app.rt_tiles, app.target_img16.x, app.target_img16.y, app.rt_seed );
+
       printf( " reshape done: glw=( %u, %u ), target=( %u, %u, [%u] )\n", window_x, window_y, app.target_img16.x, app.target_img16.y, app.target_img16.stride_x );
 
     } else {
@@ -678,20 +691,28 @@ __OnRender( AppOnRender )
     mat3x3r<f32> rotation_world_from_camera = rotation_camera_from_world;
     Transpose( &rotation_world_from_camera );
 
+    if( !( app.rt_pos == app.pos )  ||  !( app.rt_rot == app.rot ) ) {
+      app.rt_pos = app.pos;
+      app.rt_rot = app.rot;
+      Reset( app.rt_tiles );
+    }
+
     //Metropolis(
+    //  app.target_img16,
+    //  app.rt_seed,
     Raytrace(
       app.target_img16,
-      app.rt_rng,
+      app.rt_tiles,
       app.samples_per_pixel,
       translate_world_from_camera,
       rotation_world_from_camera,
       camera_half_x,
       app.camera_half_y,
       app.camera_near_z,
-      rtmeshes,
-      rtmeshes_len,
+      rtscene,
       app.lights.mem,
-      app.lights.len
+      app.lights.len,
+      app.rendermode
       );
 
     if( g_do_edge_blurring ) {
@@ -934,6 +955,12 @@ __OnKeyEvent( AppOnKeyEvent )
           app.reshape_required = 1;
           printf( "rendermode: ray\n" );
         } break;
+
+        case glwkey_t::num_5: {
+          app.rendermode = rendermode_t::ray_packet;
+          app.reshape_required = 1;
+          printf( "rendermode: ray_packet\n" );
+        } break;
       }
     } break;
 
@@ -973,11 +1000,330 @@ __OnMouseEvent( AppOnMouseEvent )
 }
 
 
+// ============================================================================
+// TRACE BENCHMARK
+//
+// Run with "bench" on the cmdline. Reports primary ray throughput for the brute force Trace vs.
+// the BVH Trace, on the existing scenes plus a procedural ~1M triangle heightfield.
+//
+
+// Bumpy heightfield of 2 * n * n triangles, spanning [-1,1] in model space x and z.
+Inl void
+InitHeightfield( rtmesh_t& mesh, u32 n )
+{
+  ProfFunc();
+
+  mesh = {};
+  mesh.reflectance = _vec3( 1.0f );
+  Alloc( mesh.tris, 2 * n * n );
+
+  auto height = [n]( u32 i, u32 j )
+  {
+    auto x = Cast( f32, i ) / n;
+    auto z = Cast( f32, j ) / n;
+    return _vec3<f32>(
+      2 * x - 1,
+      0.1f * Sin32( 23.0f * x ) * Cos32( 17.0f * z ) + 0.02f * Sin32( 131.0f * x * z ),
+      2 * z - 1
+      );
+  };
+
+  Fori( u32, j, 0, n ) {
+  Fori( u32, i, 0, n ) {
+    auto p00 = height( i + 0, j + 0 );
+    auto p10 = height( i + 1, j + 0 );
+    auto p01 = height( i + 0, j + 1 );
+    auto p11 = height( i + 1, j + 1 );
+    vec3<f32> corners[2][3] = {
+      { p00, p01, p10 },
+      { p11, p10, p01 },
+    };
+    For( k, 0, 2 ) {
+      auto tri = AddBack( mesh.tris );
+      tri->p = corners[k][0];
+      tri->e0 = corners[k][1] - corners[k][0];
+      tri->e1 = corners[k][2] - corners[k][0];
+      tri->n = Cross( tri->e0, tri->e1 );
+      tri->twice_surface_area_model = Length( tri->n );
+      tri->n /= tri->twice_surface_area_model;
+      mesh.surface_area_model += 0.5f * tri->twice_surface_area_model;
+    }
+  }
+  }
+
+  Identity( &mesh.rotation_world_from_model );
+  Transpose( &mesh.rotation_model_from_world, mesh.rotation_world_from_model );
+  mesh.scale_world_from_model = 15.0f;
+  mesh.scale_model_from_world = 1 / mesh.scale_world_from_model;
+  mesh.translation_world = _vec3<f32>( 0, -10, 0 );
+  mesh.radiance_emit = _vec3( 0.0f );
+}
+
+Enumc( tracebench_t )
+{
+  brute,
+  bvh,
+  packet,
+};
+
+Inl void
+BenchmarkTrace(
+  const char* name,
+  rtscene_t& scene,
+  tracebench_t mode,
+  u32 res,
+  u32 max_rays
+  )
+{
+  // Same camera as AppInit.
+  auto rot = _vec3<f32>( 0.12f, -0.12f, 0 );
+  auto translate_world_from_camera = _vec3<f32>( 5, 5, 50 );
+  f32 camera_near_z = 1.0f;
+  f32 camera_half_y = camera_near_z * Tan32( 0.5f * 0.34f * f32_PI );
+  f32 camera_half_x = camera_half_y;
+
+  mat3x3r<f32> rotation_x, rotation_y, rotation_z, rotation_xy, rotation_world_from_camera;
+  RotateX( &rotation_x, rot.x );
+  RotateY( &rotation_y, rot.y );
+  RotateZ( &rotation_z, rot.z );
+  Mul( &rotation_xy, rotation_x, rotation_y );
+  Mul( &rotation_world_from_camera, rotation_z, rotation_xy );
+  Transpose( &rotation_world_from_camera );
+
+  auto RayFromPixel = [&]( u32 x, u32 y, vec3<f32>& ray_p, vec3<f32>& ray_d )
+  {
+    f32 cx = ( x + 0.5f ) / res;
+    f32 cy = ( y + 0.5f ) / res;
+    auto ray_d_cam = _vec3<f32>(
+      ( 2 * cx - 1 ) * camera_half_x,
+      ( 2 * cy - 1 ) * camera_half_y,
+      -camera_near_z
+      );
+    Mul( &ray_d, rotation_world_from_camera, ray_d_cam );
+    ray_p = translate_world_from_camera + ray_d;
+    ray_d = Normalize( ray_d );
+  };
+
+  constant f32 t_min_world = 1e-3f;
+
+  u64 num_rays = 0;
+  u64 num_hits = 0;
+  auto t0 = TimeClock();
+  if( mode == tracebench_t::packet ) {
+    // Packets are 2x2 pixel quads, for coherence.
+    AssertCrash( res % 2 == 0 );
+    for( u32 y = 0;  y < res;  y += 2 ) {
+    for( u32 x = 0;  x < res;  x += 2 ) {
+      vec3<f32> ray_ps[4];
+      vec3<f32> ray_ds[4];
+      bool actives[4] = { 1, 1, 1, 1 };
+      Fori( u32, lane, 0, 4 ) {
+        RayFromPixel( x + ( lane & 1 ), y + ( lane >> 1 ), ray_ps[lane], ray_ds[lane] );
+      }
+      hit_t hits[4];
+      TracePacket( hits, scene, ray_ps, ray_ds, actives, t_min_world );
+      Fori( u32, lane, 0, 4 ) {
+        num_rays += 1;
+        num_hits += Valid( hits[lane] );
+      }
+    }
+    }
+  } else {
+    // For slow configurations, we trace a strided subset of the image.
+    auto num_px = res * res;
+    auto stride = MAX( 1, num_px / MAX( max_rays, 1 ) );
+    for( u32 px = 0;  px < num_px;  px += stride ) {
+      vec3<f32> ray_p;
+      vec3<f32> ray_d;
+      RayFromPixel( px % res, px / res, ray_p, ray_d );
+      auto hit = ( mode == tracebench_t::brute )  ?
+        TraceBruteForce( scene, ray_p, ray_d, t_min_world )  :
+        Trace( scene, ray_p, ray_d, t_min_world );
+      num_rays += 1;
+      num_hits += Valid( hit );
+    }
+  }
+  auto t1 = TimeClock();
+  auto sec = TimeSecFromClocks64( t1 - t0 );
+
+  const char* mode_names[] = { "brute", "bvh", "packet" };
+  printf(
+    "%-12s %-6s rays: %8llu  hits: %8llu  time: %9.3f ms  rays/sec: %12.0f\n",
+    name,
+    mode_names[Cast( idx_t, mode )],
+    Cast( unsigned long long, num_rays ),
+    Cast( unsigned long long, num_hits ),
+    1000 * sec,
+    num_rays / MAX( sec, 1e-9 )
+    );
+}
+
+Inl void
+BenchmarkScene(
+  const char* name,
+  rtmesh_t* meshes[],
+  idx_t meshes_len,
+  u32 max_rays_brute_force
+  )
+{
+  idx_t num_primitives = 0;
+
+  auto t0 = TimeClock();
+  rtscene_t scene;
+  Init( scene, meshes, meshes_len );
+  auto t1 = TimeClock();
+
+  num_primitives = scene.primrefs.len;
+  printf(
+    "%-12s primitives: %llu  bvh nodes: %llu  bvh depth: %u  build: %.3f ms\n",
+    name,
+    Cast( unsigned long long, num_primitives ),
+    Cast( unsigned long long, scene.nodes.len ),
+    scene.depth,
+    1000 * TimeSecFromClocks64( t1 - t0 )
+    );
+
+  constant u32 res = 256;
+  BenchmarkTrace( name, scene, tracebench_t::brute, res, max_rays_brute_force );
+  BenchmarkTrace( name, scene, tracebench_t::bvh, res, MAX_u32 );
+  BenchmarkTrace( name, scene, tracebench_t::packet, res, MAX_u32 );
+
+  Kill( scene );
+}
+
+// Renders the same frame with 1, 2, 4, ... workers, checking the output is bit-identical to the 1-worker render.
+Inl void
+BenchmarkRaytraceThreads( rtscene_t& scene, rtmesh_t* lights[], idx_t lights_len )
+{
+  auto rot = _vec3<f32>( 0.12f, -0.12f, 0 );
+  auto translate_world_from_camera = _vec3<f32>( 5, 5, 50 );
+  f32 camera_near_z = 1.0f;
+  f32 camera_half_y = camera_near_z * Tan32( 0.5f * 0.34f * f32_PI );
+  f32 camera_half_x = camera_half_y;
+
+  mat3x3r<f32> rotation_x, rotation_y, rotation_z, rotation_xy, rotation_world_from_camera;
+  RotateX( &rotation_x, rot.x );
+  RotateY( &rotation_y, rot.y );
+  RotateZ( &rotation_z, rot.z );
+  Mul( &rotation_xy, rotation_x, rotation_y );
+  Mul( &rotation_world_from_camera, rotation_z, rotation_xy );
+  Transpose( &rotation_world_from_camera );
+
+  constant u32 res = 256;
+  constant u32 samples_per_pixel = 16;
+  constant u64 seed = 1234567890;
+
+  img_t img_reference;
+  Init( img_reference, res, res, res, 16 );
+  Alloc( img_reference );
+
+  img_t img;
+  Init( img, res, res, res, 16 );
+  Alloc( img );
+
+  auto max_workers = g_mainthread.taskthreads.len + 1;
+  f64 sec_1 = 0;
+  for( idx_t num_workers = 1;  ;  num_workers = MIN( 2 * num_workers, max_workers ) ) {
+    rttiles_t tiles;
+    Init( tiles, res, res, seed );
+
+    auto t0 = TimeClock();
+    Raytrace(
+      img,
+      tiles,
+      samples_per_pixel,
+      translate_world_from_camera,
+      rotation_world_from_camera,
+      camera_half_x,
+      camera_half_y,
+      camera_near_z,
+      scene,
+      lights,
+      lights_len,
+      rendermode_t::ray,
+      num_workers
+      );
+    auto t1 = TimeClock();
+    auto sec = TimeSecFromClocks64( t1 - t0 );
+
+    if( num_workers == 1 ) {
+      sec_1 = sec;
+      Memmove( img_reference.mem.mem, ML( img.mem ) );
+    }
+    bool identical = MemEqual( ML( img_reference.mem ), ML( img.mem ) );
+
+    printf(
+      "raytrace     workers: %3llu  time: %9.3f ms  speedup: %6.2fx  identical: %u\n",
+      Cast( unsigned long long, num_workers ),
+      1000 * sec,
+      sec_1 / MAX( sec, 1e-9 ),
+      identical
+      );
+    AssertWarn( identical );
+
+    Kill( tiles );
+
+    if( num_workers == max_workers ) {
+      break;
+    }
+  }
+
+  Free( img );
+  Free( img_reference );
+}
+
+Inl void
+BenchmarkScenes()
+{
+  // makes accessible the statics:
+  //   rtmeshes*[]
+  //   rtmeshes_len
+  InitScene();
+
+  BenchmarkScene( "default", rtmeshes, rtmeshes_len, MAX_u32 );
+
+  rtmesh_t* lights[] = { &rtmesh_light, &rtmesh_light2 };
+  BenchmarkRaytraceThreads( rtscene, AL( lights ) );
+
+  rtmesh_t* meshes_all[] = {
+    &rtmesh_box,
+    &rtmesh_b,
+    &rtmesh_tri,
+    &rtmesh_s,
+    &rtmesh_light,
+    &rtmesh_light2,
+    &rtmesh_c,
+    &rtmesh_cone,
+  };
+  BenchmarkScene( "all", AL( meshes_all ), MAX_u32 );
+
+  // 2 * 708^2 ~= 1M triangles.
+  rtmesh_t rtmesh_heightfield;
+  InitHeightfield( rtmesh_heightfield, 708 );
+  rtmesh_t* meshes_big[] = {
+    &rtmesh_box,
+    &rtmesh_light,
+    &rtmesh_light2,
+    &rtmesh_heightfield,
+  };
+  BenchmarkScene( "heightfield", AL( meshes_big ), 256 );
+  Free( rtmesh_heightfield.tris );
+
+  Kill( rtscene );
+}
+
+
 int
 Main( u8* cmdline, idx_t cmdline_len )
 {
 //  u8* filename = Str( "c:/doc/dev/cpp/master/rt/output.png" );
 
+  idx_t bench_idx;
+  if( StringIdxScanR( &bench_idx, cmdline, cmdline_len, 0, Str( "bench" ), 5, 0, 0 ) ) {
+    BenchmarkScenes();
+    return 0;
+  }
+
   app_t app;
   AppInit( app );
 
@@ -0,0 +1,255 @@
+// build:console_x64_optimized
+// Copyright (c) John A. Carlos Jr., all rights reserved.
+
+#define FINDLEAKS 0
+#include "core_cruntime.h"
+#include "core_types.h"
+#include "core_language_macros.h"
+#include "os_mac.h"
+#include "os_windows.h"
+#include "memory_operations.h"
+#include "asserts.h"
+#include "math_integer.h"
+#include "math_float.h"
+#include "math_lerp.h"
+#include "math_floatvec.h"
+#include "math_matrix.h"
+#include "math_kahansummation.h"
+#include "allocator_heap.h"
+#include "allocator_virtual.h"
+#include "allocator_heap_or_virtual.h"
+#include "cstr.h"
+#include "ds_slice.h"
+#include "ds_string.h"
+#include "allocator_pagelist.h"
+#include "ds_stack_resizeable_cont.h"
+#include "ds_stack_nonresizeable_stack.h"
+#include "ds_stack_nonresizeable.h"
+#include "ds_stack_resizeable_pagelist.h"
+#include "ds_list.h"
+#include "ds_stack_cstyle.h"
+#include "ds_hashset_cstyle.h"
+#include "filesys.h"
+#include "cstr_integer.h"
+#include "timedate.h"
+#include "thread_atomics.h"
+#include "ds_mtqueue_mrmw_nonresizeable.h"
+#include "ds_mtqueue_mrsw_nonresizeable.h"
+#include "ds_mtqueue_srmw_nonresizeable.h"
+#include "ds_mtqueue_srsw_nonresizeable.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
+#include "threading.h"
+#define LOGGER_ENABLED   0
+#include "logger.h"
+#include "asserts_ship.h"
+#define PROF_ENABLED   0
+#define PROF_ENABLED_AT_LAUNCH   0
+#include "profile.h"
+#include "rand.h"
+#include "allocator_heap_findleaks.h"
+#include "mainthread.h"
+#include "text_parsing.h"
+#include "trigramindex.h"
+
+struct
+searchbench_key_t
+{
+  slice_t key;
+  bool case_sens;
+  bool word_boundary;
+};
+
+// counts every match in contents, the same way find-in-files walks a file.
+Templ Inl idx_t
+CountMatches( string_t& contents, searchbench_key_t& k, T Search )
+{
+  idx_t count = 0;
+  idx_t pos = 0;
+  idx_t found;
+  while( pos < contents.len  &&  Search( &found, ML( contents ), pos, ML( k.key ), k.case_sens, k.word_boundary ) ) {
+    count += 1;
+    pos = found + 1;
+  }
+  return count;
+}
+
+Inl
+FS_ITERATOR( _IterSearchbenchAddFile )
+{
+  if( is_file ) {
+    auto update = Cast( trigramindex_update_t*, misc );
+    TrigramIndexUpdateAddFile( *update, name, len, filesize, filetime );
+  }
+  return fsiter_result_t::continue_;
+}
+
+int
+Main( u8** args, idx_t args_len )
+{
+  printf( "Benchmarks substring search over every file in the CWD, recursing down.\n" );
+  printf( "Compares the reference scan, the vectorized scan, and trigram index queries.\n" );
+  printf( "Specify search keys as arguments, or leave them off to use a default set.\n" );
+  printf( "Ex: \"searchbench Alloc StringIdxScanR\"\n\n" );
+
+  fsobj_t cwd;
+  FsGetCwd( cwd );
+
+  // build the index from scratch, ignoring whatever's on disk, so we measure a full build.
+  auto index_filename = TrigramIndexFilename( ML( cwd ) );
+  trigramindex_update_t update;
+  Init( update, 0, index_filename );
+  auto t0 = TimeTSC();
+  FsIterate( ML( cwd ), 1, _IterSearchbenchAddFile, &update );
+  auto t1 = TimeTSC();
+  TrigramIndexUpdatePrepare( update );
+  TrigramIndexUpdateStart( update );
+  while( !update.done ) {
+    TimeSleep( 1 );
+  }
+  auto t2 = TimeTSC();
+  printf( "enumerated %llu files in %.1f ms.\n", Cast( unsigned long long, update.entries.len ), 1000 * TimeSecFromTSC64( t1 - t0 ) );
+  printf(
+    "built trigram index in %.1f ms on %llu taskthreads: %llu MB read, %llu KB index at %s\n",
+    1000 * TimeSecFromTSC64( t2 - t1 ),
+    Cast( unsigned long long, g_mainthread.taskthreads.len ),
+    Cast( unsigned long long, update.bytes_read / ( 1024 * 1024 ) ),
+    Cast( unsigned long long, update.result.size / 1024 ),
+    index_filename.mem
+    );
+  trigramindex_t index;
+  AssertCrash( TrigramIndexUpdateInstall( update, index ) );
+  Kill( update );
+
+  // an incremental update with nothing changed is just the enumeration plus the diff.
+  Init( update, &index, index_filename );
+  t0 = TimeTSC();
+  FsIterate( ML( cwd ), 1, _IterSearchbenchAddFile, &update );
+  TrigramIndexUpdatePrepare( update );
+  t1 = TimeTSC();
+  printf(
+    "incremental check in %.1f ms: %llu files to reread, %llu removed.\n\n",
+    1000 * TimeSecFromTSC64( t1 - t0 ),
+    Cast( unsigned long long, update.stale.len ),
+    Cast( unsigned long long, update.num_removed )
+    );
+  Kill( update );
+
+  // load contents in index order, so query results index straight into this.
+  stack_resizeable_cont_t<string_t> contents;
+  Alloc( contents, NumFiles( index ) );
+  idx_t total_len = 0;
+  For( i, 0, NumFiles( index ) ) {
+    auto name = FileName( index, i );
+    auto file = FileOpen( ML( name ), fileopen_t::only_existing, fileop_t::R, fileop_t::R );
+    auto content = AddBack( contents );
+    *content = {};
+    if( !file.loaded ) continue;
+    *content = FileAlloc( file );
+    FileFree( file );
+    total_len += content->len;
+  }
+  printf( "loaded %llu files, %llu bytes.\n\n", Cast( unsigned long long, contents.len ), Cast( unsigned long long, total_len ) );
+
+  stack_resizeable_cont_t<searchbench_key_t> keys;
+  Alloc( keys, 32 );
+  if( args_len ) {
+    For( i, 0, args_len ) {
+      For( flags, 0, 4 ) {
+        auto k = AddBack( keys );
+        k->key = SliceFromCStr( args[i] );
+        k->case_sens = flags & 1;
+        k->word_boundary = flags & 2;
+      }
+    }
+  } else {
+    // short, medium, and long keys, with and without case and word_boundary.
+    searchbench_key_t defaults[] = {
+      { SliceFromCStr( "i" ), 1, 1 },
+      { SliceFromCStr( "idx_t" ), 1, 0 },
+      { SliceFromCStr( "idx_t" ), 0, 1 },
+      { SliceFromCStr( "AssertCrash" ), 1, 0 },
+      { SliceFromCStr( "assertcrash" ), 0, 0 },
+      { SliceFromCStr( "StringIdxScanR" ), 1, 1 },
+      { SliceFromCStr( "zzzz_not_in_any_file" ), 0, 0 },
+      { SliceFromCStr( "// Copyright (c) John A. Carlos Jr., all rights reserved." ), 1, 0 },
+      { SliceFromCStr( "copyright (c) john a. carlos jr., all rights reserved." ), 0, 0 },
+      };
+    ForEach( k, defaults ) {
+      *AddBack( keys ) = k;
+    }
+  }
+
+  stack_resizeable_cont_t<u32> candidates;
+  Alloc( candidates, NumFiles( index ) );
+
+  printf(
+    "%-32s  case  word  %8s  %8s  %8s  %8s  %10s  %10s  %8s\n",
+    "key", "matches", "ref GB/s", "fast GB/s", "speedup", "candidates", "index ms", "scan ms"
+    );
+  ForLen( i, keys ) {
+    auto& k = keys.mem[i];
+
+    idx_t count_ref = 0;
+    t0 = TimeTSC();
+    ForLen( j, contents ) {
+      count_ref += CountMatches( contents.mem[j], k, StringSearchReference );
+    }
+    t1 = TimeTSC();
+    idx_t count_fast = 0;
+    ForLen( j, contents ) {
+      count_fast += CountMatches( contents.mem[j], k, StringSearch );
+    }
+    t2 = TimeTSC();
+    candidates.len = 0;
+    TrigramIndexQuery( index, candidates, ML( k.key ) );
+    idx_t count_index = 0;
+    ForLen( j, candidates ) {
+      count_index += CountMatches( contents.mem[ candidates.mem[j] ], k, StringSearch );
+    }
+    auto t3 = TimeTSC();
+    AssertCrash( count_ref == count_fast );
+    AssertCrash( count_ref == count_index );
+
+    auto sec_ref = TimeSecFromTSC64( t1 - t0 );
+    auto sec_fast = TimeSecFromTSC64( t2 - t1 );
+    auto sec_index = TimeSecFromTSC64( t3 - t2 );
+    auto gb = total_len / 1e9;
+    printf(
+      "%-32.*s  %4u  %4u  %8llu  %8.2f  %8.2f  %7.1fx  %10llu  %10.3f  %8.3f\n",
+      Cast( int, MIN( k.key.len, 32u ) ), k.key.mem,
+      k.case_sens,
+      k.word_boundary,
+      Cast( unsigned long long, count_fast ),
+      gb / sec_ref,
+      gb / sec_fast,
+      sec_ref / sec_fast,
+      Cast( unsigned long long, candidates.len ),
+      1000 * sec_index,
+      1000 * sec_fast
+      );
+  }
+
+  Free( candidates );
+  ForLen( i, contents ) {
+    Free( contents.mem[i] );
+  }
+  Free( contents );
+  Free( keys );
+  Free( index );
+
+  return 0;
+}
+
+
+
+
+int
+main( int argc, char** argv )
+{
+  MainInit();
+
+  int r = Main( Cast( u8**, &argv[1] ), argc - 1 );
+
+  MainKill();
+  return r;
+}
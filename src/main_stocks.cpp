@@ -38,6 +38,7 @@
 #include "cstr_float.h"
 #include "timedate.h"
 #include "thread_atomics.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
 #include "ds_mtqueue_srsw_nonresizeable.h"
 #include "ds_mtqueue_srmw_nonresizeable.h"
 #include "ds_mtqueue_mrsw_nonresizeable.h"
@@ -54,6 +55,8 @@
 #include "allocator_heap_findleaks.h"
 #include "mainthread.h"
 #include "text_parsing.h"
+#include "csv_ingest.h"
+#include "colcache.h"
 #include "ds_stack_resizeable_cont_addbacks.h"
 #include "sparse2d_compressedsparserow.h"
 
@@ -119,296 +122,39 @@ csv_column_t
   bool is_all_usd; // true when the column contains all $-prefixed values.
 };
 
+// whether the columnar caches we write are compressed. uncompressed ones get mapped straight into the columns,
+// compressed ones are several times smaller on disk, but get decoded on load.
+constant bool c_csvcache_compress = 0;
+
 struct
 csv_t
 {
-  string_t csv; // file contents
+  filemapped_t file; // file contents
+  csvingest_t ingest; // the csv cells in column-major order, pointing into file, or into ingest.unescaped.
+  colcache_t cache; // instead of file and ingest, when we loaded from the cache. there's no column strings then.
   string_t table_name;
   idx_t ncolumns;
   u32 nrows;
-  tstring_t<slice_t> alloc_cells; // the csv cells in column-major order in one block allocation (excluding headers)
-  tstring_t<f64> alloc_cells_numeric;
-  tstring_t<slice_t> headers; // headers per-column.
+  tslice_t<slice_t> headers; // headers per-column.
   tstring_t<csv_column_t> columns; // 2-D indexed column-major csv cells.
 };
 
 Inl void
 Kill( csv_t* table )
 {
-  Free( table->alloc_cells );
-  Free( table->alloc_cells_numeric );
   Free( table->columns );
-  Free( table->headers );
-  Free( table->csv );
+  Kill( &table->ingest );
+  FileFree( table->file );
+  Free( table->cache );
   Free( table->table_name );
 }
 
-Inl void
-ParseNumeric(
-  slice_t value,
-  f64* numeric,
-  bool* is_numeric
-  )
-{
-  *numeric = 0;
-  *is_numeric = 0;
-
-  bool found_num = 0;
-  idx_t offset_num_start = 0;
-  bool num_negative = 0;
-  auto curr = value.mem;
-  auto len = value.len;
-  if( curr[0] == '-' ) {
-    idx_t offset = 1;
-    while( offset < len  &&  AsciiIsSpaceTab( curr[offset] ) ) {
-      offset += 1;
-    }
-    if( offset < len ) {
-      if( AsciiIsNumber( curr[offset] ) ) {
-        found_num = 1;
-        num_negative = 1;
-        offset_num_start = offset;
-      }
-    }
-  }
-  elif( AsciiIsNumber( curr[0] ) ) {
-    found_num = 1;
-    num_negative = 0;
-    offset_num_start = 0;
-  }
-  if( found_num ) {
-    // we've determined AsciiIsNumber( curr[offset_num_start] )
-    idx_t offset = 1;
-    bool seen_dot = 0;
-    bool seen_e = 0;
-    // TODO: negative exponents
-    // bool seen_e_negativesign = 0;
-    while( offset < len ) {
-      auto c = curr[offset];
-      if( AsciiIsNumber( c ) ) {
-        offset += 1;
-        continue;
-      }
-      elif( c == '.' ) {
-        if( seen_dot ) {
-          // "numbers can only have one decimal point!"
-          return;
-        }
-        if( seen_e ) {
-          // "number exponent can't contain a decimal point!"
-          return;
-        }
-        seen_dot = 1;
-        offset += 1;
-        continue;
-      }
-      elif( c == 'e'  ||  c == 'E' ) {
-        if( seen_e ) {
-          // "numbers can only have one exponent!"
-          return;
-        }
-        seen_e = 1;
-        offset += 1;
-        continue;
-      }
-      else {
-        // "unexpected character within a number!"
-        return;
-      }
-      break;
-    }
-    *is_numeric = 1;
-    *numeric = CsTo_f64( ML( value ) ); // TODO: use our own instead.
-  }
-}
-enum
-date_order_t
-{
-  ymd = 1u << 0,
-  mdy = 1u << 1,
-  dym = 1u << 2,
-  ydm = 1u << 3,
-  dmy = 1u << 4,
-  myd = 1u << 5,
-};
-ENUM_IS_BITMASK( date_order_t );
-struct
-date_t
-{
-  date_order_t order;
-  u32 slots[3];
-};
-Inl void
-UnpackDate(
-  date_t date,
-  u32* dd,
-  u32* mm,
-  u32* yyyy
-  )
-{
-  AssertCrash( _popcnt_idx_t( date.order ) == 1u );
-  switch( date.order ) {
-    case date_order_t::ymd: {
-      *yyyy = date.slots[0];
-      *mm   = date.slots[1];
-      *dd   = date.slots[2];
-    } break;
-    case date_order_t::mdy: {
-      *yyyy = date.slots[2];
-      *mm   = date.slots[0];
-      *dd   = date.slots[1];
-    } break;
-    case date_order_t::dym: {
-      *yyyy = date.slots[1];
-      *mm   = date.slots[2];
-      *dd   = date.slots[0];
-    } break;
-    case date_order_t::ydm: {
-      *yyyy = date.slots[0];
-      *mm   = date.slots[2];
-      *dd   = date.slots[1];
-    } break;
-    case date_order_t::dmy: {
-      *yyyy = date.slots[2];
-      *mm   = date.slots[1];
-      *dd   = date.slots[0];
-    } break;
-    case date_order_t::myd: {
-      *yyyy = date.slots[1];
-      *mm   = date.slots[0];
-      *dd   = date.slots[2];
-    } break;
-  }
-}
-struct
-parsed_number_t
-{
-  f64 numeric;
-  date_t date;
-  bool is_numeric;
-  bool is_datetime;
-  bool is_usd;
-};
-ForceInl void
-ParseDate(
-  stack_resizeable_cont_t<slice_t>* buffer,
-  slice_t value,
-  parsed_number_t* result
-  )
-{
-  buffer->len = 0;
-  Reserve( *buffer, 4 );
-  // Each split character is OR'ed when splitting, so the presence of any will cause a split.
-  auto split_chars = SliceFromCStr( "-/" );
-  SplitBy( buffer, split_chars, ML( value ) );
-  if( buffer->len == 1 ) {
-    // Handle dates without separators, like: "20120129"
-    // TODO: handle all possible orderings of ymd in this case.
-    //   it requires more possibilities than date_t.order at the moment, since the 3 integer values aren't
-    //   decided just yet. Or maybe we try the 3 possible slicings here, and error if more than one works?
-    if( value.len == 8 ) {
-      bool all_numbers = 1;
-      ForLen( i, value ) {
-        auto c = value.mem[i];
-        all_numbers &= ( '0' <= c  &&  c <= '9' );
-      }
-      if( all_numbers ) {
-        buffer->mem[0] = { value.mem, 4 };
-        buffer->mem[1] = { value.mem + 4, 2 };
-        buffer->mem[2] = { value.mem + 6, 2 };
-        buffer->len = 3;
-      }
-    }
-  }
-
-  if( buffer->len != 3 ) {
-    return;
-  }
-
-  auto string0 = TrimSpacetabsPrefixAndSuffix( buffer->mem[0] );
-  u32 val0;
-  bool parsed0;
-  CsToIntegerU<u32>( &val0, &parsed0, ML( string0 ), 0 );
-  auto string1 = TrimSpacetabsPrefixAndSuffix( buffer->mem[1] );
-  u32 val1;
-  bool parsed1;
-  CsToIntegerU<u32>( &val1, &parsed1, ML( string1 ), 0 );
-  auto string2 = TrimSpacetabsPrefixAndSuffix( buffer->mem[2] );
-  u32 val2;
-  bool parsed2;
-  CsToIntegerU<u32>( &val2, &parsed2, ML( string2 ), 0 );
-  if( !parsed0 || !parsed1 || !parsed2 ) {
-    return;
-  }
-  // Use posix 32bit year bounds, since our CRT uses that.
-  constant u32 minyear = 1900;
-  constant u32 maxyear = 2037;
-  constant u32 minmonth = 1;
-  constant u32 maxmonth = 12;
-  constant u32 minday = 1;
-  constant u32 maxday = 31;
-  auto valid_y_0 = LTEandLTE( val0, minyear, maxyear );
-  auto valid_y_1 = LTEandLTE( val1, minyear, maxyear );
-  auto valid_y_2 = LTEandLTE( val2, minyear, maxyear );
-  auto valid_m_0 = LTEandLTE( val0, minmonth, maxmonth );
-  auto valid_m_1 = LTEandLTE( val1, minmonth, maxmonth );
-  auto valid_m_2 = LTEandLTE( val2, minmonth, maxmonth );
-  auto valid_d_0 = LTEandLTE( val0, minday, maxday );
-  auto valid_d_1 = LTEandLTE( val1, minday, maxday );
-  auto valid_d_2 = LTEandLTE( val2, minday, maxday );
-  date_t date = {};
-  date.slots[0] = val0;
-  date.slots[1] = val1;
-  date.slots[2] = val2;
-  if( valid_y_0 && valid_m_1 && valid_d_2 ) date.order |= date_order_t::ymd;
-  if( valid_m_0 && valid_d_1 && valid_y_2 ) date.order |= date_order_t::mdy;
-  if( valid_d_0 && valid_y_1 && valid_m_2 ) date.order |= date_order_t::dym;
-  if( valid_y_0 && valid_d_1 && valid_m_2 ) date.order |= date_order_t::ydm;
-  if( valid_d_0 && valid_m_1 && valid_y_2 ) date.order |= date_order_t::dmy;
-  if( valid_m_0 && valid_y_1 && valid_d_2 ) date.order |= date_order_t::myd;
-  result->date = date;
-  result->is_datetime = 1;
-}
-ForceInl void
-ParseNumericOrDatetimeOrUsd(
-  stack_resizeable_cont_t<slice_t>* buffer,
-  slice_t value,
-  parsed_number_t* result
-  )
-{
-  *result = {};
-
-  value = TrimSpacetabsPrefixAndSuffix( value );
-  if( !value.len ) return;
-
-  // USD parsing
-  if( value.mem[0] == '$' ) {
-    result->is_usd = 1;
-    value.mem += 1;
-    value.len -= 1;
-    value = TrimSpacetabsPrefixAndSuffix( value );
-    if( !value.len ) return;
-    ParseNumeric( value, &result->numeric, &result->is_numeric );
-    if( result->is_numeric ) return;
-  }
-
-  // datetime parsing
-  ParseDate( buffer, value, result );
-  // WARNING: some values are both datetime-like and numeric-like. E.g. "20120128"
-  // So for these, we want to set is_datetime=1 and is_numeric=1.
-  // It's up to the calling column-parsing logic to decide which way to treat these.
-  //if( result->is_datetime ) return;
-
-  // Final numeric parsing for standalone numerics.
-  ParseNumeric( value, &result->numeric, &result->is_numeric );
-  if( result->is_numeric ) return;
-}
-
 int
 LoadCsv( slice_t path, csv_t* table )
 {
-  auto file = FileOpen( ML( path ), fileopen_t::only_existing, fileop_t::R, fileop_t::R );
-  if( !file.loaded ) {
+  u64 source_size;
+  u64 source_time;
+  if( !FileSizeAndTimeLastWrite( ML( path ), &source_size, &source_time ) ) {
     auto mem = AllocCstr( path );
     printf( "Failed to load file: %s\n", mem );
     MemHeapFree( mem );
@@ -416,204 +162,92 @@ LoadCsv( slice_t path, csv_t* table )
   }
 
   // Note we already stripped double-quotes above.
-  auto filename_only = FileNameOnly( ML( file.obj ) );
+  auto filename_only = FileNameOnly( ML( path ) );
   auto table_name = AllocString( filename_only.len );
   TMove( table_name.mem, ML( filename_only ) );
 
-  auto csv = FileAlloc( file );
-  FileFree( file );
-
-  // parse the csv into columns.
-  u32 nlines = CountNewlines( ML( csv ) ) + 1;
-  stack_resizeable_cont_t<slice32_t> lines;
-  Alloc( lines, nlines );
-  SplitIntoLines( &lines, ML( csv ) );
-  AssertCrash( lines.len );
-  AssertCrash( nlines == lines.len );
-
-  // remove empty lines
-  // TODO: optimal ordered contiguoize. This is n^2
-  For( i, 0, lines.len ) {
-    auto line = lines.mem[i];
-    if( !line.len ) {
-      RemAt( lines, i );
-      i -= 1;
+  // if the csv hasn't changed since we last parsed it, use the columns we cached then.
+  auto cache_filename = ColCacheFilename( ML( path ) );
+  colcache_t cache;
+  if( ColCacheLoad( cache, ML( cache_filename ), path, source_size, source_time ) ) {
+    auto ncolumns = Cast( idx_t, cache.header->ncolumns );
+    auto nrows = Cast( u32, cache.header->nrows );
+    auto columns = AllocString<csv_column_t>( ncolumns );
+    For( x, 0, ncolumns ) {
+      auto column = columns.mem + x;
+      auto flags = cache.columns[x].flags;
+      column->string = {};
+      column->numeric = cache.values.mem[x];
+      column->is_numeric = flags & c_colcache_numeric;
+      column->is_datetime = flags & c_colcache_datetime;
+      column->is_mixed_string_numeric = flags & c_colcache_mixed_string_numeric;
+      column->is_all_usd = flags & c_colcache_all_usd;
     }
+    *table = {};
+    table->cache = cache;
+    table->table_name = table_name;
+    table->ncolumns = ncolumns;
+    table->nrows = nrows;
+    table->headers = cache.names;
+    table->columns = columns;
+    return 0;
   }
-  nlines = Cast( u32, lines.len );
-  AssertCrash( nlines );
-
-  auto nrows = nlines - 1;
-  auto line_headers = lines.mem[0];
-  AssertCrash( line_headers.len ); // TODO: More robust whitespace parsing support, handling empty lines.
-  auto ncolumns = CountCommas( ML( line_headers ) ) + 1; // TODO: double-quote parsing support.
-  AssertCrash( ncolumns );
-  // store the csv cells in column-major order in one block allocation.
-  auto alloc_cells = AllocString<slice_t>( nrows * ncolumns );
-  auto alloc_cells_numeric = AllocString<f64>( nrows * ncolumns );
-  // we'll leave the headers and column-index as separate allocations for now, for convenience.
-  auto headers = AllocString<slice_t>( ncolumns );
-  stack_resizeable_cont_t<slice_t> entries;
-  Alloc( entries, ncolumns );
-  SplitByCommas( &entries, ML( line_headers ) );
-  AssertCrash( ncolumns == entries.len );
-  For( x, 0, ncolumns ) {
-    headers.mem[x] = entries.mem[x];
-  }
-  auto columns = AllocString<csv_column_t>( ncolumns );
-  For( x, 0, ncolumns ) {
-    // column-major striping of alloc_cells.
-    auto column = columns.mem + x;
-    column->string = { alloc_cells.mem + x * nrows, nrows };
-    column->numeric = { alloc_cells_numeric.mem + x * nrows, nrows };
+
+  auto file = FileOpenMappedExistingReadShareRead( ML( path ) );
+  if( !file.loaded ) {
+    auto mem = AllocCstr( path );
+    printf( "Failed to load file: %s\n", mem );
+    MemHeapFree( mem );
+    Free( table_name );
+    return 1;
   }
-  Fori( u32, row, 0, nrows ) {
-    auto y = row + 1;
-    auto line = lines.mem[y];
-    AssertCrash( line.len ); // TODO: More robust whitespace parsing support, handling empty lines.
-    auto nentries = CountCommas( ML( line ) ) + 1;
-    if( nentries != ncolumns ) {
-      printf(
-        "Line number %u has different number of elements: %Iu than expected: %Iu: \n",
-        y + 1,
-        nentries,
-        ncolumns );
-      return 1;
-    }
-    entries.len = 0;
-    Reserve( entries, nentries );
-    SplitByCommas( &entries, ML( line ) );
-    AssertCrash( nentries == entries.len );
-    For( x, 0, nentries ) {
-      auto column = columns.mem + x;
-      auto string = column->string;
-      string.mem[y - 1] = entries.mem[x];
+
+  // parse the csv into columns, skipping empty lines.
+  slice_t contents;
+  contents.mem = file.mapped_mem;
+  contents.len = file.size;
+  csvingest_t ingest;
+  if( !CsvIngest( &ingest, contents, 1, 0, 1, 1 ) ) {
+    switch( ingest.error ) {
+      case csvingesterror_t::empty: {
+        auto mem = AllocCstr( path );
+        printf( "No csv records in file: %s\n", mem );
+        MemHeapFree( mem );
+      } break;
+      case csvingesterror_t::nfields_mismatch: {
+        printf(
+          "Line number %u has different number of elements: %Iu than expected: %Iu: \n",
+          ingest.error_row + 1,
+          ingest.error_nfields,
+          ingest.ncolumns );
+      } break;
+      case csvingesterror_t::date_before_epoch: {
+        // TODO: we need to write our own date encoding?
+        printf( "ERROR: time before posix epoch, 1/1/1970.\n" );
+      } break;
+      default: UnreachableCrash();
     }
+    Kill( &ingest );
+    FileFree( file );
+    Free( table_name );
+    return 1;
   }
 
-  Free( lines );
-
-  auto parsed_numbers = AllocString<parsed_number_t>( nrows );
+  auto ncolumns = ingest.ncolumns;
+  auto nrows = ingest.nrows;
+  auto columns = AllocString<csv_column_t>( ncolumns );
   For( x, 0, ncolumns ) {
+    // column-major striping of the ingested cells.
     auto column = columns.mem + x;
-    auto column_string = column->string;
-    auto column_numeric = column->numeric;
-    TZero( ML( parsed_numbers ) );
-    For( y, 0, nrows ) {
-      auto string = column_string.mem[y];
-      auto parsed_number = parsed_numbers.mem + y;
-      ParseNumericOrDatetimeOrUsd(
-        &entries,
-        string,
-        parsed_number
-        );
-    }
-    {
-      // Find a consistent date.order across the column.
-      bool found_date = 0;
-      date_order_t order = {};
-      For( y, 0, nrows ) {
-        auto parsed_number = parsed_numbers.mem[y];
-        if( parsed_number.is_datetime ) {
-          if( !found_date ) {
-            found_date = 1;
-            order = parsed_number.date.order;
-          }
-          else {
-            order &= parsed_number.date.order;
-          }
-          if( !order ) break;
-        }
-      }
-      // Convert the column to is_numeric=1 from is_datetime=1 if we have a consistent date.order.
-      if( found_date  &&  _popcnt_idx_t( order ) == 1u ) {
-        // if( !order ) {
-        //   printf( "ERROR: conflicting y/m/d date orders.\n" );
-        //   return 1;
-        // }
-        // if( _popcnt_idx_t( order ) != 1u ) {
-        //   printf( "ERROR: ambiguous y/m/d date orders.\n" );
-        //   return 1;
-        // }
-        For( y, 0, nrows ) {
-          auto numeric = column_numeric.mem + y;
-          auto parsed_number = parsed_numbers.mem + y;
-          if( parsed_number->is_datetime ) {
-            // UnpackDate reads the order from the date_t, so use the shared, resolved order.
-            parsed_number->date.order = order;
-
-            u32 dd;
-            u32 mm;
-            u32 yyyy;
-            UnpackDate(
-              parsed_number->date,
-              &dd,
-              &mm,
-              &yyyy
-              );
-
-            struct tm time_data = { 0 };
-            // time_data.tm_sec = 0
-            // time_data.tm_min = 0
-            // time_data.tm_hour = 0
-            time_data.tm_mday = dd; // 1-based
-            time_data.tm_mon = mm - 1; // 0-based
-            time_data.tm_year = yyyy - 1900; // based on 1900
-            // time_data.tm_wday = 0
-            // time_data.tm_yday = 0
-            time_data.tm_isdst = -1;
-            auto sequence_number = mktime( &time_data );
-            if( sequence_number == -1 ) {
-              // TODO: we need to write our own date encoding?
-              printf( "ERROR: time before posix epoch, 1/1/1970.\n" );
-              return 1;
-            }
-
-            // Cast the time_t sequence_number to f64, which should be big enough to hold it.
-            parsed_number->numeric = Cast( f64, sequence_number );
-            parsed_number->is_numeric = 1; // dates are numerically encoded.
-          }
-        }
-      }
-    }
-    bool handled_first = 0;
-    bool all_numeric = 1;
-    bool all_datetime = 1;
-    bool all_usd = 1;
-    bool all_mixed_string_numeric = 0;
-    For( y, 0, nrows ) {
-      auto numeric = column_numeric.mem + y;
-      auto parsed_number = parsed_numbers.mem[y];
-      if( parsed_number.is_numeric ) {
-        *numeric = parsed_number.numeric;
-      }
-      else {
-        *numeric = 0;
-      }
-      if( !handled_first ) {
-        handled_first = 1;
-        all_numeric = parsed_number.is_numeric;
-        all_datetime = parsed_number.is_datetime;
-        all_usd = parsed_number.is_usd;
-      }
-      else {
-        if( all_numeric != parsed_number.is_numeric ) {
-          all_mixed_string_numeric = 1;
-        }
-        all_numeric &= parsed_number.is_numeric;
-        all_datetime &= parsed_number.is_datetime;
-        all_usd &= parsed_number.is_usd;
-      }
-    }
+    auto info = ingest.infos.mem[x];
+    column->string = { ingest.cells.mem + x * nrows, nrows };
+    column->numeric = { ingest.numeric.mem + x * nrows, nrows };
     // TODO: consistent naming for these aggregate flags.
-    column->is_numeric = all_numeric;
-    column->is_datetime = all_datetime;
-    column->is_mixed_string_numeric = all_mixed_string_numeric;
-    column->is_all_usd = all_usd;
+    column->is_numeric = info.is_numeric;
+    column->is_datetime = info.is_datetime;
+    column->is_mixed_string_numeric = info.is_mixed_string_numeric;
+    column->is_all_usd = info.is_all_usd;
   }
-  Free( parsed_numbers );
-
-  Free( entries );
 
   // If there's one datetime column, presumably that's the one to sort by, at least initially.
   {
@@ -671,13 +305,43 @@ LoadCsv( slice_t path, csv_t* table )
 //    }
 //  }
 
+  // cache the sorted columns for next time. if we can't write it, we'll just parse again next time.
+  {
+    auto values = AllocString<tslice_t<f64>>( ncolumns );
+    auto flags = AllocString<u8>( ncolumns );
+    For( x, 0, ncolumns ) {
+      auto column = columns.mem + x;
+      values.mem[x] = column->numeric;
+      flags.mem[x] = Cast( u8,
+        ( column->is_numeric  ?  c_colcache_numeric  :  0 ) |
+        ( column->is_datetime  ?  c_colcache_datetime  :  0 ) |
+        ( column->is_mixed_string_numeric  ?  c_colcache_mixed_string_numeric  :  0 ) |
+        ( column->is_all_usd  ?  c_colcache_all_usd  :  0 )
+        );
+    }
+    auto contents = ColCacheEncode(
+      path,
+      source_size,
+      source_time,
+      nrows,
+      ingest.headers,
+      values,
+      flags,
+      c_csvcache_compress
+      );
+    ColCacheWrite( ML( cache_filename ), contents );
+    Free( contents );
+    Free( flags );
+    Free( values );
+  }
+
+  *table = {};
+  table->file = file;
+  table->ingest = ingest;
   table->table_name = table_name;
-  table->csv = csv;
   table->ncolumns = ncolumns;
   table->nrows = nrows;
-  table->alloc_cells = alloc_cells;
-  table->alloc_cells_numeric = alloc_cells_numeric;
-  table->headers = headers;
+  table->headers = ingest.headers;
   table->columns = columns;
 
   return 0;
@@ -827,7 +491,6 @@ AppInit( app_t* app, tslice_t<slice_t> args )
   auto tables = AllocString<csv_t>( paths.len );
   app->tables = tables;
   // TODO: parallelize this loop.
-  // TODO: binary file format: csv<->binary converter, and binary loader.
   ForLen( i, paths ) {
     auto path = paths.mem[i];
     auto table = tables.mem + i;
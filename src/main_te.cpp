@@ -44,6 +44,7 @@ LogUI( const void* cstr ... );
 #include "cstr_float.h"
 #include "timedate.h"
 #include "thread_atomics.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
 #include "ds_mtqueue_mrmw_nonresizeable.h"
 #include "ds_mtqueue_mrsw_nonresizeable.h"
 #include "ds_mtqueue_srmw_nonresizeable.h"
@@ -77,13 +78,17 @@ LogUI( const void* cstr ... );
 #include "ui_propdb.h"
 #include "ui_font.h"
 #include "ui_render.h"
+#include "ds_linetree.h"
 #include "ui_buf2.h"
 #include "ui_txt2.h"
 #include "ui_cmd.h"
 #include "ui_listview.h"
+#include "trigramindex.h"
 #include "ui_findinfiles.h"
 #include "ui_fileopener.h"
 #include "ui_switchopened.h"
+#include "bigfile.h"
+#include "ui_bigfile.h"
 #include "ui_edit2.h"
 
 struct
@@ -521,13 +526,13 @@ Enumc( applayer_t )
     app_t* app
     )
   {
-    idx_t num_prof_elems = 0;
-    if( g_prof_enabled  ||  g_saved_prof_pos ) {
-      num_prof_elems = MIN( g_prof_pos, g_prof_buffer_len );
-      if( !g_prof_enabled ) {
-        num_prof_elems = g_saved_prof_pos;
-      }
-    }
+    // every frame we copy out what the profiled threads have logged so far; they keep writing meanwhile.
+    stack_resizeable_cont_t<prof_elem_t> prof_elems;
+    Alloc( prof_elems, 65536 );
+    stack_resizeable_cont_t<prof_thread_t> prof_threads;
+    Alloc( prof_threads, 16 );
+    ProfSnapshot( prof_elems, prof_threads );
+    idx_t num_prof_elems = prof_elems.len;
 
     {
       stack_nonresizeable_stack_t<u8, 32> tmp;
@@ -563,72 +568,49 @@ Enumc( applayer_t )
       //   or is that going to slow things down in the optimal future?
 
       //
-      // note that we don't actually record the prof_entry_t until the scope's closed, but we've taken the
-      // time_start at the scope-open. so we actually have to search to find the earliest time_start, since
+      // note that we don't actually record the non-split prof_elem_t until the scope's closed, but we've taken
+      // the time_start at the scope-open. so we actually have to search to find the earliest time_start, since
       // we could have arbitrary durations delaying when we log that first, early entry.
+      // each thread logs into its own ring, so there's no ordering across threads to rely on either.
       //
-      // note we have a different problem on scope-close that also means we have to search.
-      // we do the atomic inc to get the prof_elem_t index, and then we take the time.
-      // if that execution interleaves with another thread, we might have an earlier entry with a later time.
-      // TODO: handle this scope-close problem.
-      //   i'm ignoring it for now, since the scaling difference it has isn't likely to cause much concern now.
-      //   but for better correctness, it'd be nice to resolve this.
-      //
-      // even if we split the prof_elem_t entries into scope-start and scope-close, we'd still have this
-      // interleaving concern about when we do the atomic inc vs. when we take the time.
-      // so i think fundamentally we just have to do a search, unless we use a more complicated model than
-      // the simple atomic inc.
-      // something like a lock-free queue, i.e. use mtqueue_srmw_t<prof_elem_t> for example.
-      // that would give slower instrumentation, since it requires retries.
-      // i don't know that we care enough about the strict ordering, but we do care about the cost of retries.
-      // so for now i think we'll stick with searches for first/last.
-      //
-  //    auto first_elem = Cast( prof_elem_t*, g_prof_buffer + 0 );
-  //    u64 time_first = first_elem->time_start;
       u64 time_first = MAX_u64;
-
-  //    auto last_elem = Cast( prof_elem_t*, g_prof_buffer + num_prof_elems - 1 );
-  //    u64 time_last = last_elem->time_start + last_elem->time_elapsed;
       u64 time_last = 0;
 
-      For( i, 0, num_prof_elems ) {
-        auto elem = Cast( prof_elem_t*, g_prof_buffer + i );
+      FORLEN( prof_thread, t, prof_threads )
+        // the os can reuse a tid after a thread exits, so two rings can share one timeline row.
+        idx_t thread_idx;
+        auto found = TIdxScanR( &thread_idx, ML( threadids ), prof_thread->tid );
+        if( !found ) {
+          thread_idx = threadids.len;
+          *AddBack( threadids ) = prof_thread->tid;
+          auto perthread = AddBack( per_thread );
+          perthread->max_depth = 0;
+          perthread->min_depth = MAX_u32;
+        }
+        auto perthread = per_thread.mem + thread_idx;
+
+        For( i, prof_thread->elems_start, prof_thread->elems_start + prof_thread->elems_len ) {
+          auto elem = prof_elems.mem + i;
 
   #if PROF_SPLITSCOPES
-        auto time = elem->time;
-        time_first = MIN( time_first, time );
-        time_last = MAX( time_last, time );
+          auto time = elem->time;
+          time_first = MIN( time_first, time );
+          time_last = MAX( time_last, time );
   #else
-        // early out for tiny events, which we can have millions of.
-        auto time_start = elem->time_start;
-        auto time_end = elem->time_end;
-  //      if( time_elapsed < cycles_per_px ) {
-  //        continue;
-  //      }
-
-        time_first = MIN( time_first, time_start );
-        time_last = MAX( time_last, time_end );
+          auto time_start = elem->time_start;
+          auto time_end = elem->time_end;
+          time_first = MIN( time_first, time_start );
+          time_last = MAX( time_last, time_end );
   #endif
 
-  #if PROF_SPLITSCOPES
-        if( elem->start  &&  !TContains( ML( threadids ), &elem->tid ) ) {
-          *AddBack( threadids ) = elem->tid;
-        }
-  #else
-        idx_t thread_idx;
-        auto found = TIdxScanR( &thread_idx, ML( threadids ), elem->tid );
-        if( !found ) {
-          *AddBack( threadids ) = elem->tid;
-          auto perthread = AddBack( per_thread );
-          perthread->max_depth = elem->depth;
-          perthread->min_depth = elem->depth;
-        }
-        else {
-          auto perthread = per_thread.mem + thread_idx;
+  #if PROF_DEPTHCOUNT
           perthread->max_depth = MAX( perthread->max_depth, elem->depth );
           perthread->min_depth = MIN( perthread->min_depth, elem->depth );
-        }
+  #else
+          perthread->max_depth = 0;
+          perthread->min_depth = 0;
   #endif
+        }
       }
       auto thread_count = threadids.len;
 
@@ -702,103 +684,113 @@ Enumc( applayer_t )
   #else
   #endif
 
-      For( i, 0, num_prof_elems ) {
-        auto elem = *Cast( prof_elem_t*, g_prof_buffer + i );
+      FORLEN( prof_thread, t, prof_threads )
+        auto tid = prof_thread->tid;
 
   #if PROF_SPLITSCOPES
-        if( elem.start ) {
-          *AddBack( open_scopes ) = elem;
-          continue;
-        }
+        // scopes nest within a thread, so the matching scope-start is on this thread's stack.
+        open_scopes.len = 0;
+  #else
+  #endif
+
+        For( i, prof_thread->elems_start, prof_thread->elems_start + prof_thread->elems_len ) {
+          auto elem = prof_elems.mem[i];
 
-        idx_t opened_idx = 0;
-        prof_elem_t* popen = 0;
-        REVERSEFORLEN( open_scope, j, open_scopes )
-          if( elem.id == open_scope->id  &&  elem.tid == open_scope->tid ) {
-            opened_idx = j;
-            popen = open_scope;
-            break;
+  #if PROF_SPLITSCOPES
+          if( elem.start ) {
+            *AddBack( open_scopes ) = elem;
+            continue;
           }
-        }
-        if( !popen ) {
-          // TODO: should we need this early-out? somehow pushing a scope-end as the first elem?
-          continue;
-        }
-        auto open = *popen;
-        UnorderedRemAt( open_scopes, opened_idx );
+
+          idx_t opened_idx = 0;
+          prof_elem_t* popen = 0;
+          REVERSEFORLEN( open_scope, j, open_scopes )
+            if( elem.id == open_scope->id ) {
+              opened_idx = j;
+              popen = open_scope;
+              break;
+            }
+          }
+          if( !popen ) {
+            // the scope-start got overwritten by ring wraparound, or dropped by ProfReset.
+            continue;
+          }
+          auto open = *popen;
+          UnorderedRemAt( open_scopes, opened_idx );
   #else
   #endif
 
-        // early out for tiny events, which we can have millions of.
+          // early out for tiny events, which we can have millions of.
   #if PROF_SPLITSCOPES
-        auto time_start = open.time;
-        auto time_elapsed = elem.time - time_start;
+          auto time_start = open.time;
+          auto time_elapsed = elem.time - time_start;
   #else
-        auto time_start = elem.time_start;
-        auto time_elapsed = elem.time_end - time_start;
+          auto time_start = elem.time_start;
+          auto time_elapsed = elem.time_end - time_start;
   #endif
-        if( time_elapsed < cycles_per_px ) {
-          continue;
-        }
+          if( time_elapsed < cycles_per_px ) {
+            continue;
+          }
 
-        RenderThreadTimelineElem(
-          app->prof_renderedscopes,
-          app->stream,
-          zrange,
-          font,
-          spaces_per_tab,
-          bounds_orig,
-          bounds_prof,
-          line_h,
-          time_first,
-          time_last,
-          time_start,
-          time_elapsed,
-          elem.id,
-          elem.tid,
+          RenderThreadTimelineElem(
+            app->prof_renderedscopes,
+            app->stream,
+            zrange,
+            font,
+            spaces_per_tab,
+            bounds_orig,
+            bounds_prof,
+            line_h,
+            time_first,
+            time_last,
+            time_start,
+            time_elapsed,
+            elem.id,
+            tid,
   #if PROF_DEPTHCOUNT
-          elem.depth,
+            elem.depth,
   #else
-          0,
+            0,
   #endif
-          threadids,
-          per_thread,
-          thread_count
-          );
-      }
+            threadids,
+            per_thread,
+            thread_count
+            );
+        }
 
   #if PROF_SPLITSCOPES
-      // now render all the scopes that haven't closed yet, with time_last as a pseudo-close.
-      FORLEN( open_scope, j, open_scopes )
-        auto time_start = open_scope->time;
-        auto time_elapsed = time_last + time_first - time_start;
-        RenderThreadTimelineElem(
-          app->prof_renderedscopes,
-          app->stream,
-          zrange,
-          font,
-          spaces_per_tab,
-          bounds_orig,
-          bounds_prof,
-          line_h,
-          time_first,
-          time_last,
-          time_start,
-          time_elapsed,
-          open_scope->id,
-          open_scope->tid,
-  #if PROF_DEPTHCOUNT
-          open_scope->depth,
+        // now render all the scopes on this thread that haven't closed yet, with time_last as a pseudo-close.
+        FORLEN( open_scope, j, open_scopes )
+          auto time_start = open_scope->time;
+          auto time_elapsed = time_last + time_first - time_start;
+          RenderThreadTimelineElem(
+            app->prof_renderedscopes,
+            app->stream,
+            zrange,
+            font,
+            spaces_per_tab,
+            bounds_orig,
+            bounds_prof,
+            line_h,
+            time_first,
+            time_last,
+            time_start,
+            time_elapsed,
+            open_scope->id,
+            tid,
+    #if PROF_DEPTHCOUNT
+            open_scope->depth,
+    #else
+            0,
+    #endif
+            threadids,
+            per_thread,
+            thread_count
+            );
+        }
   #else
-          0,
   #endif
-          threadids,
-          per_thread,
-          thread_count
-          );
       }
-  #else
-  #endif
 
   #if PROF_SPLITSCOPES
       Free( open_scopes );
@@ -934,6 +926,9 @@ Enumc( applayer_t )
           );
       }
     }
+
+    Free( prof_threads );
+    Free( prof_elems );
   }
 
 #endif // PROF_ENABLED
@@ -2193,7 +2188,14 @@ Main( stack_resizeable_cont_t<slice_t>& args )
 #else
     auto file = FileOpen( ML( filename ), fileopen_t::only_existing, fileop_t::R, fileop_t::R );
 #endif
-    if( file.loaded ) {
+    if( file.loaded  &&  file.size >= c_bigfile_min_size ) {
+      // too big for a txt_t, so go line by line through the mapped file instead.
+      EditOpenBigfile( app->edit, ML( filename ) );
+      if( has_lineno ) {
+        BigfileviewGotoline( app->edit.bigfile, lineno );
+      }
+    }
+    elif( file.loaded ) {
       edittxtopen_t* open = 0;
       bool opened_existing = 0;
       EditOpen( app->edit, file, &open, &opened_existing );
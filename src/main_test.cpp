@@ -64,6 +64,7 @@ LogUI( const void* cstr ... )
 #include "cstr_float.h"
 #include "timedate.h"
 #include "thread_atomics.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
 #include "ds_mtqueue_mrmw_nonresizeable.h"
 #include "ds_mtqueue_mrsw_nonresizeable.h"
 #include "ds_mtqueue_srmw_nonresizeable.h"
@@ -94,6 +95,9 @@ LogUI( const void* cstr ... )
 #include "text_parsing.h"
 #include "allocator_heap_findleaks.h"
 #include "mainthread.h"
+#include "csv_ingest.h"
+#include "colcache.h"
+#include "diff.h"
 #include "optimize_simplex.h"
 #include "ds_hashset_cstyle_indexed.h"
 
@@ -106,6 +110,9 @@ LogUI( const void* cstr ... )
 #include "ui_propdb.h"
 #include "ui_font.h"
 #include "ui_render.h"
+#include "img.h"
+#include "render.h"
+#include "ds_linetree.h"
 #include "ui_buf2.h"
 #include "ui_txt2.h"
 #include "ui_cmd.h"
@@ -940,6 +947,587 @@ void Junk() {
 
 
 
+// packet vs. scalar tracing, and tiled vs. single-threaded Raytrace.
+// Builds a small scene touching every packet kernel, plus the scalar fallback for cylinders.
+// Only untextured primitives, so the scene owns nothing but its primitive lists.
+Inl void
+InitTestMesh( rtmesh_t& mesh, f32 scale, vec3<f32> translation, f32 rotate_y )
+{
+  mesh = {};
+  mesh.reflectance = _vec3( 0.8f );
+  RotateY( &mesh.rotation_world_from_model, rotate_y );
+  Transpose( &mesh.rotation_model_from_world, mesh.rotation_world_from_model );
+  mesh.scale_world_from_model = scale;
+  mesh.scale_model_from_world = 1 / scale;
+  mesh.translation_world = translation;
+  mesh.surface_area_model = 1;
+  mesh.radiance_emit = _vec3( 0.0f );
+}
+
+Inl void
+KillTestMesh( rtmesh_t& mesh )
+{
+  Free( mesh.tris );
+  Free( mesh.parallelos );
+  Free( mesh.spheres );
+  Free( mesh.discs );
+  Free( mesh.cylinders );
+}
+
+RegisterTest([]()
+{
+  rtmesh_t box;
+  InitTestMesh( box, 16.0f, _vec3<f32>( 0, 0, 0 ), 0 );
+  vec3<f32> box_pos_and_deltas[] = {
+    { -1, -1, -1 }, {  0,  2,  0 }, {  0,  0,  2 },
+    {  1, -1, -1 }, {  0,  2,  0 }, {  0,  0,  2 },
+    { -1, -1, -1 }, {  2,  0,  0 }, {  0,  0,  2 },
+    { -1,  1, -1 }, {  2,  0,  0 }, {  0,  0,  2 },
+    { -1, -1, -1 }, {  2,  0,  0 }, {  0,  2,  0 },
+  };
+  Alloc( box.parallelos, 5 );
+  For( i, 0, 5 ) {
+    rtparallelo_t parallelo;
+    parallelo.p = box_pos_and_deltas[3*i+0];
+    parallelo.e0 = box_pos_and_deltas[3*i+1];
+    parallelo.e1 = box_pos_and_deltas[3*i+2];
+    parallelo.n = Cross( parallelo.e0, parallelo.e1 );
+    parallelo.surface_area_model = Length( parallelo.n );
+    parallelo.n /= parallelo.surface_area_model;
+    *AddBack( box.parallelos ) = parallelo;
+  }
+
+  rtmesh_t light;
+  InitTestMesh( light, 8.0f, _vec3<f32>( -6, 10, 0 ), 0 );
+  light.radiance_emit = _vec3( 1.0f, 0.8f, 0.6f );
+  Alloc( light.spheres, 1 );
+  {
+    rtsphere_t sphere;
+    sphere.p = _vec3( 0.0f );
+    sphere.radius = 0.5f;
+    sphere.sq_radius = Square( sphere.radius );
+    *AddBack( light.spheres ) = sphere;
+  }
+
+  rtmesh_t tris;
+  InitTestMesh( tris, 4.0f, _vec3<f32>( -6, -8, -4 ), 0.3f * f32_PI );
+  Alloc( tris.tris, 16 );
+  Fori( u32, i, 0, 4 ) {
+  Fori( u32, j, 0, 4 ) {
+    rttri_t tri;
+    tri.p = _vec3<f32>( Cast( f32, i ) - 2, 0.25f * j, Cast( f32, j ) - 2 );
+    tri.e0 = _vec3<f32>( 1, 0.5f, 0 );
+    tri.e1 = _vec3<f32>( 0, 0.25f, 1 );
+    tri.n = Cross( tri.e0, tri.e1 );
+    tri.twice_surface_area_model = Length( tri.n );
+    tri.n /= tri.twice_surface_area_model;
+    *AddBack( tris.tris ) = tri;
+  }
+  }
+
+  rtmesh_t shapes;
+  InitTestMesh( shapes, 3.0f, _vec3<f32>( 6, -6, 2 ), 0.1f * f32_PI );
+  Alloc( shapes.spheres, 1 );
+  {
+    rtsphere_t sphere;
+    sphere.p = _vec3<f32>( 0, 1, 0 );
+    sphere.radius = 1;
+    sphere.sq_radius = Square( sphere.radius );
+    *AddBack( shapes.spheres ) = sphere;
+  }
+  Alloc( shapes.discs, 1 );
+  {
+    rtdisc_t disc;
+    disc.p = _vec3<f32>( -2, 0, 1 );
+    disc.n = Normalize( _vec3<f32>( 1, 2, 3 ) );
+    disc.radius = 1;
+    disc.sq_radius = Square( disc.radius );
+    *AddBack( shapes.discs ) = disc;
+  }
+  Alloc( shapes.cylinders, 1 );
+  {
+    rtcylinder_t cylinder;
+    cylinder.p = _vec3<f32>( 2, 0, -1 );
+    cylinder.n = _vec3<f32>( 0, 1, 0 );
+    cylinder.height = 2;
+    cylinder.radius = 0.5f;
+    cylinder.sq_radius = Square( cylinder.radius );
+    *AddBack( shapes.cylinders ) = cylinder;
+  }
+
+  rtmesh_t* meshes[] = { &box, &light, &tris, &shapes };
+  rtmesh_t* lights[] = { &light };
+  rtscene_t scene;
+  Init( scene, AL( meshes ) );
+
+  constant f32 t_min_world = 1e-3f;
+
+  // Packet vs. scalar traversal, per ray. Partially active packets included.
+  {
+    rng_t rng;
+    Init( rng, 1234 );
+    u32 num_mismatch = 0;
+    u32 num_rays = 0;
+    Fori( u32, n, 0, 4096 ) {
+      auto ray_p = _vec3<f32>( 28 * Zeta32( rng ) - 14, 28 * Zeta32( rng ) - 14, 28 * Zeta32( rng ) - 14 );
+      auto ray_d = Normalize( _vec3<f32>( 2 * Zeta32( rng ) - 1, 2 * Zeta32( rng ) - 1, 2 * Zeta32( rng ) - 1 ) );
+      vec3<f32> ray_ps[4];
+      vec3<f32> ray_ds[4];
+      bool actives[4];
+      f32 t_mins[4];
+      Fori( u32, lane, 0, 4 ) {
+        ray_ps[lane] = ray_p;
+        ray_ds[lane] = Normalize( ray_d + 0.05f * _vec3<f32>( Zeta32( rng ) - 0.5f, Zeta32( rng ) - 0.5f, Zeta32( rng ) - 0.5f ) );
+        actives[lane] = ( n % 5 != lane );
+        // Every other packet gets per-lane t_mins, like shadow rays do.
+        t_mins[lane] = ( n % 2 )  ?  t_min_world * ( 1 + 100 * Zeta32( rng ) )  :  t_min_world;
+      }
+      hit_t hits[4];
+      TracePacket( hits, scene, ray_ps, ray_ds, actives, t_mins );
+      Fori( u32, lane, 0, 4 ) {
+        if( !actives[lane] ) {
+          AssertCrash( Invalid( hits[lane] ) );
+          continue;
+        }
+        auto hit = Trace( scene, ray_ps[lane], ray_ds[lane], t_mins[lane] );
+        num_rays += 1;
+        AssertCrash( Valid( hit ) == Valid( hits[lane] ) );
+        if( Valid( hit ) ) {
+          if( hit.primitive == hits[lane].primitive ) {
+            AssertCrash( hit.t_world == hits[lane].t_world );
+            AssertCrash( hit.x_world == hits[lane].x_world );
+          } else {
+            // Ties at shared edges may resolve to either primitive.
+            AssertCrash( ABS( hit.t_world - hits[lane].t_world ) <= 1e-3f * hit.t_world );
+            num_mismatch += 1;
+          }
+        }
+      }
+    }
+    AssertCrash( num_mismatch * 1000 <= num_rays );
+  }
+
+  // Scalar vs. packet Raytrace; identical seeds, so the images should match.
+  // Then, the same seed rendered on one thread vs. all task threads must match bit for bit, over several passes.
+  // 40x24 doesn't divide into tiles evenly, so we exercise the partial tiles.
+  {
+    auto translate_world_from_camera = _vec3<f32>( 5, 5, 50 );
+    mat3x3r<f32> rotation_world_from_camera;
+    RotateY( &rotation_world_from_camera, -0.12f );
+    f32 camera_half = Tan32( 0.5f * 0.34f * f32_PI );
+
+    img_t img_ray;
+    img_t img_packet;
+    img_t img_threaded;
+    Init( img_ray, 40, 24, 40, 16 );
+    Init( img_packet, 40, 24, 40, 16 );
+    Init( img_threaded, 40, 24, 40, 16 );
+    Alloc( img_ray );
+    Alloc( img_packet );
+    Alloc( img_threaded );
+
+    rttiles_t tiles_ray;
+    rttiles_t tiles_packet;
+    rttiles_t tiles_threaded;
+    Init( tiles_ray, 40, 24, 1234567890 );
+    Init( tiles_packet, 40, 24, 1234567890 );
+    Init( tiles_threaded, 40, 24, 1234567890 );
+
+    // 9 subpixels per pixel, so we exercise the partial last packet.
+    Fori( u32, pass, 0, 3 ) {
+      Raytrace( img_ray, tiles_ray, 9, translate_world_from_camera, rotation_world_from_camera, camera_half, camera_half, 1.0f, scene, AL( lights ), rendermode_t::ray, 1 );
+      Raytrace( img_packet, tiles_packet, 9, translate_world_from_camera, rotation_world_from_camera, camera_half, camera_half, 1.0f, scene, AL( lights ), rendermode_t::ray_packet, 1 );
+      Raytrace( img_threaded, tiles_threaded, 9, translate_world_from_camera, rotation_world_from_camera, camera_half, camera_half, 1.0f, scene, AL( lights ), rendermode_t::ray );
+    }
+    AssertCrash( tiles_ray.num_passes == 3 );
+
+    u32 num_mismatch = 0;
+    Fori( u32, y, 0, img_ray.y ) {
+    Fori( u32, x, 0, img_ray.x ) {
+      auto& a = LookupAs( vec4<f32>, img_ray, x, y );
+      auto& b = LookupAs( vec4<f32>, img_packet, x, y );
+      auto diff = MAX( MAX( ABS( a.x - b.x ), ABS( a.y - b.y ) ), ABS( a.z - b.z ) );
+      num_mismatch += ( diff > 1e-4f );
+    }
+    }
+    AssertCrash( num_mismatch * 100 <= img_ray.x * img_ray.y );
+
+    AssertCrash( MemEqual( ML( img_ray.mem ), ML( img_threaded.mem ) ) );
+    AssertCrash( MemEqual( ML( tiles_ray.accum.mem ), ML( tiles_threaded.accum.mem ) ) );
+
+    // Reset starts the accumulation over; a fresh pass must match a fresh render's first pass.
+    Reset( tiles_threaded );
+    Raytrace( img_threaded, tiles_threaded, 9, translate_world_from_camera, rotation_world_from_camera, camera_half, camera_half, 1.0f, scene, AL( lights ), rendermode_t::ray );
+    Reset( tiles_ray );
+    Raytrace( img_ray, tiles_ray, 9, translate_world_from_camera, rotation_world_from_camera, camera_half, camera_half, 1.0f, scene, AL( lights ), rendermode_t::ray, 1 );
+    AssertCrash( MemEqual( ML( img_ray.mem ), ML( img_threaded.mem ) ) );
+
+    Kill( tiles_threaded );
+    Kill( tiles_packet );
+    Kill( tiles_ray );
+    Free( img_threaded );
+    Free( img_packet );
+    Free( img_ray );
+  }
+
+  Kill( scene );
+  KillTestMesh( shapes );
+  KillTestMesh( tris );
+  KillTestMesh( light );
+  KillTestMesh( box );
+});
+
+
+
+// line-space benchmarks for buf_t at various sizes, comparing against the plain array it used to use.
+// these take a while at 10M lines, so they only run when you pass "bench" on the cmdline.
+void
+BenchBufLines()
+{
+  rng_xorshift32_t rng;
+  Init( rng, 1234 );
+  static u8 contents[] = "  auto line = LineFromY( buf, y );";
+  constant u32 c_nops = 100000;
+  constant u32 c_nops_array = 1000;
+  constant u32 c_scroll_lines = 60;
+
+  u32 sizes[] = { 10*1000, 1000*1000, 10*1000*1000 };
+  printf( "%10s  %10s  %10s  %10s  %10s  %12s  %12s\n", "lines", "load ms", "ins ns", "del ns", "scroll ns", "array ins ns", "array del ns" );
+  ForEach( nlines, sizes ) {
+    line_t line;
+    line.mem = contents;
+    line.len = _countof( contents ) - 1;
+    line.flags = 0;
+
+    buf_t buf;
+    Init( &buf );
+    BufLoadEmpty( &buf );
+    auto t0 = TimeTSC();
+    Fori( u32, y, 1, nlines ) {
+      LineInsert( &buf, y, &line );
+    }
+    auto t1 = TimeTSC();
+    Fori( u32, i, 0, c_nops ) {
+      LineInsert( &buf, Rand32( rng ) % ( NLines( &buf ) + 1 ), &line );
+    }
+    auto t2 = TimeTSC();
+    Fori( u32, i, 0, c_nops ) {
+      LineRemove( &buf, Rand32( rng ) % NLines( &buf ), 0 );
+    }
+    auto t3 = TimeTSC();
+    // scrolling is a random jump, then iterating a screenful of lines.
+    idx_t sum = 0;
+    Fori( u32, i, 0, c_nops ) {
+      auto top = Rand32( rng ) % ( NLines( &buf ) - c_scroll_lines );
+      FORLINES( &buf, l, y, top, top + c_scroll_lines )
+        sum += l->len;
+      }
+    }
+    auto t4 = TimeTSC();
+    AssertCrash( sum == Cast( idx_t, c_nops ) * c_scroll_lines * line.len );
+    Kill( &buf );
+
+    // the old model, for comparison.
+    stack_resizeable_cont_t<u32> array;
+    Alloc( array, nlines + c_nops_array );
+    Fori( u32, y, 0, nlines ) {
+      *AddBack( array ) = y;
+    }
+    auto t5 = TimeTSC();
+    Fori( u32, i, 0, c_nops_array ) {
+      *AddAt( array, Rand32( rng ) % ( array.len + 1 ) ) = i;
+    }
+    auto t6 = TimeTSC();
+    Fori( u32, i, 0, c_nops_array ) {
+      RemAt( array, Rand32( rng ) % array.len );
+    }
+    auto t7 = TimeTSC();
+    Free( array );
+
+    printf(
+      "%10u  %10.1f  %10.1f  %10.1f  %10.1f  %12.1f  %12.1f\n",
+      nlines,
+      1e3 * TimeSecFromTSC64( t1 - t0 ),
+      1e9 * TimeSecFromTSC64( t2 - t1 ) / c_nops,
+      1e9 * TimeSecFromTSC64( t3 - t2 ) / c_nops,
+      1e9 * TimeSecFromTSC64( t4 - t3 ) / ( c_nops * c_scroll_lines ),
+      1e9 * TimeSecFromTSC64( t6 - t5 ) / c_nops_array,
+      1e9 * TimeSecFromTSC64( t7 - t6 ) / c_nops_array
+      );
+  }
+}
+
+// a scripted typing session against buf_t undo history: mostly chars, some newlines and backspaces,
+// and the odd cursor jump, with an undo checkpt per keystroke like txt_t does.
+// reports the history bytes per keystroke, and undo/redo latency.
+void
+BenchBufUndo()
+{
+  rng_xorshift32_t rng;
+  Init( rng, 1234 );
+  constant u32 c_nlines = 10000;
+  constant u32 c_nkeys = 1000*1000;
+  constant u32 c_nundos = 100000;
+
+  stack_resizeable_cont_t<u8> contents;
+  Alloc( contents, c_nlines * 61 );
+  Fori( u32, i, 0, c_nlines ) {
+    Fori( u32, j, 0, 60 ) {
+      *AddBack( contents ) = Cast( u8, 'a' + ( i + j ) % 26 );
+    }
+    if( i + 1 < c_nlines ) {
+      *AddBack( contents ) = '\n';
+    }
+  }
+  buf_t buf;
+  Init( &buf );
+  BufLoadEmpty( &buf );
+  Insert( &buf, 0, 0, ML( contents ) );
+  WipeHistories( &buf );
+  // we want to undo all the way back, so don't let the cap drop anything.
+  BufSetHistoryLimit( &buf, MAX_idx );
+
+  u32 x = 0;
+  u32 y = 0;
+  auto t0 = TimeTSC();
+  Fori( u32, i, 0, c_nkeys ) {
+    UndoCheckpt( &buf );
+    auto r = Rand32( rng ) % 100;
+    if( r < 85 ) {
+      auto c = Cast( u8, 'a' + Rand32( rng ) % 26 );
+      Insert( &buf, x, y, &c, 1, &x, &y );
+    } elif( r < 90 ) {
+      Insert( &buf, x, y, Str( "\n" ), 1, &x, &y );
+    } elif( r < 99 ) {
+      if( x ) {
+        Delete( &buf, x - 1, y, x, y, &x, &y );
+      }
+    } else {
+      y = Rand32( rng ) % NLines( &buf );
+      x = Rand32( rng ) % ( LineFromY( &buf, y )->len + 1 );
+    }
+  }
+  auto t1 = TimeTSC();
+  auto history_bytes = buf.history.log.len;
+  Fori( u32, i, 0, c_nundos ) {
+    Undo( &buf );
+  }
+  auto t2 = TimeTSC();
+  Fori( u32, i, 0, c_nundos ) {
+    Redo( &buf );
+  }
+  auto t3 = TimeTSC();
+  Fori( u32, i, 0, c_nkeys ) {
+    Undo( &buf );
+  }
+  auto t4 = TimeTSC();
+  auto contents_undone = AllocContents( &buf, eoltype_t::lf );
+  AssertCrash( MemEqual( ML( contents_undone ), ML( contents ) ) );
+  Free( contents_undone );
+  Kill( &buf );
+  Free( contents );
+
+  printf( "%10s  %12s  %10s  %10s  %14s\n", "edit ns", "history B/key", "undo ns", "redo ns", "full undo ms" );
+  printf(
+    "%10.1f  %12.2f  %10.1f  %10.1f  %14.1f\n",
+    1e9 * TimeSecFromTSC64( t1 - t0 ) / c_nkeys,
+    Cast( f64, history_bytes ) / c_nkeys,
+    1e9 * TimeSecFromTSC64( t2 - t1 ) / c_nundos,
+    1e9 * TimeSecFromTSC64( t3 - t2 ) / c_nundos,
+    1e3 * TimeSecFromTSC64( t4 - t3 )
+    );
+}
+
+// csv ingest throughput on a synthetic daily-price dump, like the ones main_stocks loads.
+// reports split-only and typed, each serial and on the taskthreads.
+void
+BenchCsvIngest()
+{
+  rng_xorshift32_t rng;
+  Init( rng, 1234 );
+  constant u32 c_nrows = 2*1000*1000;
+
+  stack_resizeable_cont_t<u8> csv;
+  Alloc( csv, c_nrows * 64 );
+  AddBackCStr( &csv, "Date,Open,High,Low,Close,Volume\n" );
+  Fori( u32, row, 0, c_nrows ) {
+    auto day = row % ( 100 * 12 * 28 );
+    u8 line[128];
+    auto len = snprintf(
+      Cast( char*, line ),
+      _countof( line ),
+      "%04u-%02u-%02u,%.2f,%.2f,%.2f,%.2f,%u\n",
+      1971 + day / ( 12 * 28 ),
+      1 + ( day / 28 ) % 12,
+      1 + day % 28,
+      Cast( f64, Rand32( rng ) % 100000 ) / 100,
+      Cast( f64, Rand32( rng ) % 100000 ) / 100,
+      Cast( f64, Rand32( rng ) % 100000 ) / 100,
+      Cast( f64, Rand32( rng ) % 100000 ) / 100,
+      Rand32( rng ) % 10000000
+      );
+    slice_t text = { line, Cast( idx_t, len ) };
+    AddBackContents( &csv, text );
+  }
+  auto src = SliceFromArray( csv );
+
+  printf( "%10s  %8s  %10s  %8s\n", "typed", "parallel", "ms", "GB/s" );
+  For( typed, 0, 2 ) {
+    For( parallel, 0, 2 ) {
+      csvingest_t ingest;
+      auto t0 = TimeTSC();
+      AssertCrash( CsvIngest( &ingest, src, Cast( bool, typed ), 0, 1, Cast( bool, parallel ) ) );
+      auto t1 = TimeTSC();
+      AssertCrash( ingest.nrows == c_nrows );
+      Kill( &ingest );
+      auto sec = TimeSecFromTSC64( t1 - t0 );
+      printf( "%10u  %8u  %10.1f  %8.3f\n", Cast( u32, typed ), Cast( u32, parallel ), 1e3 * sec, src.len / ( 1e9 * sec ) );
+    }
+  }
+  Free( csv );
+}
+
+// line diff throughput on a synthetic 1M line source file, against a copy with scattered edits.
+// we also time the hirschberg path on a smaller prefix, since it's O(n*m) and can't do 1M lines at all.
+void
+BenchDiff()
+{
+  rng_xorshift32_t rng;
+  Init( rng, 1234 );
+  constant u32 c_nlines = 1000*1000;
+
+  auto AddLine = [&]( stack_resizeable_cont_t<u8>& file )
+  {
+    switch( Rand32( rng ) % 8 ) {
+      case 0: AddBackCStr( &file, "{\n" ); break;
+      case 1: AddBackCStr( &file, "}\n" ); break;
+      case 2: AddBackCStr( &file, "\n" ); break;
+      default: {
+        u8 line[128];
+        auto len = snprintf(
+          Cast( char*, line ),
+          _countof( line ),
+          "  v%u = Function%u( x, %u );\n",
+          Rand32( rng ) % 1000,
+          Rand32( rng ) % 1000,
+          Rand32( rng ) % 100000
+          );
+        slice_t text = { line, Cast( idx_t, len ) };
+        AddBackContents( &file, text );
+      } break;
+    }
+  };
+
+  stack_resizeable_cont_t<u8> file_l;
+  stack_resizeable_cont_t<u8> file_r;
+  Alloc( file_l, c_nlines * 32 );
+  Alloc( file_r, c_nlines * 32 );
+  stack_resizeable_cont_t<slice_t> lines;
+  Alloc( lines, c_nlines );
+  Fori( u32, i, 0, c_nlines ) {
+    AddLine( file_l );
+  }
+  DiffSplitLines( lines, SliceFromArray( file_l ) );
+
+  diff_t diff;
+  Init( diff );
+
+  printf( "%10s  %10s  %10s  %10s\n", "algo", "edit rate", "ms", "hunks" );
+  constant u32 c_edit_rates[] = { 1000, 30 };
+  ForEach( edit_rate, c_edit_rates ) {
+    // each line has a 1 / edit_rate chance of being edited, deleted, or having a line inserted before it.
+    file_r.len = 0;
+    FORLEN( line, i, lines )
+      if( Rand32( rng ) % edit_rate ) {
+        AddBackContents( &file_r, *line );
+        AddBackCStr( &file_r, "\n" );
+        continue;
+      }
+      switch( Rand32( rng ) % 3 ) {
+        case 0: AddLine( file_r ); break;
+        case 1: break;
+        case 2: {
+          AddLine( file_r );
+          AddBackContents( &file_r, *line );
+          AddBackCStr( &file_r, "\n" );
+        } break;
+      }
+    }
+    For( algo, 0, Cast( idx_t, diffalgo_t::COUNT ) ) {
+      auto t0 = TimeTSC();
+      DiffFiles( diff, SliceFromArray( file_l ), SliceFromArray( file_r ), Cast( diffalgo_t, algo ), 1 );
+      auto t1 = TimeTSC();
+      constant const char* algo_names[] = { "myers", "patience", "histogram" };
+      printf(
+        "%10s  %10u  %10.1f  %10llu\n",
+        algo_names[algo],
+        edit_rate,
+        1e3 * TimeSecFromTSC64( t1 - t0 ),
+        Cast( unsigned long long, diff.hunks.len )
+        );
+    }
+  }
+
+  // hirschberg on the first few thousand lines. we only time its first split, which is the two O(n*m) score
+  // passes over the whole input, so this is a lower bound; the full recursion roughly doubles it.
+  {
+    constant idx_t c_nlines_hirschberg = 8000;
+    auto prefix_l = SliceFromArray( file_l );
+    auto prefix_r = SliceFromArray( file_r );
+    idx_t nlines = 0;
+    For( i, 0, prefix_l.len ) {
+      nlines += prefix_l.mem[i] == '\n';
+      if( nlines == c_nlines_hirschberg ) {
+        prefix_l.len = i + 1;
+        break;
+      }
+    }
+    nlines = 0;
+    For( i, 0, prefix_r.len ) {
+      nlines += prefix_r.mem[i] == '\n';
+      if( nlines == c_nlines_hirschberg ) {
+        prefix_r.len = i + 1;
+        break;
+      }
+    }
+
+    auto t0 = TimeTSC();
+    DiffFiles( diff, prefix_l, prefix_r, diffalgo_t::myers, 0 );
+    auto t1 = TimeTSC();
+
+    tslice_t<u32> x = { diff.ids_l.mem, diff.ids_l.len };
+    tslice_t<u32> y = { diff.ids_r.mem, diff.ids_r.len };
+    auto x_mid = x.len / 2;
+    tslice_t<u32> x_left = { x.mem, x_mid };
+    tslice_t<u32> x_rght = { x.mem + x_mid, x.len - x_mid };
+    auto score = AllocString<s32>( 2 * ( y.len + 1 ) );
+    auto score_l = AllocString<s32>( y.len + 1 );
+    auto score_r = AllocString<s32>( y.len + 1 );
+    auto cost_insdel = []( u32 c ) { return -2; };
+    auto cost_rep = []( u32 a, u32 b ) { return a == b  ?  2  :  -1; };
+    auto t2 = TimeTSC();
+    FMatrixLastRow( y, x_left, score.mem, cost_rep, cost_insdel, cost_insdel, score_l.mem );
+    FMatrixLastRowReverse( y, x_rght, score.mem, cost_rep, cost_insdel, cost_insdel, score_r.mem );
+    auto t3 = TimeTSC();
+    Free( score_r );
+    Free( score_l );
+    Free( score );
+
+    printf( "%10s  %10s  %10s\n", "lines", "myers ms", "hirschberg ms (first split)" );
+    printf(
+      "%10llu  %10.3f  %10.1f\n",
+      Cast( unsigned long long, c_nlines_hirschberg ),
+      1e3 * TimeSecFromTSC64( t1 - t0 ),
+      1e3 * TimeSecFromTSC64( t3 - t2 )
+      );
+  }
+
+  Kill( diff );
+  Free( lines );
+  Free( file_r );
+  Free( file_l );
+}
+
 int
 Main( u8* cmdline, idx_t cmdline_len )
 {
@@ -956,6 +1544,14 @@ Main( u8* cmdline, idx_t cmdline_len )
     g_tests[i]();
   }
 
+  idx_t bench_idx;
+  if( StringIdxScanR( &bench_idx, cmdline, cmdline_len, 0, Str( "bench" ), 5, 0, 0 ) ) {
+    BenchBufLines();
+    BenchBufUndo();
+    BenchCsvIngest();
+    BenchDiff();
+  }
+
 //  CalcJunk();
 
 //#if defined(WIN)
@@ -30,16 +30,20 @@
 #include "ds_stack_cstyle.h"
 #include "ds_hashset_cstyle.h"
 #include "filesys.h"
+#include "cstr_integer.h"
+#include "cstr_float.h"
 #include "timedate.h"
+#include "thread_atomics.h"
 #include "ds_mtqueue_mrmw_nonresizeable.h"
 #include "ds_mtqueue_mrsw_nonresizeable.h"
 #include "ds_mtqueue_srmw_nonresizeable.h"
 #include "ds_mtqueue_srsw_nonresizeable.h"
-#include "thread_atomics.h"
+#include "ds_mtdeque_worksteal_nonresizeable.h"
 #include "threading.h"
+#include "ds_stack_resizeable_cont_addbacks.h"
 #define LOGGER_ENABLED   0
 #include "logger.h"
-#define PROF_ENABLED   0
+#define PROF_ENABLED   1
 #define PROF_ENABLED_AT_LAUNCH   0
 #include "profile.h"
 #include "rand.h"
@@ -47,8 +51,6 @@
 #include "mainthread.h"
 
 
-#if defined(WIN)
-
 // TODO: move this to test!
 
 
@@ -103,8 +105,8 @@ Enumc( workerstate_t )
   pushwork,
 };
 
-u32 __stdcall
-MainWorker( LPVOID data )
+u32 STDCALLWIN
+MainWorker( void* data )
 {
   ThreadInit();
 
@@ -194,11 +196,11 @@ TestThreadedQueues()
   worker_t workers[num_threads];
 #if !SINGLEm2w
   mtqueue_mrsw_t<m2w_t> qm2w;
-  AllocQueue( qm2w, num_threads * 8 );
+  Alloc( qm2w, num_threads * 8 );
 #endif
 #if !SINGLEw2m
   mtqueue_srmw_t<w2m_t> qw2m;
-  AllocQueue( qw2m, num_threads * 8 );
+  Alloc( qw2m, num_threads * 8 );
 #endif
 
   for( u32 i = 0;  i < num_threads;  ++i ) {
@@ -230,11 +232,20 @@ TestThreadedQueues()
   ProfClose( queue_init );
 
   Prof( thread_init );
+#if defined(WIN)
   HANDLE threads_w[num_threads];
   for( u32 i = 0;  i < num_threads;  ++i ) {
     threads_w[i] = Cast( HANDLE, _beginthreadex( 0, 0, MainWorker, &workers[i], 0, 0 ) );
     AssertWarn( threads_w[i] );
   }
+#elif defined(MAC)
+  pthread_t threads_w[num_threads];
+  for( u32 i = 0;  i < num_threads;  ++i ) {
+    threads_w[i] = ThreadStart( MainWorker, &workers[i] );
+  }
+#else
+#error Unsupported platform
+#endif
   ProfClose( thread_init );
 
   TimeSleep( 1 );
@@ -276,8 +287,14 @@ TestThreadedQueues()
   g_quit = 1;
   printf( "quit\n" );
   for( u32 i = 0;  i < num_threads;  ++i ) {
+#if defined(WIN)
     DWORD wait = WaitForSingleObject( threads_w[i], INFINITE );
     AssertWarn( wait == WAIT_OBJECT_0 );
+#elif defined(MAC)
+    ThreadWait( threads_w[i] );
+#else
+#error Unsupported platform
+#endif
   }
   ProfClose( thread_kill );
 
@@ -306,6 +323,586 @@ TestThreadedQueues()
 }
 
 
+Inl void
+SignalMainWake()
+{
+#if defined(WIN)
+  auto r = SetEvent( g_mainthread.wake_asynctaskscompleted );
+  AssertCrash( r );
+#elif defined(MAC)
+  Set( g_mainthread.wake_asynctaskscompleted );
+#else
+#error Unsupported platform
+#endif
+}
+
+Inl void
+WaitForMainWake()
+{
+#if defined(WIN)
+  DWORD wait = WaitForSingleObject( g_mainthread.wake_asynctaskscompleted, INFINITE );
+  AssertWarn( wait == WAIT_OBJECT_0 );
+#elif defined(MAC)
+  Wait( g_mainthread.wake_asynctaskscompleted );
+#else
+#error Unsupported platform
+#endif
+}
+
+// exercises the g_mainthread task system end to end:
+// async tasks on the taskthreads, completions back through the per-taskthread output queues.
+
+static const u32 num_asynctasks = 20000;
+
+struct
+asynctest_t
+{
+  u32 data[64];
+};
+
+struct
+asynctestresults_t
+{
+  u64 sum;
+  u32 num_completed;
+};
+
+__MainTaskCompleted( MainTaskCompleted_AsyncTest )
+{
+  auto results = Cast( asynctestresults_t*, misc0 );
+  results->sum += Cast( u64, misc1 );
+  results->num_completed += 1;
+}
+
+__AsyncTask( AsyncTask_AsyncTest )
+{
+  auto test = Cast( asynctest_t*, misc0 );
+  u64 sum = 0;
+  For( i, 0, _countof( test->data ) ) {
+    sum += test->data[i];
+  }
+
+  maincompletedqueue_entry_t entry;
+  entry.FnMainTaskCompleted = MainTaskCompleted_AsyncTest;
+  entry.misc0 = misc1;
+  entry.misc1 = Cast( void*, sum );
+  entry.misc2 = 0;
+  entry.time_generated = TimeTSC();
+  PushMainTaskCompleted( taskthread, &entry );
+}
+
+void
+TestAsyncTasks()
+{
+  auto tests = MemHeapAlloc( asynctest_t, num_asynctasks );
+  For( i, 0, num_asynctasks ) {
+    For( j, 0, _countof( tests[i].data ) ) {
+      tests[i].data[j] = Cast( u32, i );
+    }
+  }
+
+  asynctestresults_t results = {};
+
+  auto time0 = TimeClock();
+  For( i, 0, num_asynctasks ) {
+    asyncqueue_entry_t entry;
+    entry.FnAsyncTask = AsyncTask_AsyncTest;
+    entry.misc0 = tests + i;
+    entry.misc1 = &results;
+    entry.time_generated = TimeTSC();
+    PushAsyncTask( i, &entry );
+  }
+
+  // note the completion callbacks only run here on the main thread, so results doesn't need atomics.
+  while( results.num_completed < num_asynctasks ) {
+    WaitForMainWake();
+    FORLEN( t, i, g_mainthread.taskthreads )
+      Forever {
+        bool success;
+        maincompletedqueue_entry_t entry;
+        DequeueS( t->output, &entry, &success );
+        if( !success ) {
+          break;
+        }
+        bool target_valid = 1;
+        entry.FnMainTaskCompleted( &target_valid, entry.misc0, entry.misc1, entry.misc2 );
+      }
+    }
+  }
+  auto time1 = TimeClock();
+
+  u64 expected = 0;
+  For( i, 0, num_asynctasks ) {
+    expected += Cast( u64, i ) * _countof( tests[i].data );
+  }
+  AssertWarn( results.sum == expected );
+  printf( "%llu, %llu\n", Cast( unsigned long long, results.sum ), Cast( unsigned long long, expected ) );
+  printf( "%u async tasks on %llu taskthreads: %f sec\n", num_asynctasks, Cast( unsigned long long, g_mainthread.taskthreads.len ), TimeSecFromClocks64( time1 - time0 ) );
+
+  MemHeapFree( tests );
+}
+
+
+// ParallelFor should visit every item exactly once, with dense worker indices.
+
+struct
+parallelfortest_t
+{
+  volatile u32* visits;
+  volatile u32* workers_seen;
+};
+
+__ParallelForBody( ParallelFor_Test )
+{
+  auto test = Cast( parallelfortest_t*, misc );
+  InterlockedIncrement( test->visits + k );
+  test->workers_seen[worker] = 1;
+}
+
+void
+TestParallelFor()
+{
+  constant idx_t c_nitems = 100000;
+  auto max_workers = g_mainthread.taskthreads.len + 1;
+  parallelfortest_t test;
+  test.visits = MemHeapAlloc( u32, c_nitems );
+  test.workers_seen = MemHeapAlloc( u32, max_workers );
+  For( serial, 0, 2 ) {
+    For( i, 0, c_nitems ) {
+      test.visits[i] = 0;
+    }
+    For( i, 0, max_workers ) {
+      test.workers_seen[i] = 0;
+    }
+    auto nworkers = ParallelFor( ParallelFor_Test, &test, c_nitems, serial  ?  1  :  max_workers );
+    AssertCrash( nworkers  &&  nworkers <= ( serial  ?  1  :  max_workers ) );
+    For( i, 0, c_nitems ) {
+      AssertCrash( test.visits[i] == 1 );
+    }
+    For( i, 0, max_workers ) {
+      AssertCrash( test.workers_seen[i] == ( i < nworkers ) );
+    }
+  }
+  AssertCrash( ParallelFor( ParallelFor_Test, &test, 0, max_workers ) == 0 );
+  MemHeapFree( Cast( u32*, test.visits ) );
+  MemHeapFree( Cast( u32*, test.workers_seen ) );
+}
+
+
+void
+TestExecute()
+{
+#if defined(WIN)
+  auto cmd = SliceFromCStr( "cmd.exe /c for /l %i in (1,1,20000) do @echo line %i" );
+#elif defined(MAC)
+  auto cmd = SliceFromCStr( "i=1; while [ $i -le 20000 ]; do echo line $i; i=$((i+1)); done; exit 3" );
+#else
+#error Unsupported platform
+#endif
+  stack_resizeable_pagelist_t<u8> output;
+  Init( output, 4096 );
+  s32 r = Execute( cmd, 0, OutputForExecute, &output, 0 );
+#if defined(MAC)
+  AssertWarn( r == 3 );
+#endif
+  printf( "Execute returned %d, %llu bytes of streamed output\n", r, Cast( unsigned long long, output.totallen ) );
+  Kill( output );
+}
+
+
+// scheduler benchmarks: the workstealing scheduler against the old pull model.
+// all of these use tiny tasks, so we're measuring scheduling overhead rather than the work itself.
+
+static const u32 num_tinytasks = 1000000;
+static const u32 num_wakesamples = 200;
+
+struct
+tinytasks_t
+{
+  u64* time_pushed; // tsc
+  u64* time_started; // tsc
+  volatile idx_t num_done;
+  idx_t num_total;
+};
+
+__AsyncTask( AsyncTask_Tiny )
+{
+  auto tiny = Cast( tinytasks_t*, misc0 );
+  auto i = Cast( idx_t, misc1 );
+  tiny->time_started[i] = TimeTSC();
+  if( InterlockedIncrement( &tiny->num_done ) == tiny->num_total ) {
+    SignalMainWake();
+  }
+}
+
+// percentiles of time_started - time_pushed, in microseconds.
+void
+PrintTaskLatencies( const char* label, tinytasks_t& tiny, idx_t num )
+{
+  auto latencies = MemHeapAlloc( u64, num );
+  For( i, 0, num ) {
+    AssertWarn( tiny.time_started[i] );
+    latencies[i] = tiny.time_started[i] - tiny.time_pushed[i];
+  }
+  std::sort( latencies, latencies + num );
+  auto Percentile = [&]( f64 p )
+  {
+    auto i = MIN( Cast( idx_t, p * num ), num - 1 );
+    return 1e6 * TimeSecFromTSC64( latencies[i] );
+  };
+  printf(
+    "  %s latency usec: p50 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n",
+    label,
+    Percentile( 0.5 ),
+    Percentile( 0.99 ),
+    Percentile( 0.999 ),
+    Percentile( 1.0 )
+    );
+  MemHeapFree( latencies );
+}
+
+// 1M tiny tasks pushed from the main thread as fast as it can.
+void
+BenchmarkPushThroughput( tinytasks_t& tiny )
+{
+  tiny.num_done = 0;
+  tiny.num_total = num_tinytasks;
+  Memzero( tiny.time_started, num_tinytasks * sizeof( u64 ) );
+
+  auto time0 = TimeClock();
+  For( i, 0, num_tinytasks ) {
+    asyncqueue_entry_t entry;
+    entry.FnAsyncTask = AsyncTask_Tiny;
+    entry.misc0 = &tiny;
+    entry.misc1 = Cast( void*, i );
+    entry.time_generated = TimeTSC();
+    tiny.time_pushed[i] = entry.time_generated;
+    PushAsyncTask( i, &entry );
+  }
+  while( tiny.num_done < num_tinytasks ) {
+    WaitForMainWake();
+  }
+  auto sec = TimeSecFromClocks64( TimeClock() - time0 );
+
+  printf( "  push throughput: %.2f M tasks/sec ( %f sec )\n", num_tinytasks / sec / 1e6, sec );
+  PrintTaskLatencies( "queueing", tiny, num_tinytasks );
+}
+
+
+struct
+forkjoinrange_t
+{
+  tinytasks_t* tiny;
+  idx_t start;
+  idx_t end;
+};
+
+// split the range in half, fork the left and recurse into the right ourselves, until we're down to single tasks.
+// note with the pull scheduler, forks just run inline, so this is serial there.
+__AsyncTask( AsyncTask_ForkJoin )
+{
+  auto range = Cast( forkjoinrange_t*, misc0 );
+  if( range->end - range->start == 1 ) {
+    range->tiny->time_started[range->start] = TimeTSC();
+    return;
+  }
+  auto mid = range->start + ( range->end - range->start ) / 2;
+  forkjoinrange_t left = { range->tiny, range->start, mid };
+  forkjoinrange_t right = { range->tiny, mid, range->end };
+
+  // the left range lives on our stack, which is fine since we don't return until the join.
+  asyncjoin_t join = {};
+  asyncqueue_entry_t entry;
+  entry.FnAsyncTask = AsyncTask_ForkJoin;
+  entry.misc0 = &left;
+  entry.misc1 = 0;
+  entry.time_generated = TimeTSC();
+  ForkAsyncTask( taskthread, &join, &entry );
+
+  AsyncTask_ForkJoin( taskthread, &right, 0 );
+
+  JoinAsyncTasks( taskthread, &join );
+}
+
+__AsyncTask( AsyncTask_ForkJoinRoot )
+{
+  AsyncTask_ForkJoin( taskthread, misc0, misc1 );
+  auto range = Cast( forkjoinrange_t*, misc0 );
+  range->tiny->num_done = range->tiny->num_total;
+  SignalMainWake();
+}
+
+// 1M tiny tasks spawned recursively from inside a single task.
+void
+BenchmarkForkJoin( tinytasks_t& tiny )
+{
+  tiny.num_done = 0;
+  tiny.num_total = num_tinytasks;
+  Memzero( tiny.time_started, num_tinytasks * sizeof( u64 ) );
+
+  forkjoinrange_t range = { &tiny, 0, num_tinytasks };
+  auto time0 = TimeClock();
+  asyncqueue_entry_t entry;
+  entry.FnAsyncTask = AsyncTask_ForkJoinRoot;
+  entry.misc0 = &range;
+  entry.misc1 = 0;
+  entry.time_generated = TimeTSC();
+  PushAsyncTask( 0, &entry );
+  while( tiny.num_done < num_tinytasks ) {
+    WaitForMainWake();
+  }
+  auto sec = TimeSecFromClocks64( TimeClock() - time0 );
+
+  For( i, 0, num_tinytasks ) {
+    AssertWarn( tiny.time_started[i] );
+  }
+  printf( "  fork/join throughput: %.2f M tasks/sec ( %f sec )\n", num_tinytasks / sec / 1e6, sec );
+}
+
+// one task at a time, pushed after the taskthreads have had time to go to sleep.
+void
+BenchmarkWakeLatency( tinytasks_t& tiny )
+{
+  For( i, 0, num_wakesamples ) {
+    TimeSleep( 2 );
+    tiny.num_done = 0;
+    tiny.num_total = 1;
+    tiny.time_started[i] = 0;
+
+    asyncqueue_entry_t entry;
+    entry.FnAsyncTask = AsyncTask_Tiny;
+    entry.misc0 = &tiny;
+    entry.misc1 = Cast( void*, i );
+    entry.time_generated = TimeTSC();
+    tiny.time_pushed[i] = entry.time_generated;
+    PushAsyncTask( 0, &entry );
+    while( !tiny.num_done ) {
+      WaitForMainWake();
+    }
+  }
+  PrintTaskLatencies( "wake", tiny, num_wakesamples );
+}
+
+void
+BenchmarkSchedulers()
+{
+  tinytasks_t tiny = {};
+  tiny.time_pushed = MemHeapAlloc( u64, num_tinytasks );
+  tiny.time_started = MemHeapAlloc( u64, num_tinytasks );
+
+  scheduler_t schedulers[] = { scheduler_t::pull, scheduler_t::workstealing };
+  const char* scheduler_names[] = { "pull", "workstealing" };
+  CompileAssert( _countof( schedulers ) == _countof( scheduler_names ) );
+
+  For( i, 0, _countof( schedulers ) ) {
+    // restart the taskthreads under this scheduler.
+    SignalQuitAndWaitForTaskThreads();
+    TaskThreadsKill();
+    TaskThreadsInit( schedulers[i] );
+
+    printf( "%s scheduler, %llu taskthreads:\n", scheduler_names[i], Cast( unsigned long long, g_mainthread.taskthreads.len ) );
+    BenchmarkPushThroughput( tiny );
+    BenchmarkForkJoin( tiny );
+    BenchmarkWakeLatency( tiny );
+  }
+
+  MemHeapFree( tiny.time_pushed );
+  MemHeapFree( tiny.time_started );
+}
+
+
+// profiler overhead: the cost of one empty Prof scope, with profiling disabled and enabled.
+// we want this small enough to leave profiling compiled in for shipping builds.
+
+static const u32 num_profscopes = 10000000;
+
+static volatile idx_t g_profbench_sink = 0;
+
+// returns the average cost of one loop iteration, in nanoseconds.
+f64
+ProfBenchLoop( bool with_scope )
+{
+  auto time0 = TimeTSC();
+  if( with_scope ) {
+    For( i, 0, num_profscopes ) {
+      Prof( profbench_scope );
+      g_profbench_sink = g_profbench_sink + 1;
+    }
+  }
+  else {
+    For( i, 0, num_profscopes ) {
+      g_profbench_sink = g_profbench_sink + 1;
+    }
+  }
+  return 1e9 * TimeSecFromTSC64( TimeTSC() - time0 ) / num_profscopes;
+}
+
+struct
+profbench_t
+{
+  f64* ns_per_scope; // one per taskthread.
+  volatile idx_t num_done;
+  idx_t num_total;
+};
+
+__AsyncTask( AsyncTask_ProfBench )
+{
+  auto bench = Cast( profbench_t*, misc0 );
+  auto i = Cast( idx_t, misc1 );
+  bench->ns_per_scope[i] = ProfBenchLoop( 1 ) - ProfBenchLoop( 0 );
+  if( InterlockedIncrement( &bench->num_done ) == bench->num_total ) {
+    SignalMainWake();
+  }
+}
+
+void
+BenchmarkProfOverhead()
+{
+  printf( "profiler overhead, %u scopes:\n", num_profscopes );
+
+  auto ns_base = ProfBenchLoop( 0 );
+  ProfDisable();
+  auto ns_disabled = ProfBenchLoop( 1 );
+  ProfEnable();
+  auto ns_enabled = ProfBenchLoop( 1 );
+  ProfDisable();
+  printf( "  disabled: %.2f ns/scope\n", ns_disabled - ns_base );
+  printf( "  enabled, 1 thread: %.2f ns/scope\n", ns_enabled - ns_base );
+
+  // each scope takes two timestamps, so report what those cost on their own.
+  // e.g. under some hypervisors rdtsc traps, and that dominates everything else.
+  auto time0 = TimeTSC();
+  For( i, 0, num_profscopes ) {
+    g_profbench_sink = g_profbench_sink + TimeTSC();
+  }
+  auto ns_tsc = 1e9 * TimeSecFromTSC64( TimeTSC() - time0 ) / num_profscopes;
+  printf( "  TimeTSC alone: %.2f ns\n", ns_tsc - ns_base );
+
+  // the main thread's ring should hold the newest records, up to the ring size.
+  // a full ring reads back one short, since the oldest slot is the one the writer would overwrite next.
+#if PROF_SPLITSCOPES
+  idx_t num_records = 2 * Cast( idx_t, num_profscopes );
+#else
+  idx_t num_records = num_profscopes;
+#endif
+  stack_resizeable_cont_t<prof_elem_t> elems;
+  Alloc( elems, 65536 );
+  stack_resizeable_cont_t<prof_thread_t> threads;
+  Alloc( threads, 16 );
+  ProfSnapshot( elems, threads );
+  AssertCrash( threads.len == 1 );
+  AssertCrash( threads.mem[0].tid == GetThreadIdFast() );
+  AssertCrash( elems.len == MIN( num_records, PROF_RING_LEN - 1 ) );
+  For( i, 1, elems.len ) {
+    auto elem = elems.mem + i;
+#if PROF_SPLITSCOPES
+    AssertCrash( elems.mem[i - 1].time <= elem->time );
+#else
+    AssertCrash( elem->time_start <= elem->time_end );
+    AssertCrash( elems.mem[i - 1].time_end <= elem->time_end );
+#endif
+  }
+  ProfReset();
+
+  // every taskthread logging at once. since each has its own ring, we expect roughly the 1 thread cost.
+  auto ntaskthreads = g_mainthread.taskthreads.len;
+  profbench_t bench = {};
+  bench.ns_per_scope = MemHeapAlloc( f64, ntaskthreads );
+  bench.num_total = ntaskthreads;
+  ProfEnable();
+  For( i, 0, ntaskthreads ) {
+    asyncqueue_entry_t entry;
+    entry.FnAsyncTask = AsyncTask_ProfBench;
+    entry.misc0 = &bench;
+    entry.misc1 = Cast( void*, i );
+    entry.time_generated = TimeTSC();
+    PushAsyncTask( i, &entry );
+  }
+  while( bench.num_done < bench.num_total ) {
+    WaitForMainWake();
+  }
+  ProfDisable();
+  f64 ns_max = 0;
+  For( i, 0, ntaskthreads ) {
+    ns_max = MAX( ns_max, bench.ns_per_scope[i] );
+  }
+  printf( "  enabled, %llu threads: %.2f ns/scope worst thread\n", Cast( unsigned long long, ntaskthreads ), ns_max );
+
+  elems.len = 0;
+  threads.len = 0;
+  ProfSnapshot( elems, threads );
+  FORLEN( thread, i, threads )
+    AssertCrash( thread->elems_len == MIN( num_records, PROF_RING_LEN - 1 ) );
+  }
+  ProfReset();
+
+  MemHeapFree( bench.ns_per_scope );
+  Free( threads );
+  Free( elems );
+}
+
+
+// export throughput: fill the main thread's ring with nested scopes, then time each file exporter.
+
+typedef bool ( *pfn_profexport_t )( u8* filename, idx_t filename_len );
+
+void
+BenchmarkProfExport()
+{
+  ProfReset();
+  ProfEnable();
+  For( i, 0, PROF_RING_LEN / 3 ) {
+    Prof( profexport_outer );
+    {
+      Prof( profexport_middle );
+      {
+        Prof( profexport_inner );
+        g_profbench_sink = g_profbench_sink + 1;
+      }
+    }
+  }
+  ProfDisable();
+
+  const char* labels[] = { "chrome trace", "flame graph" };
+  const char* filenames[] = { "profbench_trace.json", "profbench_flame.txt" };
+  pfn_profexport_t exports[] = { ProfOutputChromeTrace, ProfOutputFlameGraph };
+  CompileAssert( _countof( labels ) == _countof( exports ) );
+  CompileAssert( _countof( filenames ) == _countof( exports ) );
+
+  printf( "profiler export, %llu records:\n", Cast( unsigned long long, PROF_RING_LEN - 1 ) );
+  For( i, 0, _countof( exports ) ) {
+    // write next to the exe, and clean up after.
+    fsobj_t filename = FsGetExe();
+    auto last_slash = StringScanL( ML( filename ), '/' );
+    filename.len = last_slash  ?  ( last_slash - filename.mem + 1 )  :  0;
+    auto name_len = CstrLength( Str( filenames[i] ) );
+    Memmove( AddBack( filename, name_len ), filenames[i], name_len );
+    filename.mem[filename.len] = 0;
+
+    auto time0 = TimeClock();
+    auto exported = exports[i]( ML( filename ) );
+    auto sec = TimeSecFromClocks64( TimeClock() - time0 );
+    AssertCrash( exported );
+
+    u64 size = 0;
+    u64 time = 0;
+    FileSizeAndTimeLastWrite( ML( filename ), &size, &time );
+    FileDelete( ML( filename ) );
+
+    printf(
+      "  %s: %.2f M records/sec, %.1f MB, %.2f sec per 100M records\n",
+      labels[i],
+      ( PROF_RING_LEN - 1 ) / sec / 1e6,
+      size / 1e6,
+      sec * 100e6 / ( PROF_RING_LEN - 1 )
+      );
+  }
+  ProfReset();
+}
+
+
+#if defined(WIN)
+
 static const s64 delay_over_sec = -10000000;
 static const s64 delay_over_millisec = -10000;
 static const s32 timeout_period_millisec = 5000;
@@ -325,7 +922,7 @@ TestTimerDelay()
   u64 time0 = TimeClock();
   u64 count = 0;
   s64 period = delay_over_millisec / 1;
-  while( TimeSecFromClocks32( time0, TimeClock() ) < test_timeout_sec ) {
+  while( TimeSecFromClocks32( TimeClock() - time0 ) < test_timeout_sec ) {
     Prof( mainloop );
 #if 1
     bool success = !!SetWaitableTimer( timer, Cast( LARGE_INTEGER*, &period ), 0, 0, 0, 0 );
@@ -374,7 +971,7 @@ TestTimerDelayThenPeriodic()
   u64 time0 = TimeClock();
   u64 time_start = time0;
   u64 count = 0;
-  while( TimeSecFromClocks32( time_start, TimeClock() ) < test_timeout_sec ) {
+  while( TimeSecFromClocks32( TimeClock() - time_start ) < test_timeout_sec ) {
     Prof( mainloop );
     DWORD waitres = MsgWaitForMultipleObjects( 1, wait_timers, 0, timeout_period_millisec, QS_ALLINPUT );
     if( waitres == WAIT_FAILED ) {
@@ -384,11 +981,11 @@ TestTimerDelayThenPeriodic()
     } elif( waitres == WAIT_OBJECT_0 ) {
       if( count == 0 ) {
         u64 time1 = TimeClock();
-        Add( fdelay, TimeSecFromClocks32( time0, time1 ) );
+        Add( fdelay, TimeSecFromClocks32( time1 - time0 ) );
         time0 = time1;
       } else {
         u64 time1 = TimeClock();
-        Add( fperiod, TimeSecFromClocks32( time0, time1 ) );
+        Add( fperiod, TimeSecFromClocks32( time1 - time0 ) );
         time0 = time1;
       }
       //printf( "tick!\n" );
@@ -434,7 +1031,7 @@ TestMultiplePeriodicTimers()
   u64 time_start = TimeClock();
   u64 time0[2] = { time_start, time_start };
   u64 count[2] = {};
-  while( TimeSecFromClocks32( time_start, TimeClock() ) < test_timeout_sec ) {
+  while( TimeSecFromClocks32( TimeClock() - time_start ) < test_timeout_sec ) {
     Prof( mainloop );
     DWORD waitres = MsgWaitForMultipleObjects( 2, wait_timers, 0, timeout_period_millisec, QS_ALLINPUT );
     if( waitres == WAIT_FAILED ) {
@@ -444,11 +1041,11 @@ TestMultiplePeriodicTimers()
     } elif( waitres == WAIT_OBJECT_0 + 0 ) {
       if( count[0] == 0 ) {
         u64 time1 = TimeClock();
-        Add( fdelay[0], TimeSecFromClocks32( time0[0], time1 ) );
+        Add( fdelay[0], TimeSecFromClocks32( time1 - time0[0] ) );
         time0[0] = time1;
       } else {
         u64 time1 = TimeClock();
-        Add( fperiod[0], TimeSecFromClocks32( time0[0], time1 ) );
+        Add( fperiod[0], TimeSecFromClocks32( time1 - time0[0] ) );
         time0[0] = time1;
       }
       //printf( "tick!\n" );
@@ -456,11 +1053,11 @@ TestMultiplePeriodicTimers()
     } elif( waitres == WAIT_OBJECT_0 + 1 ) {
       if( count[1] == 0 ) {
         u64 time1 = TimeClock();
-        Add( fdelay[1], TimeSecFromClocks32( time0[1], time1 ) );
+        Add( fdelay[1], TimeSecFromClocks32( time1 - time0[1] ) );
         time0[1] = time1;
       } else {
         u64 time1 = TimeClock();
-        Add( fperiod[1], TimeSecFromClocks32( time0[1], time1 ) );
+        Add( fperiod[1], TimeSecFromClocks32( time1 - time0[1] ) );
         time0[1] = time1;
       }
       //printf( "tick!\n" );
@@ -483,13 +1080,28 @@ TestMultiplePeriodicTimers()
 
 
 
+#endif // WIN
+
+
+
 int
 Main( u8* cmdline, idx_t cmdline_len )
 {
   TestThreadedQueues();
+  TestAsyncTasks();
+  TestParallelFor();
+  TestExecute();
+  BenchmarkSchedulers();
+  BenchmarkProfOverhead();
+  BenchmarkProfExport();
+#if defined(WIN)
   TestTimerDelay();
   TestTimerDelayThenPeriodic();
   TestMultiplePeriodicTimers();
+#endif
+
+  // Do this before destroying any datastructures, so other threads stop trying to access things.
+  SignalQuitAndWaitForTaskThreads();
 
   return 0;
 }
@@ -497,7 +1109,7 @@ Main( u8* cmdline, idx_t cmdline_len )
 
 
 
-#if defined(_DEBUG)
+#if defined(_DEBUG) || defined(MAC)
 
 int
 main( int argc, char** argv )
@@ -518,7 +1130,9 @@ main( int argc, char** argv )
   MainKill();
 
   printf( "Main returned: %d\n", r );
+#if defined(WIN)
   system( "pause" );
+#endif
 
   return r;
 }
@@ -547,5 +1161,3 @@ WinMain( HINSTANCE prog_inst, HINSTANCE prog_inst_prev, LPSTR prog_cmd_line, int
 }
 
 #endif
-
-#endif // WIN
@@ -153,19 +153,19 @@ Inl f32 fastpow32( f32 x, f32 e )
 
 #if defined(MAC) // TODO: do this better.
 
-  #define Floor32( x )   std::floorf( x )
+  #define Floor32( x )   ::floorf( x )
   #define Floor64( x )   std::floor( x )
 
-  #define Ceil32( x )   std::ceilf( x )
+  #define Ceil32( x )   ::ceilf( x )
   #define Ceil64( x )   std::ceil( x )
 
   #define Truncate32( x )   Cast( f32, Truncate_s32_from_f32( x ) )
   #define Truncate64( x )   Cast( f64, Truncate_s64_from_f64( x ) )
 
-  #define Round32( x )   std::roundf( x )
+  #define Round32( x )   ::roundf( x )
   #define Round64( x )   std::round( x )
 
-  #define Sqrt32( x )   std::sqrtf( x )
+  #define Sqrt32( x )   ::sqrtf( x )
   #define Sqrt64( x )   std::sqrt( x )
 
 #else
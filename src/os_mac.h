@@ -5,5 +5,38 @@
   #define _countof( array )   ( sizeof( array ) / sizeof( ( array )[0] ) )
 
   #define __fallthrough   /*nothing*/
-  
+
+  // note MAC is our one non-windows platform switch; it's really a posix build, so it also covers linux.
+  // platform-specific bits below MAC are guarded by __APPLE__ / __linux__ where they differ.
+  #if !defined(_MSC_EXTENSIONS)
+    #define __forceinline   inline __attribute__(( always_inline ))
+    #define __declspec( x )   /*nothing*/
+    #define __cdecl   /*nothing*/
+    #define __debugbreak()   __builtin_trap()
+  #endif
+
+  // the ds_mtqueue headers use this before thread_atomics.h is included, so it has to live here.
+  #define _ReadWriteBarrier()   __atomic_thread_fence( __ATOMIC_SEQ_CST )
+
+  #include <pthread.h>
+  #include <sched.h>
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <signal.h>
+  #include <spawn.h>
+  #include <sys/wait.h>
+  #include <sys/stat.h>
+  #include <sys/mman.h>
+  #include <dirent.h>
+  #include <errno.h>
+  #if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+  #endif
+  #if defined(__linux__)
+    #include <sys/syscall.h>
+    #include <linux/futex.h>
+  #endif
+
+  extern char** environ;
+
 #endif
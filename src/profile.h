@@ -18,18 +18,26 @@
 #define ProfClose( zone_label ) // nothing
 #define ProfOutputZoneStats() // nothing
 #define ProfOutputTimeline() // nothing
+#define ProfOutputChromeTrace( filename, filename_len )   ( 0 )
+#define ProfOutputFlameGraph( filename, filename_len )   ( 0 )
 #define ProfKill() // nothing
 
 #else // PROF_ENABLED
 
 
 
-// size of the one prof_elem_t buffer, which stores all the records.
-#define PROF_STORE_MAX   10ULL*1024*1024*1024
+// records per thread. each thread that opens a scope gets its own ring of this many records, and once it
+// wraps, the oldest records get overwritten. must be a power of 2.
+#define PROF_RING_LEN   ( 1ULL << 21 )
 
+// max number of threads we'll keep rings for. threads past this just don't get profiled.
+#define PROF_MAX_THREADS   256
 
 
 
+// split scopes log a record at scope-start and another at scope-end, so live views can see scopes that
+// are still running. that's 2x16bytes per scope, instead of one 24byte record at scope-end.
+// for offline logs, the non-split representation is what we want.
 #define PROF_SPLITSCOPES   0
 
 #define PROF_DEPTHCOUNT    1
@@ -40,78 +48,65 @@
 
 
 //
-// i'm thinking we really only need: { time_start, time_end, tid, id }
-// that'd take us from 44bytes -> 20bytes, and eliminate a subtraction.
-// assuming memory/caching is the bottleneck, that should be ~2x as fast.
+// every thread writes into its own ring, so there's no shared atomic inc on the hot path, and no cache
+// line ping-pong between threads. the tid lives once per ring, not per record.
 //
-// we can store { name, file, line } per-id, into a separate structure.
-// and we only need to store those once, so maybe we do a static bool or something per-id.
-// hopefully branch prediction would eat most of the cost of those static bools per-id.
-// we'd have to be careful with multiple threads writing to that separate structure, so that's something to
-//   think about going forward.
+// we store { name, file, line } per-id, into g_prof_locations, once per id guarded by a static bool.
+// hopefully branch prediction eats most of the cost of those static bools.
 //
-// there's also alternate methods for { name, file, line }, like source-scanning, if we really want to
-// get rid of all the runtime cost.
-// i'm hopeful the static bool would make most of that unnecessary, but you never know.
-// we could try just dropping the { name, file, line } temporarily, just to see what the cost of the
-//   static bool approach is.
-// we wouldn't be able to do any analysis that way, but it's fine just for a quick perf test.
+// the owning thread is the only writer of a ring. it fills in the record, and then publishes it by bumping
+// ring->pos with a release store. readers ( the output functions, or a live ui on another thread ) copy
+// out the range they can see, and then re-read pos to drop anything the writer may have lapped during the
+// copy. so readers never block writers, and writers never wait on anything.
 //
-// for realtime ui, it'd be nice to see scopes that are currently running too.
-// to do that, we'd need to split this into scope-start and scope-end.
-// unfortunately i think that means logging tid/id redundantly, i.e.
-//   scope-start { tid, id, time_start };
-//   scope-end   { tid, id, time_end };
-// we'd also have to encode start/end somehow, probably as the high bit in id/tid.
-// that would make each of these 16bytes, so we'd have 16*2=32bytes per scope, instead of 20bytes per scope.
-// that's not actually 2x worse, so it's probably worth having this as an option.
-// e.g. for offline logs, the smaller 20byte representation is probably what we want.
-// but for online ui, the scope-start/end is useful, and it's not a huge price to pay.
-//
-// TODO: implement split scope entries as described above.
-//
-// TODO: how do we actually match scope-starts with scope-ends?
-//
-// i need to remember the last scope-start { id, tid, time }, so i can match and subtract.
-// note we'd need a stack, to handle nested scopes with the same id,tid values.
-// simplest thing would be one stack, and we just push on scope-start, and reverse search on scope-end.
-// presumably we could make that a little faster if we had multiple stacks, one per id or tid or id,tid.
+// to match scope-starts with scope-ends in the split case, we keep a stack of open scopes per thread.
+// since a thread's scopes nest, the matching start is almost always the top of that stack; we still
+// reverse search by id, since ring wraparound can drop starts.
 //
 struct
 prof_elem_t
 {
 #if PROF_SPLITSCOPES
   u64 time;
-  u32 tid;
   u32 start :  1,
          id : 31;
 #else
   u64 time_start;
   u64 time_end;
-  u32 tid;
   u32 id;
+#endif
 
 #if PROF_DEPTHCOUNT
   u32 depth;
 #else
-#endif
-
+  u32 unused;
 #endif
 };
 
-// TODO: buffer_t
-volatile prof_elem_t* g_prof_buffer;
-volatile idx_t g_prof_buffer_len;
-volatile idx_t g_prof_pos;
-volatile idx_t g_saved_prof_pos;
-volatile bool g_prof_enabled;
+struct
+prof_ring_t
+{
+  prof_elem_t* mem; // PROF_RING_LEN records.
+  volatile idx_t pos; // number of records ever written. only the owning thread writes this.
+  volatile idx_t pos_reset; // records before this are dropped. only ProfReset writes this.
+  const char* name; // g_thread_name when the ring was made; may be 0.
+  u32 tid;
 
 #if PROF_DEPTHCOUNT
-// start at MAX_u32, because we add one on scope-entry, and subtract on scope-exit.
-// the toplevel scopes should have depth=0, and MAX_u32+1 is 0.
-__declspec(thread) u32 g_depthcount = MAX_u32;
+  // start at MAX_u32, because we add one on scope-entry, and subtract on scope-exit.
+  // the toplevel scopes should have depth=0, and MAX_u32+1 is 0.
+  u32 depth;
 #else
 #endif
+};
+
+prof_ring_t* volatile g_prof_rings[PROF_MAX_THREADS] = {};
+volatile u32 g_prof_nrings;
+volatile bool g_prof_enabled;
+u64 g_prof_time_init; // tsc at ProfInit, which precedes every record. exports use it as time zero.
+
+thread_local prof_ring_t* g_prof_ring = 0;
+thread_local bool g_prof_ring_failed = 0;
 
 struct
 prof_loc_t
@@ -136,153 +131,167 @@ volatile prof_loc_t g_prof_locations[PROF_MAX_LOCATIONS] = {};
 
 
 
-
+// these only flip g_prof_enabled, so they're fine to call from any thread.
+// scopes that are already open when we disable still log their close, so depths stay balanced.
 Inl void
 ProfDisable()
 {
-  // TODO: not correct if multiple threads try to disable
-  //   if that's not the intention, why is g_prof_enabled volatile?
-  if( g_prof_enabled ) {
-    g_prof_enabled = 0;
-    g_saved_prof_pos = g_prof_pos;
-    g_prof_pos = g_prof_buffer_len;
-  }
+  g_prof_enabled = 0;
 }
 
 Inl void
 ProfEnable()
 {
-  // TODO: not correct if multiple threads try to disable
-  //   if that's not the intention, why is g_prof_enabled volatile?
-  if( !g_prof_enabled ) {
-    g_prof_enabled = 1;
-    g_prof_pos = g_saved_prof_pos;
-  }
+  g_prof_enabled = 1;
 }
 
+// drops all records logged so far.
+// we don't touch ring->pos, since that belongs to the owning thread; we just move the reset mark up to it.
 Inl void
 ProfReset()
 {
-  if( g_prof_enabled ) {
-    g_prof_pos = 0;
-  }
-  else {
-    g_saved_prof_pos = 0;
+  auto nrings = MIN( g_prof_nrings, PROF_MAX_THREADS );
+  For( i, 0, nrings ) {
+    auto ring = g_prof_rings[i];
+    if( ring ) {
+      ring->pos_reset = LoadAcquire( &ring->pos );
+    }
   }
 }
 
 Inl void
 ProfZero()
 {
-  g_prof_buffer = 0;
-  g_prof_buffer_len = 0;
-  g_prof_pos = 0;
-  g_saved_prof_pos = 0;
+  For( i, 0, PROF_MAX_THREADS ) {
+    g_prof_rings[i] = 0;
+  }
+  g_prof_nrings = 0;
+  g_prof_enabled = 0;
+  g_prof_time_init = 0;
+  g_prof_ring = 0;
+  g_prof_ring_failed = 0;
 }
 
 Inl void
 ProfInit()
 {
   ProfZero();
+  g_prof_time_init = TimeTSC();
 
-  g_prof_buffer_len = PROF_STORE_MAX / sizeof( prof_elem_t );
-  g_prof_buffer = MemVirtualAlloc( prof_elem_t, g_prof_buffer_len );
-  AssertCrash( g_prof_buffer );
-
-  ProfEnable();
-
-  // note we always enable first, and then disable if we need to.
-  // this is so we can share the same live save/restore logic as manual enable/disable.
-  #if !PROF_ENABLED_AT_LAUNCH
-    ProfDisable();
+  #if PROF_ENABLED_AT_LAUNCH
+    ProfEnable();
   #endif
 }
 
+// note this has to happen after every thread that profiled has stopped, since they hold pointers to their rings.
 Inl void
 ProfKill()
 {
-  MemVirtualFree( Cast( void*, g_prof_buffer ) );
+  auto nrings = MIN( g_prof_nrings, PROF_MAX_THREADS );
+  For( i, 0, nrings ) {
+    auto ring = g_prof_rings[i];
+    if( ring ) {
+      MemVirtualFree( ring->mem );
+      MemHeapFree( ring );
+    }
+  }
   ProfZero();
 }
 
+// first scope on this thread; make its ring and register it, so readers can find it.
+NoInl prof_ring_t*
+_ProfRingAttach()
+{
+  if( g_prof_ring_failed ) {
+    return 0;
+  }
+  auto idx = GetValueBeforeAtomicInc( &g_prof_nrings );
+  if( idx >= PROF_MAX_THREADS ) {
+    g_prof_ring_failed = 1;
+    return 0;
+  }
+  auto ring = MemHeapAlloc( prof_ring_t, 1 );
+  ring->mem = MemVirtualAlloc( prof_elem_t, PROF_RING_LEN );
+  AssertCrash( ring->mem );
+  ring->pos = 0;
+  ring->pos_reset = 0;
+  ring->name = g_thread_name;
+  ring->tid = GetThreadIdFast();
+#if PROF_DEPTHCOUNT
+  ring->depth = MAX_u32;
+#else
+#endif
+  StoreRelease( g_prof_rings + idx, ring );
+  g_prof_ring = ring;
+  return ring;
+}
+
+ForceInl prof_ring_t*
+_ProfRing()
+{
+  auto ring = g_prof_ring;
+  if( ring ) {
+    return ring;
+  }
+  return _ProfRingAttach();
+}
 
+// reserves the next record; the caller fills it in, and then calls _ProfPublish.
+ForceInl prof_elem_t*
+_ProfNext( prof_ring_t* ring )
+{
+  return ring->mem + ( ring->pos & ( PROF_RING_LEN - 1 ) );
+}
 
+ForceInl void
+_ProfPublish( prof_ring_t* ring )
+{
+  StoreRelease( &ring->pos, ring->pos + 1 );
+}
 
 #if PROF_SPLITSCOPES
 
-  #define AddScopeStart( _id ) \
-    do { \
-      if( g_prof_pos < g_prof_buffer_len ) { /* avoids overflow, as long as g_prof_buffer_len isn't close to the bounds. */ \
-        idx_t pos = GetValueBeforeAtomicInc( &g_prof_pos ); \
-        if( pos < g_prof_buffer_len ) { \
-          auto elem = Cast( prof_elem_t*, g_prof_buffer + pos ); \
-          elem->time = TimeTSC(); \
-          elem->tid = GetThreadIdFast(); \
-          elem->id = _id; \
-          elem->start = 1; \
-        } \
-      } \
-    } while( 0 )
-
-  #define AddScopeEnd( _id ) \
-    do { \
-      if( g_prof_pos < g_prof_buffer_len ) { /* avoids overflow, as long as g_prof_buffer_len isn't close to the bounds. */ \
-        idx_t pos = GetValueBeforeAtomicInc( &g_prof_pos ); \
-        if( pos < g_prof_buffer_len ) { \
-          auto elem = Cast( prof_elem_t*, g_prof_buffer + pos ); \
-          elem->time = TimeTSC(); \
-          elem->tid = GetThreadIdFast(); \
-          elem->id = _id; \
-          elem->start = 0; \
-        } \
-      } \
-    } while( 0 )
+  ForceInl void
+  _ProfAddScope( prof_ring_t* ring, u32 id, bool start )
+  {
+    auto elem = _ProfNext( ring );
+    elem->time = TimeTSC();
+    elem->id = id;
+    elem->start = start;
+  #if PROF_DEPTHCOUNT
+    elem->depth = ring->depth;
+  #else
+  #endif
+    _ProfPublish( ring );
+  }
 
 #else
 
+  ForceInl void
+  _ProfAddRecord( prof_ring_t* ring, u64 time_start, u32 id )
+  {
+    auto elem = _ProfNext( ring );
+    elem->time_start = time_start;
+    elem->time_end = TimeTSC();
+    elem->id = id;
   #if PROF_DEPTHCOUNT
-    #define AddProfRecord( time_start, id ) \
-      do { \
-        if( g_prof_pos < g_prof_buffer_len ) { /* avoids overflow, as long as g_prof_buffer_len isn't close to the bounds. */ \
-          idx_t pos = GetValueBeforeAtomicInc( &g_prof_pos ); \
-          if( pos < g_prof_buffer_len ) { \
-            auto elem = Cast( prof_elem_t*, g_prof_buffer + pos ); \
-            elem->time_start = time_start; \
-            elem->time_end = TimeTSC(); \
-            elem->tid = GetThreadIdFast(); \
-            elem->id = id; \
-            elem->depth = g_depthcount--; \
-          } \
-        } \
-      } while( 0 )
-
+    elem->depth = ring->depth;
   #else
-    #define AddProfRecord( time_start, id ) \
-      do { \
-        if( g_prof_pos < g_prof_buffer_len ) { /* avoids overflow, as long as g_prof_buffer_len isn't close to the bounds. */ \
-          idx_t pos = GetValueBeforeAtomicInc( &g_prof_pos ); \
-          if( pos < g_prof_buffer_len ) { \
-            auto elem = Cast( prof_elem_t*, g_prof_buffer + pos ); \
-            elem->time_start = time_start; \
-            elem->time_end = TimeTSC(); \
-            elem->tid = GetThreadIdFast(); \
-            elem->id = id; \
-          } \
-        } \
-      } while( 0 )
   #endif
+    _ProfPublish( ring );
+  }
 
 #endif
 
 // TODO: try unpacking this, so we macro define a bunch of local vars instead.
 //   not sure i trust the toolchains to unpack this.
-// TODO: make a different version for ProfClose, so we don't need a runtime !closed check.
+// TODO: make a different version for ProfClose, so we don't need a runtime !ring check.
 struct
 prof_zone_t
 {
+  prof_ring_t* ring; // 0 when closed, or when profiling was disabled at scope-open.
   u64 time_start;
   u32 id;
-  bool closed;
 
   ForceInl
   prof_zone_t(
@@ -293,8 +302,8 @@ prof_zone_t
     bool* location_logged
     )
   {
+    ring = 0;
     if( !g_prof_enabled ) {
-      closed = 1;
       return;
     }
 
@@ -306,48 +315,48 @@ prof_zone_t
       loc->line = lineno;
     }
 
+    ring = _ProfRing();
+    if( !ring ) {
+      return;
+    }
     id = zoneid;
-    closed = 0;
 
 #if PROF_DEPTHCOUNT
-    g_depthcount += 1;
+    ring->depth += 1;
 #else
 #endif
 
 #if PROF_SPLITSCOPES
-    AddScopeStart( id );
+    _ProfAddScope( ring, id, 1 );
 #else
     time_start = TimeTSC();
 #endif
   }
 
-  ForceInl
-  ~prof_zone_t()
+  ForceInl void
+  Close()
   {
-    if( closed ) {
+    if( !ring ) {
       return;
     }
 
 #if PROF_SPLITSCOPES
-    AddScopeEnd( id );
+    _ProfAddScope( ring, id, 0 );
 #else
-    AddProfRecord( time_start, id );
+    _ProfAddRecord( ring, time_start, id );
 #endif
-  }
 
-  ForceInl void
-  Close()
-  {
-    if( closed ) {
-      return;
-    }
-
-#if PROF_SPLITSCOPES
-    AddScopeEnd( id );
+#if PROF_DEPTHCOUNT
+    ring->depth -= 1;
 #else
-    AddProfRecord( time_start, id );
 #endif
-    closed = 1;
+    ring = 0;
+  }
+
+  ForceInl
+  ~prof_zone_t()
+  {
+    Close();
   }
 };
 
@@ -376,18 +385,84 @@ prof_zone_t
 
 
 
+// copies out the records the ring currently holds, appending to dst.
+// safe to call from any thread while the owner keeps writing; we just lose whatever it laps during the copy.
+Inl void
+ProfCopyRecords( prof_ring_t* ring, stack_resizeable_cont_t<prof_elem_t>& dst )
+{
+  auto pos = LoadAcquire( &ring->pos );
+  auto start = ring->pos_reset;
+  if( pos > PROF_RING_LEN ) {
+    start = MAX( start, pos - PROF_RING_LEN );
+  }
+  if( start >= pos ) {
+    return;
+  }
+  auto dst_start = dst.len;
+  auto nrecords = pos - start;
+  auto mem = AddBack( dst, nrecords );
+  auto idx_start = start & ( PROF_RING_LEN - 1 );
+  auto nfirst = MIN( nrecords, PROF_RING_LEN - idx_start );
+  Memmove( mem, ring->mem + idx_start, nfirst * sizeof( prof_elem_t ) );
+  Memmove( mem + nfirst, ring->mem, ( nrecords - nfirst ) * sizeof( prof_elem_t ) );
+
+  // record i shares its slot with record i + PROF_RING_LEN, and the writer may be partway into record
+  // pos_after without having published it yet. so anything at or below pos_after - PROF_RING_LEN is suspect.
+  // that means a full ring always reads back PROF_RING_LEN - 1 records.
+  _ReadWriteBarrier();
+  auto pos_after = LoadAcquire( &ring->pos );
+  if( pos_after + 1 > start + PROF_RING_LEN ) {
+    auto ndrop = MIN( nrecords, pos_after + 1 - ( start + PROF_RING_LEN ) );
+    Memmove( mem, mem + ndrop, ( nrecords - ndrop ) * sizeof( prof_elem_t ) );
+    dst.len = dst_start + nrecords - ndrop;
+  }
+}
+
+struct
+prof_thread_t
+{
+  u32 tid;
+  idx_t elems_start; // index into the elems array of ProfSnapshot.
+  idx_t elems_len;
+};
+
+// copies every thread's records into elems, one contiguous run per thread, in the order each thread logged them.
+Inl void
+ProfSnapshot(
+  stack_resizeable_cont_t<prof_elem_t>& elems,
+  stack_resizeable_cont_t<prof_thread_t>& threads
+  )
+{
+  auto nrings = MIN( g_prof_nrings, PROF_MAX_THREADS );
+  For( i, 0, nrings ) {
+    auto ring = LoadAcquire( g_prof_rings + i );
+    if( !ring ) {
+      continue;
+    }
+    auto elems_start = elems.len;
+    ProfCopyRecords( ring, elems );
+    if( elems.len == elems_start ) {
+      continue;
+    }
+    auto thread = AddBack( threads );
+    thread->tid = ring->tid;
+    thread->elems_start = elems_start;
+    thread->elems_len = elems.len - elems_start;
+  }
+}
 
 
 
 
-// TODO: output raw prof_elem_t records to a separate CSV file, not the logger .log file.
-// TODO: it might also make sense to just add a plot output function.
-//   e.g. ProfDrawThreadTimelines( stack_resizeable_cont_t<u8>& stream, ... )
+// note this goes through the logger; for anything big, use ProfOutputChromeTrace instead.
 void
 ProfOutputTimeline()
 {
-  // since we disable profiling by messing with g_prof_pos, we have to reset it here for things to function.
-  ProfEnable();
+  stack_resizeable_cont_t<prof_elem_t> elems;
+  Alloc( elems, 65536 );
+  stack_resizeable_cont_t<prof_thread_t> threads;
+  Alloc( threads, 16 );
+  ProfSnapshot( elems, threads );
 
   // log calls are file writes, so chunk stuff together to minimize the overhead.
   // est. size per row is probably 100bytes, so we chunk ~100,000 rows at a time.
@@ -407,43 +482,46 @@ ProfOutputTimeline()
 #endif
 
 
-  idx_t nelems = MIN( g_prof_pos, g_prof_buffer_len );
-  For( i, 0, nelems ) {
-    auto elem = *Cast( prof_elem_t*, g_prof_buffer + i );
-
-    auto loc = *Cast( prof_loc_t*, g_prof_locations + elem.id );
-
-    AddBackUInt( &stage, elem.id );
-    *AddBack( stage ) = ',';
-    AddBackUInt( &stage, elem.tid );
-    *AddBack( stage ) = ',';
-    auto file = _StandardFilename( loc.file, CstrLength( loc.file ) );
-    auto filename = FileNameAndExt( ML( file ) );
-    AddBackContents( &stage, filename );
-    *AddBack( stage ) = ',';
-    AddBackUInt( &stage, loc.line );
-    *AddBack( stage ) = ',';
-    AddBackCStr( &stage, loc.name );
-    *AddBack( stage ) = ',';
-#if PROF_SPLITSCOPES
-    AddBackUInt( &stage, elem.start );
-    *AddBack( stage ) = ',';
-    AddBackUInt( &stage, elem.time );
-#else
-  #if PROF_DEPTHCOUNT
-    AddBackUInt( &stage, elem.depth );
-    *AddBack( stage ) = ',';
+  idx_t nrows = 0;
+  FORLEN( thread, t, threads )
+    For( i, thread->elems_start, thread->elems_start + thread->elems_len ) {
+      auto elem = elems.mem[i];
+
+      auto loc = *Cast( prof_loc_t*, g_prof_locations + elem.id );
+
+      AddBackUInt( &stage, elem.id );
+      *AddBack( stage ) = ',';
+      AddBackUInt( &stage, thread->tid );
+      *AddBack( stage ) = ',';
+      auto file = _StandardFilename( loc.file, CstrLength( loc.file ) );
+      auto filename = FileNameAndExt( ML( file ) );
+      AddBackContents( &stage, filename );
+      *AddBack( stage ) = ',';
+      AddBackUInt( &stage, loc.line );
+      *AddBack( stage ) = ',';
+      AddBackCStr( &stage, loc.name );
+      *AddBack( stage ) = ',';
+  #if PROF_SPLITSCOPES
+      AddBackUInt( &stage, elem.start );
+      *AddBack( stage ) = ',';
+      AddBackUInt( &stage, elem.time );
   #else
+    #if PROF_DEPTHCOUNT
+      AddBackUInt( &stage, elem.depth );
+      *AddBack( stage ) = ',';
+    #else
+    #endif
+      AddBackUInt( &stage, elem.time_start );
+      *AddBack( stage ) = ',';
+      AddBackUInt( &stage, elem.time_end - elem.time_start );
   #endif
-    AddBackUInt( &stage, elem.time_start );
-    *AddBack( stage ) = ',';
-    AddBackUInt( &stage, elem.time_end - elem.time_start );
-#endif
-    *AddBack( stage ) = '\n';
+      *AddBack( stage ) = '\n';
 
-    if( i != 0  &&  i % rows_per_chunk == 0 ) {
-      LogDirect( SliceFromArray( stage ) );
-      stage.len = 0;
+      nrows += 1;
+      if( nrows % rows_per_chunk == 0 ) {
+        LogDirect( SliceFromArray( stage ) );
+        stage.len = 0;
+      }
     }
   }
 
@@ -453,6 +531,8 @@ ProfOutputTimeline()
   }
 
   Free( stage );
+  Free( threads );
+  Free( elems );
 }
 
 
@@ -500,15 +580,16 @@ zoneid_t
 void
 ProfOutputZoneStats()
 {
-  // since we disable profiling by messing with g_prof_pos, we have to reset it here for things to function.
-  ProfEnable();
+  stack_resizeable_cont_t<prof_elem_t> elems;
+  Alloc( elems, 65536 );
+  stack_resizeable_cont_t<prof_thread_t> threads;
+  Alloc( threads, 16 );
+  ProfSnapshot( elems, threads );
 
   // TODO: hashset iteration so I don't have to keep an extra array in sync.
   stack_resizeable_cont_t<zoneid_t> set;
   Alloc( set, 256 );
 
-  auto nelems = MIN( g_prof_pos, g_prof_buffer_len );
-
   hashset_t map;
   Init(
     map,
@@ -527,89 +608,96 @@ ProfOutputZoneStats()
 #else
 #endif
 
-  For( i, 0, nelems ) {
-    auto elem = *Cast( prof_elem_t*, g_prof_buffer + i );
-    auto loc = *Cast( prof_loc_t*, g_prof_locations + elem.id );
-
-#if PROF_SPLITSCOPES
-    if( elem.start ) {
-      *AddBack( open_scopes ) = elem;
-      continue;
-    }
-
-    idx_t opened_idx = 0;
-    prof_elem_t* popen = 0;
-    REVERSEFORLEN( open_scope, j, open_scopes )
-      if( elem.id == open_scope->id  &&  elem.tid == open_scope->tid ) {
-        opened_idx = j;
-        popen = open_scope;
-        break;
-      }
-    }
-    if( !popen ) {
-      // TODO: should we need this early-out? somehow pushing a scope-end as the first elem?
-      continue;
-    }
-    auto open = *popen;
-    UnorderedRemAt( open_scopes, opened_idx );
-#else
-#endif
-
-    bool found;
-    prof_zonestats_t* rawstats;
-    zoneid_t zoneid = { elem.id, elem.tid };
-    LookupRaw( map, &zoneid, &found, Cast( void**, &rawstats ) );
-
-    // calculate the all-important value: time elapsed since start.
+  FORLEN( thread, t, threads )
 #if PROF_SPLITSCOPES
-    auto time_elapsed = TimeSecFromTSC64( elem.time - open.time );
+    // scopes nest within a thread, so open scopes don't carry over from one thread to the next.
+    open_scopes.len = 0;
 #else
-    auto time_elapsed = TimeSecFromTSC64( elem.time_end - elem.time_start );
 #endif
+    For( i, thread->elems_start, thread->elems_start + thread->elems_len ) {
+      auto elem = elems.mem[i];
+      auto loc = *Cast( prof_loc_t*, g_prof_locations + elem.id );
+
+  #if PROF_SPLITSCOPES
+      if( elem.start ) {
+        *AddBack( open_scopes ) = elem;
+        continue;
+      }
 
-    if( !found ) {
-      prof_zonestats_t newstats;
-      newstats.n_invocs = 1;
-      newstats.time_mean = time_elapsed;
-      newstats.time_total = time_elapsed;
-      newstats.time_total_err = 0;
-      newstats.time_variance = 0;
-      newstats.name = loc.name;
-      newstats.file = SliceFromCStr( loc.file );
-      newstats.line = loc.line;
-      newstats.tid = elem.tid;
-      newstats.id = elem.id;
-
-      bool already_there;
-      Add( map, &zoneid, &newstats, &already_there, 0, 0 );
-      AssertCrash( !already_there );
-
-      *AddBack( set ) = zoneid;
-    }
-    else {
-      auto stats = *rawstats;
-
-      // calculate incrementally the total time ( using kahan summation )
-      auto time_elapsed_cor = time_elapsed - stats.time_total_err; // TODO: convert to kahansum64_t
-      auto time_total = stats.time_total + time_elapsed_cor;
-      stats.time_total_err = ( time_total - stats.time_total ) - time_elapsed_cor;
-      stats.time_total = time_total;
-
-      // calculate incrementally the mean.
-      auto prev_n = stats.n_invocs;
-      auto rec_n = 1.0 / ( prev_n + 1 );
-      auto prev_mu = stats.time_mean;
-      auto prev_diff = time_elapsed - prev_mu;
-      auto mu = prev_mu + rec_n * prev_diff;
-      stats.time_mean = mu;
+      idx_t opened_idx = 0;
+      prof_elem_t* popen = 0;
+      REVERSEFORLEN( open_scope, j, open_scopes )
+        if( elem.id == open_scope->id ) {
+          opened_idx = j;
+          popen = open_scope;
+          break;
+        }
+      }
+      if( !popen ) {
+        // the scope-start got overwritten by ring wraparound, or dropped by ProfReset.
+        continue;
+      }
+      auto open = *popen;
+      UnorderedRemAt( open_scopes, opened_idx );
+  #else
+  #endif
 
-      // calculate incrementally the variance.
-      auto prev_sn = prev_n * stats.time_variance;
-      stats.time_variance = rec_n * ( prev_sn + prev_diff * ( time_elapsed - mu ) );
+      bool found;
+      prof_zonestats_t* rawstats;
+      zoneid_t zoneid = { elem.id, thread->tid };
+      LookupRaw( map, &zoneid, &found, Cast( void**, &rawstats ) );
 
-      stats.n_invocs += 1;
+      // calculate the all-important value: time elapsed since start.
+  #if PROF_SPLITSCOPES
+      auto time_elapsed = TimeSecFromTSC64( elem.time - open.time );
+  #else
+      auto time_elapsed = TimeSecFromTSC64( elem.time_end - elem.time_start );
+  #endif
 
-      *rawstats = stats;
+      if( !found ) {
+        prof_zonestats_t newstats;
+        newstats.n_invocs = 1;
+        newstats.time_mean = time_elapsed;
+        newstats.time_total = time_elapsed;
+        newstats.time_total_err = 0;
+        newstats.time_variance = 0;
+        newstats.name = loc.name;
+        newstats.file = SliceFromCStr( loc.file );
+        newstats.line = loc.line;
+        newstats.tid = thread->tid;
+        newstats.id = elem.id;
+
+        bool already_there;
+        Add( map, &zoneid, &newstats, &already_there, 0, 0 );
+        AssertCrash( !already_there );
+
+        *AddBack( set ) = zoneid;
+      }
+      else {
+        auto stats = *rawstats;
+
+        // calculate incrementally the total time ( using kahan summation )
+        auto time_elapsed_cor = time_elapsed - stats.time_total_err; // TODO: convert to kahansum64_t
+        auto time_total = stats.time_total + time_elapsed_cor;
+        stats.time_total_err = ( time_total - stats.time_total ) - time_elapsed_cor;
+        stats.time_total = time_total;
+
+        // calculate incrementally the mean.
+        auto prev_n = stats.n_invocs;
+        auto rec_n = 1.0 / ( prev_n + 1 );
+        auto prev_mu = stats.time_mean;
+        auto prev_diff = time_elapsed - prev_mu;
+        auto mu = prev_mu + rec_n * prev_diff;
+        stats.time_mean = mu;
+
+        // calculate incrementally the variance.
+        auto prev_sn = prev_n * stats.time_variance;
+        stats.time_variance = rec_n * ( prev_sn + prev_diff * ( time_elapsed - mu ) );
+
+        stats.n_invocs += 1;
+
+        *rawstats = stats;
+      }
     }
   }
 
@@ -633,6 +721,8 @@ ProfOutputZoneStats()
 
   Kill( map );
   Free( set );
+  Free( threads );
+  Free( elems );
 
   if( !zonestats.len ) {
     Free( zonestats );
@@ -718,5 +808,609 @@ ProfOutputZoneStats()
 
 
 
+// streaming exports to files. these copy out one thread's ring at a time, and push text through a fixed
+// size staging buffer, so memory stays bounded by PROF_RING_LEN no matter how much we export.
+
+#define PROF_EXPORT_STAGE   ( 4*1024*1024 )
+
+// any one write to the stage has to fit in this much; names longer than this get truncated.
+#define PROF_EXPORT_MAXWRITE   1024
+
+struct
+prof_export_t
+{
+  file_t file;
+  stack_resizeable_cont_t<u8> stage;
+  f64 ns_per_tsc;
+
+  // per-id names, formatted for the output on first use.
+  stack_resizeable_cont_t<u8> names;
+  u32* name_offsets; // MAX_u32 if we haven't formatted that id yet.
+  u32* name_lens;
+};
+
+Inl bool
+_ProfExportInit( prof_export_t& ex, u8* filename, idx_t filename_len )
+{
+  ex.file = FileOpen( filename, filename_len, fileopen_t::always, fileop_t::W, fileop_t::none );
+  if( !ex.file.loaded ) {
+    return 0;
+  }
+  FileSetEOF( ex.file, 0 );
+  Alloc( ex.stage, PROF_EXPORT_STAGE );
+  ex.ns_per_tsc = 1e9 * g_sec_per_tsc64;
+  Alloc( ex.names, 4096 );
+  ex.name_offsets = MemHeapAlloc( u32, PROF_MAX_LOCATIONS );
+  ex.name_lens = MemHeapAlloc( u32, PROF_MAX_LOCATIONS );
+  For( i, 0, PROF_MAX_LOCATIONS ) {
+    ex.name_offsets[i] = MAX_u32;
+  }
+  return 1;
+}
+
+Inl void
+_ProfExportFlush( prof_export_t& ex )
+{
+  if( ex.stage.len ) {
+    FileWriteAppend( ex.file, ML( ex.stage ) );
+    ex.stage.len = 0;
+  }
+}
+
+Inl void
+_ProfExportKill( prof_export_t& ex )
+{
+  _ProfExportFlush( ex );
+  FileSetEOF( ex.file );
+  FileFree( ex.file );
+  Free( ex.stage );
+  Free( ex.names );
+  MemHeapFree( ex.name_offsets );
+  MemHeapFree( ex.name_lens );
+}
+
+// returns where to write the next PROF_EXPORT_MAXWRITE bytes. the caller sets stage.len past what it wrote.
+ForceInl u8*
+_ProfExportDst( prof_export_t& ex )
+{
+  if( ex.stage.len + PROF_EXPORT_MAXWRITE > ex.stage.capacity ) {
+    _ProfExportFlush( ex );
+  }
+  return ex.stage.mem + ex.stage.len;
+}
+
+ForceInl void
+_ProfExportCommit( prof_export_t& ex, u8* dst )
+{
+  ex.stage.len = dst - ex.stage.mem;
+}
+
+template< idx_t N >
+ForceInl u8*
+_ProfWriteLiteral( u8* dst, const char (&literal)[N] )
+{
+  Memmove( dst, literal, N - 1 );
+  return dst + N - 1;
+}
+
+ForceInl u8*
+_ProfWrite( u8* dst, u8* src, idx_t src_len )
+{
+  Memmove( dst, src, src_len );
+  return dst + src_len;
+}
+
+// printf is far too slow for 100M records, so we do two digits at a time.
+ForceInl u8*
+_ProfWriteU64( u8* dst, u64 value )
+{
+  static const char c_digitpairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+  u8 tmp[20];
+  auto end = tmp + _countof( tmp );
+  auto write = end;
+  while( value >= 100 ) {
+    auto pair = 2 * ( value % 100 );
+    value /= 100;
+    write -= 2;
+    write[0] = c_digitpairs[pair];
+    write[1] = c_digitpairs[pair + 1];
+  }
+  if( value >= 10 ) {
+    write -= 2;
+    write[0] = c_digitpairs[2 * value];
+    write[1] = c_digitpairs[2 * value + 1];
+  }
+  else {
+    *--write = Cast( u8, '0' + value );
+  }
+  return _ProfWrite( dst, write, end - write );
+}
+
+// microseconds with 3 decimals, i.e. nanosecond precision, which is what trace viewers want for "ts".
+ForceInl u8*
+_ProfWriteMicros( u8* dst, u64 ns )
+{
+  dst = _ProfWriteU64( dst, ns / 1000 );
+  auto frac = ns % 1000;
+  dst[0] = '.';
+  dst[1] = Cast( u8, '0' + frac / 100 );
+  dst[2] = Cast( u8, '0' + ( frac / 10 ) % 10 );
+  dst[3] = Cast( u8, '0' + frac % 10 );
+  return dst + 4;
+}
+
+ForceInl u64
+_ProfExportNs( prof_export_t& ex, u64 time )
+{
+  // records from before ProfInit can't happen, but clamp rather than wrap if the tsc isn't synced across cores.
+  auto tsc = ( time > g_prof_time_init )  ?  time - g_prof_time_init  :  0;
+  return Cast( u64, tsc * ex.ns_per_tsc );
+}
+
+// json string contents, or a flame graph frame when !json.
+// collapsed stacks use ';' as the frame separator, so we swap those out.
+Inl slice_t
+_ProfExportName( prof_export_t& ex, u32 id, bool json )
+{
+  if( ex.name_offsets[id] == MAX_u32 ) {
+    auto loc = *Cast( prof_loc_t*, g_prof_locations + id );
+    auto name = loc.name  ?  SliceFromCStr( loc.name )  :  SliceFromCStr( "?" );
+    name.len = MIN( name.len, PROF_EXPORT_MAXWRITE / 4 );
+    auto offset = ex.names.len;
+    For( i, 0, name.len ) {
+      auto c = name.mem[i];
+      if( json ) {
+        if( c == '"'  ||  c == '\\' ) {
+          *AddBack( ex.names ) = '\\';
+        }
+        elif( c < 0x20 ) {
+          c = ' ';
+        }
+      }
+      elif( c == ';' ) {
+        c = ':';
+      }
+      *AddBack( ex.names ) = c;
+    }
+    ex.name_offsets[id] = Cast( u32, offset );
+    ex.name_lens[id] = Cast( u32, ex.names.len - offset );
+  }
+  slice_t r;
+  r.mem = ex.names.mem + ex.name_offsets[id];
+  r.len = ex.name_lens[id];
+  return r;
+}
+
+// writes the chrome trace-event json format, which chrome://tracing, perfetto and speedscope all open.
+// one "X" complete event per scope, or "B"/"E" pairs with PROF_SPLITSCOPES, plus thread name metadata.
+// viewers nest a thread's events by time; depth rides along in args, for filtering.
+bool
+ProfOutputChromeTrace( u8* filename, idx_t filename_len )
+{
+  prof_export_t ex;
+  if( !_ProfExportInit( ex, filename, filename_len ) ) {
+    return 0;
+  }
+
+  stack_resizeable_cont_t<prof_elem_t> elems;
+  Alloc( elems, 65536 );
+
+  auto dst = _ProfExportDst( ex );
+  dst = _ProfWriteLiteral( dst, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+  dst = _ProfWriteLiteral( dst, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"" );
+  auto exe = FsGetExe();
+  auto exe_name = FileNameAndExt( ML( exe ) );
+  dst = _ProfWrite( dst, exe_name.mem, MIN( exe_name.len, PROF_EXPORT_MAXWRITE / 4 ) );
+  dst = _ProfWriteLiteral( dst, "\"}}" );
+  _ProfExportCommit( ex, dst );
+
+  auto nrings = MIN( g_prof_nrings, PROF_MAX_THREADS );
+  For( r, 0, nrings ) {
+    auto ring = LoadAcquire( g_prof_rings + r );
+    if( !ring ) {
+      continue;
+    }
+    elems.len = 0;
+    ProfCopyRecords( ring, elems );
+    if( !elems.len ) {
+      continue;
+    }
+
+    // the prefix every event on this thread starts with.
+    stack_nonresizeable_stack_t<u8, 64> prefix;
+    prefix.len = _ProfWriteLiteral( prefix.mem, ",\n{\"pid\":1,\"tid\":" ) - prefix.mem;
+    prefix.len = _ProfWriteU64( prefix.mem + prefix.len, ring->tid ) - prefix.mem;
+
+    dst = _ProfExportDst( ex );
+    dst = _ProfWrite( dst, ML( prefix ) );
+    dst = _ProfWriteLiteral( dst, ",\"ph\":\"M\",\"name\":\"thread_name\",\"args\":{\"name\":\"" );
+    if( ring->name ) {
+      auto name = SliceFromCStr( ring->name );
+      dst = _ProfWrite( dst, name.mem, MIN( name.len, PROF_EXPORT_MAXWRITE / 4 ) );
+    }
+    else {
+      dst = _ProfWriteLiteral( dst, "Thread" );
+    }
+    dst = _ProfWriteLiteral( dst, "\"}}" );
+    dst = _ProfWrite( dst, ML( prefix ) );
+    dst = _ProfWriteLiteral( dst, ",\"ph\":\"M\",\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":" );
+    dst = _ProfWriteU64( dst, r );
+    dst = _ProfWriteLiteral( dst, "}}" );
+    _ProfExportCommit( ex, dst );
+
+#if PROF_SPLITSCOPES
+    // ring wraparound can drop the starts of the oldest scopes; skip ends we never saw a start for.
+    idx_t nopen = 0;
+#else
+#endif
+
+    FORLEN( elem, i, elems )
+#if PROF_SPLITSCOPES
+      if( !elem->start ) {
+        if( !nopen ) {
+          continue;
+        }
+        nopen -= 1;
+      }
+      else {
+        nopen += 1;
+      }
+#else
+#endif
+      auto name = _ProfExportName( ex, elem->id, 1 );
+      dst = _ProfExportDst( ex );
+      dst = _ProfWrite( dst, ML( prefix ) );
+#if PROF_SPLITSCOPES
+      dst = elem->start  ?
+        _ProfWriteLiteral( dst, ",\"ph\":\"B\",\"ts\":" )  :
+        _ProfWriteLiteral( dst, ",\"ph\":\"E\",\"ts\":" );
+      dst = _ProfWriteMicros( dst, _ProfExportNs( ex, elem->time ) );
+#else
+      auto ns_start = _ProfExportNs( ex, elem->time_start );
+      auto ns_end = _ProfExportNs( ex, elem->time_end );
+      dst = _ProfWriteLiteral( dst, ",\"ph\":\"X\",\"ts\":" );
+      dst = _ProfWriteMicros( dst, ns_start );
+      dst = _ProfWriteLiteral( dst, ",\"dur\":" );
+      dst = _ProfWriteMicros( dst, ns_end - ns_start );
+#endif
+      dst = _ProfWriteLiteral( dst, ",\"name\":\"" );
+      dst = _ProfWrite( dst, ML( name ) );
+#if PROF_DEPTHCOUNT
+      dst = _ProfWriteLiteral( dst, "\",\"args\":{\"depth\":" );
+      dst = _ProfWriteU64( dst, elem->depth );
+      dst = _ProfWriteLiteral( dst, "}}" );
+#else
+      dst = _ProfWriteLiteral( dst, "\"}" );
+#endif
+      _ProfExportCommit( ex, dst );
+    }
+  }
+
+  dst = _ProfExportDst( ex );
+  dst = _ProfWriteLiteral( dst, "\n]}\n" );
+  _ProfExportCommit( ex, dst );
+
+  Free( elems );
+  _ProfExportKill( ex );
+  return 1;
+}
+
+
+
+// flame graph aggregation: every distinct call path gets a node in a tree keyed by { parent, id },
+// shared across threads, and each node accumulates its self time, i.e. duration minus its children's.
+// the output is the collapsed-stack format that flamegraph.pl, speedscope and inferno read:
+//   "outer;middle;inner 1234\n", where the count is self time in nanoseconds.
+
+#define PROF_FLAME_UNKNOWN   MAX_u32 // stands in for parents we don't have records for.
+
+struct
+prof_flamenode_t
+{
+  u32 parent;
+  u32 id;
+  s64 self; // tsc. transiently negative while we're still subtracting children.
+};
+
+struct
+prof_flame_t
+{
+  stack_resizeable_cont_t<prof_flamenode_t> nodes; // nodes.mem[0] is the root.
+  hashset_t map; // { parent, id } -> node index.
+};
+
+Inl void
+Init( prof_flame_t& flame )
+{
+  Alloc( flame.nodes, 1024 );
+  auto root = AddBack( flame.nodes );
+  root->parent = 0;
+  root->id = PROF_FLAME_UNKNOWN;
+  root->self = 0;
+  Init(
+    flame.map,
+    1024,
+    sizeof( u64 ),
+    sizeof( u32 ),
+    0.75f,
+    Equal_FirstU64,
+    Hash_FirstU64
+    );
+}
+
+Inl void
+Kill( prof_flame_t& flame )
+{
+  Kill( flame.map );
+  Free( flame.nodes );
+}
+
+Inl u32
+_ProfFlameChild( prof_flame_t& flame, u32 parent, u32 id )
+{
+  u64 key = ( Cast( u64, parent ) << 32 ) | id;
+  bool found;
+  u32 node;
+  Lookup( flame.map, &key, &found, &node );
+  if( found ) {
+    return node;
+  }
+  node = Cast( u32, flame.nodes.len );
+  auto newnode = AddBack( flame.nodes );
+  newnode->parent = parent;
+  newnode->id = id;
+  newnode->self = 0;
+  bool already_there;
+  Add( flame.map, &key, &node, &already_there, 0, 0 );
+  return node;
+}
+
+// non-split records are logged at scope-end, so children come before their parent.
+// walking backwards, parents come first, and the most recent record at depth d-1 is the parent of a record
+// at depth d: nothing else at depth d-1 can close between the child and its parent.
+Inl void
+_ProfFlameAddThread( prof_flame_t& flame, tslice_t<prof_elem_t> elems, stack_resizeable_cont_t<u32>& path )
+{
+  path.len = 0;
+
+#if PROF_SPLITSCOPES
+  stack_resizeable_cont_t<u64> path_times;
+  Alloc( path_times, 64 );
+
+  FORLEN( elem, i, elems )
+    if( elem->start ) {
+      auto parent = path.len  ?  path.mem[path.len - 1]  :  0;
+      *AddBack( path ) = _ProfFlameChild( flame, parent, elem->id );
+      *AddBack( path_times ) = elem->time;
+      continue;
+    }
+    // skip ends whose start got dropped by ring wraparound.
+    if( !path.len  ||  flame.nodes.mem[ path.mem[path.len - 1] ].id != elem->id ) {
+      continue;
+    }
+    auto node = path.mem[path.len - 1];
+    auto dur = Cast( s64, elem->time - path_times.mem[path.len - 1] );
+    RemBack( path );
+    RemBack( path_times );
+    flame.nodes.mem[node].self += dur;
+    if( path.len ) {
+      flame.nodes.mem[ path.mem[path.len - 1] ].self -= dur;
+    }
+  }
+
+  // scopes that haven't closed yet get the last time we saw as a pseudo-close, like the live views do.
+  // otherwise their children's time would come out of them, with nothing to balance it.
+  if( elems.len ) {
+    auto time_last = elems.mem[elems.len - 1].time;
+    REVERSEFORLEN( node, j, path )
+      auto dur = Cast( s64, time_last - path_times.mem[j] );
+      flame.nodes.mem[*node].self += dur;
+      if( j ) {
+        flame.nodes.mem[ path.mem[j - 1] ].self -= dur;
+      }
+    }
+  }
+
+  Free( path_times );
+#else
+  REVERSEFORLEN( elem, i, elems )
+  #if PROF_DEPTHCOUNT
+    idx_t depth = elem->depth;
+  #else
+    idx_t depth = 0;
+  #endif
+    // deeper than what we've walked; the parents are still open, or got dropped by ProfReset.
+    while( path.len < depth ) {
+      auto parent = path.len  ?  path.mem[path.len - 1]  :  0;
+      *AddBack( path ) = _ProfFlameChild( flame, parent, PROF_FLAME_UNKNOWN );
+    }
+    path.len = depth;
+    auto parent = path.len  ?  path.mem[path.len - 1]  :  0;
+    auto node = _ProfFlameChild( flame, parent, elem->id );
+    *AddBack( path ) = node;
+
+    auto dur = Cast( s64, elem->time_end - elem->time_start );
+    flame.nodes.mem[node].self += dur;
+    if( parent  &&  flame.nodes.mem[parent].id != PROF_FLAME_UNKNOWN ) {
+      flame.nodes.mem[parent].self -= dur;
+    }
+  }
+#endif
+}
+
+bool
+ProfOutputFlameGraph( u8* filename, idx_t filename_len )
+{
+  prof_export_t ex;
+  if( !_ProfExportInit( ex, filename, filename_len ) ) {
+    return 0;
+  }
+
+  prof_flame_t flame;
+  Init( flame );
+
+  stack_resizeable_cont_t<prof_elem_t> elems;
+  Alloc( elems, 65536 );
+  stack_resizeable_cont_t<u32> path;
+  Alloc( path, 64 );
+
+  auto nrings = MIN( g_prof_nrings, PROF_MAX_THREADS );
+  For( r, 0, nrings ) {
+    auto ring = LoadAcquire( g_prof_rings + r );
+    if( !ring ) {
+      continue;
+    }
+    elems.len = 0;
+    ProfCopyRecords( ring, elems );
+    _ProfFlameAddThread( flame, SliceFromArray( elems ), path );
+  }
+
+  For( n, 1, flame.nodes.len ) {
+    auto node = flame.nodes.mem[n];
+    if( node.self <= 0 ) {
+      continue;
+    }
+    path.len = 0;
+    for( u32 p = Cast( u32, n );  p;  p = flame.nodes.mem[p].parent ) {
+      *AddBack( path ) = flame.nodes.mem[p].id;
+    }
+    // each frame is at most PROF_EXPORT_MAXWRITE / 4 bytes, so flush per frame to stay in bounds.
+    REVERSEFORLEN( id, i, path )
+      auto dst = _ProfExportDst( ex );
+      if( *id == PROF_FLAME_UNKNOWN ) {
+        dst = _ProfWriteLiteral( dst, "?" );
+      }
+      else {
+        auto name = _ProfExportName( ex, *id, 0 );
+        dst = _ProfWrite( dst, ML( name ) );
+      }
+      *dst++ = i  ?  ';'  :  ' ';
+      _ProfExportCommit( ex, dst );
+    }
+    auto dst = _ProfExportDst( ex );
+    dst = _ProfWriteU64( dst, Cast( u64, node.self * ex.ns_per_tsc ) );
+    *dst++ = '\n';
+    _ProfExportCommit( ex, dst );
+  }
+
+  Free( path );
+  Free( elems );
+  Kill( flame );
+  _ProfExportKill( ex );
+  return 1;
+}
+
+#if PROF_SPLITSCOPES  ||  PROF_DEPTHCOUNT
+RegisterTest([]()
+{
+  // one synthetic thread:
+  //   outer [0,100] contains middle [10,60], which contains two inners [20,30] and [40,50].
+  //   then another outer [200,210], and an inner [220,225] whose parent hasn't closed yet.
+  constant u32 outer = 1;
+  constant u32 middle = 2;
+  constant u32 inner = 3;
+  prof_flame_t flame;
+  Init( flame );
+  stack_resizeable_cont_t<u32> path;
+  Alloc( path, 64 );
+  stack_resizeable_cont_t<prof_elem_t> elems;
+  Alloc( elems, 64 );
+  auto Record = [&]( u32 id, u64 t0, u64 t1, u32 depth )
+  {
+#if PROF_SPLITSCOPES
+    auto elem = AddBack( elems, 2 );
+    elem[0] = {};
+    elem[0].time = t0;
+    elem[0].id = id;
+    elem[0].start = 1;
+    elem[1] = elem[0];
+    elem[1].time = t1;
+    elem[1].start = 0;
+#else
+    auto elem = AddBack( elems );
+    *elem = {};
+    elem->time_start = t0;
+    elem->time_end = t1;
+    elem->id = id;
+  #if PROF_DEPTHCOUNT
+    elem->depth = depth;
+  #else
+  #endif
+#endif
+  };
+#if PROF_SPLITSCOPES
+  // split records are in time order, so we log starts and ends as they happen.
+  auto Start = [&]( u32 id, u64 t )
+  {
+    auto elem = AddBack( elems );
+    *elem = {};
+    elem->time = t;
+    elem->id = id;
+    elem->start = 1;
+  };
+  auto End = [&]( u32 id, u64 t )
+  {
+    auto elem = AddBack( elems );
+    *elem = {};
+    elem->time = t;
+    elem->id = id;
+    elem->start = 0;
+  };
+  Start( outer, 0 );
+  Start( middle, 10 );
+  Record( inner, 20, 30, 2 );
+  Record( inner, 40, 50, 2 );
+  End( middle, 60 );
+  End( outer, 100 );
+  Record( outer, 200, 210, 0 );
+  Start( outer, 215 );
+  Record( inner, 220, 225, 1 );
+#else
+  // non-split records are in scope-end order.
+  Record( inner, 20, 30, 2 );
+  Record( inner, 40, 50, 2 );
+  Record( middle, 10, 60, 1 );
+  Record( outer, 0, 100, 0 );
+  Record( outer, 200, 210, 0 );
+  Record( inner, 220, 225, 1 );
+#endif
+  _ProfFlameAddThread( flame, SliceFromArray( elems ), path );
+
+  auto Self = [&]( u32 parent, u32 id, u32* node )
+  {
+    u64 key = ( Cast( u64, parent ) << 32 ) | id;
+    bool found;
+    Lookup( flame.map, &key, &found, node );
+    AssertCrash( found );
+    return flame.nodes.mem[*node].self;
+  };
+  u32 n_outer, n_middle, n_inner, n_open, n_orphan;
+  auto self_outer = Self( 0, outer, &n_outer );
+  AssertCrash( Self( n_outer, middle, &n_middle ) == 30 );
+  AssertCrash( Self( n_middle, inner, &n_inner ) == 20 );
+#if PROF_SPLITSCOPES
+  // the open outer is pseudo-closed at 225, so it adds 225 - 215 - 5 of self time to the outer path.
+  AssertCrash( self_outer == 65 );
+  AssertCrash( Self( n_outer, inner, &n_orphan ) == 5 );
+#else
+  AssertCrash( self_outer == 60 );
+  Self( 0, PROF_FLAME_UNKNOWN, &n_open );
+  AssertCrash( Self( n_open, inner, &n_orphan ) == 5 );
+#endif
+
+  Free( elems );
+  Free( path );
+  Kill( flame );
+});
+#endif
+
+
+
+
+
+
 
 #endif // PROF_ENABLED
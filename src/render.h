@@ -6,6 +6,7 @@ Enumc( rendermode_t )
   opt,
   simd,
   ray,
+  ray_packet,
 };
 
 
@@ -2244,10 +2245,477 @@ TraceCone(
 
 
 
+// ============================================================================
+// BOUNDING VOLUME HIERARCHY
+//
+// One BVH over every primitive of every rtmesh_t in the scene, built in world space with binned SAH.
+// The nodes are flattened depth-first into one contiguous array:
+//   interior node: the left child is the very next node, and 'first' is the idx of the right child.
+//   leaf node: 'first' is the idx of the first primref, and 'count' is the # of primrefs.
+// Primitive intersection still happens in model space with the Trace* fns above; we only use the
+// world space boxes to cull. Since the mesh transforms are rigid + uniform scale, t_world is
+// consistent across all meshes, so closest.t_world works as the traversal cutoff.
+//
+
+#define c_bvh_num_bins   ( 16 )
+#define c_bvh_max_leaf   ( 4 )
+#define c_bvh_max_depth  ( 60 )
+#define c_bvh_cost_traversal   ( 1.0f )
+#define c_bvh_cost_intersect   ( 1.0f )
+#define c_bvh_aabb_pad   ( 1e-4f )
+
+struct
+rtaabb_t
+{
+  vec3<f32> p0;
+  vec3<f32> p1;
+};
+
+Inl void
+Init( rtaabb_t& aabb )
+{
+  aabb.p0 = _vec3( MAX_f32 );
+  aabb.p1 = _vec3( MIN_f32 );
+}
+
+Inl void
+Grow( rtaabb_t& aabb, vec3<f32> p )
+{
+  aabb.p0 = Min( aabb.p0, p );
+  aabb.p1 = Max( aabb.p1, p );
+}
+
+Inl void
+Grow( rtaabb_t& aabb, rtaabb_t& src )
+{
+  aabb.p0 = Min( aabb.p0, src.p0 );
+  aabb.p1 = Max( aabb.p1, src.p1 );
+}
+
+Inl f32
+SurfaceArea( rtaabb_t& aabb )
+{
+  auto d = aabb.p1 - aabb.p0;
+  if( ( d.x < 0 )  |  ( d.y < 0 )  |  ( d.z < 0 ) ) {
+    return 0;
+  }
+  auto r = 2 * ( d.x * d.y + d.y * d.z + d.z * d.x );
+  return r;
+}
+
+Inl vec3<f32>
+Center( rtaabb_t& aabb )
+{
+  auto r = 0.5f * ( aabb.p0 + aabb.p1 );
+  return r;
+}
+
+// Slab test. Returns the entry distance in t_enter, for near-first child ordering.
+ForceInl bool
+IntersectAabb(
+  rtaabb_t& aabb,
+  vec3<f32>& ray_p,
+  vec3<f32>& rec_ray_d,
+  f32 t_min,
+  f32 t_max,
+  f32* t_enter
+  )
+{
+  auto t0 = ( aabb.p0 - ray_p ) * rec_ray_d;
+  auto t1 = ( aabb.p1 - ray_p ) * rec_ray_d;
+  auto tnear = MaxElem( Min( t0, t1 ) );
+  auto tfar = MinElem( Max( t0, t1 ) );
+  tnear = MAX( tnear, t_min );
+  tfar = MIN( tfar, t_max );
+  *t_enter = tnear;
+  bool r = ( tnear <= tfar );
+  return r;
+}
+
+
+struct
+rtprimref_t
+{
+  u32 mesh_idx;
+  u32 primitive_idx;
+  primitive_type_t primitive_type;
+};
+
+struct
+rtbvhnode_t
+{
+  rtaabb_t aabb;
+  u32 first;
+  u32 count;
+};
+CompileAssert( sizeof( rtbvhnode_t ) == 32 );
+
+struct
+rtscene_t
+{
+  rtmesh_t** meshes;
+  idx_t meshes_len;
+  stack_resizeable_cont_t<rtbvhnode_t> nodes;
+  stack_resizeable_cont_t<rtprimref_t> primrefs;
+  u32 depth;
+};
+
+Inl void
+AabbWorldFromModelPoints( rtaabb_t& aabb, rtmesh_t& mesh, vec3<f32>* ps, idx_t ps_len )
+{
+  Init( aabb );
+  For( i, 0, ps_len ) {
+    Grow( aabb, WorldFromModelP( mesh, ps[i] ) );
+  }
+}
+
+// Conservative world space bounds of a ball of radius_model around each of the given points.
+Inl void
+AabbWorldFromModelBalls( rtaabb_t& aabb, rtmesh_t& mesh, vec3<f32>* ps, idx_t ps_len, f32 radius_model )
+{
+  AabbWorldFromModelPoints( aabb, mesh, ps, ps_len );
+  auto r = _vec3( WorldFromModelDist( mesh, radius_model ) );
+  aabb.p0 -= r;
+  aabb.p1 += r;
+}
+
+Inl rtaabb_t
+AabbWorld( rtmesh_t& mesh, rtprimref_t& ref )
+{
+  rtaabb_t aabb;
+  auto idx = ref.primitive_idx;
+  switch( ref.primitive_type ) {
+    case primitive_tritex: {
+      auto& tri = mesh.tris_tex.mem[idx];
+      vec3<f32> ps[] = { tri.p, tri.p + tri.e0, tri.p + tri.e1 };
+      AabbWorldFromModelPoints( aabb, mesh, AL( ps ) );
+    } break;
+    case primitive_tri: {
+      auto& tri = mesh.tris.mem[idx];
+      vec3<f32> ps[] = { tri.p, tri.p + tri.e0, tri.p + tri.e1 };
+      AabbWorldFromModelPoints( aabb, mesh, AL( ps ) );
+    } break;
+    case primitive_parallelotex: {
+      auto& parallelo = mesh.parallelos_tex.mem[idx];
+      vec3<f32> ps[] = { parallelo.p, parallelo.p + parallelo.e0, parallelo.p + parallelo.e1, parallelo.p + parallelo.e0 + parallelo.e1 };
+      AabbWorldFromModelPoints( aabb, mesh, AL( ps ) );
+    } break;
+    case primitive_parallelo: {
+      auto& parallelo = mesh.parallelos.mem[idx];
+      vec3<f32> ps[] = { parallelo.p, parallelo.p + parallelo.e0, parallelo.p + parallelo.e1, parallelo.p + parallelo.e0 + parallelo.e1 };
+      AabbWorldFromModelPoints( aabb, mesh, AL( ps ) );
+    } break;
+    case primitive_sphere: {
+      auto& sphere = mesh.spheres.mem[idx];
+      AabbWorldFromModelBalls( aabb, mesh, &sphere.p, 1, sphere.radius );
+    } break;
+    case primitive_disc: {
+      auto& disc = mesh.discs.mem[idx];
+      AabbWorldFromModelBalls( aabb, mesh, &disc.p, 1, disc.radius );
+    } break;
+    case primitive_cylinder: {
+      auto& cylinder = mesh.cylinders.mem[idx];
+      vec3<f32> ps[] = { cylinder.p, cylinder.p + cylinder.height * cylinder.n };
+      AabbWorldFromModelBalls( aabb, mesh, AL( ps ), cylinder.radius );
+    } break;
+    case primitive_cone: {
+      // TraceCone accepts heights in [ extent_neg, extent_pos ] along -n, with radius r * |height|.
+      auto& cone = mesh.cones.mem[idx];
+      vec3<f32> ps[] = { cone.p - cone.extent_neg * cone.n, cone.p - cone.extent_pos * cone.n };
+      auto radius = cone.r * MAX( ABS( cone.extent_neg ), ABS( cone.extent_pos ) );
+      AabbWorldFromModelBalls( aabb, mesh, AL( ps ), radius );
+    } break;
+    default: UnreachableCrash();
+  }
+  // The Trace* fns accept hits slightly outside the primitive ( uv_epsilon, cos_epsilon ), so pad
+  // the box to match; otherwise grazing rays near edges can disagree with brute force.
+  auto pad = _vec3( c_bvh_aabb_pad * MaxElem( aabb.p1 - aabb.p0 ) );
+  aabb.p0 -= pad;
+  aabb.p1 += pad;
+  return aabb;
+}
+
+Inl void
+AddPrimrefs( stack_resizeable_cont_t<rtprimref_t>& primrefs, u32 mesh_idx, idx_t count, primitive_type_t primitive_type )
+{
+  AssertCrash( count <= MAX_u32 );
+  auto dst = AddBack( primrefs, count );
+  For( i, 0, count ) {
+    dst[i].mesh_idx = mesh_idx;
+    dst[i].primitive_idx = Cast( u32, i );
+    dst[i].primitive_type = primitive_type;
+  }
+}
+
+struct
+rtbvhbin_t
+{
+  rtaabb_t aabb;
+  u32 count;
+};
+
+struct
+rtbvhbuildrange_t
+{
+  u32 start;
+  u32 end;
+  u32 depth;
+  u32 parent; // MAX_u32 if this range doesn't need to patch its parent's right child idx.
+};
+
+// Partitions primrefs[start,end) by SAH, returning the split point, or end if a leaf is cheaper.
+Inl u32
+SplitSah(
+  rtprimref_t* primrefs,
+  rtaabb_t* aabbs,
+  vec3<f32>* centroids,
+  u32 start,
+  u32 end,
+  rtaabb_t& node_aabb
+  )
+{
+  auto count = end - start;
+
+  rtaabb_t centroid_aabb;
+  Init( centroid_aabb );
+  For( i, start, end ) {
+    Grow( centroid_aabb, centroids[i] );
+  }
+  auto extent = centroid_aabb.p1 - centroid_aabb.p0;
+
+  f32 best_cost = MAX_f32;
+  u32 best_axis = 0;
+  u32 best_bin = 0;
+  Fori( u32, axis, 0, 3 ) {
+    auto axis_min = ( &centroid_aabb.p0.x )[axis];
+    auto axis_extent = ( &extent.x )[axis];
+    if( axis_extent <= 0 ) {
+      continue;
+    }
+    auto bin_scale = c_bvh_num_bins * ( 1 - 1e-5f ) / axis_extent;
+
+    rtbvhbin_t bins[c_bvh_num_bins];
+    For( b, 0, c_bvh_num_bins ) {
+      Init( bins[b].aabb );
+      bins[b].count = 0;
+    }
+    For( i, start, end ) {
+      auto b = Cast( u32, ( ( &centroids[i].x )[axis] - axis_min ) * bin_scale );
+      b = MIN( b, c_bvh_num_bins - 1 );
+      Grow( bins[b].aabb, aabbs[i] );
+      bins[b].count += 1;
+    }
+
+    // Sweep from the right to get the suffix areas, then from the left to evaluate each split.
+    f32 area_r[c_bvh_num_bins];
+    u32 count_r[c_bvh_num_bins];
+    rtaabb_t acc;
+    Init( acc );
+    u32 acc_count = 0;
+    ReverseFori( u32, b, 1, c_bvh_num_bins ) {
+      Grow( acc, bins[b].aabb );
+      acc_count += bins[b].count;
+      area_r[b] = SurfaceArea( acc );
+      count_r[b] = acc_count;
+    }
+    Init( acc );
+    acc_count = 0;
+    Fori( u32, b, 0, c_bvh_num_bins - 1 ) {
+      Grow( acc, bins[b].aabb );
+      acc_count += bins[b].count;
+      if( !acc_count  ||  !count_r[b + 1] ) {
+        continue;
+      }
+      auto cost = SurfaceArea( acc ) * acc_count + area_r[b + 1] * count_r[b + 1];
+      if( cost < best_cost ) {
+        best_cost = cost;
+        best_axis = axis;
+        best_bin = b;
+      }
+    }
+  }
+
+  auto node_area = SurfaceArea( node_aabb );
+  auto rec_node_area = ( node_area > 0 )  ?  1 / node_area  :  0.0f;
+  auto split_cost = c_bvh_cost_traversal + c_bvh_cost_intersect * best_cost * rec_node_area;
+  auto leaf_cost = c_bvh_cost_intersect * count;
+
+  if( best_cost == MAX_f32 ) {
+    // All centroids coincide, so no plane separates them.
+    // Split by idx if we must, to keep the leaf size bounded.
+    if( count <= c_bvh_max_leaf ) {
+      return end;
+    }
+    return start + count / 2;
+  }
+  if( ( count <= c_bvh_max_leaf )  &&  ( leaf_cost <= split_cost ) ) {
+    return end;
+  }
+
+  auto axis_min = ( &centroid_aabb.p0.x )[best_axis];
+  auto bin_scale = c_bvh_num_bins * ( 1 - 1e-5f ) / ( &extent.x )[best_axis];
+  auto l = start;
+  auto r = end;
+  while( l < r ) {
+    auto b = Cast( u32, ( ( &centroids[l].x )[best_axis] - axis_min ) * bin_scale );
+    b = MIN( b, c_bvh_num_bins - 1 );
+    if( b <= best_bin ) {
+      l += 1;
+    } else {
+      r -= 1;
+      SWAP( rtprimref_t, primrefs[l], primrefs[r] );
+      SWAP( rtaabb_t, aabbs[l], aabbs[r] );
+      SWAP( vec3<f32>, centroids[l], centroids[r] );
+    }
+  }
+  AssertCrash( start < l  &&  l < end );
+  return l;
+}
+
+Inl void
+Init( rtscene_t& scene, rtmesh_t* meshes[], idx_t meshes_len )
+{
+  ProfFunc();
+
+  AssertCrash( meshes_len <= MAX_u32 );
+  scene.meshes = meshes;
+  scene.meshes_len = meshes_len;
+  scene.depth = 0;
+
+  idx_t num_primitives = 0;
+  For( m, 0, meshes_len ) {
+    auto& mesh = *meshes[m];
+    num_primitives +=
+      mesh.tris_tex.len + mesh.tris.len + mesh.parallelos_tex.len + mesh.parallelos.len +
+      mesh.spheres.len + mesh.discs.len + mesh.cylinders.len + mesh.cones.len;
+  }
+  AssertCrash( num_primitives < MAX_u32 );
+
+  Alloc( scene.primrefs, MAX( num_primitives, 1 ) );
+  Alloc( scene.nodes, MAX( 2 * num_primitives, 1 ) );
+  if( !num_primitives ) {
+    return;
+  }
+
+  For( m, 0, meshes_len ) {
+    auto& mesh = *meshes[m];
+    auto mesh_idx = Cast( u32, m );
+    AddPrimrefs( scene.primrefs, mesh_idx, mesh.tris_tex.len, primitive_tritex );
+    AddPrimrefs( scene.primrefs, mesh_idx, mesh.tris.len, primitive_tri );
+    AddPrimrefs( scene.primrefs, mesh_idx, mesh.parallelos_tex.len, primitive_parallelotex );
+    AddPrimrefs( scene.primrefs, mesh_idx, mesh.parallelos.len, primitive_parallelo );
+    AddPrimrefs( scene.primrefs, mesh_idx, mesh.spheres.len, primitive_sphere );
+    AddPrimrefs( scene.primrefs, mesh_idx, mesh.discs.len, primitive_disc );
+    AddPrimrefs( scene.primrefs, mesh_idx, mesh.cylinders.len, primitive_cylinder );
+    AddPrimrefs( scene.primrefs, mesh_idx, mesh.cones.len, primitive_cone );
+  }
+
+  // Build-time only; these get permuted along with primrefs.
+  auto aabbs = MemHeapAlloc( rtaabb_t, num_primitives );
+  auto centroids = MemHeapAlloc( vec3<f32>, num_primitives );
+  ForLen( i, scene.primrefs ) {
+    auto& ref = scene.primrefs.mem[i];
+    aabbs[i] = AabbWorld( *meshes[ref.mesh_idx], ref );
+    centroids[i] = Center( aabbs[i] );
+  }
+
+  // Explicit stack instead of recursion. We push the right range before the left one, so the
+  // left child is always allocated immediately after its parent. The right child patches the
+  // parent's 'first' once it's popped.
+  stack_resizeable_cont_t<rtbvhbuildrange_t> ranges;
+  Alloc( ranges, 2 * c_bvh_max_depth + 2 );
+  *AddBack( ranges ) = { 0, Cast( u32, num_primitives ), 0, MAX_u32 };
+
+  while( ranges.len ) {
+    auto range = ranges.mem[ranges.len - 1];
+    RemBack( ranges );
+
+    auto node_idx = Cast( u32, scene.nodes.len );
+    if( range.parent != MAX_u32 ) {
+      scene.nodes.mem[range.parent].first = node_idx;
+    }
+    auto node = AddBack( scene.nodes );
+    Init( node->aabb );
+    For( i, range.start, range.end ) {
+      Grow( node->aabb, aabbs[i] );
+    }
+    scene.depth = MAX( scene.depth, range.depth + 1 );
+
+    auto split = range.end;
+    if( range.depth + 1 < c_bvh_max_depth ) {
+      split = SplitSah( scene.primrefs.mem, aabbs, centroids, range.start, range.end, node->aabb );
+    }
+    if( split == range.end ) {
+      node->first = range.start;
+      node->count = range.end - range.start;
+    } else {
+      node->first = MAX_u32;
+      node->count = 0;
+      *AddBack( ranges ) = { split, range.end, range.depth + 1, node_idx };
+      *AddBack( ranges ) = { range.start, split, range.depth + 1, MAX_u32 };
+    }
+  }
+
+  Free( ranges );
+  MemHeapFree( centroids );
+  MemHeapFree( aabbs );
+}
+
+Inl void
+Kill( rtscene_t& scene )
+{
+  Free( scene.nodes );
+  Free( scene.primrefs );
+  scene = {};
+}
+
+
+ForceInl void
+TracePrimitive(
+  hit_t& closest,
+  rtmesh_t& mesh,
+  rtprimref_t& ref,
+  vec3<f32>& ray_p_model,
+  vec3<f32>& ray_d_model,
+  f32 t_min_world
+  )
+{
+  auto idx = ref.primitive_idx;
+  switch( ref.primitive_type ) {
+    case primitive_tritex:       { TraceTri( closest, mesh, mesh.tris_tex.mem[idx], ray_p_model, ray_d_model, t_min_world ); } break;
+    case primitive_tri:          { TraceTri( closest, mesh, mesh.tris.mem[idx], ray_p_model, ray_d_model, t_min_world ); } break;
+    case primitive_parallelotex: { TraceParallelo( closest, mesh, mesh.parallelos_tex.mem[idx], ray_p_model, ray_d_model, t_min_world ); } break;
+    case primitive_parallelo:    { TraceParallelo( closest, mesh, mesh.parallelos.mem[idx], ray_p_model, ray_d_model, t_min_world ); } break;
+    case primitive_sphere:       { TraceSphere( closest, mesh, mesh.spheres.mem[idx], ray_p_model, ray_d_model, t_min_world ); } break;
+    case primitive_disc:         { TraceDisc( closest, mesh, mesh.discs.mem[idx], ray_p_model, ray_d_model, t_min_world ); } break;
+    case primitive_cylinder:     { TraceCylinder( closest, mesh, mesh.cylinders.mem[idx], ray_p_model, ray_d_model, t_min_world ); } break;
+    case primitive_cone:         { TraceCone( closest, mesh, mesh.cones.mem[idx], ray_p_model, ray_d_model, t_min_world ); } break;
+    default: UnreachableCrash();
+  }
+}
+
+// Fills in the world space parts of the hit, once we know the closest one.
+Inl void
+FinishHit( hit_t& closest )
+{
+  if( Valid( closest ) ) {
+    auto& mesh = *closest.mesh;
+
+    closest.basis.n = WorldFromModelN( mesh, closest.basis.n );
+    OrthonormalBasisGivenNorm( closest.basis.t, closest.basis.b, closest.basis.n, cos_epsilon );
+
+    closest.x_world = WorldFromModelP( mesh, closest.x_model );
+    //closest.x_world = ray_p_world + closest.t_world * ray_d_world;
+    //auto err = Length( x_world - closest.x_world );
+    //Log( "transform err: %f", err );
+  }
+}
+
+// Reference implementation; tests every primitive in the scene.
+// Kept around for validating and benchmarking the BVH traversal.
 Inl hit_t
-Trace(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+TraceBruteForce(
+  rtscene_t& scene,
   vec3<f32>& ray_p_world,
   vec3<f32>& ray_d_world,
   f32 t_min_world
@@ -2258,8 +2726,8 @@ Trace(
   hit_t closest;
   Init( closest );
 
-  For( m, 0, meshes_len ) {
-    auto& mesh = *meshes[m];
+  For( m, 0, scene.meshes_len ) {
+    auto& mesh = *scene.meshes[m];
 
     auto ray_p_model = ModelFromWorldP( mesh, ray_p_world );
     auto ray_d_model = ModelFromWorldN( mesh, ray_d_world );
@@ -2306,19 +2774,609 @@ Trace(
 
   }
 
-  if( Valid( closest ) ) {
-    auto& mesh = *closest.mesh;
+  FinishHit( closest );
+  return closest;
+}
 
-    closest.basis.n = WorldFromModelN( mesh, closest.basis.n );
-    OrthonormalBasisGivenNorm( closest.basis.t, closest.basis.b, closest.basis.n, cos_epsilon );
+Inl hit_t
+Trace(
+  rtscene_t& scene,
+  vec3<f32>& ray_p_world,
+  vec3<f32>& ray_d_world,
+  f32 t_min_world
+  )
+{
+  ProfFunc();
 
-    closest.x_world = WorldFromModelP( mesh, closest.x_model );
-    //closest.x_world = ray_p_world + closest.t_world * ray_d_world;
-    //auto err = Length( x_world - closest.x_world );
-    //Log( "transform err: %f", err );
+  hit_t closest;
+  Init( closest );
+
+  if( !scene.nodes.len ) {
+    return closest;
+  }
+
+  auto rec_ray_d_world = 1.0f / ray_d_world;
+
+  f32 t_enter;
+  if( !IntersectAabb( scene.nodes.mem[0].aabb, ray_p_world, rec_ray_d_world, t_min_world, closest.t_world, &t_enter ) ) {
+    return closest;
+  }
+
+  // Model space rays are cached per mesh, since consecutive leaf primitives usually share a mesh.
+  rtmesh_t* mesh_model = 0;
+  vec3<f32> ray_p_model;
+  vec3<f32> ray_d_model;
+
+  // Every node on the stack has already passed its box test; we re-check the entry distance
+  // against closest.t_world when popping, since the closest hit may have moved in the meantime.
+  struct
+  stackelem_t
+  {
+    u32 node_idx;
+    f32 t_enter;
+  };
+  stackelem_t stack[c_bvh_max_depth + 4];
+  u32 stack_len = 0;
+  stack[stack_len++] = { 0, t_enter };
+
+  while( stack_len ) {
+    auto elem = stack[--stack_len];
+    if( elem.t_enter >= closest.t_world ) {
+      continue;
+    }
+    auto& node = scene.nodes.mem[elem.node_idx];
+
+    if( node.count ) {
+      Fori( u32, i, node.first, node.first + node.count ) {
+        auto& ref = scene.primrefs.mem[i];
+        auto& mesh = *scene.meshes[ref.mesh_idx];
+        if( &mesh != mesh_model ) {
+          mesh_model = &mesh;
+          ray_p_model = ModelFromWorldP( mesh, ray_p_world );
+          ray_d_model = ModelFromWorldN( mesh, ray_d_world );
+        }
+        TracePrimitive( closest, mesh, ref, ray_p_model, ray_d_model, t_min_world );
+      }
+      continue;
+    }
+
+    auto idx_l = elem.node_idx + 1;
+    auto idx_r = node.first;
+    f32 t_l, t_r;
+    bool hit_l = IntersectAabb( scene.nodes.mem[idx_l].aabb, ray_p_world, rec_ray_d_world, t_min_world, closest.t_world, &t_l );
+    bool hit_r = IntersectAabb( scene.nodes.mem[idx_r].aabb, ray_p_world, rec_ray_d_world, t_min_world, closest.t_world, &t_r );
+
+    // Push the farther child first, so we visit the nearer one next.
+    if( hit_l  &&  hit_r ) {
+      if( t_l <= t_r ) {
+        stack[stack_len++] = { idx_r, t_r };
+        stack[stack_len++] = { idx_l, t_l };
+      } else {
+        stack[stack_len++] = { idx_l, t_l };
+        stack[stack_len++] = { idx_r, t_r };
+      }
+    } elif( hit_l ) {
+      stack[stack_len++] = { idx_l, t_l };
+    } elif( hit_r ) {
+      stack[stack_len++] = { idx_r, t_r };
+    }
+    AssertCrash( stack_len <= _countof( stack ) );
+  }
+
+  FinishHit( closest );
+  return closest;
+}
+
+
+
+// ============================================================================
+// RAY PACKETS
+//
+// 4-wide SSE packets of rays, stored SoA, traced through the same BVH as Trace.
+// Lanes carry an active mask, so partially filled packets and divergent lanes just get masked off.
+// The packet kernels only find the closest primref per lane. We then re-run the scalar Trace* fn
+// on that one primitive to fill in the hit_t, so whenever the same primitive wins, the shading
+// inputs are bit-identical to the scalar path.
+//
+// Triangles, parallelograms, spheres and discs have SIMD kernels; cylinders and cones fall back
+// to the scalar kernel for each active lane.
+//
+
+struct
+vec3x4_t
+{
+  __m128 x;
+  __m128 y;
+  __m128 z;
+};
+
+ForceInl vec3x4_t
+_vec3x4( vec3<f32> a )
+{
+  vec3x4_t r;
+  r.x = _mm_set1_ps( a.x );
+  r.y = _mm_set1_ps( a.y );
+  r.z = _mm_set1_ps( a.z );
+  return r;
+}
+
+ForceInl vec3x4_t
+_vec3x4( vec3<f32>* a )
+{
+  vec3x4_t r;
+  r.x = _mm_setr_ps( a[0].x, a[1].x, a[2].x, a[3].x );
+  r.y = _mm_setr_ps( a[0].y, a[1].y, a[2].y, a[3].y );
+  r.z = _mm_setr_ps( a[0].z, a[1].z, a[2].z, a[3].z );
+  return r;
+}
+
+ForceInl vec3<f32>
+Lane( vec3x4_t& a, u32 lane )
+{
+  alignas( 16 ) f32 x[4];
+  alignas( 16 ) f32 y[4];
+  alignas( 16 ) f32 z[4];
+  _mm_store_ps( x, a.x );
+  _mm_store_ps( y, a.y );
+  _mm_store_ps( z, a.z );
+  return _vec3( x[lane], y[lane], z[lane] );
+}
+
+ForceInl vec3x4_t
+Sub( vec3x4_t& a, vec3x4_t& b )
+{
+  vec3x4_t r;
+  r.x = _mm_sub_ps( a.x, b.x );
+  r.y = _mm_sub_ps( a.y, b.y );
+  r.z = _mm_sub_ps( a.z, b.z );
+  return r;
+}
+
+// Same operation order as the scalar Dot, so results match bit for bit.
+ForceInl __m128
+Dot( vec3x4_t& a, vec3x4_t& b )
+{
+  return _mm_add_ps( _mm_add_ps( _mm_mul_ps( a.x, b.x ), _mm_mul_ps( a.y, b.y ) ), _mm_mul_ps( a.z, b.z ) );
+}
+
+ForceInl __m128
+Dot( vec3<f32> a, vec3x4_t& b )
+{
+  auto ax = _mm_set1_ps( a.x );
+  auto ay = _mm_set1_ps( a.y );
+  auto az = _mm_set1_ps( a.z );
+  return _mm_add_ps( _mm_add_ps( _mm_mul_ps( ax, b.x ), _mm_mul_ps( ay, b.y ) ), _mm_mul_ps( az, b.z ) );
+}
+
+ForceInl vec3x4_t
+Cross( vec3x4_t& a, vec3x4_t& b )
+{
+  vec3x4_t r;
+  r.x = _mm_sub_ps( _mm_mul_ps( a.y, b.z ), _mm_mul_ps( a.z, b.y ) );
+  r.y = _mm_sub_ps( _mm_mul_ps( a.z, b.x ), _mm_mul_ps( a.x, b.z ) );
+  r.z = _mm_sub_ps( _mm_mul_ps( a.x, b.y ), _mm_mul_ps( a.y, b.x ) );
+  return r;
+}
+
+// SSE2 stand-in for blendv: mask ? a : b.
+ForceInl __m128
+Select( __m128 mask, __m128 a, __m128 b )
+{
+  return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+
+ForceInl __m128
+Abs( __m128 a )
+{
+  return _mm_andnot_ps( _mm_set1_ps( -0.0f ), a );
+}
+
+ForceInl vec3x4_t
+ModelFromWorldP( rtmesh_t& mesh, vec3x4_t& p_world )
+{
+  auto translation = _vec3x4( mesh.translation_world );
+  auto scale = _mm_set1_ps( mesh.scale_model_from_world );
+  auto p = Sub( p_world, translation );
+  p.x = _mm_mul_ps( p.x, scale );
+  p.y = _mm_mul_ps( p.y, scale );
+  p.z = _mm_mul_ps( p.z, scale );
+  vec3x4_t p_model;
+  p_model.x = Dot( mesh.rotation_model_from_world.row0, p );
+  p_model.y = Dot( mesh.rotation_model_from_world.row1, p );
+  p_model.z = Dot( mesh.rotation_model_from_world.row2, p );
+  return p_model;
+}
+
+ForceInl vec3x4_t
+ModelFromWorldN( rtmesh_t& mesh, vec3x4_t& n_world )
+{
+  vec3x4_t n_model;
+  n_model.x = Dot( mesh.rotation_model_from_world.row0, n_world );
+  n_model.y = Dot( mesh.rotation_model_from_world.row1, n_world );
+  n_model.z = Dot( mesh.rotation_model_from_world.row2, n_world );
+  return n_model;
+}
+
+
+struct
+rtclosest4_t
+{
+  __m128 t_world;
+  __m128i primref_idx; // -1 for no hit.
+};
+
+ForceInl void
+Update( rtclosest4_t& closest, __m128 mask, __m128 t_world, u32 primref_idx )
+{
+  closest.t_world = Select( mask, t_world, closest.t_world );
+  closest.primref_idx = _mm_castps_si128( Select(
+    mask,
+    _mm_castsi128_ps( _mm_set1_epi32( Cast( s32, primref_idx ) ) ),
+    _mm_castsi128_ps( closest.primref_idx )
+    ) );
+}
+
+// Shared by tris and parallelos; see the scalar TraceTri.
+// Returns the lanes that hit the plane in the valid t range, and writes the plane params u,v.
+ForceInl __m128
+TracePlane4(
+  rtclosest4_t& closest,
+  __m128 active,
+  vec3<f32>& plane_p,
+  vec3<f32>& plane_n,
+  vec3<f32>& e0,
+  vec3<f32>& e1,
+  f32 area,
+  vec3x4_t& ray_p_model,
+  vec3x4_t& ray_d_model,
+  __m128 scale_world_from_model,
+  __m128 t_min_world,
+  __m128& t_world,
+  __m128& u,
+  __m128& v
+  )
+{
+  auto cos_theta = Dot( plane_n, ray_d_model );
+  auto intersects_plane = _mm_cmpgt_ps( Abs( cos_theta ), _mm_set1_ps( cos_epsilon ) );
+  auto mask = _mm_and_ps( active, intersects_plane );
+  if( !_mm_movemask_ps( mask ) ) {
+    return mask;
+  }
+  auto rec_cos_theta = _mm_div_ps( _mm_set1_ps( 1.0f ), cos_theta );
+  auto p = _vec3x4( plane_p );
+  auto c = Sub( ray_p_model, p );
+  auto t_model = _mm_mul_ps( _mm_sub_ps( _mm_setzero_ps(), Dot( plane_n, c ) ), rec_cos_theta );
+  t_world = _mm_mul_ps( t_model, scale_world_from_model );
+  mask = _mm_and_ps( mask, _mm_cmpgt_ps( t_world, t_min_world ) );
+  mask = _mm_and_ps( mask, _mm_cmplt_ps( t_world, closest.t_world ) );
+  if( !_mm_movemask_ps( mask ) ) {
+    return mask;
+  }
+  auto cross_c_d = Cross( c, ray_d_model );
+  auto rec_denom = _mm_div_ps( rec_cos_theta, _mm_set1_ps( area ) );
+  u = _mm_mul_ps( _mm_sub_ps( _mm_setzero_ps(), Dot( e1, cross_c_d ) ), rec_denom );
+  v = _mm_mul_ps( Dot( e0, cross_c_d ), rec_denom );
+  return mask;
+}
+
+Templ ForceInl void
+TraceTri4(
+  rtclosest4_t& closest,
+  __m128 active,
+  u32 primref_idx,
+  T& tri,
+  vec3x4_t& ray_p_model,
+  vec3x4_t& ray_d_model,
+  __m128 scale_world_from_model,
+  __m128 t_min_world
+  )
+{
+  __m128 t_world, u, v;
+  auto mask = TracePlane4(
+    closest, active, tri.p, tri.n, tri.e0, tri.e1, tri.twice_surface_area_model,
+    ray_p_model, ray_d_model, scale_world_from_model, t_min_world, t_world, u, v
+    );
+  if( !_mm_movemask_ps( mask ) ) {
+    return;
+  }
+  auto min_uv = _mm_set1_ps( -uv_epsilon );
+  auto max_sum = _mm_set1_ps( 1 + uv_epsilon );
+  mask = _mm_and_ps( mask, _mm_cmpge_ps( u, min_uv ) );
+  mask = _mm_and_ps( mask, _mm_cmpge_ps( v, min_uv ) );
+  mask = _mm_and_ps( mask, _mm_cmple_ps( _mm_add_ps( u, v ), max_sum ) );
+  Update( closest, mask, t_world, primref_idx );
+}
+
+Templ ForceInl void
+TraceParallelo4(
+  rtclosest4_t& closest,
+  __m128 active,
+  u32 primref_idx,
+  T& parallelo,
+  vec3x4_t& ray_p_model,
+  vec3x4_t& ray_d_model,
+  __m128 scale_world_from_model,
+  __m128 t_min_world
+  )
+{
+  __m128 t_world, u, v;
+  auto mask = TracePlane4(
+    closest, active, parallelo.p, parallelo.n, parallelo.e0, parallelo.e1, parallelo.surface_area_model,
+    ray_p_model, ray_d_model, scale_world_from_model, t_min_world, t_world, u, v
+    );
+  if( !_mm_movemask_ps( mask ) ) {
+    return;
+  }
+  auto min_uv = _mm_set1_ps( -uv_epsilon );
+  auto max_uv = _mm_set1_ps( 1 + uv_epsilon );
+  mask = _mm_and_ps( mask, _mm_cmpge_ps( u, min_uv ) );
+  mask = _mm_and_ps( mask, _mm_cmple_ps( u, max_uv ) );
+  mask = _mm_and_ps( mask, _mm_cmpge_ps( v, min_uv ) );
+  mask = _mm_and_ps( mask, _mm_cmple_ps( v, max_uv ) );
+  Update( closest, mask, t_world, primref_idx );
+}
+
+ForceInl void
+TraceDisc4(
+  rtclosest4_t& closest,
+  __m128 active,
+  u32 primref_idx,
+  rtdisc_t& disc,
+  vec3x4_t& ray_p_model,
+  vec3x4_t& ray_d_model,
+  __m128 scale_world_from_model,
+  __m128 t_min_world
+  )
+{
+  auto cos_theta = Dot( disc.n, ray_d_model );
+  auto mask = _mm_and_ps( active, _mm_cmpgt_ps( Abs( cos_theta ), _mm_set1_ps( cos_epsilon ) ) );
+  if( !_mm_movemask_ps( mask ) ) {
+    return;
+  }
+  auto rec_cos_theta = _mm_div_ps( _mm_set1_ps( 1.0f ), cos_theta );
+  auto p = _vec3x4( disc.p );
+  auto c = Sub( ray_p_model, p );
+  auto t_model = _mm_mul_ps( _mm_sub_ps( _mm_setzero_ps(), Dot( disc.n, c ) ), rec_cos_theta );
+  auto t_world = _mm_mul_ps( t_model, scale_world_from_model );
+  mask = _mm_and_ps( mask, _mm_cmpgt_ps( t_world, t_min_world ) );
+  mask = _mm_and_ps( mask, _mm_cmplt_ps( t_world, closest.t_world ) );
+  if( !_mm_movemask_ps( mask ) ) {
+    return;
+  }
+  vec3x4_t x_model;
+  x_model.x = _mm_add_ps( ray_p_model.x, _mm_mul_ps( t_model, ray_d_model.x ) );
+  x_model.y = _mm_add_ps( ray_p_model.y, _mm_mul_ps( t_model, ray_d_model.y ) );
+  x_model.z = _mm_add_ps( ray_p_model.z, _mm_mul_ps( t_model, ray_d_model.z ) );
+  auto d = Sub( x_model, p );
+  auto d2 = Dot( d, d );
+  mask = _mm_and_ps( mask, _mm_cmplt_ps( d2, _mm_set1_ps( disc.sq_radius ) ) );
+  Update( closest, mask, t_world, primref_idx );
+}
+
+ForceInl void
+TraceSphere4(
+  rtclosest4_t& closest,
+  __m128 active,
+  u32 primref_idx,
+  rtsphere_t& sphere,
+  vec3x4_t& ray_p_model,
+  vec3x4_t& ray_d_model,
+  __m128 scale_world_from_model,
+  __m128 t_min_world
+  )
+{
+  auto p = _vec3x4( sphere.p );
+  auto rel = Sub( p, ray_p_model );
+  auto tau = _mm_mul_ps( _mm_set1_ps( 2.0f ), Dot( ray_d_model, rel ) );
+  auto del = _mm_sub_ps( Dot( rel, rel ), _mm_set1_ps( sphere.sq_radius ) );
+  auto disc = _mm_sub_ps( _mm_mul_ps( tau, tau ), _mm_mul_ps( _mm_set1_ps( 4.0f ), del ) );
+  auto mask = _mm_and_ps( active, _mm_cmpge_ps( disc, _mm_setzero_ps() ) );
+  if( !_mm_movemask_ps( mask ) ) {
+    return;
+  }
+  // The scalar version treats disc < sphere_epsilon as a tangent hit at exactly 0.5 * tau.
+  auto tangent = _mm_cmplt_ps( disc, _mm_set1_ps( sphere_epsilon ) );
+  auto rt_disc = _mm_andnot_ps( tangent, _mm_sqrt_ps( _mm_max_ps( disc, _mm_setzero_ps() ) ) );
+  auto half = _mm_set1_ps( 0.5f );
+  auto t0_model = _mm_mul_ps( half, _mm_sub_ps( tau, rt_disc ) );
+  auto t1_model = _mm_mul_ps( half, _mm_add_ps( tau, rt_disc ) );
+  auto t0_world = _mm_mul_ps( t0_model, scale_world_from_model );
+  auto t1_world = _mm_mul_ps( t1_model, scale_world_from_model );
+  auto valid0 = _mm_and_ps( _mm_cmpgt_ps( t0_world, t_min_world ), _mm_cmplt_ps( t0_world, closest.t_world ) );
+  auto valid1 = _mm_and_ps( _mm_cmpgt_ps( t1_world, t_min_world ), _mm_cmplt_ps( t1_world, closest.t_world ) );
+  auto t_world = Select( valid0, t0_world, t1_world );
+  mask = _mm_and_ps( mask, _mm_or_ps( valid0, valid1 ) );
+  Update( closest, mask, t_world, primref_idx );
+}
+
+// Scalar fallback for the primitive types without a SIMD kernel.
+Inl void
+TracePrimitiveLanes(
+  rtclosest4_t& closest,
+  __m128 active,
+  u32 primref_idx,
+  rtmesh_t& mesh,
+  rtprimref_t& ref,
+  vec3x4_t& ray_p_model,
+  vec3x4_t& ray_d_model,
+  f32* t_min_world // [4]
+  )
+{
+  auto lanes = _mm_movemask_ps( active );
+  alignas( 16 ) f32 t_world[4];
+  _mm_store_ps( t_world, closest.t_world );
+  alignas( 16 ) f32 t_world_new[4];
+  _mm_store_ps( t_world_new, closest.t_world );
+  Fori( u32, lane, 0, 4 ) {
+    if( !( lanes & ( 1 << lane ) ) ) {
+      continue;
+    }
+    hit_t hit;
+    Init( hit );
+    hit.t_world = t_world[lane];
+    auto ray_p = Lane( ray_p_model, lane );
+    auto ray_d = Lane( ray_d_model, lane );
+    TracePrimitive( hit, mesh, ref, ray_p, ray_d, t_min_world[lane] );
+    t_world_new[lane] = hit.t_world;
+  }
+  auto t_new = _mm_load_ps( t_world_new );
+  auto mask = _mm_and_ps( active, _mm_cmplt_ps( t_new, closest.t_world ) );
+  Update( closest, mask, t_new, primref_idx );
+}
+
+// Packet slab test; returns the lanes whose ray overlaps the box within [ t_min, t_max ].
+ForceInl __m128
+IntersectAabb4(
+  rtaabb_t& aabb,
+  vec3x4_t& ray_p,
+  vec3x4_t& rec_ray_d,
+  __m128 t_min,
+  __m128 t_max
+  )
+{
+  auto t0x = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( aabb.p0.x ), ray_p.x ), rec_ray_d.x );
+  auto t1x = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( aabb.p1.x ), ray_p.x ), rec_ray_d.x );
+  auto t0y = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( aabb.p0.y ), ray_p.y ), rec_ray_d.y );
+  auto t1y = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( aabb.p1.y ), ray_p.y ), rec_ray_d.y );
+  auto t0z = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( aabb.p0.z ), ray_p.z ), rec_ray_d.z );
+  auto t1z = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( aabb.p1.z ), ray_p.z ), rec_ray_d.z );
+  auto tnear = _mm_max_ps( _mm_max_ps( _mm_min_ps( t0x, t1x ), _mm_min_ps( t0y, t1y ) ), _mm_max_ps( _mm_min_ps( t0z, t1z ), t_min ) );
+  auto tfar = _mm_min_ps( _mm_min_ps( _mm_max_ps( t0x, t1x ), _mm_max_ps( t0y, t1y ) ), _mm_min_ps( _mm_max_ps( t0z, t1z ), t_max ) );
+  return _mm_cmple_ps( tnear, tfar );
+}
+
+// Traces up to 4 rays at once. Lanes with active == 0 are ignored, and get an invalid hit.
+// Each lane has its own t_min, since shadow rays scale theirs by the cosine at their hit point.
+Inl void
+TracePacket(
+  hit_t* hits, // [4]
+  rtscene_t& scene,
+  vec3<f32>* ray_p_world, // [4]
+  vec3<f32>* ray_d_world, // [4]
+  bool* active, // [4]
+  f32* t_min_world // [4]
+  )
+{
+  ProfFunc();
+
+  rtclosest4_t closest;
+  closest.t_world = _mm_set1_ps( MAX_f32 );
+  closest.primref_idx = _mm_set1_epi32( -1 );
+
+  auto active4 = _mm_castsi128_ps( _mm_setr_epi32( -s32( active[0] ), -s32( active[1] ), -s32( active[2] ), -s32( active[3] ) ) );
+
+  if( scene.nodes.len  &&  _mm_movemask_ps( active4 ) ) {
+    auto ray_p = _vec3x4( ray_p_world );
+    auto ray_d = _vec3x4( ray_d_world );
+    auto one = _mm_set1_ps( 1.0f );
+    vec3x4_t rec_ray_d;
+    rec_ray_d.x = _mm_div_ps( one, ray_d.x );
+    rec_ray_d.y = _mm_div_ps( one, ray_d.y );
+    rec_ray_d.z = _mm_div_ps( one, ray_d.z );
+    auto t_min = _mm_loadu_ps( t_min_world );
+
+    // For near-first child ordering; packets are assumed coherent, so one lane's direction suffices.
+    u32 lane_first = 0;
+    while( !active[lane_first] ) {
+      lane_first += 1;
+    }
+    auto& order_d = ray_d_world[lane_first];
+
+    rtmesh_t* mesh_model = 0;
+    vec3x4_t ray_p_model;
+    vec3x4_t ray_d_model;
+    __m128 scale_world_from_model = {};
+
+    u32 stack[c_bvh_max_depth + 4];
+    u32 stack_len = 0;
+    stack[stack_len++] = 0;
+
+    while( stack_len ) {
+      auto node_idx = stack[--stack_len];
+      auto& node = scene.nodes.mem[node_idx];
+      auto mask = _mm_and_ps( active4, IntersectAabb4( node.aabb, ray_p, rec_ray_d, t_min, closest.t_world ) );
+      if( !_mm_movemask_ps( mask ) ) {
+        continue;
+      }
+
+      if( node.count ) {
+        Fori( u32, i, node.first, node.first + node.count ) {
+          auto& ref = scene.primrefs.mem[i];
+          auto& mesh = *scene.meshes[ref.mesh_idx];
+          if( &mesh != mesh_model ) {
+            mesh_model = &mesh;
+            ray_p_model = ModelFromWorldP( mesh, ray_p );
+            ray_d_model = ModelFromWorldN( mesh, ray_d );
+            scale_world_from_model = _mm_set1_ps( mesh.scale_world_from_model );
+          }
+          auto idx = ref.primitive_idx;
+          switch( ref.primitive_type ) {
+            case primitive_tritex:       { TraceTri4( closest, mask, i, mesh.tris_tex.mem[idx], ray_p_model, ray_d_model, scale_world_from_model, t_min ); } break;
+            case primitive_tri:          { TraceTri4( closest, mask, i, mesh.tris.mem[idx], ray_p_model, ray_d_model, scale_world_from_model, t_min ); } break;
+            case primitive_parallelotex: { TraceParallelo4( closest, mask, i, mesh.parallelos_tex.mem[idx], ray_p_model, ray_d_model, scale_world_from_model, t_min ); } break;
+            case primitive_parallelo:    { TraceParallelo4( closest, mask, i, mesh.parallelos.mem[idx], ray_p_model, ray_d_model, scale_world_from_model, t_min ); } break;
+            case primitive_sphere:       { TraceSphere4( closest, mask, i, mesh.spheres.mem[idx], ray_p_model, ray_d_model, scale_world_from_model, t_min ); } break;
+            case primitive_disc:         { TraceDisc4( closest, mask, i, mesh.discs.mem[idx], ray_p_model, ray_d_model, scale_world_from_model, t_min ); } break;
+            case primitive_cylinder:
+            case primitive_cone: {
+              TracePrimitiveLanes( closest, mask, i, mesh, ref, ray_p_model, ray_d_model, t_min_world );
+            } break;
+            default: UnreachableCrash();
+          }
+        }
+        continue;
+      }
+
+      auto idx_l = node_idx + 1;
+      auto idx_r = node.first;
+      auto delta = Center( scene.nodes.mem[idx_r].aabb ) - Center( scene.nodes.mem[idx_l].aabb );
+      if( Dot( delta, order_d ) > 0 ) {
+        stack[stack_len++] = idx_r;
+        stack[stack_len++] = idx_l;
+      } else {
+        stack[stack_len++] = idx_l;
+        stack[stack_len++] = idx_r;
+      }
+      AssertCrash( stack_len <= _countof( stack ) );
+    }
   }
 
-  return closest;
+  // Fill in each lane's hit with the scalar kernel, on just the winning primitive.
+  // Right at an edge, the scalar kernel can reject the primitive the SIMD kernel picked. Those lanes are the only
+  // unresolved ones, so only they re-run the full scalar Trace, rather than reporting a miss.
+  alignas( 16 ) s32 primref_idxs[4];
+  _mm_store_si128( Cast( __m128i*, primref_idxs ), closest.primref_idx );
+  Fori( u32, lane, 0, 4 ) {
+    auto& hit = hits[lane];
+    Init( hit );
+    if( primref_idxs[lane] < 0 ) {
+      continue;
+    }
+    auto& ref = scene.primrefs.mem[primref_idxs[lane]];
+    auto& mesh = *scene.meshes[ref.mesh_idx];
+    auto ray_p_model = ModelFromWorldP( mesh, ray_p_world[lane] );
+    auto ray_d_model = ModelFromWorldN( mesh, ray_d_world[lane] );
+    TracePrimitive( hit, mesh, ref, ray_p_model, ray_d_model, t_min_world[lane] );
+    if( !Valid( hit ) ) {
+      hit = Trace( scene, ray_p_world[lane], ray_d_world[lane], t_min_world[lane] );
+      continue;
+    }
+    FinishHit( hit );
+  }
+}
+
+Inl void
+TracePacket(
+  hit_t* hits, // [4]
+  rtscene_t& scene,
+  vec3<f32>* ray_p_world, // [4]
+  vec3<f32>* ray_d_world, // [4]
+  bool* active, // [4]
+  f32 t_min_world
+  )
+{
+  f32 t_mins[4] = { t_min_world, t_min_world, t_min_world, t_min_world };
+  TracePacket( hits, scene, ray_p_world, ray_d_world, active, t_mins );
 }
 
 
@@ -2512,8 +3570,7 @@ RadianceEmit( hit_t& hit )
 //
 Inl vec3<f32>
 ReflectedRadiance_0_75(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   hit_t& hit,
   vec3<f32> wr,
   rng_t& rng,
@@ -2522,23 +3579,21 @@ ReflectedRadiance_0_75(
 
 Inl vec3<f32>
 Radiance_0_75(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   vec3<f32>& x,
   vec3<f32> w,
   rng_t& rng,
   f32 t_min_world
   )
 {
-  hit_t hit = Trace( meshes, meshes_len, x, w, t_min_world );
+  hit_t hit = Trace( scene, x, w, t_min_world );
   if( Invalid( hit ) ) {
     return bkgd_radiance_emit; // background radiance_emit
   }
 
   auto radiance_emit = RadianceEmit( hit );
   auto radiance_refl = ReflectedRadiance_0_75(
-    meshes,
-    meshes_len,
+    scene,
     hit,
     -w,
     rng,
@@ -2551,8 +3606,7 @@ Radiance_0_75(
 
 Inl vec3<f32>
 ReflectedRadiance_0_75(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   hit_t& hit,
   vec3<f32> wr,
   rng_t& rng,
@@ -2573,8 +3627,7 @@ ReflectedRadiance_0_75(
     auto brdf = Reflectance( hit ) * f32_PI_REC * Dot( wr, hit.basis.n );
 
     auto radiance_in = Radiance_0_75(
-      meshes,
-      meshes_len,
+      scene,
       x,
       wi,
       rng,
@@ -2595,8 +3648,7 @@ ReflectedRadiance_0_75(
 //
 Inl vec3<f32>
 ReflectedRadiance_1_0(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   hit_t& hit,
@@ -2607,8 +3659,7 @@ ReflectedRadiance_1_0(
 
 Inl vec3<f32>
 Radiance_1_0(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   vec3<f32>& x,
@@ -2617,7 +3668,7 @@ Radiance_1_0(
   f32 t_min_world
   )
 {
-  hit_t hit = Trace( meshes, meshes_len, x, w, t_min_world );
+  hit_t hit = Trace( scene, x, w, t_min_world );
   if( Invalid( hit ) ) {
     return bkgd_radiance_emit;
   }
@@ -2628,8 +3679,7 @@ Radiance_1_0(
   }
 
   auto radiance_refl = ReflectedRadiance_1_0(
-    meshes,
-    meshes_len,
+    scene,
     lights,
     lights_len,
     hit,
@@ -2640,10 +3690,20 @@ Radiance_1_0(
   return radiance_refl;
 }
 
-Inl vec3<f32>
-DirectRadianceFromSphere_1_0(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+// One direct lighting sample: a shadow ray toward a point on a light.
+// The sample's radiance is weight * RadianceEmit of whatever the shadow ray hits.
+// Split from the trace, so RadianceFromHits_1_0 can trace a packet of these at once.
+struct
+lightsample_t
+{
+  vec3<f32> wi;
+  vec3<f32> weight;
+  f32 t_min_world;
+  bool active; // 0 if wi is below the surface; there's nothing to trace, and the radiance is 0.
+};
+
+Inl lightsample_t
+LightSampleFromSphere_1_0(
   rtmesh_t& light,
   hit_t& hit,
   vec3<f32> wr,
@@ -2654,6 +3714,8 @@ DirectRadianceFromSphere_1_0(
   AssertCrash( light.spheres.len == 1 );
   auto& sphere = light.spheres.mem[0];
 
+  lightsample_t sample = {};
+
   auto sphere_p_world = WorldFromModelP( light, sphere.p );
   auto sphere_r_world = WorldFromModelDist( light, sphere.radius );
   auto sphere_r2_world = Square( sphere_r_world );
@@ -2671,7 +3733,7 @@ DirectRadianceFromSphere_1_0(
     rec_wi_pdf = f32_2PI;
     cos_theta_i = Dot( wi, hit.basis.n );
     if( cos_theta_i < cos_epsilon ) {
-      return _vec3( 0.0f );
+      return sample;
     }
 
   } else {
@@ -2688,26 +3750,21 @@ DirectRadianceFromSphere_1_0(
     rec_wi_pdf = f32_2PI * ( 1 - cos_alpha );
     cos_theta_i = Dot( wi, hit.basis.n );
     if( cos_theta_i < cos_epsilon ) {
-      return _vec3( 0.0f );
+      return sample;
     }
   }
 
-  t_min_world /= MAX( t_min_world, cos_theta_i );
-  hit_t lighthit = Trace( meshes, meshes_len, hit.x_world, wi, t_min_world );
-  if( Invalid( lighthit ) ) {
-    return _vec3( 0.0f );
-  }
-
   auto brdf = Reflectance( hit ) * f32_PI_REC * Dot( wr, hit.basis.n );
 
-  auto res = ( brdf * RadianceEmit( lighthit ) * rec_wi_pdf );
-  return res;
+  sample.wi = wi;
+  sample.weight = brdf * rec_wi_pdf;
+  sample.t_min_world = t_min_world / MAX( t_min_world, cos_theta_i );
+  sample.active = 1;
+  return sample;
 }
 
-Inl vec3<f32>
-DirectRadianceFromParallelo_1_0(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+Inl lightsample_t
+LightSampleFromParallelo_1_0(
   rtmesh_t& light,
   hit_t& hit,
   vec3<f32> wr,
@@ -2718,6 +3775,8 @@ DirectRadianceFromParallelo_1_0(
   AssertCrash( light.parallelos.len == 1 );
   auto& parallelo = light.parallelos.mem[0];
 
+  lightsample_t sample = {};
+
   auto p_world = WorldFromModelP( light, parallelo.p );
   auto n_world = WorldFromModelN( light, parallelo.n );
   auto surface_area = WorldFromModelArea( light, parallelo.surface_area_model );
@@ -2737,26 +3796,21 @@ DirectRadianceFromParallelo_1_0(
   auto cos_theta_i = Dot( wi, hit.basis.n );
 
   if( cos_theta_i < cos_epsilon ) {
-    return _vec3( 0.0f );
-  }
-
-  t_min_world /= MAX( t_min_world, cos_theta_i );
-  hit_t lighthit = Trace( meshes, meshes_len, hit.x_world, wi, t_min_world );
-  if( Invalid( lighthit ) ) {
-    return _vec3( 0.0f );
+    return sample;
   }
 
   auto brdf = Reflectance( hit ) * f32_PI_REC * Dot( wr, hit.basis.n );
   auto cos_thetaprime = ABS( Dot( n_world, wi ) );
 
-  auto res = ( brdf * RadianceEmit( lighthit ) * cos_thetaprime * rec_wi_pdf * rec_d2 );
-  return res;
+  sample.wi = wi;
+  sample.weight = brdf * ( cos_thetaprime * rec_wi_pdf * rec_d2 );
+  sample.t_min_world = t_min_world / MAX( t_min_world, cos_theta_i );
+  sample.active = 1;
+  return sample;
 }
 
-Inl vec3<f32>
-DirectRadianceFromDisc_1_0(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+Inl lightsample_t
+LightSampleFromDisc_1_0(
   rtmesh_t& light,
   hit_t& hit,
   vec3<f32> wr,
@@ -2768,6 +3822,8 @@ DirectRadianceFromDisc_1_0(
   AssertCrash( light.discs.len == 1 );
   auto& disc = light.discs.mem[0];
 
+  lightsample_t sample = {};
+
   auto p_world = WorldFromModelP( light, disc.p );
   auto n_world = WorldFromModelN( light, disc.n );
   auto radius_world = WorldFromModelDist( light, disc.radius );
@@ -2787,27 +3843,21 @@ DirectRadianceFromDisc_1_0(
   auto cos_theta_i = Dot( wi, hit.basis.n );
 
   if( cos_theta_i < cos_epsilon ) {
-    return _vec3( 0.0f );
-  }
-
-  t_min_world /= MAX( t_min_world, cos_theta_i );
-  hit_t lighthit = Trace( meshes, meshes_len, hit.x_world, wi, t_min_world );
-  if( Invalid( lighthit ) ) {
-    return _vec3( 0.0f );
+    return sample;
   }
 
   auto brdf = Reflectance( hit ) * f32_PI_REC * Dot( wr, hit.basis.n );
   auto cos_thetaprime = ABS( Dot( n_world, wi ) );
 
-  auto res = ( brdf * RadianceEmit( lighthit ) * cos_thetaprime * rec_wi_pdf * rec_d2 );
-  return res;
+  sample.wi = wi;
+  sample.weight = brdf * ( cos_thetaprime * rec_wi_pdf * rec_d2 );
+  sample.t_min_world = t_min_world / MAX( t_min_world, cos_theta_i );
+  sample.active = 1;
+  return sample;
 }
 
-
-Inl vec3<f32>
-DirectRadiance_1_0(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+Inl lightsample_t
+LightSample_1_0(
   rtmesh_t* lights[],
   idx_t lights_len,
   hit_t& hit,
@@ -2820,25 +3870,57 @@ DirectRadiance_1_0(
   auto light_idx = Rand64( rng ) % lights_len;
   auto& light = *lights[light_idx];
 
-  vec3<f32> direct_radiance = {};
+  lightsample_t sample = {};
 
   // TODO: enum all light types.
 
   if( light.spheres.len > 0 ) {
-    direct_radiance = DirectRadianceFromSphere_1_0( meshes, meshes_len, light, hit, wr, rng, t_min_world );
+    sample = LightSampleFromSphere_1_0( light, hit, wr, rng, t_min_world );
   } elif( light.parallelos.len > 0 ) {
-    direct_radiance = DirectRadianceFromParallelo_1_0( meshes, meshes_len, light, hit, wr, rng, t_min_world );
+    sample = LightSampleFromParallelo_1_0( light, hit, wr, rng, t_min_world );
   } elif( light.discs.len > 0 ) {
-    direct_radiance = DirectRadianceFromDisc_1_0( meshes, meshes_len, light, hit, wr, rng, t_min_world );
+    sample = LightSampleFromDisc_1_0( light, hit, wr, rng, t_min_world );
+  }
+
+  return sample;
+}
+
+Inl vec3<f32>
+DirectRadianceFromLightHit_1_0(
+  lightsample_t& sample,
+  hit_t& lighthit
+  )
+{
+  if( !sample.active  ||  Invalid( lighthit ) ) {
+    return _vec3( 0.0f );
   }
+  auto res = ( sample.weight * RadianceEmit( lighthit ) );
+  return res;
+}
 
+Inl vec3<f32>
+DirectRadiance_1_0(
+  rtscene_t& scene,
+  rtmesh_t* lights[],
+  idx_t lights_len,
+  hit_t& hit,
+  vec3<f32> wr,
+  rng_t& rng,
+  f32 t_min_world
+  )
+{
+  auto sample = LightSample_1_0( lights, lights_len, hit, wr, rng, t_min_world );
+  if( !sample.active ) {
+    return _vec3( 0.0f );
+  }
+  hit_t lighthit = Trace( scene, hit.x_world, sample.wi, sample.t_min_world );
+  auto direct_radiance = DirectRadianceFromLightHit_1_0( sample, lighthit );
   return direct_radiance;
 }
 
 Inl vec3<f32>
 IndirectRadiance_1_0(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   hit_t& hit,
@@ -2865,8 +3947,7 @@ IndirectRadiance_1_0(
   auto brdf = reflectance * f32_PI_REC * Dot( wr, hit.basis.n );
 
   auto radiance_in = Radiance_1_0(
-    meshes,
-    meshes_len,
+    scene,
     lights,
     lights_len,
     hit.x_world,
@@ -2880,8 +3961,7 @@ IndirectRadiance_1_0(
 
 Inl vec3<f32>
 ReflectedRadiance_1_0(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   hit_t& hit,
@@ -2896,8 +3976,7 @@ ReflectedRadiance_1_0(
   auto rec_prob_indirect = 1 / ( 1 - prob_direct );
   if( Zeta32( rng ) < prob_direct ) {
     auto radiance_direct = DirectRadiance_1_0(
-      meshes,
-      meshes_len,
+      scene,
       lights,
       lights_len,
       hit,
@@ -2908,8 +3987,7 @@ ReflectedRadiance_1_0(
     return radiance_direct * rec_prob_direct;
   } else {
     auto radiance_indirect = IndirectRadiance_1_0(
-      meshes,
-      meshes_len,
+      scene,
       lights,
       lights_len,
       hit,
@@ -2922,8 +4000,7 @@ ReflectedRadiance_1_0(
 #else
 
   auto radiance_direct = DirectRadiance_1_0(
-    meshes,
-    meshes_len,
+    scene,
     lights,
     lights_len,
     hit,
@@ -2933,8 +4010,7 @@ ReflectedRadiance_1_0(
     );
 //  auto radiance_direct = _vec3( 0.0f );
   auto radiance_indirect = IndirectRadiance_1_0(
-    meshes,
-    meshes_len,
+    scene,
     lights,
     lights_len,
     hit,
@@ -2949,6 +4025,95 @@ ReflectedRadiance_1_0(
 #endif
 }
 
+// Shades up to 4 primary hits, like the tail of Radiance_1_0 per lane.
+// Every lane draws its light sample first, then the shadow rays are traced, then every lane runs its indirect bounce.
+// With packet set, the shadow rays go through TracePacket: they start a subpixel apart and aim at the same light,
+// so they're about as coherent as the primary rays. Both modes draw from the rng in the same order.
+Inl void
+RadianceFromHits_1_0(
+  vec3<f32>* radiances, // [lanes]
+  rtscene_t& scene,
+  rtmesh_t* lights[],
+  idx_t lights_len,
+  hit_t* hits, // [lanes]
+  vec3<f32>* ws, // [lanes]
+  u32 lanes,
+  rng_t& rng,
+  f32 t_min_world,
+  bool packet
+  )
+{
+  AssertCrash( lanes <= 4 );
+
+  lightsample_t samples[4];
+  vec3<f32> shadow_ps[4];
+  vec3<f32> shadow_ds[4];
+  f32 shadow_t_mins[4];
+  bool shadow_actives[4];
+  bool reflects[4];
+  Fori( u32, lane, 0, 4 ) {
+    samples[lane] = {};
+    shadow_ps[lane] = _vec3( 0.0f );
+    shadow_ds[lane] = _vec3( 0.0f, 0.0f, 1.0f );
+    shadow_t_mins[lane] = t_min_world;
+    shadow_actives[lane] = 0;
+    reflects[lane] = 0;
+  }
+
+  Fori( u32, lane, 0, lanes ) {
+    auto& hit = hits[lane];
+    if( Invalid( hit ) ) {
+      radiances[lane] = bkgd_radiance_emit;
+      continue;
+    }
+    auto radiance_emit = RadianceEmit( hit );
+    if( MaxElem( radiance_emit ) > 0 ) {
+      radiances[lane] = radiance_emit;
+      continue;
+    }
+    reflects[lane] = 1;
+    auto& sample = samples[lane];
+    sample = LightSample_1_0( lights, lights_len, hit, -ws[lane], rng, t_min_world );
+    if( sample.active ) {
+      shadow_ps[lane] = hit.x_world;
+      shadow_ds[lane] = sample.wi;
+      shadow_t_mins[lane] = sample.t_min_world;
+      shadow_actives[lane] = 1;
+    }
+  }
+
+  hit_t lighthits[4];
+  if( packet ) {
+    TracePacket( lighthits, scene, shadow_ps, shadow_ds, shadow_actives, shadow_t_mins );
+  } else {
+    Fori( u32, lane, 0, lanes ) {
+      if( shadow_actives[lane] ) {
+        lighthits[lane] = Trace( scene, shadow_ps[lane], shadow_ds[lane], shadow_t_mins[lane] );
+      }
+    }
+  }
+
+  Fori( u32, lane, 0, lanes ) {
+    if( !reflects[lane] ) {
+      continue;
+    }
+    vec3<f32> radiance_direct = {};
+    if( shadow_actives[lane] ) {
+      radiance_direct = DirectRadianceFromLightHit_1_0( samples[lane], lighthits[lane] );
+    }
+    auto radiance_indirect = IndirectRadiance_1_0(
+      scene,
+      lights,
+      lights_len,
+      hits[lane],
+      -ws[lane],
+      rng,
+      t_min_world
+      );
+    radiances[lane] = radiance_direct + radiance_indirect;
+  }
+}
+
 
 
 
@@ -2960,8 +4125,7 @@ ReflectedRadiance_1_0(
 //
 Inl vec3<f32>
 ReflectedRadiance_1_0m(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   hit_t& hit,
@@ -2972,8 +4136,7 @@ ReflectedRadiance_1_0m(
 
 Inl vec3<f32>
 Radiance_1_0m(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   vec3<f32>& x,
@@ -2982,13 +4145,13 @@ Radiance_1_0m(
   f32 t_min_world
   )
 {
-  hit_t hit = Trace( meshes, meshes_len, x, w, t_min_world );
+  hit_t hit = Trace( scene, x, w, t_min_world );
   if( Invalid( hit ) ) {
     return bkgd_radiance_emit;
   }
 
   auto radiance_emit = RadianceEmit( hit );
-  auto radiance_refl = ReflectedRadiance_1_0m( meshes, meshes_len, lights, lights_len, hit, -w, rng, t_min_world );
+  auto radiance_refl = ReflectedRadiance_1_0m( scene, lights, lights_len, hit, -w, rng, t_min_world );
 
   auto res = radiance_emit + radiance_refl;
   return res;
@@ -2996,8 +4159,7 @@ Radiance_1_0m(
 
 Inl vec3<f32>
 DirectRadianceFromDisc_1_0m(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t& light,
   hit_t& hit,
   vec3<f32> wr,
@@ -3012,8 +4174,7 @@ DirectRadianceFromDisc_1_0m(
 
 Inl vec3<f32>
 DirectRadiance_1_0m(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   hit_t& hit,
@@ -3056,7 +4217,7 @@ DirectRadiance_1_0m(
   auto rec_cos_thetaprime = 1 / cos_thetaprime;
   auto cos_theta_i_light = Dot( wi_light, hit.basis.n );
   if( cos_theta_i_light > cos_epsilon ) {
-    hit_t lighthit = Trace( meshes, meshes_len, hit.x_world, wi_light, t_min_world / MAX( t_min_world, cos_theta_i_light ) );
+    hit_t lighthit = Trace( scene, hit.x_world, wi_light, t_min_world / MAX( t_min_world, cos_theta_i_light ) );
     if( Valid( lighthit ) ) {
       auto brdf = reflectance * f32_PI_REC * cos_theta_o;
       direct_radiance_light = ( brdf * RadianceEmit( lighthit ) );
@@ -3070,7 +4231,7 @@ DirectRadiance_1_0m(
   auto rec_wi_brdf_pdf = f32_PI / Dot( wi_brdf, hit.basis.n );
   AssertCrash( isfinite( rec_wi_brdf_pdf ) );
   auto cos_theta_i_brdf = Dot( wi_brdf, hit.basis.n );
-  hit_t brdfhit = Trace( meshes, meshes_len, hit.x_world, wi_brdf, t_min_world / MAX( t_min_world, cos_theta_i_brdf ) );
+  hit_t brdfhit = Trace( scene, hit.x_world, wi_brdf, t_min_world / MAX( t_min_world, cos_theta_i_brdf ) );
   if( Valid( brdfhit ) ) {
     auto brdf = reflectance * f32_PI_REC * cos_theta_o;
     direct_radiance_brdf = ( brdf * RadianceEmit( brdfhit ) );
@@ -3094,8 +4255,7 @@ DirectRadiance_1_0m(
 
 Inl vec3<f32>
 IndirectRadiance_1_0m(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   hit_t& hit,
@@ -3119,8 +4279,7 @@ IndirectRadiance_1_0m(
     auto brdf = reflectance * f32_PI_REC * Dot( wr, hit.basis.n );
 
     auto radiance_in = Radiance_1_0m(
-      meshes,
-      meshes_len,
+      scene,
       lights,
       lights_len,
       hit.x_world,
@@ -3137,8 +4296,7 @@ IndirectRadiance_1_0m(
 
 Inl vec3<f32>
 ReflectedRadiance_1_0m(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   hit_t& hit,
@@ -3147,9 +4305,9 @@ ReflectedRadiance_1_0m(
   f32 t_min_world
   )
 {
-  auto radiance_direct = DirectRadiance_1_0m( meshes, meshes_len, lights, lights_len, hit, wr, rng, t_min_world );
+  auto radiance_direct = DirectRadiance_1_0m( scene, lights, lights_len, hit, wr, rng, t_min_world );
   //auto radiance_direct = _vec3( 0.0f );
-  auto radiance_indirect = IndirectRadiance_1_0m( meshes, meshes_len, lights, lights_len, hit, wr, rng, t_min_world );
+  auto radiance_indirect = IndirectRadiance_1_0m( scene, lights, lights_len, hit, wr, rng, t_min_world );
   //auto radiance_indirect = _vec3( 0.0f );
 
   auto res = radiance_direct + radiance_indirect;
@@ -3172,8 +4330,7 @@ ReflectedRadiance_1_0m(
 
 Inl vec3<f32>
 ReflectedRadiance_1_1(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   hit_t& hit,
@@ -3218,7 +4375,7 @@ ReflectedRadiance_1_1(
   auto rec_cos_thetaprime = 1 / cos_thetaprime;
   auto cos_theta_i_light = Dot( wi_light, hit.basis.n );
   if( cos_theta_i_light > cos_epsilon ) {
-    hit_t lighthit = Trace( meshes, meshes_len, hit.x_world, wi_light, t_min_world / MAX( t_min_world, cos_theta_i_light ) );
+    hit_t lighthit = Trace( scene, hit.x_world, wi_light, t_min_world / MAX( t_min_world, cos_theta_i_light ) );
     if( Valid( lighthit ) ) {
       radiance_direct_light = ( brdf * RadianceEmit( lighthit ) );
     }
@@ -3232,8 +4389,7 @@ ReflectedRadiance_1_1(
   AssertCrash( isfinite( rec_wi_brdf_pdf ) );
   auto cos_theta_i_brdf = Dot( wi_brdf, hit.basis.n );
   hit_t brdfhit = Trace(
-    meshes,
-    meshes_len,
+    scene,
     hit.x_world,
     wi_brdf,
     t_min_world / MAX( t_min_world, cos_theta_i_brdf )
@@ -3272,8 +4428,7 @@ ReflectedRadiance_1_1(
     vec3<f32> radiance_refl;
     if( Valid( brdfhit ) ) {
       radiance_refl = ReflectedRadiance_1_1(
-        meshes,
-        meshes_len,
+        scene,
         lights,
         lights_len,
         brdfhit,
@@ -3293,8 +4448,7 @@ ReflectedRadiance_1_1(
 
 Inl vec3<f32>
 Radiance_1_1(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   vec3<f32>& x,
@@ -3303,7 +4457,7 @@ Radiance_1_1(
   f32 t_min_world
   )
 {
-  hit_t hit = Trace( meshes, meshes_len, x, w, t_min_world );
+  hit_t hit = Trace( scene, x, w, t_min_world );
   if( Invalid( hit ) ) {
     return bkgd_radiance_emit;
   }
@@ -3314,8 +4468,7 @@ Radiance_1_1(
   }
 
   auto radiance_refl = ReflectedRadiance_1_1(
-    meshes,
-    meshes_len,
+    scene,
     lights,
     lights_len,
     hit,
@@ -3332,8 +4485,7 @@ Radiance_1_1(
 
 Inl vec3<f32>
 PathTrace(
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
+  rtscene_t& scene,
   rtmesh_t* lights[],
   idx_t lights_len,
   vec3<f32>& x,
@@ -3342,7 +4494,7 @@ PathTrace(
   f32 t_min_world
   )
 {
-  hit_t hit = Trace( meshes, meshes_len, x, v, t_min_world );
+  hit_t hit = Trace( scene, x, v, t_min_world );
   if( Invalid( hit ) ) {
     return bkgd_radiance_emit;
   }
@@ -3374,8 +4526,7 @@ PathTrace(
   }
 
   auto radiance_i = PathTrace(
-    meshes,
-    meshes_len,
+    scene,
     lights,
     lights_len,
     hit.x_world,
@@ -3393,133 +4544,347 @@ PathTrace(
 
 
 
-void
-Raytrace(
-  img_t& target_img,
-  rng_t& rng,
-  u32 samples_per_pixel,
-  vec3<f32>& translate_world_from_camera,
-  mat3x3r<f32>& rotation_world_from_camera,
-  f32 camera_half_x,
-  f32 camera_half_y,
-  f32 camera_near_z,
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
-  rtmesh_t* lights[],
-  idx_t lights_len
+// ============================================================================
+// TILED RENDERING
+//
+// Raytrace and Metropolis split the image into tiles, and render the tiles on the task threads.
+// Tiles are handed out through an atomic counter, so threads that finish early just grab more tiles.
+// The calling thread grabs tiles too, and then waits for the task threads to drain.
+//
+// Every tile gets its own rng stream, seeded from ( seed, pass, tile index ), and only writes its own pixels.
+// So the output for a given seed is identical no matter how many threads render it, or in what order.
+//
+// Raytrace accumulates into rttiles_t.accum over successive passes, so the caller can show a converging image;
+// call Reset when the camera or scene changes.
+//
+
+constant u32 c_rttile_x = 16;
+constant u32 c_rttile_y = 16;
+
+struct
+rttiles_t
+{
+  img_t accum; // f32x4 sum of each pass's per-pixel radiance.
+  u32 num_passes;
+  u64 seed;
+  u32 num_tiles_x;
+  u32 num_tiles_y;
+  u32 num_tiles;
+  stack_resizeable_cont_t<f64> tile_brightness; // per-tile sums, so the image mean is independent of scheduling.
+};
+
+Inl void
+Init( rttiles_t& tiles, u32 x, u32 y, u64 seed )
+{
+  Init( tiles.accum, x, y, x, 16 );
+  Alloc( tiles.accum );
+  tiles.num_passes = 0;
+  tiles.seed = seed;
+  tiles.num_tiles_x = ( x + c_rttile_x - 1 ) / c_rttile_x;
+  tiles.num_tiles_y = ( y + c_rttile_y - 1 ) / c_rttile_y;
+  tiles.num_tiles = tiles.num_tiles_x * tiles.num_tiles_y;
+  Alloc( tiles.tile_brightness, tiles.num_tiles );
+  tiles.tile_brightness.len = tiles.num_tiles;
+  Zero( tiles.accum );
+}
+
+Inl void
+Kill( rttiles_t& tiles )
+{
+  Free( tiles.tile_brightness );
+  Free( tiles.accum );
+  tiles = {};
+}
+
+// Throws away the accumulated passes.
+Inl void
+Reset( rttiles_t& tiles )
+{
+  tiles.num_passes = 0;
+  Zero( tiles.accum );
+}
+
+// splitmix64 finalizer, to decorrelate the per-tile streams.
+// xorshift32 has a fixed point at 0, so we avoid that seed.
+Inl u64
+SeedFromTile( u64 seed, u32 pass, u32 tile_idx )
+{
+  u64 z = seed + 0x9E3779B97F4A7C15ULL * ( 1 + ( ( Cast( u64, pass ) << 32 ) | tile_idx ) );
+  z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+  z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+  z = z ^ ( z >> 31 );
+  z = Cast( u32, z )  ?  z  :  1;
+  return z;
+}
+
+#define __RtTile( name )    \
+  void ( name )( \
+    void* misc, \
+    u32 tile_idx, \
+    u32 x0, \
+    u32 y0, \
+    u32 x1, \
+    u32 y1 \
+    ) \
+
+typedef __RtTile( *pfn_rttile_t );
+
+struct
+rttilejob_t
+{
+  pfn_rttile_t FnTile;
+  void* misc;
+  u32 num_tiles_x;
+  u32 img_x;
+  u32 img_y;
+};
+
+__ParallelForBody( ParallelFor_RtTile )
+{
+  auto& job = *Cast( rttilejob_t*, misc );
+  auto tile_x = Cast( u32, k % job.num_tiles_x );
+  auto tile_y = Cast( u32, k / job.num_tiles_x );
+  auto x0 = tile_x * c_rttile_x;
+  auto y0 = tile_y * c_rttile_y;
+  auto x1 = MIN( x0 + c_rttile_x, job.img_x );
+  auto y1 = MIN( y0 + c_rttile_y, job.img_y );
+  job.FnTile( job.misc, Cast( u32, k ), x0, y0, x1, y1 );
+}
+
+// Blocks until every tile is rendered.
+// num_workers includes the calling thread, and is clamped to the number of task threads available.
+Inl void
+RunTiles(
+  pfn_rttile_t FnTile,
+  void* misc,
+  u32 img_x,
+  u32 img_y,
+  idx_t num_workers
   )
 {
   ProfFunc();
 
-  AssertCrash( camera_half_x > 0 );
-  AssertCrash( camera_half_y > 0 );
-  AssertCrash( camera_near_z > 0 );
-
-  u32 supersample_x = Round_u32_from_f32( qsqrt32( Cast( f32, samples_per_pixel ) ) );
-  u32 supersample_y = supersample_x;
+  rttilejob_t job;
+  job.FnTile = FnTile;
+  job.misc = misc;
+  job.num_tiles_x = ( img_x + c_rttile_x - 1 ) / c_rttile_x;
+  job.img_x = img_x;
+  job.img_y = img_y;
+  auto num_tiles = job.num_tiles_x * ( ( img_y + c_rttile_y - 1 ) / c_rttile_y );
+  ParallelFor( ParallelFor_RtTile, &job, num_tiles, num_workers );
+}
 
-  idx_t brightness_count = 0;
-  f32 mean_brightness = 0;
+Inl void
+TonemapRaytrace( vec4<f32>& dst )
+{
+#if 0
+  auto lumin = PerceivedBrightness( _vec3( dst.x, dst.y, dst.z ) );
+  auto lumin_fac = 2.0f / ( 1.0f + lumin );
+  dst.x = CLAMP( dst.x * lumin_fac, 0, 1 );
+  dst.y = CLAMP( dst.y * lumin_fac, 0, 1 );
+  dst.z = CLAMP( dst.z * lumin_fac, 0, 1 );
+#else
+  dst.x = CLAMP( dst.x, 0, 1 );
+  dst.y = CLAMP( dst.y, 0, 1 );
+  dst.z = CLAMP( dst.z, 0, 1 );
+#endif
 
-  Fori( u32, y, 0, target_img.y ) {
-  Fori( u32, x, 0, target_img.x ) {
-    auto& dst = LookupAs( vec4<f32>, target_img, x, y );
+  static const f32 expon = 1 / 2.2f;
+  dst.x = Pow32( dst.x, expon );
+  dst.y = Pow32( dst.y, expon );
+  dst.z = Pow32( dst.z, expon );
 
-    Prof( raytrace_perpixel );
+  dst.w = 1;
+}
 
-    vec3<f32> supersample_dst = {};
-    u32 supersample_count = 0;
+struct
+raytrace_t
+{
+  img_t* target_img;
+  rttiles_t* tiles;
+  u32 samples_per_pixel;
+  vec3<f32> translate_world_from_camera;
+  mat3x3r<f32> rotation_world_from_camera;
+  f32 camera_half_x;
+  f32 camera_half_y;
+  f32 camera_near_z;
+  rtscene_t* scene;
+  rtmesh_t** lights;
+  idx_t lights_len;
+  rendermode_t rendermode;
+};
 
-    Fori( u32, j, 0, supersample_y ) {
-    Fori( u32, i, 0, supersample_x ) {
+__RtTile( RaytraceTile )
+{
+  ProfFunc();
 
-      Prof( raytrace_persubpixel );
+  auto& rt = *Cast( raytrace_t*, misc );
+  auto& target_img = *rt.target_img;
+  auto& tiles = *rt.tiles;
+  auto& scene = *rt.scene;
+  auto lights = rt.lights;
+  auto lights_len = rt.lights_len;
+  auto camera_half_x = rt.camera_half_x;
+  auto camera_half_y = rt.camera_half_y;
+  auto camera_near_z = rt.camera_near_z;
+  auto& translate_world_from_camera = rt.translate_world_from_camera;
+  auto& rotation_world_from_camera = rt.rotation_world_from_camera;
+  auto rendermode = rt.rendermode;
+
+  rng_t rng;
+  Init( rng, SeedFromTile( tiles.seed, tiles.num_passes, tile_idx ) );
+
+  u32 supersample_x = Round_u32_from_f32( qsqrt32( Cast( f32, rt.samples_per_pixel ) ) );
+  u32 supersample_y = supersample_x;
 
-      f32 ox = ( i + 0.5f ) / supersample_x - 0.5f;
-      f32 oy = ( j + 0.5f ) / supersample_y - 0.5f;
+  f64 brightness = 0;
+  auto rec_num_passes = 1.0f / ( tiles.num_passes + 1 );
 
-      f32 cx = ( x + ox ) / target_img.x;
-      f32 cy = ( y + oy ) / target_img.y;
+  Fori( u32, y, y0, y1 ) {
+  Fori( u32, x, x0, x1 ) {
+    Prof( raytrace_perpixel );
 
-      auto ray_p_cam = _vec3<f32>( 0 );
-      auto ray_d_cam = _vec3<f32>(
-        ( 2 * cx - 1 ) * camera_half_x,
-        ( 2 * cy - 1 ) * camera_half_y,
-        -camera_near_z
-        );
+    vec3<f32> supersample_dst = {};
+    u32 supersample_count = 0;
 
-      // Move ray_p to the image plane in world space.
-      vec3<f32> ray_d;
-      Mul( &ray_d, rotation_world_from_camera, ray_d_cam );
-      auto ray_p = translate_world_from_camera + ray_p_cam + ray_d;
-      ray_d = Normalize( ray_d );
+    constant f32 t_min_world = 1e-3f;
 
+    // Subpixels are generated and traced in groups of 4, so ray_packet mode can trace them as one packet,
+    // and their first bounce shadow rays as a second packet. The indirect bounces stay scalar.
+    u32 num_subpixels = supersample_x * supersample_y;
+    for( u32 s = 0;  s < num_subpixels;  s += 4 ) {
 
-      constant f32 t_min_world = 1e-3f;
+      Prof( raytrace_persubpixel );
 
-//      auto radiance = Radiance_0_75( meshes, meshes_len, ray_p, ray_d, rng, t_min_world );
-      auto radiance = Radiance_1_0( meshes, meshes_len, lights, lights_len, ray_p, ray_d, rng, t_min_world );
-//      auto radiance = Radiance_1_0m( meshes, meshes_len, lights, lights_len, ray_p, ray_d, rng, t_min_world );
-//      auto radiance = Radiance_1_1( meshes, meshes_len, lights, lights_len, ray_p, ray_d, rng, t_min_world );
-//      auto radiance = PathTrace( meshes, meshes_len, lights, lights_len, ray_p, ray_d, rng, t_min_world );
+      vec3<f32> ray_ps[4];
+      vec3<f32> ray_ds[4];
+      bool actives[4];
+      u32 lanes = MIN( 4, num_subpixels - s );
+      Fori( u32, lane, 0, 4 ) {
+        // Pad out the last packet by repeating the first ray; those lanes are inactive.
+        auto subpixel = ( lane < lanes )  ?  s + lane  :  s;
+        actives[lane] = ( lane < lanes );
+
+        u32 i = subpixel % supersample_x;
+        u32 j = subpixel / supersample_x;
+
+        f32 ox = ( i + 0.5f ) / supersample_x - 0.5f;
+        f32 oy = ( j + 0.5f ) / supersample_y - 0.5f;
+
+        f32 cx = ( x + ox ) / target_img.x;
+        f32 cy = ( y + oy ) / target_img.y;
+
+        auto ray_p_cam = _vec3<f32>( 0 );
+        auto ray_d_cam = _vec3<f32>(
+          ( 2 * cx - 1 ) * camera_half_x,
+          ( 2 * cy - 1 ) * camera_half_y,
+          -camera_near_z
+          );
+
+        // Move ray_p to the image plane in world space.
+        vec3<f32> ray_d;
+        Mul( &ray_d, rotation_world_from_camera, ray_d_cam );
+        ray_ps[lane] = translate_world_from_camera + ray_p_cam + ray_d;
+        ray_ds[lane] = Normalize( ray_d );
+      }
 
-      supersample_dst += radiance;
-      supersample_count += 1;
+      auto packet = ( rendermode == rendermode_t::ray_packet );
+      hit_t hits[4];
+      if( packet ) {
+        TracePacket( hits, scene, ray_ps, ray_ds, actives, t_min_world );
+      } else {
+        Fori( u32, lane, 0, lanes ) {
+          hits[lane] = Trace( scene, ray_ps[lane], ray_ds[lane], t_min_world );
+        }
+      }
+      vec3<f32> radiances[4];
+      RadianceFromHits_1_0( radiances, scene, lights, lights_len, hits, ray_ds, lanes, rng, t_min_world, packet );
+      Fori( u32, lane, 0, lanes ) {
+        supersample_dst += radiances[lane];
+        supersample_count += 1;
+      }
 
       ProfClose( raytrace_persubpixel );
     }
-    }
 
     if( supersample_count ) {
       supersample_dst *= ( 1.0f / supersample_count );
     }
 
-    dst.x = supersample_dst.x;
-    dst.y = supersample_dst.y;
-    dst.z = supersample_dst.z;
+    auto& sum = LookupAs( vec4<f32>, tiles.accum, x, y );
+    sum.x += supersample_dst.x;
+    sum.y += supersample_dst.y;
+    sum.z += supersample_dst.z;
+    sum.w = 1;
+
+    auto& dst = LookupAs( vec4<f32>, target_img, x, y );
+    dst.x = sum.x * rec_num_passes;
+    dst.y = sum.y * rec_num_passes;
+    dst.z = sum.z * rec_num_passes;
     dst.w = 1;
 
-    auto lumin = PerceivedBrightness( _vec3( dst.x, dst.y, dst.z ) );
-    brightness_count += 1;
-    auto new_mean = mean_brightness + ( lumin - mean_brightness ) / brightness_count;
-    mean_brightness = new_mean;
+    brightness += PerceivedBrightness( _vec3( dst.x, dst.y, dst.z ) );
+
+    TonemapRaytrace( dst );
 
     ProfClose( raytrace_perpixel );
   }
   }
 
-  Log( "mean_brightness: %f", mean_brightness );
-
-  if( mean_brightness > 0 ) {
-    Fori( u32, y, 0, target_img.y ) {
-    Fori( u32, x, 0, target_img.x ) {
-      auto& dst = LookupAs( vec4<f32>, target_img, x, y );
-
-#if 0
-      auto lumin = PerceivedBrightness( _vec3( dst.x, dst.y, dst.z ) );
-      auto lumin_fac = 2.0f / ( 1.0f + lumin );
-      dst.x = CLAMP( dst.x * lumin_fac, 0, 1 );
-      dst.y = CLAMP( dst.y * lumin_fac, 0, 1 );
-      dst.z = CLAMP( dst.z * lumin_fac, 0, 1 );
-#elif 0
-      dst.x = CLAMP( 2.0f * dst.x / mean_brightness, 0, 1 );
-      dst.y = CLAMP( 2.0f * dst.y / mean_brightness, 0, 1 );
-      dst.z = CLAMP( 2.0f * dst.z / mean_brightness, 0, 1 );
-#else
-      dst.x = CLAMP( dst.x, 0, 1 );
-      dst.y = CLAMP( dst.y, 0, 1 );
-      dst.z = CLAMP( dst.z, 0, 1 );
-#endif
+  tiles.tile_brightness.mem[tile_idx] = brightness;
+}
 
-      static const f32 expon = 1 / 2.2f;
-      dst.x = Pow32( dst.x, expon );
-      dst.y = Pow32( dst.y, expon );
-      dst.z = Pow32( dst.z, expon );
+// Adds one pass of samples_per_pixel samples into tiles.accum, and writes the tonemapped running mean to target_img.
+void
+Raytrace(
+  img_t& target_img,
+  rttiles_t& tiles,
+  u32 samples_per_pixel,
+  vec3<f32>& translate_world_from_camera,
+  mat3x3r<f32>& rotation_world_from_camera,
+  f32 camera_half_x,
+  f32 camera_half_y,
+  f32 camera_near_z,
+  rtscene_t& scene,
+  rtmesh_t* lights[],
+  idx_t lights_len,
+  rendermode_t rendermode, // ray or ray_packet.
+  idx_t num_workers = MAX_idx
+  )
+{
+  ProfFunc();
 
-      dst.w = 1;
-    }
-    }
+  AssertCrash( rendermode == rendermode_t::ray  ||  rendermode == rendermode_t::ray_packet );
+  AssertCrash( camera_half_x > 0 );
+  AssertCrash( camera_half_y > 0 );
+  AssertCrash( camera_near_z > 0 );
+  AssertCrash( tiles.accum.x == target_img.x );
+  AssertCrash( tiles.accum.y == target_img.y );
+
+  raytrace_t rt;
+  rt.target_img = &target_img;
+  rt.tiles = &tiles;
+  rt.samples_per_pixel = samples_per_pixel;
+  rt.translate_world_from_camera = translate_world_from_camera;
+  rt.rotation_world_from_camera = rotation_world_from_camera;
+  rt.camera_half_x = camera_half_x;
+  rt.camera_half_y = camera_half_y;
+  rt.camera_near_z = camera_near_z;
+  rt.scene = &scene;
+  rt.lights = lights;
+  rt.lights_len = lights_len;
+  rt.rendermode = rendermode;
+
+  RunTiles( RaytraceTile, &rt, target_img.x, target_img.y, num_workers );
+
+  tiles.num_passes += 1;
+
+  f64 brightness = 0;
+  ForLen( i, tiles.tile_brightness ) {
+    brightness += tiles.tile_brightness.mem[i];
   }
+  auto mean_brightness = brightness / MAX( 1, target_img.x * target_img.y );
+  Log( "mean_brightness: %f, passes: %u", mean_brightness, tiles.num_passes );
 }
 
 
@@ -3577,36 +4942,46 @@ Kill( path_t& path )
 
 
 
-void
-Metropolis(
-  img_t& target_img,
-  rng_t& rng,
-  vec3<f32>& translate_world_from_camera,
-  mat3x3r<f32>& rotation_world_from_camera,
-  f32 camera_half_x,
-  f32 camera_half_y,
-  f32 camera_near_z,
-  rtmesh_t* meshes[],
-  idx_t meshes_len,
-  rtmesh_t* lights[],
-  idx_t lights_len
-  )
+struct
+metropolis_t
+{
+  img_t* target_img;
+  u64 seed;
+  vec3<f32> translate_world_from_camera;
+  mat3x3r<f32> rotation_world_from_camera;
+  f32 camera_half_x;
+  f32 camera_half_y;
+  f32 camera_near_z;
+  rtscene_t* scene;
+  rtmesh_t** lights;
+  idx_t lights_len;
+};
+
+// Initial paths are seeded per tile, from the tile's own rng stream, so the chains don't depend on scheduling.
+constant idx_t c_metropolis_paths_per_tile = 16;
+
+__RtTile( MetropolisTile )
 {
   ProfFunc();
 
-  AssertCrash( camera_half_x > 0 );
-  AssertCrash( camera_half_y > 0 );
-  AssertCrash( camera_near_z > 0 );
+  auto& mp = *Cast( metropolis_t*, misc );
+  auto& target_img = *mp.target_img;
+  auto& scene = *mp.scene;
 
   static const auto t_min_world = 1e-3f;
 
+  rng_t rng;
+  Init( rng, SeedFromTile( mp.seed, 0, tile_idx ) );
+
+  auto uv0 = _vec2<f32>( Cast( f32, x0 ) / target_img.x, Cast( f32, y0 ) / target_img.y );
+  auto uv_extent = _vec2<f32>( Cast( f32, x1 - x0 ) / target_img.x, Cast( f32, y1 - y0 ) / target_img.y );
+
   // Initial path
-  static const idx_t npaths = 1024;
-  path_t paths[npaths];
-  For( i, 0, npaths ) {
+  path_t paths[c_metropolis_paths_per_tile];
+  For( i, 0, c_metropolis_paths_per_tile ) {
     path_t& path = paths[i];
 
-    path.eye_uv = _vec2( Zeta32( rng ), Zeta32( rng ) );
+    path.eye_uv = uv0 + uv_extent * _vec2( Zeta32( rng ), Zeta32( rng ) );
     path.eye_px = _vec2(
       Cast( u32, 0.5f + path.eye_uv.x * target_img.x_m1 ),
       Cast( u32, 0.5f + path.eye_uv.y * target_img.y_m1 )
@@ -3615,20 +4990,20 @@ Metropolis(
     {
       auto ray_p_cam = _vec3<f32>( 0 );
       auto ray_d_cam = _vec3<f32>(
-        ( 2 * path.eye_uv.x - 1 ) * camera_half_x,
-        ( 2 * path.eye_uv.y - 1 ) * camera_half_y,
-        -camera_near_z
+        ( 2 * path.eye_uv.x - 1 ) * mp.camera_half_x,
+        ( 2 * path.eye_uv.y - 1 ) * mp.camera_half_y,
+        -mp.camera_near_z
         );
       vec3<f32> ray_d;
-      Mul( &ray_d, rotation_world_from_camera, ray_d_cam );
-      auto ray_p = translate_world_from_camera + ray_p_cam + ray_d;
+      Mul( &ray_d, mp.rotation_world_from_camera, ray_d_cam );
+      auto ray_p = mp.translate_world_from_camera + ray_p_cam + ray_d;
       ray_d = Normalize( ray_d );
 
       path.eye_ray_p = ray_p;
       path.eye_ray_d = ray_d;
     }
 
-    auto hit = Trace( meshes, meshes_len, path.eye_ray_p, path.eye_ray_d, t_min_world );
+    auto hit = Trace( scene, path.eye_ray_p, path.eye_ray_d, t_min_world );
     if( Invalid( hit ) ) {
       path.radiance = bkgd_radiance_emit;
       continue;
@@ -3644,8 +5019,8 @@ Metropolis(
 //  }
 
 
-  Fori( u32, y, 0, target_img.y ) {
-  Fori( u32, x, 0, target_img.x ) {
+  Fori( u32, y, y0, y1 ) {
+  Fori( u32, x, x0, x1 ) {
     auto& dst = LookupAs( vec4<f32>, target_img, x, y );
     auto& dst3 = *Cast( vec3<f32>*, &dst );
 
@@ -3667,6 +5042,42 @@ Metropolis(
   }
 }
 
+void
+Metropolis(
+  img_t& target_img,
+  u64 seed,
+  vec3<f32>& translate_world_from_camera,
+  mat3x3r<f32>& rotation_world_from_camera,
+  f32 camera_half_x,
+  f32 camera_half_y,
+  f32 camera_near_z,
+  rtscene_t& scene,
+  rtmesh_t* lights[],
+  idx_t lights_len,
+  idx_t num_workers = MAX_idx
+  )
+{
+  ProfFunc();
+
+  AssertCrash( camera_half_x > 0 );
+  AssertCrash( camera_half_y > 0 );
+  AssertCrash( camera_near_z > 0 );
+
+  metropolis_t mp;
+  mp.target_img = &target_img;
+  mp.seed = seed;
+  mp.translate_world_from_camera = translate_world_from_camera;
+  mp.rotation_world_from_camera = rotation_world_from_camera;
+  mp.camera_half_x = camera_half_x;
+  mp.camera_half_y = camera_half_y;
+  mp.camera_near_z = camera_near_z;
+  mp.scene = &scene;
+  mp.lights = lights;
+  mp.lights_len = lights_len;
+
+  RunTiles( MetropolisTile, &mp, target_img.x, target_img.y, num_workers );
+}
+
 
 static img_t checker_tex;
 static img_t white_tex;
@@ -3694,6 +5105,8 @@ static rtmesh_t* rtmeshes[] = {
   };
 static idx_t rtmeshes_len = _countof( rtmeshes );
 
+static rtscene_t rtscene;
+
 
 void
 InitScene()
@@ -4120,5 +5533,6 @@ InitScene()
   rtmesh_cone.surface_area_model = f32_2PI * rtmesh_cone.cones.mem[0].r2 * ( Square( rtmesh_cone.cones.mem[0].extent_neg ) + Square( rtmesh_cone.cones.mem[0].extent_neg ) );
   rtmesh_cone.radiance_emit = _vec3( 0.0f );
 
-}
 
+  Init( rtscene, rtmeshes, rtmeshes_len );
+}
@@ -207,6 +207,59 @@ CountNewlines(
 #endif
 }
 
+// a crlf counts once as crlf, never as a cr plus an lf.
+struct
+eolcounts_t
+{
+  idx_t num_cr;
+  idx_t num_lf;
+  idx_t num_crlf;
+};
+
+Inl void
+CountEols(
+  eolcounts_t* counts,
+  u8* src,
+  idx_t src_len
+  )
+{
+  idx_t total_cr = 0;
+  idx_t total_lf = 0;
+  idx_t num_crlf = 0;
+  idx_t idx = 0;
+#if STRINGSEARCH_SIMD
+  // every crlf shows up once in each total, so we just count the pairs and subtract them out at the end.
+  // note the +1, since we look at the following byte to find the pairs.
+  auto cr = StrvecSet( '\r' );
+  auto lf = StrvecSet( '\n' );
+  while( idx + c_stringsearch_width + 1 <= src_len ) {
+    auto v = StrvecLoad( src + idx );
+    auto mask_cr = StrvecEqualMask( v, cr );
+    auto mask_lf = StrvecEqualMask( v, lf );
+    auto mask_lf_next = StrvecEqualMask( StrvecLoad( src + idx + 1 ), lf );
+    total_cr += _mm_popcnt_u32( mask_cr );
+    total_lf += _mm_popcnt_u32( mask_lf );
+    num_crlf += _mm_popcnt_u32( mask_cr & mask_lf_next );
+    idx += c_stringsearch_width;
+  }
+#endif
+  for( ;  idx < src_len;  ++idx ) {
+    auto c = src[idx];
+    if( c == '\r' ) {
+      total_cr += 1;
+      if( idx + 1 < src_len  &&  src[idx + 1] == '\n' ) {
+        num_crlf += 1;
+      }
+    }
+    elif( c == '\n' ) {
+      total_lf += 1;
+    }
+  }
+  counts->num_cr = total_cr - num_crlf;
+  counts->num_lf = total_lf - num_crlf;
+  counts->num_crlf = num_crlf;
+}
+
 Inl void
 SplitIntoLines(
   stack_resizeable_cont_t<slice32_t>* lines,
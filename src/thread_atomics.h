@@ -1,28 +1,39 @@
 // Copyright (c) John A. Carlos Jr., all rights reserved.
 
-#ifdef MAC
+#if defined(MAC)  &&  !( defined(__x86_64__) || defined(__i386__) )
   #define _mm_pause() /*nothing*/
 #endif
 
-void _ReadWriteBarrier();
+#ifndef MAC
+  void _ReadWriteBarrier();
+#endif
 
 #ifdef MAC
-  u32 InterlockedIncrement( volatile u32* x )
+  // note these are the gcc/clang __atomic builtins, so this works for both the clang mac and the gcc linux builds.
+  Inl u32 InterlockedIncrement( volatile u32* x )
   {
-    return __c11_atomic_fetch_add( Cast( _Atomic u32*, x ), 1u, Cast( int, std::memory_order_seq_cst ) ) + 1u;
+    return __atomic_add_fetch( x, 1u, __ATOMIC_SEQ_CST );
   }
-  u64 InterlockedIncrement( volatile u64* x )
+  Inl u64 InterlockedIncrement( volatile u64* x )
   {
-    return __c11_atomic_fetch_add( Cast( _Atomic u32*, x ), 1u, Cast( int, std::memory_order_seq_cst ) ) + 1u;
+    return __atomic_add_fetch( x, 1ull, __ATOMIC_SEQ_CST );
   }
-  
-  bool CAS( volatile u32* dst, u32 compare, u32 exchange )
+  Inl u32 InterlockedDecrement( volatile u32* x )
   {
-    return __c11_atomic_compare_exchange_strong( Cast( _Atomic u32*, dst ), &compare, exchange, Cast( int, std::memory_order_seq_cst ), Cast( int, std::memory_order_seq_cst ) );
+    return __atomic_sub_fetch( x, 1u, __ATOMIC_SEQ_CST );
   }
-  bool CAS( volatile u64* dst, u64 compare, u64 exchange )
+  Inl u64 InterlockedDecrement( volatile u64* x )
+  {
+    return __atomic_sub_fetch( x, 1ull, __ATOMIC_SEQ_CST );
+  }
+
+  Inl bool CAS( volatile u32* dst, u32 compare, u32 exchange )
   {
-    return __c11_atomic_compare_exchange_strong( Cast( _Atomic u64*, dst ), &compare, exchange, Cast( int, std::memory_order_seq_cst ), Cast( int, std::memory_order_seq_cst ) );
+    return __atomic_compare_exchange_n( dst, &compare, exchange, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+  }
+  Inl bool CAS( volatile u64* dst, u64 compare, u64 exchange )
+  {
+    return __atomic_compare_exchange_n( dst, &compare, exchange, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
   }
 #else
 
@@ -31,6 +42,32 @@ void _ReadWriteBarrier();
 
 #endif
 
+// full hardware fence, for store->load ordering.
+// _ReadWriteBarrier on windows only stops the compiler from reordering, which isn't enough for that.
+#ifdef MAC
+  #define MemoryFence()   __atomic_thread_fence( __ATOMIC_SEQ_CST )
+#else
+  #define MemoryFence()   MemoryBarrier()
+#endif
+
+// single-writer publish: everything written before the StoreRelease is visible to a reader that sees the
+// new value through LoadAcquire.
+// x64 windows is already ordered that way, so we only have to keep the compiler from reordering.
+#ifdef MAC
+  #define StoreRelease( dst, value )   __atomic_store_n( dst, value, __ATOMIC_RELEASE )
+  #define LoadAcquire( src )   __atomic_load_n( src, __ATOMIC_ACQUIRE )
+#else
+  #define StoreRelease( dst, value )   do { _ReadWriteBarrier(); *( dst ) = ( value ); } while( 0 )
+  #define LoadAcquire( src )   _LoadAcquire( src )
+  Templ ForceInl T
+  _LoadAcquire( volatile T* src )
+  {
+    T value = *src;
+    _ReadWriteBarrier();
+    return value;
+  }
+#endif
+
 #define GetValueBeforeAtomicInc( dst ) \
   ( InterlockedIncrement( dst ) - 1 )
 
@@ -1,13 +1,34 @@
 // Copyright (c) John A. Carlos Jr., all rights reserved.
 
 
+#if defined(MAC)
+  // the os thread id, cached per thread since the syscall isn't free.
+  Inl u32
+  GetThreadIdPosix()
+  {
+    static thread_local u32 tid = 0;
+    if( !tid ) {
+#if defined(__linux__)
+      tid = Cast( u32, syscall( SYS_gettid ) );
+#elif defined(__APPLE__)
+      u64 tid64 = 0;
+      pthread_threadid_np( 0, &tid64 );
+      tid = Cast( u32, tid64 );
+#else
+      tid = Cast( u32, Cast( idx_t, pthread_self() ) );
+#endif
+    }
+    return tid;
+  }
+#endif
+
 #if _SIZEOF_IDX_T == 4
 
   #if defined(WIN)
     #define GetThreadIdFast() \
       ( *Cast( u32*, Cast( u8*, __readfsdword( 0x18 ) ) + 0x24 ) )
   #elif defined(MAC)
-    #define GetThreadIdFast()   (0)
+    #define GetThreadIdFast()   ( GetThreadIdPosix() )
   #else
     #error Unsupported platform
   #endif
@@ -18,7 +39,7 @@
     #define GetThreadIdFast() \
       ( *Cast( u32*, Cast( u8*, __readgsqword( 0x30 ) ) + 0x48 ) )
   #elif defined(MAC)
-    #define GetThreadIdFast()   (0)
+    #define GetThreadIdFast()   ( GetThreadIdPosix() )
   #else
     #error Unsupported platform
   #endif
@@ -28,6 +49,15 @@
 #endif
 
 
+// a label for the calling thread, for tools like the profiler's trace export. must be a static string.
+thread_local const char* g_thread_name = 0;
+
+Inl void
+ThreadSetName( const char* name )
+{
+  g_thread_name = name;
+}
+
 
 
 // TODO: this is a dumb way of doing TLS.
@@ -255,7 +285,91 @@ Execute(
   CloseHandle( process.hThread );
   return exit;
 #elif defined(MAC)
-  return 0;
+  // we run the command through the shell, the same way cmd.exe parses it on windows.
+  // show_window doesn't mean anything here.
+  // stdout and stderr share one pipe, and stdin is /dev/null so the child never waits on input.
+
+  // both pipe ends are close-on-exec, so children spawned concurrently from other threads don't inherit them.
+  // the child still gets its own copies of the write end via the dup2's below, since dup2 clears that flag.
+  int pipefd[2];
+#if defined(__linux__)
+  int res = pipe2( pipefd, O_CLOEXEC );
+#else
+  int res = pipe( pipefd );
+  if( !res ) {
+    fcntl( pipefd[0], F_SETFD, FD_CLOEXEC );
+    fcntl( pipefd[1], F_SETFD, FD_CLOEXEC );
+  }
+#endif
+  if( res ) {
+    auto err = errno;
+    auto str = SliceFromCStr( "failed to make the stdout pipe!\r\n" );
+    ExecuteOutput( &str, 1, misc0, misc1 );
+    return err;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init( &actions );
+  posix_spawn_file_actions_addopen( &actions, 0, "/dev/null", O_RDONLY, 0 );
+  posix_spawn_file_actions_adddup2( &actions, pipefd[1], 1 );
+  posix_spawn_file_actions_adddup2( &actions, pipefd[1], 2 );
+
+  auto com = AllocCstr( command );
+  char* argv[] = { Cast( char*, "/bin/sh" ), Cast( char*, "-c" ), Cast( char*, com ), 0 };
+  pid_t pid = 0;
+  res = posix_spawn( &pid, "/bin/sh", &actions, 0, argv, environ );
+  posix_spawn_file_actions_destroy( &actions );
+
+  // close the parent's reference to the child-side of the pipe, so our reads see EOF once the child exits.
+  close( pipefd[1] );
+
+  if( res ) {
+    auto str = SliceFromCStr( "failed to create a process with the given command!\r\n" );
+    ExecuteOutput( &str, 1, misc0, misc1 );
+    auto str2 = SliceFromCStr( com );
+    ExecuteOutput( &str2, 1, misc0, misc1 );
+    MemHeapFree( com );
+    close( pipefd[0] );
+    return res;
+  }
+  MemHeapFree( com );
+
+  Forever {
+    u8 pipebuf[4096];
+    auto nread = read( pipefd[0], pipebuf, _countof( pipebuf ) );
+    if( nread < 0  &&  errno == EINTR ) {
+      continue;
+    }
+    if( nread <= 0 ) {
+      break;
+    }
+    slice_t str;
+    str.mem = pipebuf;
+    str.len = Cast( idx_t, nread );
+    ExecuteOutput( &str, 0, misc0, misc1 );
+  }
+
+  // we're done reading from the child's stdout pipe, so close it.
+  close( pipefd[0] );
+
+  // get the process's exit code.
+  int status = 0;
+  while( waitpid( pid, &status, 0 ) < 0 ) {
+    if( errno != EINTR ) {
+      auto err = errno;
+      auto str = SliceFromCStr( "failed to get process exit code!\r\n" );
+      ExecuteOutput( &str, 1, misc0, misc1 );
+      return err;
+    }
+  }
+  if( WIFEXITED( status ) ) {
+    return WEXITSTATUS( status );
+  }
+  // same convention as the shells: killed by signal N exits with 128 + N.
+  if( WIFSIGNALED( status ) ) {
+    return 128 + WTERMSIG( status );
+  }
+  return -1;
 #else
 #error Unsupported platform
 #endif
@@ -286,6 +400,23 @@ PinThreadToOneCore()
   u64 prev_thread_mask = SetThreadAffinityMask( GetCurrentThread(), process_mask );
   AssertWarn( prev_thread_mask );
 #elif defined(MAC)
+#if defined(__linux__)
+  // same choice as windows: keep only the highest cpu that we're allowed to run on.
+  cpu_set_t process_mask;
+  CPU_ZERO( &process_mask );
+  AssertWarn( !sched_getaffinity( 0, sizeof( process_mask ), &process_mask ) );
+  AssertWarn( CPU_COUNT( &process_mask ) );
+  ReverseFor( i, 0, CPU_SETSIZE ) {
+    if( CPU_ISSET( i, &process_mask ) ) {
+      cpu_set_t thread_mask;
+      CPU_ZERO( &thread_mask );
+      CPU_SET( i, &thread_mask );
+      AssertWarn( !sched_setaffinity( 0, sizeof( thread_mask ), &thread_mask ) );
+      break;
+    }
+  }
+#endif
+  // macos doesn't let you pin threads to cores, so do nothing there.
 #else
 #error Unsupported platform
 #endif
@@ -302,6 +433,119 @@ PinThreadToOneCore()
 typedef u32 ( STDCALLWIN *pfn_threadproc_t )( void* misc );
 
 
+#if defined(MAC)
+
+// auto-reset event, with the same semantics as the win32 CreateEvent( 0, 0, 0, 0 ) we use on WIN.
+// a Set wakes at most one Wait, and a Set with nobody waiting is remembered until the next Wait.
+// repeated Sets before a Wait collapse into one, just like SetEvent on an already-signaled event.
+struct
+event_t
+{
+#if defined(__linux__)
+  volatile u32 signaled; // the futex word.
+#else
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  bool signaled;
+#endif
+};
+
+Inl void
+Init( event_t& e )
+{
+  e.signaled = 0;
+#if defined(__linux__)
+#else
+  AssertCrash( !pthread_mutex_init( &e.mutex, 0 ) );
+  AssertCrash( !pthread_cond_init( &e.cond, 0 ) );
+#endif
+}
+
+Inl void
+Kill( event_t& e )
+{
+#if defined(__linux__)
+#else
+  pthread_cond_destroy( &e.cond );
+  pthread_mutex_destroy( &e.mutex );
+#endif
+}
+
+Inl void
+Set( event_t& e )
+{
+#if defined(__linux__)
+  // only the 0 -> 1 transition can have a sleeper to wake, so skip the syscall otherwise.
+  if( !__atomic_exchange_n( &e.signaled, 1u, __ATOMIC_SEQ_CST ) ) {
+    syscall( SYS_futex, &e.signaled, FUTEX_WAKE_PRIVATE, 1, 0, 0, 0 );
+  }
+#else
+  pthread_mutex_lock( &e.mutex );
+  e.signaled = 1;
+  pthread_cond_signal( &e.cond );
+  pthread_mutex_unlock( &e.mutex );
+#endif
+}
+
+Inl void
+Wait( event_t& e )
+{
+#if defined(__linux__)
+  // consume the signal if it's there, otherwise sleep until the word changes from 0.
+  // the kernel rechecks the word before sleeping, so a Set between our exchange and the wait isn't lost.
+  while( !__atomic_exchange_n( &e.signaled, 0u, __ATOMIC_SEQ_CST ) ) {
+    syscall( SYS_futex, &e.signaled, FUTEX_WAIT_PRIVATE, 0, 0, 0, 0 );
+  }
+#else
+  pthread_mutex_lock( &e.mutex );
+  while( !e.signaled ) {
+    pthread_cond_wait( &e.cond, &e.mutex );
+  }
+  e.signaled = 0;
+  pthread_mutex_unlock( &e.mutex );
+#endif
+}
+
+
+struct
+threadstart_t
+{
+  pfn_threadproc_t ThreadProc;
+  void* misc;
+};
+
+Inl void*
+__ThreadStartPosix( void* misc )
+{
+  auto start = *Cast( threadstart_t*, misc );
+  MemHeapFree( Cast( threadstart_t*, misc ) );
+  start.ThreadProc( start.misc );
+  return 0;
+}
+
+// pthreads version of _beginthreadex, so we can keep the windows pfn_threadproc_t signature everywhere.
+Inl pthread_t
+ThreadStart( pfn_threadproc_t ThreadProc, void* misc )
+{
+  auto start = MemHeapAlloc( threadstart_t, 1 );
+  start->ThreadProc = ThreadProc;
+  start->misc = misc;
+  pthread_t thread;
+  auto r = pthread_create( &thread, 0, __ThreadStartPosix, start );
+  AssertCrash( !r );
+  return thread;
+}
+
+Inl void
+ThreadWait( pthread_t thread )
+{
+  auto r = pthread_join( thread, 0 );
+  AssertCrash( !r );
+}
+
+#endif
+
+
 
 //
 // TODO: we don't currently handle full queues very well.
@@ -376,6 +620,9 @@ typedef __AsyncTask( *pfn_asynctask_t );
 
 typedef __MainTaskCompleted( *pfn_maintaskcompleted_t );
 
+struct
+asyncjoin_t;
+
 struct
 asyncqueue_entry_t
 {
@@ -383,6 +630,7 @@ asyncqueue_entry_t
   void* misc0;
   void* misc1;
   u64 time_generated;
+  asyncjoin_t* join; // only set by ForkAsyncTask; PushAsyncTask overwrites it with 0.
 };
 
 struct
@@ -395,15 +643,25 @@ maincompletedqueue_entry_t
   u64 time_generated;
 };
 
+// lets a task wait for the subtasks it forks.
+struct
+asyncjoin_t
+{
+  volatile idx_t num_pending;
+};
 
 
-#define PULLMODEL   1
-
-#if PULLMODEL
-#else
-#endif
 
+Enumc( scheduler_t )
+{
+  // per-taskthread chase-lev deques plus the shared queue from the main thread.
+  // idle taskthreads steal from the others, and each push wakes at most one parked taskthread.
+  workstealing,
 
+  // the old pull model: one shared queue that every taskthread pulls from, and every push wakes every taskthread.
+  // kept around so main_th can benchmark against it.
+  pull,
+};
 
 struct
 taskthread_t
@@ -411,14 +669,16 @@ taskthread_t
 #if defined(WIN)
   HANDLE wake;
 #elif defined(MAC)
+  event_t wake;
 #else
 #error Unsupported platform
 #endif
 
-#if PULLMODEL
-#else
-  mtqueue_srsw_t<asyncqueue_entry_t> input;
-#endif
+  mtdeque_worksteal_t<asyncqueue_entry_t> deque; // only used with scheduler_t::workstealing.
+  volatile u32 parked; // 1 while this thread is sleeping, or about to, with no work. wakers CAS this back to 0.
+  idx_t idx;
+  idx_t steal_cursor;
+
   mtqueue_srsw_t<maincompletedqueue_entry_t> output;
 
   u8 cache_line_padding_to_avoid_thrashing[64]; // last thing, since this type is packed into an stack_resizeable_cont_t
@@ -427,10 +687,14 @@ taskthread_t
 Inl void
 Kill( taskthread_t& t )
 {
-#if PULLMODEL
+#if defined(WIN)
+  CloseHandle( t.wake );
+#elif defined(MAC)
+  Kill( t.wake );
 #else
-  Free( t.input );
+#error Unsupported platform
 #endif
+  Free( t.deque );
   Free( t.output );
 }
 
@@ -442,20 +706,26 @@ mainthread_t
 #if defined(WIN)
   volatile HANDLE wake_asynctaskscompleted;
 #elif defined(MAC)
+  event_t wake_asynctaskscompleted;
 #else
 #error Unsupported platform
 #endif
 
   volatile bool signal_quit;
 
-#if PULLMODEL
+  scheduler_t scheduler;
+
+  // tasks pushed by the main thread, which every taskthread pulls from.
+  // note this is single-writer, so only the main thread can PushAsyncTask; tasks use ForkAsyncTask instead.
   mtqueue_mrsw_t<asyncqueue_entry_t> tasks;
-#else
-#endif
+
+  volatile idx_t num_parked;
+  volatile idx_t wake_cursor;
 
 #if defined(WIN)
   stack_resizeable_cont_t<HANDLE> taskthread_handles; // TODO: stack_nonresizeable_t / buffer_t
 #elif defined(MAC)
+  stack_resizeable_cont_t<pthread_t> taskthread_handles;
 #else
 #error Unsupported platform
 #endif
@@ -467,50 +737,197 @@ static mainthread_t g_mainthread = {};
 
 
 
+Inl void
+WakeTaskThread( taskthread_t* t )
+{
+#if defined(WIN)
+  auto r = SetEvent( t->wake );
+  AssertCrash( r );
+#elif defined(MAC)
+  Set( t->wake );
+#else
+#error Unsupported platform
+#endif
+}
+
+Inl void
+SleepTaskThread( taskthread_t* t )
+{
+#if defined(WIN)
+  DWORD wait = WaitForSingleObject( t->wake, INFINITE );
+  if( wait != WAIT_OBJECT_0 ) {
+    Log( "Task thread failed WaitForSingleObject with %d", wait );
+  }
+#elif defined(MAC)
+  Wait( t->wake );
+#else
+#error Unsupported platform
+#endif
+}
+
+Inl void
+RunAsyncTask( taskthread_t* taskthread, asyncqueue_entry_t* ae )
+{
+#if LOGASYNCTASKS
+  // TODO: make a new prof buffer type to store these waiting times.
+  auto time_waiting = TimeTSC() - ae->time_generated;
+  Log( "asyncqueue_entry_t waited for: %llu", time_waiting );
+#endif
+
+  ae->FnAsyncTask( taskthread, ae->misc0, ae->misc1 );
+
+  if( ae->join ) {
+    InterlockedDecrement( &ae->join->num_pending );
+  }
+}
+
+Inl bool
+StealAsyncTask( taskthread_t* taskthread, asyncqueue_entry_t* ae )
+{
+  // start each round of stealing at a different victim, so idle threads don't all pile onto the same one.
+  auto num_taskthreads = g_mainthread.taskthreads.len;
+  auto start = taskthread->steal_cursor++;
+  For( i, 0, num_taskthreads ) {
+    auto victim = g_mainthread.taskthreads.mem + ( start + i ) % num_taskthreads;
+    if( victim == taskthread  ||  IsEmpty( victim->deque ) ) {
+      continue;
+    }
+    bool success;
+    StealM( victim->deque, ae, &success );
+    if( success ) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// our own deque first, since that's the most recently forked and likely cache-hot work.
+// then the main thread's shared queue, and finally stealing from the other taskthreads.
+Inl bool
+RunOneAsyncTask( taskthread_t* taskthread )
+{
+  asyncqueue_entry_t ae;
+  bool success;
+  PopS( taskthread->deque, &ae, &success );
+  if( !success ) {
+    DequeueM( g_mainthread.tasks, &ae, &success );
+  }
+  if( !success ) {
+    success = StealAsyncTask( taskthread, &ae );
+  }
+  if( !success ) {
+    return 0;
+  }
+  RunAsyncTask( taskthread, &ae );
+  return 1;
+}
+
+// approximate, since other threads may be pushing/stealing concurrently.
+Inl bool
+HasAsyncTasks()
+{
+  if( g_mainthread.tasks.head != g_mainthread.tasks.tail ) {
+    return 1;
+  }
+  FORLEN( t, i, g_mainthread.taskthreads )
+    if( !IsEmpty( t->deque ) ) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// wakes at most one parked taskthread, and doesn't touch the OS at all if every taskthread is already busy.
+// note the caller has already published its task, and the fence orders that before our read of num_parked.
+// ParkTaskThread does the mirror image: it publishes num_parked, fences, then rechecks for tasks.
+// so either we see the parked thread here, or it sees our task before going to sleep.
+Inl void
+WakeOneParkedTaskThread()
+{
+  MemoryFence();
+  if( !g_mainthread.num_parked ) {
+    return;
+  }
+  auto num_taskthreads = g_mainthread.taskthreads.len;
+  idx_t start = g_mainthread.wake_cursor;
+  g_mainthread.wake_cursor = start + 1;
+  For( i, 0, num_taskthreads ) {
+    auto t = g_mainthread.taskthreads.mem + ( start + i ) % num_taskthreads;
+    if( t->parked  &&  CAS( &t->parked, 1, 0 ) ) {
+      InterlockedDecrement( &g_mainthread.num_parked );
+      WakeTaskThread( t );
+      return;
+    }
+  }
+}
+
+Inl void
+ParkTaskThread( taskthread_t* t )
+{
+  t->parked = 1;
+  InterlockedIncrement( &g_mainthread.num_parked );
+  MemoryFence();
+
+  if( g_mainthread.signal_quit  ||  HasAsyncTasks() ) {
+    // if this CAS fails, a waker already claimed us and set our wake event.
+    // that just means our next sleep returns immediately, which is harmless.
+    if( CAS( &t->parked, 1, 0 ) ) {
+      InterlockedDecrement( &g_mainthread.num_parked );
+    }
+    return;
+  }
+
+  SleepTaskThread( t );
+}
+
+
+
 u32 STDCALLWIN
 TaskThread( void* misc )
 {
   ThreadInit();
+  ThreadSetName( "TaskThread" );
 
 #if defined(WIN)
 // Only supported on Win10+.
 //  HRESULT hr = SetThreadDescription( GetCurrentThread(), L"TaskThread" );
 //  AssertWarn( SUCCEEDED( hr ) );
+#elif defined(MAC)
+#if defined(__linux__)
+  pthread_setname_np( pthread_self(), "TaskThread" );
+#endif
+#else
+#error Unsupported platform
+#endif
 
   auto taskthread = Cast( taskthread_t*, misc );
 
-  while( !g_mainthread.signal_quit ) {
-    DWORD wait = WaitForSingleObject( taskthread->wake, INFINITE );
-    if( wait == WAIT_OBJECT_0 ) {
+  switch( g_mainthread.scheduler ) {
+    case scheduler_t::workstealing: {
       while( !g_mainthread.signal_quit ) {
-        bool success;
-        asyncqueue_entry_t ae;
-#if PULLMODEL
-        DequeueM( g_mainthread.tasks, &ae, &success );
-#else
-        DequeueS( taskthread->input, &ae, &success );
-#endif
-        if( !success ) {
-          break;
+        if( !RunOneAsyncTask( taskthread ) ) {
+          ParkTaskThread( taskthread );
         }
+      }
+    } break;
 
-#if LOGASYNCTASKS
-        // TODO: make a new prof buffer type to store these waiting times.
-        auto time_waiting = TimeTSC() - ae.time_generated;
-        Log( "asyncqueue_entry_t waited for: %llu", time_waiting );
-#endif
-
-        ae.FnAsyncTask( taskthread, ae.misc0, ae.misc1 );
+    case scheduler_t::pull: {
+      while( !g_mainthread.signal_quit ) {
+        SleepTaskThread( taskthread );
+        while( !g_mainthread.signal_quit ) {
+          bool success;
+          asyncqueue_entry_t ae;
+          DequeueM( g_mainthread.tasks, &ae, &success );
+          if( !success ) {
+            break;
+          }
+          RunAsyncTask( taskthread, &ae );
+        }
       }
-    }
-    else {
-      Log( "Task thread failed WaitForSingleObject with %d", wait );
-    }
+    } break;
+
+    default: UnreachableCrash();
   }
-#elif defined(MAC)
-#else
-#error Unsupported platform
-#endif
 
   ThreadKill();
   return 0;
@@ -526,10 +943,14 @@ TaskThread( void* misc )
 //   unitialized entries in the queue.
 // since we haven't done that, we do the not-as-optimal convention.
 //
+// main thread only. tasks that want to spawn more tasks should use ForkAsyncTask.
+// taskthreadidx is ignored; both schedulers let the first available taskthread take the task.
+//
 Inl void
 PushAsyncTask( idx_t taskthreadidx, asyncqueue_entry_t* entry )
 {
-#if PULLMODEL
+  entry->join = 0;
+
   // note pushing to a shared taskthread input queue means we don't have to do any choosing.
   // the first thread available to pull this task will do so.
   // that should be a much more efficient scheduling mechanism, letting the task threads feed themselves.
@@ -539,53 +960,160 @@ PushAsyncTask( idx_t taskthreadidx, asyncqueue_entry_t* entry )
     EnqueueS( g_mainthread.tasks, entry, &success );
   }
 
-  //
-  // TODO: we should probably have some more-targeted solution here.
-  // waking every taskthread is likely overkill, we probably only need to wake one thread per task push.
-  // we're likely wasting some time unnecessarily waking threads and having them fall asleep again.
-  //
-  // note this would only be a problem for situations where we're pushing async tasks repeatedly over time.
-  // right now i think all our async tasks are one-shot deals; push N tasks all in a row, and then do other stuff.
-  //
-  // it'd be helpful to know if we have any threads that aren't active, so we could wake those ones.
-  // maybe we set/reset a bool either side of the Wait call in each taskthread?
-  //
-  // note that we kind of need to ensure at least one thread gets woken up.
-  // i probably need to do more reading/testing of SetEvent/WaitFor calls to make sure we're doing this right.
-  //
-#if defined(WIN)
-  FORLEN( t, i, g_mainthread.taskthreads )
-    auto r = SetEvent( t->wake );
-    AssertCrash( r );
+  switch( g_mainthread.scheduler ) {
+    case scheduler_t::workstealing: {
+      WakeOneParkedTaskThread();
+    } break;
+
+    case scheduler_t::pull: {
+      // waking every taskthread is overkill, but that's what this model did.
+      FORLEN( t, i, g_mainthread.taskthreads )
+        WakeTaskThread( t );
+      }
+    } break;
+
+    default: UnreachableCrash();
   }
-#elif defined(MAC)
-#else
-#error Unsupported platform
-#endif
+}
 
-#else
-  AssertCrash( g_mainthread.taskthreads.len );
-  taskthreadidx = taskthreadidx % g_mainthread.taskthreads.len;
-  auto t = g_mainthread.taskthreads.mem + taskthreadidx;
-
-  // TODO: handle t-in-use by some better scheduling.
-  //   probably something like:
-  //   loop:
-  //     first try to schedule the task to an already-running thread.
-  //     then try to schedule the task on the other threads that are likely inactive.
-  //   this is to try to avoid causing OS thread scheduling overheads.
-  //   i'm not seeing any good way to do this with public Win32 functions, unfortunately.
-  //   so we'll do something a little less optimal.
-  //   note we'd have to be careful not to just fill up one thread's queue.
+// taskthread only. pushes a subtask onto this taskthread's own deque, where idle taskthreads can steal it.
+// if join is nonzero, JoinAsyncTasks( taskthread, join ) waits until the subtask has finished.
+// running the subtask immediately is always a valid schedule, so we do that when we can't queue it.
+Inl void
+ForkAsyncTask( taskthread_t* taskthread, asyncjoin_t* join, asyncqueue_entry_t* entry )
+{
+  entry->join = join;
+  if( join ) {
+    InterlockedIncrement( &join->num_pending );
+  }
 
-  bool success = 0;
-  while( !success ) {
-    EnqueueS( t->input, entry, &success );
+  if( g_mainthread.scheduler != scheduler_t::workstealing ) {
+    RunAsyncTask( taskthread, entry );
+    return;
   }
 
-  auto r = SetEvent( t->wake );
-  AssertCrash( r );
-#endif
+  bool success;
+  PushS( taskthread->deque, entry, &success );
+  if( !success ) {
+    RunAsyncTask( taskthread, entry );
+    return;
+  }
+  WakeOneParkedTaskThread();
+}
+
+// taskthread only. runs other tasks while we wait, so a task blocked on its subtasks doesn't waste the thread.
+Inl void
+JoinAsyncTasks( taskthread_t* taskthread, asyncjoin_t* join )
+{
+  while( join->num_pending ) {
+    if( !RunOneAsyncTask( taskthread ) ) {
+      _mm_pause();
+    }
+  }
+}
+
+//
+// ParallelFor calls FnBody for every k in [0, n), spread over the taskthreads and the calling thread.
+// items are claimed off a shared counter, and the calling thread claims them too, so this still finishes
+// when every taskthread is busy, and there's no join to wait on besides the items already claimed.
+// worker is claimed the first time a thread gets an item, so it's dense in [0, max_workers), and workers
+// can index per-worker scratch with it. late tasks find every item claimed, and exit without a worker.
+//
+
+#define __ParallelForBody( name )    \
+  void ( name )( \
+    void* misc, \
+    idx_t worker, \
+    idx_t k \
+    ) \
+
+typedef __ParallelForBody( *pfn_parallelforbody_t );
+
+struct
+parallelfor_t
+{
+  pfn_parallelforbody_t FnBody;
+  void* misc;
+  idx_t n;
+  volatile idx_t next_k;
+  volatile idx_t num_done;
+  volatile idx_t next_worker;
+
+  // one for the calling thread, plus one per pushed task; the last one out frees this.
+  volatile idx_t refcount;
+};
+
+Inl void
+_ParallelForRun( parallelfor_t* pf )
+{
+  idx_t worker = MAX_idx;
+  Forever {
+    auto k = InterlockedIncrement( &pf->next_k ) - 1;
+    if( k >= pf->n ) {
+      break;
+    }
+    if( worker == MAX_idx ) {
+      worker = InterlockedIncrement( &pf->next_worker ) - 1;
+    }
+    pf->FnBody( pf->misc, worker, k );
+    InterlockedIncrement( &pf->num_done );
+  }
+}
+
+Inl void
+_ParallelForRelease( parallelfor_t* pf )
+{
+  if( !InterlockedDecrement( &pf->refcount ) ) {
+    MemHeapFree( pf );
+  }
+}
+
+__AsyncTask( AsyncTask_ParallelFor )
+{
+  auto pf = Cast( parallelfor_t*, misc0 );
+  _ParallelForRun( pf );
+  _ParallelForRelease( pf );
+}
+
+// main thread only, since we push tasks. max_workers includes the calling thread; pass 1 to run serially.
+// returns how many workers claimed items, so callers know how much per-worker scratch got used.
+Inl idx_t
+ParallelFor( pfn_parallelforbody_t FnBody, void* misc, idx_t n, idx_t max_workers )
+{
+  AssertCrash( max_workers );
+  auto ntasks = MIN3( max_workers - 1, g_mainthread.taskthreads.len, n  ?  n - 1  :  0 );
+  if( !ntasks ) {
+    For( k, 0, n ) {
+      FnBody( misc, 0, k );
+    }
+    return n  ?  1  :  0;
+  }
+
+  auto pf = MemHeapAlloc( parallelfor_t, 1 );
+  pf->FnBody = FnBody;
+  pf->misc = misc;
+  pf->n = n;
+  pf->next_k = 0;
+  pf->num_done = 0;
+  pf->next_worker = 0;
+  pf->refcount = 1 + ntasks;
+  For( i, 0, ntasks ) {
+    asyncqueue_entry_t entry;
+    entry.FnAsyncTask = AsyncTask_ParallelFor;
+    entry.misc0 = pf;
+    entry.misc1 = 0;
+    entry.time_generated = TimeTSC();
+    PushAsyncTask( i, &entry );
+  }
+  _ParallelForRun( pf );
+
+  // the items we didn't claim are already running elsewhere, so this wait is at most one item long.
+  while( pf->num_done < n ) {
+    _mm_pause();
+  }
+  auto nworkers = pf->next_worker;
+  _ParallelForRelease( pf );
+  return nworkers;
 }
 
 // note we push onto a per-taskthread output queue, so any spamming will be isolated to that thread.
@@ -602,6 +1130,7 @@ PushMainTaskCompleted( taskthread_t* t, maincompletedqueue_entry_t* me )
   auto r = SetEvent( g_mainthread.wake_asynctaskscompleted );
   AssertCrash( r );
 #elif defined(MAC)
+  Set( g_mainthread.wake_asynctaskscompleted );
 #else
 #error Unsupported platform
 #endif
@@ -612,22 +1141,22 @@ PushMainTaskCompleted( taskthread_t* t, maincompletedqueue_entry_t* me )
 }
 
 
+// separate from MainThreadInit, so main_th can restart the taskthreads under a different scheduler.
 void
-MainThreadInit()
+TaskThreadsInit( scheduler_t scheduler )
 {
-#if BADTLS
-  g_tls_handle = TlsAlloc();
-  _ReadWriteBarrier();
-  AssertWarn( g_tls_handle != TLS_OUT_OF_INDEXES );
-#endif
-
-  ThreadInit();
-
 #if defined(WIN)
   SYSTEM_INFO si = { 0 };
   GetSystemInfo( &si );
   AssertCrash( si.dwNumberOfProcessors > 0 );
   auto num_procs = Cast( idx_t, si.dwNumberOfProcessors );
+#elif defined(MAC)
+  auto nprocs_onln = sysconf( _SC_NPROCESSORS_ONLN );
+  AssertCrash( nprocs_onln > 0 );
+  auto num_procs = Cast( idx_t, nprocs_onln );
+#else
+#error Unsupported platform
+#endif
 
   // note these taskthreads are in addition to the main thread, so we're actually oversubscribing here by 1.
   // this is in the hope of having the main thread sleep while all taskthreads run.
@@ -635,38 +1164,95 @@ MainThreadInit()
   auto num_threads = num_procs;
 
   g_mainthread.signal_quit = 0;
+  g_mainthread.scheduler = scheduler;
+  g_mainthread.num_parked = 0;
+  g_mainthread.wake_cursor = 0;
 
+#if defined(WIN)
   g_mainthread.wake_asynctaskscompleted = CreateEvent( 0, 0, 0, 0 );
   AssertCrash( g_mainthread.wake_asynctaskscompleted );
+#elif defined(MAC)
+  Init( g_mainthread.wake_asynctaskscompleted );
+#else
+#error Unsupported platform
+#endif
 
   constant idx_t c_perthread_queuesize = 16000;
+  constant idx_t c_perthread_dequesize = 16384; // must be a power of 2.
 
   Alloc( g_mainthread.taskthread_handles, num_threads );
   Alloc( g_mainthread.taskthreads, num_threads );
 
-#if PULLMODEL
   Alloc( g_mainthread.tasks, num_threads * c_perthread_queuesize );
-#else
-#endif
 
+  // initialize every taskthread before starting any, since they steal from each other.
   For( i, 0, num_threads ) {
     auto t = AddBack( g_mainthread.taskthreads );
+#if defined(WIN)
     t->wake = CreateEvent( 0, 0, 0, 0 );
     AssertCrash( t->wake );
-#if PULLMODEL
+#elif defined(MAC)
+    Init( t->wake );
 #else
-    Alloc( t->input, c_perthread_queuesize );
+#error Unsupported platform
 #endif
+    Alloc( t->deque, c_perthread_dequesize );
+    t->parked = 0;
+    t->idx = i;
+    t->steal_cursor = i + 1;
     Alloc( t->output, c_perthread_queuesize );
+  }
+  _ReadWriteBarrier();
+
+  FORLEN( t, i, g_mainthread.taskthreads )
     auto handle = AddBack( g_mainthread.taskthread_handles );
-    _ReadWriteBarrier();
+#if defined(WIN)
     *handle = Cast( HANDLE, _beginthreadex( 0, 0, TaskThread, t, 0, 0 ) );
     AssertCrash( *handle );
+#elif defined(MAC)
+    *handle = ThreadStart( TaskThread, t );
+#else
+#error Unsupported platform
+#endif
   }
+}
+
+void
+TaskThreadsKill()
+{
+#if defined(WIN)
+  FORLEN( handle, i, g_mainthread.taskthread_handles )
+    CloseHandle( *handle );
+  }
+  CloseHandle( g_mainthread.wake_asynctaskscompleted );
 #elif defined(MAC)
+  Kill( g_mainthread.wake_asynctaskscompleted );
 #else
 #error Unsupported platform
 #endif
+  Free( g_mainthread.taskthread_handles );
+
+  FORLEN( t, i, g_mainthread.taskthreads )
+    Kill( *t );
+  }
+  Free( g_mainthread.taskthreads );
+
+  Free( g_mainthread.tasks );
+}
+
+void
+MainThreadInit()
+{
+#if BADTLS
+  g_tls_handle = TlsAlloc();
+  _ReadWriteBarrier();
+  AssertWarn( g_tls_handle != TLS_OUT_OF_INDEXES );
+#endif
+
+  ThreadInit();
+  ThreadSetName( "MainThread" );
+
+  TaskThreadsInit( scheduler_t::workstealing );
 }
 
 void
@@ -675,13 +1261,11 @@ SignalQuitAndWaitForTaskThreads()
   g_mainthread.signal_quit = 1;
   _ReadWriteBarrier();
 
-#if defined(WIN)
-  ForLen( i, g_mainthread.taskthreads ) {
-    auto taskthread = g_mainthread.taskthreads.mem + i;
-    auto r = SetEvent( taskthread->wake );
-    AssertCrash( r );
+  FORLEN( t, i, g_mainthread.taskthreads )
+    WakeTaskThread( t );
   }
 
+#if defined(WIN)
   // TODO: should we use Msg- version of this, to keep flushing our win messages ?
   DWORD waitres = WaitForMultipleObjects(
     Cast( DWORD, g_mainthread.taskthread_handles.len ),
@@ -692,6 +1276,9 @@ SignalQuitAndWaitForTaskThreads()
   AssertCrash( waitres != WAIT_FAILED );
   AssertCrash( waitres != WAIT_TIMEOUT );
 #elif defined(MAC)
+  FORLEN( handle, i, g_mainthread.taskthread_handles )
+    ThreadWait( *handle );
+  }
 #else
 #error Unsupported platform
 #endif
@@ -700,23 +1287,7 @@ SignalQuitAndWaitForTaskThreads()
 void
 MainThreadKill()
 {
-#if defined(WIN)
-  Free( g_mainthread.taskthread_handles );
-
-  FORLEN( t, i, g_mainthread.taskthreads )
-    Kill( *t );
-  }
-  Free( g_mainthread.taskthreads );
-
-#if PULLMODEL
-  Free( g_mainthread.tasks );
-#else
-#endif
-
-#elif defined(MAC)
-#else
-#error Unsupported platform
-#endif
+  TaskThreadsKill();
 
   ThreadKill();
 
@@ -741,10 +1312,17 @@ RegisterTest([]()
 {
   stack_resizeable_pagelist_t<u8> output;
   Init( output, 64 );
+#if defined(WIN)
   auto cmd = SliceFromCStr( "cmd.exe /c echo hello world!" );
+  auto expected = SliceFromCStr( "hello world!\r\n" );
+#elif defined(MAC)
+  auto cmd = SliceFromCStr( "echo hello world!" );
+  auto expected = SliceFromCStr( "hello world!\n" );
+#else
+#error Unsupported platform
+#endif
   s32 r = Execute( cmd, 0, OutputForExecute, &output, 0 );
   auto output_pos = MakeIteratorAtLinearIndex( output, 0 );
-  auto expected = SliceFromCStr( "hello world!\r\n" );
   AssertCrash( !r );
   AssertCrash( MemEqual( ML( expected ), ML( *output_pos.page ) ) );
   Kill( output );
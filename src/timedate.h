@@ -6,6 +6,8 @@ void
 Log( const void* cstr ... );
 void
 LogInline( const void* cstr ... );
+Inl u64
+TimeClock();
 
 
 static f32 g_sec_per_tsc32;
@@ -21,7 +23,7 @@ static u32 g_sleep_prec_period_min;
 // TODO: define struct types around cycle_t and clock_t so we can't mix up the apis.
 //   already had one bug like that.
 
-#ifdef MAC
+#if defined(MAC)  &&  defined(__aarch64__)
   ForceInl u64 __rdtsc()
   {
     u64 r;
@@ -43,6 +45,11 @@ TimeSleep( u32 milliseconds )
 #if defined(WIN)
   Sleep( milliseconds ); // arg, winAPI! let me have a nano TimeSleep!
 #elif defined(MAC)
+  timespec ts;
+  ts.tv_sec = milliseconds / 1000;
+  ts.tv_nsec = Cast( long, milliseconds % 1000 ) * 1000000;
+  while( nanosleep( &ts, &ts )  &&  errno == EINTR ) {
+  }
 #else
 #error Unsupported platform
 #endif
@@ -289,6 +296,23 @@ TimeInit()
   LogAddIndent( -1 );
   Log( "" );
 #elif defined(MAC)
+  // TimeClock is CLOCK_MONOTONIC in nanoseconds here.
+  g_sec_per_qpc32 = 1e-9f;
+  g_sec_per_qpc64 = 1e-9;
+
+  // no portable way to read the tsc frequency, so measure it against the monotonic clock.
+  u64 clock_start = TimeClock();
+  u64 tsc_start = TimeTSC();
+  u64 clock_dticks;
+  Forever {
+    clock_dticks = TimeClock() - clock_start;
+    if( clock_dticks > 1000000000 / 16 ) {
+      break;
+    }
+  }
+  u64 tsc_dticks = TimeTSC() - tsc_start;
+  g_sec_per_tsc64 = 1e-9 * Cast( f64, clock_dticks ) / Cast( f64, tsc_dticks );
+  g_sec_per_tsc32 = Cast( f32, g_sec_per_tsc64 );
 #else
 #error Unsupported platform
 #endif
@@ -374,8 +398,9 @@ TimeClock()
   QueryPerformanceCounter( Cast( LARGE_INTEGER*, &qpc ) );
   return qpc;
 #elif defined(MAC)
-  ImplementCrash();
-  return 0;
+  timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return Cast( u64, ts.tv_sec ) * 1000000000ull + Cast( u64, ts.tv_nsec );
 #else
 #error Unsupported platform
 #endif
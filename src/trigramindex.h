@@ -0,0 +1,1054 @@
+// Copyright (c) John A. Carlos Jr., all rights reserved.
+
+// persistent trigram index over the files in a directory tree, for find-in-files.
+//
+// every 3-byte window of a file's contents, ascii-lowercased, is a trigram. for each trigram, we store the ascending
+// list of files that contain it. a key can only occur in files that contain every trigram of the key, so a query
+// intersects those lists to get a small candidate set, and only the candidates need scanning.
+// lowercasing makes the candidates a superset for case-sensitive searches too, and word_boundary only ever removes
+// matches, so callers still verify every candidate with the exact StringIdxScanR search.
+//
+// on-disk format, native-endian, with each section 8-byte aligned:
+//   trigramindex_header_t
+//   trigramindex_file_t[ num_files ], sorted by name.
+//   trigramindex_trigram_t[ num_trigrams ], sorted by trigram.
+//   names, referenced by trigramindex_file_t.
+//   postings, referenced by trigramindex_trigram_t. each is the ascending list of file indices containing that
+//     trigram, as varint-encoded deltas.
+// we load it with FileOpenMappedExistingReadShareRead, so a big index gets mapped rather than copied.
+//
+// files are keyed by name, size and last-write time. an update only rereads the files where any of those changed,
+// and remaps the postings of every other file over from the old index.
+//
+
+constant u64 c_trigramindex_magic = 0x3158444E49524754ULL; // "TGRINDX1"
+constant u32 c_trigramindex_version = 1;
+constant u32 c_num_trigrams = 1u << 24;
+
+// bigger files are left out of the index, and always come back as candidates.
+constant u64 c_trigramindex_max_file_size = 64*1024*1024;
+
+// # of files each indexing task reads.
+constant idx_t c_trigramindex_chunk_size = 64;
+
+// most freshly read ( trigram, file ) pairs a merge buckets at once. a cold build of a big tree can have billions,
+// so the merge takes them one range of trigrams at a time.
+constant idx_t c_trigramindex_merge_batch = 64*1024*1024;
+
+constant u32 c_trigramindex_file_unindexed = 1u << 0;
+
+struct
+trigramindex_header_t
+{
+  u64 magic;
+  u32 version;
+  u32 num_files;
+  u64 num_trigrams;
+  u64 offset_files;
+  u64 offset_trigrams;
+  u64 offset_names;
+  u64 offset_postings;
+  u64 size;
+};
+
+struct
+trigramindex_file_t
+{
+  u64 name_offset;
+  u32 name_len;
+  u32 flags;
+  u64 size;
+  u64 time;
+};
+
+struct
+trigramindex_trigram_t
+{
+  u32 trigram;
+  u32 num_postings;
+  u64 postings_offset;
+};
+
+struct
+trigramindex_t
+{
+  filemapped_t file; // owns the memory everything below points into.
+  trigramindex_header_t* header;
+  trigramindex_file_t* files;
+  trigramindex_trigram_t* trigrams;
+  u8* names;
+  u8* postings;
+  idx_t postings_len;
+};
+
+Inl void
+Zero( trigramindex_t& index )
+{
+  index.file = {};
+  index.header = 0;
+  index.files = 0;
+  index.trigrams = 0;
+  index.names = 0;
+  index.postings = 0;
+  index.postings_len = 0;
+}
+
+Inl void
+Free( trigramindex_t& index )
+{
+  FileFree( index.file );
+  Zero( index );
+}
+
+Inl bool
+IsLoaded( trigramindex_t& index )
+{
+  return index.header;
+}
+
+Inl idx_t
+NumFiles( trigramindex_t& index )
+{
+  return index.header  ?  index.header->num_files  :  0;
+}
+
+Inl slice_t
+FileName( trigramindex_t& index, idx_t file )
+{
+  auto f = index.files + file;
+  slice_t r;
+  r.mem = index.names + f->name_offset;
+  r.len = f->name_len;
+  return r;
+}
+
+// takes ownership of file, and checks everything we'll later index with.
+// on failure, the index is left empty and file is freed.
+Inl bool
+TrigramIndexAttach( trigramindex_t& index, filemapped_t& file )
+{
+  Zero( index );
+  index.file = file;
+  file = {};
+
+  auto mem = index.file.mapped_mem;
+  auto len = index.file.size;
+  auto header = Cast( trigramindex_header_t*, mem );
+  bool valid =
+    len >= sizeof( trigramindex_header_t )  &&
+    header->magic == c_trigramindex_magic  &&
+    header->version == c_trigramindex_version  &&
+    header->size == len  &&
+    header->offset_files <= header->offset_trigrams  &&
+    header->offset_trigrams <= header->offset_names  &&
+    header->offset_names <= header->offset_postings  &&
+    header->offset_postings <= len  &&
+    header->offset_files + header->num_files * sizeof( trigramindex_file_t ) <= header->offset_trigrams  &&
+    header->offset_trigrams + header->num_trigrams * sizeof( trigramindex_trigram_t ) <= header->offset_names;
+  if( !valid ) {
+    Free( index );
+    return 0;
+  }
+
+  index.header = header;
+  index.files = Cast( trigramindex_file_t*, mem + header->offset_files );
+  index.trigrams = Cast( trigramindex_trigram_t*, mem + header->offset_trigrams );
+  index.names = mem + header->offset_names;
+  index.postings = mem + header->offset_postings;
+  index.postings_len = len - header->offset_postings;
+
+  auto names_len = header->offset_postings - header->offset_names;
+  For( i, 0, header->num_files ) {
+    auto f = index.files + i;
+    if( f->name_offset + f->name_len > names_len ) {
+      Free( index );
+      return 0;
+    }
+  }
+  For( i, 0, header->num_trigrams ) {
+    auto t = index.trigrams + i;
+    if( t->postings_offset > index.postings_len  ||
+        ( i  &&  t->trigram <= index.trigrams[i - 1].trigram ) ) {
+      Free( index );
+      return 0;
+    }
+  }
+  return 1;
+}
+
+Inl bool
+TrigramIndexLoad( trigramindex_t& index, u8* filename, idx_t filename_len )
+{
+  auto file = FileOpenMappedExistingReadShareRead( filename, filename_len );
+  if( !file.loaded ) {
+    Zero( index );
+    return 0;
+  }
+  return TrigramIndexAttach( index, file );
+}
+
+// where we keep the index for a given directory: next to the exe, keyed by a hash of the directory name.
+Inl fsobj_t
+TrigramIndexFilename( u8* dir, idx_t dir_len )
+{
+  fsobj_t r = FsGetExe();
+  auto last_slash = StringScanL( ML( r ), '/' );
+  r.len = last_slash  ?  ( last_slash - r.mem + 1 )  :  0;
+  u8 tmp[64];
+  auto tmp_len = sprintf( Cast( char*, tmp ), "te_index/%016llx.trigrams", Cast( unsigned long long, StringHash( dir, dir_len ) ) );
+  Memmove( AddBack( r, tmp_len ), tmp, tmp_len );
+  r.mem[r.len] = 0;
+  return r;
+}
+
+Inl bool
+TrigramIndexFindFile( trigramindex_t& index, u8* name, idx_t name_len, u32* file )
+{
+  idx_t l = 0;
+  idx_t r = NumFiles( index );
+  while( l < r ) {
+    auto m = l + ( r - l ) / 2;
+    auto f = FileName( index, m );
+    auto cmp = memcmp( f.mem, name, MIN( f.len, name_len ) );
+    if( !cmp ) {
+      cmp = ( f.len < name_len )  ?  -1  :  ( f.len > name_len );
+    }
+    if( !cmp ) {
+      *file = Cast( u32, m );
+      return 1;
+    }
+    if( cmp < 0 ) {
+      l = m + 1;
+    } else {
+      r = m;
+    }
+  }
+  return 0;
+}
+
+Inl trigramindex_trigram_t*
+TrigramIndexFindTrigram( trigramindex_t& index, u32 trigram )
+{
+  idx_t l = 0;
+  idx_t r = index.header  ?  index.header->num_trigrams  :  0;
+  while( l < r ) {
+    auto m = l + ( r - l ) / 2;
+    auto t = index.trigrams + m;
+    if( t->trigram == trigram ) {
+      return t;
+    }
+    if( t->trigram < trigram ) {
+      l = m + 1;
+    } else {
+      r = m;
+    }
+  }
+  return 0;
+}
+
+Inl void
+_TrigramIndexPutVarint( stack_resizeable_cont_t<u8>& dst, u32 value )
+{
+  while( value >= 0x80 ) {
+    *AddBack( dst ) = Cast( u8, value | 0x80 );
+    value >>= 7;
+  }
+  *AddBack( dst ) = Cast( u8, value );
+}
+
+// appends the postings of t to dst. stops early if the encoding runs off the end of the postings.
+Inl void
+_TrigramIndexDecodePostings( trigramindex_t& index, trigramindex_trigram_t* t, stack_resizeable_cont_t<u32>& dst )
+{
+  auto src = index.postings + t->postings_offset;
+  auto end = index.postings + index.postings_len;
+  u32 file = 0;
+  Reserve( dst, dst.len + t->num_postings );
+  For( i, 0, t->num_postings ) {
+    u32 delta = 0;
+    u32 shift = 0;
+    Forever {
+      if( src == end ) {
+        return;
+      }
+      auto c = *src++;
+      delta |= Cast( u32, c & 0x7F ) << shift;
+      if( !( c & 0x80 ) ) {
+        break;
+      }
+      shift += 7;
+    }
+    file += delta;
+    dst.mem[ dst.len++ ] = file;
+  }
+}
+
+ForceInl u32
+_TrigramFold( u8 c )
+{
+  return ToLowerAscii( c );
+}
+
+// bitmap with one bit per possible trigram, so deduplicating a file's trigrams is a bit test.
+// only the bits in the trigram list are ever set, so clearing is proportional to that, not the bitmap size.
+struct
+trigramscratch_t
+{
+  u64* seen;
+  stack_resizeable_cont_t<u32> trigrams;
+};
+
+Inl void
+Alloc( trigramscratch_t& scratch )
+{
+  scratch.seen = MemHeapAlloc( u64, c_num_trigrams / 64 );
+  TZero( scratch.seen, c_num_trigrams / 64 );
+  Alloc( scratch.trigrams, 4096 );
+}
+
+Inl void
+Free( trigramscratch_t& scratch )
+{
+  MemHeapFree( scratch.seen );
+  Free( scratch.trigrams );
+}
+
+// appends the distinct trigrams of src to dst, in no particular order.
+Inl void
+TrigramsFromContents( trigramscratch_t& scratch, stack_resizeable_cont_t<u32>& dst, u8* src, idx_t src_len )
+{
+  if( src_len < 3 ) {
+    return;
+  }
+  auto start = dst.len;
+  auto seen = scratch.seen;
+  u32 t = ( _TrigramFold( src[0] ) << 8 ) | _TrigramFold( src[1] );
+  For( i, 2, src_len ) {
+    t = ( ( t << 8 ) | _TrigramFold( src[i] ) ) & ( c_num_trigrams - 1 );
+    auto bit = 1ull << ( t & 63 );
+    if( !( seen[ t >> 6 ] & bit ) ) {
+      seen[ t >> 6 ] |= bit;
+      *AddBack( dst ) = t;
+    }
+  }
+  For( i, start, dst.len ) {
+    seen[ dst.mem[i] >> 6 ] = 0;
+  }
+}
+
+// appends the indices of every file that may contain key, ascending.
+Inl void
+TrigramIndexQuery( trigramindex_t& index, stack_resizeable_cont_t<u32>& dst, u8* key, idx_t key_len )
+{
+  auto num_files = NumFiles( index );
+  if( key_len < 3 ) {
+    Reserve( dst, dst.len + num_files );
+    Fori( u32, i, 0, Cast( u32, num_files ) ) {
+      dst.mem[ dst.len++ ] = i;
+    }
+    return;
+  }
+
+  // look up each distinct trigram of the key, and start intersecting from the shortest posting list.
+  stack_resizeable_cont_t<trigramindex_trigram_t*> lists;
+  Alloc( lists, key_len );
+  bool any_missing = 0;
+  u32 t = ( _TrigramFold( key[0] ) << 8 ) | _TrigramFold( key[1] );
+  For( i, 2, key_len ) {
+    t = ( ( t << 8 ) | _TrigramFold( key[i] ) ) & ( c_num_trigrams - 1 );
+    auto found = TrigramIndexFindTrigram( index, t );
+    if( !found ) {
+      any_missing = 1;
+      break;
+    }
+    bool dupe = 0;
+    ForLen( j, lists ) {
+      dupe |= lists.mem[j] == found;
+    }
+    if( !dupe ) {
+      *AddBack( lists ) = found;
+    }
+  }
+
+  stack_resizeable_cont_t<u32> candidates;
+  stack_resizeable_cont_t<u32> next;
+  Alloc( candidates, 256 );
+  Alloc( next, 256 );
+  if( !any_missing ) {
+    idx_t shortest = 0;
+    ForLen( j, lists ) {
+      if( lists.mem[j]->num_postings < lists.mem[shortest]->num_postings ) {
+        shortest = j;
+      }
+    }
+    _TrigramIndexDecodePostings( index, lists.mem[shortest], candidates );
+    ForLen( j, lists ) {
+      if( j == shortest  ||  !candidates.len ) {
+        continue;
+      }
+      next.len = 0;
+      _TrigramIndexDecodePostings( index, lists.mem[j], next );
+      idx_t a = 0;
+      idx_t b = 0;
+      idx_t n = 0;
+      while( a < candidates.len  &&  b < next.len ) {
+        if( candidates.mem[a] < next.mem[b] ) {
+          a += 1;
+        } elif( next.mem[b] < candidates.mem[a] ) {
+          b += 1;
+        } else {
+          candidates.mem[n++] = candidates.mem[a];
+          a += 1;
+          b += 1;
+        }
+      }
+      candidates.len = n;
+    }
+  }
+
+  // unindexed files have no postings at all, so they never collide with the candidates.
+  idx_t a = 0;
+  For( i, 0, num_files ) {
+    if( !( index.files[i].flags & c_trigramindex_file_unindexed ) ) {
+      continue;
+    }
+    while( a < candidates.len  &&  candidates.mem[a] < i ) {
+      *AddBack( dst ) = candidates.mem[a++];
+    }
+    *AddBack( dst ) = Cast( u32, i );
+  }
+  while( a < candidates.len ) {
+    *AddBack( dst ) = candidates.mem[a++];
+  }
+
+  Free( next );
+  Free( candidates );
+  Free( lists );
+}
+
+
+
+//
+// index updates.
+//
+// TrigramIndexUpdateAddFile for every file currently in the tree, then TrigramIndexUpdatePrepare diffs that against
+// the old index. if TrigramIndexUpdateNeeded, TrigramIndexUpdateStart reads the changed files on the taskthreads.
+// the last task to finish merges everything into update.result and writes it to update.tmpname, then pushes
+// FnCompleted to the main thread, if there is one. it sets update.done last, for callers that poll instead.
+// TrigramIndexUpdateInstall then moves the new index into place, on the main thread.
+//
+
+struct
+trigramindex_entry_t
+{
+  slice_t name;
+  u64 size;
+  u64 time;
+  u32 flags;
+  u32 old_file; // index into the old index's files, or MAX_u32 if we have to reread this file.
+  u32 chunk;
+  u32 num_trigrams;
+  idx_t trigrams_offset; // into chunks[chunk].trigrams.
+};
+
+struct
+trigramindex_update_t;
+
+struct
+trigramindex_chunk_t
+{
+  trigramindex_update_t* update;
+  idx_t stale_start;
+  idx_t stale_count;
+  stack_resizeable_cont_t<u32> trigrams;
+  u64 bytes_read;
+
+  u8 cache_line_padding_to_avoid_thrashing[64]; // last thing, since this type is packed into an stack_resizeable_cont_t
+};
+
+struct
+trigramindex_update_t
+{
+  trigramindex_t* old; // readonly while the update is in flight; may be unloaded.
+  fsobj_t filename;
+  fsobj_t tmpname; // filename + ".tmp", where we write the new index.
+  pagelist_t mem;
+  stack_resizeable_cont_t<trigramindex_entry_t> entries; // sorted by name after prepare.
+  stack_resizeable_cont_t<u32> stale; // entries we have to reread.
+  idx_t num_removed; // old files that aren't in entries.
+  stack_resizeable_cont_t<trigramindex_chunk_t> chunks;
+  stack_resizeable_cont_t<trigramscratch_t> scratch; // one per taskthread, allocated by the first task to use it.
+  volatile idx_t num_chunks_pending;
+
+  pfn_maintaskcompleted_t FnCompleted;
+  void* completed_misc;
+
+  // output:
+  filemapped_t result;
+  bool written; // tmpname holds result.
+  u64 bytes_read;
+  u64 time_start;
+  u64 time_end;
+  volatile bool done;
+};
+
+Inl void
+Init( trigramindex_update_t& update, trigramindex_t* old, fsobj_t& filename )
+{
+  update.old = old;
+  update.filename = filename;
+  update.tmpname = filename;
+  Memmove( AddBack( update.tmpname, 4 ), ".tmp", 4 );
+  update.tmpname.mem[update.tmpname.len] = 0;
+  Init( update.mem, 64000 );
+  Alloc( update.entries, 4096 );
+  Alloc( update.stale, 256 );
+  update.num_removed = 0;
+  Alloc( update.chunks, 16 );
+  Alloc( update.scratch, g_mainthread.taskthreads.len );
+  update.scratch.len = g_mainthread.taskthreads.len;
+  ForLen( i, update.scratch ) {
+    update.scratch.mem[i] = {};
+  }
+  update.num_chunks_pending = 0;
+  update.FnCompleted = 0;
+  update.completed_misc = 0;
+  update.result = {};
+  update.written = 0;
+  update.bytes_read = 0;
+  update.time_start = 0;
+  update.time_end = 0;
+  update.done = 0;
+}
+
+Inl void
+Kill( trigramindex_update_t& update )
+{
+  Kill( update.mem );
+  Free( update.entries );
+  Free( update.stale );
+  ForLen( i, update.chunks ) {
+    Free( update.chunks.mem[i].trigrams );
+  }
+  Free( update.chunks );
+  ForLen( i, update.scratch ) {
+    if( update.scratch.mem[i].seen ) {
+      Free( update.scratch.mem[i] );
+    }
+  }
+  Free( update.scratch );
+  FileFree( update.result );
+}
+
+Inl void
+TrigramIndexUpdateAddFile( trigramindex_update_t& update, u8* name, idx_t name_len, u64 size, u64 time )
+{
+  // don't index our own index, in case it lives under the tree.
+  if( MemEqual( name, name_len, ML( update.filename ) )  ||  MemEqual( name, name_len, ML( update.tmpname ) ) ) {
+    return;
+  }
+  auto entry = AddBack( update.entries );
+  entry->name.mem = AddPagelist( update.mem, u8, 1, name_len );
+  entry->name.len = name_len;
+  Memmove( entry->name.mem, name, name_len );
+  entry->size = size;
+  entry->time = time;
+  entry->flags = ( size > c_trigramindex_max_file_size )  ?  c_trigramindex_file_unindexed  :  0;
+  entry->old_file = MAX_u32;
+  entry->chunk = 0;
+  entry->num_trigrams = 0;
+  entry->trigrams_offset = 0;
+}
+
+Inl void
+TrigramIndexUpdatePrepare( trigramindex_update_t& update )
+{
+  std::sort(
+    update.entries.mem,
+    update.entries.mem + update.entries.len,
+    []( trigramindex_entry_t& a, trigramindex_entry_t& b )
+    {
+      auto cmp = memcmp( a.name.mem, b.name.mem, MIN( a.name.len, b.name.len ) );
+      return cmp  ?  ( cmp < 0 )  :  ( a.name.len < b.name.len );
+    }
+    );
+
+  idx_t num_kept = 0;
+  auto old = update.old;
+  ForLen( i, update.entries ) {
+    auto entry = update.entries.mem + i;
+    u32 old_file;
+    if( old  &&  TrigramIndexFindFile( *old, ML( entry->name ), &old_file ) ) {
+      auto f = old->files + old_file;
+      if( f->size == entry->size  &&  f->time == entry->time ) {
+        entry->old_file = old_file;
+        num_kept += 1;
+        continue;
+      }
+    }
+    if( !( entry->flags & c_trigramindex_file_unindexed ) ) {
+      *AddBack( update.stale ) = Cast( u32, i );
+    }
+  }
+  update.num_removed = old  ?  NumFiles( *old ) - num_kept  :  0;
+}
+
+Inl bool
+TrigramIndexUpdateNeeded( trigramindex_update_t& update )
+{
+  if( !update.old  ||  !IsLoaded( *update.old ) ) {
+    return 1;
+  }
+  ForLen( i, update.entries ) {
+    if( update.entries.mem[i].old_file == MAX_u32 ) {
+      return 1;
+    }
+  }
+  return update.num_removed;
+}
+
+// appends the current files that may contain key: files the old index is still valid for that match the query,
+// plus everything the old index doesn't know about.
+// names are copied into mem, so they outlive the update.
+Inl void
+TrigramIndexUpdateCandidates(
+  trigramindex_update_t& update,
+  stack_resizeable_cont_t<slice_t>& dst,
+  pagelist_t& mem,
+  u8* key,
+  idx_t key_len
+  )
+{
+  auto old = update.old;
+  u64* is_candidate = 0;
+  if( old  &&  IsLoaded( *old ) ) {
+    auto num_old = NumFiles( *old );
+    is_candidate = MemHeapAlloc( u64, num_old / 64 + 1 );
+    TZero( is_candidate, num_old / 64 + 1 );
+    stack_resizeable_cont_t<u32> files;
+    Alloc( files, 256 );
+    TrigramIndexQuery( *old, files, key, key_len );
+    ForLen( i, files ) {
+      is_candidate[ files.mem[i] / 64 ] |= 1ull << ( files.mem[i] % 64 );
+    }
+    Free( files );
+  }
+
+  ForLen( i, update.entries ) {
+    auto entry = update.entries.mem + i;
+    auto f = entry->old_file;
+    if( f != MAX_u32  &&  !( is_candidate[ f / 64 ] & ( 1ull << ( f % 64 ) ) ) ) {
+      continue;
+    }
+    auto name = AddBack( dst );
+    name->mem = AddPagelist( mem, u8, 1, entry->name.len );
+    name->len = entry->name.len;
+    Memmove( name->mem, ML( entry->name ) );
+  }
+
+  if( is_candidate ) {
+    MemHeapFree( is_candidate );
+  }
+}
+
+Inl void
+_TrigramIndexUpdateChunk( taskthread_t* taskthread, trigramindex_chunk_t* chunk )
+{
+  auto update = chunk->update;
+  auto scratch = update->scratch.mem + taskthread->idx;
+  if( !scratch->seen ) {
+    Alloc( *scratch );
+  }
+  For( i, chunk->stale_start, chunk->stale_start + chunk->stale_count ) {
+    if( g_mainthread.signal_quit ) {
+      return;
+    }
+    auto entry = update->entries.mem + update->stale.mem[i];
+    entry->trigrams_offset = chunk->trigrams.len;
+    auto file = FileOpenMappedExistingReadShareRead( ML( entry->name ) );
+    if( !file.loaded ) {
+      // leave it in the index with no trigrams, so we don't retry it until it changes.
+      continue;
+    }
+    TrigramsFromContents( *scratch, chunk->trigrams, file.mapped_mem, file.size );
+    entry->num_trigrams = Cast( u32, chunk->trigrams.len - entry->trigrams_offset );
+    chunk->bytes_read += file.size;
+    FileFree( file );
+  }
+}
+
+// merges the old index's still-valid postings with the freshly read files, and serializes into update.result.
+Inl void
+_TrigramIndexUpdateMerge( trigramindex_update_t& update )
+{
+  auto old = update.old;
+  auto num_files = update.entries.len;
+  AssertCrash( num_files < MAX_u32 );
+
+  ForLen( i, update.chunks ) {
+    update.bytes_read += update.chunks.mem[i].bytes_read;
+  }
+
+  // count the fresh ( trigram, file ) pairs per trigram. a count is at most num_files, so it fits a u32.
+  auto ends = MemHeapAlloc( u32, c_num_trigrams );
+  TZero( ends, c_num_trigrams );
+  ForLen( i, update.stale ) {
+    auto entry = update.entries.mem + update.stale.mem[i];
+    auto trigrams = update.chunks.mem[ entry->chunk ].trigrams.mem + entry->trigrams_offset;
+    For( j, 0, entry->num_trigrams ) {
+      ends[ trigrams[j] ] += 1;
+    }
+  }
+
+  auto num_old = ( old  &&  IsLoaded( *old ) )  ?  NumFiles( *old )  :  0;
+  auto new_from_old = MemHeapAlloc( u32, num_old + 1 );
+  For( i, 0, num_old ) {
+    new_from_old[i] = MAX_u32;
+  }
+  ForLen( i, update.entries ) {
+    auto f = update.entries.mem[i].old_file;
+    if( f != MAX_u32 ) {
+      new_from_old[f] = Cast( u32, i );
+    }
+  }
+
+  stack_resizeable_cont_t<trigramindex_trigram_t> trigrams;
+  stack_resizeable_cont_t<u8> postings;
+  stack_resizeable_cont_t<u32> decoded;
+  stack_resizeable_cont_t<u32> kept;
+  Alloc( trigrams, 65536 );
+  Alloc( postings, 1024*1024 );
+  Alloc( decoded, 1024 );
+  Alloc( kept, 1024 );
+  idx_t old_cursor = 0;
+  auto num_old_trigrams = num_old  ?  old->header->num_trigrams  :  0;
+  u32 t0 = 0;
+  while( t0 < c_num_trigrams ) {
+    // take trigrams into this batch until it's full, but always at least one.
+    u32 t1 = t0;
+    idx_t batch_len = 0;
+    while( t1 < c_num_trigrams  &&  ( t1 == t0  ||  batch_len + ends[t1] <= c_trigramindex_merge_batch ) ) {
+      batch_len += ends[t1];
+      t1 += 1;
+    }
+    AssertCrash( batch_len < MAX_u32 );
+
+    // bucket the batch's fresh pairs by trigram. walking the files in order keeps each bucket ascending.
+    u32 sum = 0;
+    For( t, t0, t1 ) {
+      sum += ends[t];
+      ends[t] = sum;
+    }
+    auto fresh = MemHeapAlloc( u32, MAX( batch_len, 1 ) );
+    ReverseForLen( i, update.stale ) {
+      auto file = update.stale.mem[i];
+      auto entry = update.entries.mem + file;
+      auto trigrams = update.chunks.mem[ entry->chunk ].trigrams.mem + entry->trigrams_offset;
+      For( j, 0, entry->num_trigrams ) {
+        auto t = trigrams[j];
+        if( t0 <= t  &&  t < t1 ) {
+          fresh[ --ends[t] ] = file;
+        }
+      }
+    }
+    // ends[t] is now the start of bucket t, within fresh.
+
+    For( t, t0, t1 ) {
+      auto fresh_start = ends[t];
+      auto fresh_end = ( t + 1 < t1 )  ?  ends[t + 1]  :  Cast( u32, batch_len );
+
+      // old files keep their relative order in the new index, since both are sorted by name.
+      kept.len = 0;
+      if( old_cursor < num_old_trigrams  &&  old->trigrams[old_cursor].trigram == t ) {
+        decoded.len = 0;
+        _TrigramIndexDecodePostings( *old, old->trigrams + old_cursor, decoded );
+        old_cursor += 1;
+        ForLen( i, decoded ) {
+          auto f = ( decoded.mem[i] < num_old )  ?  new_from_old[ decoded.mem[i] ]  :  MAX_u32;
+          if( f != MAX_u32 ) {
+            *AddBack( kept ) = f;
+          }
+        }
+      }
+      if( !kept.len  &&  fresh_start == fresh_end ) {
+        continue;
+      }
+
+      auto entry = AddBack( trigrams );
+      entry->trigram = Cast( u32, t );
+      entry->num_postings = Cast( u32, kept.len + fresh_end - fresh_start );
+      entry->postings_offset = postings.len;
+      u32 prev = 0;
+      idx_t a = 0;
+      auto b = fresh_start;
+      while( a < kept.len  ||  b < fresh_end ) {
+        u32 f;
+        if( b == fresh_end  ||  ( a < kept.len  &&  kept.mem[a] < fresh[b] ) ) {
+          f = kept.mem[a++];
+        } else {
+          f = fresh[b++];
+        }
+        _TrigramIndexPutVarint( postings, f - prev );
+        prev = f;
+      }
+    }
+    MemHeapFree( fresh );
+    t0 = t1;
+  }
+  Free( kept );
+  Free( decoded );
+  MemHeapFree( new_from_old );
+  MemHeapFree( ends );
+
+  idx_t names_len = 0;
+  ForLen( i, update.entries ) {
+    names_len += update.entries.mem[i].name.len;
+  }
+
+  #define ALIGN8( x )   ( ( ( x ) + 7 ) & ~Cast( u64, 7 ) )
+  trigramindex_header_t header;
+  header.magic = c_trigramindex_magic;
+  header.version = c_trigramindex_version;
+  header.num_files = Cast( u32, num_files );
+  header.num_trigrams = trigrams.len;
+  header.offset_files = ALIGN8( sizeof( trigramindex_header_t ) );
+  header.offset_trigrams = ALIGN8( header.offset_files + num_files * sizeof( trigramindex_file_t ) );
+  header.offset_names = ALIGN8( header.offset_trigrams + trigrams.len * sizeof( trigramindex_trigram_t ) );
+  header.offset_postings = ALIGN8( header.offset_names + names_len );
+  header.size = header.offset_postings + postings.len;
+  #undef ALIGN8
+
+  auto result = MemHeapAlloc( u8, Cast( idx_t, header.size ) );
+  Memzero( result, Cast( idx_t, header.size ) );
+  Memmove( result, &header, sizeof( header ) );
+  auto files = Cast( trigramindex_file_t*, result + header.offset_files );
+  auto names = result + header.offset_names;
+  u64 name_offset = 0;
+  ForLen( i, update.entries ) {
+    auto entry = update.entries.mem + i;
+    files[i].name_offset = name_offset;
+    files[i].name_len = Cast( u32, entry->name.len );
+    files[i].flags = entry->flags;
+    files[i].size = entry->size;
+    files[i].time = entry->time;
+    Memmove( names + name_offset, ML( entry->name ) );
+    name_offset += entry->name.len;
+  }
+  Memmove( result + header.offset_trigrams, trigrams.mem, trigrams.len * sizeof( trigramindex_trigram_t ) );
+  Memmove( result + header.offset_postings, postings.mem, postings.len );
+  Free( postings );
+  Free( trigrams );
+
+  // a heap copy, like FileOpenMappedExistingReadShareRead makes of small files.
+  update.result = {};
+  update.result.mapped_mem = result;
+  update.result.size = Cast( idx_t, header.size );
+  update.result.loaded = 1;
+}
+
+Inl void
+_TrigramIndexWrite( trigramindex_update_t& update )
+{
+  // the old index is still mapped and in use, so we write beside it, and the main thread moves this into place.
+  auto file = FileOpen( ML( update.tmpname ), fileopen_t::always, fileop_t::W, fileop_t::none );
+  if( !file.loaded ) {
+    return;
+  }
+  FileWrite( file, 0, update.result.mapped_mem, update.result.size );
+  FileSetEOF( file, update.result.size );
+  update.written = file.size == update.result.size;
+  FileFree( file );
+  if( !update.written ) {
+    FileDelete( ML( update.tmpname ) );
+  }
+}
+
+// loads the finished update into index, moving the written index over the old one.
+// the caller has to Free whatever index was mapping update.filename first; WIN can't replace a mapped file.
+// if the write or the move failed, index takes the in-memory result instead, and we'll rebuild next time.
+Inl bool
+TrigramIndexUpdateInstall( trigramindex_update_t& update, trigramindex_t& index )
+{
+  if( update.written ) {
+    update.written = 0;
+    if( FileMoveOverwrite( ML( update.filename ), ML( update.tmpname ) ) ) {
+      if( TrigramIndexLoad( index, ML( update.filename ) ) ) {
+        FileFree( update.result );
+        return 1;
+      }
+    } else {
+      FileDelete( ML( update.tmpname ) );
+    }
+  }
+  return TrigramIndexAttach( index, update.result );
+}
+
+__AsyncTask( AsyncTask_TrigramIndexUpdateChunk )
+{
+  ProfFunc();
+
+  auto chunk = Cast( trigramindex_chunk_t*, misc0 );
+  auto update = chunk->update;
+
+  _TrigramIndexUpdateChunk( taskthread, chunk );
+
+  if( InterlockedDecrement( &update->num_chunks_pending ) ) {
+    return;
+  }
+  if( g_mainthread.signal_quit ) {
+    return;
+  }
+
+  // we're the last chunk, so do the merge here too.
+  _TrigramIndexUpdateMerge( *update );
+  _TrigramIndexWrite( *update );
+  update->time_end = TimeTSC();
+
+  if( update->FnCompleted ) {
+    maincompletedqueue_entry_t entry;
+    entry.FnMainTaskCompleted = update->FnCompleted;
+    entry.misc0 = update;
+    entry.misc1 = update->completed_misc;
+    entry.misc2 = 0;
+    entry.time_generated = TimeTSC();
+    PushMainTaskCompleted( taskthread, &entry );
+  }
+  _ReadWriteBarrier();
+  update->done = 1;
+}
+
+// main thread only.
+Inl void
+TrigramIndexUpdateStart( trigramindex_update_t& update )
+{
+  update.time_start = TimeTSC();
+
+  // always push at least one chunk, since the last chunk is what does the merge.
+  auto num_chunks = MAX( 1, ( update.stale.len + c_trigramindex_chunk_size - 1 ) / c_trigramindex_chunk_size );
+  Reserve( update.chunks, num_chunks );
+  For( i, 0, num_chunks ) {
+    auto chunk = AddBack( update.chunks );
+    chunk->update = &update;
+    chunk->stale_start = i * c_trigramindex_chunk_size;
+    chunk->stale_count = MIN( c_trigramindex_chunk_size, update.stale.len - MIN( update.stale.len, chunk->stale_start ) );
+    Alloc( chunk->trigrams, 16384 );
+    chunk->bytes_read = 0;
+    For( j, chunk->stale_start, chunk->stale_start + chunk->stale_count ) {
+      update.entries.mem[ update.stale.mem[j] ].chunk = Cast( u32, i );
+    }
+  }
+  update.num_chunks_pending = num_chunks;
+  _ReadWriteBarrier();
+
+  For( i, 0, num_chunks ) {
+    asyncqueue_entry_t entry;
+    entry.FnAsyncTask = AsyncTask_TrigramIndexUpdateChunk;
+    entry.misc0 = update.chunks.mem + i;
+    entry.misc1 = 0;
+    entry.time_generated = TimeTSC();
+    PushAsyncTask( i, &entry );
+  }
+}
+
+
+
+RegisterTest([]()
+{
+  // build an index in memory from fake contents, and check queries against a brute force search.
+  // this bypasses the file reads, so it doesn't need the filesystem.
+  u8* contents[] = {
+    Str( "int main() { return 0; }" ),
+    Str( "StringIdxScanR( &pos, ML( mem ), 0, ML( key ), 0, 0 );" ),
+    Str( "the quick brown fox jumps over the lazy dog" ),
+    Str( "THE QUICK BROWN FOX" ),
+    Str( "ab" ),
+    Str( "" ),
+    Str( "aaaaaaaaaaaaaaaa" ),
+    Str( "fox\x80\xFFglove" ),
+  };
+  u8* keys[] = {
+    Str( "fox" ), Str( "FOX" ), Str( "quick brown" ), Str( "return" ), Str( "ab" ), Str( "a" ),
+    Str( "aaaa" ), Str( "idxscan" ), Str( "zzz" ), Str( "\x80\xFF" ), Str( "x\x80\xFF" ), Str( "dog!" ),
+  };
+
+  fsobj_t filename;
+  FsGetCwd( filename );
+  AddBackCStr( &filename, "/trigramindex_test.trigrams" );
+  trigramindex_t old;
+  Zero( old );
+
+  // two rounds: a fresh build, then an update that changes one file and drops another.
+  For( round, 0, 2 ) {
+    trigramindex_update_t update;
+    Init( update, &old, filename );
+    For( i, 0, _countof( contents ) ) {
+      if( round == 1  &&  i == 4 ) {
+        continue;
+      }
+      u8 name[32];
+      auto name_len = sprintf( Cast( char*, name ), "file%02u", Cast( u32, i ) );
+      auto len = CstrLength( contents[i] );
+      auto time = ( round == 1  &&  i == 2 )  ?  1  :  0;
+      TrigramIndexUpdateAddFile( update, name, name_len, len, time );
+    }
+    TrigramIndexUpdatePrepare( update );
+    AssertCrash( TrigramIndexUpdateNeeded( update ) );
+    AssertCrash( update.stale.len == ( round  ?  1u  :  _countof( contents ) ) );
+
+    // stand in for the taskthreads.
+    auto chunk = AddBack( update.chunks );
+    chunk->update = &update;
+    chunk->stale_start = 0;
+    chunk->stale_count = update.stale.len;
+    Alloc( chunk->trigrams, 1024 );
+    chunk->bytes_read = 0;
+    trigramscratch_t scratch;
+    Alloc( scratch );
+    ForLen( i, update.stale ) {
+      auto entry = update.entries.mem + update.stale.mem[i];
+      u32 file = 0;
+      sscanf( Cast( char*, entry->name.mem ) + 4, "%02u", &file );
+      entry->chunk = 0;
+      entry->trigrams_offset = chunk->trigrams.len;
+      TrigramsFromContents( scratch, chunk->trigrams, contents[file], CstrLength( contents[file] ) );
+      entry->num_trigrams = Cast( u32, chunk->trigrams.len - entry->trigrams_offset );
+    }
+    Free( scratch );
+    _TrigramIndexUpdateMerge( update );
+    _TrigramIndexWrite( update );
+    AssertCrash( update.written );
+
+    // the second round's install replaces the file the first round's index maps.
+    Free( old );
+    trigramindex_t index;
+    AssertCrash( TrigramIndexUpdateInstall( update, index ) );
+    AssertCrash( index.file.loaded  &&  !FileExists( ML( update.tmpname ) ) );
+    AssertCrash( NumFiles( index ) == _countof( contents ) - round );
+
+    ForEach( key, keys ) {
+      auto key_len = CstrLength( key );
+      stack_resizeable_cont_t<u32> files;
+      Alloc( files, 16 );
+      TrigramIndexQuery( index, files, key, key_len );
+      For( i, 0, NumFiles( index ) ) {
+        u32 file = 0;
+        sscanf( Cast( char*, FileName( index, i ).mem ) + 4, "%02u", &file );
+        idx_t pos;
+        bool match = StringIdxScanR( &pos, contents[file], CstrLength( contents[file] ), 0, key, key_len, 0, 0 );
+        bool candidate = 0;
+        ForLen( j, files ) {
+          candidate |= files.mem[j] == i;
+        }
+        // every match has to be a candidate, and for keys of 3+ chars these contents have no false positives.
+        AssertCrash( !match  ||  candidate );
+        AssertCrash( key_len < 3  ||  match == candidate );
+      }
+      Free( files );
+    }
+
+    old = index;
+    Kill( update );
+  }
+  Free( old );
+  FileDelete( ML( filename ) );
+});
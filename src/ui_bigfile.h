@@ -0,0 +1,784 @@
+// Copyright (c) John A. Carlos Jr., all rights reserved.
+
+//
+// editor mode for files too big for a buf_t; see bigfile.h.
+// it's a line list, rather than a full txt_t: you scroll, find, go to a line, and edit one line at a time.
+//
+
+constant u64 c_bigfile_min_size = 1024ULL*1024*1024;
+constant u64 c_bigfile_find_lines_per_frame = 64*1024;
+constant idx_t c_bigfile_render_max_linelen = 1024;
+
+Enumc( bigfilefocus_t )
+{
+  view,
+  find,
+  gotoline,
+  editline,
+};
+
+struct
+bigfileview_t
+{
+  bigfile_t bf;
+  bool opened;
+  idx_t nlines; // mirror of BigfileNLines, for the listview.
+  listview_t listview;
+  bigfilefocus_t focus;
+  txt_t find;
+  txt_t gotoline;
+  txt_t editline;
+  bool case_sens;
+  bool word_boundary;
+  slice_t status;
+
+  // an in-progress find, which we advance a budgeted number of lines per frame.
+  bool finding;
+  bool find_wrapped;
+  u64 find_start_y;
+  u64 find_y;
+  idx_t find_x;
+  string_t find_key;
+
+  bool match_valid;
+  u64 match_y;
+  idx_t match_x;
+  idx_t match_len;
+
+  // a goto past what we've indexed so far waits here until the index catches up.
+  bool goto_pending;
+  u64 goto_y;
+};
+
+Inl void
+Init( bigfileview_t& bv )
+{
+  Zero( bv.bf );
+  bv.opened = 0;
+  bv.nlines = 0;
+  Init( &bv.listview, &bv.nlines );
+  bv.focus = bigfilefocus_t::view;
+  Init( bv.find );
+  TxtLoadEmpty( bv.find );
+  Init( bv.gotoline );
+  TxtLoadEmpty( bv.gotoline );
+  Init( bv.editline );
+  TxtLoadEmpty( bv.editline );
+  bv.case_sens = 0;
+  bv.word_boundary = 0;
+  bv.status = {};
+  bv.finding = 0;
+  bv.find_wrapped = 0;
+  bv.find_start_y = 0;
+  bv.find_y = 0;
+  bv.find_x = 0;
+  bv.find_key = {};
+  bv.match_valid = 0;
+  bv.match_y = 0;
+  bv.match_x = 0;
+  bv.match_len = 0;
+  bv.goto_pending = 0;
+  bv.goto_y = 0;
+}
+
+Inl void
+BigfileviewClose( bigfileview_t& bv )
+{
+  if( bv.opened ) {
+    Kill( bv.bf );
+    bv.opened = 0;
+  }
+  bv.nlines = 0;
+  ListviewResetCS( &bv.listview );
+  bv.focus = bigfilefocus_t::view;
+  bv.status = {};
+  bv.finding = 0;
+  Free( bv.find_key );
+  bv.find_key = {};
+  bv.match_valid = 0;
+  bv.goto_pending = 0;
+}
+
+Inl void
+Kill( bigfileview_t& bv )
+{
+  BigfileviewClose( bv );
+  Kill( &bv.listview );
+  Kill( bv.find );
+  Kill( bv.gotoline );
+  Kill( bv.editline );
+}
+
+Inl bool
+BigfileviewIsOpen( bigfileview_t& bv, u8* name, idx_t name_len )
+{
+  return bv.opened  &&  bv.bf.filename.len == name_len  &&  MemEqual( bv.bf.filename.mem, name, name_len );
+}
+
+Inl bool
+BigfileviewOpen( bigfileview_t& bv, u8* name, idx_t name_len )
+{
+  BigfileviewClose( bv );
+  bv.opened = BigfileOpen( bv.bf, name, name_len );
+  return bv.opened;
+}
+
+Inl void
+_BigfileviewClearTxt( txt_t& txt )
+{
+  CmdSelectAll( txt );
+  CmdRemChL( txt );
+}
+
+#define __BigfileCmd( name )   void ( name )( bigfileview_t& bv, idx_t misc = 0 )
+#define __BigfileCmdDef( name )   void ( name )( bigfileview_t& bv, idx_t misc )
+typedef __BigfileCmdDef( *pfn_bigfilecmd_t );
+
+__BigfileCmd( CmdBigfileCursorU )
+{
+  ListviewCursorU( &bv.listview, misc );
+}
+__BigfileCmd( CmdBigfileCursorD )
+{
+  ListviewCursorD( &bv.listview, misc );
+}
+__BigfileCmd( CmdBigfileScrollU )
+{
+  ListviewScrollU( &bv.listview, misc );
+}
+__BigfileCmd( CmdBigfileScrollD )
+{
+  ListviewScrollD( &bv.listview, misc );
+}
+
+__BigfileCmd( CmdBigfileToggleCaseSens )
+{
+  bv.case_sens = !bv.case_sens;
+}
+__BigfileCmd( CmdBigfileToggleWordBoundary )
+{
+  bv.word_boundary = !bv.word_boundary;
+}
+
+__BigfileCmd( CmdBigfileFocusView )
+{
+  bv.focus = bigfilefocus_t::view;
+}
+__BigfileCmd( CmdBigfileFocusFind )
+{
+  bv.focus = bigfilefocus_t::find;
+  CmdSelectAll( bv.find );
+}
+__BigfileCmd( CmdBigfileFocusGotoline )
+{
+  bv.focus = bigfilefocus_t::gotoline;
+  _BigfileviewClearTxt( bv.gotoline );
+}
+
+__BigfileCmd( CmdBigfileFocusEditline )
+{
+  if( !bv.nlines ) {
+    return;
+  }
+  if( !BigfileCanEdit( bv.bf ) ) {
+    bv.status = SliceFromCStr( "Can't edit until indexing finishes." );
+    return;
+  }
+  bv.focus = bigfilefocus_t::editline;
+  _BigfileviewClearTxt( bv.editline );
+  auto line = BigfileLine( bv.bf, bv.listview.cursor );
+  CmdAddString( bv.editline, Cast( idx_t, line.mem ), line.len );
+}
+
+// starts a find at the cursor, just past the current match if the cursor is on it.
+__BigfileCmd( CmdBigfileFindR )
+{
+  Free( bv.find_key );
+  bv.find_key = AllocContents( &bv.find.buf, eoltype_t::crlf );
+  if( !bv.find_key.len ) {
+    bv.finding = 0;
+    return;
+  }
+  bv.finding = 1;
+  bv.find_wrapped = 0;
+  bv.find_y = bv.listview.cursor;
+  bv.find_x = 0;
+  if( bv.match_valid  &&  bv.match_y == bv.find_y ) {
+    bv.find_x = bv.match_x + 1;
+  }
+  bv.find_start_y = bv.find_y;
+  bv.match_valid = 0;
+  bv.status = SliceFromCStr( "Finding..." );
+}
+
+Inl void
+_BigfileviewGoto( bigfileview_t& bv, u64 y )
+{
+  bv.listview.cursor = Cast( idx_t, y );
+  ListviewMakeCursorVisible( &bv.listview );
+}
+
+Inl void
+BigfileviewGotoline( bigfileview_t& bv, u64 y )
+{
+  bv.nlines = Cast( idx_t, BigfileNLines( bv.bf ) );
+  if( y < bv.nlines  ||  bv.bf.index_done ) {
+    bv.goto_pending = 0;
+    _BigfileviewGoto( bv, y );
+  }
+  else {
+    bv.goto_pending = 1;
+    bv.goto_y = y;
+    bv.status = SliceFromCStr( "Waiting for indexing to reach that line..." );
+  }
+}
+
+Inl void
+_BigfileviewUpdateFind( bigfileview_t& bv )
+{
+  if( !bv.finding ) {
+    return;
+  }
+  auto budget = c_bigfile_find_lines_per_frame;
+  if( bv.find_wrapped ) {
+    // past the start means we've looked at everything.
+    if( bv.find_y > bv.find_start_y ) {
+      bv.finding = 0;
+      bv.status = SliceFromCStr( "Not found." );
+      return;
+    }
+    budget = MIN( budget, bv.find_start_y - bv.find_y + 1 );
+  }
+  auto result = BigfileFindR( bv.bf, &bv.find_y, &bv.find_x, ML( bv.find_key ), bv.case_sens, bv.word_boundary, budget );
+  switch( result ) {
+    case bigfile_findresult_t::found: {
+      bv.finding = 0;
+      bv.match_valid = 1;
+      bv.match_y = bv.find_y;
+      bv.match_x = bv.find_x;
+      bv.match_len = bv.find_key.len;
+      bv.status = {};
+      _BigfileviewGoto( bv, bv.find_y );
+    } break;
+    case bigfile_findresult_t::notfound: {
+      if( bv.find_wrapped ) {
+        bv.finding = 0;
+        bv.status = SliceFromCStr( "Not found." );
+      }
+      else {
+        bv.find_wrapped = 1;
+        bv.find_y = 0;
+        bv.find_x = 0;
+      }
+    } break;
+    case bigfile_findresult_t::budget: {
+    } break;
+    default: UnreachableCrash();
+  }
+}
+
+__BigfileCmd( CmdBigfileGotolineChoose )
+{
+  auto gotoline = AllocContents( &bv.gotoline.buf, eoltype_t::crlf );
+  bool valid = gotoline.len > 0;
+  For( i, 0, gotoline.len ) {
+    if( !AsciiIsNumber( gotoline.mem[i] ) ) {
+      valid = 0;
+      break;
+    }
+  }
+  if( valid ) {
+    auto lineno = CsTo_u64( ML( gotoline ) );
+    if( lineno ) {
+      lineno -= 1;
+    }
+    BigfileviewGotoline( bv, lineno );
+    bv.focus = bigfilefocus_t::view;
+  }
+  Free( gotoline );
+}
+
+__BigfileCmd( CmdBigfileEditlineApply )
+{
+  if( !bv.nlines  ||  !BigfileCanEdit( bv.bf ) ) {
+    return;
+  }
+  auto line = AllocContents( &bv.editline.buf, eoltype_t::crlf );
+  BigfileReplaceLine( bv.bf, bv.listview.cursor, ML( line ) );
+  Free( line );
+  bv.match_valid = 0;
+  bv.focus = bigfilefocus_t::view;
+}
+
+__BigfileCmd( CmdBigfileChoose )
+{
+  switch( bv.focus ) {
+    case bigfilefocus_t::view: {
+      CmdBigfileFocusEditline( bv );
+    } break;
+    case bigfilefocus_t::find: {
+      CmdBigfileFindR( bv );
+    } break;
+    case bigfilefocus_t::gotoline: {
+      CmdBigfileGotolineChoose( bv );
+    } break;
+    case bigfilefocus_t::editline: {
+      CmdBigfileEditlineApply( bv );
+    } break;
+    default: UnreachableCrash();
+  }
+}
+
+// inserts an empty line below the cursor, and moves onto it.
+__BigfileCmd( CmdBigfileInsertLine )
+{
+  if( !BigfileCanEdit( bv.bf ) ) {
+    bv.status = SliceFromCStr( "Can't edit until indexing finishes." );
+    return;
+  }
+  auto y = bv.nlines  ?  bv.listview.cursor + 1  :  0;
+  BigfileInsertLine( bv.bf, y, 0, 0 );
+  bv.nlines = Cast( idx_t, BigfileNLines( bv.bf ) );
+  bv.match_valid = 0;
+  _BigfileviewGoto( bv, y );
+}
+
+__BigfileCmd( CmdBigfileRemoveLine )
+{
+  if( !bv.nlines ) {
+    return;
+  }
+  if( !BigfileCanEdit( bv.bf ) ) {
+    bv.status = SliceFromCStr( "Can't edit until indexing finishes." );
+    return;
+  }
+  BigfileRemoveLine( bv.bf, bv.listview.cursor );
+  bv.nlines = Cast( idx_t, BigfileNLines( bv.bf ) );
+  bv.match_valid = 0;
+  ListviewFixupCS( &bv.listview );
+}
+
+__BigfileCmd( CmdBigfileSave )
+{
+  if( !bv.opened  ||  !bv.bf.unsaved ) {
+    return;
+  }
+  if( !BigfileCanEdit( bv.bf ) ) {
+    bv.status = SliceFromCStr( "Can't save until indexing finishes." );
+    return;
+  }
+  auto saved = BigfileSave( bv.bf );
+  bv.opened = bv.bf.mapping.loaded;
+  bv.finding = 0;
+  bv.match_valid = 0;
+  bv.status = saved  ?  SliceFromCStr( "Saved." )  :  SliceFromCStr( "Save failed!" );
+}
+
+Enumc( bigfilelayer_t )
+{
+  bkgd,
+  sel,
+  txt,
+
+  COUNT
+};
+
+void
+BigfileviewRender(
+  bigfileview_t& bv,
+  bool& target_valid,
+  stack_resizeable_cont_t<f32>& stream,
+  font_t& font,
+  rectf32_t bounds,
+  vec2<f32> zrange,
+  f64 timestep_realtime,
+  f64 timestep_fixed
+  )
+{
+  ProfFunc();
+
+  auto timestep = MIN( timestep_realtime, timestep_fixed );
+
+  auto spaces_per_tab = GetPropFromDb( u8, u8_spaces_per_tab );
+  auto rgba_text = GetPropFromDb( vec4<f32>, rgba_text );
+  auto rgba_lineno = GetPropFromDb( vec4<f32>, rgba_lineno );
+  auto rgba_cursor_text = GetPropFromDb( vec4<f32>, rgba_cursor_text );
+  auto rgba_wordmatch_bkgd = GetPropFromDb( vec4<f32>, rgba_wordmatch_bkgd );
+
+  auto line_h = FontLineH( font );
+
+  if( !bv.opened ) {
+    return;
+  }
+
+  // lines keep arriving while we index, and finds run a slice per frame, so keep the frames coming.
+  auto& bf = bv.bf;
+  bv.nlines = Cast( idx_t, BigfileNLines( bf ) );
+  if( bv.goto_pending  &&  ( bv.goto_y < bv.nlines  ||  bf.index_done ) ) {
+    bv.goto_pending = 0;
+    bv.status = {};
+    _BigfileviewGoto( bv, bv.goto_y );
+  }
+  _BigfileviewUpdateFind( bv );
+  if( bv.finding  ||  !bf.index_done ) {
+    target_valid = 0;
+  }
+
+  { // header
+    string_t label;
+    if( bf.index_failed ) {
+      label = AllocFormattedString( "%s -- failed to index!", bf.filename.mem );
+    }
+    elif( !bf.index_done ) {
+      auto pct = ( bf.bytes_indexed * 100.0 ) / MAX( bf.mapping.size, 1 );
+      label = AllocFormattedString( "%s -- %llu lines, %.2f%% indexed...", bf.filename.mem, Cast( u64, bv.nlines ), pct );
+    }
+    else {
+      label = AllocFormattedString( "%s%s -- %llu lines", bf.filename.mem, bf.unsaved  ?  "*"  :  "", Cast( u64, bv.nlines ) );
+    }
+    DrawString(
+      stream,
+      font,
+      bounds.p0,
+      GetZ( zrange, bigfilelayer_t::txt ),
+      bounds,
+      rgba_text,
+      spaces_per_tab,
+      ML( label )
+      );
+    Free( label );
+
+    auto flags = AllocFormattedString( "Case sensitive: %u  Whole word: %u", bv.case_sens, bv.word_boundary );
+    auto flags_w = LayoutString( font, spaces_per_tab, ML( flags ) );
+    DrawString(
+      stream,
+      font,
+      AlignRight( bounds, flags_w ),
+      GetZ( zrange, bigfilelayer_t::txt ),
+      bounds,
+      rgba_text,
+      spaces_per_tab,
+      ML( flags )
+      );
+    Free( flags );
+
+    bounds.p0.y = MIN( bounds.p0.y + line_h, bounds.p1.y );
+  }
+
+  static const auto label_find = SliceFromCStr( "Find: " );
+  auto label_find_w = LayoutString( font, spaces_per_tab, ML( label_find ) );
+
+  static const auto label_gotoline = SliceFromCStr( "Go to line: " );
+  auto label_gotoline_w = LayoutString( font, spaces_per_tab, ML( label_gotoline ) );
+
+  static const auto label_editline = SliceFromCStr( "Edit line: " );
+  auto label_editline_w = LayoutString( font, spaces_per_tab, ML( label_editline ) );
+
+  auto maxlabelw = MAX3( label_find_w, label_gotoline_w, label_editline_w );
+
+  #define DRAW_TEXTBOXLINE( _txt, _label, _labelw, _maxlabelw, _infocus ) \
+    DrawString( \
+      stream, \
+      font, \
+      bounds.p0 + _vec2( _maxlabelw - _labelw, 0.0f ), \
+      GetZ( zrange, bigfilelayer_t::txt ), \
+      bounds, \
+      rgba_text, \
+      spaces_per_tab, \
+      ML( _label ) \
+      ); \
+    TxtRenderSingleLineSubset( \
+      _txt, \
+      stream, \
+      font, \
+      0, \
+      _rect( bounds.p0 + _vec2( _maxlabelw, 0.0f ), bounds.p1 ), \
+      ZRange( zrange, bigfilelayer_t::txt ), \
+      0, \
+      _infocus, \
+      _infocus \
+      ); \
+    bounds.p0.y = MIN( bounds.p0.y + line_h, bounds.p1.y ); \
+
+  DRAW_TEXTBOXLINE(
+    bv.find,
+    label_find,
+    label_find_w,
+    maxlabelw,
+    ( bv.focus == bigfilefocus_t::find )
+    );
+
+  DRAW_TEXTBOXLINE(
+    bv.gotoline,
+    label_gotoline,
+    label_gotoline_w,
+    maxlabelw,
+    ( bv.focus == bigfilefocus_t::gotoline )
+    );
+
+  DRAW_TEXTBOXLINE(
+    bv.editline,
+    label_editline,
+    label_editline_w,
+    maxlabelw,
+    ( bv.focus == bigfilefocus_t::editline )
+    );
+
+  { // status
+    if( bv.status.len ) {
+      auto status_w = LayoutString( font, spaces_per_tab, ML( bv.status ) );
+      DrawString(
+        stream,
+        font,
+        AlignCenter( bounds, status_w ),
+        GetZ( zrange, bigfilelayer_t::txt ),
+        bounds,
+        rgba_text,
+        spaces_per_tab,
+        ML( bv.status )
+        );
+    }
+    bounds.p0.y = MIN( bounds.p0.y + line_h, bounds.p1.y );
+  }
+
+  tslice_t<listview_rect_t> lines;
+  ListviewUpdateScrollingAndRenderScrollbar(
+    &bv.listview,
+    target_valid,
+    stream,
+    font,
+    bounds,
+    zrange,
+    timestep,
+    &lines
+    );
+
+  if( !lines.len ) {
+    return;
+  }
+
+  // size the line number column for the largest line number.
+  u8 lineno[64];
+  idx_t lineno_len = 0;
+  CsFromIntegerU( AL( lineno ), &lineno_len, Cast( u64, bv.nlines ) );
+  TSet( lineno, lineno_len, Cast( u8, '0' ) );
+  Memmove( lineno + lineno_len, "  ", 2 );
+  auto lineno_w = LayoutString( font, spaces_per_tab, lineno, lineno_len + 2 );
+
+  auto first_line = lines.mem[0].row_idx;
+  For( i, 0, lines.len ) {
+    auto y = first_line + i;
+    auto is_cursor = y == bv.listview.cursor;
+    auto line_p0 = bounds.p0 + _vec2( 0.0f, line_h * i );
+    auto line_p1 = _vec2( bounds.p1.x, line_p0.y + line_h );
+
+    CsFromIntegerU( AL( lineno ), &lineno_len, Cast( u64, y + 1 ) );
+    DrawString(
+      stream,
+      font,
+      line_p0,
+      GetZ( zrange, bigfilelayer_t::txt ),
+      bounds,
+      rgba_lineno,
+      spaces_per_tab,
+      lineno, lineno_len
+      );
+    line_p0.x += lineno_w;
+
+    auto line = BigfileLine( bf, y );
+    line.len = MIN( line.len, c_bigfile_render_max_linelen );
+
+    if( bv.match_valid  &&  bv.match_y == y  &&  bv.match_x < line.len ) {
+      auto match_len = MIN( bv.match_len, line.len - bv.match_x );
+      auto match_start = LayoutString( font, spaces_per_tab, line.mem, bv.match_x );
+      auto match_w = LayoutString( font, spaces_per_tab, line.mem + bv.match_x, match_len );
+      RenderQuad(
+        stream,
+        rgba_wordmatch_bkgd,
+        line_p0 + _vec2( match_start, 0.0f ),
+        _vec2( line_p0.x + match_start + match_w, line_p1.y ),
+        bounds,
+        GetZ( zrange, bigfilelayer_t::sel )
+        );
+    }
+
+    DrawString(
+      stream,
+      font,
+      line_p0,
+      GetZ( zrange, bigfilelayer_t::txt ),
+      bounds,
+      is_cursor  ?  rgba_cursor_text  :  rgba_text,
+      spaces_per_tab,
+      ML( line )
+      );
+  }
+
+#undef DRAW_TEXTBOXLINE
+}
+
+void
+BigfileviewControlMouse(
+  bigfileview_t& bv,
+  bool& target_valid,
+  font_t& font,
+  rectf32_t bounds,
+  glwmouseevent_t type,
+  glwmousebtn_t btn,
+  vec2<s32> m,
+  vec2<s32> raw_delta,
+  s32 dwheel
+  )
+{
+  bool double_clicked_on_line = 0;
+  ListviewControlMouse(
+    &bv.listview,
+    target_valid,
+    font,
+    bounds,
+    type,
+    btn,
+    m,
+    raw_delta,
+    dwheel,
+    &double_clicked_on_line
+    );
+  if( double_clicked_on_line ) {
+    CmdBigfileFocusEditline( bv );
+  }
+}
+
+
+// =================================================================================
+// KEYBOARD
+
+struct
+bigfile_cmdmap_t
+{
+  glwkeybind_t keybind;
+  pfn_bigfilecmd_t fn;
+  idx_t misc;
+};
+
+Inl bigfile_cmdmap_t
+_bigfilecmdmap(
+  glwkeybind_t keybind,
+  pfn_bigfilecmd_t fn,
+  idx_t misc = 0
+  )
+{
+  bigfile_cmdmap_t r;
+  r.keybind = keybind;
+  r.fn = fn;
+  r.misc = misc;
+  return r;
+}
+
+Inl void
+ExecuteCmdMap(
+  bigfileview_t& bv,
+  bigfile_cmdmap_t* table,
+  idx_t table_len,
+  glwkey_t key,
+  bool& target_valid,
+  bool& ran_cmd
+  )
+{
+  For( i, 0, table_len ) {
+    auto entry = table + i;
+    if( GlwKeybind( key, entry->keybind ) ) {
+      entry->fn( bv, entry->misc );
+      target_valid = 0;
+      ran_cmd = 1;
+    }
+  }
+}
+
+void
+BigfileviewControlKeyboard(
+  bigfileview_t& bv,
+  bool kb_command,
+  bool& target_valid,
+  bool& ran_cmd,
+  glwkeyevent_t type,
+  glwkey_t key,
+  glwkeylocks_t& keylocks
+  )
+{
+  ProfFunc();
+
+  if( !bv.opened ) {
+    return;
+  }
+
+  if( kb_command ) {
+    switch( type ) {
+      case glwkeyevent_t::dn: {
+        bigfile_cmdmap_t table[] = {
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_choose          ), CmdBigfileChoose        ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_focus_view      ), CmdBigfileFocusView     ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_focus_find      ), CmdBigfileFocusFind     ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_focus_gotoline  ), CmdBigfileFocusGotoline ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_focus_editline  ), CmdBigfileFocusEditline ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_insertline      ), CmdBigfileInsertLine    ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_removeline      ), CmdBigfileRemoveLine    ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_save                    ), CmdBigfileSave          ),
+        };
+        ExecuteCmdMap( bv, AL( table ), key, target_valid, ran_cmd );
+      } __fallthrough;
+
+      case glwkeyevent_t::repeat: {
+        bigfile_cmdmap_t table[] = {
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_find_r                ), CmdBigfileFindR              ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_cursor_u              ), CmdBigfileCursorU            ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_cursor_d              ), CmdBigfileCursorD            ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_cursor_page_u         ), CmdBigfileCursorU            , bv.listview.pageupdn_distance ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_cursor_page_d         ), CmdBigfileCursorD            , bv.listview.pageupdn_distance ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_scroll_u              ), CmdBigfileScrollU            , Cast( idx_t, GetPropFromDb( f32, f32_lines_per_jump ) ) ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_scroll_d              ), CmdBigfileScrollD            , Cast( idx_t, GetPropFromDb( f32, f32_lines_per_jump ) ) ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_scroll_page_u         ), CmdBigfileScrollU            , bv.listview.pageupdn_distance ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_scroll_page_d         ), CmdBigfileScrollD            , bv.listview.pageupdn_distance ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_toggle_case_sensitive ), CmdBigfileToggleCaseSens     ),
+          _bigfilecmdmap( GetPropFromDb( glwkeybind_t, keybind_bigfile_toggle_word_boundary  ), CmdBigfileToggleWordBoundary ),
+        };
+        ExecuteCmdMap( bv, AL( table ), key, target_valid, ran_cmd );
+      } break;
+
+      case glwkeyevent_t::up: {
+      } break;
+
+      default: UnreachableCrash();
+    }
+  }
+
+  if( !ran_cmd ) {
+    txt_t* txt = 0;
+    switch( bv.focus ) {
+      case bigfilefocus_t::view: {
+      } break;
+      case bigfilefocus_t::find: {
+        txt = &bv.find;
+      } break;
+      case bigfilefocus_t::gotoline: {
+        txt = &bv.gotoline;
+      } break;
+      case bigfilefocus_t::editline: {
+        txt = &bv.editline;
+      } break;
+      default: UnreachableCrash();
+    }
+    if( txt ) {
+      bool content_changed = 0;
+      TxtControlKeyboardSingleLine(
+        *txt,
+        kb_command,
+        target_valid,
+        content_changed,
+        ran_cmd,
+        type,
+        key,
+        keylocks
+        );
+    }
+  }
+}
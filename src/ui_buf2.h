@@ -286,7 +286,8 @@
 // - store an 'edited' flag on each line, and only do the stack_implicitcapacity_t thing on those lines. from-file lines stay exact-bounded.
 // note we'd have to be careful about when we set/reset line flags.
 //
-// we'd also need to change how we store line modify undos, since right now it's an entire-line swap.
+// line modify undos store just the changed middle of the line now, so they don't hold on to the old contents.
+// edited lines are individually heap allocated, see _AllocLine, which is most of the way there.
 //
 
 //
@@ -377,6 +378,7 @@
 // i can also imagine 'unsaved_changes', which we render somehow to show what's locally changed.
 // maybe we render 'edited' too; VS does this with a yellow for 'unsaved_changes', green for 'edited', blank else.
 constant u32 lineflag_bit_arrayline = 0;
+constant u32 lineflag_bit_owned = 1; // mem is our own heap allocation, rather than pointing into the original file.
 
 struct
 line_t
@@ -389,53 +391,45 @@ line_t
 Enumc( undoableopertype_t )
 {
   checkpt,
-  add, // new slice stored in slice_new
-  mod, // change stored in slice_old -> slice_new
-  rem, // old slice stored in slice_old
+  add, // new line stored in full.
+  mod, // old -> new, stored as the common prefix/suffix lens, plus the differing middles.
+  rem, // old line stored in full.
   permuteu,
   permuted,
+  insrun, // a run of single chars typed left to right on one line. each char is its own undo step.
 };
 
-#define PAGEHISTORY   0
-// TODO: for massive copy/paste, we generate separate opers for each line.
-// this leads to massive expansion of the buf's history.
-// undoableoper_t is ~40bytes right now, so we can have ~2M of them before we blow up the stack_resizeable_cont_t len threshold.
-// we should consider ways to cut down on the history size in that case.
-// we may also have to convert history to be a pagearray or something else.
-// linkedlist structures are totally fine, since we only iterate element at a time. no random accessing.
-//
-// i'd prefer we add some bulk-line opers, since we push many line edits at once; see ForwardLineOper called in loops.
-// even with that mitigation though, we probably still want pagearray / list of some kind here.
-// using list_t adds 16bytes for forward and back listelem_t pointers, per oper.
-// that's kind of a lot, relative to ~40bytes. so i think i'd prefer pagearray.
-// pagearray has more complicated iteration, but it's likely worth it here.
-//
-// one more question is: should we use the buf_t pagelist, or make another pagelist on the buf_t for these opers?
-// i think we're already copying lines to the existing pagelist, so probably that's fine.
-// indeed, line edits always create new contents in the existing pagelist, preserving the old one in place.
-// if we ever want to allow dynamic history deletion, then a separate pagelist might be nice to have.
-//
-// another size optimization we could do is one-line diffing, for oper type mod.
-// when we're replacing a subset of the line, we don't need to preserve the old line in it's entirety.
-// this goes hand in hand with the line_t flags for marking is_pointing_to_original_file, and leaving
-// extra allocation space when that's not the case.
+// the undo history is an append-only byte log of variable-length records, oldest first:
+//   u8 type
+//   checkpt:            nothing
+//   add, rem:           dy, len, contents
+//   mod:                dy, prefix_len, suffix_len, old_len, old contents, new_len, new contents
+//   permuteu, permuted: dy, y_end - y_start
+//   insrun:             u32 len of the rest, dy, x, chars
+//   backlen: the record's len as a varint stored byte-reversed, so we can walk the log backwards.
+// all the numbers besides the insrun len are varints. dy is the zigzag delta from the last record's y,
+// since edits tend to cluster. the insrun len is fixed size so we can extend the run in place.
+//
+// the old format was a ~40 byte oper per line edit, holding on to full copies of both lines in the pagelist.
+// typing a char is now usually 1 byte in an existing insrun, and lines edited in place are heap allocated
+// and freed once their replacement is logged, so memory is the live text plus the log.
+// the log is capped at max_bytes; past that, we drop ( or spill to a file, if set ) the oldest half,
+// cutting only at checkpt boundaries, so we never leave a partial undo group behind.
 struct
-undoableoper_t
+bufhistory_t
 {
-  undoableopertype_t type;
-  union {
-    struct { // for add, mod, rem
-      u32 y;
-      line_t line_old;
-      line_t line_new;
-    };
-    struct { // for permuteu, permuted
-      u32 y_start;
-      u32 y_end;
-    };
-  };
+  stack_resizeable_cont_t<u8> log;
+  idx_t pos; // end of the last applied record. records past this are redoable.
+  u32 run_undone; // how many trailing chars of the insrun record ending at pos are currently undone.
+  bool checkpt_pending; // UndoCheckpt defers writing, so a following char can extend an insrun instead.
+  s64 y_last; // y of the last applied record that has one.
+  idx_t max_bytes;
+  file_t spill; // when loaded, dropped history is appended here as [segment][u64 segment len], newest last.
 };
 
+// the default cap on buf history bytes, per buf.
+constant idx_t c_bufhistory_max_bytes = 32*1024*1024;
+
 // NOTE: this value is tied to our use of pagetree_11x2_t in buf_t below.
 // we use the lowest 10 bits for within-lineblock addressing, and the highest 22 bits for pagetree addressing.
 // just as an additional note, we probably want c_lineblock_size to be >= 2 * nlines_visible, so rendering happens in one block.
@@ -448,39 +442,31 @@ lineblock_t
 };
 
 // to access a line, this is the model:
-//   line = AccessLine( &buf->internal_lineblocks, buf->internal_idx_from_line.mem[ line ] )
+//   line = AccessLine( &buf->internal_lineblocks, *LinetreeLookup( buf->internal_idx_from_line, line ) )
 struct
 buf_t
 {
   pagelist_t pagelist;
-  // TODO: we hit array limits on internal_idx_from_line.
-  //   our current limit is 100MB for regular arrays, which is 25M lines.
   // this is what's encoding line ordering, so we can't use an unordered hash map for example.
-  // one interesting idea is maybe to use a linked list, so we don't have to slide array elements over.
-  //
-  //
-  stack_resizeable_cont_t<u32> internal_idx_from_line; // len = number of actual lines.
-  stack_resizeable_cont_t<u32> unused_internal_idxs; // len = O( max len of internal_idx_from_line )
+  // it used to be a plain array, which made line ins/del O( num_lines ), and fell over around ~1M lines.
+  // the linetree keeps those O( log num_lines ), and tracks line lens so we can map linear space -> line space too.
+  linetree_t internal_idx_from_line; // nlines = number of actual lines.
+  stack_resizeable_cont_t<u32> unused_internal_idxs; // len = O( max nlines of internal_idx_from_line )
 #if LB
   // PERF: This used to be allocator_pagelist_t, and that's likely faster.
   pagetree_11x2_t internal_lineblocks;
 #else
   stack_resizeable_cont_t<line_t> unordered_lines; // TODO: do something different. see above comment blocks.
 #endif
-#if PAGEHISTORY
-#else
-  stack_resizeable_cont_t<undoableoper_t> history; // TODO: do something different. this can blow past stack_resizeable_cont_t limits.
-  idx_t history_idx;
-#endif
+  bufhistory_t history;
+  stack_resizeable_cont_t<u8*> lines_to_free; // owned line contents replaced during an edit; see _FreeLineLater.
   string_t orig_file_contents;
 };
 
 Inl u32
 NLines( buf_t* buf )
 {
-  auto r = buf->internal_idx_from_line.len;
-  AssertCrash( r <= MAX_u32 );
-  return Cast( u32, r );
+  return buf->internal_idx_from_line.nlines;
 }
 
 Inl u32
@@ -526,72 +512,65 @@ AccessLine( buf_t* buf, u32 internal_idx )
 #endif
 
 
+// note we use TryAccessLine since the lines should already exist if we're looking them up.
+Inl line_t*
+LineFromInternal( buf_t* buf, u32 internal_idx )
+{
 #if LB
+  auto linemem = TryAccessLine( buf, internal_idx );
+#else
+  auto linemem = buf->unordered_lines.mem + internal_idx;
+#endif
+  AssertCrash( linemem );
+  return linemem;
+}
 
-// note we use TryAccessLine since the lines should already exist if we're iterating over them.
+Inl line_t*
+LineFromY( buf_t* buf, u32 y )
+{
+//  ProfFunc();
+  AssertCrash( y < NLines( buf ) );
+  return LineFromInternal( buf, *LinetreeLookup( buf->internal_idx_from_line, y ) );
+}
 
-#define FORALLLINES( _buf, _linemem, _lineidx ) \
-  Fori( u32, _lineidx, 0, NLines( _buf ) ) { \
-    auto _linemem = TryAccessLine( ( _buf ), ( _buf )->internal_idx_from_line.mem[ _lineidx ] ); \
-    AssertCrash( _linemem ); \
+// linear space -> line space, assuming every line ends in an eol of eol_len.
+// returns 0 if offset is past the end.
+Inl bool
+LinearToLineSpace( buf_t* buf, idx_t offset, idx_t eol_len, u32* x, u32* y )
+{
+  AssertCrash( eol_len <= MAX_u32 );
+  u64 x_found;
+  if( !LinetreeFromOffset( buf->internal_idx_from_line, offset, Cast( u32, eol_len ), y, &x_found ) ) {
+    return 0;
+  }
+  AssertCrash( x_found <= MAX_u32 );
+  *x = Cast( u32, x_found );
+  return 1;
+}
 
+// forward iteration walks the linetree leaves, so it's O( 1 ) per line.
+// the loop body can modify line contents, but can't insert or remove lines.
 #define FORLINES( _buf, _linemem, _lineidx, _line_start, _line_end ) \
   AssertCrash( _line_start <= _line_end ); \
   AssertCrash( _line_end <= NLines( _buf ) ); \
-  Fori( u32, _lineidx, _line_start, _line_end ) { \
-    auto _linemem = TryAccessLine( ( _buf ), ( _buf )->internal_idx_from_line.mem[ _lineidx ] ); \
-    AssertCrash( _linemem ); \
-
-#define REVERSEFORLINES( _buf, _linemem, _lineidx, _line_start, _line_end ) \
-  AssertCrash( _line_start <= _line_end ); \
-  AssertCrash( _line_end <= NLines( _buf ) ); \
-  ReverseFori( u32, _lineidx, _line_start, _line_end ) { \
-    auto _linemem = TryAccessLine( ( _buf ), ( _buf )->internal_idx_from_line.mem[ _lineidx ] ); \
-    AssertCrash( _linemem ); \
-
-#else
+  for( \
+    auto _lineidx##_iter = LinetreeIter( ( _buf )->internal_idx_from_line, _line_start ); \
+    _lineidx##_iter.y < ( _line_end ); \
+    LinetreeIterNext( _lineidx##_iter ) ) { \
+    auto _lineidx = _lineidx##_iter.y; \
+    auto _linemem = LineFromInternal( ( _buf ), *LinetreeIterValue( _lineidx##_iter ) ); \
 
 #define FORALLLINES( _buf, _linemem, _lineidx ) \
-  Fori( u32, _lineidx, 0, NLines( _buf ) ) { \
-    auto _linemem = ( _buf )->unordered_lines.mem + ( _buf )->internal_idx_from_line.mem[ _lineidx ]; \
-
-#define FORLINES( _buf, _linemem, _lineidx, _line_start, _line_end ) \
-  AssertCrash( _line_start <= _line_end ); \
-  AssertCrash( _line_end <= NLines( _buf ) ); \
-  Fori( u32, _lineidx, _line_start, _line_end ) { \
-    auto _linemem = ( _buf )->unordered_lines.mem + ( _buf )->internal_idx_from_line.mem[ _lineidx ]; \
+  FORLINES( _buf, _linemem, _lineidx, 0, NLines( _buf ) ) \
 
+// reverse iteration looks up each line, since the loop body is allowed to remove the line it's on.
 #define REVERSEFORLINES( _buf, _linemem, _lineidx, _line_start, _line_end ) \
   AssertCrash( _line_start <= _line_end ); \
   AssertCrash( _line_end <= NLines( _buf ) ); \
   ReverseFori( u32, _lineidx, _line_start, _line_end ) { \
-    auto _linemem = ( _buf )->unordered_lines.mem + ( _buf )->internal_idx_from_line.mem[ _lineidx ]; \
+    auto _linemem = LineFromY( ( _buf ), _lineidx ); \
     ( void )_linemem; \
 
-#endif
-
-#if LB
-Inl line_t*
-LineFromY( buf_t* buf, u32 y )
-{
-//  ProfFunc();
-  AssertCrash( y < NLines( buf ) );
-  auto linemem = TryAccessLine( buf, buf->internal_idx_from_line.mem[ y ] );
-  AssertCrash( linemem );
-  return linemem;
-}
-#else
-Inl line_t*
-LineFromY( buf_t* buf, u32 y )
-{
-  ProfFunc();
-  AssertCrash( y < NLines( buf ) );
-  auto linemem = buf->unordered_lines.mem + buf->internal_idx_from_line.mem[ y ];
-  AssertCrash( linemem );
-  return linemem;
-}
-#endif
-
 Inl bool
 IsEmpty( buf_t* buf )
 {
@@ -621,8 +600,10 @@ _CheckNoDupes(
   Alloc( counts, buf->unordered_lines.len );
   Memzero( AddBack( counts, buf->unordered_lines.len ), buf->unordered_lines.len );
 #endif
+  auto iter = LinetreeIter( buf->internal_idx_from_line, 0 );
   Fori( u32, i, 0, nlines ) {
-    auto internal = buf->internal_idx_from_line.mem[i];
+    auto internal = *LinetreeIterValue( iter );
+    LinetreeIterNext( iter );
     AssertCrash( !counts.mem[internal] );
     counts.mem[internal] = 1;
   }
@@ -667,7 +648,7 @@ LineInsert(
     line = AddBack( buf->unordered_lines );
   }
 #endif
-  *AddAt( buf->internal_idx_from_line, y ) = internal;
+  LinetreeInsert( buf->internal_idx_from_line, y, internal, line_new->len );
   *line = *line_new;
   _CheckNoDupes( buf );
 }
@@ -681,12 +662,9 @@ LineRemove(
 {
   ProfFunc();
   AssertCrash( y < NLines( buf ) );
-  auto internal = buf->internal_idx_from_line.mem[ y ];
-#if LB
-  auto removed = TryAccessLine( buf, internal );
-#else
-  auto removed = buf->unordered_lines.mem + internal;
-#endif
+  u32 internal;
+  LinetreeRemove( buf->internal_idx_from_line, y, &internal );
+  auto removed = LineFromInternal( buf, internal );
   if( verify_removed ) {
     AssertCrash( removed->mem == verify_removed->mem );
     AssertCrash( removed->len == verify_removed->len );
@@ -696,7 +674,6 @@ LineRemove(
   // this is so we could fixup the internal_idx_from_line entry for the line compaction.
   // that's a bit more expensive than we want here, so we do a reclamation strategy instead.
   *AddBack( buf->unused_internal_idxs ) = internal;
-  RemAt( buf->internal_idx_from_line, y );
   _CheckNoDupes( buf );
 }
 
@@ -715,6 +692,7 @@ LineReplace(
     AssertCrash( line->len == dst_verify->len );
   }
   *line = *src;
+  LinetreeSetLen( buf->internal_idx_from_line, y, src->len );
   _CheckNoDupes( buf );
 }
 
@@ -733,11 +711,10 @@ LinePermuteU(
     *moved = 0;
     return;
   }
-  auto first_internal = buf->internal_idx_from_line.mem[ y_start - 1 ];
-  Fori( u32, y, y_start - 1, y_end ) {
-    buf->internal_idx_from_line.mem[ y ] = buf->internal_idx_from_line.mem[ y + 1 ];
-  }
-  buf->internal_idx_from_line.mem[ y_end ] = first_internal;
+  // rotating the range by one is just moving the line above it to the bottom.
+  u32 first_internal;
+  LinetreeRemove( buf->internal_idx_from_line, y_start - 1, &first_internal );
+  LinetreeInsert( buf->internal_idx_from_line, y_end, first_internal, LineFromInternal( buf, first_internal )->len );
   *moved = 1;
   _CheckNoDupes( buf );
 }
@@ -758,16 +735,52 @@ LinePermuteD(
     *moved = 0;
     return;
   }
-  auto last_internal = buf->internal_idx_from_line.mem[ y_end + 1 ];
-  ReverseFori( u32, y, y_start + 1, y_end + 2 ) {
-    buf->internal_idx_from_line.mem[ y ] = buf->internal_idx_from_line.mem[ y - 1 ];
-  }
-  buf->internal_idx_from_line.mem[ y_start ] = last_internal;
+  // rotating the range by one is just moving the line below it to the top.
+  u32 last_internal;
+  LinetreeRemove( buf->internal_idx_from_line, y_end + 1, &last_internal );
+  LinetreeInsert( buf->internal_idx_from_line, y_start, last_internal, LineFromInternal( buf, last_internal )->len );
   *moved = 1;
   _CheckNoDupes( buf );
 }
 
 
+// line contents we edit are heap allocated per line, and marked owned so we know to free them.
+// lines loaded from the file point into orig_file_contents, and are never freed individually.
+Inl u8*
+_AllocLine( line_t* line, idx_t len )
+{
+  AssertCrash( len <= MAX_u32 );
+  line->len = Cast( u32, len );
+  line->flags = 0;
+  if( !len ) {
+    line->mem = 0;
+    return 0;
+  }
+  line->mem = MemHeapAlloc( u8, len );
+  line->flags |= ( 1u << lineflag_bit_owned );
+  return line->mem;
+}
+
+// replaced or removed contents are often still read by the rest of the edit, e.g. Replace reads line_end
+// after merging it into line_start. so we only free them once the whole edit is done.
+Inl void
+_FreeLineLater( buf_t* buf, line_t* line )
+{
+  if( line->flags & ( 1u << lineflag_bit_owned ) ) {
+    *AddBack( buf->lines_to_free ) = line->mem;
+  }
+}
+
+Inl void
+_FreeLinesNow( buf_t* buf )
+{
+  FORLEN( mem, i, buf->lines_to_free )
+    MemHeapFree( *mem );
+  }
+  buf->lines_to_free.len = 0;
+}
+
+
 // =================================================================================
 // FIRST / LAST CALLS
 //
@@ -783,12 +796,15 @@ Zero( buf_t* buf )
   Zero( buf->unordered_lines );
 #endif
   Zero( buf->pagelist );
-#if PAGEHISTORY
-#else
-  Zero( buf->history );
-#endif
+  Zero( buf->history.log );
+  buf->history.pos = 0;
+  buf->history.run_undone = 0;
+  buf->history.checkpt_pending = 0;
+  buf->history.y_last = 0;
+  buf->history.max_bytes = c_bufhistory_max_bytes;
+  buf->history.spill = {};
+  Zero( buf->lines_to_free );
   Zero( buf->orig_file_contents );
-  buf->history_idx = 0;
 }
 
 Inl void
@@ -800,7 +816,15 @@ Init( buf_t* buf )
 Inl void
 Kill( buf_t* buf )
 {
-  Free( buf->internal_idx_from_line );
+  _FreeLinesNow( buf );
+  if( NLines( buf ) ) {
+    FORALLLINES( buf, line, y )
+      if( line->flags & ( 1u << lineflag_bit_owned ) ) {
+        MemHeapFree( line->mem );
+      }
+    }
+  }
+  Kill( buf->internal_idx_from_line );
   Free( buf->unused_internal_idxs );
 #if LB
   Kill( &buf->internal_lineblocks );
@@ -808,10 +832,12 @@ Kill( buf_t* buf )
   Free( buf->unordered_lines );
 #endif
   Kill( buf->pagelist );
-#if PAGEHISTORY
-#else
-  Free( buf->history );
-#endif
+  Free( buf->history.log );
+  if( buf->history.spill.loaded ) {
+    FileSetEOF( buf->history.spill, 0 );
+    FileFree( buf->history.spill );
+  }
+  Free( buf->lines_to_free );
   Free( buf->orig_file_contents );
   Zero( buf );
 }
@@ -848,8 +874,8 @@ void
 BufLoadEmpty( buf_t* buf )
 {
   Init( buf->pagelist, 4000 );
-  Alloc( buf->internal_idx_from_line, 8 );
-  *AddBack( buf->internal_idx_from_line ) = 0;
+  Init( buf->internal_idx_from_line );
+  LinetreeAppend( buf->internal_idx_from_line, 0, 0 );
   Alloc( buf->unused_internal_idxs, 8 );
 #if LB
   Init( &buf->internal_lineblocks );
@@ -859,52 +885,207 @@ BufLoadEmpty( buf_t* buf )
   Alloc( buf->unordered_lines, 8 );
   *AddBack( buf->unordered_lines ) = {};
 #endif
-#if PAGEHISTORY
-#else
-  Alloc( buf->history, 8 );
-#endif
+  Alloc( buf->history.log, 64 );
+  Alloc( buf->lines_to_free, 8 );
   Zero( buf->orig_file_contents );
-  buf->history_idx = 0;
 }
 
-void
-BufLoad( buf_t* buf, file_t* file, eoltype_t* eoltype_detected )
+//
+// BufLoad splits the file into lines in parallel chunks.
+// pass one counts the eols in each chunk, which gives every chunk its starting line number.
+// pass two splits each chunk again, writing lines straight into their final line_t slots and linetree leaves.
+// each pass is a ParallelFor over the chunks.
+//
+
+constant idx_t c_bufload_chunk_size = 4*1024*1024;
+constant idx_t c_bufload_max_chunks = 256;
+
+struct
+bufload_chunk_t
 {
-  ProfFunc();
-  AssertCrash( file->size < MAX_idx );
+  idx_t start;
+  idx_t end;
+  eolcounts_t eols;
+  u32 y_start;
+};
 
-  constant u64 c_chunk_size = 200*1000*1000;
-  Init( buf->pagelist, CLAMP( Cast( idx_t, file->size ), 4000, c_chunk_size ) );
+struct
+bufload_t
+{
+  buf_t* buf;
+  u8* src;
+  idx_t src_len;
+  bufload_chunk_t chunks[c_bufload_max_chunks];
+  idx_t nchunks;
+  linetree_leaf_t** leaves;
+};
 
-  Prof( BufLoad_FileAlloc );
-  buf->orig_file_contents = FileAlloc( *file );
-  auto filemem = SliceFromString( buf->orig_file_contents );
-  ProfClose( BufLoad_FileAlloc );
+// advances pos to just past the next eol, so chunks never split a line or a crlf.
+Inl idx_t
+_BufLoadChunkEnd( u8* src, idx_t src_len, idx_t pos )
+{
+  while( pos < src_len  &&  src[pos] != '\r'  &&  src[pos] != '\n' ) {
+    pos += 1;
+  }
+  if( pos == src_len ) {
+    return src_len;
+  }
+  if( src[pos] == '\r'  &&  pos + 1 < src_len  &&  src[pos + 1] == '\n' ) {
+    return pos + 2;
+  }
+  return pos + 1;
+}
 
-#if LB
-  stack_resizeable_pagelist_t<slice32_t> lines;
-  Init( lines, 65000 );
-  Init( &buf->internal_lineblocks );
-  idx_t num_cr = 0;
-  idx_t num_lf = 0;
-  idx_t num_crlf = 0;
-  Prof( BufLoad_SplitIntoLines );
-  SplitIntoLines( &lines, ML( filemem ), &num_cr, &num_lf, &num_crlf );
-  AssertCrash( lines.totallen <= MAX_u32 );
-  auto nlines = Cast( u32, lines.totallen );
-  auto nlines_alloc = Cast( u32, MIN( MAX_u32, ( 4 * Cast( u64, nlines ) ) / 3 ) );
-  ProfClose( BufLoad_SplitIntoLines );
+Inl void
+_BufLoadEmitLine( bufload_t* load, u32 y, line_t** dst, idx_t line_start, idx_t line_end )
+{
+  auto line_len = line_end - line_start;
+  AssertCrash( line_len <= MAX_u32 );
+
+  // line storage is contiguous within a lineblock, so we only look it up again when we cross into the next one.
+  if( !*dst  ||  y % c_lineblock_size == 0 ) {
+    *dst = LineFromInternal( load->buf, y ); // note internal_idx is the trivial [0, nlines-1] here on load.
+  }
+  auto line = *dst;
+  line->mem = load->src + line_start;
+  line->len = Cast( u32, line_len );
+  line->flags = 0;
+  *dst += 1;
+
+  auto leaf = load->leaves[ y / c_linetree_leaf_cap ];
+  leaf->values[ y % c_linetree_leaf_cap ] = y;
+  leaf->lens[ y % c_linetree_leaf_cap ] = Cast( u32, line_len );
+}
+
+Inl void
+_BufLoadSplitChunk( bufload_t* load, bufload_chunk_t* chunk, bool last )
+{
+  auto src = load->src;
+  auto y = chunk->y_start;
+  line_t* dst = 0;
+  auto line_start = chunk->start;
+  auto idx = chunk->start;
+
+  // note a '\n' right after a '\r' is the second half of a crlf, whose line the '\r' already emitted.
+  // chunks start just past an eol, so the byte before an eol in this chunk is never in some other chunk's crlf.
+#define _BUFLOAD_EOL( pos ) \
+  if( src[pos] == '\n'  &&  pos > chunk->start  &&  src[pos - 1] == '\r' ) { \
+    line_start = pos + 1; \
+  } \
+  else { \
+    _BufLoadEmitLine( load, y, &dst, line_start, pos ); \
+    y += 1; \
+    line_start = pos + 1; \
+  } \
+
+#if STRINGSEARCH_SIMD
+  auto cr = StrvecSet( '\r' );
+  auto lf = StrvecSet( '\n' );
+  while( idx + c_stringsearch_width <= chunk->end ) {
+    auto v = StrvecLoad( src + idx );
+    auto mask = StrvecEqualMask( v, cr ) | StrvecEqualMask( v, lf );
+    while( mask ) {
+      auto pos = idx + _tzcnt_u32( mask );
+      mask &= mask - 1;
+      _BUFLOAD_EOL( pos )
+    }
+    idx += c_stringsearch_width;
+  }
+#endif
+  for( ;  idx < chunk->end;  ++idx ) {
+    if( src[idx] == '\r'  ||  src[idx] == '\n' ) {
+      _BUFLOAD_EOL( idx )
+    }
+  }
+
+#undef _BUFLOAD_EOL
+
+  // the final line of the file has no eol.
+  if( last ) {
+    _BufLoadEmitLine( load, y, &dst, line_start, chunk->end );
+    y += 1;
+  }
+  else {
+    AssertCrash( line_start == chunk->end );
+  }
+  AssertCrash( y == chunk->y_start + chunk->eols.num_cr + chunk->eols.num_lf + chunk->eols.num_crlf + last );
+}
+
+__ParallelForBody( ParallelFor_BufLoadCountEols )
+{
+  auto load = Cast( bufload_t*, misc );
+  auto chunk = load->chunks + k;
+  CountEols( &chunk->eols, load->src + chunk->start, chunk->end - chunk->start );
+}
+
+__ParallelForBody( ParallelFor_BufLoadSplit )
+{
+  auto load = Cast( bufload_t*, misc );
+  _BufLoadSplitChunk( load, load->chunks + k, k + 1 == load->nchunks );
+}
+
+// splits buf->orig_file_contents into lines.
+// chunk_size is a parameter so the tests can exercise the chunk boundaries on small inputs.
+void
+_BufLoadContents( buf_t* buf, eoltype_t* eoltype_detected, bool parallel, idx_t chunk_size )
+{
+  auto load = MemHeapAlloc( bufload_t, 1 );
+  load->buf = buf;
+  load->src = buf->orig_file_contents.mem;
+  load->src_len = buf->orig_file_contents.len;
+  load->leaves = 0;
+
+  idx_t max_workers = parallel  ?  MAX_idx  :  1;
+
+  Prof( BufLoad_Chunks );
+  load->nchunks = CLAMP( load->src_len / chunk_size, 1, c_bufload_max_chunks );
+  idx_t pos = 0;
+  For( k, 0, load->nchunks ) {
+    auto chunk = load->chunks + k;
+    chunk->start = pos;
+    if( k + 1 == load->nchunks ) {
+      pos = load->src_len;
+    }
+    else {
+      auto target = ( load->src_len / load->nchunks ) * ( k + 1 );
+      pos = _BufLoadChunkEnd( load->src, load->src_len, MAX( pos, target ) );
+    }
+    chunk->end = pos;
+
+    // only the last chunk may end without an eol, so stop early if we ran out of eols.
+    if( pos == load->src_len ) {
+      load->nchunks = k + 1;
+      break;
+    }
+  }
+  ProfClose( BufLoad_Chunks );
+
+  Prof( BufLoad_CountEols );
+  ParallelFor( ParallelFor_BufLoadCountEols, load, load->nchunks, max_workers );
+  eolcounts_t eols = {};
+  idx_t nlines = 1; // the final line of the file has no eol.
+  For( k, 0, load->nchunks ) {
+    auto chunk = load->chunks + k;
+    AssertCrash( nlines <= MAX_u32 );
+    chunk->y_start = Cast( u32, nlines - 1 );
+    eols.num_cr += chunk->eols.num_cr;
+    eols.num_lf += chunk->eols.num_lf;
+    eols.num_crlf += chunk->eols.num_crlf;
+    nlines += chunk->eols.num_cr + chunk->eols.num_lf + chunk->eols.num_crlf;
+  }
+  AssertCrash( nlines <= MAX_u32 );
+  ProfClose( BufLoad_CountEols );
 
   // pick eoltype based on the eols we saw.
   // we just pick the most frequently one seen.
   // ties are broken in the order: crlf, lf, cr. that seems like the most
   // reasonable order to me.
   {
-    auto max_eof = MAX3( num_cr, num_lf, num_crlf );
-    if( max_eof == num_crlf ) {
+    auto max_eof = MAX3( eols.num_cr, eols.num_lf, eols.num_crlf );
+    if( max_eof == eols.num_crlf ) {
       *eoltype_detected = eoltype_t::crlf;
     }
-    elif( max_eof == num_lf ) {
+    elif( max_eof == eols.num_lf ) {
       *eoltype_detected = eoltype_t::lf;
     }
     else {
@@ -912,56 +1093,57 @@ BufLoad( buf_t* buf, file_t* file, eoltype_t* eoltype_detected )
     }
   }
 
-  Prof( BufLoad_SetupPageTreeContents );
-  auto pa_iter = MakeIteratorAtLinearIndex( lines, 0 );
-  Fori( u32, i, 0, nlines ) {
-    auto line = GetElemAtIterator( lines, pa_iter );
-    pa_iter = IteratorMoveR( lines, pa_iter );
-
-    // PERF: not ideal to copy array like this. could split into place directly.
-    auto dst = AccessLine( buf, i ); // note internal_idx is the trivial [0, nlines-1] here on load.
-    dst->mem = line->mem;
-    dst->len = line->len;
-    dst->flags = 0;
+  // allocate all the line storage up front, so pass two can fill it in from any thread.
+  Prof( BufLoad_AllocLines );
+#if LB
+  Init( &buf->internal_lineblocks );
+  for( idx_t y = 0;  y < nlines;  y += c_lineblock_size ) {
+    AccessLine( buf, Cast( u32, y ) );
   }
-  ProfClose( BufLoad_SetupPageTreeContents );
-  Kill( lines );
-
 #else
-  Prof( BufLoad_CountNewlines );
-  auto nlines = CountNewlines( ML( filemem ) ) + 1;
-  auto nlines_alloc = ( 4 * nlines ) / 3;
-  ProfClose( BufLoad_CountNewlines );
-
-  stack_resizeable_cont_t<slice32_t> lines;
-  Alloc( lines, nlines );
-  SplitIntoLines( &lines, ML( filemem ) );
-  // PERF: not ideal to copy array like this. unordered_lines is going away soon anyways, so leave this here for now.
-  Alloc( buf->unordered_lines, nlines_alloc );
+  Alloc( buf->unordered_lines, nlines );
   buf->unordered_lines.len = nlines;
-  FORLEN( line, i, lines )
-    auto dst = buf->unordered_lines.mem + i;
-    dst->mem = line->mem;
-    dst->len = line->len;
-    dst->flags = 0;
-  }
-  Free( lines );
 #endif
+  stack_resizeable_cont_t<linetree_leaf_t*> leaves;
+  Alloc( leaves, 1 + nlines / c_linetree_leaf_cap );
+  Zero( buf->internal_idx_from_line );
+  LinetreeBulkAlloc( buf->internal_idx_from_line, Cast( u32, nlines ), &leaves );
+  load->leaves = leaves.mem;
+  ProfClose( BufLoad_AllocLines );
 
-  Prof( BufLoad_SetupPermutationArray );
-  Alloc( buf->internal_idx_from_line, nlines_alloc );
-  Fori( u32, i, 0, nlines ) {
-    *AddBack( buf->internal_idx_from_line ) = i;
-  }
-  ProfClose( BufLoad_SetupPermutationArray );
+  Prof( BufLoad_SplitIntoLines );
+  ParallelFor( ParallelFor_BufLoadSplit, load, load->nchunks, max_workers );
+  ProfClose( BufLoad_SplitIntoLines );
+
+  Prof( BufLoad_LinetreeFinish );
+  LinetreeBulkFinish( buf->internal_idx_from_line, &leaves );
+  AssertCrash( NLines( buf ) == nlines );
+  ProfClose( BufLoad_LinetreeFinish );
+
+  Free( leaves );
+  MemHeapFree( load );
+}
+
+// note parallel is only allowed on the main thread, since it pushes tasks.
+void
+BufLoad( buf_t* buf, file_t* file, eoltype_t* eoltype_detected, bool parallel )
+{
+  ProfFunc();
+  AssertCrash( file->size < MAX_idx );
+
+  constant u64 c_chunk_size = 200*1000*1000;
+  Init( buf->pagelist, CLAMP( Cast( idx_t, file->size ), 4000, c_chunk_size ) );
+
+  Prof( BufLoad_FileAlloc );
+  buf->orig_file_contents = FileAlloc( *file );
+  ProfClose( BufLoad_FileAlloc );
+
+  _BufLoadContents( buf, eoltype_detected, parallel, c_bufload_chunk_size );
 
   Alloc( buf->unused_internal_idxs, 1000 );
 
-#if PAGEHISTORY
-#else
-  Alloc( buf->history, 256 );
-#endif
-  buf->history_idx = 0;
+  Alloc( buf->history.log, 4096 );
+  Alloc( buf->lines_to_free, 8 );
 }
 
 // TODO: check filesys retvals?
@@ -1203,29 +1385,367 @@ FindFirstInlineL(
 // CONTENT MODIFY CALLS
 //
 
-Inl undoableoper_t*
-AddHistorical( buf_t* buf )
+Inl void
+_HistoryAddVarint( stack_resizeable_cont_t<u8>& log, u64 value )
 {
-  // invalidate previous futures.
-#if PAGEHISTORY
-#else
-  AssertCrash( buf->history_idx <= buf->history.len );
-  buf->history.len = buf->history_idx;
-  auto oper = AddBack( buf->history );
-  buf->history_idx += 1;
-  return oper;
-#endif
+  while( value >= 0x80 ) {
+    *AddBack( log ) = Cast( u8, value | 0x80 );
+    value >>= 7;
+  }
+  *AddBack( log ) = Cast( u8, value );
+}
+
+Inl u64
+_HistoryReadVarint( u8*& src )
+{
+  u64 value = 0;
+  u32 shift = 0;
+  Forever {
+    auto c = *src++;
+    value |= Cast( u64, c & 0x7F ) << shift;
+    if( !( c & 0x80 ) ) {
+      return value;
+    }
+    shift += 7;
+  }
+}
+
+Inl idx_t
+_HistoryVarintLen( u64 value )
+{
+  idx_t n = 1;
+  while( value >= 0x80 ) {
+    value >>= 7;
+    n += 1;
+  }
+  return n;
+}
+
+Inl void
+_HistoryAddBytes( stack_resizeable_cont_t<u8>& log, u8* mem, idx_t len )
+{
+  Memmove( AddBack( log, len ), mem, len );
+}
+
+Inl void
+_HistoryAddY( bufhistory_t& h, u32 y )
+{
+  auto dy = Cast( s64, y ) - h.y_last;
+  _HistoryAddVarint( h.log, Cast( u64, dy << 1 ) ^ Cast( u64, dy >> 63 ) );
+  h.y_last = y;
+}
+
+Inl s64
+_HistoryReadDy( u8*& src )
+{
+  auto zigzag = _HistoryReadVarint( src );
+  return Cast( s64, zigzag >> 1 ) ^ -Cast( s64, zigzag & 1 );
+}
+
+// decoded view of one record. slices point into the log, so they're invalid after any log change.
+struct
+historyrec_t
+{
+  undoableopertype_t type;
+  idx_t start;
+  idx_t end;
+  s64 dy;
+  u32 prefix_len; // mod
+  u32 suffix_len; // mod
+  slice_t contents; // add, rem: the line. mod: the old middle. insrun: the chars.
+  slice_t contents_new; // mod: the new middle.
+  u32 y_span; // permuteu, permuted
+  u32 x; // insrun
+};
+
+historyrec_t
+_HistoryReadForward( bufhistory_t& h, idx_t start )
+{
+  historyrec_t rec = {};
+  rec.start = start;
+  auto src = h.log.mem + start;
+  rec.type = Cast( undoableopertype_t, *src++ );
+  switch( rec.type ) {
+    case undoableopertype_t::checkpt: {
+    } break;
+    case undoableopertype_t::add:
+    case undoableopertype_t::rem: {
+      rec.dy = _HistoryReadDy( src );
+      rec.contents.len = Cast( idx_t, _HistoryReadVarint( src ) );
+      rec.contents.mem = src;
+      src += rec.contents.len;
+    } break;
+    case undoableopertype_t::mod: {
+      rec.dy = _HistoryReadDy( src );
+      rec.prefix_len = Cast( u32, _HistoryReadVarint( src ) );
+      rec.suffix_len = Cast( u32, _HistoryReadVarint( src ) );
+      rec.contents.len = Cast( idx_t, _HistoryReadVarint( src ) );
+      rec.contents.mem = src;
+      src += rec.contents.len;
+      rec.contents_new.len = Cast( idx_t, _HistoryReadVarint( src ) );
+      rec.contents_new.mem = src;
+      src += rec.contents_new.len;
+    } break;
+    case undoableopertype_t::permuteu:
+    case undoableopertype_t::permuted: {
+      rec.dy = _HistoryReadDy( src );
+      rec.y_span = Cast( u32, _HistoryReadVarint( src ) );
+    } break;
+    case undoableopertype_t::insrun: {
+      u32 len;
+      Memmove( &len, src, sizeof( len ) );
+      src += sizeof( len );
+      auto end = src + len;
+      rec.dy = _HistoryReadDy( src );
+      rec.x = Cast( u32, _HistoryReadVarint( src ) );
+      rec.contents.mem = src;
+      rec.contents.len = Cast( idx_t, end - src );
+      src = end;
+    } break;
+    default: UnreachableCrash();
+  }
+  auto payload_len = Cast( idx_t, src - ( h.log.mem + start ) );
+  rec.end = start + payload_len + _HistoryVarintLen( payload_len );
+  return rec;
+}
+
+Inl historyrec_t
+_HistoryReadBackward( bufhistory_t& h, idx_t end )
+{
+  // the backlen is stored byte-reversed, so the last byte holds its lowest 7 bits.
+  idx_t payload_len = 0;
+  u32 shift = 0;
+  auto src = h.log.mem + end;
+  Forever {
+    auto c = *--src;
+    payload_len |= Cast( idx_t, c & 0x7F ) << shift;
+    if( !( c & 0x80 ) ) {
+      break;
+    }
+    shift += 7;
+  }
+  return _HistoryReadForward( h, Cast( idx_t, src - h.log.mem ) - payload_len );
+}
+
+Inl void
+_HistoryEndRecord( bufhistory_t& h, idx_t start )
+{
+  auto payload_len = h.log.len - start;
+  u8 backlen[10];
+  idx_t n = 0;
+  while( payload_len >= 0x80 ) {
+    backlen[n++] = Cast( u8, payload_len | 0x80 );
+    payload_len >>= 7;
+  }
+  backlen[n++] = Cast( u8, payload_len );
+  auto dst = AddBack( h.log, n );
+  For( i, 0, n ) {
+    dst[i] = backlen[ n - 1 - i ];
+  }
+  h.pos = h.log.len;
+}
+
+Inl void
+_HistorySetRunLen( bufhistory_t& h, idx_t start )
+{
+  auto len_offset = start + 1;
+  AssertCrash( h.log.len - len_offset - sizeof( u32 ) <= MAX_u32 );
+  auto len = Cast( u32, h.log.len - len_offset - sizeof( u32 ) );
+  Memmove( h.log.mem + len_offset, &len, sizeof( len ) );
+}
+
+void
+_HistoryTruncateFutures( bufhistory_t& h )
+{
+  if( h.run_undone ) {
+    // keep just the applied part of the run.
+    auto rec = _HistoryReadBackward( h, h.pos );
+    AssertCrash( rec.type == undoableopertype_t::insrun );
+    AssertCrash( h.run_undone < rec.contents.len );
+    h.log.len = Cast( idx_t, rec.contents.mem + rec.contents.len - h.log.mem ) - h.run_undone;
+    _HistorySetRunLen( h, rec.start );
+    _HistoryEndRecord( h, rec.start );
+    h.run_undone = 0;
+  }
+  AssertCrash( h.pos <= h.log.len );
+  h.log.len = h.pos;
+}
+
+idx_t
+_HistoryBeginRecord( bufhistory_t& h, undoableopertype_t type )
+{
+  _HistoryTruncateFutures( h );
+  if( h.checkpt_pending ) {
+    h.checkpt_pending = 0;
+    auto start = h.log.len;
+    *AddBack( h.log ) = Cast( u8, undoableopertype_t::checkpt );
+    _HistoryEndRecord( h, start );
+  }
+  auto start = h.log.len;
+  *AddBack( h.log ) = Cast( u8, type );
+  return start;
+}
+
+void
+_HistoryAddLine( bufhistory_t& h, undoableopertype_t type, u32 y, line_t* line )
+{
+  auto start = _HistoryBeginRecord( h, type );
+  _HistoryAddY( h, y );
+  _HistoryAddVarint( h.log, line->len );
+  _HistoryAddBytes( h.log, ML( *line ) );
+  _HistoryEndRecord( h, start );
+}
+
+void
+_HistoryAddMod( bufhistory_t& h, u32 y, line_t* line_old, line_t* line_new )
+{
+  auto len_common = MIN( line_old->len, line_new->len );
+  u32 prefix_len = 0;
+  while( prefix_len < len_common  &&  line_old->mem[prefix_len] == line_new->mem[prefix_len] ) {
+    prefix_len += 1;
+  }
+  u32 suffix_len = 0;
+  while( suffix_len < len_common - prefix_len  &&
+         line_old->mem[ line_old->len - 1 - suffix_len ] == line_new->mem[ line_new->len - 1 - suffix_len ] ) {
+    suffix_len += 1;
+  }
+  auto old_len = line_old->len - prefix_len - suffix_len;
+  auto new_len = line_new->len - prefix_len - suffix_len;
+  if( !old_len  &&  new_len == 1 ) {
+    auto c = line_new->mem[prefix_len];
+    // try to extend the last insrun, if this char starts a new undo group right where that run ends.
+    // prefix_len isn't exact inside a repeated char, e.g. typing 'a' into "aa", so allow the run to end
+    // anywhere inside the repeat.
+    if( h.checkpt_pending  &&  h.pos  &&  h.pos == h.log.len  &&  y == h.y_last ) {
+      auto rec = _HistoryReadBackward( h, h.pos );
+      if( rec.type == undoableopertype_t::insrun ) {
+        auto x_next = rec.x + Cast( u32, rec.contents.len );
+        bool extends = ( x_next <= prefix_len );
+        for( auto x = x_next; extends  &&  x < prefix_len; ++x ) {
+          extends = ( line_new->mem[x] == c );
+        }
+        if( extends ) {
+          h.checkpt_pending = 0;
+          h.log.len = Cast( idx_t, rec.contents.mem + rec.contents.len - h.log.mem );
+          *AddBack( h.log ) = c;
+          _HistorySetRunLen( h, rec.start );
+          _HistoryEndRecord( h, rec.start );
+          return;
+        }
+      }
+    }
+    auto start = _HistoryBeginRecord( h, undoableopertype_t::insrun );
+    AddBack( h.log, sizeof( u32 ) );
+    _HistoryAddY( h, y );
+    _HistoryAddVarint( h.log, prefix_len );
+    *AddBack( h.log ) = c;
+    _HistorySetRunLen( h, start );
+    _HistoryEndRecord( h, start );
+    return;
+  }
+  auto start = _HistoryBeginRecord( h, undoableopertype_t::mod );
+  _HistoryAddY( h, y );
+  _HistoryAddVarint( h.log, prefix_len );
+  _HistoryAddVarint( h.log, suffix_len );
+  _HistoryAddVarint( h.log, old_len );
+  _HistoryAddBytes( h.log, line_old->mem + prefix_len, old_len );
+  _HistoryAddVarint( h.log, new_len );
+  _HistoryAddBytes( h.log, line_new->mem + prefix_len, new_len );
+  _HistoryEndRecord( h, start );
+}
+
+// drop the oldest history once we're over max_bytes, down to roughly half.
+// we only cut at checkpts at or before pos, so undo never sees half of a group.
+void
+_HistoryEnforceLimit( bufhistory_t& h )
+{
+  if( h.log.len <= h.max_bytes ) {
+    return;
+  }
+  idx_t cut = 0;
+  idx_t offset = 0;
+  while( offset < h.pos ) {
+    auto rec = _HistoryReadForward( h, offset );
+    if( rec.type == undoableopertype_t::checkpt  &&  offset ) {
+      cut = offset;
+      if( offset >= h.log.len / 2 ) {
+        break;
+      }
+    }
+    offset = rec.end;
+  }
+  if( !cut ) {
+    return;
+  }
+  if( h.spill.loaded ) {
+    u64 segment_len = cut;
+    FileWriteAppend( h.spill, h.log.mem, cut );
+    FileWriteAppend( h.spill, Cast( u8*, &segment_len ), sizeof( segment_len ) );
+  }
+  Memmove( h.log.mem, h.log.mem + cut, h.log.len - cut );
+  h.log.len -= cut;
+  h.pos -= cut;
+}
+
+// bring back the most recently spilled segment, in front of the log.
+bool
+_HistoryUnspill( bufhistory_t& h )
+{
+  AssertCrash( !h.pos );
+  if( !h.spill.loaded  ||  h.spill.size < sizeof( u64 ) ) {
+    return 0;
+  }
+  u64 segment_len;
+  FileRead( h.spill, h.spill.size - sizeof( u64 ), Cast( u8*, &segment_len ), sizeof( u64 ), MAX_u32 );
+  AssertCrash( segment_len + sizeof( u64 ) <= h.spill.size );
+  AssertCrash( segment_len <= MAX_idx );
+  auto segment_start = h.spill.size - sizeof( u64 ) - segment_len;
+  AddAt( h.log, 0, Cast( idx_t, segment_len ) );
+  FileRead( h.spill, segment_start, h.log.mem, segment_len, MAX_u32 );
+  FileSetEOF( h.spill, segment_start );
+  h.pos = Cast( idx_t, segment_len );
+  return 1;
+}
+
+//
+// caps the bytes of undo history kept in memory.
+// past that, the oldest history is dropped, or spilled if BufSpillHistory was called.
+//
+Inl void
+BufSetHistoryLimit( buf_t* buf, idx_t max_bytes )
+{
+  buf->history.max_bytes = max_bytes;
+  _HistoryEnforceLimit( buf->history );
+}
+
+//
+// keeps the history that max_bytes would drop in the given file instead, so undo can go all the way back.
+// the file is truncated first, and it's only ever read back in by undo.
+//
+Inl void
+BufSpillHistory( buf_t* buf, u8* filename, idx_t filename_len )
+{
+  auto& h = buf->history;
+  if( h.spill.loaded ) {
+    FileFree( h.spill );
+  }
+  h.spill = FileOpen( filename, filename_len, fileopen_t::always, fileop_t::RW, fileop_t::R );
+  if( h.spill.loaded ) {
+    FileSetEOF( h.spill, 0 );
+  }
 }
 
 Inl void
 WipeHistories( buf_t* buf )
 {
-#if PAGEHISTORY
-#else
-  AssertCrash( buf->history_idx <= buf->history.len );
-  buf->history.len = 0;
-  buf->history_idx = 0;
-#endif
+  auto& h = buf->history;
+  h.log.len = 0;
+  h.pos = 0;
+  h.run_undone = 0;
+  h.checkpt_pending = 0;
+  if( h.spill.loaded ) {
+    FileSetEOF( h.spill, 0 );
+  }
 }
 
 Inl void
@@ -1237,30 +1757,23 @@ ForwardLineOper(
   undoableopertype_t type
   )
 {
-  auto oper = AddHistorical( buf );
-  oper->type = type;
-  if( line_old ) {
-    oper->line_old = *line_old;
-  } else {
-    oper->line_old = {};
-  }
-  if( line_new ) {
-    oper->line_new = *line_new;
-  } else {
-    oper->line_new = {};
-  }
-  oper->y = y;
+  auto& h = buf->history;
 
-  // actually perform the operation:
+  // record the operation, then actually perform it:
 
   switch( type ) {
     case undoableopertype_t::add: {
+      _HistoryAddLine( h, type, y, line_new );
       LineInsert( buf, y, line_new );
     } break;
     case undoableopertype_t::mod: {
+      _HistoryAddMod( h, y, line_old, line_new );
+      _FreeLineLater( buf, line_old );
       LineReplace( buf, y, line_old, line_new );
     } break;
     case undoableopertype_t::rem: {
+      _HistoryAddLine( h, type, y, line_old );
+      _FreeLineLater( buf, line_old );
       LineRemove( buf, y, line_old );
     } break;
     case undoableopertype_t::checkpt: UnreachableCrash();
@@ -1291,10 +1804,11 @@ ForwardPermuteOper(
   // e.g. to undo the PermuteD, trying to PermuteU the very last line _will_ do something.
   // note we can do this as a post-op check, since the oper doesn't contain anything from the pre-op.
   if( *moved ) {
-    auto oper = AddHistorical( buf );
-    oper->type = type;
-    oper->y_start = y_start;
-    oper->y_end = y_end;
+    auto& h = buf->history;
+    auto start = _HistoryBeginRecord( h, type );
+    _HistoryAddY( h, y_start );
+    _HistoryAddVarint( h.log, y_end - y_start );
+    _HistoryEndRecord( h, start );
   }
 }
 
@@ -1337,9 +1851,7 @@ Replace(
     //   we probably want to optimize for the last-line-modified, since that's the most likely edit.
     //   at minimum we could likely avoid allocing the line contents up to x.
     line_t line_new;
-    line_new.len = line->len - len_x + add.len;
-    line_new.mem = AddPagelist( buf->pagelist, u8, 1, line_new.len );
-    line_new.flags = 0;
+    _AllocLine( &line_new, line->len - len_x + add.len );
     Memmove( line_new.mem, line->mem, x_start );
     Memmove( line_new.mem + x_start, ML( add ) );
     Memmove( line_new.mem + x_start + add.len, line->mem + x_end, line->len - x_end );
@@ -1365,9 +1877,7 @@ Replace(
       *y_finish = y_start;
     }
     line_t line_new;
-    line_new.len = x_start + add.len + line_end->len - x_end;
-    line_new.mem = AddPagelist( buf->pagelist, u8, 1, line_new.len );
-    line_new.flags = 0;
+    _AllocLine( &line_new, x_start + add.len + line_end->len - x_end );
     Memmove( line_new.mem, line_start->mem, x_start );
     Memmove( line_new.mem + x_start, ML( add ) );
     Memmove( line_new.mem + x_start + add.len, line_end->mem + x_end, line_end->len - x_end );
@@ -1404,9 +1914,7 @@ Replace(
       *y_finish = y_start + Cast( u32, lines.len ) - 1;
     }
     line_t line_new;
-    line_new.len = x_start + add_first.len;
-    line_new.mem = AddPagelist( buf->pagelist, u8, 1, line_new.len );
-    line_new.flags = 0;
+    _AllocLine( &line_new, x_start + add_first.len );
     Memmove( line_new.mem, line->mem, x_start );
     Memmove( line_new.mem + x_start, ML( add_first ) );
     ForwardLineOper(
@@ -1419,9 +1927,7 @@ Replace(
     AssertCrash( lines.len <= MAX_u32 );
     Fori( u32, i, 1, Cast( u32, lines.len ) - 1 ) {
       auto add = lines.mem[i];
-      line_new.len = add.len;
-      line_new.mem = AddPagelist( buf->pagelist, u8, 1, line_new.len );
-      line_new.flags = 0;
+      _AllocLine( &line_new, add.len );
       Memmove( line_new.mem, ML( add ) );
       ForwardLineOper(
         buf,
@@ -1431,9 +1937,7 @@ Replace(
         undoableopertype_t::add
         );
     }
-    line_new.len = add_last.len + line_orig.len - x_end;
-    line_new.mem = AddPagelist( buf->pagelist, u8, 1, line_new.len );
-    line_new.flags = 0;
+    _AllocLine( &line_new, add_last.len + line_orig.len - x_end );
     Memmove( line_new.mem, ML( add_last ) );
     Memmove( line_new.mem + add_last.len, line_orig.mem + x_end, line_orig.len - x_end );
     AssertCrash( lines.len <= MAX_u32 );
@@ -1460,9 +1964,7 @@ Replace(
       *y_finish = y_start + Cast( u32, lines.len ) - 1;
     }
     line_t line_new;
-    line_new.len = x_start + add_first.len;
-    line_new.mem = AddPagelist( buf->pagelist, u8, 1, line_new.len );
-    line_new.flags = 0;
+    _AllocLine( &line_new, x_start + add_first.len );
     Memmove( line_new.mem, line_start->mem, x_start );
     Memmove( line_new.mem + x_start, ML( add_first ) );
     ForwardLineOper(
@@ -1486,9 +1988,7 @@ Replace(
     // TODO: consolidate these with the rems above to make mods, making fewer ops overall?
     Fori( u32, i, 1, lines.len - 1 ) {
       auto add = lines.mem[i];
-      line_new.len = add.len;
-      line_new.mem = AddPagelist( buf->pagelist, u8, 1, line_new.len );
-      line_new.flags = 0;
+      _AllocLine( &line_new, add.len );
       Memmove( line_new.mem, ML( add ) );
       ForwardLineOper(
         buf,
@@ -1498,9 +1998,7 @@ Replace(
         undoableopertype_t::add
         );
     }
-    line_new.len = add_last.len + line_end->len - x_end;
-    line_new.mem = AddPagelist( buf->pagelist, u8, 1, line_new.len );
-    line_new.flags = 0;
+    _AllocLine( &line_new, add_last.len + line_end->len - x_end );
     Memmove( line_new.mem, ML( add_last ) );
     Memmove( line_new.mem + add_last.len, line_end->mem + x_end, line_end->len - x_end );
     AssertCrash( lines.len <= MAX_u32 );
@@ -1513,6 +2011,7 @@ Replace(
       );
   }
   Free( lines );
+  _FreeLinesNow( buf );
 }
 
 //
@@ -1590,6 +2089,7 @@ DeleteLine(
   else {
     ForwardLineOper( buf, y, line, 0, undoableopertype_t::rem );
   }
+  _FreeLinesNow( buf );
 }
 
 
@@ -1600,128 +2100,236 @@ DeleteLine(
 void
 UndoCheckpt( buf_t* buf )
 {
-  auto checkpt = AddHistorical( buf );
-  checkpt->type = undoableopertype_t::checkpt;
+  auto& h = buf->history;
+  _HistoryTruncateFutures( h );
+  if( h.checkpt_pending ) {
+    // the last group was empty; it still needs its own undo step.
+    h.checkpt_pending = 0;
+    auto start = _HistoryBeginRecord( h, undoableopertype_t::checkpt );
+    _HistoryEndRecord( h, start );
+  }
+  _HistoryEnforceLimit( h );
+  // we hold off on writing the checkpt, so a typed char can extend an insrun instead.
+  h.checkpt_pending = 1;
 }
 
+Inl void
+_HistoryFlushCheckpt( bufhistory_t& h )
+{
+  if( h.checkpt_pending ) {
+    h.checkpt_pending = 0;
+    auto start = _HistoryBeginRecord( h, undoableopertype_t::checkpt );
+    _HistoryEndRecord( h, start );
+  }
+}
 
-void
-Undo( buf_t* buf )
+// replaces line y with a + b + c, where a and c are usually parts of the current line, which is passed in.
+Inl void
+_ReplaceLineParts(
+  buf_t* buf,
+  u32 y,
+  line_t* line,
+  u8* a,
+  idx_t a_len,
+  u8* b,
+  idx_t b_len,
+  u8* c,
+  idx_t c_len
+  )
 {
-#if PAGEHISTORY
-#else
-  AssertCrash( buf->history_idx <= buf->history.len );
-  AssertCrash( buf->history_idx == buf->history.len  ||  buf->history.mem[buf->history_idx].type == undoableopertype_t::checkpt );
-#endif
-  if( !buf->history_idx ) {
-    return;
+  line_t line_new;
+  auto mem = _AllocLine( &line_new, a_len + b_len + c_len );
+  Memmove( mem, a, a_len );
+  Memmove( mem + a_len, b, b_len );
+  Memmove( mem + a_len + b_len, c, c_len );
+  _FreeLineLater( buf, line );
+  LineReplace( buf, y, 0, &line_new );
+}
+
+Inl void
+_InsertLineCopy( buf_t* buf, u32 y, slice_t contents )
+{
+  line_t line_new;
+  Memmove( _AllocLine( &line_new, contents.len ), ML( contents ) );
+  LineInsert( buf, y, &line_new );
+}
+
+Inl void
+_RemoveLine( buf_t* buf, u32 y )
+{
+  _FreeLineLater( buf, LineFromY( buf, y ) );
+  LineRemove( buf, y, 0 );
+}
+
+Inl void
+_ApplyMod( buf_t* buf, u32 y, historyrec_t& rec, slice_t middle )
+{
+  auto line = LineFromY( buf, y );
+  AssertCrash( rec.prefix_len + rec.suffix_len <= line->len );
+  _ReplaceLineParts(
+    buf,
+    y,
+    line,
+    line->mem, rec.prefix_len,
+    ML( middle ),
+    line->mem + line->len - rec.suffix_len, rec.suffix_len
+    );
+}
+
+// insrun char i is either inserted or removed at x + i, which is all an insrun undo/redo step does.
+Inl void
+_ApplyRunChar( buf_t* buf, u32 y, historyrec_t& rec, idx_t i, bool insert )
+{
+  auto line = LineFromY( buf, y );
+  auto x = rec.x + i;
+  AssertCrash( x <= line->len );
+  if( insert ) {
+    _ReplaceLineParts(
+      buf,
+      y,
+      line,
+      line->mem, x,
+      rec.contents.mem + i, 1,
+      line->mem + x, line->len - x
+      );
   }
+  else {
+    AssertCrash( x < line->len );
+    _ReplaceLineParts(
+      buf,
+      y,
+      line,
+      line->mem, x,
+      0, 0,
+      line->mem + x + 1, line->len - x - 1
+      );
+  }
+}
 
-  bool loop = 1;
-  while( loop ) {
-    buf->history_idx -= 1;
-#if PAGEHISTORY
-#else
-    auto oper = buf->history.mem + buf->history_idx;
-#endif
+void
+Undo( buf_t* buf )
+{
+  auto& h = buf->history;
+  _HistoryFlushCheckpt( h );
+  Forever {
+    if( !h.pos  &&  !_HistoryUnspill( h ) ) {
+      break;
+    }
+    auto rec = _HistoryReadBackward( h, h.pos );
+    if( rec.type == undoableopertype_t::checkpt ) {
+      h.pos = rec.start;
+      break;
+    }
+    AssertCrash( h.y_last >= 0  &&  h.y_last <= MAX_u32 );
+    auto y = Cast( u32, h.y_last );
 
     // undo this operation:
-    switch( oper->type ) {
-      case undoableopertype_t::checkpt: {
-        loop = 0;
-      } break;
+    switch( rec.type ) {
       case undoableopertype_t::add: {
-        LineRemove( buf, oper->y, &oper->line_new );
+        _RemoveLine( buf, y );
       } break;
       case undoableopertype_t::mod: {
-        LineReplace( buf, oper->y, &oper->line_new, &oper->line_old );
+        _ApplyMod( buf, y, rec, rec.contents );
       } break;
       case undoableopertype_t::rem: {
-        LineInsert( buf, oper->y, &oper->line_old );
+        _InsertLineCopy( buf, y, rec.contents );
       } break;
       case undoableopertype_t::permuteu: {
         bool moved;
-        // TODO: consider changing what we store in the oper to make this simpler.
-        AssertCrash( oper->y_start );
-        AssertCrash( oper->y_end );
-        LinePermuteD( buf, oper->y_start - 1, oper->y_end - 1, &moved );
+        AssertCrash( y );
+        LinePermuteD( buf, y - 1, y + rec.y_span - 1, &moved );
         AssertCrash( moved );
       } break;
       case undoableopertype_t::permuted: {
         bool moved;
-        LinePermuteU( buf, oper->y_start + 1, oper->y_end + 1, &moved );
+        LinePermuteU( buf, y + 1, y + rec.y_span + 1, &moved );
         AssertCrash( moved );
       } break;
+      case undoableopertype_t::insrun: {
+        _ApplyRunChar( buf, y, rec, rec.contents.len - h.run_undone - 1, 0 );
+        h.run_undone += 1;
+      } break;
       default: UnreachableCrash();
     }
-  }
 
-#if PAGEHISTORY
-#else
-  AssertCrash( buf->history_idx == buf->history.len  ||  buf->history.mem[buf->history_idx].type == undoableopertype_t::checkpt );
-#endif
+    if( h.run_undone ) {
+      // there's an implicit checkpt between every pair of chars in a run.
+      // the first char doesn't have one before it, so it keeps going to the real checkpt.
+      if( h.run_undone < rec.contents.len ) {
+        break;
+      }
+      h.run_undone = 0;
+    }
+    h.pos = rec.start;
+    h.y_last -= rec.dy;
+  }
+  _FreeLinesNow( buf );
 }
 
-
-
 void
 Redo( buf_t* buf )
 {
-#if PAGEHISTORY
-#else
-  AssertCrash( buf->history_idx <= buf->history.len );
-  AssertCrash( buf->history_idx == buf->history.len  ||  buf->history.mem[buf->history_idx].type == undoableopertype_t::checkpt );
-  if( buf->history_idx == buf->history.len ) {
-    return;
+  auto& h = buf->history;
+  _HistoryFlushCheckpt( h );
+  if( h.run_undone ) {
+    // we're between two chars of a run, so redo just the next char.
+    auto rec = _HistoryReadBackward( h, h.pos );
+    _ApplyRunChar( buf, Cast( u32, h.y_last ), rec, rec.contents.len - h.run_undone, 1 );
+    h.run_undone -= 1;
+    if( h.run_undone ) {
+      _FreeLinesNow( buf );
+      return;
+    }
+    // that was the run's last char, so the rest of its group follows the run.
+  }
+  elif( h.pos < h.log.len ) {
+    auto rec = _HistoryReadForward( h, h.pos );
+    if( rec.type == undoableopertype_t::checkpt ) {
+      h.pos = rec.end;
+    }
   }
-#endif
-
-  buf->history_idx += 1;
 
-  bool loop = 1;
-  while( loop ) {
-#if PAGEHISTORY
-#else
-    if( buf->history_idx == buf->history.len ) {
+  while( h.pos < h.log.len ) {
+    auto rec = _HistoryReadForward( h, h.pos );
+    if( rec.type == undoableopertype_t::checkpt ) {
       break;
     }
-    auto oper = buf->history.mem + buf->history_idx;
-#endif
+    AssertCrash( h.y_last + rec.dy >= 0  &&  h.y_last + rec.dy <= MAX_u32 );
+    auto y = Cast( u32, h.y_last + rec.dy );
+    h.pos = rec.end;
+    h.y_last = y;
 
     // redo this operation:
-    switch( oper->type ) {
-      case undoableopertype_t::checkpt: {
-        loop = 0;
-      } break;
+    switch( rec.type ) {
       case undoableopertype_t::add: {
-        LineInsert( buf, oper->y, &oper->line_new );
+        _InsertLineCopy( buf, y, rec.contents );
       } break;
       case undoableopertype_t::mod: {
-        LineReplace( buf, oper->y, &oper->line_old, &oper->line_new );
+        _ApplyMod( buf, y, rec, rec.contents_new );
       } break;
       case undoableopertype_t::rem: {
-        LineRemove( buf, oper->y, &oper->line_old );
+        _RemoveLine( buf, y );
       } break;
       case undoableopertype_t::permuteu: {
         bool moved;
-        LinePermuteU( buf, oper->y_start, oper->y_end, &moved );
+        LinePermuteU( buf, y, y + rec.y_span, &moved );
       } break;
       case undoableopertype_t::permuted: {
         bool moved;
-        LinePermuteD( buf, oper->y_start, oper->y_end, &moved );
+        LinePermuteD( buf, y, y + rec.y_span, &moved );
+      } break;
+      case undoableopertype_t::insrun: {
+        _ApplyRunChar( buf, y, rec, 0, 1 );
+        h.run_undone = Cast( u32, rec.contents.len - 1 );
       } break;
       default: UnreachableCrash();
     }
 
-    if( loop ) {
-      buf->history_idx += 1;
+    if( h.run_undone ) {
+      break;
     }
   }
-
-#if PAGEHISTORY
-#else
-  AssertCrash( buf->history_idx == buf->history.len  ||  buf->history.mem[buf->history_idx].type == undoableopertype_t::checkpt );
-#endif
+  _FreeLinesNow( buf );
 }
 
 
@@ -2502,3 +3110,163 @@ RegisterTest([]()
   }
 });
 
+
+RegisterTest([]()
+{
+  // chunked BufLoad against the plain serial split, with chunks small enough to land on every kind of boundary.
+  rng_xorshift32_t rng;
+  Init( rng, 1234 );
+  u8 alphabet[] = { 'a', 'b', '\r', '\n' };
+  idx_t chunk_sizes[] = { 1, 3, 7, 64, 1000000 };
+  For( round, 0, 50 ) {
+    auto len = Rand32( rng ) % 2000;
+    auto contents = AllocString<u8>( len );
+    For( i, 0, len ) {
+      contents.mem[i] = alphabet[ Rand32( rng ) % _countof( alphabet ) ];
+    }
+
+    stack_resizeable_pagelist_t<slice32_t> lines;
+    Init( lines, 1024 );
+    idx_t num_cr;
+    idx_t num_lf;
+    idx_t num_crlf;
+    SplitIntoLines( &lines, ML( contents ), &num_cr, &num_lf, &num_crlf );
+
+    eolcounts_t eols;
+    CountEols( &eols, ML( contents ) );
+    AssertCrash( eols.num_cr == num_cr );
+    AssertCrash( eols.num_lf == num_lf );
+    AssertCrash( eols.num_crlf == num_crlf );
+
+    ForEach( chunk_size, chunk_sizes ) {
+      buf_t buf;
+      Init( &buf );
+      Init( buf.pagelist, 4000 );
+      buf.orig_file_contents = AllocString<u8>( len );
+      Memmove( buf.orig_file_contents.mem, ML( contents ) );
+      eoltype_t eoltype;
+      _BufLoadContents( &buf, &eoltype, 0, chunk_size );
+      Alloc( buf.unused_internal_idxs, 8 );
+      Alloc( buf.history.log, 8 );
+      Alloc( buf.lines_to_free, 8 );
+
+      AssertCrash( NLines( &buf ) == lines.totallen );
+      auto iter = MakeIteratorAtLinearIndex( lines, 0 );
+      FORALLLINES( &buf, line, y )
+        auto expected = GetElemAtIterator( lines, iter );
+        iter = IteratorMoveR( lines, iter );
+        AssertCrash( line->len == expected->len );
+        AssertCrash( line->mem == buf.orig_file_contents.mem + ( expected->mem - contents.mem ) );
+      }
+      Kill( &buf );
+    }
+
+    Kill( lines );
+    Free( contents );
+  }
+});
+
+RegisterTest([]()
+{
+  // random typing and edits, undone and redone all the way, through insruns, the history cap, and spilling.
+  fsobj_t spillname;
+  FsGetCwd( spillname );
+  AddBackCStr( &spillname, "/bufhistory_test.bin" );
+
+  rng_xorshift32_t rng;
+  Init( rng, 1234 );
+  u8 paste[] = "xy\r\nz\r\n\r\nw";
+  idx_t limits[] = { c_bufhistory_max_bytes, 300, 300 };
+  For( l, 0, _countof( limits ) ) {
+    bool spill = ( l == 2 );
+    buf_t buf;
+    Init( &buf );
+    BufLoadEmpty( &buf );
+    BufSetHistoryLimit( &buf, limits[l] );
+    if( spill ) {
+      BufSpillHistory( &buf, ML( spillname ) );
+    }
+    stack_resizeable_cont_t<string_t> states;
+    Alloc( states, 512 );
+    *AddBack( states ) = AllocContents( &buf, eoltype_t::lf );
+    u32 x = 0;
+    u32 y = 0;
+    For( i, 0, 400 ) {
+      // most steps type a char at the cursor, so runs get long.
+      UndoCheckpt( &buf );
+      auto r = Rand32( rng ) % 32;
+      if( r < 24 ) {
+        auto c = Cast( u8, 'a' + Rand32( rng ) % 3 );
+        Insert( &buf, x, y, &c, 1, &x, &y );
+      } elif( r < 26 ) {
+        Insert( &buf, x, y, paste, CstrLength( paste ), &x, &y );
+      } elif( r < 29 ) {
+        if( x ) {
+          Delete( &buf, x - 1, y, x, y );
+          x -= 1;
+        } elif( y ) {
+          auto x_prev = LineFromY( &buf, y - 1 )->len;
+          Delete( &buf, x_prev, y - 1, x, y );
+          x = x_prev;
+          y -= 1;
+        }
+      } elif( r < 30 ) {
+        bool moved;
+        ForwardPermuteOper( &buf, y, y, undoableopertype_t::permuted, &moved );
+        x = MIN( x, LineFromY( &buf, y )->len );
+      } else {
+        y = Rand32( rng ) % NLines( &buf );
+        x = Rand32( rng ) % ( LineFromY( &buf, y )->len + 1 );
+      }
+      *AddBack( states ) = AllocContents( &buf, eoltype_t::lf );
+    }
+    AssertCrash( Implies( l, buf.history.log.len <= 2 * limits[l] ) );
+
+    auto Verify = [&]( string_t& expected )
+    {
+      auto contents = AllocContents( &buf, eoltype_t::lf );
+      AssertCrash( MemEqual( ML( contents ), ML( expected ) ) );
+      Free( contents );
+    };
+    // every undo and redo lands exactly on the state from that step.
+    // without spilling, undo stops short of the start, at the oldest checkpt the cap kept.
+    auto undone = states.len - 1;
+    while( undone  &&  ( l != 1  ||  buf.history.pos ) ) {
+      Undo( &buf );
+      undone -= 1;
+      Verify( states.mem[undone] );
+    }
+    AssertCrash( ( l == 1 ) == ( undone > 0 ) );
+    Undo( &buf );
+    Verify( states.mem[undone] );
+    For( i, undone + 1, states.len ) {
+      Redo( &buf );
+      Verify( states.mem[i] );
+    }
+
+    // undo a few steps, likely into the middle of a run, then diverge. the undone steps are gone for good.
+    auto back = Min<idx_t>( 7, states.len - 1 - undone );
+    For( i, 0, back ) {
+      Undo( &buf );
+    }
+    auto& state_back = states.mem[ states.len - 1 - back ];
+    UndoCheckpt( &buf );
+    auto c = Cast( u8, 'q' );
+    Insert( &buf, 0, 0, &c, 1 );
+    Undo( &buf );
+    Verify( state_back );
+    Redo( &buf );
+    Redo( &buf );
+    auto contents = AllocContents( &buf, eoltype_t::lf );
+    AssertCrash( contents.len == state_back.len + 1 );
+    AssertCrash( contents.mem[0] == 'q' );
+    Free( contents );
+
+    ForLen( i, states ) {
+      Free( states.mem[i] );
+    }
+    Free( states );
+    Kill( &buf );
+  }
+  FileDelete( ML( spillname ) );
+});
@@ -6,6 +6,7 @@ diffview_t
   pagelist_t mem;
   slice_t file_l;
   slice_t file_r;
+  diff_t diff; // hunks between file_l and file_r.
 };
 Inl void
 Init( diffview_t& d )
@@ -13,6 +14,7 @@ Init( diffview_t& d )
   Init( d.mem, 32768 );
   d.file_l = {};
   d.file_r = {};
+  Init( d.diff );
 }
 Inl void
 Kill( diffview_t& d )
@@ -20,6 +22,7 @@ Kill( diffview_t& d )
   Kill( d.mem );
   d.file_l = {};
   d.file_r = {};
+  Kill( d.diff );
 }
 
 #define __DiffCmd( name )      void ( name )( diffview_t& d, idx_t misc = 0 )
@@ -35,6 +38,8 @@ SetFiles(
 {
   d.file_l = file_l;
   d.file_r = file_r;
+  // histogram reads best on code, and we only refine the lines inside changed hunks.
+  DiffFiles( d.diff, file_l, file_r, diffalgo_t::histogram, 1 );
 }
 
 
@@ -9,6 +9,7 @@ Enumc( editmode_t )
   fileopener, // choose a new file to open and make active
   externalmerge, // detected an external change to an open file; you must decide on a resolution
   findinfiles, // recursive directory file content search
+  bigfile, // windowed view of a file too big to load into a txt_t
 };
 
 Enumc( editlayer_t )
@@ -71,6 +72,7 @@ edit_t
   switchopened_t switchopened;
   findinfiles_t findinfiles;
   fileopener_t fileopener;
+  bigfileview_t bigfile;
 
   txt_t gotoline;
   findreplace_t findrepl;
@@ -239,6 +241,25 @@ __EditCmd( CmdMode_fileopener_from_switchopened )
   _SwitchToFileopener( edit );
 }
 
+// only one big file at a time; opening another closes the last, unsaved edits and all.
+Inl bool
+EditOpenBigfile( edit_t& edit, u8* name, idx_t name_len )
+{
+  if( !BigfileviewIsOpen( edit.bigfile, name, name_len ) ) {
+    if( !BigfileviewOpen( edit.bigfile, name, name_len ) ) {
+      return 0;
+    }
+  }
+  edit.mode = editmode_t::bigfile;
+  return 1;
+}
+
+__EditCmd( CmdMode_fileopener_from_bigfile )
+{
+  AssertCrash( edit.mode == editmode_t::bigfile );
+  _SwitchToFileopener( edit );
+}
+
 __FileopenerOpenFileFromRow( EditOpenFileFromRow )
 {
   auto edit = Cast( edit_t*, misc );
@@ -249,7 +270,10 @@ __FileopenerOpenFileFromRow( EditOpenFileFromRow )
   auto file = FileOpen( ML( filename ), fileopen_t::only_existing, fileop_t::R, fileop_t::R );
 #endif
   *loaded = file.loaded;
-  if( file.loaded ) {
+  if( file.loaded  &&  file.size >= c_bigfile_min_size ) {
+    *loaded = EditOpenBigfile( *edit, ML( filename ) );
+  }
+  elif( file.loaded ) {
     edittxtopen_t* open = 0;
     bool opened_existing = 0;
     EditOpen( *edit, file, &open, &opened_existing );
@@ -284,6 +308,8 @@ EditInit( edit_t& edit )
 
   Init( edit.fileopener );
 
+  Init( edit.bigfile );
+
   Init( edit.gotoline );
   TxtLoadEmpty( edit.gotoline );
 
@@ -313,6 +339,7 @@ EditKill( edit_t& edit )
   edit.rect_statusbar[1] = {};
 
   Kill( edit.fileopener );
+  Kill( edit.bigfile );
   Kill( edit.gotoline );
 
   Kill( edit.findrepl );
@@ -496,41 +523,13 @@ __EditCmd( CmdFindinfilesChoose )
     auto match_l = foundinfile->pos_match_l;
     auto match_len = foundinfile->match_len;
     auto match_r = match_l + match_len;
-    auto cmatch_l = match_l;
-    auto cmatch_r = match_r;
     u32 match_l_x = 0;
     u32 match_l_y = 0;
     u32 match_r_x = 0;
     u32 match_r_y = 0;
     auto eol_len = EolString( txt->eoltype ).len;
-    bool converted_l = 0;
-    bool converted_r = 0;
-    FORALLLINES( &txt->buf, line, y )
-      if( converted_r ) break;
-      auto line_and_eol_len = line->len + eol_len;
-      if( !converted_l ) {
-        if( cmatch_l >= line_and_eol_len ) {
-          cmatch_l -= line_and_eol_len;
-        }
-        else { // cmatch_l < line_and_eol_len
-          converted_l = 1;
-          AssertCrash( cmatch_l <= MAX_u32 );
-          match_l_x = Cast( u32, cmatch_l );
-          match_l_y = y;
-        }
-      }
-      if( !converted_r ) {
-        if( cmatch_r >= line_and_eol_len ) {
-          cmatch_r -= line_and_eol_len;
-        }
-        else { // cmatch_r < line_and_eol_len
-          converted_r = 1;
-          AssertCrash( cmatch_r <= MAX_u32 );
-          match_r_x = Cast( u32, cmatch_r );
-          match_r_y = y;
-        }
-      }
-    }
+    auto converted_l = LinearToLineSpace( &txt->buf, match_l, eol_len, &match_l_x, &match_l_y );
+    auto converted_r = LinearToLineSpace( &txt->buf, match_r, eol_len, &match_r_x, &match_r_y );
     if( !converted_l  ||  !converted_r ) {
       auto slice = SliceFromArray( txt->filename );
       auto cstr = AllocCstr( slice );
@@ -673,41 +672,13 @@ _ReplaceInFile(
     auto match_l = foundinfile->pos_match_l;
     auto match_len = foundinfile->match_len;
     auto match_r = match_l + match_len;
-    auto cmatch_l = match_l;
-    auto cmatch_r = match_r;
     u32 match_l_x = 0;
     u32 match_l_y = 0;
     u32 match_r_x = 0;
     u32 match_r_y = 0;
     auto eol_len = EolString( txt->eoltype ).len;
-    bool converted_l = 0;
-    bool converted_r = 0;
-    FORALLLINES( &txt->buf, line, y )
-      if( converted_r ) break;
-      auto line_and_eol_len = line->len + eol_len;
-      if( !converted_l ) {
-        if( cmatch_l >= line_and_eol_len ) {
-          cmatch_l -= line_and_eol_len;
-        }
-        else { // cmatch_l < line_and_eol_len
-          converted_l = 1;
-          AssertCrash( cmatch_l <= MAX_u32 );
-          match_l_x = Cast( u32, cmatch_l );
-          match_l_y = y;
-        }
-      }
-      if( !converted_r ) {
-        if( cmatch_r >= line_and_eol_len ) {
-          cmatch_r -= line_and_eol_len;
-        }
-        else { // cmatch_r < line_and_eol_len
-          converted_r = 1;
-          AssertCrash( cmatch_r <= MAX_u32 );
-          match_r_x = Cast( u32, cmatch_r );
-          match_r_y = y;
-        }
-      }
-    }
+    auto converted_l = LinearToLineSpace( &txt->buf, match_l, eol_len, &match_l_x, &match_l_y );
+    auto converted_r = LinearToLineSpace( &txt->buf, match_r, eol_len, &match_r_x, &match_r_y );
     if( !converted_l  ||  !converted_r ) {
       auto slice = SliceFromArray( txt->filename );
       auto cstr = AllocCstr( slice );
@@ -1903,6 +1874,19 @@ EditRender(
         );
     } break;
 
+    case editmode_t::bigfile: {
+      BigfileviewRender(
+        edit.bigfile,
+        target_valid,
+        stream,
+        font,
+        bounds,
+        zrange,
+        timestep_realtime,
+        timestep_fixed
+        );
+    } break;
+
     default: UnreachableCrash();
   }
 }
@@ -2052,6 +2036,20 @@ EditControlMouse(
       }
     } break;
 
+    case editmode_t::bigfile: {
+      BigfileviewControlMouse(
+        edit.bigfile,
+        target_valid,
+        font,
+        bounds,
+        type,
+        btn,
+        m,
+        raw_delta,
+        dwheel
+        );
+    } break;
+
     default: UnreachableCrash();
   }
 }
@@ -2411,6 +2409,38 @@ EditControlKeyboard(
       }
     } break;
 
+    case editmode_t::bigfile: {
+      if( kb_command ) {
+        switch( type ) {
+          case glwkeyevent_t::dn: {
+            // edit level commands
+            edit_cmdmap_t table[] = {
+              _editcmdmap( GetPropFromDb( glwkeybind_t, keybind_mode_fileopener_from_bigfile ), CmdMode_fileopener_from_bigfile ),
+            };
+            ExecuteCmdMap( edit, AL( table ), key, target_valid, ran_cmd );
+          } break;
+
+          case glwkeyevent_t::repeat:
+          case glwkeyevent_t::up: {
+          } break;
+
+          default: UnreachableCrash();
+        }
+      }
+
+      if( !ran_cmd ) {
+        BigfileviewControlKeyboard(
+          edit.bigfile,
+          kb_command,
+          target_valid,
+          ran_cmd,
+          type,
+          key,
+          keylocks
+          );
+      }
+    } break;
+
     default: UnreachableCrash();
   }
 }
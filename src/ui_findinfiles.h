@@ -73,28 +73,104 @@ Kill( foundinfile_t& f )
 }
 
 
-// per-thread context to execute the filecontentsearch task.
+// how many matches a taskthread buffers before it pings the main thread to drain them.
+// small, so the first results show up right away.
+constant idx_t c_findinfiles_results_batch = 32;
+constant idx_t c_findinfiles_results_ring_len = 1024;
+
+// per-taskthread output of a search.
+// the taskthread is the only writer to mem and results; the main thread is the only reader of results.
 struct
-asynccontext_filecontentsearch_t
+findinfiles_slot_t
+{
+  pagelist_t mem; // match samples. pages never move, so the main thread can keep pointers into them.
+  mtqueue_srsw_t<foundinfile_t> results;
+  idx_t num_unpublished; // matches enqueued since we last pinged the main thread.
+
+  u8 cache_line_padding_to_avoid_thrashing[64]; // last thing, since this type is packed into an stack_resizeable_cont_t
+};
+
+struct
+findinfiles_t;
+
+// all the state for one query, shared by its tasks.
+// a newer query sets cancel and moves on without waiting, and the old tasks bail out at their next check.
+// the last task to finish hands this back to the main thread, which frees it once it's no longer the current search.
+struct
+findinfiles_search_t
 {
   // input / readonly:
-  stack_resizeable_cont_t<slice_t>* filenames;
-  idx_t filenames_start;
-  idx_t filenames_count;
-  stack_resizeable_cont_t<slice_t>* ignored_filetypes_list;
-  stack_resizeable_cont_t<slice_t>* included_filetypes_list;
-  slice32_t key;
+  findinfiles_t* fif;
+  pagelist_t mem; // filenames and filetype lists point in here.
+  stack_resizeable_cont_t<slice_t> filenames;
+  stack_resizeable_cont_t<slice_t> ignored_filetypes_list;
+  stack_resizeable_cont_t<slice_t> included_filetypes_list;
+  string_t key;
   bool case_sens;
   bool word_boundary;
 
-  // output / modifiable:
-  pagelist_t mem;
-  stack_resizeable_pagelist_t<foundinfile_t> matches;
+  // the cancellation token.
+  volatile bool cancel;
 
+  // output / modifiable, one per taskthread:
+  stack_resizeable_cont_t<findinfiles_slot_t> slots;
+  volatile idx_t num_files_scanned;
+  volatile idx_t num_tasks_pending;
 
-  u8 cache_line_padding_to_avoid_thrashing[64]; // last thing, since this type is packed into an stack_resizeable_cont_t
+  // main thread only:
+  bool done;
+  idx_t num_matches;
+  u64 time_start;
+  u64 time_first_result; // when the first match reached fif.matches, or 0 if none have yet.
+  u64 time_end;
 };
 
+Inl void
+Init( findinfiles_search_t& search, findinfiles_t* fif )
+{
+  search.fif = fif;
+  Init( search.mem, 128*1024 );
+  Alloc( search.filenames, 4096 );
+  Alloc( search.ignored_filetypes_list, 16 );
+  Alloc( search.included_filetypes_list, 16 );
+  Zero( search.key );
+  search.case_sens = 0;
+  search.word_boundary = 0;
+  search.cancel = 0;
+  auto num_slots = MAX( g_mainthread.taskthreads.len, 1 );
+  Alloc( search.slots, num_slots );
+  For( i, 0, num_slots ) {
+    auto slot = AddBack( search.slots );
+    Init( slot->mem, 256 );
+    Alloc( slot->results, c_findinfiles_results_ring_len );
+    slot->num_unpublished = 0;
+  }
+  search.num_files_scanned = 0;
+  search.num_tasks_pending = 0;
+  search.done = 0;
+  search.num_matches = 0;
+  search.time_start = 0;
+  search.time_first_result = 0;
+  search.time_end = 0;
+}
+
+Inl void
+Kill( findinfiles_search_t& search )
+{
+  search.fif = 0;
+  Kill( search.mem );
+  Free( search.filenames );
+  Free( search.ignored_filetypes_list );
+  Free( search.included_filetypes_list );
+  Free( search.key );
+  ForLen( i, search.slots ) {
+    auto slot = search.slots.mem + i;
+    Kill( slot->mem );
+    Free( slot->results );
+  }
+  Free( search.slots );
+}
+
 
 Enumc( findinfilesfocus_t )
 {
@@ -134,7 +210,6 @@ struct
 findinfiles_t
 {
   stack_resizeable_pagelist_t<foundinfile_t> matches;
-  pagelist_t mem;
   findinfilesfocus_t focus;
   txt_t dir;
   txt_t query;
@@ -146,22 +221,23 @@ findinfiles_t
   string_t matches_dir;
   listview_t listview;
 
-  u8 cache_line_padding_to_avoid_thrashing[64];
-  stack_resizeable_cont_t<asynccontext_filecontentsearch_t> asynccontexts;
+  // the current query's search, whose matches we're streaming into matches.
+  // cancelled searches stay in searches_cancelled until their in-flight tasks drain out.
+  findinfiles_search_t* search;
+  stack_resizeable_cont_t<findinfiles_search_t*> searches_cancelled;
   idx_t progress_num_files;
   idx_t progress_max;
 
-  // used by all other threads as readonly:
-  stack_resizeable_cont_t<slice_t> filenames;
-  stack_resizeable_cont_t<slice_t> ignored_filetypes_list;
-  stack_resizeable_cont_t<slice_t> included_filetypes_list;
-  string_t key;
+  // persistent trigram index of matches_dir, so refreshes only scan the files that might contain the key.
+  // index_update is nonzero while a background update is reading index, so we can't swap or free it until then.
+  trigramindex_t index;
+  fsobj_t index_filename;
+  trigramindex_update_t* index_update;
 };
 
 Inl void
 Init( findinfiles_t& fif )
 {
-  Init( fif.mem, 128*1024 );
   Init( fif.matches, 256 );
   Init( fif.dir );
   TxtLoadEmpty( fif.dir );
@@ -185,20 +261,19 @@ Init( findinfiles_t& fif )
   fif.focus = findinfilesfocus_t::query;
   fif.matches_dir = {};
   Init( &fif.listview, &fif.matches.totallen );
+  fif.search = 0;
+  Alloc( fif.searches_cancelled, 4 );
   fif.progress_num_files = 0;
   fif.progress_max = 0;
-  Alloc( fif.filenames, 4096 );
-  Alloc( fif.asynccontexts, 16 );
-  Alloc( fif.ignored_filetypes_list, 16 );
-  Alloc( fif.included_filetypes_list, 16 );
-  Zero( fif.key );
+  Zero( fif.index );
+  fif.index_filename.len = 0;
+  fif.index_update = 0;
 }
 
 Inl void
 Kill( findinfiles_t& fif )
 {
   Kill( fif.matches );
-  Kill( fif.mem );
   Kill( fif.dir );
   Kill( fif.query );
   fif.case_sens = 0;
@@ -212,18 +287,27 @@ Kill( findinfiles_t& fif )
   Kill( &fif.listview );
   fif.progress_num_files = 0;
   fif.progress_max = 0;
-  Free( fif.filenames );
 
-  ForLen( i, fif.asynccontexts ) {
-    auto ac = fif.asynccontexts.mem + i;
-    Kill( ac->mem );
-    Kill( ac->matches );
+  // the taskthreads have stopped by now, so in-flight searches and index updates are safe to throw away.
+  if( fif.search ) {
+    Kill( *fif.search );
+    MemHeapFree( fif.search );
+    fif.search = 0;
+  }
+  ForLen( i, fif.searches_cancelled ) {
+    auto search = fif.searches_cancelled.mem[i];
+    Kill( *search );
+    MemHeapFree( search );
   }
-  Free( fif.asynccontexts );
+  Free( fif.searches_cancelled );
 
-  Free( fif.ignored_filetypes_list );
-  Free( fif.included_filetypes_list );
-  Free( fif.key );
+  if( fif.index_update ) {
+    Kill( *fif.index_update );
+    MemHeapFree( fif.index_update );
+    fif.index_update = 0;
+  }
+  Free( fif.index );
+  fif.index_filename.len = 0;
 }
 
 #define __FindinfilesCmd( name )   void ( name )( findinfiles_t& fif, idx_t misc = 0, idx_t misc2 = 0 )
@@ -231,311 +315,484 @@ Kill( findinfiles_t& fif )
 typedef __FindinfilesCmdDef( *pfn_findinfilescmd_t );
 
 Inl void
-AsyncFileContentSearch( asynccontext_filecontentsearch_t* ac )
+_FindinfilesDrain( findinfiles_t& fif )
+{
+  auto search = fif.search;
+  if( !search ) {
+    return;
+  }
+  ForLen( i, search->slots ) {
+    auto slot = search->slots.mem + i;
+    bool success = 1;
+    while( success ) {
+      foundinfile_t elem;
+      DequeueS( slot->results, &elem, &success );
+      if( success ) {
+        *AddBack( fif.matches, 1 ) = elem;
+        search->num_matches += 1;
+      }
+    }
+  }
+  if( search->num_matches  &&  !search->time_first_result ) {
+    search->time_first_result = TimeTSC();
+  }
+  fif.progress_num_files = search->num_files_scanned;
+}
+
+// note this drains whatever the current search is, so a ping from a cancelled search is harmless.
+__MainTaskCompleted( MainTaskCompleted_FileContentSearchResults )
 {
   ProfFunc();
 
-  For( i, ac->filenames_start, ac->filenames_start + ac->filenames_count ) {
-    auto obj = ac->filenames->mem + i;
+  auto fif = Cast( findinfiles_t*, misc0 );
+  _FindinfilesDrain( *fif );
 
-    if( g_mainthread.signal_quit ) {
-      return;
-    }
+  *target_valid = 0;
+}
 
-    Prof( tmp_ContentSearchSingleFile );
-
-    Prof( tmp_ApplyFilterFiletype );
-    auto ext = FileExtension( ML( *obj ) );
-    if( ext.len ) {
-      // ignore files with extensions in the 'ignore' list.
-      bool found = 0;
-      FORLEN( filter, j, *ac->ignored_filetypes_list )
-        if( StringEquals( ML( ext ), ML( *filter ), 0 ) ) {
-          found = 1;
-          break;
-        }
-      }
-      if( found ) {
-        continue;
-      }
+Inl void
+_FindinfilesFreeSearch( findinfiles_search_t* search )
+{
+  Kill( *search );
+  MemHeapFree( search );
+}
 
-      // ignore files with extensions that aren't in the 'include' list.
-      // empty 'include' list means include everything.
-      found = 0;
-      FORLEN( filter, j, *ac->included_filetypes_list )
-        if( StringEquals( ML( ext ), ML( *filter ), 0 ) ) {
-          found = 1;
-          break;
-        }
-      }
-      if( ac->included_filetypes_list->len  &&  !found ) {
-        continue;
+__MainTaskCompleted( MainTaskCompleted_FileContentSearchDone )
+{
+  ProfFunc();
+
+  auto search = Cast( findinfiles_search_t*, misc0 );
+  auto fif = search->fif;
+  search->done = 1;
+
+  if( search != fif->search ) {
+    ForLen( i, fif->searches_cancelled ) {
+      if( fif->searches_cancelled.mem[i] == search ) {
+        UnorderedRemAt( fif->searches_cancelled, i );
+        break;
       }
     }
-    ProfClose( tmp_ApplyFilterFiletype );
+    _FindinfilesFreeSearch( search );
+    return;
+  }
 
-    Prof( tmp_FileOpen );
-    file_t file = FileOpen( ML( *obj ), fileopen_t::only_existing, fileop_t::R, fileop_t::RW );
-    ProfClose( tmp_FileOpen );
-    // TODO: log when !file.loaded
-    if( file.loaded ) {
-      // collect all instances of the key.
+  // every task has finished enqueueing by now, so this drains everything.
+  _FindinfilesDrain( *fif );
+  search->time_end = TimeTSC();
+  fif->progress_num_files = fif->progress_max;
+
+  LogUI(
+    "[EDIT] Findinfiles: %llu results in %llu files, first result %f ms, done %f ms.",
+    Cast( u64, search->num_matches ),
+    Cast( u64, search->filenames.len ),
+    search->time_first_result  ?  1000 * TimeSecFromTSC64( search->time_first_result - search->time_start )  :  0.0,
+    1000 * TimeSecFromTSC64( search->time_end - search->time_start )
+    );
 
-#if USE_BUF_FOR_FILECONTENTSEARCH
-      buf_t buf;
-      Init( &buf );
-      eoltype_t eoltype;
-      BufLoad( &buf, &file, &eoltype );
-      // TODO: close file after loading? we don't need to writeback or anything.
-      bool found = 1;
-      u32 x = 0;
-      u32 y = 0;
-      while( found ) {
-        u32 x_found;
-        u32 y_found;
-        FindFirstInlineR(
-          &buf,
-          x,
-          y,
-          ML( ac->key ),
-          &x_found,
-          &y_found,
-          &found,
-          ac->case_sens,
-          ac->word_boundary
-          );
-        if( found ) {
-          auto line = LineFromY( &buf, y_found );
-          Prof( tmp_AddMatch );
-          auto instance = AddBack( ac->matches, 1 );
-          instance->name = *obj;
-          instance->l_x = x_found;
-          instance->l_y = y_found;
-          instance->r_x = x_found + ac->key.len;
-          instance->r_y = y_found;
-          instance->match_len = ac->key.len;
-          auto bol_whitespace = CursorSkipSpacetabR( ML( *line ), 0 );
-          auto eol_whitespace = CursorSkipSpacetabL( ML( *line ), line->len );
-          // min in case search query contains whitespace.
-          auto sample_start = MIN( instance->l_x, bol_whitespace );
-          AssertCrash( sample_start <= instance->l_x );
-          // samples don't scroll, so c_max_line_len should be wide enough for anyone.
-          auto sample_end = MIN( sample_start + c_max_line_len, eol_whitespace );
-          AssertCrash( sample_start <= sample_end );
-          auto sample_len = sample_end - sample_start;
-          // min in case pos_match_l spans beyond sample_end
-          instance->sample_match_offset = MIN( instance->l_x - sample_start, sample_len );
-          // min in case pos_match_l spans beyond sample_end
-          instance->sample_match_len = MIN( instance->match_len, sample_len - instance->sample_match_offset );
-          instance->sample.len = sample_len;
-          instance->sample.mem = AddPagelist( ac->mem, u8, 1, instance->sample.len );
-          AssertCrash( sample_start <= instance->l_x );
-          Memmove( instance->sample.mem, line->mem + sample_start, instance->sample.len );
-          x = x_found;
-          y = y_found;
-          CursorCharR( &buf, &x, &y );
-          ProfClose( tmp_AddMatch );
-        }
-      }
+  *target_valid = 0;
+}
 
-      Kill( &buf );
-#else
-      Prof( tmp_FileAlloc );
-      auto mem = FileAlloc( file );
-      ProfClose( tmp_FileAlloc );
-      Prof( tmp_ContentSearch );
-      bool found = 1;
-      idx_t pos = 0;
-      while( found ) {
-        idx_t res = 0;
-        found = StringIdxScanR( &res, ML( mem ), pos, ML( ac->key ), ac->case_sens, ac->word_boundary );
-        if( found ) {
-          Prof( tmp_AddMatch );
-          pos = res;
-
-          auto instance = AddBack( ac->matches, 1 );
-          instance->name = *obj;
-          instance->pos_match_l = pos;
-          instance->pos_match_r = pos + ac->key.len;
-          instance->match_len = ac->key.len;
-          auto bol = CursorStopAtNewlineL( ML( mem ), pos );
-          auto eol = CursorStopAtNewlineR( ML( mem ), pos );
-          auto bol_skip_whitespace = CursorSkipSpacetabR( ML( mem ), bol );
-          auto eol_skip_whitespace = CursorSkipSpacetabL( ML( mem ), eol );
-          // min in case search query contains whitespace.
-          auto sample_start = MIN( instance->pos_match_l, bol_skip_whitespace );
-          AssertCrash( sample_start <= instance->pos_match_l );
-          // samples don't scroll, so c_max_line_len should be wide enough for anyone.
-          auto sample_end = MIN( sample_start + c_max_line_len, eol_skip_whitespace );
-          auto sample_len = sample_end - sample_start;
-          AssertCrash( sample_start <= sample_end );
-          // min in case pos_match_l spans beyond sample_end
-          instance->sample_match_offset = MIN( instance->pos_match_l - sample_start, sample_len );
-          // min in case pos_match_l spans beyond sample_end
-          instance->sample_match_len = MIN( instance->match_len, sample_len - instance->sample_match_offset );
-          instance->sample.len = sample_len;
-          instance->sample.mem = AddPagelist( ac->mem, u8, 1, instance->sample.len );
-          AssertCrash( sample_start <= instance->pos_match_l );
-          Memmove( instance->sample.mem, mem.mem + sample_start, instance->sample.len );
-
-          pos = CursorCharR( ML( mem ), pos );
-          ProfClose( tmp_AddMatch );
-        }
-      }
-      ProfClose( tmp_ContentSearch );
-      Free( mem );
-#endif
+Inl void
+_FindinfilesPublish( taskthread_t* taskthread, findinfiles_search_t* search, findinfiles_slot_t* slot )
+{
+  if( !slot->num_unpublished ) {
+    return;
+  }
+  slot->num_unpublished = 0;
+
+  maincompletedqueue_entry_t entry;
+  entry.FnMainTaskCompleted = MainTaskCompleted_FileContentSearchResults;
+  entry.misc0 = search->fif;
+  entry.misc1 = 0;
+  entry.misc2 = 0;
+  entry.time_generated = TimeTSC();
+  PushMainTaskCompleted( taskthread, &entry );
+}
+
+Inl bool
+_FindinfilesCancelled( findinfiles_search_t* search )
+{
+  return search->cancel  ||  g_mainthread.signal_quit;
+}
+
+Inl void
+_FindinfilesEmit( taskthread_t* taskthread, findinfiles_search_t* search, findinfiles_slot_t* slot, foundinfile_t* instance )
+{
+  bool success = 0;
+  EnqueueS( slot->results, instance, &success );
+  while( !success ) {
+    // the ring is full, so make sure the main thread knows to drain it, and wait.
+    // a cancelled search's ring won't get drained, nor will anything once we're quitting, so we just drop the match.
+    if( _FindinfilesCancelled( search ) ) {
+      return;
     }
-    FileFree( file );
+    _FindinfilesPublish( taskthread, search, slot );
+    _mm_pause();
+    EnqueueS( slot->results, instance, &success );
+  }
+  slot->num_unpublished += 1;
+  if( slot->num_unpublished >= c_findinfiles_results_batch ) {
+    _FindinfilesPublish( taskthread, search, slot );
   }
 }
 
-__MainTaskCompleted( MainTaskCompleted_FileContentSearch )
+Inl void
+AsyncFileContentSearch( taskthread_t* taskthread, findinfiles_search_t* search, idx_t file_idx )
 {
   ProfFunc();
 
-  auto ac = Cast( asynccontext_filecontentsearch_t*, misc0 );
-  auto fif = Cast( findinfiles_t*, misc1 );
+  auto slot = search->slots.mem + taskthread->idx;
+  auto obj = search->filenames.mem + file_idx;
 
-  fif->progress_num_files += ac->filenames_count;
+  if( _FindinfilesCancelled( search ) ) {
+    return;
+  }
 
-  if( ac->matches.totallen ) {
-    auto pa_iter = MakeIteratorAtLinearIndex( ac->matches, 0 );
-    For( i, 0, ac->matches.totallen ) {
-      auto elem = GetElemAtIterator( ac->matches, pa_iter );
-      pa_iter = IteratorMoveR( ac->matches, pa_iter );
+  Prof( tmp_ContentSearchSingleFile );
+
+  Prof( tmp_ApplyFilterFiletype );
+  auto ext = FileExtension( ML( *obj ) );
+  if( ext.len ) {
+    // ignore files with extensions in the 'ignore' list.
+    bool found = 0;
+    FORLEN( filter, j, search->ignored_filetypes_list )
+      if( StringEquals( ML( ext ), ML( *filter ), 0 ) ) {
+        found = 1;
+        break;
+      }
+    }
+    if( found ) {
+      return;
+    }
 
-      auto instance = AddBack( fif->matches, 1 );
-      *instance = *elem;
+    // ignore files with extensions that aren't in the 'include' list.
+    // empty 'include' list means include everything.
+    found = 0;
+    FORLEN( filter, j, search->included_filetypes_list )
+      if( StringEquals( ML( ext ), ML( *filter ), 0 ) ) {
+        found = 1;
+        break;
+      }
+    }
+    if( search->included_filetypes_list.len  &&  !found ) {
+      return;
     }
   }
+  ProfClose( tmp_ApplyFilterFiletype );
 
-  *target_valid = 0;
+#if USE_BUF_FOR_FILECONTENTSEARCH
+  Prof( tmp_FileOpen );
+  file_t file = FileOpen( ML( *obj ), fileopen_t::only_existing, fileop_t::R, fileop_t::RW );
+  ProfClose( tmp_FileOpen );
+  // TODO: log when !file.loaded
+  if( file.loaded ) {
+    // collect all instances of the key.
+
+    buf_t buf;
+    Init( &buf );
+    eoltype_t eoltype;
+    BufLoad( &buf, &file, &eoltype, 0 );
+    // TODO: close file after loading? we don't need to writeback or anything.
+    bool found = 1;
+    u32 x = 0;
+    u32 y = 0;
+    while( found  &&  !_FindinfilesCancelled( search ) ) {
+      u32 x_found;
+      u32 y_found;
+      FindFirstInlineR(
+        &buf,
+        x,
+        y,
+        ML( search->key ),
+        &x_found,
+        &y_found,
+        &found,
+        search->case_sens,
+        search->word_boundary
+        );
+      if( found ) {
+        auto line = LineFromY( &buf, y_found );
+        Prof( tmp_AddMatch );
+        foundinfile_t instance;
+        instance.name = *obj;
+        instance.l_x = x_found;
+        instance.l_y = y_found;
+        instance.r_x = x_found + search->key.len;
+        instance.r_y = y_found;
+        instance.match_len = search->key.len;
+        auto bol_whitespace = CursorSkipSpacetabR( ML( *line ), 0 );
+        auto eol_whitespace = CursorSkipSpacetabL( ML( *line ), line->len );
+        // min in case search query contains whitespace.
+        auto sample_start = MIN( instance.l_x, bol_whitespace );
+        AssertCrash( sample_start <= instance.l_x );
+        // samples don't scroll, so c_max_line_len should be wide enough for anyone.
+        auto sample_end = MIN( sample_start + c_max_line_len, eol_whitespace );
+        AssertCrash( sample_start <= sample_end );
+        auto sample_len = sample_end - sample_start;
+        // min in case pos_match_l spans beyond sample_end
+        instance.sample_match_offset = MIN( instance.l_x - sample_start, sample_len );
+        // min in case pos_match_l spans beyond sample_end
+        instance.sample_match_len = MIN( instance.match_len, sample_len - instance.sample_match_offset );
+        instance.sample.len = sample_len;
+        instance.sample.mem = AddPagelist( slot->mem, u8, 1, instance.sample.len );
+        AssertCrash( sample_start <= instance.l_x );
+        Memmove( instance.sample.mem, line->mem + sample_start, instance.sample.len );
+        _FindinfilesEmit( taskthread, search, slot, &instance );
+        x = x_found;
+        y = y_found;
+        CursorCharR( &buf, &x, &y );
+        ProfClose( tmp_AddMatch );
+      }
+    }
+
+    Kill( &buf );
+  }
+  FileFree( file );
+#else
+  Prof( tmp_FileOpen );
+  // matches point into the view until we copy their samples out, so we never copy the whole file.
+  auto file = FileOpenMappedExistingReadShareRead( ML( *obj ) );
+  ProfClose( tmp_FileOpen );
+  // TODO: log when !file.loaded
+  if( file.loaded ) {
+    // collect all instances of the key.
+    slice_t mem;
+    mem.mem = file.mapped_mem;
+    mem.len = file.size;
+    Prof( tmp_ContentSearch );
+    bool found = 1;
+    idx_t pos = 0;
+    while( found  &&  !_FindinfilesCancelled( search ) ) {
+      idx_t res = 0;
+      found = StringIdxScanR( &res, ML( mem ), pos, ML( search->key ), search->case_sens, search->word_boundary );
+      if( found ) {
+        Prof( tmp_AddMatch );
+        pos = res;
+
+        foundinfile_t instance;
+        instance.name = *obj;
+        instance.pos_match_l = pos;
+        instance.pos_match_r = pos + search->key.len;
+        instance.match_len = search->key.len;
+        auto bol = CursorStopAtNewlineL( ML( mem ), pos );
+        auto eol = CursorStopAtNewlineR( ML( mem ), pos );
+        auto bol_skip_whitespace = CursorSkipSpacetabR( ML( mem ), bol );
+        auto eol_skip_whitespace = CursorSkipSpacetabL( ML( mem ), eol );
+        // min in case search query contains whitespace.
+        auto sample_start = MIN( instance.pos_match_l, bol_skip_whitespace );
+        AssertCrash( sample_start <= instance.pos_match_l );
+        // samples don't scroll, so c_max_line_len should be wide enough for anyone.
+        auto sample_end = MIN( sample_start + c_max_line_len, eol_skip_whitespace );
+        auto sample_len = sample_end - sample_start;
+        AssertCrash( sample_start <= sample_end );
+        // min in case pos_match_l spans beyond sample_end
+        instance.sample_match_offset = MIN( instance.pos_match_l - sample_start, sample_len );
+        // min in case pos_match_l spans beyond sample_end
+        instance.sample_match_len = MIN( instance.match_len, sample_len - instance.sample_match_offset );
+        instance.sample.len = sample_len;
+        instance.sample.mem = AddPagelist( slot->mem, u8, 1, instance.sample.len );
+        AssertCrash( sample_start <= instance.pos_match_l );
+        Memmove( instance.sample.mem, mem.mem + sample_start, instance.sample.len );
+        _FindinfilesEmit( taskthread, search, slot, &instance );
+
+        pos = CursorCharR( ML( mem ), pos );
+        ProfClose( tmp_AddMatch );
+      }
+    }
+    ProfClose( tmp_ContentSearch );
+  }
+  FileFree( file );
+#endif
 }
 
 __AsyncTask( AsyncTask_FileContentSearch )
 {
   ProfFunc();
 
-  auto ac = Cast( asynccontext_filecontentsearch_t*, misc0 );
-  // auto fif = Cast( findinfiles_t*, misc1 );
+  auto search = Cast( findinfiles_search_t*, misc0 );
+  auto file_idx = Cast( idx_t, misc1 );
+
+  AsyncFileContentSearch( taskthread, search, file_idx );
+
+  // stream this file's matches back now, rather than waiting for the whole search.
+  auto slot = search->slots.mem + taskthread->idx;
+  InterlockedIncrement( &search->num_files_scanned );
+  _FindinfilesPublish( taskthread, search, slot );
+
+  // the last task out tells the main thread, which owns the search's lifetime.
+  if( !InterlockedDecrement( &search->num_tasks_pending ) ) {
+    maincompletedqueue_entry_t entry;
+    entry.FnMainTaskCompleted = MainTaskCompleted_FileContentSearchDone;
+    entry.misc0 = search;
+    entry.misc1 = 0;
+    entry.misc2 = 0;
+    entry.time_generated = TimeTSC();
+    PushMainTaskCompleted( taskthread, &entry );
+  }
+}
 
-  AsyncFileContentSearch( ac );
+__MainTaskCompleted( MainTaskCompleted_TrigramIndexUpdated )
+{
+  ProfFunc();
 
-  // note that we don't send signals back to the main thread in a more fine-grained fashion.
-  // we just send the final signal here, after everything's been done.
-  // this is because the ac's results datastructure is shared across all its results.
-  // our strategy of splitting into small, separate ac's at the start seems to work well enough.
-  maincompletedqueue_entry_t entry;
-  entry.FnMainTaskCompleted = MainTaskCompleted_FileContentSearch;
-  entry.misc0 = misc0;
-  entry.misc1 = misc1;
-  entry.misc2 = 0;
-  entry.time_generated = TimeTSC();
-  PushMainTaskCompleted( taskthread, &entry );
-}
+  auto update = Cast( trigramindex_update_t*, misc0 );
+  auto fif = Cast( findinfiles_t*, misc1 );
+  AssertCrash( fif->index_update == update );
+
+  Free( fif->index );
+  TrigramIndexUpdateInstall( *update, fif->index );
+
+  LogUI(
+    "[EDIT] Trigram index updated: %llu files, %llu reread, %llu MB read, %llu KB index, %f ms.",
+    Cast( u64, update->entries.len ),
+    Cast( u64, update->stale.len ),
+    update->bytes_read / ( 1024 * 1024 ),
+    Cast( u64, fif->index.file.size / 1024 ),
+    1000 * TimeSecFromTSC64( update->time_end - update->time_start )
+    );
 
+  Kill( *update );
+  MemHeapFree( update );
+  fif->index_update = 0;
+}
 
-__FindinfilesCmd( CmdFindinfilesRefresh )
+Inl
+FS_ITERATOR( _IterFindinfilesAddFile )
 {
-  // prevent reentrancy while async stuff is executing
-  if( fif.progress_num_files < fif.progress_max ) {
-    LogUI( "[EDIT] FindinFilesRefresh already in progress!" );
-    return;
+  if( is_file ) {
+    auto update = Cast( trigramindex_update_t*, misc );
+    TrigramIndexUpdateAddFile( *update, name, len, filesize, filetime );
   }
+  return fsiter_result_t::continue_;
+}
 
-  ForLen( i, fif.asynccontexts ) {
-    auto ac = fif.asynccontexts.mem + i;
-    Kill( ac->mem );
-    Kill( ac->matches );
+__FindinfilesCmd( CmdFindinfilesRefresh )
+{
+  auto time_start = TimeTSC();
+
+  // preempt the previous query, rather than making you wait for it.
+  // its tasks see the cancel at their next check, and the last one out hands it back to us to free.
+  if( fif.search ) {
+    auto old = fif.search;
+    fif.search = 0;
+    old->cancel = 1;
+    if( old->done ) {
+      _FindinfilesFreeSearch( old );
+    } else {
+      *AddBack( fif.searches_cancelled ) = old;
+    }
   }
-  fif.asynccontexts.len = 0;
 
-  fif.filenames.len = 0;
-  fif.ignored_filetypes_list.len = 0;
-  fif.included_filetypes_list.len = 0;
-  Free( fif.key );
   Free( fif.matches_dir );
 
   Reset( fif.matches );
-  Reset( fif.mem );
   ListviewResetCS( &fif.listview );
+  fif.progress_num_files = 0;
+  fif.progress_max = 0;
 
-  fif.key = AllocContents( &fif.query.buf, eoltype_t::crlf );
+  auto key = AllocContents( &fif.query.buf, eoltype_t::crlf );
+  if( !key.len ) {
+    Free( key );
+    return;
+  }
 
-  if( fif.key.len ) {
-    fif.matches_dir = AllocContents( &fif.dir.buf, eoltype_t::crlf );
+  auto search = MemHeapAlloc( findinfiles_search_t, 1 );
+  Init( *search, &fif );
+  search->key = key;
+  search->case_sens = fif.case_sens;
+  search->word_boundary = fif.word_boundary;
+  search->time_start = time_start;
+  fif.search = search;
 
-    Prof( tmp_MakeFilterFiletypes );
+  fif.matches_dir = AllocContents( &fif.dir.buf, eoltype_t::crlf );
 
-    AssertCrash( NLines( &fif.ignored_filetypes.buf ) == 1 );
-    auto line = LineFromY( &fif.ignored_filetypes.buf, 0 );
-    SplitBySpacesAndCopyContents(
-      &fif.mem,
-      &fif.ignored_filetypes_list,
-      ML( *line )
-      );
+  Prof( tmp_MakeFilterFiletypes );
 
-    AssertCrash( NLines( &fif.included_filetypes.buf ) == 1 );
-    line = LineFromY( &fif.included_filetypes.buf, 0 );
-    SplitBySpacesAndCopyContents(
-      &fif.mem,
-      &fif.included_filetypes_list,
-      ML( *line )
-      );
+  AssertCrash( NLines( &fif.ignored_filetypes.buf ) == 1 );
+  auto line = LineFromY( &fif.ignored_filetypes.buf, 0 );
+  SplitBySpacesAndCopyContents(
+    &search->mem,
+    &search->ignored_filetypes_list,
+    ML( *line )
+    );
 
-    ProfClose( tmp_MakeFilterFiletypes );
-
-    // this call is ~3% of the cost of this function, after the OS / filesys caches filesys metadata.
-    // so, we'll do this part on the main thread, then fan out.
-    //
-    // if we really need to, we could multithread this:
-    // - have some input queues of directories to process.
-    // - have some result queues of files.
-    // - each thread will:
-    //   - pop off a directory.
-    //   - enumerate all child files and directories.
-    //   - push files onto result queues.
-    //   - push child directories onto input queues.
-    // the lopsided nature of directories would make scheduling pretty hard though.
-    Prof( tmp_FsFindFiles );
-    fif.filenames.len = 0;
-    FsFindFiles( fif.filenames, fif.mem, ML( fif.matches_dir ), 1 );
-    ProfClose( tmp_FsFindFiles );
-
-    fif.progress_num_files = 0;
-    fif.progress_max = fif.filenames.len;
-
-    // PERF: optimize chunksize and per-thread-queue sizes
-    // PERF: filesize-level chunking, for a more even distribution.
-    constant idx_t chunksize = 1;
-    auto quo = fif.filenames.len / chunksize;
-    auto rem = fif.filenames.len % chunksize;
-    Reserve( fif.asynccontexts, quo + 1 );
-    For( i, 0, quo + 1 ) {
-      auto count = ( i == quo )  ?  rem  :  chunksize;
-      if( count ) {
-        auto ac = AddBack( fif.asynccontexts );
-        ac->filenames = &fif.filenames;
-        ac->filenames_start = i * chunksize;
-        ac->filenames_count = count;
-        ac->ignored_filetypes_list = &fif.ignored_filetypes_list;
-        ac->included_filetypes_list = &fif.included_filetypes_list;
-        ac->key = Slice32FromString( fif.key );
-        ac->case_sens = fif.case_sens;
-        ac->word_boundary = fif.word_boundary;
-        // keep these small, since we're using chunksize = 1 above.
-        Init( ac->mem, 256 );
-        Init( ac->matches, 16 );
-
-        asyncqueue_entry_t entry;
-        entry.FnAsyncTask = AsyncTask_FileContentSearch;
-        entry.misc0 = ac;
-        entry.misc1 = &fif;
-        entry.time_generated = TimeTSC();
-        PushAsyncTask( i, &entry );
-      }
-    }
+  AssertCrash( NLines( &fif.included_filetypes.buf ) == 1 );
+  line = LineFromY( &fif.included_filetypes.buf, 0 );
+  SplitBySpacesAndCopyContents(
+    &search->mem,
+    &search->included_filetypes_list,
+    ML( *line )
+    );
+
+  ProfClose( tmp_MakeFilterFiletypes );
+
+  // this call is ~3% of the cost of this function, after the OS / filesys caches filesys metadata.
+  // so, we'll do this part on the main thread, then fan out.
+  //
+  // if we really need to, we could multithread this:
+  // - have some input queues of directories to process.
+  // - have some result queues of files.
+  // - each thread will:
+  //   - pop off a directory.
+  //   - enumerate all child files and directories.
+  //   - push files onto result queues.
+  //   - push child directories onto input queues.
+  // the lopsided nature of directories would make scheduling pretty hard though.
+  Prof( tmp_FsFindFiles );
+  auto index_filename = TrigramIndexFilename( ML( fif.matches_dir ) );
+  auto update = MemHeapAlloc( trigramindex_update_t, 1 );
+  Init( *update, &fif.index, index_filename );
+  FsIterate( ML( fif.matches_dir ), 1, _IterFindinfilesAddFile, update );
+  ProfClose( tmp_FsFindFiles );
+
+  // switch indices when the dir changes, unless a background update is still reading the current one.
+  // in that case, we just don't use an index for this refresh.
+  bool use_index = MemEqual( ML( index_filename ), ML( fif.index_filename ) );
+  if( !use_index  &&  !fif.index_update ) {
+    Prof( tmp_TrigramIndexLoad );
+    Free( fif.index );
+    TrigramIndexLoad( fif.index, ML( index_filename ) );
+    fif.index_filename = index_filename;
+    use_index = 1;
+    ProfClose( tmp_TrigramIndexLoad );
+  }
+  if( !use_index ) {
+    update->old = 0;
+  }
+
+  // files the index is stale for come back as candidates, so the results are exact either way.
+  Prof( tmp_TrigramIndexQuery );
+  TrigramIndexUpdatePrepare( *update );
+  TrigramIndexUpdateCandidates( *update, search->filenames, search->mem, ML( search->key ) );
+  ProfClose( tmp_TrigramIndexQuery );
+
+  fif.progress_max = search->filenames.len;
+
+  // one task per file, so a big file on one taskthread doesn't hold the others' results back.
+  // PERF: filesize-level chunking, for a more even distribution.
+  search->num_tasks_pending = search->filenames.len;
+  ForLen( i, search->filenames ) {
+    asyncqueue_entry_t entry;
+    entry.FnAsyncTask = AsyncTask_FileContentSearch;
+    entry.misc0 = search;
+    entry.misc1 = Cast( void*, i );
+    entry.time_generated = TimeTSC();
+    PushAsyncTask( i, &entry );
+  }
+  if( !search->filenames.len ) {
+    search->done = 1;
+  }
+
+  // bring the index up to date in the background, for the next refresh.
+  // we queue this after the searches, so it doesn't hold up this refresh's results.
+  if( use_index  &&  !fif.index_update  &&  TrigramIndexUpdateNeeded( *update ) ) {
+    fif.index_update = update;
+    update->FnCompleted = MainTaskCompleted_TrigramIndexUpdated;
+    update->completed_misc = &fif;
+    TrigramIndexUpdateStart( *update );
+  } else {
+    Kill( *update );
+    MemHeapFree( update );
   }
 }
 __FindinfilesCmd( CmdSelectAllQueryText )
@@ -766,36 +1023,21 @@ FindinfilesRender(
 
   { // result count
     if( fif.progress_num_files < fif.progress_max ) {
-      static const auto label = SliceFromCStr( " % files scanned..." );
-      auto label_w = LayoutString( font, spaces_per_tab, ML( label ) );
-
-      u8 count[128];
-      idx_t count_len = 0;
+      // results stream in while we scan, so show both.
       auto pct = ( fif.progress_num_files * 100.0f ) / fif.progress_max;
-      count_len = sprintf_s( Cast( char*, count ), _countof( count ), "%.2f", pct );
-      auto count_w = LayoutString( font, spaces_per_tab, count, count_len );
-
-      DrawString(
-        stream,
-        font,
-        AlignCenter( bounds, count_w + label_w ),
-        GetZ( zrange, fiflayer_t::txt ),
-        bounds,
-        rgba_text,
-        spaces_per_tab,
-        count, count_len
-        );
-
+      auto label = AllocFormattedString( "%llu results, %.2f%% files scanned...", Cast( u64, fif.matches.totallen ), pct );
+      auto label_w = LayoutString( font, spaces_per_tab, ML( label ) );
       DrawString(
         stream,
         font,
-        AlignCenter( bounds, count_w + label_w ) + _vec2( count_w, 0.0f ),
+        AlignCenter( bounds, label_w ),
         GetZ( zrange, fiflayer_t::txt ),
         bounds,
         rgba_text,
         spaces_per_tab,
         ML( label )
         );
+      Free( label );
     }
     else {
       static const auto label = SliceFromCStr( " results" );
@@ -241,6 +241,7 @@ TxtLoadEmpty( txt_t& txt )
   txt.filename.mem[0] = 0;
   txt.filename.len = 0;
   BufLoadEmpty( &txt.buf );
+  BufSetHistoryLimit( &txt.buf, GetPropFromDb( u32, u32_undo_history_max_mb ) * 1024ull*1024 );
 
   txt.spaces_per_tab = GetPropFromDb( u8, u8_spaces_per_tab );
   txt.insert_spaces_for_tabs = GetPropFromDb( bool, bool_insert_spaces_for_tabs );
@@ -253,7 +254,8 @@ TxtLoad( txt_t& txt, file_t& file )
   Memmove( txt.filename.mem, ML( file.obj ) );
   txt.filename.len = file.obj.len;
 
-  BufLoad( &txt.buf, &file, &txt.eoltype );
+  BufLoad( &txt.buf, &file, &txt.eoltype, 1 );
+  BufSetHistoryLimit( &txt.buf, GetPropFromDb( u32, u32_undo_history_max_mb ) * 1024ull*1024 );
 
   auto default_spaces_per_tab = GetPropFromDb( u8, u8_spaces_per_tab );
   auto default_insert_spaces_for_tabs = GetPropFromDb( bool, bool_insert_spaces_for_tabs );